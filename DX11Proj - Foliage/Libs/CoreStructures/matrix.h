@@ -5,4 +5,7 @@
 #include "matrix_core.h"
 #include "matrix_complex.h"
 #include "matrix_lsystem.h"
+#include "matrix_fixed.h"
+#include "matrix_expr.h"
+#include "matrix_sparse.h"
 
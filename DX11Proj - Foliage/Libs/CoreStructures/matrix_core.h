@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "matrix_interface.h"
+#include "matrix_kernels.h"
 
 // #define __GU_DEBUG_MATRIX__ 1
 
@@ -654,6 +655,18 @@ namespace CoreStructures {
 		// return *(M + (i-1) + ((j-1) * n));
 	}
 
+	template <typename T>
+	T* matrix<T>::data() {
+
+		return M.get();
+	}
+
+	template <typename T>
+	const T* matrix<T>::data() const {
+
+		return M.get();
+	}
+
 
 
 	template <typename T>
@@ -916,6 +929,19 @@ namespace CoreStructures {
 			return matrix<T>::nullmatrix();
 
 		matrix<T> I = matrix<T>::I(n);
+
+		if (n >= matrix_lu_blocked_threshold) {
+
+			// solve AX = I from the LUP decomposition of A
+			matrix<T> D;
+			std::vector<unsigned int> P;
+
+			if (lup_decomp(&D, &P) != gu_lu_okay)
+				return matrix<T>::nullmatrix();
+
+			return lup_solve(D, P, I);
+		}
+
 		matrix<T> M = (*this) | I;
 
 		// create pivotIndex and initialise indices to 0
@@ -984,7 +1010,7 @@ namespace CoreStructures {
 				if (D.is_null())
 					return T(0);
 
-				gu_lu_decomp_state lu_state = D.lup_decomposition_doolittle(NULL, &detA);
+				gu_lu_decomp_state lu_state = D.lup_decomposition(NULL, &detA);
 
 				// cout << "debug det: D = \n" << D << endl;
 
@@ -1110,6 +1136,15 @@ namespace CoreStructures {
 			m = 0;
 			M.reset(nullptr); // set matrix to a NULL matrix if A is a NULL matrix
 		
+		} else if (&A == this) {
+
+			return *this;
+
+		} else if (n==A.n && m==A.m && M) {
+
+			// orders match - copy into the existing buffer
+			memcpy_s(M.get(), n * m * sizeof(T), A.M.get(), n * m * sizeof(T));
+
 		} else {
 
 			auto copyBuffer = (T*)malloc(A.n * A.m * sizeof(T));
@@ -1200,31 +1235,37 @@ namespace CoreStructures {
 
 
 	template <typename T>
-	matrix<T>& matrix<T>::operator+=(const matrix<T>& B) {
+	matrix<T> matrix<T>::operator+(matrix<T>&& B) const {
 
-		if (!B.is_null()) {
+		if (is_null() || B.is_null() || n!=B.n || m!=B.m)
+			return (*this) + static_cast<const matrix<T>&>(B);
 
-			if (n==B.n && m==B.m) {
+		// B is a temporary so reuse its buffer for the result
+		auto Aptr = M.get();
+		auto Bptr = B.M.get();
 
-				// if orders match and B is not null then it follows that A is also not null
-				// therefore setup new matrix and add results
+		for (unsigned int k=0;k<n*m;k++)
+			Bptr[k] = Aptr[k] + Bptr[k];
 
-				auto buffer = (T*)malloc(n * m * sizeof(T));
+		return std::move(B);
+	}
 
-				if (buffer) {
 
-					auto Aptr = M.get();
-					auto Bptr = B.M.get();
+	template <typename T>
+	matrix<T>& matrix<T>::operator+=(const matrix<T>& B) {
+
+		if (!B.is_null()) {
 
-					for (unsigned int k=0;k<n*m;k++)
-						buffer[k] = Aptr[k] + Bptr[k];
+			if (n==B.n && m==B.m) {
 
-					M.reset(buffer);
+				// if orders match and B is not null then it follows that A is also not null
+				// therefore add B in-place
 
-				} else {
+				auto Aptr = M.get();
+				auto Bptr = B.M.get();
 
-					make_null(); // cannot allocate buffer - set matrix to a NULL matrix
-				}
+				for (unsigned int k=0;k<n*m;k++)
+					Aptr[k] += Bptr[k];
 
 			} else {
 
@@ -1280,31 +1321,37 @@ namespace CoreStructures {
 
 
 	template <typename T>
-	matrix<T>& matrix<T>::operator-=(const matrix<T>& B) {
+	matrix<T> matrix<T>::operator-(matrix<T>&& B) const {
 
-		if (!B.is_null()) {
+		if (is_null() || B.is_null() || n!=B.n || m!=B.m)
+			return (*this) - static_cast<const matrix<T>&>(B);
 
-			if (n==B.n && m==B.m) {
+		// B is a temporary so reuse its buffer for the result
+		auto Aptr = M.get();
+		auto Bptr = B.M.get();
 
-				// if orders match and B is not null then it follows that A is also not null
-				// therefore setup new matrix and add results
+		for (unsigned int k=0;k<n*m;k++)
+			Bptr[k] = Aptr[k] - Bptr[k];
+
+		return std::move(B);
+	}
 
-				auto buffer = (T*)malloc(n * m * sizeof(T));
 
-				if (buffer) {
+	template <typename T>
+	matrix<T>& matrix<T>::operator-=(const matrix<T>& B) {
 
-					auto Aptr = M.get();
-					auto Bptr = B.M.get();
+		if (!B.is_null()) {
 
-					for (unsigned int k=0;k<n*m;k++)
-						buffer[k] = Aptr[k] - Bptr[k];
+			if (n==B.n && m==B.m) {
 
-					M.reset(buffer);
+				// if orders match and B is not null then it follows that A is also not null
+				// therefore subtract B in-place
 
-				} else {
+				auto Aptr = M.get();
+				auto Bptr = B.M.get();
 
-					make_null(); // cannot allocate buffer - set matrix to a NULL matrix
-				}
+				for (unsigned int k=0;k<n*m;k++)
+					Aptr[k] -= Bptr[k];
 
 			} else {
 
@@ -1355,13 +1402,8 @@ namespace CoreStructures {
 	template <typename T>
 	matrix<T>& matrix<T>::operator*=(T k) {
 
-		if (!is_null()) {
-
-			auto Aptr = M.get();
-
-			for (unsigned int i=0; i<(n*m); i++)
-				Aptr[i] *= k;
-		}
+		if (!is_null())
+			matrix_kernel<T>::scale(M.get(), k, n*m, 1);
 
 		return *this;
 	}
@@ -1379,21 +1421,7 @@ namespace CoreStructures {
 			return matrix<T>::nullmatrix();
 
 		// multiplication kernel
-		for (unsigned int i=0;i<n; i++) { // ith row in new matrix
-
-			auto Mptr = buffer + i;
-			auto Bptr = B.M.get();
-
-			for (unsigned int j=0; j<B.m; j++, Mptr+=n) { // jth column in new matrix
-
-				auto Aptr = M.get() + i;
-			
-				*Mptr = T(0);
-
-				for (unsigned int k=0; k<m; k++, Aptr+=n, Bptr++)
-					*Mptr += *Aptr * *Bptr;
-			}
-		}
+		matrix_kernel<T>::multiply(M.get(), B.M.get(), buffer, n, m, B.m);
 
 		return matrix<T>(n, B.m, matrix_ptr(buffer, ::free));
 	}
@@ -1420,21 +1448,7 @@ namespace CoreStructures {
 		}
 
 		// multiplication kernel
-		for (unsigned int i=0;i<n; i++) { // ith row in new matrix
-
-			auto Mptr = buffer + i;
-			auto Bptr = B.M.get();
-
-			for (unsigned int j=0; j<B.m; j++, Mptr+=n) { // jth column in new matrix
-
-				auto Aptr = M.get() + i;
-			
-				*Mptr = T(0);
-
-				for (unsigned int k=0; k<m; k++, Aptr+=n, Bptr++)
-					*Mptr += *Aptr * *Bptr;
-			}
-		}
+		matrix_kernel<T>::multiply(M.get(), B.M.get(), buffer, n, m, B.m);
 
 		// update this
 		m = B.m;
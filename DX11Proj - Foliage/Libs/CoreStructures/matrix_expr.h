@@ -0,0 +1,544 @@
+﻿#pragma once
+
+#include "matrix_core.h"
+#include <algorithm>
+
+
+/*
+
+matrix_expr<T, E> models a lazily evaluated matrix<T> expression.  An expression is started by wrapping a matrix with lazy(A) and built with the usual operators (+, -, unary -, scalar *, matrix *, transpose(), | and ||).  Nothing is evaluated until the expression is assigned to a matrix<T> (or constructed into one).  Element-wise chains (sums, differences, scaling, negation, transposition and concatenation) are fused into a single loop that writes directly into the destination, and matrix products that appear as terms of a sum are accumulated into the destination by matrix_kernel<T>::multiply_add, so for example
+
+	C = lazy(A) * B + D * E - F * 2.0;
+
+evaluates with no temporaries at all and reuses C's buffer if C already has the required order.  Where fusion is not possible - a product operand that is itself an expression, or a product under a transpose or concatenation - the sub-expression is evaluated once into a temporary matrix that is moved into the expression (the move-semantics fallback).  NULL operands follow the same rules as the corresponding matrix<T> operators.
+
+Expressions refer to their matrix operands, so an expression must be evaluated within the full-expression that creates it - do not store an expression in an auto variable.  lazy() rejects temporaries for the same reason.
+
+Allocation counts can be compared by defining __GU_DEBUG_MEMORY__ in the host application, which routes every matrix buffer allocation through gu_malloc, and reading gu_memory_allocations() (see GUMemory.h) before and after a chain
+
+Each expression type E provides:
+
+	pointwise		element (i, j) only depends on element (i, j) of each operand, so E can be evaluated into one of its operands in-place
+	fused			E contains no products and is evaluated in a single element loop
+	rows(), columns()	order of the result (0 x 0 for a NULL result)
+	at(i, j)		zero-indexed element of the result (valid after prepare())
+	at(k)			element k of the result in column-major order (single index access for pointwise expressions where complete() is true)
+	complete()		true if no sum below E has a NULL operand
+	prepare()		evaluate any products below E so at() can be called
+	buffer()		the column-major elements of the result if E is a plain matrix operand, otherwise nullptr
+	references(p)		true if E reads the matrix buffer p
+	store(C, alpha, acc)	C = alpha * E or (if acc is true) C += alpha * E where C has the order of E
+
+*/
+
+
+namespace CoreStructures {
+
+	template <typename T, typename E>
+	struct matrix_transpose;
+
+
+	//
+	// expression base
+	//
+
+	template <typename T, typename E>
+	struct matrix_expr {
+
+		typedef T value_type;
+
+		const E& expr() const { return static_cast<const E&>(*this); }
+
+		matrix_transpose<T, E> transpose() const { return matrix_transpose<T, E>(expr()); }
+
+		matrix<T> eval() const { return matrix<T>(*this); }
+	};
+
+
+	// evaluate X element by element into C (C = alpha * X or C += alpha * X)
+	template <typename T, typename E>
+	void matrix_expr_store_elements(const E& X, T *C, const T& alpha, bool accumulate) {
+
+		X.prepare();
+
+		unsigned int n = X.rows();
+		unsigned int m = X.columns();
+
+		if (E::pointwise && X.complete()) {
+
+			// every operand has the order of X so the elements can be visited with a single index
+			unsigned int size = n * m;
+
+			if (!accumulate && alpha == T(1)) {
+
+				for (unsigned int k=0; k<size; k++)
+					C[k] = X.at(k);
+
+			} else if (!accumulate) {
+
+				for (unsigned int k=0; k<size; k++)
+					C[k] = alpha * X.at(k);
+
+			} else {
+
+				for (unsigned int k=0; k<size; k++)
+					C[k] += alpha * X.at(k);
+			}
+
+		} else if (!accumulate && alpha == T(1)) {
+
+			for (unsigned int j=0; j<m; j++, C+=n)
+				for (unsigned int i=0; i<n; i++)
+					C[i] = X.at(i, j);
+
+		} else if (!accumulate) {
+
+			for (unsigned int j=0; j<m; j++, C+=n)
+				for (unsigned int i=0; i<n; i++)
+					C[i] = alpha * X.at(i, j);
+
+		} else {
+
+			for (unsigned int j=0; j<m; j++, C+=n)
+				for (unsigned int i=0; i<n; i++)
+					C[i] += alpha * X.at(i, j);
+		}
+	}
+
+
+	//
+	// matrix operand
+	//
+
+	template <typename T>
+	struct matrix_leaf : public matrix_expr<T, matrix_leaf<T> > {
+
+		static const bool		pointwise = true;
+		static const bool		fused = true;
+
+		const T					*ptr;
+		unsigned int			n, m;
+
+		explicit matrix_leaf(const matrix<T>& A) : ptr(A.data()), n(A.rows()), m(A.columns()) {}
+
+		unsigned int rows() const { return n; }
+		unsigned int columns() const { return m; }
+		T at(unsigned int i, unsigned int j) const { return ptr[j*n + i]; }
+		T at(unsigned int k) const { return ptr[k]; }
+		bool complete() const { return true; }
+		void prepare() const {}
+		const T* buffer() const { return ptr; }
+		bool references(const T *p) const { return ptr && ptr == p; }
+
+		void store(T *C, const T& alpha, bool accumulate) const {
+
+			matrix_expr_store_elements(*this, C, alpha, accumulate);
+		}
+	};
+
+
+	//
+	// A + B and A - B
+	//
+
+	template <typename T, typename L, typename R, bool Subtract>
+	struct matrix_sum : public matrix_expr<T, matrix_sum<T, L, R, Subtract> > {
+
+		static const bool		pointwise = L::pointwise && R::pointwise;
+		static const bool		fused = L::fused && R::fused;
+
+		L						lhs;
+		R						rhs;
+		unsigned int			n, m;
+		bool					useL, useR; // operands that contribute to the result (x + 0 = x; 0 + x = x; 0 + 0 = 0; x + y {order(x) != order(y)} = 0)
+
+		matrix_sum(const L& A, const R& B) : lhs(A), rhs(B) {
+
+			useL = lhs.rows() > 0;
+			useR = rhs.rows() > 0;
+
+			if (useL && useR && (lhs.rows()!=rhs.rows() || lhs.columns()!=rhs.columns()))
+				useL = useR = false;
+
+			n = (useL) ? lhs.rows() : (useR) ? rhs.rows() : 0;
+			m = (useL) ? lhs.columns() : (useR) ? rhs.columns() : 0;
+		}
+
+		unsigned int rows() const { return n; }
+		unsigned int columns() const { return m; }
+
+		T at(unsigned int i, unsigned int j) const {
+
+			if (useL && useR)
+				return (Subtract) ? lhs.at(i, j) - rhs.at(i, j) : lhs.at(i, j) + rhs.at(i, j);
+			else if (useL)
+				return lhs.at(i, j);
+			else
+				return rhs.at(i, j);
+		}
+
+		T at(unsigned int k) const { return (Subtract) ? lhs.at(k) - rhs.at(k) : lhs.at(k) + rhs.at(k); }
+		bool complete() const { return useL && useR && lhs.complete() && rhs.complete(); }
+
+		void prepare() const { lhs.prepare(); rhs.prepare(); }
+		const T* buffer() const { return nullptr; }
+		bool references(const T *p) const { return lhs.references(p) || rhs.references(p); }
+
+		void store(T *C, const T& alpha, bool accumulate) const {
+
+			if (fused) {
+
+				matrix_expr_store_elements(*this, C, alpha, accumulate);
+
+			} else if (useL && useR) {
+
+				// evaluate each term directly into C so products are accumulated without temporaries
+				lhs.store(C, alpha, accumulate);
+				rhs.store(C, (Subtract) ? -alpha : alpha, true);
+
+			} else if (useL) {
+
+				lhs.store(C, alpha, accumulate);
+
+			} else if (useR) {
+
+				rhs.store(C, alpha, accumulate);
+			}
+		}
+	};
+
+
+	//
+	// kA
+	//
+
+	template <typename T, typename E>
+	struct matrix_scale : public matrix_expr<T, matrix_scale<T, E> > {
+
+		static const bool		pointwise = E::pointwise;
+		static const bool		fused = E::fused;
+
+		E						x;
+		T						k;
+
+		matrix_scale(const E& X, const T& k_) : x(X), k(k_) {}
+
+		unsigned int rows() const { return x.rows(); }
+		unsigned int columns() const { return x.columns(); }
+		T at(unsigned int i, unsigned int j) const { return k * x.at(i, j); }
+		T at(unsigned int p) const { return k * x.at(p); }
+		bool complete() const { return x.complete(); }
+		void prepare() const { x.prepare(); }
+		const T* buffer() const { return nullptr; }
+		bool references(const T *p) const { return x.references(p); }
+
+		void store(T *C, const T& alpha, bool accumulate) const {
+
+			x.store(C, alpha * k, accumulate);
+		}
+	};
+
+
+	//
+	// A^T
+	//
+
+	template <typename T, typename E>
+	struct matrix_transpose : public matrix_expr<T, matrix_transpose<T, E> > {
+
+		static const bool		pointwise = false;
+		static const bool		fused = E::fused;
+
+		E						x;
+
+		explicit matrix_transpose(const E& X) : x(X) {}
+
+		unsigned int rows() const { return x.columns(); }
+		unsigned int columns() const { return x.rows(); }
+		T at(unsigned int i, unsigned int j) const { return x.at(j, i); }
+		T at(unsigned int k) const { return at(k % x.columns(), k / x.columns()); }
+		bool complete() const { return true; }
+		void prepare() const { x.prepare(); }
+		const T* buffer() const { return nullptr; }
+		bool references(const T *p) const { return x.references(p); }
+
+		void store(T *C, const T& alpha, bool accumulate) const {
+
+			matrix_expr_store_elements(*this, C, alpha, accumulate);
+		}
+	};
+
+
+	//
+	// A | B (Rows = false) and A || B (Rows = true)
+	//
+
+	template <typename T, typename L, typename R, bool Rows>
+	struct matrix_concat : public matrix_expr<T, matrix_concat<T, L, R, Rows> > {
+
+		static const bool		pointwise = false;
+		static const bool		fused = L::fused && R::fused;
+
+		L						lhs;
+		R						rhs;
+		unsigned int			n, m;
+		unsigned int			split; // first row (Rows) or column (!Rows) taken from rhs
+
+		matrix_concat(const L& A, const R& B) : lhs(A), rhs(B) {
+
+			unsigned int ln = lhs.rows(), lm = lhs.columns();
+			unsigned int rn = rhs.rows(), rm = rhs.columns();
+
+			bool valid = (ln > 0 || rn > 0) && (ln == 0 || rn == 0 || ((Rows) ? lm == rm : ln == rn));
+
+			n = (!valid) ? 0 : (Rows) ? ln + rn : ((ln > 0) ? ln : rn);
+			m = (!valid) ? 0 : (Rows) ? ((lm > 0) ? lm : rm) : lm + rm;
+			split = (Rows) ? ln : lm;
+		}
+
+		unsigned int rows() const { return n; }
+		unsigned int columns() const { return m; }
+
+		T at(unsigned int i, unsigned int j) const {
+
+			if (Rows)
+				return (i < split) ? lhs.at(i, j) : rhs.at(i - split, j);
+			else
+				return (j < split) ? lhs.at(i, j) : rhs.at(i, j - split);
+		}
+
+		T at(unsigned int k) const { return at(k % n, k / n); }
+		bool complete() const { return true; }
+
+		void prepare() const { lhs.prepare(); rhs.prepare(); }
+		const T* buffer() const { return nullptr; }
+		bool references(const T *p) const { return lhs.references(p) || rhs.references(p); }
+
+		void store(T *C, const T& alpha, bool accumulate) const {
+
+			matrix_expr_store_elements(*this, C, alpha, accumulate);
+		}
+	};
+
+
+	//
+	// AB
+	//
+
+	template <typename T, typename L, typename R>
+	struct matrix_product : public matrix_expr<T, matrix_product<T, L, R> > {
+
+		static const bool		pointwise = false;
+		static const bool		fused = false;
+
+		L						lhs;
+		R						rhs;
+		unsigned int			n, m;
+		mutable matrix<T>		value; // evaluated product when element access is needed (see prepare)
+
+		matrix_product(const L& A, const R& B) : lhs(A), rhs(B) {
+
+			bool valid = lhs.rows() > 0 && rhs.rows() > 0 && lhs.columns() == rhs.rows();
+
+			n = (valid) ? lhs.rows() : 0;
+			m = (valid) ? rhs.columns() : 0;
+		}
+
+		unsigned int rows() const { return n; }
+		unsigned int columns() const { return m; }
+		T at(unsigned int i, unsigned int j) const { return value.data()[j*n + i]; }
+		T at(unsigned int k) const { return value.data()[k]; }
+		bool complete() const { return true; }
+
+		void prepare() const {
+
+			if (n > 0 && value.is_null()) {
+
+				matrix<T> P = matrix<T>(n, m);
+
+				if (!P.is_null()) {
+
+					store(P.data(), T(1), false);
+					value = std::move(P);
+				}
+			}
+		}
+
+		const T* buffer() const { return nullptr; }
+		bool references(const T *p) const { return lhs.references(p) || rhs.references(p); }
+
+		void store(T *C, const T& alpha, bool accumulate) const {
+
+			if (n == 0)
+				return;
+
+			if (!value.is_null()) {
+
+				matrix_expr_store_elements(*this, C, alpha, accumulate);
+				return;
+			}
+
+			// operands that are not plain matrices are evaluated into temporaries
+			matrix<T> tempA, tempB;
+
+			const T *Aptr = lhs.buffer();
+			const T *Bptr = rhs.buffer();
+
+			if (!Aptr) {
+
+				tempA = lhs;
+				Aptr = tempA.data();
+			}
+
+			if (!Bptr) {
+
+				tempB = rhs;
+				Bptr = tempB.data();
+			}
+
+			if (!Aptr || !Bptr)
+				return;
+
+			if (!accumulate)
+				std::fill(C, C + n*m, T(0));
+
+			matrix_kernel<T>::multiply_add(Aptr, Bptr, C, n, lhs.columns(), m, alpha);
+		}
+	};
+
+
+	//
+	// matrix<T> evaluation of expressions
+	//
+
+	template <typename T>
+	template <typename E>
+	matrix<T>::matrix(const matrix_expr<T, E>& X) : n(0), m(0), M(nullptr, ::free) {
+
+		*this = X;
+	}
+
+
+	template <typename T>
+	template <typename E>
+	matrix<T>& matrix<T>::operator=(const matrix_expr<T, E>& X_) {
+
+		const E& X = X_.expr();
+
+		unsigned int n_ = X.rows();
+		unsigned int m_ = X.columns();
+
+		if (n_ == 0 || m_ == 0) {
+
+			make_null();
+			return *this;
+		}
+
+		// evaluate directly into the existing buffer unless X reads it in a way evaluation would overwrite
+		if (n==n_ && m==m_ && M && (E::pointwise || !X.references(M.get()))) {
+
+			X.store(M.get(), T(1), false);
+			return *this;
+		}
+
+		auto buffer = (T*)malloc(n_ * m_ * sizeof(T));
+
+		if (!buffer) {
+
+			make_null();
+			return *this;
+		}
+
+		X.store(buffer, T(1), false);
+
+		n = n_;
+		m = m_;
+		M.reset(buffer);
+
+		return *this;
+	}
+
+
+	//
+	// expression construction
+	//
+
+	template <typename T>
+	matrix_leaf<T> lazy(const matrix<T>& A) { return matrix_leaf<T>(A); }
+
+	template <typename T>
+	void lazy(const matrix<T>&& A) = delete; // an expression must not refer to a temporary matrix
+
+
+	template <typename T, typename E>
+	matrix_transpose<T, E> transpose(const matrix_expr<T, E>& X) { return matrix_transpose<T, E>(X.expr()); }
+
+	template <typename T, typename E>
+	matrix_scale<T, E> operator-(const matrix_expr<T, E>& X) { return matrix_scale<T, E>(X.expr(), T(-1)); }
+
+	template <typename T, typename E>
+	matrix_scale<T, E> operator*(const matrix_expr<T, E>& X, const typename matrix_expr<T, E>::value_type& k) { return matrix_scale<T, E>(X.expr(), k); }
+
+	template <typename T, typename E>
+	matrix_scale<T, E> operator*(const typename matrix_expr<T, E>::value_type& k, const matrix_expr<T, E>& X) { return matrix_scale<T, E>(X.expr(), k); }
+
+
+	// A + B
+
+	template <typename T, typename L, typename R>
+	matrix_sum<T, L, R, false> operator+(const matrix_expr<T, L>& A, const matrix_expr<T, R>& B) { return matrix_sum<T, L, R, false>(A.expr(), B.expr()); }
+
+	template <typename T, typename L>
+	matrix_sum<T, L, matrix_leaf<T>, false> operator+(const matrix_expr<T, L>& A, const matrix<T>& B) { return matrix_sum<T, L, matrix_leaf<T>, false>(A.expr(), matrix_leaf<T>(B)); }
+
+	template <typename T, typename R>
+	matrix_sum<T, matrix_leaf<T>, R, false> operator+(const matrix<T>& A, const matrix_expr<T, R>& B) { return matrix_sum<T, matrix_leaf<T>, R, false>(matrix_leaf<T>(A), B.expr()); }
+
+
+	// A - B
+
+	template <typename T, typename L, typename R>
+	matrix_sum<T, L, R, true> operator-(const matrix_expr<T, L>& A, const matrix_expr<T, R>& B) { return matrix_sum<T, L, R, true>(A.expr(), B.expr()); }
+
+	template <typename T, typename L>
+	matrix_sum<T, L, matrix_leaf<T>, true> operator-(const matrix_expr<T, L>& A, const matrix<T>& B) { return matrix_sum<T, L, matrix_leaf<T>, true>(A.expr(), matrix_leaf<T>(B)); }
+
+	template <typename T, typename R>
+	matrix_sum<T, matrix_leaf<T>, R, true> operator-(const matrix<T>& A, const matrix_expr<T, R>& B) { return matrix_sum<T, matrix_leaf<T>, R, true>(matrix_leaf<T>(A), B.expr()); }
+
+
+	// AB
+
+	template <typename T, typename L, typename R>
+	matrix_product<T, L, R> operator*(const matrix_expr<T, L>& A, const matrix_expr<T, R>& B) { return matrix_product<T, L, R>(A.expr(), B.expr()); }
+
+	template <typename T, typename L>
+	matrix_product<T, L, matrix_leaf<T> > operator*(const matrix_expr<T, L>& A, const matrix<T>& B) { return matrix_product<T, L, matrix_leaf<T> >(A.expr(), matrix_leaf<T>(B)); }
+
+	template <typename T, typename R>
+	matrix_product<T, matrix_leaf<T>, R> operator*(const matrix<T>& A, const matrix_expr<T, R>& B) { return matrix_product<T, matrix_leaf<T>, R>(matrix_leaf<T>(A), B.expr()); }
+
+
+	// A | B
+
+	template <typename T, typename L, typename R>
+	matrix_concat<T, L, R, false> operator|(const matrix_expr<T, L>& A, const matrix_expr<T, R>& B) { return matrix_concat<T, L, R, false>(A.expr(), B.expr()); }
+
+	template <typename T, typename L>
+	matrix_concat<T, L, matrix_leaf<T>, false> operator|(const matrix_expr<T, L>& A, const matrix<T>& B) { return matrix_concat<T, L, matrix_leaf<T>, false>(A.expr(), matrix_leaf<T>(B)); }
+
+	template <typename T, typename R>
+	matrix_concat<T, matrix_leaf<T>, R, false> operator|(const matrix<T>& A, const matrix_expr<T, R>& B) { return matrix_concat<T, matrix_leaf<T>, R, false>(matrix_leaf<T>(A), B.expr()); }
+
+
+	// A || B
+
+	template <typename T, typename L, typename R>
+	matrix_concat<T, L, R, true> operator||(const matrix_expr<T, L>& A, const matrix_expr<T, R>& B) { return matrix_concat<T, L, R, true>(A.expr(), B.expr()); }
+
+	template <typename T, typename L>
+	matrix_concat<T, L, matrix_leaf<T>, true> operator||(const matrix_expr<T, L>& A, const matrix<T>& B) { return matrix_concat<T, L, matrix_leaf<T>, true>(A.expr(), matrix_leaf<T>(B)); }
+
+	template <typename T, typename R>
+	matrix_concat<T, matrix_leaf<T>, R, true> operator||(const matrix<T>& A, const matrix_expr<T, R>& B) { return matrix_concat<T, matrix_leaf<T>, R, true>(matrix_leaf<T>(A), B.expr()); }
+}
@@ -0,0 +1,813 @@
+﻿#pragma once
+
+#include "matrix_core.h"
+#include <cmath>
+#include <limits>
+
+
+/*
+
+fixed_matrix models an (N x M) real matrix whose order is fixed at compile time.  Elements are stored in column-major format in an array held inside the object so fixed_matrix never allocates memory, has no NULL state and needs no run-time order checks - mismatched orders fail to compile instead.  Loops run over compile-time bounds so the compiler unrolls and inlines them, and the determinant and inverse of 2x2, 3x3 and 4x4 matrices are evaluated in closed form.  Larger square matrices use LU decomposition with partial pivoting on a local copy.  Value semantics apply as for matrix<T> and fixed_matrix converts to and from matrix<T> so the general purpose linear systems functions of matrix<T> remain available.  fixed_matrix is a separate template rather than a specialisation of matrix<T> so the matrix<T> specialisations exported from CoreStructures.lib keep their names
+
+*/
+
+
+namespace CoreStructures {
+
+	//
+	// square matrix operations on column-major arrays (see fixed_matrix<>::det and fixed_matrix<>::inv).  2x2, 3x3 and 4x4 matrices are specialised with closed form solutions
+	//
+
+	// generic (N x N) case.  det() uses LU decomposition and inv() uses Gauss-Jordan elimination, both with partial pivoting on a local copy of a
+	template <typename T, unsigned int N>
+	struct fixed_matrix_square {
+
+		static T det(const T *a_) {
+
+			T a[N * N];
+			T d = T(1);
+
+			for (unsigned int k=0;k<N*N;k++)
+				a[k] = a_[k];
+
+			for (unsigned int j=0;j<N;j++) {
+
+				unsigned int p = j;
+
+				for (unsigned int i=j+1;i<N;i++)
+					if (std::abs(a[j*N + i]) > std::abs(a[j*N + p]))
+						p = i;
+
+				if (tequal<T>(a[j*N + p], T(0), matrix<T>::precision))
+					return T(0);
+
+				if (p != j) {
+
+					for (unsigned int k=j;k<N;k++)
+						std::swap(a[k*N + j], a[k*N + p]);
+
+					d = -d;
+				}
+
+				T pivot = a[j*N + j];
+				d *= pivot;
+
+				for (unsigned int i=j+1;i<N;i++) {
+
+					T l = a[j*N + i] / pivot;
+
+					for (unsigned int k=j+1;k<N;k++)
+						a[k*N + i] -= l * a[k*N + j];
+				}
+			}
+
+			return d;
+		}
+
+		// write the inverse of a into r and return det(a).  r is undefined if a is singular (det(a) = 0)
+		static T inv(const T *a_, T *r) {
+
+			T a[N * N];
+			T d = T(1);
+
+			for (unsigned int k=0;k<N*N;k++) {
+
+				a[k] = a_[k];
+				r[k] = T(0);
+			}
+
+			for (unsigned int k=0;k<N;k++)
+				r[k*N + k] = T(1);
+
+			for (unsigned int j=0;j<N;j++) {
+
+				unsigned int p = j;
+
+				for (unsigned int i=j+1;i<N;i++)
+					if (std::abs(a[j*N + i]) > std::abs(a[j*N + p]))
+						p = i;
+
+				if (tequal<T>(a[j*N + p], T(0), matrix<T>::precision))
+					return T(0);
+
+				if (p != j) {
+
+					for (unsigned int k=0;k<N;k++) {
+
+						std::swap(a[k*N + j], a[k*N + p]);
+						std::swap(r[k*N + j], r[k*N + p]);
+					}
+
+					d = -d;
+				}
+
+				T pivot = a[j*N + j];
+				T s = T(1) / pivot;
+
+				d *= pivot;
+
+				for (unsigned int k=0;k<N;k++) {
+
+					a[k*N + j] *= s;
+					r[k*N + j] *= s;
+				}
+
+				// eliminate column j from every other row
+				for (unsigned int i=0;i<N;i++) {
+
+					if (i == j)
+						continue;
+
+					T l = a[j*N + i];
+
+					for (unsigned int k=0;k<N;k++) {
+
+						a[k*N + i] -= l * a[k*N + j];
+						r[k*N + i] -= l * r[k*N + j];
+					}
+				}
+			}
+
+			return d;
+		}
+	};
+
+	template <typename T>
+	struct fixed_matrix_square<T, 1> {
+
+		static T det(const T *a) {
+
+			return a[0];
+		}
+
+		static T inv(const T *a, T *r) {
+
+			if (!tequal<T>(a[0], T(0), matrix<T>::precision))
+				r[0] = T(1) / a[0];
+
+			return a[0];
+		}
+	};
+
+	template <typename T>
+	struct fixed_matrix_square<T, 2> {
+
+		static T det(const T *a) {
+
+			return a[0]*a[3] - a[2]*a[1];
+		}
+
+		static T inv(const T *a, T *r) {
+
+			T d = det(a);
+
+			if (!tequal<T>(d, T(0), matrix<T>::precision)) {
+
+				T s = T(1) / d;
+
+				r[0] = a[3] * s;
+				r[1] = -a[1] * s;
+				r[2] = -a[2] * s;
+				r[3] = a[0] * s;
+			}
+
+			return d;
+		}
+	};
+
+	template <typename T>
+	struct fixed_matrix_square<T, 3> {
+
+		static T det(const T *a) {
+
+			return a[0]*(a[4]*a[8] - a[7]*a[5]) - a[3]*(a[1]*a[8] - a[7]*a[2]) + a[6]*(a[1]*a[5] - a[4]*a[2]);
+		}
+
+		// adjugate / det
+		static T inv(const T *a, T *r) {
+
+			T c0 = a[4]*a[8] - a[7]*a[5];
+			T c1 = a[7]*a[2] - a[1]*a[8];
+			T c2 = a[1]*a[5] - a[4]*a[2];
+
+			T d = a[0]*c0 + a[3]*c1 + a[6]*c2;
+
+			if (!tequal<T>(d, T(0), matrix<T>::precision)) {
+
+				T s = T(1) / d;
+
+				r[0] = c0 * s;
+				r[1] = c1 * s;
+				r[2] = c2 * s;
+				r[3] = (a[6]*a[5] - a[3]*a[8]) * s;
+				r[4] = (a[0]*a[8] - a[6]*a[2]) * s;
+				r[5] = (a[3]*a[2] - a[0]*a[5]) * s;
+				r[6] = (a[3]*a[7] - a[6]*a[4]) * s;
+				r[7] = (a[6]*a[1] - a[0]*a[7]) * s;
+				r[8] = (a[0]*a[4] - a[3]*a[1]) * s;
+			}
+
+			return d;
+		}
+	};
+
+	template <typename T>
+	struct fixed_matrix_square<T, 4> {
+
+		// Laplace expansion over the 2x2 minors of the first two columns and the last two columns
+		static T det(const T *a) {
+
+			T s0 = a[0]*a[5] - a[1]*a[4];
+			T s1 = a[0]*a[6] - a[2]*a[4];
+			T s2 = a[0]*a[7] - a[3]*a[4];
+			T s3 = a[1]*a[6] - a[2]*a[5];
+			T s4 = a[1]*a[7] - a[3]*a[5];
+			T s5 = a[2]*a[7] - a[3]*a[6];
+
+			T c5 = a[10]*a[15] - a[11]*a[14];
+			T c4 = a[9]*a[15] - a[11]*a[13];
+			T c3 = a[9]*a[14] - a[10]*a[13];
+			T c2 = a[8]*a[15] - a[11]*a[12];
+			T c1 = a[8]*a[14] - a[10]*a[12];
+			T c0 = a[8]*a[13] - a[9]*a[12];
+
+			return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+		}
+
+		static T inv(const T *a, T *r) {
+
+			T s0 = a[0]*a[5] - a[1]*a[4];
+			T s1 = a[0]*a[6] - a[2]*a[4];
+			T s2 = a[0]*a[7] - a[3]*a[4];
+			T s3 = a[1]*a[6] - a[2]*a[5];
+			T s4 = a[1]*a[7] - a[3]*a[5];
+			T s5 = a[2]*a[7] - a[3]*a[6];
+
+			T c5 = a[10]*a[15] - a[11]*a[14];
+			T c4 = a[9]*a[15] - a[11]*a[13];
+			T c3 = a[9]*a[14] - a[10]*a[13];
+			T c2 = a[8]*a[15] - a[11]*a[12];
+			T c1 = a[8]*a[14] - a[10]*a[12];
+			T c0 = a[8]*a[13] - a[9]*a[12];
+
+			T d = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+
+			if (!tequal<T>(d, T(0), matrix<T>::precision)) {
+
+				T s = T(1) / d;
+
+				r[0] = (a[5]*c5 - a[6]*c4 + a[7]*c3) * s;
+				r[1] = (-a[1]*c5 + a[2]*c4 - a[3]*c3) * s;
+				r[2] = (a[13]*s5 - a[14]*s4 + a[15]*s3) * s;
+				r[3] = (-a[9]*s5 + a[10]*s4 - a[11]*s3) * s;
+
+				r[4] = (-a[4]*c5 + a[6]*c2 - a[7]*c1) * s;
+				r[5] = (a[0]*c5 - a[2]*c2 + a[3]*c1) * s;
+				r[6] = (-a[12]*s5 + a[14]*s2 - a[15]*s1) * s;
+				r[7] = (a[8]*s5 - a[10]*s2 + a[11]*s1) * s;
+
+				r[8] = (a[4]*c4 - a[5]*c2 + a[7]*c0) * s;
+				r[9] = (-a[0]*c4 + a[1]*c2 - a[3]*c0) * s;
+				r[10] = (a[12]*s4 - a[13]*s2 + a[15]*s0) * s;
+				r[11] = (-a[8]*s4 + a[9]*s2 - a[11]*s0) * s;
+
+				r[12] = (-a[4]*c3 + a[5]*c1 - a[6]*c0) * s;
+				r[13] = (a[0]*c3 - a[1]*c1 + a[2]*c0) * s;
+				r[14] = (-a[12]*s3 + a[13]*s1 - a[14]*s0) * s;
+				r[15] = (a[8]*s3 - a[9]*s1 + a[10]*s0) * s;
+			}
+
+			return d;
+		}
+	};
+
+
+	// cyclic Jacobi limits for fixed_matrix::symmetric_eigen and fixed_symmetric_eigen_batch.  Small matrices converge quadratically so a 3x3 matrix needs 3-5 sweeps in double precision
+	enum fixed_matrix_eigen_limits {
+
+		fixed_matrix_jacobi_sweeps = 16,
+		fixed_matrix_jacobi_lanes = 8,
+		fixed_matrix_eigen_batch_size = 1024
+	};
+
+
+	// cyclic Jacobi eigen-decomposition (Golub & Van Loan sec 8.5.2) of L symmetric (N x N) matrices stored with their elements interleaved, so element (i, j) of matrix l is a[(j*N + i)*L + l].  Each rotation is computed for every lane in a loop with no data-dependent branches, which keeps the lanes in step and lets the compiler vectorise across them.  Sweeps continue until every lane has converged.  On return the diagonal of a holds the eigenvalues of each lane in ascending order and v holds the corresponding eigenvectors in its columns
+	template <typename T, unsigned int N, unsigned int L>
+	struct fixed_matrix_jacobi {
+
+		static unsigned int solve(T *a, T *v) {
+
+			const T eps2 = std::numeric_limits<T>::epsilon() * std::numeric_limits<T>::epsilon();
+			T norm2[L];
+
+			for (unsigned int l=0;l<L;l++)
+				norm2[l] = T(0);
+
+			for (unsigned int j=0;j<N;j++) {
+
+				for (unsigned int i=0;i<N;i++) {
+
+					for (unsigned int l=0;l<L;l++) {
+
+						norm2[l] += a[(j*N + i)*L + l] * a[(j*N + i)*L + l];
+						v[(j*N + i)*L + l] = (i==j) ? T(1) : T(0);
+					}
+				}
+			}
+
+			unsigned int sweep = 0;
+
+			for (; sweep<fixed_matrix_jacobi_sweeps; sweep++) {
+
+				bool converged = true;
+
+				for (unsigned int l=0;l<L;l++) {
+
+					T off2 = T(0);
+
+					for (unsigned int q=1;q<N;q++)
+						for (unsigned int p=0;p<q;p++)
+							off2 += a[(q*N + p)*L + l] * a[(q*N + p)*L + l];
+
+					converged = converged && (off2 <= eps2 * norm2[l]);
+				}
+
+				if (converged)
+					break;
+
+				// one rotation per off-diagonal element annihilating a(pq)
+				for (unsigned int q=1;q<N;q++) {
+
+					for (unsigned int p=0;p<q;p++) {
+
+						T c[L], s[L];
+
+						for (unsigned int l=0;l<L;l++) {
+
+							T apq = a[(q*N + p)*L + l];
+							T theta = (a[(q*N + q)*L + l] - a[(p*N + p)*L + l]) / (T(2) * ((apq != T(0)) ? apq : T(1)));
+							T t = T(1) / (std::abs(theta) + std::sqrt(theta * theta + T(1)));
+
+							t = (apq != T(0)) ? ((theta < T(0)) ? -t : t) : T(0);
+
+							c[l] = T(1) / std::sqrt(t * t + T(1));
+							s[l] = t * c[l];
+						}
+
+						// A = J^T A J and V = VJ
+						for (unsigned int k=0;k<N;k++) {
+
+							for (unsigned int l=0;l<L;l++) {
+
+								T akp = a[(p*N + k)*L + l];
+								T akq = a[(q*N + k)*L + l];
+
+								a[(p*N + k)*L + l] = c[l] * akp - s[l] * akq;
+								a[(q*N + k)*L + l] = s[l] * akp + c[l] * akq;
+							}
+						}
+
+						for (unsigned int k=0;k<N;k++) {
+
+							for (unsigned int l=0;l<L;l++) {
+
+								T apk = a[(k*N + p)*L + l];
+								T aqk = a[(k*N + q)*L + l];
+
+								a[(k*N + p)*L + l] = c[l] * apk - s[l] * aqk;
+								a[(k*N + q)*L + l] = s[l] * apk + c[l] * aqk;
+							}
+						}
+
+						for (unsigned int k=0;k<N;k++) {
+
+							for (unsigned int l=0;l<L;l++) {
+
+								T vkp = v[(p*N + k)*L + l];
+								T vkq = v[(q*N + k)*L + l];
+
+								v[(p*N + k)*L + l] = c[l] * vkp - s[l] * vkq;
+								v[(q*N + k)*L + l] = s[l] * vkp + c[l] * vkq;
+							}
+						}
+					}
+				}
+			}
+
+			// sort each lane into ascending order
+			for (unsigned int l=0;l<L;l++) {
+
+				for (unsigned int i=0;i+1<N;i++) {
+
+					unsigned int k = i;
+
+					for (unsigned int j=i+1;j<N;j++)
+						if (a[(j*N + j)*L + l] < a[(k*N + k)*L + l])
+							k = j;
+
+					if (k != i) {
+
+						std::swap(a[(i*N + i)*L + l], a[(k*N + k)*L + l]);
+
+						for (unsigned int r=0;r<N;r++)
+							std::swap(v[(i*N + r)*L + l], v[(k*N + r)*L + l]);
+					}
+				}
+			}
+
+			return sweep;
+		}
+	};
+
+
+	//
+	// fixed_matrix<> declaration
+	//
+
+	template <typename T, unsigned int N, unsigned int M>
+	struct fixed_matrix {
+
+		static_assert(N > 0 && M > 0, "fixed_matrix order must be at least (1 x 1)");
+
+		enum { order_n = N, order_m = M }; // matrix order as compile-time constants
+
+		T						e[N * M]; // column-major elements (a(ij) = e[(j-1)*N + (i-1)])
+
+
+		//
+		// static interface
+		//
+
+		static fixed_matrix zeromatrix() {
+
+			fixed_matrix A;
+
+			for (unsigned int k=0;k<N*M;k++)
+				A.e[k] = T(0);
+
+			return A;
+		}
+
+		static fixed_matrix identity() {
+
+			static_assert(N == M, "identity matrix must be square");
+
+			fixed_matrix A = zeromatrix();
+
+			for (unsigned int k=0;k<N;k++)
+				A.e[k*N + k] = T(1);
+
+			return A;
+		}
+
+
+		// constructors
+
+		fixed_matrix() {} // elements are not initialised (use zeromatrix() or identity())
+
+		explicit fixed_matrix(const T* data) { // copy N x M values from data (column-major)
+
+			for (unsigned int k=0;k<N*M;k++)
+				e[k] = data[k];
+		}
+
+		explicit fixed_matrix(const matrix<T>& A) { // copy from A.  If A is a NULL matrix or A is not of order (N x M) then a zero matrix is returned
+
+			bool valid = (A.rows()==N && A.columns()==M);
+
+			for (unsigned int j=0;j<M;j++)
+				for (unsigned int i=0;i<N;i++)
+					e[j*N + i] = (valid) ? A(i+1, j+1) : T(0);
+		}
+
+
+		// accessor methods
+
+		static unsigned int rows() { return N; }
+
+		static unsigned int columns() { return M; }
+
+		T& operator()(unsigned int i, unsigned int j) { return e[(j-1)*N + (i-1)]; } // indices are not zero-indexed to conform to matrix<T>
+
+		T operator()(unsigned int i, unsigned int j) const { return e[(j-1)*N + (i-1)]; }
+
+		matrix<T> to_matrix() const { return matrix<T>(N, M, (const T*)e); } // return a dynamic (heap allocated) copy
+
+
+		// unary operators
+
+		fixed_matrix operator-() const {
+
+			fixed_matrix A;
+
+			for (unsigned int k=0;k<N*M;k++)
+				A.e[k] = -e[k];
+
+			return A;
+		}
+
+		fixed_matrix<T, M, N> transpose() const {
+
+			fixed_matrix<T, M, N> A;
+
+			for (unsigned int j=0;j<M;j++)
+				for (unsigned int i=0;i<N;i++)
+					A.e[i*M + j] = e[j*N + i];
+
+			return A;
+		}
+
+		T trace() const {
+
+			static_assert(N == M, "trace requires a square matrix");
+
+			T t = T(0);
+
+			for (unsigned int k=0;k<N;k++)
+				t += e[k*N + k];
+
+			return t;
+		}
+
+		T det() const; // return the determinant of the given square matrix (closed form for N <= 4, otherwise LU decomposition with partial pivoting)
+
+		fixed_matrix inv(bool *invertible = nullptr) const; // return the inverse of the given square matrix.  If the matrix is singular (as determined by tequal<T>(det, T(0), matrix<T>::precision)) a zero matrix is returned and *invertible (if not nullptr) is set to false
+
+		template <unsigned int P>
+		fixed_matrix<T, N, P> solve(const fixed_matrix<T, N, P>& B, bool *solved = nullptr) const; // solve AX = B for X where A is the given square matrix using Gaussian elimination with partial pivoting.  If A is singular a zero matrix is returned and *solved (if not nullptr) is set to false
+
+		unsigned int symmetric_eigen(fixed_matrix<T, N, 1> *values, fixed_matrix *V) const; // return the eigenvalues (in ascending order) and the corresponding orthonormal eigenvectors (in the columns of *V) of the given real symmetric matrix using the cyclic Jacobi method.  Only the lower triangle is read.  Returns the number of sweeps performed (at most fixed_matrix_jacobi_sweeps)
+
+
+		// binary operators
+
+		bool operator==(const fixed_matrix& B) const {
+
+			bool equal = true;
+
+			for (unsigned int k=0;k<N*M && equal;k++)
+				equal = tequal<T>(e[k], B.e[k], matrix<T>::precision);
+
+			return equal;
+		}
+
+		fixed_matrix operator+(const fixed_matrix& B) const {
+
+			fixed_matrix A;
+
+			for (unsigned int k=0;k<N*M;k++)
+				A.e[k] = e[k] + B.e[k];
+
+			return A;
+		}
+
+		fixed_matrix& operator+=(const fixed_matrix& B) {
+
+			for (unsigned int k=0;k<N*M;k++)
+				e[k] += B.e[k];
+
+			return *this;
+		}
+
+		fixed_matrix operator-(const fixed_matrix& B) const {
+
+			fixed_matrix A;
+
+			for (unsigned int k=0;k<N*M;k++)
+				A.e[k] = e[k] - B.e[k];
+
+			return A;
+		}
+
+		fixed_matrix& operator-=(const fixed_matrix& B) {
+
+			for (unsigned int k=0;k<N*M;k++)
+				e[k] -= B.e[k];
+
+			return *this;
+		}
+
+		fixed_matrix operator*(T k) const { // scalar multiplication
+
+			fixed_matrix A;
+
+			for (unsigned int p=0;p<N*M;p++)
+				A.e[p] = e[p] * k;
+
+			return A;
+		}
+
+		fixed_matrix& operator*=(T k) {
+
+			for (unsigned int p=0;p<N*M;p++)
+				e[p] *= k;
+
+			return *this;
+		}
+
+		template <unsigned int P>
+		fixed_matrix<T, N, P> operator*(const fixed_matrix<T, M, P>& B) const { // post-multiply the given matrix with B
+
+			fixed_matrix<T, N, P> C;
+
+			for (unsigned int j=0;j<P;j++) {
+
+				// column j of C is a linear combination of the columns of A
+				for (unsigned int i=0;i<N;i++)
+					C.e[j*N + i] = e[i] * B.e[j*M];
+
+				for (unsigned int k=1;k<M;k++) {
+
+					T b = B.e[j*M + k];
+
+					for (unsigned int i=0;i<N;i++)
+						C.e[j*N + i] += e[k*N + i] * b;
+				}
+			}
+
+			return C;
+		}
+
+		fixed_matrix& operator*=(const fixed_matrix<T, M, M>& B) {
+
+			*this = (*this) * B;
+			return *this;
+		}
+	};
+
+
+	//
+	// fixed_matrix<> implementation
+	//
+
+	template <typename T, unsigned int N, unsigned int M>
+	T fixed_matrix<T, N, M>::det() const {
+
+		static_assert(N == M, "determinant requires a square matrix");
+
+		return fixed_matrix_square<T, N>::det(e);
+	}
+
+
+	template <typename T, unsigned int N, unsigned int M>
+	fixed_matrix<T, N, M> fixed_matrix<T, N, M>::inv(bool *invertible) const {
+
+		static_assert(N == M, "inverse requires a square matrix");
+
+		fixed_matrix R;
+
+		bool valid = !tequal<T>(fixed_matrix_square<T, N>::inv(e, R.e), T(0), matrix<T>::precision);
+
+		if (invertible)
+			*invertible = valid;
+
+		return (valid) ? R : zeromatrix();
+	}
+
+
+	template <typename T, unsigned int N, unsigned int M>
+	template <unsigned int P>
+	fixed_matrix<T, N, P> fixed_matrix<T, N, M>::solve(const fixed_matrix<T, N, P>& B, bool *solved) const {
+
+		static_assert(N == M, "solve requires a square coefficient matrix");
+
+		T a[N * N];
+		fixed_matrix<T, N, P> X = B;
+
+		for (unsigned int k=0;k<N*N;k++)
+			a[k] = e[k];
+
+		// forward elimination with partial pivoting applied to [A | B]
+		for (unsigned int j=0;j<N;j++) {
+
+			unsigned int p = j;
+
+			for (unsigned int i=j+1;i<N;i++)
+				if (std::abs(a[j*N + i]) > std::abs(a[j*N + p]))
+					p = i;
+
+			if (tequal<T>(a[j*N + p], T(0), matrix<T>::precision)) {
+
+				if (solved)
+					*solved = false;
+
+				return fixed_matrix<T, N, P>::zeromatrix();
+			}
+
+			if (p != j) {
+
+				for (unsigned int k=j;k<N;k++)
+					std::swap(a[k*N + j], a[k*N + p]);
+
+				for (unsigned int k=0;k<P;k++)
+					std::swap(X.e[k*N + j], X.e[k*N + p]);
+			}
+
+			T pivot = a[j*N + j];
+
+			for (unsigned int i=j+1;i<N;i++) {
+
+				T l = a[j*N + i] / pivot;
+
+				for (unsigned int k=j+1;k<N;k++)
+					a[k*N + i] -= l * a[k*N + j];
+
+				for (unsigned int k=0;k<P;k++)
+					X.e[k*N + i] -= l * X.e[k*N + j];
+			}
+		}
+
+		// back substitution
+		for (unsigned int k=0;k<P;k++) {
+
+			for (unsigned int i=N;i-->0;) {
+
+				T x = X.e[k*N + i];
+
+				for (unsigned int c=i+1;c<N;c++)
+					x -= a[c*N + i] * X.e[k*N + c];
+
+				X.e[k*N + i] = x / a[i*N + i];
+			}
+		}
+
+		if (solved)
+			*solved = true;
+
+		return X;
+	}
+
+
+	template <typename T, unsigned int N, unsigned int M>
+	unsigned int fixed_matrix<T, N, M>::symmetric_eigen(fixed_matrix<T, N, 1> *values, fixed_matrix *V) const {
+
+		static_assert(N == M, "eigen-decomposition requires a square matrix");
+
+		T a[N * N];
+
+		// symmetric copy of the lower triangle
+		for (unsigned int j=0;j<N;j++)
+			for (unsigned int i=j;i<N;i++)
+				a[j*N + i] = a[i*N + j] = e[j*N + i];
+
+		unsigned int sweeps = fixed_matrix_jacobi<T, N, 1>::solve(a, V->e);
+
+		for (unsigned int i=0;i<N;i++)
+			values->e[i] = a[i*N + i];
+
+		return sweeps;
+	}
+
+
+	// eigen-decompose count symmetric matrices A[0..count-1] (for example inertia tensors or the covariance matrices of point sets for oriented bounding boxes) with the cyclic Jacobi method as fixed_matrix::symmetric_eigen.  Eigenvalues are returned in values[0..count-1] and eigenvectors in V[0..count-1].  Matrices are solved fixed_matrix_jacobi_lanes at a time with their elements interleaved so the rotations of each lane are independent and can be vectorised, and the batch is split into blocks of fixed_matrix_eigen_batch_size matrices that are run through matrix_parallel_for
+	template <typename T, unsigned int N>
+	void fixed_symmetric_eigen_batch(const fixed_matrix<T, N, N> *A, fixed_matrix<T, N, 1> *values, fixed_matrix<T, N, N> *V, unsigned int count) {
+
+		const unsigned int L = fixed_matrix_jacobi_lanes;
+
+		matrix_parallel_for(count, fixed_matrix_eigen_batch_size, [=](unsigned int begin, unsigned int end) {
+
+			T a[N * N * L];
+			T v[N * N * L];
+
+			for (unsigned int k0=begin; k0<end; k0+=L) {
+
+				const unsigned int lanes = std::min<unsigned int>(L, end - k0);
+
+				// interleave the lower triangles of the next L matrices.  Unused lanes are set to the identity and converge immediately
+				for (unsigned int j=0;j<N;j++) {
+
+					for (unsigned int i=j;i<N;i++) {
+
+						for (unsigned int l=0;l<L;l++) {
+
+							T x = (l < lanes) ? A[k0 + l].e[j*N + i] : ((i==j) ? T(1) : T(0));
+
+							a[(j*N + i)*L + l] = x;
+							a[(i*N + j)*L + l] = x;
+						}
+					}
+				}
+
+				fixed_matrix_jacobi<T, N, L>::solve(a, v);
+
+				for (unsigned int l=0;l<lanes;l++) {
+
+					for (unsigned int i=0;i<N;i++)
+						values[k0 + l].e[i] = a[(i*N + i)*L + l];
+
+					for (unsigned int k=0;k<N*N;k++)
+						V[k0 + l].e[k] = v[k*L + l];
+				}
+			}
+		});
+	}
+
+
+	// common fixed-size types
+
+	typedef fixed_matrix<float, 3, 3>		fixed_matrix3f;
+	typedef fixed_matrix<float, 4, 4>		fixed_matrix4f;
+	typedef fixed_matrix<double, 3, 3>		fixed_matrix3d;
+	typedef fixed_matrix<double, 4, 4>		fixed_matrix4d;
+}
@@ -48,6 +48,9 @@ namespace CoreStructures {
 	template <typename T>
 	struct matrix;
 
+	template <typename T, typename E>
+	struct matrix_expr;
+
 
 	// model auxiliary data for a given linear system AX = B where X and B are assumed to represent column vectors
 	template<typename T>
@@ -161,6 +164,9 @@ namespace CoreStructures {
 		matrix(const matrix& A); // copy constructor.  A NULL matrix is returned if the required matrix cannot be copied or A is a NULL matrix
 
 		matrix(matrix&& A); // move constructor
+
+		template <typename E>
+		matrix(const matrix_expr<T, E>& X); // evaluate the matrix expression X (see matrix_expr.h).  A NULL matrix is returned if X evaluates to a NULL matrix or the matrix cannot be created
 		
 
 		// accessor methods
@@ -207,6 +213,10 @@ namespace CoreStructures {
 		
 		T operator()(unsigned int i, unsigned int j) const; // return matrix element aij.  The matrix is assumed to be valid and ij are valid element indices
 
+		T* data(); // return a pointer to the matrix elements in column-major format or nullptr if the matrix is NULL
+
+		const T* data() const;
+
 
 
 		matrix<T> row(unsigned int i) const; // return row i of the given matrix as a (1 x m) row vector.  A NULL matrix is returned if the given matrix is null, i is not a valid row index or the row vector cannot be created
@@ -236,9 +246,9 @@ namespace CoreStructures {
 
 		matrix<T> operator^(const int i) const;  // return the given -square- matrix (A) raised to the integer power i.  If i<-1 or A is not a square matrix then a NULL matrix is returned.  If i=-1 then the inverse of A is returned if A is non-singular, otherwise a NULL matrix is returned.  This calls inv() and is defined for syntactic convinience only, allowing statements such as Ainv = A^-1 as well as Ainv = A.inv().  If i=0 then an (n x n) identity matrix is returned, if i=1 then A is returned and if i>1 then A^i is returned.  Care must be taken when considering operator precedence: ^ is by default the bitwise OR operator and has a lower precedence than *, so expressions like A * A^-1 = (A * A)^-1.  Parenthesis should be used around ^ to force precedence ie. A * (A^-1)
 		
-		matrix<T> inv() const;  // return the inverse matrix if non-singular, otherwise return a NULL matrix
+		matrix<T> inv() const;  // return the inverse matrix if non-singular, otherwise return a NULL matrix.  Matrices of order matrix_lu_blocked_threshold or more are inverted by LUP decomposition, smaller matrices by Gauss-Jordan elimination
 
-		T det() const; // return the determinant of the given matrix (A) using Doolittle LUP decomposition.  If the given matrix is NULL or not a square matrix then T(0) is returned
+		T det() const; // return the determinant of the given matrix (A) using LUP decomposition (Doolittle's method, or the blocked decomposition if n >= matrix_lu_blocked_threshold).  If the given matrix is NULL or not a square matrix then T(0) is returned
 
 		T norm(gu_norm_type t = gu_norm_frobenius) const; // return the matrix norm (default to the Frobenius norm), otherwise return T(0) if the given matrix is a NULL matrix
 
@@ -249,16 +259,21 @@ namespace CoreStructures {
 
 		// binary operators
 
-		matrix<T> &operator=(const matrix<T>& A); // copy assign - set the given matrix to equal A.  If the matrix copy cannot be created a NULL matrix is returned
+		matrix<T> &operator=(const matrix<T>& A); // copy assign - set the given matrix to equal A.  The existing buffer is reused if the orders match.  If the matrix copy cannot be created a NULL matrix is returned
 
 		matrix<T> &operator=(matrix<T>&& A); // move assign
 
+		template <typename E>
+		matrix<T> &operator=(const matrix_expr<T, E>& X); // evaluate the matrix expression X into the given matrix.  The existing buffer is reused if the orders match and X does not depend on the given matrix in a way that would be overwritten during evaluation
+
 		bool operator==(const matrix<T>& B); // return true if the given matrix equals B (as determined by tequal<T>, otherwise return false.  If both matrices is NULL then true is returned
 
 		matrix<T> operator+(const matrix<T>& B) const; // return the given matrix added to B.  A NULL matrix is returned if the resulting matrix cannot be created.  Additive rules - let 0 denote a NULL matrix, x denote matrices of order (x1, x2) and y denote matrices of order (y1, y2) where (x1, x2) != (y1, y2): (x + 0 = x); (0 + x = x); (0 + 0 = 0); (x + y = 0)
-		matrix<T>& operator+=(const matrix<T>& B);
+		matrix<T> operator+(matrix<T>&& B) const; // as above but the result is accumulated in B's buffer (no allocation) when the orders match
+		matrix<T>& operator+=(const matrix<T>& B); // add B in-place
 
 		matrix<T> operator-(const matrix<T>& B) const;
+		matrix<T> operator-(matrix<T>&& B) const;
 		matrix<T>& operator-=(const matrix<T>& B);
 
 		matrix<T> operator*(T k) const; // scalar multiplication
@@ -331,13 +346,17 @@ namespace CoreStructures {
 		
 		gu_lu_decomp_state lup_decomposition_doolittle(std::vector<unsigned int> *permutationVector, T *parity);  // for the given square matrix (A), derive the LUP decomposition of A so that PA = LU using Doolittle's method (see Lengyel p.426).  Return gu_lu_okay if A is invertible and the decomposition was successful, otherwise return gu_lu_fail_singular.  If gu_lu_fail_singular is returned, A (and permutationVector if given) are left in an indeterminate state since the LUP decomposition is performed in-place.  permuationVector is assumed to be a vector of order (n) into which the row exchange permutations will be stored.  permuationVector is also assumed to be initialised to P[i-1] = i : 1<=i<=n.  The row exchange parity is be stored in *parity.  permutationVector and parity are optional since they are not needed for all applications of the LUP decomposition so it is left to the calling function to determine the need for these structures and perform the relevant initialisation of permutationVector.  For example, the determinant calculation does not use the permutationVector but LU-based linear solvers do
 
+		gu_lu_decomp_state lup_decomposition_blocked(std::vector<unsigned int> *permutationVector, T *parity);  // blocked right-looking version of lup_decomposition_doolittle with the same pre- and post-conditions.  Panels of columns are factorised with partial pivoting and the trailing submatrix is updated by matrix multiplication, split into column blocks that are run through matrix_parallel_for (see matrix_kernels.h).  Faster than lup_decomposition_doolittle once A no longer fits in cache
+
+		gu_lu_decomp_state lup_decomposition(std::vector<unsigned int> *permutationVector, T *parity);  // call lup_decomposition_doolittle if n < matrix_lu_blocked_threshold, otherwise call lup_decomposition_blocked
+
 	public:
 
 		gu_lu_decomp_state lup_decomp(matrix<T> *D, std::vector<unsigned int> *P) const; // return the LUP decomposition of the given matrix (A) where [P]A = LU.  Return gu_lu_okay if A is a square invertible matrix and the decomposition was successful, gu_lu_fail_error if the decomposition cannot be created, otherwise return gu_lu_fail_singular.  If successful, D contains the combined LU representation (see Lengyel p.426) and P contains the permutation vector (which needs to be subsequently transformed into a permutation matrix)
 
 		gu_lu_decomp_state lup_decomp(matrix<T> *L, matrix<T> *U, matrix<T> *P) const; // return the LUP decomposition of the given matrix (A) where PA = LU.  Return gu_lu_okay if A is a square invertible matrix and the decomposition was successful, gu_lu_fail_error if the decomposition cannot be created, otherwise return gu_lu_fail_singular
 
-		friend matrix<T> lup_solve<>(const matrix<T>& D, const std::vector<unsigned int>& P, const matrix<T>& B); // lup_solve performs forward and backward substitution on the given LUP decomposition (D), where D represents the combined LU matrices (Lengyel p.425) and P represents the row permutation vector, to solve ([P]A)x = (LU)x = [P]B.  It is assumed the order of P = (D.n x 1).  B represents the known constant vector and is assumed to be of the order (D.n x 1).  The function returns the column vector x of the order (D.n x 1) which represents the solution to the system.  Given D represents the LU decomposition of a given matrix (A), it is assumed the solution vector x exists and is unique given the pre-conditions for LUP factorisation (see above)
+		friend matrix<T> lup_solve<>(const matrix<T>& D, const std::vector<unsigned int>& P, const matrix<T>& B); // lup_solve performs forward and backward substitution on the given LUP decomposition (D), where D represents the combined LU matrices (Lengyel p.425) and P represents the row permutation vector, to solve ([P]A)x = (LU)x = [P]B.  It is assumed the order of P = (D.n x 1).  B represents the known constant vector and is assumed to be of the order (D.n x k).  The function returns x of the order (D.n x k) where each column of x represents the solution for the corresponding column of B (the complex<float> specialisation solves the first column of B only).  Columns are solved in parallel through matrix_parallel_for.  Given D represents the LU decomposition of a given matrix (A), it is assumed the solution vector x exists and is unique given the pre-conditions for LUP factorisation (see above)
 
 
 		// Cholesky decomposition
@@ -364,13 +383,21 @@ namespace CoreStructures {
 
 		bool tqli(std::vector<T>* d, std::vector<T>* e); // QL decomposition to calculate the eigenvalues and eigenvectors for a given real, square, symmetric, tri-diagonal matrix.  <d, e> represent the tri-diagonal matrix, where d[0..n-1] represents the elements of the leading diagonal and e[1..n-1] (e[0] is not used) represents the off-diagonal elements.  The given matrix (Z) represents either an (n x n) identity matrix if <d, e> represent a tri-diagonal matrix that has not been pre-processed, otherwise Z represents the transform matix (Q) output by tred2 if <d, e> represent a matrix reduced to tri-diagonal form by tred2().  The n eigenvalues are output in d and the corresponding normalised eigenvectors are output in the columns of the given matrix.  e is returned in an indeterminate state.  If the function succeeds then true is returned, otherwise the function returns false.  Derived from Press et al. Numerical Recipes 3rd ed.
 
+		void tridiagonalise_householder(std::vector<T>* d, std::vector<T>* e, std::vector<T>* tau); // perform in-place Householder reduction of the given real, symmetric matrix (A) to tri-diagonal form.  Only the lower triangle of A is read.  d[0..n-1] returns the diagonal elements and e[0..n-2] the sub-diagonal elements of the tri-diagonal matrix.  The Householder vector of reflector k (0 <= k < n-2) is stored in A(k+1:n, k) with its leading 1 and its scale factor is stored in tau[k].  The remaining elements of A are left in an indeterminate state
+
+		matrix<T> householder_q(const std::vector<T>& tau) const; // return the orthogonal matrix Q that represents the transform to tri-diagonal form from the reflectors stored in the given matrix (A) and tau by tridiagonalise_householder().  Reflectors are accumulated a block at a time in compact WY form so most of the work is matrix multiplication.  A NULL matrix is returned if Q cannot be created
+
+		bool tql_implicit(std::vector<T>* d, std::vector<T>* e); // QL decomposition as for tqli() with zero-indexed off-diagonal elements e[0..n-2] (as output by tridiagonalise_householder).  The rotations of each QL iteration are applied to the given matrix (Z) together in parallel over blocks of rows.  If the function succeeds then true is returned, otherwise the function returns false
+
 		void balbak(const std::vector<T>& scale);  // forms the eigenvectors of a real non-symmetric matrix by backtransforming those of the corresponding balanced matrix determined by balance().  Derived from Press et al. Numerical Recipes 3rd ed.
 
 		void sort_vecs(std::vector<std::complex<T>> *wri); // in-place sort of eigenvectors stored as columns in the given matrix (Z) and corresponding eigenvalues in *wri.  Derived from Press et al. Numerical Recipes 3rd ed.
 
 	public:
 
-		bool eigen_system(std::vector<std::complex<T>>* d, matrix<T>* Z) const; // extract the eigenvalues and eigenvectors for the given square, real matrix A.  The eigenvalues are returned in *d and the corresponding eigenvectors are returned in the column vectors of *Z.  If the eigensystem cannot be created, false is returned, otherwise the function returns true
+		bool eigen_system(std::vector<std::complex<T>>* d, matrix<T>* Z) const; // extract the eigenvalues and eigenvectors for the given square, real matrix A.  The eigenvalues are returned in *d and the corresponding eigenvectors are returned in the column vectors of *Z.  Symmetric matrices of order matrix_eigen_threshold or more are solved by symmetric_eigen().  If the eigensystem cannot be created, false is returned, otherwise the function returns true
+
+		bool symmetric_eigen(std::vector<T>* d, matrix<T>* Z) const; // extract the eigenvalues and eigenvectors for the given real, symmetric matrix A.  Only the lower triangle of A is read.  The eigenvalues are returned in ascending order in *d and the corresponding orthonormal eigenvectors are returned in the column vectors of *Z.  A is reduced to tri-diagonal form by Householder reflections, the reflectors are accumulated into Q in blocks by matrix multiplication and the tri-diagonal matrix is diagonalised by implicit QL.  Each stage is split into column or row blocks that are run through matrix_parallel_for.  If A is NULL or not square or the QL iteration does not converge false is returned, otherwise the function returns true
 
 
 
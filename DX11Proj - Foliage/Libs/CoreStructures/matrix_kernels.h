@@ -0,0 +1,697 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <functional>
+
+
+/*
+
+matrix_kernel<T> provides the inner loops of matrix<T> over raw column-major buffers - multiplication (C = AB and C += alpha AB), scaling, swaps, dot products, plane rotations and the elementary axpy style row and column operations.  The generic template is the original scalar implementation and is used for any T (including complex<float> and complex<double>).  float and double are specialised at compile time with SSE2 or AVX kernels.  AVX is used if __AVX__ is defined (/arch:AVX), otherwise SSE2 is used on x64 and on x86 with /arch:SSE2.  Define __GU_MATRIX_NO_SIMD__ in the host application to force the generic kernels for every type
+
+Columns are contiguous in column-major storage and are processed a full SIMD register at a time.  Rows are strided by n so row operations process a register's worth of row elements per iteration with the elements gathered into (and scattered from) the register.  Multiplication is blocked so a panel of A stays in cache while it is applied to every column of B, and each panel is multiplied by a register-tiled micro-kernel that accumulates a (2 register x 4 column) tile of C across the panel before writing it back.  No kernel allocates memory
+
+Large LU decompositions and solves split their work into independent column blocks.  These are run through matrix_parallel_for, which calls the function registered with matrix_set_parallel_for (for example a thread pool owned by the host application) or runs the blocks serially on the calling thread if no function is registered.  CoreStructures does not create threads itself
+
+*/
+
+
+#if !defined(__GU_MATRIX_NO_SIMD__)
+
+#if defined(__AVX__)
+
+#define __GU_MATRIX_AVX__ 1
+#include <immintrin.h>
+
+#elif defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#define __GU_MATRIX_SSE2__ 1
+#include <emmintrin.h>
+
+#endif
+
+#endif
+
+
+namespace CoreStructures {
+
+	// matrix multiplication blocking factors (panel of A = block_rows x block_depth elements)
+	enum matrix_kernel_blocking {
+
+		matrix_kernel_block_rows = 128,
+		matrix_kernel_block_depth = 128
+	};
+
+
+	// LU decomposition blocking.  Square matrices of order matrix_lu_blocked_threshold or more are factorised a panel of matrix_lu_block_size columns at a time, smaller matrices use Doolittle's method directly
+	enum matrix_lu_blocking {
+
+		matrix_lu_block_size = 64,
+		matrix_lu_blocked_threshold = 64
+	};
+
+
+	// symmetric eigen-decomposition blocking.  Householder reflectors are accumulated matrix_eigen_block_size at a time, the rotations of matrix_eigen_ql_sweeps QL iterations are applied together to blocks of matrix_eigen_block_rows rows, and eigen_system uses symmetric_eigen for symmetric matrices of order matrix_eigen_threshold or more
+	enum matrix_eigen_blocking {
+
+		matrix_eigen_block_size = 32,
+		matrix_eigen_block_rows = 64,
+		matrix_eigen_ql_sweeps = 16,
+		matrix_eigen_threshold = 128
+	};
+
+
+	//
+	// parallel loop hook
+	//
+
+	// parallel_for(count, grain, fn) calls fn(begin, end) over [0, count) in blocks of grain indices and returns when every block has been processed.  Blocks may run concurrently in any order
+	typedef std::function<void(unsigned int, unsigned int, const std::function<void(unsigned int, unsigned int)>&)> matrix_parallel_for_fn;
+
+	inline matrix_parallel_for_fn& matrix_parallel_for_instance() {
+
+		static matrix_parallel_for_fn parallel_for;
+		return parallel_for;
+	}
+
+	// register the loop used by matrix_parallel_for.  Pass an empty function to run loops serially.  This is not synchronised with running loops so should be called once at startup
+	inline void matrix_set_parallel_for(const matrix_parallel_for_fn& parallel_for) {
+
+		matrix_parallel_for_instance() = parallel_for;
+	}
+
+	// call fn(begin, end) over [0, count) through the registered loop, or serially in a single call if no loop is registered or count fits in a single block
+	inline void matrix_parallel_for(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& fn) {
+
+		auto& parallel_for = matrix_parallel_for_instance();
+
+		if (parallel_for && count > grain)
+			parallel_for(count, grain, fn);
+		else if (count > 0)
+			fn(0, count);
+	}
+
+
+	//
+	// generic (scalar) kernels
+	//
+
+	template <typename T>
+	struct matrix_kernel {
+
+		static const bool simd = false;
+
+		// C (n x p) = A (n x m) * B (m x p).  C must not alias A or B
+		static void multiply(const T *A, const T *B, T *C, unsigned int n, unsigned int m, unsigned int p) {
+
+			for (unsigned int i=0;i<n; i++) { // ith row in new matrix
+
+				auto Mptr = C + i;
+				auto Bptr = B;
+
+				for (unsigned int j=0; j<p; j++, Mptr+=n) { // jth column in new matrix
+
+					auto Aptr = A + i;
+
+					*Mptr = T(0);
+
+					for (unsigned int k=0; k<m; k++, Aptr+=n, Bptr++)
+						*Mptr += *Aptr * *Bptr;
+				}
+			}
+		}
+
+		// C (n x p) += alpha * A (n x m) * B (m x p).  C must not alias A or B
+		static void multiply_add(const T *A, const T *B, T *C, unsigned int n, unsigned int m, unsigned int p, const T& alpha) {
+
+			multiply_add(A, n, B, m, C, n, n, m, p, alpha);
+		}
+
+		// multiply_add over sub-matrices of larger column-major buffers.  Columns of A, B and C are lda, ldb and ldc elements apart
+		static void multiply_add(const T *A, unsigned int lda, const T *B, unsigned int ldb, T *C, unsigned int ldc, unsigned int n, unsigned int m, unsigned int p, const T& alpha) {
+
+			for (unsigned int i=0;i<n; i++) {
+
+				auto Mptr = C + i;
+
+				for (unsigned int j=0; j<p; j++, Mptr+=ldc) {
+
+					auto Aptr = A + i;
+					auto Bptr = B + j*ldb;
+					T sum = T(0);
+
+					for (unsigned int k=0; k<m; k++, Aptr+=lda, Bptr++)
+						sum += *Aptr * *Bptr;
+
+					*Mptr += alpha * sum;
+				}
+			}
+		}
+
+		// x <-> y over count elements stride apart
+		static void swap(T *x, T *y, unsigned int count, unsigned int stride) {
+
+			for (unsigned int p=0;p<count;p++, x+=stride, y+=stride) {
+
+				T t = T(*x);
+				*x = *y;
+				*y = t;
+			}
+		}
+
+		// kx -> x over count elements stride apart
+		static void scale(T *x, const T& k, unsigned int count, unsigned int stride) {
+
+			for (unsigned int p=0;p<count;p++, x+=stride)
+				*x *= k;
+		}
+
+		// kx + y -> y over count elements stride apart
+		static void axpy(const T *x, const T& k, T *y, unsigned int count, unsigned int stride) {
+
+			for (unsigned int p=0;p<count;p++, x+=stride, y+=stride)
+				*y = *x * k + *y;
+		}
+
+		// kx + k_y -> y over count elements stride apart
+		static void axpby(const T *x, const T& k, T *y, const T& k_, unsigned int count, unsigned int stride) {
+
+			for (unsigned int p=0;p<count;p++, x+=stride, y+=stride)
+				*y = (*x * k) + (*y * k_);
+		}
+
+		// return x.y over count elements stride apart
+		static T dot(const T *x, const T *y, unsigned int count, unsigned int stride) {
+
+			T sum = T(0);
+
+			for (unsigned int p=0;p<count;p++, x+=stride, y+=stride)
+				sum += *x * *y;
+
+			return sum;
+		}
+
+		// plane rotation (cx - sy -> x, sx + cy -> y) over count elements stride apart
+		static void rotate(T *x, T *y, const T& c, const T& s, unsigned int count, unsigned int stride) {
+
+			for (unsigned int p=0;p<count;p++, x+=stride, y+=stride) {
+
+				T t = *x;
+				*x = c * t - s * *y;
+				*y = s * t + c * *y;
+			}
+		}
+	};
+
+
+#if defined(__GU_MATRIX_AVX__) || defined(__GU_MATRIX_SSE2__)
+
+	//
+	// SIMD register abstraction for float and double
+	//
+
+	template <typename T>
+	struct matrix_simd;
+
+#if defined(__GU_MATRIX_AVX__)
+
+	template <>
+	struct matrix_simd<float> {
+
+		typedef __m256 reg;
+		static const unsigned int width = 8;
+
+		static reg zero() { return _mm256_setzero_ps(); }
+		static reg splat(float k) { return _mm256_set1_ps(k); }
+		static reg load(const float *x) { return _mm256_loadu_ps(x); }
+		static void store(float *x, reg v) { _mm256_storeu_ps(x, v); }
+		static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+		static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+
+		static reg gather(const float *x, unsigned int stride) {
+
+			return _mm256_set_ps(x[7*stride], x[6*stride], x[5*stride], x[4*stride], x[3*stride], x[2*stride], x[stride], x[0]);
+		}
+
+		static void scatter(float *x, unsigned int stride, reg v) {
+
+			float t[8];
+
+			_mm256_storeu_ps(t, v);
+
+			for (unsigned int p=0;p<8;p++, x+=stride)
+				*x = t[p];
+		}
+	};
+
+	template <>
+	struct matrix_simd<double> {
+
+		typedef __m256d reg;
+		static const unsigned int width = 4;
+
+		static reg zero() { return _mm256_setzero_pd(); }
+		static reg splat(double k) { return _mm256_set1_pd(k); }
+		static reg load(const double *x) { return _mm256_loadu_pd(x); }
+		static void store(double *x, reg v) { _mm256_storeu_pd(x, v); }
+		static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+		static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+
+		static reg gather(const double *x, unsigned int stride) {
+
+			return _mm256_set_pd(x[3*stride], x[2*stride], x[stride], x[0]);
+		}
+
+		static void scatter(double *x, unsigned int stride, reg v) {
+
+			__m128d lo = _mm256_castpd256_pd128(v);
+			__m128d hi = _mm256_extractf128_pd(v, 1);
+
+			_mm_storel_pd(x, lo);
+			_mm_storeh_pd(x + stride, lo);
+			_mm_storel_pd(x + 2*stride, hi);
+			_mm_storeh_pd(x + 3*stride, hi);
+		}
+	};
+
+#else
+
+	template <>
+	struct matrix_simd<float> {
+
+		typedef __m128 reg;
+		static const unsigned int width = 4;
+
+		static reg zero() { return _mm_setzero_ps(); }
+		static reg splat(float k) { return _mm_set1_ps(k); }
+		static reg load(const float *x) { return _mm_loadu_ps(x); }
+		static void store(float *x, reg v) { _mm_storeu_ps(x, v); }
+		static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+		static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+
+		static reg gather(const float *x, unsigned int stride) {
+
+			return _mm_set_ps(x[3*stride], x[2*stride], x[stride], x[0]);
+		}
+
+		static void scatter(float *x, unsigned int stride, reg v) {
+
+			_mm_store_ss(x, v);
+			_mm_store_ss(x + stride, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+			_mm_store_ss(x + 2*stride, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)));
+			_mm_store_ss(x + 3*stride, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+		}
+	};
+
+	template <>
+	struct matrix_simd<double> {
+
+		typedef __m128d reg;
+		static const unsigned int width = 2;
+
+		static reg zero() { return _mm_setzero_pd(); }
+		static reg splat(double k) { return _mm_set1_pd(k); }
+		static reg load(const double *x) { return _mm_loadu_pd(x); }
+		static void store(double *x, reg v) { _mm_storeu_pd(x, v); }
+		static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+		static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+
+		static reg gather(const double *x, unsigned int stride) {
+
+			return _mm_loadh_pd(_mm_load_sd(x), x + stride);
+		}
+
+		static void scatter(double *x, unsigned int stride, reg v) {
+
+			_mm_storel_pd(x, v);
+			_mm_storeh_pd(x + stride, v);
+		}
+	};
+
+#endif
+
+
+	//
+	// SIMD kernels shared by the float and double specialisations
+	//
+
+	template <typename T>
+	struct matrix_simd_kernel {
+
+		typedef matrix_simd<T>		S;
+		typedef typename S::reg		reg;
+
+		static const bool simd = true;
+
+		// C(i0:i1, j) += alpha * A(i0:i1, k0:k1) * B(k0:k1, j) for the 4 columns j0 <= j < j0+4 of C.  A tile of 2 registers x 4 columns of C is held in registers across the depth of the panel
+		static void multiply_panel4(const T *A, unsigned int lda, const T *B, unsigned int ldb, T *C, unsigned int ldc, unsigned int i0, unsigned int i1, unsigned int k0, unsigned int k1, unsigned int j0, const T& alpha) {
+
+			const unsigned int W = S::width;
+			reg av = S::splat(alpha);
+
+			const T *B0 = B + j0*ldb;
+			const T *B1 = B0 + ldb;
+			const T *B2 = B1 + ldb;
+			const T *B3 = B2 + ldb;
+
+			T *C0 = C + j0*ldc;
+			T *C1 = C0 + ldc;
+			T *C2 = C1 + ldc;
+			T *C3 = C2 + ldc;
+
+			unsigned int i = i0;
+
+			for (; i + 2*W <= i1; i += 2*W) {
+
+				reg c00 = S::zero(), c01 = S::zero(), c02 = S::zero(), c03 = S::zero();
+				reg c10 = S::zero(), c11 = S::zero(), c12 = S::zero(), c13 = S::zero();
+
+				auto Aptr = A + k0*lda + i;
+
+				for (unsigned int k=k0; k<k1; k++, Aptr+=lda) {
+
+					reg a0 = S::load(Aptr);
+					reg a1 = S::load(Aptr + W);
+					reg b;
+
+					b = S::splat(B0[k]);
+					c00 = S::add(c00, S::mul(a0, b));
+					c10 = S::add(c10, S::mul(a1, b));
+
+					b = S::splat(B1[k]);
+					c01 = S::add(c01, S::mul(a0, b));
+					c11 = S::add(c11, S::mul(a1, b));
+
+					b = S::splat(B2[k]);
+					c02 = S::add(c02, S::mul(a0, b));
+					c12 = S::add(c12, S::mul(a1, b));
+
+					b = S::splat(B3[k]);
+					c03 = S::add(c03, S::mul(a0, b));
+					c13 = S::add(c13, S::mul(a1, b));
+				}
+
+				S::store(C0 + i, S::add(S::load(C0 + i), S::mul(c00, av)));
+				S::store(C0 + i + W, S::add(S::load(C0 + i + W), S::mul(c10, av)));
+				S::store(C1 + i, S::add(S::load(C1 + i), S::mul(c01, av)));
+				S::store(C1 + i + W, S::add(S::load(C1 + i + W), S::mul(c11, av)));
+				S::store(C2 + i, S::add(S::load(C2 + i), S::mul(c02, av)));
+				S::store(C2 + i + W, S::add(S::load(C2 + i + W), S::mul(c12, av)));
+				S::store(C3 + i, S::add(S::load(C3 + i), S::mul(c03, av)));
+				S::store(C3 + i + W, S::add(S::load(C3 + i + W), S::mul(c13, av)));
+			}
+
+			for (; i + W <= i1; i += W) {
+
+				reg c0 = S::zero(), c1 = S::zero(), c2 = S::zero(), c3 = S::zero();
+
+				auto Aptr = A + k0*lda + i;
+
+				for (unsigned int k=k0; k<k1; k++, Aptr+=lda) {
+
+					reg a = S::load(Aptr);
+
+					c0 = S::add(c0, S::mul(a, S::splat(B0[k])));
+					c1 = S::add(c1, S::mul(a, S::splat(B1[k])));
+					c2 = S::add(c2, S::mul(a, S::splat(B2[k])));
+					c3 = S::add(c3, S::mul(a, S::splat(B3[k])));
+				}
+
+				S::store(C0 + i, S::add(S::load(C0 + i), S::mul(c0, av)));
+				S::store(C1 + i, S::add(S::load(C1 + i), S::mul(c1, av)));
+				S::store(C2 + i, S::add(S::load(C2 + i), S::mul(c2, av)));
+				S::store(C3 + i, S::add(S::load(C3 + i), S::mul(c3, av)));
+			}
+
+			// remaining rows
+			for (; i < i1; i++) {
+
+				T c0 = T(0), c1 = T(0), c2 = T(0), c3 = T(0);
+
+				auto Aptr = A + k0*lda + i;
+
+				for (unsigned int k=k0; k<k1; k++, Aptr+=lda) {
+
+					c0 += *Aptr * B0[k];
+					c1 += *Aptr * B1[k];
+					c2 += *Aptr * B2[k];
+					c3 += *Aptr * B3[k];
+				}
+
+				C0[i] += alpha * c0;
+				C1[i] += alpha * c1;
+				C2[i] += alpha * c2;
+				C3[i] += alpha * c3;
+			}
+		}
+
+		// single column version of multiply_panel4 for the columns left over when p is not a multiple of 4
+		static void multiply_panel1(const T *A, unsigned int lda, const T *B, unsigned int ldb, T *C, unsigned int ldc, unsigned int i0, unsigned int i1, unsigned int k0, unsigned int k1, unsigned int j, const T& alpha) {
+
+			const unsigned int W = S::width;
+			reg av = S::splat(alpha);
+
+			const T *Bj = B + j*ldb;
+			T *Cj = C + j*ldc;
+
+			unsigned int i = i0;
+
+			for (; i + W <= i1; i += W) {
+
+				reg c = S::zero();
+
+				auto Aptr = A + k0*lda + i;
+
+				for (unsigned int k=k0; k<k1; k++, Aptr+=lda)
+					c = S::add(c, S::mul(S::load(Aptr), S::splat(Bj[k])));
+
+				S::store(Cj + i, S::add(S::load(Cj + i), S::mul(c, av)));
+			}
+
+			for (; i < i1; i++) {
+
+				T c = T(0);
+
+				auto Aptr = A + k0*lda + i;
+
+				for (unsigned int k=k0; k<k1; k++, Aptr+=lda)
+					c += *Aptr * Bj[k];
+
+				Cj[i] += alpha * c;
+			}
+		}
+
+		// C (n x p) = A (n x m) * B (m x p).  C must not alias A or B
+		static void multiply(const T *A, const T *B, T *C, unsigned int n, unsigned int m, unsigned int p) {
+
+			std::fill(C, C + n*p, T(0));
+			multiply_add(A, B, C, n, m, p, T(1));
+		}
+
+		// C (n x p) += alpha * A (n x m) * B (m x p).  C must not alias A or B
+		static void multiply_add(const T *A, const T *B, T *C, unsigned int n, unsigned int m, unsigned int p, const T& alpha) {
+
+			multiply_add(A, n, B, m, C, n, n, m, p, alpha);
+		}
+
+		// multiply_add over sub-matrices of larger column-major buffers.  Columns of A, B and C are lda, ldb and ldc elements apart
+		static void multiply_add(const T *A, unsigned int lda, const T *B, unsigned int ldb, T *C, unsigned int ldc, unsigned int n, unsigned int m, unsigned int p, const T& alpha) {
+
+			for (unsigned int k0=0; k0<m; k0+=matrix_kernel_block_depth) {
+
+				unsigned int k1 = std::min<unsigned int>(k0 + matrix_kernel_block_depth, m);
+
+				for (unsigned int i0=0; i0<n; i0+=matrix_kernel_block_rows) {
+
+					unsigned int i1 = std::min<unsigned int>(i0 + matrix_kernel_block_rows, n);
+
+					// apply the (i0:i1, k0:k1) panel of A to every column of B
+					unsigned int j = 0;
+
+					for (; j + 4 <= p; j += 4)
+						multiply_panel4(A, lda, B, ldb, C, ldc, i0, i1, k0, k1, j, alpha);
+
+					for (; j < p; j++)
+						multiply_panel1(A, lda, B, ldb, C, ldc, i0, i1, k0, k1, j, alpha);
+				}
+			}
+		}
+
+		// x <-> y over count elements stride apart
+		static void swap(T *x, T *y, unsigned int count, unsigned int stride) {
+
+			const unsigned int W = S::width;
+			unsigned int p = 0;
+
+			if (stride == 1) {
+
+				for (; p + W <= count; p += W, x += W, y += W) {
+
+					reg t = S::load(x);
+					S::store(x, S::load(y));
+					S::store(y, t);
+				}
+
+			} else {
+
+				for (; p + W <= count; p += W, x += W*stride, y += W*stride) {
+
+					reg t = S::gather(x, stride);
+					S::scatter(x, stride, S::gather(y, stride));
+					S::scatter(y, stride, t);
+				}
+			}
+
+			for (; p<count; p++, x+=stride, y+=stride) {
+
+				T t = *x;
+				*x = *y;
+				*y = t;
+			}
+		}
+
+		// kx -> x over count elements stride apart
+		static void scale(T *x, const T& k, unsigned int count, unsigned int stride) {
+
+			const unsigned int W = S::width;
+			reg kv = S::splat(k);
+			unsigned int p = 0;
+
+			if (stride == 1) {
+
+				for (; p + W <= count; p += W, x += W)
+					S::store(x, S::mul(S::load(x), kv));
+
+			} else {
+
+				for (; p + W <= count; p += W, x += W*stride)
+					S::scatter(x, stride, S::mul(S::gather(x, stride), kv));
+			}
+
+			for (; p<count; p++, x+=stride)
+				*x *= k;
+		}
+
+		// kx + y -> y over count elements stride apart
+		static void axpy(const T *x, const T& k, T *y, unsigned int count, unsigned int stride) {
+
+			const unsigned int W = S::width;
+			reg kv = S::splat(k);
+			unsigned int p = 0;
+
+			if (stride == 1) {
+
+				for (; p + W <= count; p += W, x += W, y += W)
+					S::store(y, S::add(S::mul(S::load(x), kv), S::load(y)));
+
+			} else {
+
+				for (; p + W <= count; p += W, x += W*stride, y += W*stride)
+					S::scatter(y, stride, S::add(S::mul(S::gather(x, stride), kv), S::gather(y, stride)));
+			}
+
+			for (; p<count; p++, x+=stride, y+=stride)
+				*y = *x * k + *y;
+		}
+
+		// kx + k_y -> y over count elements stride apart
+		static void axpby(const T *x, const T& k, T *y, const T& k_, unsigned int count, unsigned int stride) {
+
+			const unsigned int W = S::width;
+			reg kv = S::splat(k);
+			reg kv_ = S::splat(k_);
+			unsigned int p = 0;
+
+			if (stride == 1) {
+
+				for (; p + W <= count; p += W, x += W, y += W)
+					S::store(y, S::add(S::mul(S::load(x), kv), S::mul(S::load(y), kv_)));
+
+			} else {
+
+				for (; p + W <= count; p += W, x += W*stride, y += W*stride)
+					S::scatter(y, stride, S::add(S::mul(S::gather(x, stride), kv), S::mul(S::gather(y, stride), kv_)));
+			}
+
+			for (; p<count; p++, x+=stride, y+=stride)
+				*y = (*x * k) + (*y * k_);
+		}
+
+		// return x.y over count elements stride apart
+		static T dot(const T *x, const T *y, unsigned int count, unsigned int stride) {
+
+			const unsigned int W = S::width;
+			reg s0 = S::zero(), s1 = S::zero();
+			unsigned int p = 0;
+
+			if (stride == 1) {
+
+				for (; p + 2*W <= count; p += 2*W, x += 2*W, y += 2*W) {
+
+					s0 = S::add(s0, S::mul(S::load(x), S::load(y)));
+					s1 = S::add(s1, S::mul(S::load(x + W), S::load(y + W)));
+				}
+
+			} else {
+
+				for (; p + W <= count; p += W, x += W*stride, y += W*stride)
+					s0 = S::add(s0, S::mul(S::gather(x, stride), S::gather(y, stride)));
+			}
+
+			T t[S::width];
+			T sum = T(0);
+
+			S::store(t, S::add(s0, s1));
+
+			for (unsigned int k=0;k<W;k++)
+				sum += t[k];
+
+			for (; p<count; p++, x+=stride, y+=stride)
+				sum += *x * *y;
+
+			return sum;
+		}
+
+		// plane rotation (cx - sy -> x, sx + cy -> y) over count elements stride apart
+		static void rotate(T *x, T *y, const T& c, const T& s, unsigned int count, unsigned int stride) {
+
+			const unsigned int W = S::width;
+			reg cv = S::splat(c);
+			reg sv = S::splat(s);
+			reg nsv = S::splat(-s);
+			unsigned int p = 0;
+
+			if (stride == 1) {
+
+				for (; p + W <= count; p += W, x += W, y += W) {
+
+					reg xv = S::load(x);
+					reg yv = S::load(y);
+
+					S::store(x, S::add(S::mul(xv, cv), S::mul(yv, nsv)));
+					S::store(y, S::add(S::mul(xv, sv), S::mul(yv, cv)));
+				}
+			}
+
+			for (; p<count; p++, x+=stride, y+=stride) {
+
+				T t = *x;
+				*x = c * t - s * *y;
+				*y = s * t + c * *y;
+			}
+		}
+	};
+
+
+	//
+	// float and double specialisations
+	//
+
+	template <>
+	struct matrix_kernel<float> : public matrix_simd_kernel<float> {};
+
+	template <>
+	struct matrix_kernel<double> : public matrix_simd_kernel<double> {};
+
+#endif
+
+}
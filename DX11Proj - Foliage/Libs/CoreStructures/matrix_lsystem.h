@@ -14,15 +14,7 @@ namespace CoreStructures {
 	template <typename T>
 	void matrix<T>::rowInterchange(unsigned int i, unsigned int j) {
 
-		auto iptr = M.get() + (i-1);
-		auto jptr = M.get() + (j-1);
-	
-		for (unsigned int p=0;p<m;p++, iptr+=n, jptr+=n) {
-
-			T t = T(*iptr);
-			*iptr = *jptr;
-			*jptr = t;
-		}
+		matrix_kernel<T>::swap(M.get() + (i-1), M.get() + (j-1), m, n);
 	}
 
 	
@@ -31,10 +23,7 @@ namespace CoreStructures {
 	template <typename T>
 	void matrix<T>::rowScale(unsigned int i, const T& k) {
 	
-		auto iptr = M.get() + (i-1);
-	
-		for (unsigned int p=0;p<m;p++, iptr+=n)
-			*iptr *= k;
+		matrix_kernel<T>::scale(M.get() + (i-1), k, m, n);
 	}
 
 
@@ -43,11 +32,7 @@ namespace CoreStructures {
 	template <typename T>
 	void matrix<T>::rowAddition(unsigned int i, const T& k, unsigned int j) {
 	
-		auto iptr = M.get() + (i-1);
-		auto jptr = M.get() + (j-1);
-	
-		for (unsigned int p=0;p<m;p++, iptr+=n, jptr+=n)
-			*jptr = *iptr * k + *jptr;
+		matrix_kernel<T>::axpy(M.get() + (i-1), k, M.get() + (j-1), m, n);
 	}
 
 
@@ -56,11 +41,7 @@ namespace CoreStructures {
 	template <typename T>
 	void matrix<T>::rowScaleAdd(unsigned int i, const T& k, unsigned int j, const T& k_) {
 	
-		auto iptr = M.get() + (i-1);
-		auto jptr = M.get() + (j-1);
-	
-		for (unsigned int p=0;p<m;p++, iptr+=n, jptr+=n)
-			*jptr = (*iptr * k) + (*jptr * k_);
+		matrix_kernel<T>::axpby(M.get() + (i-1), k, M.get() + (j-1), k_, m, n);
 	}
 
 
@@ -70,51 +51,28 @@ namespace CoreStructures {
 	template <typename T>
 	void matrix<T>::colInterchange(unsigned int i, unsigned int j) {
 
-		auto iptr = M.get() + (i-1)*n;
-		auto jptr = M.get() + (j-1)*n;
-	
-		auto temp = (T*)malloc(n * sizeof(T));
-
-		if (temp) {
-
-			memcpy_s(temp, n * sizeof(T), iptr, n * sizeof(T)); // copy column i into temp
-			memcpy_s(iptr, n * sizeof(T), jptr, n * sizeof(T)); // copy column j into column i
-			memcpy_s(jptr, n * sizeof(T), temp, n * sizeof(T)); // copy temp into column j
-
-			free(temp);
-		}
+		matrix_kernel<T>::swap(M.get() + (i-1)*n, M.get() + (j-1)*n, n, 1);
 	}
 
 	// E2. kCi -> Ci (preconditions: matrix is not NULL; (1 <= i <= m); k≠0)
 	template <typename T>
 	void matrix<T>::colScale(unsigned int i, const T& k) {
 
-		auto iptr = M.get() + (i-1)*n;
-	
-		for (unsigned int p=0; p<n; p++, iptr++)
-			*iptr *= k;
+		matrix_kernel<T>::scale(M.get() + (i-1)*n, k, n, 1);
 	}
 	
 	// E3. kCi + Cj -> Cj (preconditions: matrix is not NULL; i!=j; (1 <= i <= m); (1 <= j <= m))
 	template <typename T>
 	void matrix<T>::colAddition(unsigned int i, const T& k, unsigned int j) {
 
-		auto iptr = M.get() + (i-1)*n;
-		auto jptr = M.get() + (j-1)*n;
-	
-		for (unsigned int p=0; p<n; p++, iptr++, jptr++)
-			*jptr = *iptr * k + *jptr;
+		matrix_kernel<T>::axpy(M.get() + (i-1)*n, k, M.get() + (j-1)*n, n, 1);
 	}
 
 	// E. kCi + k_Cj -> Cj (preconditions: matrix is not NULL; i!=j; (1 <= i <= m); (1 <= j <= m); k_≠0)
 	template <typename T>
 	void matrix<T>::colScaleAdd(unsigned int i, const T& k, unsigned int j, const T& k_) {
 
-		auto iptr = M.get() + (i-1)*n;
-		auto jptr = M.get() + (j-1)*n;
-	
-		for (unsigned int p=0; p<n; p++, iptr++, jptr++)
-			*jptr = (*iptr * k) + (*jptr * k_);
+		matrix_kernel<T>::axpby(M.get() + (i-1)*n, k, M.get() + (j-1)*n, k_, n, 1);
 	}
 
 
@@ -872,8 +830,7 @@ namespace CoreStructures {
 				if (pivotRowIndex!=-1) {
 				
 					// valid pivot found - exchange rows
-					for (k=1; k<=n; k++)
-						swap(element(j, k), element(pivotRowIndex, k));
+					rowInterchange(j, pivotRowIndex);
 				
 					// swap row indices in permutation vector if defined
 					if (permutationVector)
@@ -922,6 +879,109 @@ namespace CoreStructures {
 	}
 
 	
+	// Blocked right-looking LUP factorisation (see Golub & Van Loan sec 3.2.9).  Each panel of matrix_lu_block_size columns is factorised in place with partial pivoting (using the same implicit row scaling as lup_decomposition_doolittle), swapping whole rows so the permutation applies to the entire matrix.  The block row of U to the right of the panel is then solved against the panel's unit lower triangle and the trailing submatrix is updated with A22 -= L21 * U12, which is a matrix multiplication and so runs through the blocked SIMD kernel.  The solve and update of each column block of the trailing submatrix are independent so column blocks are run through matrix_parallel_for
+	template <typename T>
+	gu_lu_decomp_state matrix<T>::lup_decomposition_blocked(std::vector<unsigned int> *permutationVector, T *parity) {
+
+		const unsigned int nb = matrix_lu_block_size;
+
+		T *A = M.get();
+
+		// create row normalisation array
+		T *N = createRowNormalisationCoeffVector();
+
+		T rowParity = T(1);
+		gu_lu_decomp_state luState = gu_lu_okay;
+
+		for (unsigned int k0=0; k0<n && luState==gu_lu_okay; k0+=nb) {
+
+			unsigned int k1 = std::min<unsigned int>(k0 + nb, n);
+
+			// factorise the panel A(k0:n, k0:k1)
+			for (unsigned int j=k0; j<k1 && luState==gu_lu_okay; j++) {
+
+				T *Aj = A + j*n;
+
+				// find the largest (scaled) pivot in column j
+				int pivotRowIndex = -1;
+				T maxValue = T(0);
+
+				for (unsigned int i=j; i<n; i++) {
+
+					T p_ij = abs(Aj[i]) * N[i];
+
+					if (tgreater<T>(p_ij, maxValue, precision)) {
+
+						maxValue = p_ij;
+						pivotRowIndex = i;
+					}
+				}
+
+				if (pivotRowIndex==-1) {
+
+					luState = gu_lu_fail_singular;
+					break;
+				}
+
+				if ((unsigned int)pivotRowIndex != j) {
+
+					// exchange whole rows so rows already factorised in L and rows still to be updated are permuted together
+					matrix_kernel<T>::swap(A + j, A + pivotRowIndex, n, n);
+
+					if (permutationVector)
+						swap((*permutationVector)[j], (*permutationVector)[pivotRowIndex]);
+
+					rowParity = -rowParity;
+
+					swap(N[j], N[pivotRowIndex]);
+				}
+
+				// scale column j below the pivot to give L(j+1:n, j) then apply the rank-1 update to the rest of the panel
+				matrix_kernel<T>::scale(Aj + j + 1, T(1) / Aj[j], n - j - 1, 1);
+
+				for (unsigned int c=j+1; c<k1; c++)
+					matrix_kernel<T>::axpy(Aj + j + 1, -A[c*n + j], A + c*n + j + 1, n - j - 1, 1);
+			}
+
+			if (luState!=gu_lu_okay || k1==n)
+				continue;
+
+			// solve U12 = L11^-1 A12 and update A22 -= L21 U12 one block of trailing columns at a time
+			matrix_parallel_for(n - k1, nb, [=](unsigned int begin, unsigned int end) {
+
+				for (unsigned int c=k1+begin; c<k1+end; c++) {
+
+					T *Ac = A + c*n;
+
+					for (unsigned int j=k0; j<k1; j++)
+						matrix_kernel<T>::axpy(A + j*n + j + 1, -Ac[j], Ac + j + 1, k1 - j - 1, 1);
+				}
+
+				matrix_kernel<T>::multiply_add(A + k0*n + k1, n, A + (k1 + begin)*n + k0, n, A + (k1 + begin)*n + k1, n, n - k1, k1 - k0, end - begin, T(-1));
+			});
+		}
+
+		// store rowParity in *parity if defined
+		if (parity)
+			*parity = rowParity;
+
+		// Dispose of local resources
+		free(N);
+
+		return luState;
+	}
+
+
+	template <typename T>
+	gu_lu_decomp_state matrix<T>::lup_decomposition(std::vector<unsigned int> *permutationVector, T *parity) {
+
+		if (n < matrix_lu_blocked_threshold)
+			return lup_decomposition_doolittle(permutationVector, parity);
+		else
+			return lup_decomposition_blocked(permutationVector, parity);
+	}
+
+
 	template <typename T>
 	gu_lu_decomp_state matrix<T>::lup_decomp(matrix<T> *D, std::vector<unsigned int> *P) const {
 
@@ -932,7 +992,7 @@ namespace CoreStructures {
 
 		std::vector<unsigned int> v = identity_permutation_vec(D_.n);
 
-		gu_lu_decomp_state lu_state = D_.lup_decomposition_doolittle(&v, NULL);
+		gu_lu_decomp_state lu_state = D_.lup_decomposition(&v, NULL);
 
 		if (lu_state != gu_lu_okay)
 			return lu_state;
@@ -954,7 +1014,7 @@ namespace CoreStructures {
 
 		std::vector<unsigned int> v = identity_permutation_vec(D.n);
 
-		gu_lu_decomp_state lu_state = D.lup_decomposition_doolittle(&v, NULL); 
+		gu_lu_decomp_state lu_state = D.lup_decomposition(&v, NULL);
 
 		if (lu_state != gu_lu_okay)
 			return lu_state;
@@ -1005,40 +1065,41 @@ namespace CoreStructures {
 	template <typename T>
 	matrix<T> lup_solve(const matrix<T>& D, const std::vector<unsigned int>& P, const matrix<T>& B) {
 	
-		matrix<T> x(D.n, 1);
+		matrix<T> x(D.n, B.m);
 
 		if (x.is_null())
 			return matrix<T>::nullmatrix();
 		
-		auto xptr = x.M.get();
-		auto bptr = B.M.get();
-		
-		// initialise x to the constants in r but mapped via permutation vector P
-		for (unsigned int i=0; i<D.n; i++)
-			xptr[i] = bptr[P[i]-1]; // index B with P[i]-1 here since permutation indices start at 1, not 0
-	
-		// perform forward substitution step Ly = r : eq.14.4 (where L(ii) = 1.0 so no division necessary)
-		for (unsigned int i=1; i<=D.n; i++) {
-			
-			T s = xptr[i-1];
-			
-			for (unsigned int k=1; k<i; k++)
-				s -= D(i, k) * xptr[k-1];
-			
-			xptr[i-1] = s;
-		}
-		
-			
-		// perform backward substitution step Ux = y : eq.14.7
-		for (unsigned int i=D.n; i>=1; i--) {
+		auto Dptr = D.M.get();
+		auto Xptr = x.M.get();
+		auto Bptr = B.M.get();
+		auto Pptr = P.data();
+		unsigned int n = D.n;
 
-			auto s = xptr[i-1];
-			
-			for (unsigned int k=i+1; k<=D.n; k++)
-				s -= D(i, k) * xptr[k-1];
-			
-			xptr[i-1] = s / D(i, i);
-		}
+		// each column of B is solved independently.  Substitution is ordered by column of D so L and U are read down their contiguous columns
+		matrix_parallel_for(B.m, matrix_lu_block_size, [=](unsigned int begin, unsigned int end) {
+
+			for (unsigned int c=begin; c<end; c++) {
+
+				auto xptr = Xptr + c*n;
+				auto bptr = Bptr + c*n;
+
+				// initialise x to the constants in b but mapped via permutation vector P
+				for (unsigned int i=0; i<n; i++)
+					xptr[i] = bptr[Pptr[i]-1]; // index B with P[i]-1 here since permutation indices start at 1, not 0
+
+				// perform forward substitution step Ly = b : eq.14.4 (where L(ii) = 1.0 so no division necessary)
+				for (unsigned int k=0; k+1<n; k++)
+					matrix_kernel<T>::axpy(Dptr + k*n + k + 1, -xptr[k], xptr + k + 1, n - k - 1, 1);
+
+				// perform backward substitution step Ux = y : eq.14.7
+				for (unsigned int k=n; k>=1; k--) {
+
+					xptr[k-1] /= Dptr[(k-1)*n + k-1];
+					matrix_kernel<T>::axpy(Dptr + (k-1)*n, -xptr[k-1], xptr, k-1, 1);
+				}
+			}
+		});
 
 		return x;
 	}
@@ -2079,6 +2140,288 @@ fail_hqr2:
 	}
 
 
+	// Householder reduction of a symmetric matrix to tri-diagonal form (see Golub & Van Loan sec 8.3.1).  Column k is reduced by the reflector H(k) = I - tau(k) v v^T built from A(k+1:n, k) and the trailing submatrix is updated with the symmetric rank-2 update A22 -= v w^T + w v^T.  A22 is kept in full (not just the lower triangle) so both the product p = A22 v and the rank-2 update run down contiguous columns, and both are split into column blocks run through matrix_parallel_for
+	template <typename T>
+	void matrix<T>::tridiagonalise_householder(std::vector<T>* d, std::vector<T>* e, std::vector<T>* tau) {
+
+		T *A = M.get();
+
+		d->assign(n, T(0));
+		e->assign(n, T(0));
+		tau->assign(n, T(0));
+
+		// A is symmetric - copy the lower triangle into the upper triangle
+		for (unsigned int j=1; j<n; j++)
+			for (unsigned int i=0; i<j; i++)
+				A[j*n + i] = A[i*n + j];
+
+		std::vector<T> w_(n);
+		T *w = w_.data();
+
+		for (unsigned int k=0; k+2<n; k++) {
+
+			const unsigned int m = n - k - 1; // order of A22
+			T *v = A + k*n + k + 1; // A(k+1:n, k) becomes the Householder vector
+			T *A22 = A + (k+1)*n + k + 1;
+
+			// reflector H(k) with H(k) A(k+1:n, k) = (beta, 0, ..., 0)^T and v[0] = 1
+			T alpha = v[0];
+			T xnorm2 = matrix_kernel<T>::dot(v + 1, v + 1, m - 1, 1);
+			T beta = alpha;
+			T t = T(0);
+
+			if (xnorm2 != T(0)) {
+
+				beta = sqrt(alpha * alpha + xnorm2);
+
+				if (alpha > T(0))
+					beta = -beta;
+
+				t = (beta - alpha) / beta;
+				matrix_kernel<T>::scale(v + 1, T(1) / (alpha - beta), m - 1, 1);
+			}
+
+			v[0] = T(1);
+
+			(*d)[k] = A[k*n + k];
+			(*e)[k] = beta;
+			(*tau)[k] = t;
+
+			if (t == T(0))
+				continue;
+
+			// w = t A22 v
+			matrix_parallel_for(m, matrix_eigen_block_rows, [=](unsigned int begin, unsigned int end) {
+
+				for (unsigned int i=begin; i<end; i++)
+					w[i] = t * matrix_kernel<T>::dot(A22 + i*n, v, m, 1);
+			});
+
+			// w = w - (t / 2)(w.v)v
+			matrix_kernel<T>::axpy(v, -T(0.5) * t * matrix_kernel<T>::dot(w, v, m, 1), w, m, 1);
+
+			// A22 = A22 - v w^T - w v^T
+			matrix_parallel_for(m, matrix_eigen_block_size, [=](unsigned int begin, unsigned int end) {
+
+				for (unsigned int j=begin; j<end; j++) {
+
+					matrix_kernel<T>::axpy(v, -w[j], A22 + j*n, m, 1);
+					matrix_kernel<T>::axpy(w, -v[j], A22 + j*n, m, 1);
+				}
+			});
+		}
+
+		if (n >= 2) {
+
+			(*d)[n-2] = A[(n-2)*n + n-2];
+			(*e)[n-2] = A[(n-2)*n + n-1];
+		}
+
+		(*d)[n-1] = A[(n-1)*n + n-1];
+		(*e)[n-1] = T(0);
+	}
+
+
+	// Q = H(0) H(1) ... H(n-3) is accumulated backwards from the identity.  Each block of matrix_eigen_block_size reflectors is combined into the compact WY form I - V T V^T (Schreiber & Van Loan) and applied to the trailing rows and columns of Q with three matrix multiplications, which are split into column blocks run through matrix_parallel_for
+	template <typename T>
+	matrix<T> matrix<T>::householder_q(const std::vector<T>& tau) const {
+
+		matrix<T> Q = matrix<T>::I(n);
+
+		if (Q.is_null() || n < 3)
+			return Q;
+
+		const T *A = M.get();
+		T *Qptr = Q.M.get();
+
+		const unsigned int nb = matrix_eigen_block_size;
+		const unsigned int numReflectors = n - 2;
+
+		for (unsigned int k0=((numReflectors - 1) / nb) * nb; ; k0-=nb) {
+
+			const unsigned int k1 = std::min<unsigned int>(k0 + nb, numReflectors);
+			const unsigned int b = k1 - k0; // reflectors in the block
+			const unsigned int r = n - k0 - 1; // rows (and columns) of Q updated by the block
+
+			// V (r x b) holds v(k) in column k - k0 starting at row k - k0, Vt = V^T
+			std::vector<T> V_(r * b, T(0)), Vt_(b * r), T_(b * b, T(0));
+			T *V = V_.data(), *Vt = Vt_.data(), *Tb = T_.data();
+
+			for (unsigned int c=0; c<b; c++) {
+
+				const T *v = A + (k0 + c)*n + k0 + c + 1;
+
+				for (unsigned int i=0; i<r - c; i++)
+					V[c*r + c + i] = v[i];
+			}
+
+			for (unsigned int c=0; c<b; c++)
+				for (unsigned int i=0; i<r; i++)
+					Vt[i*b + c] = V[c*r + i];
+
+			// T (b x b) upper triangular, T(0:c, c) = -tau(c) T(0:c, 0:c) V(:, 0:c)^T v(c)
+			for (unsigned int c=0; c<b; c++) {
+
+				const T t = tau[k0 + c];
+
+				Tb[c*b + c] = t;
+
+				for (unsigned int j=0; j<c; j++)
+					Tb[c*b + j] = -t * matrix_kernel<T>::dot(V + j*r + c, V + c*r + c, r - c, 1);
+
+				// multiply by T(0:c, 0:c) in place, top to bottom so each row reads unchanged elements below it
+				for (unsigned int i=0; i<c; i++) {
+
+					T s = T(0);
+
+					for (unsigned int j=i; j<c; j++)
+						s += Tb[j*b + i] * Tb[c*b + j];
+
+					Tb[c*b + i] = s;
+				}
+			}
+
+			// Q(k0+1:n, k0+1:n) = (I - V T V^T) Q(k0+1:n, k0+1:n)
+			T *C = Qptr + (k0 + 1)*n + k0 + 1;
+
+			matrix_parallel_for(r, matrix_eigen_block_rows, [=](unsigned int begin, unsigned int end) {
+
+				const unsigned int cols = end - begin;
+				std::vector<T> W1(b * cols, T(0)), W2(b * cols, T(0));
+
+				matrix_kernel<T>::multiply_add(Vt, b, C + begin*n, n, W1.data(), b, b, r, cols, T(1));
+				matrix_kernel<T>::multiply_add(Tb, b, W1.data(), b, W2.data(), b, b, b, cols, T(1));
+				matrix_kernel<T>::multiply_add(V, r, W2.data(), b, C + begin*n, n, r, b, cols, T(-1));
+			});
+
+			if (k0 == 0)
+				break;
+		}
+
+		return Q;
+	}
+
+
+	// implicit QL as tqli() but with zero-indexed <d, e>.  The rotations only change Z, never <d, e>, so rather than rotating the columns of Z as each rotation is found the rotations of up to matrix_eigen_ql_sweeps QL iterations are queued and then applied together.  Rows of Z are independent under the rotations so Z is split into blocks of matrix_eigen_block_rows rows run through matrix_parallel_for, and each block stays in cache while every queued rotation is applied to it
+	template <typename T>
+	bool matrix<T>::tql_implicit(std::vector<T>* d, std::vector<T>* e) {
+
+		T *Z = M.get();
+		T *D = d->data();
+		T *E = e->data();
+
+		const unsigned int N = n;
+
+		// queued rotations - iteration k rotates columns (i, i+1) for i = m-1 down to l by (c, s) = (rot[2j], rot[2j+1]), j = sweep[3k+2] + (m-1-i), where l = sweep[3k] and m = sweep[3k+1]
+		std::vector<T> rot_(2 * n * matrix_eigen_ql_sweeps);
+		std::vector<int> sweep_(3 * matrix_eigen_ql_sweeps);
+		T *rot = rot_.data();
+		int *sweep = sweep_.data();
+		unsigned int numSweeps = 0, numRotations = 0;
+
+		auto flush = [&]() {
+
+			const unsigned int count = numSweeps;
+
+			matrix_parallel_for(N, matrix_eigen_block_rows, [=](unsigned int begin, unsigned int end) {
+
+				for (unsigned int k=0; k<count; k++) {
+
+					const int l = sweep[3*k], m = sweep[3*k + 1];
+					const T *cs = rot + 2*sweep[3*k + 2];
+
+					for (int i=m-1; i>=l; i--, cs+=2)
+						matrix_kernel<T>::rotate(Z + i*N + begin, Z + (i+1)*N + begin, cs[0], cs[1], end - begin, 1);
+				}
+			});
+
+			numSweeps = numRotations = 0;
+		};
+
+		for (int l=0; l<(int)n; l++) {
+
+			int iter = 0;
+			int m;
+
+			do {
+
+				for (m=l; m<(int)n-1; m++) {
+
+					T dd = abs(D[m]) + abs(D[m+1]);
+
+					if (abs(E[m]) + dd == dd)
+						break;
+				}
+
+				if (m != l) {
+
+					if (iter++ == 30) {
+
+						flush();
+						return false;
+					}
+
+					if (numSweeps == matrix_eigen_ql_sweeps)
+						flush();
+
+					T *cs = rot + 2*numRotations;
+
+					sweep[3*numSweeps] = l;
+					sweep[3*numSweeps + 1] = m;
+					sweep[3*numSweeps + 2] = numRotations;
+					numSweeps++;
+					numRotations += m - l;
+
+					T g = (D[l+1] - D[l]) / (T(2) * E[l]);
+					T r = sqrt((g * g) + T(1));
+					g = D[m] - D[l] + E[l] / (g + ((g<T(0)) ? -abs(r) : abs(r)));
+
+					T s = T(1), c = T(1), p = T(0);
+
+					for (int i=m-1; i>=l; i--) {
+
+						T f = s * E[i];
+						T b = c * E[i];
+
+						if (abs(f) >= abs(g)) {
+
+							c = g / f;
+							r = sqrt((c * c) + T(1));
+							E[i+1] = f * r;
+							c *= (s=T(1)/r);
+
+						} else {
+
+							s = f / g;
+							r = sqrt((s * s) + T(1));
+							E[i+1] = g * r;
+							s *= (c=T(1)/r);
+						}
+
+						g = D[i+1] - p;
+						r = (D[i] - g) * s + T(2) * c * b;
+						p = s * r;
+						D[i+1] = g + p;
+						g = c * r - b;
+
+						*cs++ = c;
+						*cs++ = s;
+					}
+
+					D[l] = D[l] - p;
+					E[l] = g;
+					E[m] = T(0);
+				}
+
+			} while (m != l);
+		}
+
+		flush();
+
+		return true;
+	}
+
+
 	template <typename T>
 	void matrix<T>::balbak(const std::vector<T>& scale) {
 
@@ -2129,7 +2472,16 @@ fail_hqr2:
 
 		if (!is_null() && is_real() && is_square() && d && Z) {
 
-			if (is_symmetric()) {
+			if (is_symmetric() && n >= matrix_eigen_threshold) {
+
+				std::vector<T> d_;
+
+				eigensystem_status = symmetric_eigen(&d_, Z);
+
+				if (eigensystem_status)
+					*d = std::vector<std::complex<T>>(d_.begin(), d_.end());
+
+			} else if (is_symmetric()) {
 
 				// process symmetric real matrix
 
@@ -2194,5 +2546,49 @@ fail_hqr2:
 		return eigensystem_status;
 	}
 
+
+	template <typename T>
+	bool matrix<T>::symmetric_eigen(std::vector<T>* d, matrix<T>* Z) const {
+
+		if (is_null() || !is_square() || !d || !Z)
+			return false;
+
+		matrix<T> R = matrix<T>(*this);
+
+		if (R.is_null())
+			return false;
+
+		std::vector<T> e, tau;
+
+		R.tridiagonalise_householder(d, &e, &tau);
+
+		matrix<T> Q = R.householder_q(tau);
+
+		if (Q.is_null() || !Q.tql_implicit(d, &e))
+			return false;
+
+		// sort eigenvalues into ascending order
+		T *Qptr = Q.M.get();
+
+		for (unsigned int i=0; i+1<n; i++) {
+
+			unsigned int k = i;
+
+			for (unsigned int j=i+1; j<n; j++)
+				if ((*d)[j] < (*d)[k])
+					k = j;
+
+			if (k != i) {
+
+				std::swap((*d)[i], (*d)[k]);
+				matrix_kernel<T>::swap(Qptr + i*n, Qptr + k*n, n, 1);
+			}
+		}
+
+		*Z = std::move(Q);
+
+		return true;
+	}
+
 }
 
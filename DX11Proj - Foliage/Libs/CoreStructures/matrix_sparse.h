@@ -0,0 +1,1000 @@
+﻿#pragma once
+
+#include "matrix_core.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+
+/*
+
+sparse_matrix models an (n x m) real sparse matrix in compressed sparse row (CSR) format.  Row i (zero-indexed) holds the non-zero elements values[row_ptr[i] ... row_ptr[i+1]-1] in columns col_index[row_ptr[i] ... row_ptr[i+1]-1], sorted by column with no duplicates.  Compressed sparse column (CSC) data is accepted and returned by converting through the transpose since the CSC arrays of A are the CSR arrays of A^T.  Value semantics apply as for matrix<T>, a NULL sparse matrix has n = m = 0 and sparse_matrix converts to and from matrix<T>.  Element indices in the public interface start at 1 as for matrix<T>, indices in the compressed arrays start at 0.
+
+Matrix-vector products (SpMV) split the rows into blocks that are run through matrix_parallel_for (see matrix_kernels.h), as do the vector operations of the iterative solvers.  Dot products are summed per block and the block sums are added in order so results do not depend on the number of threads.
+
+Iterative solvers
+
+sparse_cg		preconditioned conjugate gradient for symmetric positive-definite A
+sparse_bicgstab		right-preconditioned BiCGSTAB (van der Vorst) for general square A
+
+Both take an optional preconditioner (gu_sparse_precond_jacobi scales by the inverse diagonal, gu_sparse_precond_ilu0 applies the incomplete LU factorisation of A with the sparsity pattern of A - see Saad, Iterative Methods for Sparse Linear Systems, sec 10.3).  The Jacobi preconditioner is applied in parallel, ILU(0) substitution is sequential
+
+*/
+
+
+namespace CoreStructures {
+
+	typedef enum {gu_sparse_converged, gu_sparse_not_converged, gu_sparse_breakdown, gu_sparse_error} gu_sparse_solver_state; // iterative solver states
+	typedef enum {gu_sparse_precond_none, gu_sparse_precond_jacobi, gu_sparse_precond_ilu0} gu_sparse_precond_type; // preconditioner types
+	typedef enum {gu_sparse_csr, gu_sparse_csc} gu_sparse_layout; // compressed array layouts
+
+	// rows (and vector elements) per block of parallel work
+	enum sparse_matrix_blocking {
+
+		sparse_matrix_block_rows = 2048
+	};
+
+
+	// element (i, j) = value of a sparse matrix under construction (1 <= i <= n, 1 <= j <= m)
+	template <typename T>
+	struct sparse_entry {
+
+		unsigned int		i, j;
+		T					value;
+	};
+
+
+	// auxiliary information returned by the iterative solvers
+	template <typename T>
+	struct gu_sparse_solver_aux {
+
+		unsigned int		iterations; // number of iterations performed
+		T					residual; // relative residual |b - Ax| / |b| of the returned solution
+	};
+
+
+	template <typename T>
+	struct sparse_preconditioner;
+
+
+	template <typename T>
+	struct sparse_matrix {
+
+		friend struct sparse_preconditioner<T>;
+
+	private:
+
+		unsigned int				n, m;
+		std::vector<unsigned int>	row_ptr; // (n + 1) offsets into col_index and values
+		std::vector<unsigned int>	col_index;
+		std::vector<T>				values;
+
+		void sort_rows(); // sort the elements of each row by column and sum duplicates
+
+	public:
+
+		sparse_matrix(); // create a NULL sparse matrix
+
+		sparse_matrix(unsigned int n, unsigned int m, const std::vector<sparse_entry<T> >& entries); // create an (n x m) sparse matrix from the given entries.  Entries with the same (i, j) are summed.  Entries outside the matrix are ignored.  A NULL sparse matrix is created if n = 0 or m = 0
+
+		sparse_matrix(unsigned int n, unsigned int m, gu_sparse_layout layout, const std::vector<unsigned int>& ptr, const std::vector<unsigned int>& index, const std::vector<T>& values); // create an (n x m) sparse matrix from compressed arrays in the given layout.  For gu_sparse_csr ptr holds (n + 1) row offsets and index holds column indices, for gu_sparse_csc ptr holds (m + 1) column offsets and index holds row indices.  A NULL sparse matrix is created if the arrays are inconsistent with the order
+
+		explicit sparse_matrix(const matrix<T>& A); // create a sparse matrix from the non-zero elements of A
+
+		static sparse_matrix<T> identity(unsigned int n); // return an (n x n) sparse identity matrix
+
+
+		bool is_null() const;
+		bool is_square() const;
+
+		unsigned int rows() const;
+		unsigned int columns() const;
+		unsigned int nonzeros() const; // return the number of stored elements
+
+		const unsigned int* row_offsets() const; // CSR arrays (see above)
+		const unsigned int* column_indices() const;
+		const T* elements() const;
+
+		void compressed(gu_sparse_layout layout, std::vector<unsigned int> *ptr, std::vector<unsigned int> *index, std::vector<T> *values) const; // return the compressed arrays of the matrix in the given layout
+
+		T operator()(unsigned int i, unsigned int j) const; // return element (i, j) (1 <= i <= n, 1 <= j <= m), T(0) if no element is stored at (i, j)
+
+		matrix<T> to_matrix() const; // return the dense matrix of the given sparse matrix.  A NULL matrix is returned if the sparse matrix is NULL
+
+		sparse_matrix<T> transpose() const; // return the transpose of the given sparse matrix
+
+		std::vector<T> diagonal() const; // return the leading diagonal, min(n, m) elements
+
+		void multiply(const T *x, T *y) const; // y (n) = Ax where x has m elements.  y must not alias x
+		void multiply_transpose(const T *x, T *y) const; // y (m) = (A^T)x where x has n elements.  y must not alias x
+
+		matrix<T> operator*(const matrix<T>& X) const; // return AX where X is an (m x k) dense matrix.  A NULL matrix is returned if A or X are NULL or X.n != m
+	};
+
+
+	// preconditioner M for the iterative solvers.  apply(r, z) solves Mz = r
+	template <typename T>
+	struct sparse_preconditioner {
+
+	private:
+
+		gu_sparse_precond_type		type;
+		unsigned int				n;
+		sparse_matrix<T>			LU; // ILU(0) factors - unit lower triangle L below the diagonal and U on and above the diagonal
+		std::vector<unsigned int>	diag_ptr; // position of the diagonal element of each row of LU
+		std::vector<T>				inv_diag; // Jacobi scale factors
+		bool						valid;
+
+	public:
+
+		sparse_preconditioner(const sparse_matrix<T>& A, gu_sparse_precond_type type); // build the preconditioner of the given square matrix (gu_sparse_precond_none gives M = I).  The preconditioner is not valid if A is not square or a diagonal element needed by the preconditioner is zero or not stored
+
+		bool is_valid() const;
+
+		void apply(const T *r, T *z) const; // z = (M^-1)r.  z must not alias r
+	};
+
+
+	template <typename T>
+	gu_sparse_solver_state sparse_cg(const sparse_matrix<T>& A, const matrix<T>& b, matrix<T> *x, gu_sparse_precond_type precond = gu_sparse_precond_jacobi, T tolerance = T(1e-6), unsigned int maxIterations = 0, gu_sparse_solver_aux<T> *aux = nullptr); // solve Ax = b for the symmetric positive-definite (n x n) matrix A and (n x 1) vector b using the preconditioned conjugate gradient method.  If *x is an (n x 1) matrix it is used as the initial guess, otherwise the initial guess is 0.  Iteration stops when |b - Ax| <= tolerance * |b| or after maxIterations iterations (0 = n iterations).  The solution is returned in *x.  gu_sparse_error is returned (and x is unchanged) if the orders are inconsistent or the preconditioner is not valid for A
+
+	template <typename T>
+	gu_sparse_solver_state sparse_bicgstab(const sparse_matrix<T>& A, const matrix<T>& b, matrix<T> *x, gu_sparse_precond_type precond = gu_sparse_precond_ilu0, T tolerance = T(1e-6), unsigned int maxIterations = 0, gu_sparse_solver_aux<T> *aux = nullptr); // solve Ax = b for the square (n x n) matrix A and (n x 1) vector b using the right-preconditioned BiCGSTAB method.  Arguments and return values are as for sparse_cg.  gu_sparse_breakdown is returned if the iteration breaks down (rho or omega become zero) before convergence
+
+
+
+	//
+	// sparse vector kernels
+	//
+
+	template <typename T>
+	struct sparse_vector_kernel {
+
+		// return x.y over n elements.  Blocks of sparse_matrix_block_rows elements are summed independently and the block sums are added in order
+		static T dot(const T *x, const T *y, unsigned int n) {
+
+			const unsigned int numBlocks = (n + sparse_matrix_block_rows - 1) / sparse_matrix_block_rows;
+
+			if (numBlocks <= 1) {
+
+				T sum = T(0);
+
+				for (unsigned int k=0;k<n;k++)
+					sum += x[k] * y[k];
+
+				return sum;
+			}
+
+			std::vector<T> blockSum(numBlocks);
+			T *S = blockSum.data();
+
+			matrix_parallel_for(numBlocks, 1, [=](unsigned int begin, unsigned int end) {
+
+				for (unsigned int b=begin; b<end; b++) {
+
+					unsigned int k0 = b * sparse_matrix_block_rows;
+					unsigned int k1 = std::min<unsigned int>(k0 + sparse_matrix_block_rows, n);
+					T sum = T(0);
+
+					for (unsigned int k=k0; k<k1; k++)
+						sum += x[k] * y[k];
+
+					S[b] = sum;
+				}
+			});
+
+			T sum = T(0);
+
+			for (unsigned int b=0;b<numBlocks;b++)
+				sum += S[b];
+
+			return sum;
+		}
+
+		// call fn(k0, k1) over blocks of [0, n)
+		template <typename F>
+		static void for_blocks(unsigned int n, const F& fn) {
+
+			matrix_parallel_for(n, sparse_matrix_block_rows, fn);
+		}
+	};
+
+
+
+	//
+	// sparse_matrix<T> implementation
+	//
+
+	template <typename T>
+	sparse_matrix<T>::sparse_matrix() : n(0), m(0), row_ptr(1, 0) {}
+
+
+	template <typename T>
+	sparse_matrix<T>::sparse_matrix(unsigned int n, unsigned int m, const std::vector<sparse_entry<T> >& entries) : n(0), m(0), row_ptr(1, 0) {
+
+		if (n==0 || m==0)
+			return;
+
+		this->n = n;
+		this->m = m;
+
+		// count the elements of each row then place each entry at the next free position of its row
+		row_ptr.assign(n + 1, 0);
+
+		for (auto& e : entries)
+			if (e.i>=1 && e.i<=n && e.j>=1 && e.j<=m)
+				row_ptr[e.i]++;
+
+		for (unsigned int i=0;i<n;i++)
+			row_ptr[i+1] += row_ptr[i];
+
+		col_index.resize(row_ptr[n]);
+		values.resize(row_ptr[n]);
+
+		std::vector<unsigned int> next(row_ptr.begin(), row_ptr.end() - 1);
+
+		for (auto& e : entries) {
+
+			if (e.i>=1 && e.i<=n && e.j>=1 && e.j<=m) {
+
+				unsigned int k = next[e.i - 1]++;
+
+				col_index[k] = e.j - 1;
+				values[k] = e.value;
+			}
+		}
+
+		sort_rows();
+	}
+
+
+	template <typename T>
+	sparse_matrix<T>::sparse_matrix(unsigned int n, unsigned int m, gu_sparse_layout layout, const std::vector<unsigned int>& ptr, const std::vector<unsigned int>& index, const std::vector<T>& values) : n(0), m(0), row_ptr(1, 0) {
+
+		// the compressed dimension is rows for CSR and columns for CSC
+		unsigned int major = (layout==gu_sparse_csr) ? n : m;
+		unsigned int minor = (layout==gu_sparse_csr) ? m : n;
+
+		if (n==0 || m==0 || ptr.size()!=major + 1 || ptr[0]!=0 || index.size()!=ptr[major] || values.size()!=ptr[major])
+			return;
+
+		for (unsigned int i=0;i<major;i++)
+			if (ptr[i] > ptr[i+1])
+				return;
+
+		for (auto j : index)
+			if (j >= minor)
+				return;
+
+		sparse_matrix<T> A;
+
+		A.n = major;
+		A.m = minor;
+		A.row_ptr = ptr;
+		A.col_index = index;
+		A.values = values;
+		A.sort_rows();
+
+		*this = (layout==gu_sparse_csr) ? std::move(A) : A.transpose();
+	}
+
+
+	template <typename T>
+	sparse_matrix<T>::sparse_matrix(const matrix<T>& A) : n(0), m(0), row_ptr(1, 0) {
+
+		if (A.is_null())
+			return;
+
+		n = A.rows();
+		m = A.columns();
+
+		const T *a = A.data();
+
+		row_ptr.assign(n + 1, 0);
+
+		for (unsigned int i=0;i<n;i++) {
+
+			for (unsigned int j=0;j<m;j++) {
+
+				T v = a[j*n + i];
+
+				if (v != T(0)) {
+
+					col_index.push_back(j);
+					values.push_back(v);
+				}
+			}
+
+			row_ptr[i+1] = (unsigned int)col_index.size();
+		}
+	}
+
+
+	template <typename T>
+	sparse_matrix<T> sparse_matrix<T>::identity(unsigned int n) {
+
+		sparse_matrix<T> I;
+
+		if (n==0)
+			return I;
+
+		I.n = I.m = n;
+		I.row_ptr.resize(n + 1);
+		I.col_index.resize(n);
+		I.values.assign(n, T(1));
+
+		for (unsigned int i=0;i<=n;i++)
+			I.row_ptr[i] = i;
+
+		for (unsigned int i=0;i<n;i++)
+			I.col_index[i] = i;
+
+		return I;
+	}
+
+
+	template <typename T>
+	void sparse_matrix<T>::sort_rows() {
+
+		std::vector<std::pair<unsigned int, T> > row;
+		unsigned int k = 0;
+
+		for (unsigned int i=0;i<n;i++) {
+
+			unsigned int k0 = row_ptr[i];
+			unsigned int k1 = row_ptr[i+1];
+
+			row.clear();
+
+			for (unsigned int p=k0;p<k1;p++)
+				row.push_back(std::make_pair(col_index[p], values[p]));
+
+			std::sort(row.begin(), row.end(), [](const std::pair<unsigned int, T>& a, const std::pair<unsigned int, T>& b) { return a.first < b.first; });
+
+			// compact the row in place, summing duplicate columns.  k never passes k0 so rows still to be sorted are not overwritten
+			row_ptr[i] = k;
+
+			for (unsigned int p=0;p<row.size();p++) {
+
+				if (p > 0 && row[p].first==row[p-1].first) {
+
+					values[k-1] += row[p].second;
+
+				} else {
+
+					col_index[k] = row[p].first;
+					values[k] = row[p].second;
+					k++;
+				}
+			}
+		}
+
+		row_ptr[n] = k;
+		col_index.resize(k);
+		values.resize(k);
+	}
+
+
+	template <typename T>
+	bool sparse_matrix<T>::is_null() const {
+
+		return n==0 || m==0;
+	}
+
+
+	template <typename T>
+	bool sparse_matrix<T>::is_square() const {
+
+		return !is_null() && n==m;
+	}
+
+
+	template <typename T>
+	unsigned int sparse_matrix<T>::rows() const {
+
+		return n;
+	}
+
+
+	template <typename T>
+	unsigned int sparse_matrix<T>::columns() const {
+
+		return m;
+	}
+
+
+	template <typename T>
+	unsigned int sparse_matrix<T>::nonzeros() const {
+
+		return (unsigned int)values.size();
+	}
+
+
+	template <typename T>
+	const unsigned int* sparse_matrix<T>::row_offsets() const {
+
+		return row_ptr.data();
+	}
+
+
+	template <typename T>
+	const unsigned int* sparse_matrix<T>::column_indices() const {
+
+		return col_index.data();
+	}
+
+
+	template <typename T>
+	const T* sparse_matrix<T>::elements() const {
+
+		return values.data();
+	}
+
+
+	template <typename T>
+	void sparse_matrix<T>::compressed(gu_sparse_layout layout, std::vector<unsigned int> *ptr, std::vector<unsigned int> *index, std::vector<T> *values) const {
+
+		if (layout==gu_sparse_csc) {
+
+			transpose().compressed(gu_sparse_csr, ptr, index, values);
+			return;
+		}
+
+		if (ptr) *ptr = row_ptr;
+		if (index) *index = col_index;
+		if (values) *values = this->values;
+	}
+
+
+	template <typename T>
+	T sparse_matrix<T>::operator()(unsigned int i, unsigned int j) const {
+
+		auto first = col_index.begin() + row_ptr[i-1];
+		auto last = col_index.begin() + row_ptr[i];
+		auto p = std::lower_bound(first, last, j-1);
+
+		return (p!=last && *p==j-1) ? values[p - col_index.begin()] : T(0);
+	}
+
+
+	template <typename T>
+	matrix<T> sparse_matrix<T>::to_matrix() const {
+
+		if (is_null())
+			return matrix<T>::nullmatrix();
+
+		matrix<T> A = matrix<T>::zeromatrix(n, m);
+
+		if (A.is_null())
+			return A;
+
+		T *a = A.data();
+
+		for (unsigned int i=0;i<n;i++)
+			for (unsigned int k=row_ptr[i];k<row_ptr[i+1];k++)
+				a[col_index[k]*n + i] = values[k];
+
+		return A;
+	}
+
+
+	template <typename T>
+	sparse_matrix<T> sparse_matrix<T>::transpose() const {
+
+		sparse_matrix<T> R;
+
+		if (is_null())
+			return R;
+
+		R.n = m;
+		R.m = n;
+		R.row_ptr.assign(m + 1, 0);
+		R.col_index.resize(values.size());
+		R.values.resize(values.size());
+
+		for (auto j : col_index)
+			R.row_ptr[j+1]++;
+
+		for (unsigned int j=0;j<m;j++)
+			R.row_ptr[j+1] += R.row_ptr[j];
+
+		// rows of A are visited in order so the rows of A^T are filled in column order
+		std::vector<unsigned int> next(R.row_ptr.begin(), R.row_ptr.end() - 1);
+
+		for (unsigned int i=0;i<n;i++) {
+
+			for (unsigned int k=row_ptr[i];k<row_ptr[i+1];k++) {
+
+				unsigned int p = next[col_index[k]]++;
+
+				R.col_index[p] = i;
+				R.values[p] = values[k];
+			}
+		}
+
+		return R;
+	}
+
+
+	template <typename T>
+	std::vector<T> sparse_matrix<T>::diagonal() const {
+
+		std::vector<T> d(std::min(n, m), T(0));
+
+		for (unsigned int i=0;i<d.size();i++)
+			d[i] = (*this)(i+1, i+1);
+
+		return d;
+	}
+
+
+	template <typename T>
+	void sparse_matrix<T>::multiply(const T *x, T *y) const {
+
+		const unsigned int *R = row_ptr.data();
+		const unsigned int *C = col_index.data();
+		const T *V = values.data();
+
+		sparse_vector_kernel<T>::for_blocks(n, [=](unsigned int begin, unsigned int end) {
+
+			for (unsigned int i=begin; i<end; i++) {
+
+				T sum = T(0);
+
+				for (unsigned int k=R[i]; k<R[i+1]; k++)
+					sum += V[k] * x[C[k]];
+
+				y[i] = sum;
+			}
+		});
+	}
+
+
+	template <typename T>
+	void sparse_matrix<T>::multiply_transpose(const T *x, T *y) const {
+
+		// rows of A scatter into y so this is not split across threads
+		std::fill(y, y + m, T(0));
+
+		for (unsigned int i=0;i<n;i++)
+			for (unsigned int k=row_ptr[i];k<row_ptr[i+1];k++)
+				y[col_index[k]] += values[k] * x[i];
+	}
+
+
+	template <typename T>
+	matrix<T> sparse_matrix<T>::operator*(const matrix<T>& X) const {
+
+		if (is_null() || X.is_null() || X.rows()!=m)
+			return matrix<T>::nullmatrix();
+
+		matrix<T> Y(n, X.columns());
+
+		if (Y.is_null())
+			return Y;
+
+		for (unsigned int j=0;j<X.columns();j++)
+			multiply(X.data() + j*m, Y.data() + j*n);
+
+		return Y;
+	}
+
+
+
+	//
+	// sparse_preconditioner<T> implementation
+	//
+
+	template <typename T>
+	sparse_preconditioner<T>::sparse_preconditioner(const sparse_matrix<T>& A, gu_sparse_precond_type type) : type(type), n(A.rows()), valid(A.is_square()) {
+
+		if (!valid)
+			return;
+
+		switch (type) {
+
+		case gu_sparse_precond_jacobi:
+			{
+				inv_diag = A.diagonal();
+
+				for (unsigned int i=0;i<n && valid;i++) {
+
+					if (inv_diag[i]==T(0))
+						valid = false;
+					else
+						inv_diag[i] = T(1) / inv_diag[i];
+				}
+
+				break;
+			}
+
+		case gu_sparse_precond_ilu0:
+			{
+				// IKJ variant of Gaussian elimination restricted to the sparsity pattern of A (Saad algorithm 10.4)
+				LU = A;
+
+				const unsigned int *R = LU.row_ptr.data();
+				const unsigned int *C = LU.col_index.data();
+				T *V = LU.values.data();
+
+				diag_ptr.resize(n);
+
+				// position of each column of the current row i (or -1)
+				std::vector<int> position(n, -1);
+
+				for (unsigned int i=0;i<n && valid;i++) {
+
+					for (unsigned int q=R[i];q<R[i+1];q++)
+						position[C[q]] = (int)q;
+
+					unsigned int k = R[i];
+
+					for (; k<R[i+1] && C[k]<i; k++) {
+
+						// l(ik) = a(ik) / u(kk) then subtract l(ik) * row k of U from the elements of row i in the pattern
+						unsigned int r = C[k];
+
+						V[k] /= V[diag_ptr[r]];
+
+						for (unsigned int q=diag_ptr[r]+1; q<R[r+1]; q++)
+							if (position[C[q]] >= 0)
+								V[position[C[q]]] -= V[k] * V[q];
+					}
+
+					if (k==R[i+1] || C[k]!=i || V[k]==T(0))
+						valid = false; // no diagonal element or zero pivot
+					else
+						diag_ptr[i] = k;
+
+					for (unsigned int q=R[i];q<R[i+1];q++)
+						position[C[q]] = -1;
+				}
+
+				break;
+			}
+
+		default:
+			break;
+		}
+	}
+
+
+	template <typename T>
+	bool sparse_preconditioner<T>::is_valid() const {
+
+		return valid;
+	}
+
+
+	template <typename T>
+	void sparse_preconditioner<T>::apply(const T *r, T *z) const {
+
+		switch (type) {
+
+		case gu_sparse_precond_jacobi:
+			{
+				const T *D = inv_diag.data();
+
+				sparse_vector_kernel<T>::for_blocks(n, [=](unsigned int begin, unsigned int end) {
+
+					for (unsigned int i=begin; i<end; i++)
+						z[i] = D[i] * r[i];
+				});
+
+				break;
+			}
+
+		case gu_sparse_precond_ilu0:
+			{
+				const unsigned int *R = LU.row_offsets();
+				const unsigned int *C = LU.column_indices();
+				const T *V = LU.elements();
+				const unsigned int *D = diag_ptr.data();
+
+				// forward substitution Ly = r (unit diagonal)
+				for (unsigned int i=0;i<n;i++) {
+
+					T s = r[i];
+
+					for (unsigned int k=R[i];k<D[i];k++)
+						s -= V[k] * z[C[k]];
+
+					z[i] = s;
+				}
+
+				// backward substitution Uz = y
+				for (unsigned int i=n;i>=1;i--) {
+
+					T s = z[i-1];
+
+					for (unsigned int k=D[i-1]+1;k<R[i];k++)
+						s -= V[k] * z[C[k]];
+
+					z[i-1] = s / V[D[i-1]];
+				}
+
+				break;
+			}
+
+		default:
+			std::copy(r, r + n, z);
+			break;
+		}
+	}
+
+
+
+	//
+	// iterative solvers
+	//
+
+	// common argument checks and initial guess for sparse_cg and sparse_bicgstab.  Return false if the arguments are not valid
+	template <typename T>
+	bool sparse_solver_setup(const sparse_matrix<T>& A, const matrix<T>& b, matrix<T> *x, std::vector<T> *x0) {
+
+		if (!x || !A.is_square() || b.is_null() || b.rows()!=A.rows() || b.columns()!=1)
+			return false;
+
+		const unsigned int n = A.rows();
+
+		if (!x->is_null() && x->rows()==n && x->columns()==1)
+			x0->assign(x->data(), x->data() + n);
+		else
+			x0->assign(n, T(0));
+
+		return true;
+	}
+
+
+	template <typename T>
+	gu_sparse_solver_state sparse_cg(const sparse_matrix<T>& A, const matrix<T>& b, matrix<T> *x, gu_sparse_precond_type precond, T tolerance, unsigned int maxIterations, gu_sparse_solver_aux<T> *aux) {
+
+		typedef sparse_vector_kernel<T> K;
+
+		std::vector<T> X;
+
+		if (!sparse_solver_setup(A, b, x, &X))
+			return gu_sparse_error;
+
+		sparse_preconditioner<T> M(A, precond);
+
+		if (!M.is_valid())
+			return gu_sparse_error;
+
+		const unsigned int n = A.rows();
+		const T *B = b.data();
+
+		std::vector<T> r_(n), z_(n), p_(n), q_(n);
+		T *x_ = X.data(), *r = r_.data(), *z = z_.data(), *p = p_.data(), *q = q_.data();
+
+		if (maxIterations==0)
+			maxIterations = n;
+
+		// r = b - Ax
+		A.multiply(x_, r);
+
+		K::for_blocks(n, [=](unsigned int begin, unsigned int end) {
+
+			for (unsigned int k=begin; k<end; k++)
+				r[k] = B[k] - r[k];
+		});
+
+		T normB = std::sqrt(K::dot(B, B, n));
+
+		if (normB==T(0))
+			normB = T(1);
+
+		T residual = std::sqrt(K::dot(r, r, n)) / normB;
+		unsigned int it = 0;
+
+		if (residual > tolerance) {
+
+			M.apply(r, z);
+
+			std::copy(z, z + n, p);
+
+			T rz = K::dot(r, z, n);
+
+			while (it < maxIterations) {
+
+				// q = Ap
+				A.multiply(p, q);
+
+				T pq = K::dot(p, q, n);
+
+				if (pq==T(0))
+					break;
+
+				T alpha = rz / pq;
+
+				K::for_blocks(n, [=](unsigned int begin, unsigned int end) {
+
+					for (unsigned int k=begin; k<end; k++) {
+
+						x_[k] += alpha * p[k];
+						r[k] -= alpha * q[k];
+					}
+				});
+
+				it++;
+				residual = std::sqrt(K::dot(r, r, n)) / normB;
+
+				if (residual <= tolerance)
+					break;
+
+				M.apply(r, z);
+
+				T rz_ = K::dot(r, z, n);
+				T beta = rz_ / rz;
+
+				rz = rz_;
+
+				K::for_blocks(n, [=](unsigned int begin, unsigned int end) {
+
+					for (unsigned int k=begin; k<end; k++)
+						p[k] = z[k] + beta * p[k];
+				});
+			}
+		}
+
+		*x = matrix<T>(n, 1);
+		std::copy(x_, x_ + n, x->data());
+
+		if (aux) {
+
+			aux->iterations = it;
+			aux->residual = residual;
+		}
+
+		if (residual <= tolerance)
+			return gu_sparse_converged;
+		else
+			return (it < maxIterations) ? gu_sparse_breakdown : gu_sparse_not_converged;
+	}
+
+
+	template <typename T>
+	gu_sparse_solver_state sparse_bicgstab(const sparse_matrix<T>& A, const matrix<T>& b, matrix<T> *x, gu_sparse_precond_type precond, T tolerance, unsigned int maxIterations, gu_sparse_solver_aux<T> *aux) {
+
+		typedef sparse_vector_kernel<T> K;
+
+		std::vector<T> X;
+
+		if (!sparse_solver_setup(A, b, x, &X))
+			return gu_sparse_error;
+
+		sparse_preconditioner<T> M(A, precond);
+
+		if (!M.is_valid())
+			return gu_sparse_error;
+
+		const unsigned int n = A.rows();
+		const T *B = b.data();
+
+		std::vector<T> r_(n), r0_(n), p_(n), v_(n), s_(n), t_(n), ph_(n), sh_(n);
+		T *x_ = X.data(), *r = r_.data(), *r0 = r0_.data(), *p = p_.data(), *v = v_.data(), *s = s_.data(), *t = t_.data(), *ph = ph_.data(), *sh = sh_.data();
+
+		if (maxIterations==0)
+			maxIterations = n;
+
+		// r = b - Ax and r0 = r
+		A.multiply(x_, r);
+
+		K::for_blocks(n, [=](unsigned int begin, unsigned int end) {
+
+			for (unsigned int k=begin; k<end; k++) {
+
+				r[k] = B[k] - r[k];
+				r0[k] = r[k];
+			}
+		});
+
+		T normB = std::sqrt(K::dot(B, B, n));
+
+		if (normB==T(0))
+			normB = T(1);
+
+		T residual = std::sqrt(K::dot(r, r, n)) / normB;
+		T rho = T(1), alpha = T(1), omega = T(1);
+		unsigned int it = 0;
+
+		while (residual > tolerance && it < maxIterations) {
+
+			T rho_ = K::dot(r0, r, n);
+
+			if (rho_==T(0))
+				break;
+
+			// p = r + beta(p - omega v)
+			if (it==0) {
+
+				std::copy(r, r + n, p);
+
+			} else {
+
+				T beta = (rho_ / rho) * (alpha / omega);
+
+				K::for_blocks(n, [=](unsigned int begin, unsigned int end) {
+
+					for (unsigned int k=begin; k<end; k++)
+						p[k] = r[k] + beta * (p[k] - omega * v[k]);
+				});
+			}
+
+			rho = rho_;
+
+			// v = A(M^-1)p
+			M.apply(p, ph);
+
+			A.multiply(ph, v);
+
+			T r0v = K::dot(r0, v, n);
+
+			if (r0v==T(0))
+				break;
+
+			alpha = rho / r0v;
+
+			K::for_blocks(n, [=](unsigned int begin, unsigned int end) {
+
+				for (unsigned int k=begin; k<end; k++)
+					s[k] = r[k] - alpha * v[k];
+			});
+
+			it++;
+
+			T normS = std::sqrt(K::dot(s, s, n)) / normB;
+
+			if (normS <= tolerance) {
+
+				// half step converged - x += alpha (M^-1)p
+				K::for_blocks(n, [=](unsigned int begin, unsigned int end) {
+
+					for (unsigned int k=begin; k<end; k++)
+						x_[k] += alpha * ph[k];
+				});
+
+				residual = normS;
+				break;
+			}
+
+			// t = A(M^-1)s
+			M.apply(s, sh);
+
+			A.multiply(sh, t);
+
+			T tt = K::dot(t, t, n);
+
+			omega = (tt==T(0)) ? T(0) : K::dot(t, s, n) / tt;
+
+			K::for_blocks(n, [=](unsigned int begin, unsigned int end) {
+
+				for (unsigned int k=begin; k<end; k++) {
+
+					x_[k] += alpha * ph[k] + omega * sh[k];
+					r[k] = s[k] - omega * t[k];
+				}
+			});
+
+			residual = std::sqrt(K::dot(r, r, n)) / normB;
+
+			if (omega==T(0))
+				break;
+		}
+
+		*x = matrix<T>(n, 1);
+		std::copy(x_, x_ + n, x->data());
+
+		if (aux) {
+
+			aux->iterations = it;
+			aux->residual = residual;
+		}
+
+		if (residual <= tolerance)
+			return gu_sparse_converged;
+		else
+			return (it < maxIterations) ? gu_sparse_breakdown : gu_sparse_not_converged;
+	}
+
+}
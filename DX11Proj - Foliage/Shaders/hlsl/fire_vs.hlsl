@@ -21,7 +21,7 @@ cbuffer basicCBuffer : register(b0) {
 	float4				lightAmbient;				// Not used
 	float4				lightDiffuse;				// Not used
 	float4				lightSpecular;				// Not used
-	float				Timer;
+	float				Timer;						// Not used
 };
 
 
@@ -35,7 +35,7 @@ struct vertexInputPacket {
 	float3 pos : POSITION;   // in object space
 	float3 posL : LPOS;   // in object space
 	float3 vel :VELOCITY;   // in object space
-	float3 data : DATA;
+	float3 data : DATA;		// x = age, y = lifetime, z = billboard scale
 };
 
 
@@ -50,16 +50,14 @@ struct vertexOutputPacket {
 //-----------------------------------------------------------------
 vertexOutputPacket main(vertexInputPacket vin) {
 
-	float gPartLife = 0.7;//seconds
 	float gPartScale = 0.2;
-	float gPartSpeed = 2;
 
 	vertexOutputPacket vout = (vertexOutputPacket)0;
 
-	float age = vin.data.x;
-	float ptime = fmod(Timer + (age*gPartLife), gPartLife);
-	float size = (gPartScale*ptime) + (gPartScale * 2);
-	vout.alpha = 1 - (ptime / gPartLife);
+	// Particles are simulated on the CPU (ParticleSystem / ParticleEffects).  data.x = age and data.y = lifetime in seconds.  data.z scales the billboard of effects that are transformed to world space on the CPU
+	float ptime = vin.data.x;
+	float size = ((gPartScale*ptime) + (gPartScale * 2)) * vin.data.z;
+	vout.alpha = 1 - saturate(ptime / vin.data.y);
 
 	// Compute world matrix so that billboard faces the camera.
 	float3 look = normalize(eyePos - vin.pos);
@@ -67,12 +65,9 @@ vertexOutputPacket main(vertexInputPacket vin) {
 		float3 up = cross(look, right);
 
 
-		// Transform to world space.
 		// Transform to world space.
 		float3 pos = vin.pos +(vin.posL.x*right*size) + (vin.posL.y*up*size * 2);
 
-		pos += ptime*vin.vel*gPartSpeed;
-
 	// Transform to homogeneous clip space.
 	vout.posH = mul(float4(pos, 1.0f), viewProjMatrix);
 
@@ -0,0 +1,52 @@
+
+//
+// Gerstner waves - shared declarations
+//
+
+// Must match GERSTNER_MAX_WAVES in GerstnerWaves.h
+#define GERSTNER_MAX_WAVES 8
+
+
+// Single wave (GerstnerWave)
+struct GerstnerWave {
+
+	float2				direction;					// Unit direction of travel
+	float				amplitude;
+	float				wavenumber;
+	float				angularFrequency;			// Not used - the time is folded into timePhase on the CPU
+	float				steepness;
+	float				phase;
+	float				timePhase;
+};
+
+
+// Wave set written each frame from GerstnerWaves::getConstants (GerstnerWaveCBuffer)
+cbuffer gerstnerCBuffer : register(b2) {
+
+	GerstnerWave		waves[GERSTNER_MAX_WAVES];
+	uint				numWaves;
+};
+
+
+// Displacement of the point p on the undisplaced plane and the unnormalised surface normal.  Must match GerstnerWaves::evaluate4
+void evaluateGerstnerWaves(float2 p, out float3 displacement, out float3 normal) {
+
+	displacement = float3(0, 0, 0);
+	normal = float3(0, 1, 0);
+
+	for (uint i = 0; i < numWaves; i++) {
+
+		GerstnerWave w = waves[i];
+
+		float theta = dot(p, w.direction) * w.wavenumber + w.timePhase;
+		float S, C;
+
+		sincos(theta, S, C);
+
+		float QAC = w.steepness * w.amplitude * C;
+		float kAC = w.wavenumber * w.amplitude * C;
+
+		displacement += float3(QAC * w.direction.x, w.amplitude * S, QAC * w.direction.y);
+		normal -= float3(kAC * w.direction.x, w.steepness * w.wavenumber * w.amplitude * S, kAC * w.direction.y);
+	}
+}
@@ -0,0 +1,48 @@
+
+//
+// GPU particle simulation - shared declarations
+//
+
+// Must match GPU_PARTICLES_GROUP_SIZE in GPUParticles.h
+#define GPU_PARTICLES_GROUP_SIZE 256
+
+
+// Particle as stored in the particle buffers (GPUParticle)
+struct Particle {
+
+	float3				pos;
+	float				age;
+	float3				vel;
+	float				life;
+};
+
+
+// ParticleEmitter followed by the per-step values (GPUParticleConstants)
+cbuffer particleCBuffer : register(b0) {
+
+	float3				emitPosition;
+	float				emitRate;					// Not used - the CPU works out emitCount
+	float3				positionSpread;
+	float				lifeMin;
+	float3				emitVelocity;
+	float				lifeMax;
+	float3				velocitySpread;
+	float				drag;
+	float3				gravity;
+	float				groundHeight;
+	float				restitution;
+	float3				emitterPadding;
+
+	float				dt;
+	uint				emitCount;
+	uint				seed;
+	uint				capacity;
+};
+
+
+// Live particle count written by CopyStructureCount
+cbuffer particleCountCBuffer : register(b1) {
+
+	uint				numParticles;
+	uint3				countPadding;
+};
@@ -0,0 +1,59 @@
+
+//
+// GPU particle simulation - emit pass
+//
+
+#include "gpu_particles.hlsli"
+
+
+AppendStructuredBuffer<Particle>	particles : register(u0);
+
+
+// Seed a per-thread random sequence from the thread index and the per-step seed
+uint hash(uint x) {
+
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+
+	return x;
+}
+
+
+// Uniform random number in [-1, 1] (xorshift32 as ParticleSystem::randomSigned)
+float randomSigned(inout uint state) {
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	return (float)(state >> 8) * (2.0 / 16777216.0) - 1.0;
+}
+
+
+// Emit one particle from the emitter box.  numParticles is the live count after the simulate pass so emission stops when the buffer is full
+[numthreads(GPU_PARTICLES_GROUP_SIZE, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID) {
+
+	if (id.x >= min(emitCount, capacity - numParticles))
+		return;
+
+	uint state = max(hash(id.x ^ seed), 1);
+
+	Particle p;
+
+	p.pos.x = emitPosition.x + randomSigned(state) * positionSpread.x;
+	p.pos.y = emitPosition.y + randomSigned(state) * positionSpread.y;
+	p.pos.z = emitPosition.z + randomSigned(state) * positionSpread.z;
+
+	p.vel.x = emitVelocity.x + randomSigned(state) * velocitySpread.x;
+	p.vel.y = emitVelocity.y + randomSigned(state) * velocitySpread.y;
+	p.vel.z = emitVelocity.z + randomSigned(state) * velocitySpread.z;
+
+	p.age = 0.0;
+	p.life = lifeMin + (randomSigned(state) * 0.5 + 0.5) * (lifeMax - lifeMin);
+
+	particles.Append(p);
+}
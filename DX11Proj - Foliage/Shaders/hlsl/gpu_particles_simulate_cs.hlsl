@@ -0,0 +1,38 @@
+
+//
+// GPU particle simulation - simulate pass
+//
+
+#include "gpu_particles.hlsli"
+
+
+ConsumeStructuredBuffer<Particle>	currentParticles : register(u0);
+AppendStructuredBuffer<Particle>	nextParticles : register(u1);
+
+
+// Integrate one particle with semi-implicit Euler (as ParticleSystem::IntegrateParticles) and keep it if it is still alive
+[numthreads(GPU_PARTICLES_GROUP_SIZE, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID) {
+
+	if (id.x >= numParticles)
+		return;
+
+	Particle p = currentParticles.Consume();
+
+	p.vel = p.vel * max(1.0 - drag * dt, 0.0) + gravity * dt;
+	p.pos += p.vel * dt;
+
+	// Particles that pass below the ground are put back on it and their vertical velocity reflected
+	if (p.pos.y < groundHeight) {
+
+		p.pos.y = groundHeight;
+
+		if (p.vel.y < 0.0)
+			p.vel.y *= -restitution;
+	}
+
+	p.age += dt;
+
+	if (p.age < p.life)
+		nextParticles.Append(p);
+}
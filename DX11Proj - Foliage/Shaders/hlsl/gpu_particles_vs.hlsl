@@ -0,0 +1,90 @@
+
+//
+// GPU particle simulation - billboard vertex shader
+//
+
+// Ensure matrices are row-major
+#pragma pack_matrix(row_major)
+
+
+//-----------------------------------------------------------------
+// Globals
+//-----------------------------------------------------------------
+
+// Same layout as fire_vs
+cbuffer basicCBuffer : register(b0) {
+
+	float4x4			viewProjMatrix;
+	float4x4			worldITMatrix;				// Not used
+	float4x4			worldMatrix;				// Not used
+	float4				eyePos;
+	float4				windDir;					// Not used
+	float4				lightVec;					// Not used
+	float4				lightAmbient;				// Not used
+	float4				lightDiffuse;				// Not used
+	float4				lightSpecular;				// Not used
+	float				Timer;						// Not used
+};
+
+
+// Particle as stored in the particle buffers (see gpu_particles.hlsli, which is not included here since its constant buffers also use b0)
+struct Particle {
+
+	float3				pos;
+	float				age;
+	float3				vel;
+	float				life;
+};
+
+
+// Live particles written by the simulate and emit passes
+StructuredBuffer<Particle> particles : register(t0);
+
+
+//-----------------------------------------------------------------
+// Input / Output structures
+//-----------------------------------------------------------------
+
+struct vertexOutputPacket {
+
+	float4 posH  : SV_POSITION;  // in clip space
+	float2 texCoord  : TEXCOORD0;
+	float alpha : ALPHA;
+};
+
+
+// Quad corners and the corner used by each of the 6 vertices (the same triangles as the Particles index buffer)
+static const float2 corners[4] = { float2(-1, -1), float2(-1, 1), float2(1, 1), float2(1, -1) };
+static const uint quadCorner[6] = { 2, 1, 0, 0, 3, 2 };
+
+
+//-----------------------------------------------------------------
+// Vertex Shader
+//-----------------------------------------------------------------
+vertexOutputPacket main(uint vertexID : SV_VertexID, uint instanceID : SV_InstanceID) {
+
+	float gPartScale = 0.2;
+
+	vertexOutputPacket vout = (vertexOutputPacket)0;
+
+	// One instance per particle - see fire_vs for the billboard
+	Particle p = particles[instanceID];
+	float2 posL = corners[quadCorner[vertexID]];
+
+	float size = (gPartScale*p.age) + (gPartScale * 2);
+	vout.alpha = 1 - saturate(p.age / p.life);
+
+	// Compute world matrix so that billboard faces the camera.
+	float3 look = normalize(eyePos.xyz - p.pos);
+	float3 right = normalize(cross(float3(0, 1, 0), look));
+	float3 up = cross(look, right);
+
+	// Transform to world space.
+	float3 pos = p.pos + (posL.x*right*size) + (posL.y*up*size * 2);
+
+	// Transform to homogeneous clip space.
+	vout.posH = mul(float4(pos, 1.0f), viewProjMatrix);
+
+	vout.texCoord = float2((posL.x + 1)*0.5, (posL.y + 1)*0.5);
+	return vout;
+}
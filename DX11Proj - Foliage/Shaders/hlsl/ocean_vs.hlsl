@@ -11,10 +11,16 @@ Based partly on "Effective Water Simulation From Physical Models", GPU Gems
 // Ensure matrices are row-major
 #pragma pack_matrix(row_major)
 
+#include "gerstner_waves.hlsli"
+
 //-----------------------------------------------------------------
 // Globals
 //-----------------------------------------------------------------
-#define NWAVES 2
+
+// Wave displacement (dx, height, dz, Jacobian) and normal maps written each frame from the CPU OceanSpectrum
+Texture2D displacementMap : register(t0);
+Texture2D waveNormalMap : register(t1);
+SamplerState waveMapSampler : register(s0);
 
 cbuffer basicCBuffer : register(b0) {
 
@@ -31,6 +37,14 @@ cbuffer basicCBuffer : register(b0) {
 	float				grassHeight;
 };
 
+// Mapping from object space to the wave maps (see OceanMapCBuffer)
+cbuffer oceanMapCBuffer : register(b1) {
+
+	float				mapScale;					// Wave map repeats per object-space unit (0 if there are no maps)
+	float				displacementScale;			// Object-space units per metre of displacement
+	float				metresPerUnit;				// Object space to Gerstner wave space
+};
+
 
 
 
@@ -60,25 +74,6 @@ struct vertexOutputPacket {
 	float4				posH		: SV_POSITION;  // in clip space
 };
 
-// wave structures and functions ///////////////////////
-struct Wave {
-	float				freq;						// 2*PI / wavelength
-	float				amp;						// amplitude
-	float				phase;						// speed * 2*PI / wavelength
-	float2				dir;
-};
-
-float evaluateWave(Wave w, float2 pos, float t)
-{
-	return w.amp * sin(dot(w.dir, pos)*w.freq + t*w.phase);
-}
-
-// derivative of wave function
-float evaluateWaveDeriv(Wave w, float2 pos, float t)
-{
-	return w.freq*w.amp * cos(dot(w.dir, pos)*w.freq + t*w.phase);
-}
-
 //-----------------------------------------------------------------
 // Vertex Shader
 //-----------------------------------------------------------------
@@ -95,33 +90,29 @@ vertexOutputPacket main(vertexInputPacket IN) {
 	float2				TextureScale = float2(TexReptX, TexReptY);
 	float2				BumpSpeed = float2(BumpSpeedX, BumpSpeedY);
 
-	float				WaveAmp = 0.05;
-	float				WaveFreq = 1.0;
+	// Displace the flat grid by the wave maps.  The maps tile so the coordinates are not wrapped
+	float2 mapUV = IN.pos.xz * mapScale;
+	float4 D = displacementMap.SampleLevel(waveMapSampler, mapUV, 0);
 
-	Wave wave[NWAVES] = {
-		{ WaveFreq, WaveAmp, 0.5, float2(-0.5, 0.6) },
-		{ WaveFreq * 2, WaveAmp*0.5, 1.3, float2(0.7, 0.7) }
-	};
+	// Swell from the Gerstner waves (evaluated in metres) is added to the wave maps
+	float3 G, GN;
+	evaluateGerstnerWaves(IN.pos.xz * metresPerUnit, G, GN);
 
-	float4 Po = float4(IN.pos.xyz, 1.0);
-	
-	// sum waves	
-	Po.y = 0.0;
-	// Compute y displacement and derivative for the waves defined above
-	// Add Code Here (Compute y displacement and derivative)
-	float ddx = 0.0, ddy = 0.0;
-	for (int i = 0; i<NWAVES; i++) {
-		Po.y += evaluateWave(wave[i], Po.xz, Timer / 2);
-		float deriv = evaluateWaveDeriv(wave[i], Po.xz, Timer / 2);
-		ddx += deriv * wave[i].dir.x;
-		ddy += deriv * wave[i].dir.y;
-	}
-
-
-	// compute tangent basis
-	float3 B = float3(1, ddx, 0);
-	float3 T = float3(0, ddy, 1);
-	float3 N = float3(-ddx, 1, -ddy);
+	float4 Po = float4(IN.pos.x, 0.0, IN.pos.z, 1.0);
+	Po.xyz += (D.xyz + G) * displacementScale;
+
+	// Without wave maps the map surface is flat
+	float3 NM = float3(0, 1, 0);
+
+	if (mapScale > 0.0)
+		NM = normalize(waveNormalMap.SampleLevel(waveMapSampler, mapUV, 0).xyz * 2.0 - 1.0);
+
+	// Sum the slopes of the two surfaces
+	float3 N = normalize(float3(NM.x / NM.y + GN.x / GN.y, 1.0, NM.z / NM.y + GN.z / GN.y));
+
+	// compute tangent basis from the surface slopes (ddx = -N.x / N.y, ddy = -N.z / N.y)
+	float3 B = float3(N.y, -N.x, 0);
+	float3 T = float3(0, -N.z, N.y);
 
 	OUT.posH = mul(Po, worldViewProjMatrix);
 
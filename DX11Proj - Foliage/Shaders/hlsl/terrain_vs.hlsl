@@ -0,0 +1,120 @@
+
+//
+// Terrain - CDLOD chunk vertex shader for the grass shells (see TerrainQuadtree.h)
+//
+
+// Ensure matrices are row-major
+#pragma pack_matrix(row_major)
+
+//-----------------------------------------------------------------
+// Globals
+//-----------------------------------------------------------------
+
+cbuffer basicCBuffer : register(b0) {
+
+	float4x4			worldViewProjMatrix;
+	float4x4			worldITMatrix;				// Correctly transform normals to world space
+	float4x4			worldMatrix;
+	float4				eyePos;
+	float4				windDir;					// x = world-space sway of the top of the grass
+	float4				lightVec;					// w=1: Vec represents position, w=0: Vec  represents direction.
+	float4				lightAmbient;
+	float4				lightDiffuse;
+	float4				lightSpecular;
+	float				Timer;
+	float				grassHeight;
+};
+
+
+cbuffer terrainCBuffer : register(b1) {
+
+	float4				originHeightScale;			// xyz = terrain origin, w = height scale
+	float4				quadSizeTexel;				// xy = world size of a heightmap quad, zw = 1 / heightmap dimensions
+};
+
+
+
+
+//-----------------------------------------------------------------
+// Input / Output structures
+//-----------------------------------------------------------------
+struct vertexInputPacket {
+
+	float2				gridPos		: POSITION;		// Integer grid mesh coordinates
+	float4				chunkOffset	: CHUNK0;		// xy = chunk origin in heightmap quads, z = heightmap quads per grid quad, w = level
+	float4				chunkMorph	: CHUNK1;		// x = morph start distance, y = morph scale
+};
+
+
+struct vertexOutputPacket {
+
+
+	// Vertex in world coords
+	float3				posW			: POSITION;
+	// Normal in world coords
+	float3				normalW			: NORMAL;
+	float4				matDiffuse		: DIFFUSE;
+	float4				matSpecular		: SPECULAR;
+	float2				texCoord		: TEXCOORD;
+	float4				posH			: SV_POSITION;
+};
+
+
+Texture2D heightTexture : register(t0);
+SamplerState heightSampler : register(s0);
+
+
+// World-space height at heightmap quad coordinate q.  Sample centres lie on integer quad coordinates
+float terrainHeight(float2 q) {
+
+	return originHeightScale.y + heightTexture.SampleLevel(heightSampler, (q + 0.5) * quadSizeTexel.zw, 0).r * originHeightScale.w;
+}
+
+
+float3 terrainPosition(float2 q) {
+
+	return float3(originHeightScale.x + q.x * quadSizeTexel.x, terrainHeight(q), originHeightScale.z + q.y * quadSizeTexel.y);
+}
+
+
+//-----------------------------------------------------------------
+// Vertex Shader
+//-----------------------------------------------------------------
+vertexOutputPacket main(vertexInputPacket inputVertex) {
+
+	vertexOutputPacket outputVertex;
+
+	// Morph odd grid vertices onto the next coarser grid as the vertex approaches the end of its LOD range (TerrainQuadtree::morphVertex)
+	float2 gridPos = inputVertex.gridPos;
+	float3 pos = terrainPosition(inputVertex.chunkOffset.xy + gridPos * inputVertex.chunkOffset.z);
+
+	float k = saturate((distance(pos, eyePos.xyz) - inputVertex.chunkMorph.x) * inputVertex.chunkMorph.y);
+
+	gridPos -= fmod(gridPos, 2.0) * k;
+
+	float2 q = inputVertex.chunkOffset.xy + gridPos * inputVertex.chunkOffset.z;
+
+	pos = terrainPosition(q);
+
+	// Normal from the central differences of the neighbouring heightmap samples
+	float hL = terrainHeight(q - float2(1.0, 0.0));
+	float hR = terrainHeight(q + float2(1.0, 0.0));
+	float hD = terrainHeight(q - float2(0.0, 1.0));
+	float hU = terrainHeight(q + float2(0.0, 1.0));
+
+	outputVertex.normalW = normalize(float3((hL - hR) / (2.0 * quadSizeTexel.x), 1.0, (hD - hU) / (2.0 * quadSizeTexel.y)));
+
+	// The terrain is defined in world space
+	outputVertex.posW = pos;
+	outputVertex.matDiffuse = float4(1.0, 1.0, 1.0, 1.0);
+	outputVertex.matSpecular = float4(0.0, 0.0, 0.0, 0.0);
+	outputVertex.texCoord = q * quadSizeTexel.zw;
+
+	// Shells sway with the wind by the cube of their height
+	float sway = pow(grassHeight * 100, 3);
+	pos.x += sin(Timer) * windDir.x * sway;
+
+	outputVertex.posH = mul(float4(pos, 1.0), worldViewProjMatrix);
+
+	return outputVertex;
+}
@@ -0,0 +1,104 @@
+
+//
+// DXBoundingVolume.cpp
+//
+
+#include <stdafx.h>
+#include <DXBoundingVolume.h>
+
+using namespace DirectX;
+
+
+DXBoundingVolume::DXBoundingVolume(const XMFLOAT3& initCentre, const XMFLOAT3& initExtents) {
+
+	centre = initCentre;
+	extents = initExtents;
+	XMStoreFloat(&radius, XMVector3Length(XMLoadFloat3(&extents)));
+}
+
+
+// Calculate the bounding volume of count points
+DXBoundingVolume DXBoundingVolume::FromPoints(const XMFLOAT3 *points, const uint32_t count, const uint32_t stride) {
+
+	if (!points || count == 0)
+		return DXBoundingVolume();
+
+	XMVECTOR vMin = XMLoadFloat3(points);
+	XMVECTOR vMax = vMin;
+
+	const uint8_t *ptr = (const uint8_t*)points + stride;
+
+	for (uint32_t i = 1; i < count; ++i, ptr += stride) {
+
+		XMVECTOR P = XMLoadFloat3((const XMFLOAT3*)ptr);
+
+		vMin = XMVectorMin(vMin, P);
+		vMax = XMVectorMax(vMax, P);
+	}
+
+	XMFLOAT3 C, E;
+
+	XMStoreFloat3(&C, XMVectorScale(XMVectorAdd(vMin, vMax), 0.5f));
+	XMStoreFloat3(&E, XMVectorScale(XMVectorSubtract(vMax, vMin), 0.5f));
+
+	DXBoundingVolume B = DXBoundingVolume(C, E);
+
+	// The sphere enclosing the box is often loose for elongated meshes, so tighten the radius against the actual points (the centre is kept so the box and sphere tests share it)
+	XMVECTOR vC = XMLoadFloat3(&C);
+	XMVECTOR maxDistSq = XMVectorZero();
+
+	ptr = (const uint8_t*)points;
+
+	for (uint32_t i = 0; i < count; ++i, ptr += stride)
+		maxDistSq = XMVectorMax(maxDistSq, XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3((const XMFLOAT3*)ptr), vC)));
+
+	XMStoreFloat(&B.radius, XMVectorSqrt(maxDistSq));
+
+	return B;
+}
+
+
+// Return the bounding volume enclosing both A and B
+DXBoundingVolume DXBoundingVolume::Merge(const DXBoundingVolume& A, const DXBoundingVolume& B) {
+
+	XMVECTOR cA = XMLoadFloat3(&A.centre);
+	XMVECTOR eA = XMLoadFloat3(&A.extents);
+	XMVECTOR cB = XMLoadFloat3(&B.centre);
+	XMVECTOR eB = XMLoadFloat3(&B.extents);
+
+	XMVECTOR vMin = XMVectorMin(XMVectorSubtract(cA, eA), XMVectorSubtract(cB, eB));
+	XMVECTOR vMax = XMVectorMax(XMVectorAdd(cA, eA), XMVectorAdd(cB, eB));
+
+	XMFLOAT3 C, E;
+
+	XMStoreFloat3(&C, XMVectorScale(XMVectorAdd(vMin, vMax), 0.5f));
+	XMStoreFloat3(&E, XMVectorScale(XMVectorSubtract(vMax, vMin), 0.5f));
+
+	return DXBoundingVolume(C, E);
+}
+
+
+// Return the world-space bounding volume under the affine transform W (row-vector convention as used by DirectXMath)
+DXBoundingVolume DXBoundingVolume::transform(FXMMATRIX W) const {
+
+	XMVECTOR C = XMVector3Transform(XMLoadFloat3(&centre), W);
+
+	// Arvo: the new half extents are |W3x3|^T applied to the old half extents
+	XMVECTOR E = XMVectorMultiply(XMVectorAbs(W.r[0]), XMVectorSplatX(XMLoadFloat3(&extents)));
+	E = XMVectorMultiplyAdd(XMVectorAbs(W.r[1]), XMVectorSplatY(XMLoadFloat3(&extents)), E);
+	E = XMVectorMultiplyAdd(XMVectorAbs(W.r[2]), XMVectorSplatZ(XMLoadFloat3(&extents)), E);
+
+	DXBoundingVolume B;
+
+	XMStoreFloat3(&B.centre, C);
+	XMStoreFloat3(&B.extents, E);
+
+	// Scale the sphere by the largest axis scale factor so the sphere stays conservative under non-uniform scaling
+	XMVECTOR sx = XMVector3LengthSq(W.r[0]);
+	XMVECTOR sy = XMVector3LengthSq(W.r[1]);
+	XMVECTOR sz = XMVector3LengthSq(W.r[2]);
+
+	XMStoreFloat(&B.radius, XMVectorMultiply(XMVectorSqrt(XMVectorMax(sx, XMVectorMax(sy, sz))), XMVectorReplicate(radius)));
+
+	return B;
+}
@@ -0,0 +1,32 @@
+
+//
+// DXBoundingVolume.h
+//
+
+// Model a combined axis-aligned bounding box (centre / half extents) and bounding sphere (centre / radius) used for visibility tests.  Both volumes share the same centre so a single structure can be tested with either the sphere or box test.
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+
+
+struct DXBoundingVolume {
+
+	DirectX::XMFLOAT3					centre;
+	DirectX::XMFLOAT3					extents; // Half extents of the AABB along the principle axes
+	float								radius;
+
+	DXBoundingVolume() : centre(0.0f, 0.0f, 0.0f), extents(0.0f, 0.0f, 0.0f), radius(0.0f) {}
+
+	DXBoundingVolume(const DirectX::XMFLOAT3& initCentre, const DirectX::XMFLOAT3& initExtents);
+
+	// Calculate the bounding volume of count points.  stride is the size in bytes between successive points so the position field of an interleaved vertex buffer (eg. DXVertexExt) can be read directly
+	static DXBoundingVolume FromPoints(const DirectX::XMFLOAT3 *points, const uint32_t count, const uint32_t stride = sizeof(DirectX::XMFLOAT3));
+
+	// Return the bounding volume enclosing both A and B
+	static DXBoundingVolume Merge(const DXBoundingVolume& A, const DXBoundingVolume& B);
+
+	// Return the world-space bounding volume for the given (object-space) volume under the affine transform W.  The box is transformed with Arvo's method so the result is the tightest AABB enclosing the transformed box
+	DXBoundingVolume transform(DirectX::FXMMATRIX W) const;
+};
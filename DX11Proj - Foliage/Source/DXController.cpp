@@ -14,7 +14,33 @@
 #include <GUClock.h>
 #include <DXModel.h>
 #include <LookAtCamera.h>
+#include <DXFrustumCuller.h>
+#include <DXSceneGraph.h>
+#include <DXInstanceBVH.h>
+#include <DXOcclusionCuller.h>
+#include <GUProfiler.h>
+#include <HeightField.h>
+#include <GUParallel.h>
+#include <GUFrameAllocator.h>
+#include <GPUParticles.h>
+#include <OceanSpectrum.h>
+#include <GerstnerWaves.h>
+#include <OceanGrid.h>
 #define	NUM_TREES 10
+#define	TERRAIN_OCCLUDER_RES 32
+// Effect slots and particle blocks (PARTICLE_EFFECT_BLOCK_SIZE particles each) of the particle effect pool
+#define	MAX_PARTICLE_EFFECTS 32
+#define	PARTICLE_EFFECT_BLOCKS 128
+// Capacity of the GPU simulated fire.  0 simulates the fire on the CPU so it can be depth sorted
+#define	FIRE_GPU_PARTICLES 0
+// Resolution of the ocean wave maps (a power of two) and the scale of the water mesh (metres per object-space unit)
+#define	OCEAN_FFT_SIZE 128
+#define	WATER_SCALE 5.0f
+// Vertices across and up the screen range of the water's projected grid (about one vertex every 10 pixels at 1920 x 1080)
+#define	OCEAN_GRID_WIDTH 192
+#define	OCEAN_GRID_HEIGHT 108
+// Size in bytes of each thread's per-frame arena
+#define	FRAME_ARENA_SIZE (256 * 1024)
 
 using namespace std;
 using namespace DirectX;
@@ -148,7 +174,7 @@ DXController::DXController(const LONG _width, const LONG _height, const wchar_t*
 	
 
 		// 6. Create DirectX host environment (associated with main application wnd)
-		dx = DXSystem::CreateDirectXSystem(wndHandle);
+		dx.reset(DXSystem::CreateDirectXSystem(wndHandle));
 
 		if (!dx)
 			throw exception("Cannot create Direct3D device and context model");
@@ -161,11 +187,39 @@ DXController::DXController(const LONG _width, const LONG _height, const wchar_t*
 
 
 		// 8. Create main clock / FPS timer (do this last with deferred start of 3 seconds so min FPS / SPF are not skewed by start-up events firing and taking CPU cycles).
-		mainClock = GUClock::CreateClock(string("mainClock"), 3.0f);
+		mainClock.reset(GUClock::CreateClock(string("mainClock"), 3.0f));
 
 		if (!mainClock)
 			throw exception("Cannot create main clock / timer");
 
+		// 9. Create profiler to time CPU-side sections of the frame
+		profiler.reset(GUProfiler::CreateProfiler());
+
+		if (!profiler)
+			throw exception("Cannot create profiler");
+
+		frustumCullSection = profiler->registerSection(string("Frustum cull"));
+		treeCullSection = profiler->registerSection(string("Tree BVH cull"));
+		occluderSection = profiler->registerSection(string("Occluder raster"));
+		occlusionTestSection = profiler->registerSection(string("Occlusion test"));
+		grassLODSection = profiler->registerSection(string("Grass LOD"));
+		terrainSection = profiler->registerSection(string("Terrain LOD"));
+		particleSection = profiler->registerSection(string("Particles"));
+		oceanSection = profiler->registerSection(string("Ocean FFT"));
+		transformSection = profiler->registerSection(string("Transforms"));
+
+		// 10. Create thread pool for data-parallel CPU work (particle simulation etc)
+		threadPool.reset(GUParallel::CreateThreadPool());
+
+		if (!threadPool)
+			throw exception("Cannot create thread pool");
+
+		// 11. Create the per-frame allocator for transient CPU data (culling lists etc)
+		frameAllocator.reset(GUFrameAllocator::CreateFrameAllocator(FRAME_ARENA_SIZE, threadPool->threadCount()));
+
+		if (!frameAllocator)
+			throw exception("Cannot create frame allocator");
+
 	}
 	catch (exception &e)
 	{
@@ -234,7 +288,7 @@ DXController::~DXController() {
 
 
 	// Release VertexShader interface
-	grassVS->Release();
+	terrainVS->Release();
 	// Release PixelShader interface
 	grassPS->Release();
 	// Release VertexShader interface
@@ -263,43 +317,8 @@ DXController::~DXController() {
 
 	if (projMatrix)
 		_aligned_free(projMatrix);
-	if (treeInstance)
-		_aligned_free(treeInstance);
-
-	if (mainCamera)
-		mainCamera->release();
-
-	if (mainClock)
-		mainClock->release();
-	// Release skyBox
-	
-	if (floor)
-		floor->release();
-	if (tree)
-		tree->release();
-	if (logs)
-		logs->release();
-	if (castle)
-        castle->release();
-
-	if (water)
-		water->release();
-	
-
-	// Release skyBox
-	if (skyBox)
-		skyBox->release();
-	if (fire)
-		fire->release();
 
-	// Release Box
-	
-
-	if (dx) {
-
-		dx->release();
-		dx = nullptr;
-	}
+	// The scene objects are held by GURef members and released after this in reverse declaration order, so dx (declared first) outlives the objects created on its device
 
 	if (wndHandle)
 		DestroyWindow(wndHandle);
@@ -368,6 +387,9 @@ void DXController::reportTimingData() {
 	cout << "Actual time elapsed = " << mainClock->actualTimeElapsed() << endl;
 	cout << "Game time elapsed = " << mainClock->gameTimeElapsed() << endl << endl;
 	mainClock->reportTimingData();
+
+	if (profiler)
+		profiler->reportTimingData();
 }
 
 
@@ -382,6 +404,8 @@ void DXController::handleMouseLDrag(const POINT &disp) {
 
 	mainCamera->rotateElevation((float)-disp.y * 0.01f);
 	mainCamera->rotateOnYAxis((float)-disp.x * 0.01f);
+
+	constrainCamera();
 }
 
 // Process mouse wheel movement
@@ -391,6 +415,8 @@ void DXController::handleMouseWheel(const short zDelta) {
 		mainCamera->zoomCamera(1.2f);
 	else if (zDelta>0)
 		mainCamera->zoomCamera(0.9f);
+
+	constrainCamera();
 }
 
 
@@ -398,6 +424,8 @@ void DXController::handleMouseWheel(const short zDelta) {
 void DXController::handleKeyDown(const WPARAM keyCode, const LPARAM extKeyFlags) {
 
 	// Add key down handler here...
+	if (keyCode == 'P')
+		pickTree();
 }
 
 
@@ -443,6 +471,7 @@ HRESULT DXController::rebuildViewport(){
 	
 	// Compute the projection matrix.
 	projMatrix->projMatrix = XMMatrixPerspectiveFovLH(0.25f*3.14, viewport.Width / viewport.Height, 1.0f, 1000.0f);
+	pixelScale = XMVectorGetY(projMatrix->projMatrix.r[1]) * viewport.Height * 0.5f;
 	return S_OK;
 }
 
@@ -616,17 +645,65 @@ HRESULT DXController::initialiseSceneResources() {
 	// Allocate the projection matrix (it is setup in rebuildViewport).
 	projMatrix = (projMatrixStruct*)_aligned_malloc(sizeof(projMatrixStruct), 16);
 
-	// Allocate the world matrices for the  tree instances
-	treeInstance = (worldMatrixStruct*)_aligned_malloc(sizeof(worldMatrixStruct)*NUM_TREES, 16);
-	// Setup tree instance positions
+	// Load the terrain heightmap on the CPU so objects can be placed on the ground
+	heightField.reset(new HeightField(string("Resources\\Textures\\heightmap.bmp"), XMFLOAT3(-25.0f, 0.0f, -25.0f), XMFLOAT2(50.0f, 50.0f), 2.5f));
+
+	// Setup tree instance positions.  Trees are scattered randomly and stand on the terrain
+	float treeX[NUM_TREES], treeZ[NUM_TREES], treeY[NUM_TREES];
+
+	for (int i = 0; i < NUM_TREES; i++)
+	{
+		treeX[i] = randM1P1()*forestSize;
+		treeZ[i] = randM1P1()*forestSize;
+	}
+
+	heightField->heights(treeX, treeZ, treeY, NUM_TREES);
+
+	// Each tree is an entity.  Its matrices and world bounds are built by the transform system once the tree model's bounds are known (see initialiseCulling)
+	entityWorld.reset(new DXEntityWorld());
+	entitySystems.reset(new DXEntitySystems());
+
+	const uint32_t treeComponents = DX_COMPONENT_BIT(DX_COMPONENT_TRANSFORM) | DX_COMPONENT_BIT(DX_COMPONENT_WORLD) | DX_COMPONENT_BIT(DX_COMPONENT_MESH) | DX_COMPONENT_BIT(DX_COMPONENT_MATERIAL) | DX_COMPONENT_BIT(DX_COMPONENT_BOUNDS);
+
+	treeEntity.resize(NUM_TREES);
 
 	for (int i = 0; i < NUM_TREES; i++)
 	{
+		treeEntity[i] = entityWorld->create(treeComponents);
+
 		// Translate and Rotate trees randomly
 		// Modify code here (randomly rotate trees)
-		treeInstance[i].worldMatrix = XMMatrixScaling(2.0, 2.0, 2.0)*XMMatrixTranslation(randM1P1()*forestSize, 1, randM1P1()*forestSize)*XMMatrixRotationY(0);
+		DXTransformComponent *T = entityWorld->get<DXTransformComponent>(treeEntity[i]);
+
+		T->scale = XMFLOAT3(2.0f, 2.0f, 2.0f);
+		T->rotation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		T->translation = XMFLOAT3(treeX[i], treeY[i], treeZ[i]);
+		T->dirty = 1;
+
+		entityWorld->get<DXMeshComponent>(treeEntity[i])->mesh = MESH_TREE;
+		entityWorld->get<DXMaterialComponent>(treeEntity[i])->material = MATERIAL_TREE;
 	}
 
+	// Place the remaining scene objects in the scene graph.  The logs, fire and smoke hang off a campfire node so moving the campfire moves them together
+	sceneGraph.reset(new DXSceneGraph());
+
+	XMFLOAT3 unitScale(1, 1, 1);
+	XMFLOAT4 noRotation(0.0f, 0.0f, 0.0f, 1.0f);
+	XMFLOAT4 logsRotation;
+
+	XMStoreFloat4(&logsRotation, XMQuaternionRotationRollPitchYaw(XMConvertToRadians(-90), 0, 0));
+
+	uint32_t campfireNode = sceneGraph->addNode(DX_SCENE_ROOT, unitScale, noRotation, XMFLOAT3(-15, 1.5f, -2));
+
+	objectNode[SCENE_CASTLE] = sceneGraph->addNode(DX_SCENE_ROOT, unitScale, noRotation, XMFLOAT3(-18.5f, 1, -20));
+	objectNode[SCENE_LOGS] = sceneGraph->addNode(campfireNode, XMFLOAT3(0.002f, 0.002f, 0.002f), logsRotation, XMFLOAT3(0, 0, 0));
+	objectNode[SCENE_WATER] = sceneGraph->addNode(DX_SCENE_ROOT, XMFLOAT3(WATER_SCALE, WATER_SCALE, WATER_SCALE), noRotation, XMFLOAT3(10, 1, 0));
+	objectNode[SCENE_FLOOR] = sceneGraph->addNode(DX_SCENE_ROOT, unitScale, noRotation, XMFLOAT3(0, 0, 0)); // Terrain is defined in world space
+	objectNode[SCENE_SMOKE] = sceneGraph->addNode(campfireNode, XMFLOAT3(0.25f, 0.25f, 0.25f), noRotation, XMFLOAT3(0, 0.5f, 0));
+	objectNode[SCENE_FIRE] = sceneGraph->addNode(campfireNode, XMFLOAT3(0.5f, 0.5f, 0.5f), noRotation, XMFLOAT3(0, 0.5f, 0));
+
+	sceneGraph->update();
+
 
 	rebuildViewport();
 	initDefaultPipeline();
@@ -635,7 +712,7 @@ HRESULT DXController::initialiseSceneResources() {
 	// Setup objects for the programmable (shader) stages of the pipeline
 	DXBlob *skyBoxVSBytecode = nullptr;
 	DXBlob *skyBoxPSBytecode = nullptr;
-	DXBlob *grassVSBytecode = nullptr;
+	DXBlob *terrainVSBytecode = nullptr;
 	DXBlob *grassPSBytecode = nullptr;
 	DXBlob *treeVSBytecode = nullptr;
 	DXBlob *treePSBytecode = nullptr;
@@ -654,7 +731,7 @@ HRESULT DXController::initialiseSceneResources() {
 
 	LoadShader(device, "Shaders\\cso\\sky_box_vs.cso", &skyBoxVSBytecode, &skyBoxVS);
 	LoadShader(device, "Shaders\\cso\\sky_box_ps.cso", &skyBoxPSBytecode, &skyBoxPS);
-	LoadShader(device, "Shaders\\cso\\grass_vs.cso", &grassVSBytecode, &grassVS);
+	LoadShader(device, "Shaders\\cso\\terrain_vs.cso", &terrainVSBytecode, &terrainVS);
 	LoadShader(device, "Shaders\\cso\\grass_ps.cso", &grassPSBytecode, &grassPS);
 	LoadShader(device, "Shaders\\cso\\tree_vs.cso", &treeVSBytecode, &treeVS);
 	LoadShader(device, "Shaders\\cso\\tree_ps.cso", &treePSBytecode, &treePS);
@@ -671,8 +748,9 @@ HRESULT DXController::initialiseSceneResources() {
 
 	// Create main camera
 	//
-	mainCamera = new LookAtCamera();
+	mainCamera.reset(new LookAtCamera());
 	mainCamera->setPos(XMVectorSet(25, 1, -14.5, 1));
+	constrainCamera();
 
 	// Setup tree CBuffer
 	cBufferExtSrc = (CBufferExt*)_aligned_malloc(sizeof(CBufferExt), 16);
@@ -748,25 +826,59 @@ HRESULT DXController::initialiseSceneResources() {
 	hr = CreateWICTextureFromFile(device, L"Resources\\Textures\\smoke.tif", &smokeResource, &smokeDiffuseMapSRV);
 
 
-	ID3D11Resource *grassNormalResource = static_cast<ID3D11Resource*>(grassNormalMap);
-	hr = CreateWICTextureFromFile(device, L"Resources\\Textures\\normalmap.bmp", &grassNormalResource, &grassNormalMapSRV);
-	ID3D11Resource *grassHeightResource = static_cast<ID3D11Resource*>(grassAlphaMap);
-	hr = CreateWICTextureFromFile(device, L"Resources\\Textures\\heightmapp.bmp", &grassHeightResource, &grassHeightMapSRV);
-
-
 	dx->getDeviceContext()->PSSetShaderResources(1, 1, &grassAlphaMapSRV);
-	dx->getDeviceContext()->VSSetShaderResources(1, 1, &grassNormalMapSRV);
-	dx->getDeviceContext()->VSSetShaderResources(0, 1, &grassHeightMapSRV);
 	
 	dx->getDeviceContext()->PSSetShaderResources(2, 1, &cubeMapTextureSRV);
 
-	castle = new DXModel(device, reflectionMapVSBytecode, wstring(L"Resources\\Models\\saintriqT3DS.obj"), CastleTextureSRV, XMCOLOR(1, 1, 1, 1), XMCOLOR(1, 1, 1, 0.5));
-	tree = new DXModel(device, treeVSBytecode, wstring(L"Resources\\Models\\tree.3ds"), treeTextureSRV, XMCOLOR(1.0, 1.0, 1.0, 1.0), XMCOLOR(0, 0, 0.0, 0.0));
-	//skyBox = new Box(device, skyBoxVSBytecode, cubeMapTextureSRV);
-	floor = new Grid(device, grassVSBytecode, grassDiffuseMapSRV);
-	water = new Ocean(device, oceanVSBytecode, waterNormalMapSRV);
-	logs = new DXModel(device, perPixelLightingVSBytecode, wstring(L"Resources\\Models\\logs.obj"), logsTextureSRV, XMCOLOR(1.0, 1.0, 1.0, 1.0), XMCOLOR(0, 0, 0.0, 0.0));
-	fire = new Particles(device, fireVSBytecode, fireDiffuseMapSRV);
+	castle.reset(new DXModel(device, reflectionMapVSBytecode, wstring(L"Resources\\Models\\saintriqT3DS.obj"), CastleTextureSRV, XMCOLOR(1, 1, 1, 1), XMCOLOR(1, 1, 1, 0.5)));
+	tree.reset(new DXModel(device, treeVSBytecode, wstring(L"Resources\\Models\\tree.3ds"), treeTextureSRV, XMCOLOR(1.0, 1.0, 1.0, 1.0), XMCOLOR(0, 0, 0.0, 0.0)));
+	//skyBox.reset(new Box(device, skyBoxVSBytecode, cubeMapTextureSRV));
+	terrain.reset(new Terrain(device, terrainVSBytecode, heightField.get(), grassDiffuseMapSRV));
+	// Moderate breeze over a lake.  Waves shorter than two grid spacings of the water mesh are left to the normal map ripples in ocean_ps
+	OceanSpectrumDesc oceanDesc;
+
+	oceanDesc.windSpeed = 6.0f;
+	oceanDesc.windDirection = XMFLOAT2(-0.5f, 0.6f);
+	oceanDesc.fetch = 2000.0f;
+	oceanDesc.minWavelength = 1.0f;
+
+	oceanSpectrum.reset(new OceanSpectrum(OCEAN_FFT_SIZE, oceanDesc));
+
+	// Swell from the two sine waves ocean_vs used before the wave maps (evaluated at half the game time)
+	SineWave swell[] = {
+		{ 1.0f, 0.05f, 0.5f, XMFLOAT2(-0.5f, 0.6f) },
+		{ 2.0f, 0.025f, 1.3f, XMFLOAT2(0.7f, 0.7f) }
+	};
+
+	oceanWaves.reset(new GerstnerWaves());
+
+	for (int i = 0; i < 2; i++)
+		oceanWaves->addWave(GerstnerWaves::FromSineWave(swell[i], 0.5f, WATER_SCALE));
+
+	oceanGrid.reset(new OceanGrid(OCEAN_GRID_WIDTH, OCEAN_GRID_HEIGHT));
+	water.reset(new Ocean(device, oceanVSBytecode, waterNormalMapSRV, oceanSpectrum.get(), WATER_SCALE, oceanWaves.get(), oceanGrid.get()));
+	logs.reset(new DXModel(device, perPixelLightingVSBytecode, wstring(L"Resources\\Models\\logs.obj"), logsTextureSRV, XMCOLOR(1.0, 1.0, 1.0, 1.0), XMCOLOR(0, 0, 0.0, 0.0)));
+
+	// Particles rise from the origin with a random sideways drift and live for 0.7 seconds, keeping about 100 alive in each effect
+	fireEmitter.rate = 100.0f / 0.7f;
+	fireEmitter.velocity = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	fireEmitter.velocitySpread = XMFLOAT3(1.0f, 1.0f, 1.0f);
+	fireEmitter.lifeMin = 0.7f;
+	fireEmitter.lifeMax = 0.7f;
+
+	// The smoke and fire are separate effects placed by their scene object transforms.  Texture 0 (smoke) is drawn before texture 1 (fire) when they are at the same depth
+	particleEffects.reset(new ParticleEffects(device, fireVSBytecode, MAX_PARTICLE_EFFECTS, PARTICLE_EFFECT_BLOCKS));
+
+	particleEffects->setTexture(0, smokeDiffuseMapSRV);
+	particleEffects->setTexture(1, fireDiffuseMapSRV);
+
+	smokeEffect = particleEffects->spawn(fireEmitter, 0, sceneGraph->worldMatrix(objectNode[SCENE_SMOKE]));
+	fireEffect = particleEffects->spawn(fireEmitter, 1, sceneGraph->worldMatrix(objectNode[SCENE_FIRE]));
+
+	if (FIRE_GPU_PARTICLES > 0)
+		gpuFire.reset(new GPUParticles(device, fireDiffuseMapSRV, FIRE_GPU_PARTICLES, fireEmitter));
+
+	initialiseCulling();
 
 
 	// Release PixelShader DXBlob
@@ -774,7 +886,7 @@ HRESULT DXController::initialiseSceneResources() {
 	// Release vertexShader DXBlob
 	skyBoxVSBytecode->release();
 	// Release vertexShader DXBlob
-	grassVSBytecode->release();
+	terrainVSBytecode->release();
 	// Release PixelShader DXBlob
 	grassPSBytecode->release();
 	// Release vertexShader DXBlob
@@ -800,6 +912,257 @@ HRESULT DXController::initialiseSceneResources() {
 }
 
 
+// Build the world-space bounding volumes of the tree instances and scene objects.  The scene is static so this is done once after the models are loaded
+void DXController::initialiseCulling() {
+
+	// Tree instances are culled through a BVH so the cost scales with the number of visible trees rather than the size of the forest
+	DXBoundingVolume treeBounds = (tree) ? tree->getBounds() : DXBoundingVolume();
+
+	for (int i = 0; i < NUM_TREES; i++)
+		entityWorld->get<DXBoundsComponent>(treeEntity[i])->local = treeBounds;
+
+	entitySystems->updateTransforms(entityWorld.get());
+
+	vector<DXBoundingVolume> treeVolumes(NUM_TREES);
+
+	for (int i = 0; i < NUM_TREES; i++) {
+
+		DXBoundsComponent *B = entityWorld->get<DXBoundsComponent>(treeEntity[i]);
+
+		treeVolumes[i] = B->world;
+		B->visible = 1;
+	}
+
+	treeBVH.reset(new DXInstanceBVH());
+	treeBVH->build(treeVolumes.data(), NUM_TREES);
+
+	visibleTrees.reserve(NUM_TREES);
+
+	// The remaining scene objects are few enough to test directly
+	frustumCuller.reset(new DXFrustumCuller(NUM_SCENE_OBJECTS));
+
+	objectBounds[SCENE_CASTLE] = (castle) ? castle->getBounds() : DXBoundingVolume();
+	objectBounds[SCENE_LOGS] = (logs) ? logs->getBounds() : DXBoundingVolume();
+	objectBounds[SCENE_WATER] = (water) ? water->getBounds() : DXBoundingVolume();
+	objectBounds[SCENE_FLOOR] = (terrain) ? terrain->getBounds() : DXBoundingVolume();
+	objectBounds[SCENE_SMOKE] = ParticleEffects::EmitterBounds(fireEmitter);
+	objectBounds[SCENE_FIRE] = ParticleEffects::EmitterBounds(fireEmitter);
+
+	for (int i = 0; i < NUM_SCENE_OBJECTS; i++)
+		frustumCuller->addVolume(objectBounds[i].transform(sceneGraph->worldMatrix(objectNode[i])));
+
+	visibleIndices.resize(frustumCuller->volumeCount());
+	volumeVisible.assign(frustumCuller->volumeCount(), true);
+
+	occlusionCuller.reset(new DXOcclusionCuller());
+
+	if (heightField)
+		heightField->buildOccluderMesh(TERRAIN_OCCLUDER_RES, terrainOccluderPositions, terrainOccluderIndices);
+
+	// The full castle mesh is not conservative as an occluder (its walls are thinner than a depth buffer pixel at a distance) and costs thousands of triangles per frame, so a low polygon hull inside it is built once here
+	if (castle)
+		DXOcclusionCuller::BuildOccluderHull(castle->getPositions().data(), castle->getTriangleIndices().data(), (uint32_t)castle->getTriangleIndices().size(), DX_OCCLUSION_HULL_RES, DX_OCCLUSION_HULL_BOXES, castleOccluderPositions, castleOccluderIndices);
+
+	// The selected terrain chunks are the grass patches given a level of detail each frame
+	if (terrain) {
+
+		grassLOD.reset(new GrassLOD());
+		grassPatches.reserve(TERRAIN_MAX_CHUNKS);
+	}
+}
+
+
+// Test the scene bounding volumes against the current view frustum and flag the visible volumes.  This is done before any cbuffer is updated so culled objects cost nothing else on the CPU
+void DXController::cullScene() {
+
+	if (!frustumCuller)
+		return;
+
+	if (profiler)
+		profiler->beginSection(frustumCullSection);
+
+	frustumCuller->setViewProjection(mainCamera->dxViewTransform() * projMatrix->projMatrix);
+
+	uint32_t numVisible = frustumCuller->cullBoxes(visibleIndices.data());
+
+	volumeVisible.assign(volumeVisible.size(), false);
+
+	for (uint32_t i = 0; i < numVisible; i++)
+		volumeVisible[visibleIndices[i]] = true;
+
+	if (profiler)
+		profiler->endSection(frustumCullSection, frustumCuller->volumeCount());
+
+	if (treeBVH) {
+
+		if (profiler)
+			profiler->beginSection(treeCullSection);
+
+		treeBVH->frustumQuery(frustumCuller->getPlanes(), visibleTrees);
+
+		for (uint32_t i = 0; i < treeEntity.size(); i++)
+			entityWorld->get<DXBoundsComponent>(treeEntity[i])->visible = 0;
+
+		for (uint32_t i = 0; i < visibleTrees.size(); i++)
+			entityWorld->get<DXBoundsComponent>(treeEntity[visibleTrees[i]])->visible = 1;
+
+		if (profiler)
+			profiler->endSection(treeCullSection, treeBVH->instanceCount());
+	}
+
+	// Select the terrain chunks, then the number of grass shells drawn on each
+	grassPatches.clear();
+
+	if (terrain && volumeVisible[SCENE_FLOOR]) {
+
+		if (profiler)
+			profiler->beginSection(terrainSection);
+
+		uint32_t numChunks = terrain->update(dx->getDeviceContext(), frustumCuller->getPlanes(), mainCamera->getCameraPos());
+
+		if (profiler)
+			profiler->endSection(terrainSection, numChunks);
+	}
+
+	if (terrain && grassLOD && volumeVisible[SCENE_FLOOR]) {
+
+		if (profiler)
+			profiler->beginSection(grassLODSection);
+
+		uint32_t numChunks = terrain->chunkCount();
+		DXBoundingVolume *chunkVolumes = frameAllocator->allocateArray<DXBoundingVolume>(numChunks);
+
+		if (chunkVolumes) {
+
+			for (uint32_t i = 0; i < numChunks; i++)
+				chunkVolumes[i] = terrain->getChunk(i).bounds;
+
+			grassLOD->setPatches(chunkVolumes, numChunks);
+		}
+
+		// The shell stack spans the wind sway of the top shell (see terrain_vs.hlsl)
+		float shellExtent = grassSway * powf(grassLength * 100.0f, 3.0f);
+
+		grassLOD->select(mainCamera->dxViewTransform() * projMatrix->projMatrix, mainCamera->getCameraPos(), pixelScale, numGrassPasses, shellExtent, grassPatches);
+
+		if (profiler)
+			profiler->endSection(grassLODSection, grassLOD->patchCount());
+	}
+
+	// Occlusion pass.  The castle - the only large solid object in the scene - is represented by boxes inside its walls and towers, and hills by a coarse mesh under the terrain surface.  Everything that survived the frustum tests is then checked against the resulting depth buffer
+	bool castleOccludes = (!castleOccluderIndices.empty() && volumeVisible[SCENE_CASTLE]);
+	bool terrainOccludes = (!terrainOccluderIndices.empty() && volumeVisible[SCENE_FLOOR]);
+
+	if (!occlusionCuller || (!castleOccludes && !terrainOccludes))
+		return;
+
+	if (profiler)
+		profiler->beginSection(occluderSection);
+
+	occlusionCuller->beginFrame(mainCamera->dxViewTransform() * projMatrix->projMatrix);
+
+	if (castleOccludes)
+		occlusionCuller->rasteriseOccluder(castleOccluderPositions.data(), castleOccluderIndices.data(), (uint32_t)castleOccluderIndices.size(), sceneGraph->worldMatrix(objectNode[SCENE_CASTLE]));
+
+	if (terrainOccludes)
+		occlusionCuller->rasteriseOccluder(terrainOccluderPositions.data(), terrainOccluderIndices.data(), (uint32_t)terrainOccluderIndices.size(), XMMatrixIdentity());
+
+	occlusionCuller->endFrame();
+
+	if (profiler)
+		profiler->endSection(occluderSection, occlusionCuller->trianglesRasterised());
+
+	if (profiler)
+		profiler->beginSection(occlusionTestSection);
+
+	uint32_t numTested = (uint32_t)visibleTrees.size();
+
+	for (uint32_t i = 0; i < visibleTrees.size(); i++) {
+
+		if (!occlusionCuller->isVisible(treeBVH->getVolume(visibleTrees[i])))
+			entityWorld->get<DXBoundsComponent>(treeEntity[visibleTrees[i]])->visible = 0;
+	}
+
+	const DXSceneObject occludees[] = { SCENE_LOGS, SCENE_SMOKE, SCENE_FIRE };
+
+	for (int i = 0; i < 3; i++) {
+
+		if (volumeVisible[occludees[i]]) {
+
+			volumeVisible[occludees[i]] = occlusionCuller->isVisible(frustumCuller->getVolume(occludees[i]));
+			numTested++;
+		}
+	}
+
+	if (profiler)
+		profiler->endSection(occlusionTestSection, numTested);
+}
+
+
+// Report the tree under the centre of the view (ray query) and the tree closest to the camera (nearest-neighbour query)
+void DXController::pickTree() {
+
+	if (!treeBVH)
+		return;
+
+	XMVECTOR eye = mainCamera->getCameraPos();
+	XMVECTOR dir = XMVector3Normalize(XMVectorSubtract(mainCamera->getLookAt(eye), eye));
+
+	uint32_t treeIndex;
+	float dist;
+
+	if (treeBVH->raycast(eye, dir, &treeIndex, &dist))
+		cout << "Picked tree " << treeIndex << " at distance " << dist << endl;
+	else
+		cout << "No tree picked" << endl;
+
+	if (treeBVH->nearest(eye, &treeIndex, &dist))
+		cout << "Nearest tree " << treeIndex << " at distance " << dist << endl;
+}
+
+
+// Keep the camera at least cameraClearance above the terrain and, over the water, above the swell.  The wave maps are not read back so the smaller chop is ignored
+void DXController::constrainCamera() {
+
+	if (!heightField || !mainCamera)
+		return;
+
+	XMFLOAT4 pos;
+
+	XMStoreFloat4(&pos, mainCamera->getCameraPos());
+
+	float minY = heightField->height(pos.x, pos.z) + cameraClearance;
+
+	if (water && oceanWaves) {
+
+		XMFLOAT3 objPos;
+
+		XMStoreFloat3(&objPos, XMVector3Transform(mainCamera->getCameraPos(), sceneGraph->inverseWorldMatrix(objectNode[SCENE_WATER])));
+
+		const DXBoundingVolume& waterBounds = water->getBounds();
+
+		if (fabsf(objPos.x - waterBounds.centre.x) <= waterBounds.extents.x && fabsf(objPos.z - waterBounds.centre.z) <= waterBounds.extents.z) {
+
+			// Wave space is object space in metres
+			float waveX = objPos.x * WATER_SCALE;
+			float waveZ = objPos.z * WATER_SCALE;
+			float waveHeight;
+
+			oceanWaves->surfaceHeights(&waveX, &waveZ, &waveHeight, 1);
+
+			XMFLOAT3 surface;
+
+			XMStoreFloat3(&surface, XMVector3Transform(XMVectorSet(objPos.x, waveHeight / WATER_SCALE, objPos.z, 1.0f), sceneGraph->worldMatrix(objectNode[SCENE_WATER])));
+
+			minY = max(minY, surface.y + cameraClearance);
+		}
+	}
+
+	if (pos.y < minY)
+		mainCamera->setPos(XMVectorSet(pos.x, minY, pos.z, pos.w));
+}
+
+
 // Update scene state (perform animations etc)
 HRESULT DXController::updateScene() {
 
@@ -808,15 +1171,69 @@ HRESULT DXController::updateScene() {
 	mainClock->tick();
 	gu_seconds tDelta = mainClock->gameTimeElapsed();
 
+	// Recycle the transient allocations made GU_FRAME_BUFFERS frames ago
+	frameAllocator->beginFrame();
+
 	cBufferExtSrc->Timer = (FLOAT)tDelta;
+
+	// The swell moves under the camera so the camera is constrained every frame
+	if (oceanWaves) {
+
+		oceanWaves->setTime(tDelta);
+		constrainCamera();
+	}
+
 	XMStoreFloat4(&cBufferExtSrc->eyePos, mainCamera->getCameraPos());
 
-	
-	// Update castle cBuffer
-	cBufferExtSrc->worldMatrix = XMMatrixTranslation(-18.5, 1, -20);
-	cBufferExtSrc->worldITMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, cBufferExtSrc->worldMatrix));
-	cBufferExtSrc->WVPMatrix = cBufferExtSrc->worldMatrix*mainCamera->dxViewTransform() * projMatrix->projMatrix;
-	mapCbuffer(cBufferExtSrc, cBufferCastle);
+	// Rebuild the world and normal matrices of the scene graph nodes that have moved.  Static nodes keep their matrices so no matrix is inverted while drawing
+	if (profiler)
+		profiler->beginSection(transformSection);
+
+	sceneGraph->update();
+
+	// Follow moved objects with their bounding volumes and particle effects
+	for (int i = 0; i < NUM_SCENE_OBJECTS; i++) {
+
+		if (!sceneGraph->nodeChanged(objectNode[i]))
+			continue;
+
+		if (frustumCuller)
+			frustumCuller->setVolume(i, objectBounds[i].transform(sceneGraph->worldMatrix(objectNode[i])));
+
+		if (particleEffects && i == SCENE_SMOKE)
+			particleEffects->setWorldMatrix(smokeEffect, sceneGraph->worldMatrix(objectNode[i]));
+
+		if (particleEffects && i == SCENE_FIRE)
+			particleEffects->setWorldMatrix(fireEffect, sceneGraph->worldMatrix(objectNode[i]));
+	}
+
+	// Entities are updated by the transform system.  Moved trees are refitted into the BVH
+	if (entitySystems->updateTransforms(entityWorld.get(), particleEffects.get(), threadPool.get()) > 0 && treeBVH) {
+
+		for (uint32_t i = 0; i < treeEntity.size(); i++)
+			treeBVH->setVolume(i, entityWorld->get<DXBoundsComponent>(treeEntity[i])->world);
+
+		treeBVH->refit();
+	}
+
+	if (profiler)
+		profiler->endSection(transformSection, sceneGraph->nodeCount() + entityWorld->entityCount());
+
+	// Simulate the particle effects.  Their particles are uploaded once visibility is known in renderScene
+	if (gpuFire) {
+
+		gpuFire->update(context, (float)mainClock->gameTimeDelta());
+
+	} else if (particleEffects) {
+
+		if (profiler)
+			profiler->beginSection(particleSection);
+
+		particleEffects->update((float)mainClock->gameTimeDelta(), threadPool.get());
+
+		if (profiler)
+			profiler->endSection(particleSection, particleEffects->getStats().liveParticles);
+	}
 
 
 	// Update  skyBox cBuffer
@@ -852,6 +1269,8 @@ HRESULT DXController::renderScene() {
 	if (isMinimised() || !context)
 		return E_FAIL;
 
+	// Determine which objects intersect the view frustum
+	cullScene();
 
 	// Clear the screen
 	static const FLOAT clearColor[4] = {0.0f, 0.0f, 0.3f, 1.0f };
@@ -880,28 +1299,45 @@ HRESULT DXController::renderScene() {
 
 
 	// Set ground vertex and pixel shaders
-	context->VSSetShader(grassVS, 0, 0);
+	context->VSSetShader(terrainVS, 0, 0);
 	context->PSSetShader(grassPS, 0, 0);
 
 	// Draw the Grass
-	if (floor) {
+	if (terrain && volumeVisible[SCENE_FLOOR]) {
 		// Render
 
 		// Update floor cBuffer
 		// Scale and translate floor world matrix
-		cBufferExtSrc->worldMatrix = XMMatrixScaling(5, 5, 5)*XMMatrixTranslation(0, 0, 0);
-		cBufferExtSrc->worldITMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, cBufferExtSrc->worldMatrix));
+		cBufferExtSrc->worldMatrix = sceneGraph->worldMatrix(objectNode[SCENE_FLOOR]);
+		cBufferExtSrc->worldITMatrix = sceneGraph->normalMatrix(objectNode[SCENE_FLOOR]);
 		cBufferExtSrc->WVPMatrix = cBufferExtSrc->worldMatrix*mainCamera->dxViewTransform() * projMatrix->projMatrix;
 
+		cBufferExtSrc->windDir = XMFLOAT4(grassSway, 0.0f, 0.0f, 0.0f);
+
+		terrain->bind(context);
+
+		// Draw the shells in order so blending is unchanged.  Each patch only draws the shells its LOD selects
 		for (int i = 0; i < numGrassPasses; i++)
 		{
+			bool shellUsed = false;
+
+			for (uint32_t j = 0; j < grassPatches.size() && !shellUsed; j++)
+				shellUsed = grassPatches[j].drawsShell(i);
+
+			if (!shellUsed)
+				continue;
+
 			cBufferExtSrc->grassHeight = (grassLength / numGrassPasses)*i;
 			mapCbuffer(cBufferExtSrc, cBufferGrass);
 			//// Apply the cBuffer.
 			context->VSSetConstantBuffers(0, 1, &cBufferGrass);
 			context->PSSetConstantBuffers(0, 1, &cBufferGrass);
-			floor->render(context);
 
+			for (uint32_t j = 0; j < grassPatches.size(); j++) {
+
+				if (grassPatches[j].drawsShell(i))
+					terrain->renderChunk(context, grassPatches[j].patch);
+			}
 		}
 	}
 
@@ -912,14 +1348,33 @@ HRESULT DXController::renderScene() {
 	context->PSSetShader(oceanPS, 0, 0);
 	
 	// draw water
-	if (water){
+	if (water && volumeVisible[SCENE_WATER]){
+
+		// Evaluate the waves for the current time and upload the wave maps
+		if (oceanSpectrum) {
+
+			if (profiler)
+				profiler->beginSection(oceanSection);
+
+			oceanSpectrum->update(mainClock->gameTimeElapsed(), threadPool.get());
+			water->updateMaps(context, oceanSpectrum.get());
+
+			if (profiler)
+				profiler->endSection(oceanSection, oceanSpectrum->size() * oceanSpectrum->size());
+		}
+
+		water->updateWaves(context, oceanWaves.get());
 
 		//update water cBuffer
-		cBufferExtSrc->worldMatrix = XMMatrixScaling(5, 5, 5)*XMMatrixTranslation(10, 1, 0);
+		cBufferExtSrc->worldMatrix = sceneGraph->worldMatrix(objectNode[SCENE_WATER]);
 		//cBufferExtSrc->worldMatrix = XMMatrixScaling(4, 4, 4)*XMMatrixTranslation(26.5, 5, 10);
-		cBufferExtSrc->worldITMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, cBufferExtSrc->worldMatrix));
+		cBufferExtSrc->worldITMatrix = sceneGraph->normalMatrix(objectNode[SCENE_WATER]);
 		cBufferExtSrc->WVPMatrix = cBufferExtSrc->worldMatrix*mainCamera->dxViewTransform() * projMatrix->projMatrix;
 		mapCbuffer(cBufferExtSrc, cBufferWater);
+
+		// Refit the grid to the view.  The vertex buffer is only rewritten when the camera has moved
+		if (oceanGrid && oceanGrid->update(cBufferExtSrc->WVPMatrix, water->getBounds(), water->getSurfaceBounds()))
+			water->updateGrid(context, oceanGrid.get());
 		
 		water->render(context);
 	}
@@ -932,7 +1387,14 @@ HRESULT DXController::renderScene() {
 	context->VSSetConstantBuffers(0, 1, &cBufferCastle);
 	context->PSSetConstantBuffers(0, 1, &cBufferCastle);
 	// Draw castle
-	if (castle) {
+	if (castle && volumeVisible[SCENE_CASTLE]) {
+
+		// Update castle cBuffer
+		cBufferExtSrc->worldMatrix = sceneGraph->worldMatrix(objectNode[SCENE_CASTLE]);
+		cBufferExtSrc->worldITMatrix = sceneGraph->normalMatrix(objectNode[SCENE_CASTLE]);
+		cBufferExtSrc->WVPMatrix = cBufferExtSrc->worldMatrix*mainCamera->dxViewTransform() * projMatrix->projMatrix;
+		mapCbuffer(cBufferExtSrc, cBufferCastle);
+
 		// Render
 		castle->render(context);
 	}
@@ -947,14 +1409,19 @@ HRESULT DXController::renderScene() {
 
 	// Draw tree	
 
+	// The draw list holds the visible entities sorted by material and mesh.  Trees are currently the only drawable entities
+	entitySystems->buildDrawList(entityWorld.get(), drawList, threadPool.get(), frameAllocator.get());
+
 	if (tree) {
 		// Render trees
-		for (int i = 0; i < NUM_TREES; i++)
+		for (uint32_t i = 0; i < drawList.size(); i++)
 		{
+			if (drawList[i].material != MATERIAL_TREE || drawList[i].mesh != MESH_TREE)
+				continue;
 
 			// Update tree cBuffer for each tree instance
-			cBufferExtSrc->worldMatrix = treeInstance[i].worldMatrix;
-			cBufferExtSrc->worldITMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, cBufferExtSrc->worldMatrix));
+			cBufferExtSrc->worldMatrix = XMLoadFloat4x4(drawList[i].world);
+			cBufferExtSrc->worldITMatrix = XMLoadFloat4x4(drawList[i].normal);
 			cBufferExtSrc->WVPMatrix = cBufferExtSrc->worldMatrix*mainCamera->dxViewTransform() * projMatrix->projMatrix;
 			mapCbuffer(cBufferExtSrc, cBufferTree);
 			// Apply the tree cBuffer.
@@ -975,13 +1442,13 @@ HRESULT DXController::renderScene() {
 	context->VSSetConstantBuffers(0, 1, &cBufferLogs);
 	context->PSSetConstantBuffers(0, 1, &cBufferLogs);
 	// Draw logs
-	if (logs) {
+	if (logs && volumeVisible[SCENE_LOGS]) {
 		// set  shaders for logs
 
 		// Update logs cBuffer
 		// Scale and translate logs world matrix
-		cBufferExtSrc->worldMatrix = XMMatrixScaling(0.002, 0.002, 0.002)*XMMatrixTranslation(-15, 2, 1.5)*XMMatrixRotationX(XMConvertToRadians(-90));
-		cBufferExtSrc->worldITMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, cBufferExtSrc->worldMatrix));
+		cBufferExtSrc->worldMatrix = sceneGraph->worldMatrix(objectNode[SCENE_LOGS]);
+		cBufferExtSrc->worldITMatrix = sceneGraph->normalMatrix(objectNode[SCENE_LOGS]);
 		cBufferExtSrc->WVPMatrix = cBufferExtSrc->worldMatrix*mainCamera->dxViewTransform() * projMatrix->projMatrix;
 		mapCbuffer(cBufferExtSrc, cBufferLogs);
 
@@ -991,7 +1458,7 @@ HRESULT DXController::renderScene() {
 		}
 
 	// Draw the Fire (Draw all transparent objects last)
-	if (fire) {
+	if ((particleEffects || gpuFire) && (volumeVisible[SCENE_SMOKE] || volumeVisible[SCENE_FIRE])) {
 
 		// Set fire vertex and pixel shaders
 		context->VSSetShader(fireVS, 0, 0);
@@ -1005,24 +1472,57 @@ HRESULT DXController::renderScene() {
 		context->VSSetConstantBuffers(0, 1, &cBufferFire);
 		context->PSSetConstantBuffers(0, 1, &cBufferFire);
 
-		// Update fire and smoke cBuffer
-		cBufferExtSrc->Timer = cBufferExtSrc->Timer / 4;// smoke changes more slowly than flames
-		// Scale and translate smoke world matrix
-		cBufferExtSrc->worldMatrix = XMMatrixScaling(0.25, 0.25, 0.25)*XMMatrixTranslation(-15, 2, -2);
-		cBufferExtSrc->WVPMatrix = cBufferExtSrc->worldMatrix*mainCamera->dxViewTransform() * projMatrix->projMatrix;
-		mapCbuffer(cBufferExtSrc, cBufferFire);
-		fire->setTexture(smokeDiffuseMapSRV);
-		// Render Smoke
-		fire->render(context);
-
-		cBufferExtSrc->Timer = cBufferExtSrc->Timer * 6;// fire changes more quickly than flames
-		// Scale and translate fire world matrix
-		cBufferExtSrc->worldMatrix = XMMatrixScaling(0.5, 0.5, 0.5)*XMMatrixTranslation(-15, 2,-2);
-		cBufferExtSrc->WVPMatrix = cBufferExtSrc->worldMatrix*mainCamera->dxViewTransform() * projMatrix->projMatrix;
-		mapCbuffer(cBufferExtSrc, cBufferFire);
-		fire->setTexture(fireDiffuseMapSRV);
-		// Render Fire
-		fire->render(context);
+		XMMATRIX viewMatrix = mainCamera->dxViewTransform();
+
+		if (gpuFire) {
+
+			// The GPU fire is one simulation drawn with the smoke and fire transforms.  Order the draws back to front by the view depth of their world bounds
+			DXSceneObject transparent[] = { SCENE_SMOKE, SCENE_FIRE };
+			ID3D11ShaderResourceView *transparentTextures[] = { smokeDiffuseMapSRV, fireDiffuseMapSRV };
+			float transparentDepth[2];
+
+			for (int i = 0; i < 2; i++) {
+
+				XMFLOAT3 c = frustumCuller->getVolume(transparent[i]).centre;
+
+				transparentDepth[i] = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&c), viewMatrix));
+			}
+
+			if (transparentDepth[1] > transparentDepth[0]) {
+
+				swap(transparent[0], transparent[1]);
+				swap(transparentTextures[0], transparentTextures[1]);
+			}
+
+			for (int i = 0; i < 2; i++) {
+
+				if (!volumeVisible[transparent[i]])
+					continue;
+
+				cBufferExtSrc->worldMatrix = sceneGraph->worldMatrix(objectNode[transparent[i]]);
+				cBufferExtSrc->WVPMatrix = cBufferExtSrc->worldMatrix*viewMatrix * projMatrix->projMatrix;
+				mapCbuffer(cBufferExtSrc, cBufferFire);
+
+				// GPU simulated particles stay in the order they were appended
+				gpuFire->setTexture(transparentTextures[i]);
+				gpuFire->render(context);
+			}
+
+		} else {
+
+			// Effects are expanded to world space and batched by texture, so one view-projection transform draws them all.  Each batch is sorted back to front
+			particleEffects->setVisible(smokeEffect, volumeVisible[SCENE_SMOKE]);
+			particleEffects->setVisible(fireEffect, volumeVisible[SCENE_FIRE]);
+
+			particleEffects->upload(context, threadPool.get());
+			particleEffects->sortByDepth(context, viewMatrix, threadPool.get());
+
+			cBufferExtSrc->worldMatrix = XMMatrixIdentity();
+			cBufferExtSrc->WVPMatrix = viewMatrix * projMatrix->projMatrix;
+			mapCbuffer(cBufferExtSrc, cBufferFire);
+
+			particleEffects->render(context);
+		}
 
 
 		context->OMSetBlendState(defaultBlendState, blendFactor, 0xFFFFFFFF);
@@ -8,18 +8,35 @@
 #pragma once
 
 #include <GUObject.h>
+#include <GURef.h>
 #include <Windows.h>
 #include <buffers.h>
 #include <Triangle.h>
 #include <Box.h>
-#include <Grid.h>
+#include <Terrain.h>
+#include <GrassLOD.h>
 #include <Ocean.h>
-#include <Particles.h>
+#include <ParticleEffects.h>
+#include <DXEntitySystems.h>
+#include <vector>
 
 class DXSystem;
 class GUClock;
 class DXModel;
 class LookAtCamera;
+class DXFrustumCuller;
+class DXInstanceBVH;
+class DXOcclusionCuller;
+class GrassLOD;
+class HeightField;
+class GUParallel;
+class GUFrameAllocator;
+class GPUParticles;
+class OceanSpectrum;
+class GerstnerWaves;
+class OceanGrid;
+class GUProfiler;
+class DXSceneGraph;
 
 
 // CBuffer struct
@@ -47,13 +64,21 @@ __declspec(align(16)) struct projMatrixStruct  {
 __declspec(align(16)) struct worldMatrixStruct  {
 	DirectX::XMMATRIX						worldMatrix;
 };
+
+// Index of each (non-instanced) scene object's scene graph node in DXController::objectNode and of its bounding volume in DXController::frustumCuller
+enum DXSceneObject { SCENE_CASTLE = 0, SCENE_LOGS, SCENE_WATER, SCENE_FLOOR, SCENE_SMOKE, SCENE_FIRE, NUM_SCENE_OBJECTS };
+
+// Mesh and material ids of the entities in DXController::entityWorld
+enum DXSceneMesh { MESH_TREE = 0, NUM_SCENE_MESHES };
+enum DXSceneMaterial { MATERIAL_TREE = 0, NUM_SCENE_MATERIALS };
+
 class DXController : public GUObject {
 
 	HINSTANCE								hInst = NULL;
 	HWND									wndHandle = NULL;
 
-	// Strong reference to associated Direct3D device and rendering context.
-	DXSystem								*dx = nullptr;
+	// Strong reference to associated Direct3D device and rendering context.  Declared before the other GURef members so it is released last
+	GURef<DXSystem>							dx;
 
 	// Default pipeline stage states
 	ID3D11RasterizerState					*defaultRSstate = nullptr;
@@ -65,7 +90,7 @@ class DXController : public GUObject {
 	ID3D11BlendState						*fireBlendState = nullptr;
 	ID3D11VertexShader						*skyBoxVS = nullptr;
 	ID3D11PixelShader						*skyBoxPS = nullptr;
-	ID3D11VertexShader						*grassVS = nullptr;
+	ID3D11VertexShader						*terrainVS = nullptr;
 	ID3D11PixelShader						*grassPS = nullptr;
 	ID3D11VertexShader						*treeVS = nullptr;
 	ID3D11PixelShader						*treePS = nullptr;
@@ -87,26 +112,92 @@ class DXController : public GUObject {
 	CBufferExt								*cBufferExtSrc = nullptr;
 
 	// Main FPS clock
-	GUClock									*mainClock = nullptr;
+	GURef<GUClock>							mainClock;
+
+	// CPU section timings
+	GURef<GUProfiler>						profiler;
+	int										frustumCullSection = -1;
+	int										treeCullSection = -1;
+	int										occluderSection = -1;
+	int										occlusionTestSection = -1;
+	int										grassLODSection = -1;
+	int										terrainSection = -1;
+	int										particleSection = -1;
+	int										oceanSection = -1;
+	int										transformSection = -1;
+
+	// Worker threads for data-parallel CPU work
+	GURef<GUParallel>						threadPool;
+
+	// Transient per-frame data.  One arena per thread pool thread
+	GURef<GUFrameAllocator>					frameAllocator;
 
 	
-	LookAtCamera							*mainCamera = nullptr;
+	GURef<LookAtCamera>						mainCamera;
 	projMatrixStruct 						*projMatrix = nullptr;
-	worldMatrixStruct 						*treeInstance = nullptr;
+	float									pixelScale = 1.0f; // Height in pixels of an object 1 unit high 1 unit from the camera
+
+	// Tree instances are entities with transform, world, mesh, material and bounds components.  treeEntity holds the entities in creation order, which is also the instance order of treeBVH.  drawList is rebuilt from the visible entities each frame
+	GURef<DXEntityWorld>					entityWorld;
+	GURef<DXEntitySystems>					entitySystems;
+	std::vector<DXEntity>					treeEntity;
+	std::vector<DXDrawItem>					drawList;
+
+	// Transform hierarchy placing the remaining scene objects.  objectNode holds the node of each DXSceneObject.  Matrices are only rebuilt for nodes that move
+	GURef<DXSceneGraph>						sceneGraph;
+	uint32_t								objectNode[NUM_SCENE_OBJECTS];
+
+	// World-space bounding volumes of the scene objects tested against the view frustum each frame
+	GURef<DXFrustumCuller>					frustumCuller;
+	std::vector<uint32_t>					visibleIndices;
+	std::vector<bool>						volumeVisible;
+	DXBoundingVolume						objectBounds[NUM_SCENE_OBJECTS]; // Object-space bounds, transformed into frustumCuller when an object moves
+
+	// Hierarchy over the tree instance bounds used for culling and picking.  Its results are written to the trees' DXBoundsComponent::visible
+	GURef<DXInstanceBVH>					treeBVH;
+	std::vector<uint32_t>					visibleTrees;
+
+	// CPU depth buffer the castle and terrain are rasterised into so trees and objects hidden behind them are not drawn
+	GURef<DXOcclusionCuller>				occlusionCuller;
+
+	// Coarse mesh lying under the terrain surface used as an occluder
+	std::vector<DirectX::XMFLOAT3>			terrainOccluderPositions;
+	std::vector<uint32_t>					terrainOccluderIndices;
+
+	// Boxes inside the castle walls and towers used as its occluder (see DXOcclusionCuller::BuildOccluderHull)
+	std::vector<DirectX::XMFLOAT3>			castleOccluderPositions;
+	std::vector<uint32_t>					castleOccluderIndices;
+
+	// Visible grass patches and the number of shells drawn for each
+	GURef<GrassLOD>							grassLOD;
+	std::vector<GrassPatchLOD>				grassPatches;
 
 
 	float									forestSize = 5.0f;
 	float									grassLength = 0.005f;
 	int										numGrassPasses = 40;
+	float									grassSway = 0.25f; // World-space wind sway of the top of the grass
+	float									cameraClearance = 0.5f; // Minimum height of the camera above the terrain and the water swell
+
+	// CPU copy of the terrain heightmap for placement and collision queries
+	GURef<HeightField>						heightField;
+
 	// Direct3D scene objects
-	Box										*skyBox = nullptr;
-	Grid									*floor = nullptr;
-	DXModel									*tree = nullptr;
-	Ocean                                   *water = nullptr;
-	Particles								*fire = nullptr;
-	DXModel									*logs = nullptr;
+	GURef<Box>								skyBox;
+	GURef<Terrain>							terrain;
+	GURef<DXModel>							tree;
+	GURef<Ocean>							water;
+	GURef<OceanSpectrum>					oceanSpectrum; // Wave maps displacing the water, evaluated on the CPU each frame the water is visible
+	GURef<GerstnerWaves>					oceanWaves; // Swell added to the wave maps.  The same waves are evaluated on the CPU to keep the camera above the water
+	GURef<OceanGrid>						oceanGrid; // Camera projected grid the water is drawn with
+	GURef<ParticleEffects>					particleEffects;
+	uint32_t								smokeEffect = PARTICLE_EFFECT_INVALID;
+	uint32_t								fireEffect = PARTICLE_EFFECT_INVALID;
+	ParticleEmitter							fireEmitter; // Shared by the smoke and fire effects
+	GURef<GPUParticles>						gpuFire; // Compute shader simulation of the fire, used instead of particleEffects when created (see FIRE_GPU_PARTICLES)
+	GURef<DXModel>							logs;
 	ID3D11SamplerState						*linearSampler = nullptr;
-	DXModel                                  *castle = nullptr;
+	GURef<DXModel>							castle;
 
 
 
@@ -124,12 +215,6 @@ class DXController : public GUObject {
 	ID3D11ShaderResourceView				*grassAlphaMapSRV = nullptr;
 
 
-	ID3D11Texture2D							*grassHeightMap = nullptr;
-	ID3D11ShaderResourceView				*grassHeightMapSRV = nullptr;
-	ID3D11Texture2D							*grassNormalMap = nullptr;
-	ID3D11ShaderResourceView				*grassNormalMapSRV = nullptr;
-
-
 
 	ID3D11Texture2D							*waterNormalMap = nullptr;
 	ID3D11ShaderResourceView				*waterNormalMapSRV = nullptr;
@@ -207,6 +292,10 @@ public:
 	HRESULT LoadShader(ID3D11Device *device, const char *filename, DXBlob **PSBytecode, ID3D11PixelShader **pixelShader);
 	HRESULT LoadShader(ID3D11Device *device, const char *filename, DXBlob **VSBytecode, ID3D11VertexShader **vertexShader);
 	HRESULT initialiseSceneResources();
+	void initialiseCulling();
+	void cullScene();
+	void pickTree();
+	void constrainCamera();
 	HRESULT updateScene();
 	HRESULT renderScene();
 
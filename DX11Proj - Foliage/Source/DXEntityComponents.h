@@ -0,0 +1,90 @@
+
+//
+// DXEntityComponents.h
+//
+
+// Component types stored by DXEntityWorld.  Components are plain copyable data with no pointers to Direct3D objects, so they can be moved between chunks with memcpy and processed without a device.  Meshes and materials are referred to by id and resolved by the renderer.  Each component declares its DXComponentType so DXEntityWorld can find its array from the type alone.
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DXBoundingVolume.h>
+#include <cstdint>
+
+
+enum DXComponentType { DX_COMPONENT_TRANSFORM = 0, DX_COMPONENT_WORLD, DX_COMPONENT_MESH, DX_COMPONENT_MATERIAL, DX_COMPONENT_BOUNDS, DX_COMPONENT_LOD, DX_COMPONENT_EMITTER, DX_NUM_COMPONENT_TYPES };
+
+#define DX_COMPONENT_BIT(type) (1u << (type))
+
+// Number of detail levels selectable by DXLODComponent
+#define DX_ENTITY_MAX_LODS 4
+
+
+// Local scale, rotation (unit quaternion) and translation.  dirty is set when any field changes and cleared once the transform system has rebuilt the entity's DXWorldComponent
+struct DXTransformComponent {
+
+	enum { type = DX_COMPONENT_TRANSFORM };
+
+	DirectX::XMFLOAT3					scale;
+	DirectX::XMFLOAT4					rotation;
+	DirectX::XMFLOAT3					translation;
+	uint32_t							dirty;
+};
+
+
+// World and normal ((W^-1)^T) matrices written by the transform system
+struct DXWorldComponent {
+
+	enum { type = DX_COMPONENT_WORLD };
+
+	DirectX::XMFLOAT4X4					world;
+	DirectX::XMFLOAT4X4					normal;
+};
+
+
+// Renderer mesh id
+struct DXMeshComponent {
+
+	enum { type = DX_COMPONENT_MESH };
+
+	uint32_t							mesh;
+};
+
+
+// Renderer material (shaders, constant buffer and blend state) id.  Draw lists are ordered by material then mesh
+struct DXMaterialComponent {
+
+	enum { type = DX_COMPONENT_MATERIAL };
+
+	uint32_t							material;
+};
+
+
+// Object-space bounds and the world-space bounds derived from them by the transform system.  visible is written by the culling system (or by the application when it culls the entity itself)
+struct DXBoundsComponent {
+
+	enum { type = DX_COMPONENT_BOUNDS };
+
+	DXBoundingVolume					local;
+	DXBoundingVolume					world;
+	uint32_t							visible;
+};
+
+
+// Camera distances at which the entity switches to the next (coarser) detail level.  level is written by the culling system and is the number of distances the entity lies beyond
+struct DXLODComponent {
+
+	enum { type = DX_COMPONENT_LOD };
+
+	float								distance[DX_ENTITY_MAX_LODS - 1];
+	uint32_t							level;
+};
+
+
+// Handle of a ParticleEffects effect placed by the entity's world matrix
+struct DXEmitterComponent {
+
+	enum { type = DX_COMPONENT_EMITTER };
+
+	uint32_t							effect;
+};
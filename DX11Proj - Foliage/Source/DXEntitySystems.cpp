@@ -0,0 +1,335 @@
+
+//
+// DXEntitySystems.cpp
+//
+
+#include <stdafx.h>
+#include <DXEntitySystems.h>
+#include <DXTransformBatch.h>
+#include <DXFrustumCuller.h>
+#include <ParticleEffects.h>
+#include <GURadixSort.h>
+#include <GUParallel.h>
+#include <GUFrameAllocator.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Compose the matrices and world bounds of the dirty transforms in chunk C.  Dirty rows are gathered DX_ENTITY_TRANSFORM_BATCH at a time into SoA arrays for DXTransformBatch::ComposeArrays and the matrices are scattered back to their rows
+static uint32_t updateChunkTransforms(DXEntityChunk *C, ParticleEffects *effects) {
+
+	static_assert(DX_ENTITY_TRANSFORM_BATCH % DX_TRANSFORM_LANES == 0, "DXEntitySystems: transform batch must be a whole number of lanes");
+
+	DXTransformComponent *T = C->components<DXTransformComponent>();
+	DXWorldComponent *W = C->components<DXWorldComponent>();
+	DXBoundsComponent *B = C->components<DXBoundsComponent>();
+	DXEmitterComponent *E = (effects) ? C->components<DXEmitterComponent>() : nullptr;
+
+	// Gathered components (sx, sy, sz, qx, qy, qz, qw, tx, ty, tz), their rows and the composed matrices
+	__declspec(align(32)) float soa[10][DX_ENTITY_TRANSFORM_BATCH];
+	uint32_t rows[DX_ENTITY_TRANSFORM_BATCH];
+	DXWorldComponent matrices[DX_ENTITY_TRANSFORM_BATCH];
+
+	const DXTransformArrays A = { soa[0], soa[1], soa[2], soa[3], soa[4], soa[5], soa[6], soa[7], soa[8], soa[9] };
+
+	uint32_t numUpdated = 0;
+	uint32_t i = 0;
+
+	while (i < C->count) {
+
+		uint32_t n = 0;
+
+		for (; i < C->count && n < DX_ENTITY_TRANSFORM_BATCH; i++) {
+
+			if (!T[i].dirty)
+				continue;
+
+			soa[0][n] = T[i].scale.x; soa[1][n] = T[i].scale.y; soa[2][n] = T[i].scale.z;
+			soa[3][n] = T[i].rotation.x; soa[4][n] = T[i].rotation.y; soa[5][n] = T[i].rotation.z; soa[6][n] = T[i].rotation.w;
+			soa[7][n] = T[i].translation.x; soa[8][n] = T[i].translation.y; soa[9][n] = T[i].translation.z;
+
+			T[i].dirty = 0;
+			rows[n++] = i;
+		}
+
+		if (n == 0)
+			break;
+
+		// Identity transforms in the padding lanes of the last batch so the kernel never divides by zero
+		static const float identity[10] = { 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f };
+
+		for (uint32_t lane = n; lane % DX_TRANSFORM_LANES != 0; lane++)
+			for (int k = 0; k < 10; k++)
+				soa[k][lane] = identity[k];
+
+		DXTransformBatch::ComposeArrays(A, 0, n, &matrices[0].world, &matrices[0].normal, sizeof(DXWorldComponent));
+
+		for (uint32_t k = 0; k < n; k++) {
+
+			uint32_t row = rows[k];
+
+			W[row] = matrices[k];
+
+			if (B || E) {
+
+				XMMATRIX world = XMLoadFloat4x4(&matrices[k].world);
+
+				if (B)
+					B[row].world = B[row].local.transform(world);
+
+				if (E)
+					effects->setWorldMatrix(E[row].effect, world);
+			}
+		}
+
+		numUpdated += n;
+	}
+
+	return numUpdated;
+}
+
+
+// Gather the drawable entities of chunk C that are not culled into items and their draw keys into keys.  Return the number gathered
+static uint32_t gatherDrawItems(DXEntityChunk *C, DXDrawItem *items, uint32_t *keys) {
+
+	const DXEntity *entities = C->entities();
+	const DXMeshComponent *M = C->components<DXMeshComponent>();
+	const DXMaterialComponent *S = C->components<DXMaterialComponent>();
+	const DXWorldComponent *W = C->components<DXWorldComponent>();
+	const DXBoundsComponent *B = C->components<DXBoundsComponent>();
+	const DXLODComponent *L = C->components<DXLODComponent>();
+
+	uint32_t n = 0;
+
+	for (uint32_t i = 0; i < C->count; i++) {
+
+		if (B && !B[i].visible)
+			continue;
+
+		DXDrawItem& item = items[n];
+
+		item.material = S[i].material;
+		item.mesh = M[i].mesh;
+		item.lod = (L) ? L[i].level : 0;
+		item.entity = entities[i];
+		item.world = &W[i].world;
+		item.normal = &W[i].normal;
+
+		keys[n++] = DXEntitySystems::DrawKey(item.material, item.mesh, item.lod);
+	}
+
+	return n;
+}
+
+
+uint32_t DXEntitySystems::DrawKey(const uint32_t material, const uint32_t mesh, const uint32_t lod) {
+
+	return ((material & 0xFFF) << 20) | ((mesh & 0xFFFF) << 4) | (lod & 0xF);
+}
+
+
+DXEntitySystems::DXEntitySystems() {
+
+	sorter = new GURadixSort();
+}
+
+
+DXEntitySystems::~DXEntitySystems() {
+
+	if (sorter)
+		sorter->release();
+}
+
+
+uint32_t DXEntitySystems::forChunks(GUParallel *pool, const function<uint32_t(DXEntityChunk*)>& fn) {
+
+	uint32_t numChunks = (uint32_t)chunks.size();
+
+	chunkCounts.resize(numChunks);
+
+	if (pool && numChunks > DX_ENTITY_MIN_CHUNKS) {
+
+		pool->parallelFor(numChunks, DX_ENTITY_MIN_CHUNKS, [this, &fn](uint32_t begin, uint32_t end) {
+
+			for (uint32_t c = begin; c < end; c++)
+				chunkCounts[c] = fn(chunks[c]);
+		});
+
+	} else {
+
+		for (uint32_t c = 0; c < numChunks; c++)
+			chunkCounts[c] = fn(chunks[c]);
+	}
+
+	uint32_t total = 0;
+
+	for (uint32_t c = 0; c < numChunks; c++)
+		total += chunkCounts[c];
+
+	return total;
+}
+
+
+uint32_t DXEntitySystems::updateTransforms(DXEntityWorld *world, ParticleEffects *effects, GUParallel *pool) {
+
+	world->queryChunks(DX_COMPONENT_BIT(DX_COMPONENT_TRANSFORM) | DX_COMPONENT_BIT(DX_COMPONENT_WORLD), chunks);
+
+	// ParticleEffects is not thread safe so chunks that move effects are left for the calling thread
+	uint32_t numUpdated = forChunks(pool, [effects](DXEntityChunk *C) {
+
+		return (effects && C->has(DX_COMPONENT_EMITTER)) ? 0 : updateChunkTransforms(C, nullptr);
+	});
+
+	if (effects) {
+
+		for (uint32_t c = 0; c < chunks.size(); c++)
+			if (chunks[c]->has(DX_COMPONENT_EMITTER))
+				numUpdated += updateChunkTransforms(chunks[c], effects);
+	}
+
+	return numUpdated;
+}
+
+
+uint32_t DXEntitySystems::cull(DXEntityWorld *world, const XMFLOAT4 *frustumPlanes, FXMVECTOR eye, GUParallel *pool) {
+
+	world->queryChunks(DX_COMPONENT_BIT(DX_COMPONENT_BOUNDS), chunks);
+
+	XMFLOAT3 eyePos;
+
+	XMStoreFloat3(&eyePos, eye);
+
+	return forChunks(pool, [frustumPlanes, &eyePos](DXEntityChunk *C) {
+
+		DXBoundsComponent *B = C->components<DXBoundsComponent>();
+		DXLODComponent *L = C->components<DXLODComponent>();
+
+		uint32_t numVisible = 0;
+
+		for (uint32_t i = 0; i < C->count; i++) {
+
+			B[i].visible = (DXFrustumCuller::BoxVisible(frustumPlanes, B[i].world)) ? 1 : 0;
+			numVisible += B[i].visible;
+
+			if (!L)
+				continue;
+
+			// Distances of 0 are unused
+			float dx = B[i].world.centre.x - eyePos.x;
+			float dy = B[i].world.centre.y - eyePos.y;
+			float dz = B[i].world.centre.z - eyePos.z;
+			float d = sqrtf(dx * dx + dy * dy + dz * dz);
+
+			uint32_t level = 0;
+
+			for (uint32_t k = 0; k < DX_ENTITY_MAX_LODS - 1; k++)
+				if (L[i].distance[k] > 0.0f && d > L[i].distance[k])
+					level++;
+
+			L[i].level = level;
+		}
+
+		return numVisible;
+	});
+}
+
+
+uint32_t DXEntitySystems::buildDrawList(DXEntityWorld *world, vector<DXDrawItem>& drawList, GUParallel *pool, GUFrameAllocator *frame) {
+
+	world->queryChunks(DX_COMPONENT_BIT(DX_COMPONENT_MESH) | DX_COMPONENT_BIT(DX_COMPONENT_MATERIAL) | DX_COMPONENT_BIT(DX_COMPONENT_WORLD), chunks);
+
+	uint32_t numChunks = (uint32_t)chunks.size();
+	uint32_t capacity = 0;
+
+	for (uint32_t c = 0; c < numChunks; c++)
+		capacity += chunks[c]->count;
+
+	// Room for every entity.  Only the first numItems entries are used, so items and keys are never shrunk and steady-state frames do not re-initialise them
+	if (items.size() < capacity) {
+
+		items.resize(capacity);
+		keys.resize(capacity);
+	}
+
+	uint32_t numItems = 0;
+
+	// A pool of one thread would gather the blocks one after another and then copy them, so it gathers directly instead
+	if (pool && frame && pool->threadCount() > 1 && numChunks > DX_ENTITY_MIN_CHUNKS) {
+
+		uint32_t numBlocks = (numChunks + DX_ENTITY_MIN_CHUNKS - 1) / DX_ENTITY_MIN_CHUNKS;
+
+		blockItems.resize(numBlocks);
+		blockKeys.resize(numBlocks);
+		chunkCounts.resize(numBlocks);
+
+		// Blocks run on the same thread one after another, so each thread allocates from its own arena without contention
+		pool->parallelForPerThread(numChunks, DX_ENTITY_MIN_CHUNKS, [this, frame](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+
+			uint32_t blockCapacity = 0;
+
+			for (uint32_t c = begin; c < end; c++)
+				blockCapacity += chunks[c]->count;
+
+			uint32_t b = begin / DX_ENTITY_MIN_CHUNKS;
+			DXDrawItem *I = frame->allocateArray<DXDrawItem>(blockCapacity, threadIndex);
+			uint32_t *K = frame->allocateArray<uint32_t>(blockCapacity, threadIndex);
+			uint32_t n = 0;
+
+			// If the arena and its overflow list are full the block is gathered on the calling thread below
+			if (I && K) {
+
+				for (uint32_t c = begin; c < end; c++)
+					n += gatherDrawItems(chunks[c], I + n, K + n);
+
+			} else {
+
+				I = nullptr;
+			}
+
+			blockItems[b] = I;
+			blockKeys[b] = K;
+			chunkCounts[b] = n;
+		});
+
+		// Combine the blocks in chunk order
+		for (uint32_t b = 0; b < numBlocks; b++) {
+
+			if (blockItems[b]) {
+
+				memcpy(items.data() + numItems, blockItems[b], chunkCounts[b] * sizeof(DXDrawItem));
+				memcpy(keys.data() + numItems, blockKeys[b], chunkCounts[b] * sizeof(uint32_t));
+
+				numItems += chunkCounts[b];
+
+			} else {
+
+				uint32_t end = min((b + 1) * DX_ENTITY_MIN_CHUNKS, numChunks);
+
+				for (uint32_t c = b * DX_ENTITY_MIN_CHUNKS; c < end; c++)
+					numItems += gatherDrawItems(chunks[c], items.data() + numItems, keys.data() + numItems);
+			}
+		}
+
+	} else {
+
+		for (uint32_t c = 0; c < numChunks; c++)
+			numItems += gatherDrawItems(chunks[c], items.data() + numItems, keys.data() + numItems);
+	}
+
+	order.resize(numItems);
+
+	for (uint32_t i = 0; i < numItems; i++)
+		order[i] = i;
+
+	sorter->sort(keys.data(), order.data(), numItems, pool);
+
+	drawList.resize(numItems);
+
+	for (uint32_t i = 0; i < numItems; i++)
+		drawList[i] = items[order[i]];
+
+	return numItems;
+}
@@ -0,0 +1,74 @@
+
+//
+// DXEntitySystems.h
+//
+
+// Systems run over the chunks of a DXEntityWorld each frame.  The transform system gathers the entities whose transform is dirty into structure-of-arrays form, composes their world and normal matrices with the DXTransformBatch kernel and refreshes their world bounds, the cull system flags entities whose world bounds intersect the view frustum and selects their level of detail, and the draw list system gathers the visible drawable entities into a list sorted by material, mesh and detail level so state changes between draws are minimised (in parallel into per-thread GUFrameAllocator arenas when a frame allocator is given).  Each system touches only the component arrays it needs, a chunk at a time, and chunks can be processed in parallel on a GUParallel thread pool.  Scratch buffers are kept between calls so per-frame use does not allocate once warmed up.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DXEntityWorld.h>
+#include <DirectXMath.h>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+class GUParallel;
+class GUFrameAllocator;
+class GURadixSort;
+class ParticleEffects;
+
+
+// Minimum number of chunks handled by each parallel block
+#define DX_ENTITY_MIN_CHUNKS 4
+
+// Number of dirty transforms of a chunk gathered into SoA form for each call of the DXTransformBatch compose kernel (a multiple of DX_TRANSFORM_LANES)
+#define DX_ENTITY_TRANSFORM_BATCH 64
+
+
+// Draw list entry.  Matrices point into the entity's DXWorldComponent and are valid until entities are created, destroyed or change components
+struct DXDrawItem {
+
+	uint32_t							material;
+	uint32_t							mesh;
+	uint32_t							lod;
+	DXEntity							entity;
+	const DirectX::XMFLOAT4X4			*world;
+	const DirectX::XMFLOAT4X4			*normal;
+};
+
+
+class DXEntitySystems : public GUObject {
+
+	std::vector<DXEntityChunk*>			chunks;
+	std::vector<uint32_t>				chunkCounts; // Per-chunk results combined after parallel loops
+
+	// Draw list gathered in chunk order, then sorted through keys / order.  blockItems / blockKeys hold the arrays gathered by each parallel block and chunkCounts their sizes
+	std::vector<DXDrawItem>				items;
+	std::vector<uint32_t>				keys;
+	std::vector<uint32_t>				order;
+	std::vector<DXDrawItem*>			blockItems;
+	std::vector<uint32_t*>				blockKeys;
+	GURadixSort							*sorter = nullptr;
+
+	// Call fn for every chunk in chunks, on pool if one is given, and return the sum of the counts it returns
+	uint32_t forChunks(GUParallel *pool, const std::function<uint32_t(DXEntityChunk*)>& fn);
+
+public:
+
+	// Draw key of an item.  Materials are limited to 12 bits, meshes to 16 bits and detail levels to 4 bits
+	static uint32_t DrawKey(const uint32_t material, const uint32_t mesh, const uint32_t lod);
+
+	DXEntitySystems();
+	~DXEntitySystems();
+
+	// Transform system.  For every entity with DXTransformComponent and DXWorldComponent whose transform is dirty, build the world and normal matrices, transform DXBoundsComponent::local into DXBoundsComponent::world and clear the dirty flag.  If effects is not null the effects of updated entities with a DXEmitterComponent are moved with them.  Chunks with emitters are processed on the calling thread.  Return the number of entities updated
+	uint32_t updateTransforms(DXEntityWorld *world, ParticleEffects *effects = nullptr, GUParallel *pool = nullptr);
+
+	// Cull system.  Set DXBoundsComponent::visible for every entity with bounds by testing its world bounds against the given frustum planes (see DXFrustumCuller::ExtractPlanes), and select the DXLODComponent level of entities that have one from the distance between eye and the bounds centre.  Return the number of visible entities
+	uint32_t cull(DXEntityWorld *world, const DirectX::XMFLOAT4 *frustumPlanes, DirectX::FXMVECTOR eye, GUParallel *pool = nullptr);
+
+	// Draw list system.  Collect the entities with DXMeshComponent, DXMaterialComponent and DXWorldComponent, skipping those whose DXBoundsComponent is not visible, into drawList sorted by DrawKey.  If pool (with more than one thread) and frame are both given the chunks are gathered in parallel, each block into arrays allocated from the current frame's arena of the thread running it (frame needs pool->threadCount() arenas to avoid contention).  Return the number of items
+	uint32_t buildDrawList(DXEntityWorld *world, std::vector<DXDrawItem>& drawList, GUParallel *pool = nullptr, GUFrameAllocator *frame = nullptr);
+};
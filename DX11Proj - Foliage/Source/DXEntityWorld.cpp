@@ -0,0 +1,367 @@
+
+//
+// DXEntityWorld.cpp
+//
+
+#include <stdafx.h>
+#include <DXEntityWorld.h>
+#include <exception>
+#include <cstring>
+
+using namespace std;
+
+
+static const uint32_t componentSizes[DX_NUM_COMPONENT_TYPES] = {
+
+	sizeof(DXTransformComponent),
+	sizeof(DXWorldComponent),
+	sizeof(DXMeshComponent),
+	sizeof(DXMaterialComponent),
+	sizeof(DXBoundsComponent),
+	sizeof(DXLODComponent),
+	sizeof(DXEmitterComponent)
+};
+
+
+static inline uint32_t align16(const uint32_t size) {
+
+	return (size + 15) & ~15u;
+}
+
+
+uint32_t DXEntityWorld::ComponentSize(const DXComponentType type) {
+
+	return componentSizes[type];
+}
+
+
+DXEntityWorld::DXEntityWorld() {
+}
+
+
+DXEntityWorld::~DXEntityWorld() {
+
+	clear();
+}
+
+
+// Return the index of the archetype with the given component mask, creating it if needed.  A chunk holds the entity id array followed by one array per component, with as many entities as fit in DX_ENTITY_CHUNK_BYTES
+uint32_t DXEntityWorld::findArchetype(const uint32_t mask) {
+
+	for (uint32_t a = 0; a < archetypes.size(); a++)
+		if (archetypes[a].mask == mask)
+			return a;
+
+	DXArchetype A;
+
+	A.mask = mask;
+
+	uint32_t entitySize = sizeof(DXEntity);
+
+	for (uint32_t k = 0; k < DX_NUM_COMPONENT_TYPES; k++)
+		if (mask & DX_COMPONENT_BIT(k))
+			entitySize += componentSizes[k];
+
+	A.capacity = DX_ENTITY_CHUNK_BYTES / entitySize;
+
+	uint32_t offset = align16(A.capacity * sizeof(DXEntity));
+
+	for (uint32_t k = 0; k < DX_NUM_COMPONENT_TYPES; k++) {
+
+		A.offsets[k] = 0;
+
+		if (mask & DX_COMPONENT_BIT(k)) {
+
+			A.offsets[k] = offset;
+			offset += align16(A.capacity * componentSizes[k]);
+		}
+	}
+
+	A.blockSize = offset;
+
+	archetypes.push_back(A);
+
+	return (uint32_t)archetypes.size() - 1;
+}
+
+
+void DXEntityWorld::appendRow(const uint32_t a, const DXEntity e) {
+
+	DXArchetype& A = archetypes[a];
+
+	if (A.chunks.empty() || A.chunks.back().count == A.capacity) {
+
+		DXEntityChunk C;
+
+		C.block = (uint8_t*)_aligned_malloc(A.blockSize, 64);
+
+		if (!C.block)
+			throw exception("DXEntityWorld: Cannot allocate chunk");
+
+		C.count = 0;
+		C.capacity = A.capacity;
+		C.mask = A.mask;
+		memcpy(C.offsets, A.offsets, sizeof(C.offsets));
+
+		A.chunks.push_back(C);
+	}
+
+	DXEntityChunk& C = A.chunks.back();
+
+	uint32_t row = C.count++;
+
+	((DXEntity*)C.block)[row] = e;
+
+	for (uint32_t k = 0; k < DX_NUM_COMPONENT_TYPES; k++)
+		if (A.mask & DX_COMPONENT_BIT(k))
+			memset(C.block + C.offsets[k] + row * componentSizes[k], 0, componentSizes[k]);
+
+	DXEntityRecord& R = records[e & DX_ENTITY_INDEX_MASK];
+
+	R.archetype = a;
+	R.chunk = (uint32_t)A.chunks.size() - 1;
+	R.row = row;
+}
+
+
+void DXEntityWorld::removeRow(const uint32_t a, const uint32_t chunk, const uint32_t row) {
+
+	DXArchetype& A = archetypes[a];
+	DXEntityChunk& C = A.chunks[chunk];
+	DXEntityChunk& L = A.chunks.back();
+
+	uint32_t lastRow = L.count - 1;
+
+	if (&C != &L || row != lastRow) {
+
+		DXEntity moved = ((DXEntity*)L.block)[lastRow];
+
+		((DXEntity*)C.block)[row] = moved;
+
+		for (uint32_t k = 0; k < DX_NUM_COMPONENT_TYPES; k++)
+			if (A.mask & DX_COMPONENT_BIT(k))
+				memcpy(C.block + C.offsets[k] + row * componentSizes[k], L.block + L.offsets[k] + lastRow * componentSizes[k], componentSizes[k]);
+
+		DXEntityRecord& R = records[moved & DX_ENTITY_INDEX_MASK];
+
+		R.chunk = chunk;
+		R.row = row;
+	}
+
+	// Release the last chunk once it is empty so every chunk but the last stays full
+	if (--L.count == 0) {
+
+		_aligned_free(L.block);
+		A.chunks.pop_back();
+	}
+}
+
+
+const DXEntityWorld::DXEntityRecord* DXEntityWorld::record(const DXEntity e) const {
+
+	uint32_t index = e & DX_ENTITY_INDEX_MASK;
+
+	if (e == DX_NULL_ENTITY || index >= records.size())
+		return nullptr;
+
+	const DXEntityRecord& R = records[index];
+
+	if (R.archetype == DX_NULL_ENTITY || R.generation != (e >> DX_ENTITY_INDEX_BITS))
+		return nullptr;
+
+	return &R;
+}
+
+
+DXEntity DXEntityWorld::create(const uint32_t componentMask) {
+
+	if (componentMask >> DX_NUM_COMPONENT_TYPES)
+		throw exception("DXEntityWorld: Invalid component mask");
+
+	uint32_t index;
+
+	if (!freeRecords.empty()) {
+
+		index = freeRecords.back();
+		freeRecords.pop_back();
+
+	} else {
+
+		// The highest index with generation 0xFF would equal DX_NULL_ENTITY
+		if (records.size() >= DX_ENTITY_INDEX_MASK)
+			throw exception("DXEntityWorld: Too many entities");
+
+		DXEntityRecord R = { DX_NULL_ENTITY, 0, 0, 0 };
+
+		index = (uint32_t)records.size();
+		records.push_back(R);
+	}
+
+	DXEntity e = index | (records[index].generation << DX_ENTITY_INDEX_BITS);
+
+	appendRow(findArchetype(componentMask), e);
+
+	numEntities++;
+
+	return e;
+}
+
+
+void DXEntityWorld::destroy(const DXEntity e) {
+
+	const DXEntityRecord *R = record(e);
+
+	if (!R)
+		return;
+
+	uint32_t index = e & DX_ENTITY_INDEX_MASK;
+
+	removeRow(R->archetype, R->chunk, R->row);
+
+	DXEntityRecord& F = records[index];
+
+	F.archetype = DX_NULL_ENTITY;
+	F.generation = (F.generation + 1) & 0xFF;
+
+	freeRecords.push_back(index);
+
+	numEntities--;
+}
+
+
+void DXEntityWorld::clear() {
+
+	for (uint32_t a = 0; a < archetypes.size(); a++)
+		for (uint32_t c = 0; c < archetypes[a].chunks.size(); c++)
+			_aligned_free(archetypes[a].chunks[c].block);
+
+	archetypes.clear();
+	records.clear();
+	freeRecords.clear();
+
+	numEntities = 0;
+}
+
+
+bool DXEntityWorld::isAlive(const DXEntity e) const {
+
+	return record(e) != nullptr;
+}
+
+
+uint32_t DXEntityWorld::componentMask(const DXEntity e) const {
+
+	const DXEntityRecord *R = record(e);
+
+	return (R) ? archetypes[R->archetype].mask : 0;
+}
+
+
+void DXEntityWorld::addComponents(const DXEntity e, const uint32_t mask) {
+
+	const DXEntityRecord *R = record(e);
+
+	if (!R)
+		return;
+
+	uint32_t oldMask = archetypes[R->archetype].mask;
+	uint32_t newMask = oldMask | mask;
+
+	if (newMask >> DX_NUM_COMPONENT_TYPES)
+		throw exception("DXEntityWorld: Invalid component mask");
+
+	if (newMask == oldMask)
+		return;
+
+	uint32_t oldArchetype = R->archetype;
+	uint32_t oldChunk = R->chunk;
+	uint32_t oldRow = R->row;
+
+	// findArchetype can reallocate archetypes so chunks are only referenced once both archetypes exist
+	uint32_t newArchetype = findArchetype(newMask);
+
+	appendRow(newArchetype, e);
+
+	const DXEntityChunk& src = archetypes[oldArchetype].chunks[oldChunk];
+	const DXEntityChunk& dst = archetypes[newArchetype].chunks[R->chunk];
+
+	for (uint32_t k = 0; k < DX_NUM_COMPONENT_TYPES; k++)
+		if (oldMask & DX_COMPONENT_BIT(k))
+			memcpy(dst.block + dst.offsets[k] + R->row * componentSizes[k], src.block + src.offsets[k] + oldRow * componentSizes[k], componentSizes[k]);
+
+	removeRow(oldArchetype, oldChunk, oldRow);
+}
+
+
+void DXEntityWorld::removeComponents(const DXEntity e, const uint32_t mask) {
+
+	const DXEntityRecord *R = record(e);
+
+	if (!R)
+		return;
+
+	uint32_t oldMask = archetypes[R->archetype].mask;
+	uint32_t newMask = oldMask & ~mask;
+
+	if (newMask == oldMask)
+		return;
+
+	uint32_t oldArchetype = R->archetype;
+	uint32_t oldChunk = R->chunk;
+	uint32_t oldRow = R->row;
+
+	uint32_t newArchetype = findArchetype(newMask);
+
+	appendRow(newArchetype, e);
+
+	const DXEntityChunk& src = archetypes[oldArchetype].chunks[oldChunk];
+	const DXEntityChunk& dst = archetypes[newArchetype].chunks[R->chunk];
+
+	for (uint32_t k = 0; k < DX_NUM_COMPONENT_TYPES; k++)
+		if (newMask & DX_COMPONENT_BIT(k))
+			memcpy(dst.block + dst.offsets[k] + R->row * componentSizes[k], src.block + src.offsets[k] + oldRow * componentSizes[k], componentSizes[k]);
+
+	removeRow(oldArchetype, oldChunk, oldRow);
+}
+
+
+void* DXEntityWorld::component(const DXEntity e, const DXComponentType type) {
+
+	const DXEntityRecord *R = record(e);
+
+	if (!R || !(archetypes[R->archetype].mask & DX_COMPONENT_BIT(type)))
+		return nullptr;
+
+	const DXEntityChunk& C = archetypes[R->archetype].chunks[R->chunk];
+
+	return C.block + C.offsets[type] + R->row * componentSizes[type];
+}
+
+
+uint32_t DXEntityWorld::entityCount() const {
+
+	return numEntities;
+}
+
+
+uint32_t DXEntityWorld::archetypeCount() const {
+
+	return (uint32_t)archetypes.size();
+}
+
+
+void DXEntityWorld::queryChunks(const uint32_t requiredMask, vector<DXEntityChunk*>& chunksOut) {
+
+	chunksOut.clear();
+
+	for (uint32_t a = 0; a < archetypes.size(); a++) {
+
+		DXArchetype& A = archetypes[a];
+
+		if ((A.mask & requiredMask) != requiredMask)
+			continue;
+
+		for (uint32_t c = 0; c < A.chunks.size(); c++)
+			chunksOut.push_back(&A.chunks[c]);
+	}
+}
@@ -0,0 +1,121 @@
+
+//
+// DXEntityWorld.h
+//
+
+// Archetype based entity-component storage.  Entities with the same set of components (an archetype) are stored together in fixed size chunks, and each chunk holds one tightly packed array per component (structure-of-arrays), so a system that only reads transforms or bounds walks contiguous memory.  Removing an entity moves the archetype's last entity into its slot so every chunk but the last stays full.  Entity ids hold a generation count so ids of destroyed entities are detected.  Component arrays are 16 byte aligned.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DXEntityComponents.h>
+#include <vector>
+#include <cstdint>
+
+
+typedef uint32_t DXEntity;
+
+// Returned when an entity cannot be created and never used for a live entity
+#define DX_NULL_ENTITY				0xFFFFFFFF
+
+// Entity ids hold the record index in the low bits and the generation of the record in the high bits
+#define DX_ENTITY_INDEX_BITS		24
+#define DX_ENTITY_INDEX_MASK		((1u << DX_ENTITY_INDEX_BITS) - 1)
+
+// Target size in bytes of the component storage of a chunk
+#define DX_ENTITY_CHUNK_BYTES		16384
+
+
+// Component arrays of one chunk.  Systems receive chunks from DXEntityWorld::queryChunks and process entities [0, count)
+struct DXEntityChunk {
+
+	uint8_t								*block;
+	uint32_t							count;
+	uint32_t							capacity;
+	uint32_t							mask; // Components present in the chunk's archetype
+	uint32_t							offsets[DX_NUM_COMPONENT_TYPES]; // Byte offset of each component array in block
+
+	const DXEntity* entities() const { return (const DXEntity*)block; }
+
+	bool has(const DXComponentType type) const { return (mask & DX_COMPONENT_BIT(type)) != 0; }
+
+	// Return the array of component T, or null if the archetype does not have it
+	template <typename T>
+	T* components() const { return has((DXComponentType)T::type) ? (T*)(block + offsets[T::type]) : nullptr; }
+};
+
+
+class DXEntityWorld : public GUObject {
+
+	struct DXArchetype {
+
+		uint32_t						mask;
+		uint32_t						offsets[DX_NUM_COMPONENT_TYPES];
+		uint32_t						capacity; // Entities per chunk
+		uint32_t						blockSize;
+		std::vector<DXEntityChunk>		chunks;
+	};
+
+	// Location of each entity.  Free records have archetype DX_NULL_ENTITY and are reused with the next generation
+	struct DXEntityRecord {
+
+		uint32_t						archetype;
+		uint32_t						chunk;
+		uint32_t						row;
+		uint32_t						generation;
+	};
+
+	std::vector<DXArchetype>			archetypes;
+	std::vector<DXEntityRecord>			records;
+	std::vector<uint32_t>				freeRecords;
+	uint32_t							numEntities = 0;
+
+	uint32_t findArchetype(const uint32_t mask);
+
+	// Append a zeroed row for entity e to archetype a and store its location in the entity's record
+	void appendRow(const uint32_t a, const DXEntity e);
+
+	// Remove a row from archetype a by moving the archetype's last row into it
+	void removeRow(const uint32_t a, const uint32_t chunk, const uint32_t row);
+
+	const DXEntityRecord* record(const DXEntity e) const;
+
+	// Not copyable.  A copy would share and free the same chunk blocks.  Declared but not defined
+	DXEntityWorld(const DXEntityWorld&);
+	DXEntityWorld& operator=(const DXEntityWorld&);
+
+public:
+
+	// Size in bytes of a component of the given type
+	static uint32_t ComponentSize(const DXComponentType type);
+
+	DXEntityWorld();
+	~DXEntityWorld();
+
+	// Create an entity with the components in componentMask (a combination of DX_COMPONENT_BIT values).  Components are zero initialised
+	DXEntity create(const uint32_t componentMask);
+
+	void destroy(const DXEntity e);
+
+	// Remove all entities.  Chunk storage is released
+	void clear();
+
+	bool isAlive(const DXEntity e) const;
+	uint32_t componentMask(const DXEntity e) const;
+
+	// Add or remove components, moving the entity to the archetype of its new component set.  The entity id and the values of the components it keeps are unchanged.  Added components are zero initialised
+	void addComponents(const DXEntity e, const uint32_t mask);
+	void removeComponents(const DXEntity e, const uint32_t mask);
+
+	// Return the component of type T of entity e, or null if e is not alive or does not have the component.  The pointer is invalidated when entities are created, destroyed or change components
+	void* component(const DXEntity e, const DXComponentType type);
+
+	template <typename T>
+	T* get(const DXEntity e) { return (T*)component(e, (DXComponentType)T::type); }
+
+	uint32_t entityCount() const;
+	uint32_t archetypeCount() const;
+
+	// Collect the non-empty chunks of every archetype with all the components in requiredMask.  The pointers are invalidated when entities are created, destroyed or change components
+	void queryChunks(const uint32_t requiredMask, std::vector<DXEntityChunk*>& chunksOut);
+};
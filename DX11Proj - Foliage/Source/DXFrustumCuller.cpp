@@ -0,0 +1,401 @@
+
+//
+// DXFrustumCuller.cpp
+//
+
+#include <stdafx.h>
+#include <DXFrustumCuller.h>
+#include <exception>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace DirectX;
+
+
+// Return a bitmask with bit i set if lane i of the comparison result V is true
+static inline int laneMask(FXMVECTOR V) {
+
+#if defined(_XM_SSE_INTRINSICS_)
+
+	return _mm_movemask_ps(V);
+
+#else
+
+	XMUINT4 u;
+	XMStoreUInt4(&u, V);
+
+	return (u.x & 1) | ((u.y & 1) << 1) | ((u.z & 1) << 2) | ((u.w & 1) << 3);
+
+#endif
+}
+
+
+// Write the indices of the set bits in mask (offset by base) to visibleIndices.  Only the first numLanes lanes are considered so padding lanes at the end of the SoA arrays are never reported
+static inline uint32_t emitVisible(int mask, const uint32_t base, const uint32_t numLanes, uint32_t *visibleIndices, uint32_t numVisible) {
+
+	for (uint32_t lane = 0; lane < numLanes; ++lane) {
+
+		visibleIndices[numVisible] = base + lane;
+		numVisible += (mask >> lane) & 1;
+	}
+
+	return numVisible;
+}
+
+
+
+//
+// Class methods
+//
+
+// Extract the 6 world-space frustum planes from the combined view-projection matrix
+void DXFrustumCuller::ExtractPlanes(FXMMATRIX viewProj, XMFLOAT4 *planesOut) {
+
+	// With row vectors clip = v * M, so each clip coordinate is the dot product of v with a column of M.  Transpose M so the columns can be accessed as rows
+	XMMATRIX C = XMMatrixTranspose(viewProj);
+
+	XMVECTOR P[DX_NUM_FRUSTUM_PLANES];
+
+	P[DX_PLANE_LEFT] = XMVectorAdd(C.r[3], C.r[0]);
+	P[DX_PLANE_RIGHT] = XMVectorSubtract(C.r[3], C.r[0]);
+	P[DX_PLANE_BOTTOM] = XMVectorAdd(C.r[3], C.r[1]);
+	P[DX_PLANE_TOP] = XMVectorSubtract(C.r[3], C.r[1]);
+	P[DX_PLANE_NEAR] = C.r[2];
+	P[DX_PLANE_FAR] = XMVectorSubtract(C.r[3], C.r[2]);
+
+	for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k)
+		XMStoreFloat4(&planesOut[k], XMPlaneNormalize(P[k]));
+}
+
+
+bool DXFrustumCuller::SphereVisible(const XMFLOAT4 *frustumPlanes, const DXBoundingVolume& B) {
+
+	for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+		const XMFLOAT4& p = frustumPlanes[k];
+
+		if (p.x * B.centre.x + p.y * B.centre.y + p.z * B.centre.z + p.w < -B.radius)
+			return false;
+	}
+
+	return true;
+}
+
+
+bool DXFrustumCuller::BoxVisible(const XMFLOAT4 *frustumPlanes, const DXBoundingVolume& B) {
+
+	for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+		const XMFLOAT4& p = frustumPlanes[k];
+
+		float dist = p.x * B.centre.x + p.y * B.centre.y + p.z * B.centre.z + p.w;
+		float reff = fabsf(p.x) * B.extents.x + fabsf(p.y) * B.extents.y + fabsf(p.z) * B.extents.z;
+
+		if (dist < -reff)
+			return false;
+	}
+
+	return true;
+}
+
+
+
+//
+// Instance methods
+//
+
+DXFrustumCuller::DXFrustumCuller(const uint32_t initCapacity) {
+
+	// Default to a frustum that accepts everything until setViewProjection is called
+	for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k)
+		planes[k] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	reserve(initCapacity);
+}
+
+
+DXFrustumCuller::~DXFrustumCuller() {
+
+	if (block)
+		_aligned_free(block);
+}
+
+
+void DXFrustumCuller::reserve(const uint32_t newCapacity) {
+
+	// Round up to a whole number of cull batches
+	uint32_t paddedCapacity = ((newCapacity + DX_CULL_LANES - 1) / DX_CULL_LANES) * DX_CULL_LANES;
+
+	if (paddedCapacity == 0)
+		paddedCapacity = DX_CULL_LANES;
+
+	if (paddedCapacity <= capacity)
+		return;
+
+	float *newBlock = (float*)_aligned_malloc(paddedCapacity * 7 * sizeof(float), 32);
+
+	if (!newBlock)
+		throw exception("DXFrustumCuller: Cannot allocate bounding volume arrays");
+
+	memset(newBlock, 0, paddedCapacity * 7 * sizeof(float));
+
+	float *newArrays[7];
+
+	for (int k = 0; k < 7; ++k)
+		newArrays[k] = newBlock + k * paddedCapacity;
+
+	if (block) {
+
+		float *oldArrays[7] = { cx, cy, cz, ex, ey, ez, r };
+
+		for (int k = 0; k < 7; ++k)
+			memcpy(newArrays[k], oldArrays[k], numVolumes * sizeof(float));
+
+		_aligned_free(block);
+	}
+
+	block = newBlock;
+	capacity = paddedCapacity;
+
+	cx = newArrays[0]; cy = newArrays[1]; cz = newArrays[2];
+	ex = newArrays[3]; ey = newArrays[4]; ez = newArrays[5];
+	r = newArrays[6];
+}
+
+
+uint32_t DXFrustumCuller::addVolume(const DXBoundingVolume& B) {
+
+	if (numVolumes == capacity)
+		reserve(capacity * 2);
+
+	setVolume(numVolumes, B);
+
+	return numVolumes++;
+}
+
+
+void DXFrustumCuller::setVolume(const uint32_t index, const DXBoundingVolume& B) {
+
+	cx[index] = B.centre.x;
+	cy[index] = B.centre.y;
+	cz[index] = B.centre.z;
+	ex[index] = B.extents.x;
+	ey[index] = B.extents.y;
+	ez[index] = B.extents.z;
+	r[index] = B.radius;
+}
+
+
+DXBoundingVolume DXFrustumCuller::getVolume(const uint32_t index) const {
+
+	DXBoundingVolume B;
+
+	B.centre = XMFLOAT3(cx[index], cy[index], cz[index]);
+	B.extents = XMFLOAT3(ex[index], ey[index], ez[index]);
+	B.radius = r[index];
+
+	return B;
+}
+
+
+void DXFrustumCuller::clear() {
+
+	numVolumes = 0;
+}
+
+
+uint32_t DXFrustumCuller::volumeCount() const {
+
+	return numVolumes;
+}
+
+
+void DXFrustumCuller::setViewProjection(FXMMATRIX viewProj) {
+
+	ExtractPlanes(viewProj, planes);
+}
+
+
+const XMFLOAT4* DXFrustumCuller::getPlanes() const {
+
+	return planes;
+}
+
+
+bool DXFrustumCuller::sphereVisible(const DXBoundingVolume& B) const {
+
+	return SphereVisible(planes, B);
+}
+
+
+bool DXFrustumCuller::boxVisible(const DXBoundingVolume& B) const {
+
+	return BoxVisible(planes, B);
+}
+
+
+// Batched sphere test - a sphere is culled if its centre lies further than r behind any plane
+uint32_t DXFrustumCuller::cullSpheres(uint32_t *visibleIndices) const {
+
+	uint32_t numVisible = 0;
+
+#if defined(__AVX__)
+
+	__m256 pa[DX_NUM_FRUSTUM_PLANES], pb[DX_NUM_FRUSTUM_PLANES], pc[DX_NUM_FRUSTUM_PLANES], pd[DX_NUM_FRUSTUM_PLANES];
+
+	for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+		pa[k] = _mm256_set1_ps(planes[k].x);
+		pb[k] = _mm256_set1_ps(planes[k].y);
+		pc[k] = _mm256_set1_ps(planes[k].z);
+		pd[k] = _mm256_set1_ps(planes[k].w);
+	}
+
+	for (uint32_t i = 0; i < numVolumes; i += DX_CULL_LANES) {
+
+		__m256 x = _mm256_load_ps(cx + i);
+		__m256 y = _mm256_load_ps(cy + i);
+		__m256 z = _mm256_load_ps(cz + i);
+		__m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_load_ps(r + i));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+			__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pa[k], x), _mm256_mul_ps(pb[k], y)), _mm256_add_ps(_mm256_mul_ps(pc[k], z), pd[k]));
+
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, negR, _CMP_GE_OQ));
+		}
+
+		uint32_t numLanes = (numVolumes - i < DX_CULL_LANES) ? numVolumes - i : DX_CULL_LANES;
+		numVisible = emitVisible(_mm256_movemask_ps(inside), i, numLanes, visibleIndices, numVisible);
+	}
+
+#else
+
+	XMVECTOR pa[DX_NUM_FRUSTUM_PLANES], pb[DX_NUM_FRUSTUM_PLANES], pc[DX_NUM_FRUSTUM_PLANES], pd[DX_NUM_FRUSTUM_PLANES];
+
+	for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+		pa[k] = XMVectorReplicate(planes[k].x);
+		pb[k] = XMVectorReplicate(planes[k].y);
+		pc[k] = XMVectorReplicate(planes[k].z);
+		pd[k] = XMVectorReplicate(planes[k].w);
+	}
+
+	for (uint32_t i = 0; i < numVolumes; i += DX_CULL_LANES) {
+
+		XMVECTOR x = XMLoadFloat4A((const XMFLOAT4A*)(cx + i));
+		XMVECTOR y = XMLoadFloat4A((const XMFLOAT4A*)(cy + i));
+		XMVECTOR z = XMLoadFloat4A((const XMFLOAT4A*)(cz + i));
+		XMVECTOR negR = XMVectorNegate(XMLoadFloat4A((const XMFLOAT4A*)(r + i)));
+
+		XMVECTOR inside = XMVectorTrueInt();
+
+		for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+			XMVECTOR dist = XMVectorMultiplyAdd(pa[k], x, XMVectorMultiplyAdd(pb[k], y, XMVectorMultiplyAdd(pc[k], z, pd[k])));
+
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(dist, negR));
+		}
+
+		uint32_t numLanes = (numVolumes - i < DX_CULL_LANES) ? numVolumes - i : DX_CULL_LANES;
+		numVisible = emitVisible(laneMask(inside), i, numLanes, visibleIndices, numVisible);
+	}
+
+#endif
+
+	return numVisible;
+}
+
+
+// Batched box test - the box is projected onto each plane normal giving an effective radius |a|ex + |b|ey + |c|ez.  The box is culled if its centre lies further than this behind any plane
+uint32_t DXFrustumCuller::cullBoxes(uint32_t *visibleIndices) const {
+
+	uint32_t numVisible = 0;
+
+#if defined(__AVX__)
+
+	__m256 pa[DX_NUM_FRUSTUM_PLANES], pb[DX_NUM_FRUSTUM_PLANES], pc[DX_NUM_FRUSTUM_PLANES], pd[DX_NUM_FRUSTUM_PLANES];
+	__m256 aa[DX_NUM_FRUSTUM_PLANES], ab[DX_NUM_FRUSTUM_PLANES], ac[DX_NUM_FRUSTUM_PLANES];
+
+	for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+		pa[k] = _mm256_set1_ps(planes[k].x);
+		pb[k] = _mm256_set1_ps(planes[k].y);
+		pc[k] = _mm256_set1_ps(planes[k].z);
+		pd[k] = _mm256_set1_ps(planes[k].w);
+		aa[k] = _mm256_set1_ps(fabsf(planes[k].x));
+		ab[k] = _mm256_set1_ps(fabsf(planes[k].y));
+		ac[k] = _mm256_set1_ps(fabsf(planes[k].z));
+	}
+
+	for (uint32_t i = 0; i < numVolumes; i += DX_CULL_LANES) {
+
+		__m256 x = _mm256_load_ps(cx + i);
+		__m256 y = _mm256_load_ps(cy + i);
+		__m256 z = _mm256_load_ps(cz + i);
+		__m256 hx = _mm256_load_ps(ex + i);
+		__m256 hy = _mm256_load_ps(ey + i);
+		__m256 hz = _mm256_load_ps(ez + i);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+			__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pa[k], x), _mm256_mul_ps(pb[k], y)), _mm256_add_ps(_mm256_mul_ps(pc[k], z), pd[k]));
+			__m256 reff = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(aa[k], hx), _mm256_mul_ps(ab[k], hy)), _mm256_mul_ps(ac[k], hz));
+
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(dist, reff), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		uint32_t numLanes = (numVolumes - i < DX_CULL_LANES) ? numVolumes - i : DX_CULL_LANES;
+		numVisible = emitVisible(_mm256_movemask_ps(inside), i, numLanes, visibleIndices, numVisible);
+	}
+
+#else
+
+	XMVECTOR pa[DX_NUM_FRUSTUM_PLANES], pb[DX_NUM_FRUSTUM_PLANES], pc[DX_NUM_FRUSTUM_PLANES], pd[DX_NUM_FRUSTUM_PLANES];
+	XMVECTOR aa[DX_NUM_FRUSTUM_PLANES], ab[DX_NUM_FRUSTUM_PLANES], ac[DX_NUM_FRUSTUM_PLANES];
+
+	for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+		pa[k] = XMVectorReplicate(planes[k].x);
+		pb[k] = XMVectorReplicate(planes[k].y);
+		pc[k] = XMVectorReplicate(planes[k].z);
+		pd[k] = XMVectorReplicate(planes[k].w);
+		aa[k] = XMVectorAbs(pa[k]);
+		ab[k] = XMVectorAbs(pb[k]);
+		ac[k] = XMVectorAbs(pc[k]);
+	}
+
+	for (uint32_t i = 0; i < numVolumes; i += DX_CULL_LANES) {
+
+		XMVECTOR x = XMLoadFloat4A((const XMFLOAT4A*)(cx + i));
+		XMVECTOR y = XMLoadFloat4A((const XMFLOAT4A*)(cy + i));
+		XMVECTOR z = XMLoadFloat4A((const XMFLOAT4A*)(cz + i));
+		XMVECTOR hx = XMLoadFloat4A((const XMFLOAT4A*)(ex + i));
+		XMVECTOR hy = XMLoadFloat4A((const XMFLOAT4A*)(ey + i));
+		XMVECTOR hz = XMLoadFloat4A((const XMFLOAT4A*)(ez + i));
+
+		XMVECTOR inside = XMVectorTrueInt();
+
+		for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+			XMVECTOR dist = XMVectorMultiplyAdd(pa[k], x, XMVectorMultiplyAdd(pb[k], y, XMVectorMultiplyAdd(pc[k], z, pd[k])));
+			XMVECTOR reff = XMVectorMultiplyAdd(aa[k], hx, XMVectorMultiplyAdd(ab[k], hy, XMVectorMultiply(ac[k], hz)));
+
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorAdd(dist, reff), XMVectorZero()));
+		}
+
+		uint32_t numLanes = (numVolumes - i < DX_CULL_LANES) ? numVolumes - i : DX_CULL_LANES;
+		numVisible = emitVisible(laneMask(inside), i, numLanes, visibleIndices, numVisible);
+	}
+
+#endif
+
+	return numVisible;
+}
@@ -0,0 +1,81 @@
+
+//
+// DXFrustumCuller.h
+//
+
+// Batched view frustum culling of bounding volumes.  Volumes are stored in structure-of-arrays (SoA) form so the sphere and box tests can be evaluated against all 6 frustum planes for 4 volumes at a time (SSE via DirectXMath) or 8 volumes at a time when compiled with AVX (/arch:AVX).  The culler is independent of Direct3D so it can be run and timed on the CPU alone.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <DXBoundingVolume.h>
+#include <cstdint>
+
+
+// Number of volumes processed per iteration of the batched cull loops.  The SoA arrays are padded to a multiple of this so no scalar tail is needed
+#if defined(__AVX__)
+#define DX_CULL_LANES 8
+#else
+#define DX_CULL_LANES 4
+#endif
+
+
+// Frustum plane indices
+enum DXFrustumPlane { DX_PLANE_LEFT = 0, DX_PLANE_RIGHT, DX_PLANE_BOTTOM, DX_PLANE_TOP, DX_PLANE_NEAR, DX_PLANE_FAR, DX_NUM_FRUSTUM_PLANES };
+
+
+class DXFrustumCuller : public GUObject {
+
+	// SoA bounding volume data (centres, half extents and radii) stored in a single 32 byte aligned block
+	float								*block = nullptr;
+	float								*cx = nullptr, *cy = nullptr, *cz = nullptr;
+	float								*ex = nullptr, *ey = nullptr, *ez = nullptr;
+	float								*r = nullptr;
+
+	uint32_t							numVolumes = 0;
+	uint32_t							capacity = 0;
+
+	// World-space frustum planes <a, b, c, d> normalised so |abc| = 1.  Points inside the frustum give a positive distance for every plane
+	DirectX::XMFLOAT4					planes[DX_NUM_FRUSTUM_PLANES];
+
+	void reserve(const uint32_t newCapacity);
+
+	// Not copyable.  A copy would share and free the same block.  Declared but not defined
+	DXFrustumCuller(const DXFrustumCuller&);
+	DXFrustumCuller& operator=(const DXFrustumCuller&);
+
+public:
+
+	// Extract the 6 world-space frustum planes from the combined view-projection matrix (Gribb / Hartmann).  Assumes the Direct3D clip volume (0 <= z <= w) and row-vector matrices as used by DirectXMath
+	static void ExtractPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 *planesOut);
+
+	// Single volume tests against an explicit plane set
+	static bool SphereVisible(const DirectX::XMFLOAT4 *frustumPlanes, const DXBoundingVolume& B);
+	static bool BoxVisible(const DirectX::XMFLOAT4 *frustumPlanes, const DXBoundingVolume& B);
+
+	DXFrustumCuller(const uint32_t initCapacity = 64);
+	~DXFrustumCuller();
+
+	// Add a new volume and return its index.  Indices are stable until clear() is called
+	uint32_t addVolume(const DXBoundingVolume& B);
+
+	// Update an existing volume (eg. for a moving instance)
+	void setVolume(const uint32_t index, const DXBoundingVolume& B);
+	DXBoundingVolume getVolume(const uint32_t index) const;
+
+	void clear();
+	uint32_t volumeCount() const;
+
+	// Setup the frustum planes for the current view
+	void setViewProjection(DirectX::FXMMATRIX viewProj);
+	const DirectX::XMFLOAT4* getPlanes() const;
+
+	// Single volume tests against the current frustum
+	bool sphereVisible(const DXBoundingVolume& B) const;
+	bool boxVisible(const DXBoundingVolume& B) const;
+
+	// Batched tests.  The indices of the volumes that intersect the frustum are written to visibleIndices in ascending order and the number of visible volumes is returned.  visibleIndices must have space for volumeCount() entries
+	uint32_t cullSpheres(uint32_t *visibleIndices) const;
+	uint32_t cullBoxes(uint32_t *visibleIndices) const;
+};
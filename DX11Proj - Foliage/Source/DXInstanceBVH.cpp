@@ -0,0 +1,592 @@
+
+//
+// DXInstanceBVH.cpp
+//
+
+#include <stdafx.h>
+#include <DXInstanceBVH.h>
+#include <DXFrustumCuller.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Set top bit of a frustum query stack entry to mark nodes already known to be inside the frustum
+#define DX_BVH_INSIDE_FLAG			0x80000000
+
+
+// Return half the surface area of the box (bmin, bmax).  The factor of 2 is common to every SAH term so is ignored
+static inline float halfArea(FXMVECTOR bmin, FXMVECTOR bmax) {
+
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, XMVectorSubtract(bmax, bmin));
+
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+
+// Return the axis component of v (0 = x, 1 = y, 2 = z)
+static inline float component(const XMFLOAT3& v, const int axis) {
+
+	return (&v.x)[axis];
+}
+
+
+// Return the bin index of the centroid coordinate c
+static inline int binIndex(const float c, const float binMin, const float binScale) {
+
+	int b = (int)((c - binMin) * binScale);
+
+	return (b < DX_BVH_NUM_BINS) ? b : DX_BVH_NUM_BINS - 1;
+}
+
+
+// Classify the box (bmin, bmax) against the frustum planes.  Returns 0 if the box is outside, 1 if it intersects the frustum boundary or 2 if it is entirely inside
+static inline int classifyBox(const XMFLOAT4 *frustumPlanes, const XMFLOAT3& bmin, const XMFLOAT3& bmax) {
+
+	XMFLOAT3 c = XMFLOAT3((bmin.x + bmax.x) * 0.5f, (bmin.y + bmax.y) * 0.5f, (bmin.z + bmax.z) * 0.5f);
+	XMFLOAT3 e = XMFLOAT3((bmax.x - bmin.x) * 0.5f, (bmax.y - bmin.y) * 0.5f, (bmax.z - bmin.z) * 0.5f);
+
+	int result = 2;
+
+	for (int k = 0; k < DX_NUM_FRUSTUM_PLANES; ++k) {
+
+		const XMFLOAT4& p = frustumPlanes[k];
+
+		float dist = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+		float reff = fabsf(p.x) * e.x + fabsf(p.y) * e.y + fabsf(p.z) * e.z;
+
+		if (dist < -reff)
+			return 0;
+
+		if (dist < reff)
+			result = 1;
+	}
+
+	return result;
+}
+
+
+// Slab test of the ray (o, invD) against the box (bmin, bmax) over the interval [0, tMax].  fminf / fmaxf are used so the NaNs that arise when the ray lies in a slab plane parallel to an axis are ignored.  On a hit tNear is the entry distance (0 if the origin is inside the box)
+static inline bool rayBox(const XMFLOAT3& o, const XMFLOAT3& invD, const XMFLOAT3& bmin, const XMFLOAT3& bmax, const float tMax, float *tNear) {
+
+	float tx1 = (bmin.x - o.x) * invD.x, tx2 = (bmax.x - o.x) * invD.x;
+	float ty1 = (bmin.y - o.y) * invD.y, ty2 = (bmax.y - o.y) * invD.y;
+	float tz1 = (bmin.z - o.z) * invD.z, tz2 = (bmax.z - o.z) * invD.z;
+
+	float t0 = fmaxf(fmaxf(fminf(tx1, tx2), fminf(ty1, ty2)), fmaxf(fminf(tz1, tz2), 0.0f));
+	float t1 = fminf(fminf(fmaxf(tx1, tx2), fmaxf(ty1, ty2)), fminf(fmaxf(tz1, tz2), tMax));
+
+	*tNear = t0;
+
+	return t0 <= t1;
+}
+
+
+// Return the squared distance from p to the box (bmin, bmax) - 0 if p is inside the box
+static inline float distanceSqToBox(FXMVECTOR p, const XMFLOAT3& bmin, const XMFLOAT3& bmax) {
+
+	XMVECTOR d = XMVectorMax(XMVectorSubtract(XMLoadFloat3(&bmin), p), XMVectorSubtract(p, XMLoadFloat3(&bmax)));
+	d = XMVectorMax(d, XMVectorZero());
+
+	return XMVectorGetX(XMVector3LengthSq(d));
+}
+
+
+
+DXInstanceBVH::DXInstanceBVH() {
+}
+
+
+DXInstanceBVH::~DXInstanceBVH() {
+}
+
+
+// Recalculate the bounds of a leaf from the instances it references
+void DXInstanceBVH::updateLeafBounds(DXBVHNode& node) const {
+
+	XMVECTOR bmin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR bmax = XMVectorReplicate(-FLT_MAX);
+
+	for (uint32_t i = 0; i < node.count; ++i) {
+
+		const DXBoundingVolume& B = volumes[primIndices[node.leftFirst + i]];
+
+		XMVECTOR C = XMLoadFloat3(&B.centre);
+		XMVECTOR E = XMLoadFloat3(&B.extents);
+
+		bmin = XMVectorMin(bmin, XMVectorSubtract(C, E));
+		bmax = XMVectorMax(bmax, XMVectorAdd(C, E));
+	}
+
+	XMStoreFloat3(&node.bmin, bmin);
+	XMStoreFloat3(&node.bmax, bmax);
+}
+
+
+// Binned SAH - the instances are distributed into DX_BVH_NUM_BINS bins over the centroid bounds along each axis and the cost of splitting between each pair of adjacent bins is evaluated with one sweep from each side
+float DXInstanceBVH::findBestSplit(const DXBVHNode& node, int *bestAxis, int *bestBin, float *binMin, float *binScale) const {
+
+	// Calculate the bounds of the instance centres
+	XMVECTOR cmin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR cmax = XMVectorReplicate(-FLT_MAX);
+
+	for (uint32_t i = 0; i < node.count; ++i) {
+
+		XMVECTOR C = XMLoadFloat3(&volumes[primIndices[node.leftFirst + i]].centre);
+
+		cmin = XMVectorMin(cmin, C);
+		cmax = XMVectorMax(cmax, C);
+	}
+
+	XMFLOAT3 centroidMin, centroidMax;
+
+	XMStoreFloat3(&centroidMin, cmin);
+	XMStoreFloat3(&centroidMax, cmax);
+
+	float bestCost = FLT_MAX;
+
+	for (int axis = 0; axis < 3; ++axis) {
+
+		float lo = component(centroidMin, axis);
+		float hi = component(centroidMax, axis);
+
+		if (hi <= lo)
+			continue;
+
+		float scale = (float)DX_BVH_NUM_BINS / (hi - lo);
+
+		// Populate bins
+		uint32_t binCount[DX_BVH_NUM_BINS];
+		XMVECTOR binBoxMin[DX_BVH_NUM_BINS], binBoxMax[DX_BVH_NUM_BINS];
+
+		for (int b = 0; b < DX_BVH_NUM_BINS; ++b) {
+
+			binCount[b] = 0;
+			binBoxMin[b] = XMVectorReplicate(FLT_MAX);
+			binBoxMax[b] = XMVectorReplicate(-FLT_MAX);
+		}
+
+		for (uint32_t i = 0; i < node.count; ++i) {
+
+			const DXBoundingVolume& B = volumes[primIndices[node.leftFirst + i]];
+
+			int b = binIndex(component(B.centre, axis), lo, scale);
+
+			XMVECTOR C = XMLoadFloat3(&B.centre);
+			XMVECTOR E = XMLoadFloat3(&B.extents);
+
+			binCount[b]++;
+			binBoxMin[b] = XMVectorMin(binBoxMin[b], XMVectorSubtract(C, E));
+			binBoxMax[b] = XMVectorMax(binBoxMax[b], XMVectorAdd(C, E));
+		}
+
+		// Sweep from the left and right to get the area and count on each side of every split plane
+		float leftArea[DX_BVH_NUM_BINS - 1], rightArea[DX_BVH_NUM_BINS - 1];
+		uint32_t leftCount[DX_BVH_NUM_BINS - 1], rightCount[DX_BVH_NUM_BINS - 1];
+
+		XMVECTOR lmin = XMVectorReplicate(FLT_MAX), lmax = XMVectorReplicate(-FLT_MAX);
+		XMVECTOR rmin = XMVectorReplicate(FLT_MAX), rmax = XMVectorReplicate(-FLT_MAX);
+		uint32_t lsum = 0, rsum = 0;
+
+		for (int k = 0; k < DX_BVH_NUM_BINS - 1; ++k) {
+
+			lsum += binCount[k];
+			lmin = XMVectorMin(lmin, binBoxMin[k]);
+			lmax = XMVectorMax(lmax, binBoxMax[k]);
+			leftCount[k] = lsum;
+			leftArea[k] = (lsum > 0) ? halfArea(lmin, lmax) : 0.0f;
+
+			int r = DX_BVH_NUM_BINS - 1 - k;
+
+			rsum += binCount[r];
+			rmin = XMVectorMin(rmin, binBoxMin[r]);
+			rmax = XMVectorMax(rmax, binBoxMax[r]);
+			rightCount[r - 1] = rsum;
+			rightArea[r - 1] = (rsum > 0) ? halfArea(rmin, rmax) : 0.0f;
+		}
+
+		// Split k places bins [0, k] on the left and [k + 1, DX_BVH_NUM_BINS) on the right
+		for (int k = 0; k < DX_BVH_NUM_BINS - 1; ++k) {
+
+			if (leftCount[k] == 0 || rightCount[k] == 0)
+				continue;
+
+			float cost = (float)leftCount[k] * leftArea[k] + (float)rightCount[k] * rightArea[k];
+
+			if (cost < bestCost) {
+
+				bestCost = cost;
+				*bestAxis = axis;
+				*bestBin = k + 1;
+				*binMin = lo;
+				*binScale = scale;
+			}
+		}
+	}
+
+	return bestCost;
+}
+
+
+// Build the hierarchy over count world-space instance volumes
+void DXInstanceBVH::build(const DXBoundingVolume *instanceVolumes, const uint32_t count) {
+
+	nodes.clear();
+	numNodes = 0;
+
+	if (!instanceVolumes || count == 0) {
+
+		volumes.clear();
+		primIndices.clear();
+		return;
+	}
+
+	volumes.assign(instanceVolumes, instanceVolumes + count);
+
+	primIndices.resize(count);
+
+	for (uint32_t i = 0; i < count; ++i)
+		primIndices[i] = i;
+
+	// A binary tree with one instance per leaf has at most 2n - 1 nodes so the node array never needs to grow during the build
+	nodes.resize(2 * count - 1);
+
+	DXBVHNode& root = nodes[0];
+
+	root.leftFirst = 0;
+	root.count = count;
+	updateLeafBounds(root);
+
+	numNodes = 1;
+
+	// Subdivide top-down.  Each stack entry is a node and its depth.  Only one child is pushed per level descended so the stack never holds more than DX_BVH_MAX_DEPTH + 1 entries
+	uint32_t nodeStack[DX_BVH_MAX_DEPTH + 2];
+	uint32_t depthStack[DX_BVH_MAX_DEPTH + 2];
+	int sp = 0;
+
+	nodeStack[sp] = 0;
+	depthStack[sp++] = 0;
+
+	while (sp > 0) {
+
+		--sp;
+
+		uint32_t nodeIndex = nodeStack[sp];
+		uint32_t depth = depthStack[sp];
+
+		DXBVHNode& node = nodes[nodeIndex];
+
+		if (node.count <= 1 || depth >= DX_BVH_MAX_DEPTH)
+			continue;
+
+		int axis = 0, splitBin = 0;
+		float binMin = 0.0f, binScale = 0.0f;
+
+		float splitCost = findBestSplit(node, &axis, &splitBin, &binMin, &binScale);
+
+		// All centres coincide so no split is possible
+		if (splitCost == FLT_MAX)
+			continue;
+
+		// Make a leaf when the SAH says testing the instances directly is cheaper than visiting two children
+		float nodeArea = halfArea(XMLoadFloat3(&node.bmin), XMLoadFloat3(&node.bmax));
+		float leafCost = (float)node.count * nodeArea;
+
+		if (DX_BVH_TRAVERSAL_COST * nodeArea + splitCost >= leafCost && node.count <= DX_BVH_MAX_LEAF_SIZE)
+			continue;
+
+		// Partition the instance indices in place about the split plane
+		uint32_t first = node.leftFirst;
+		uint32_t i = first;
+		uint32_t end = first + node.count;
+
+		while (i < end) {
+
+			if (binIndex(component(volumes[primIndices[i]].centre, axis), binMin, binScale) < splitBin)
+				i++;
+			else
+				swap(primIndices[i], primIndices[--end]);
+		}
+
+		uint32_t leftCount = i - first;
+
+		// Create child nodes
+		uint32_t leftIndex = numNodes;
+		numNodes += 2;
+
+		DXBVHNode& left = nodes[leftIndex];
+		DXBVHNode& right = nodes[leftIndex + 1];
+
+		left.leftFirst = first;
+		left.count = leftCount;
+		right.leftFirst = i;
+		right.count = node.count - leftCount;
+
+		updateLeafBounds(left);
+		updateLeafBounds(right);
+
+		node.leftFirst = leftIndex;
+		node.count = 0;
+
+		nodeStack[sp] = leftIndex + 1;
+		depthStack[sp++] = depth + 1;
+		nodeStack[sp] = leftIndex;
+		depthStack[sp++] = depth + 1;
+	}
+}
+
+
+void DXInstanceBVH::setVolume(const uint32_t index, const DXBoundingVolume& B) {
+
+	volumes[index] = B;
+}
+
+
+// Children are always stored after their parent so walking the node array backwards visits both children of a node before the node itself
+void DXInstanceBVH::refit() {
+
+	for (int i = (int)numNodes - 1; i >= 0; --i) {
+
+		DXBVHNode& node = nodes[i];
+
+		if (node.count > 0) {
+
+			updateLeafBounds(node);
+
+		} else {
+
+			const DXBVHNode& left = nodes[node.leftFirst];
+			const DXBVHNode& right = nodes[node.leftFirst + 1];
+
+			XMStoreFloat3(&node.bmin, XMVectorMin(XMLoadFloat3(&left.bmin), XMLoadFloat3(&right.bmin)));
+			XMStoreFloat3(&node.bmax, XMVectorMax(XMLoadFloat3(&left.bmax), XMLoadFloat3(&right.bmax)));
+		}
+	}
+}
+
+
+uint32_t DXInstanceBVH::instanceCount() const {
+
+	return (uint32_t)volumes.size();
+}
+
+
+uint32_t DXInstanceBVH::nodeCount() const {
+
+	return numNodes;
+}
+
+
+const DXBoundingVolume& DXInstanceBVH::getVolume(const uint32_t index) const {
+
+	return volumes[index];
+}
+
+
+// Frustum query
+uint32_t DXInstanceBVH::frustumQuery(const XMFLOAT4 *frustumPlanes, vector<uint32_t>& visibleInstances) const {
+
+	visibleInstances.clear();
+
+	if (numNodes == 0)
+		return 0;
+
+	uint32_t stack[DX_BVH_MAX_DEPTH + 2];
+	int sp = 0;
+
+	stack[sp++] = 0;
+
+	while (sp > 0) {
+
+		uint32_t entry = stack[--sp];
+		uint32_t nodeIndex = entry & ~DX_BVH_INSIDE_FLAG;
+		uint32_t inside = entry & DX_BVH_INSIDE_FLAG;
+
+		const DXBVHNode& node = nodes[nodeIndex];
+
+		if (!inside) {
+
+			int c = classifyBox(frustumPlanes, node.bmin, node.bmax);
+
+			if (c == 0)
+				continue;
+
+			if (c == 2)
+				inside = DX_BVH_INSIDE_FLAG;
+		}
+
+		if (node.count > 0) {
+
+			for (uint32_t i = 0; i < node.count; ++i) {
+
+				uint32_t instanceIndex = primIndices[node.leftFirst + i];
+
+				if (inside || DXFrustumCuller::BoxVisible(frustumPlanes, volumes[instanceIndex]))
+					visibleInstances.push_back(instanceIndex);
+			}
+
+		} else {
+
+			stack[sp++] = (node.leftFirst + 1) | inside;
+			stack[sp++] = node.leftFirst | inside;
+		}
+	}
+
+	return (uint32_t)visibleInstances.size();
+}
+
+
+// Ray query.  Children are visited nearest first so closer hits shrink the search interval early
+bool DXInstanceBVH::raycast(FXMVECTOR origin, FXMVECTOR direction, uint32_t *hitIndex, float *hitT, const float maxT) const {
+
+	if (numNodes == 0)
+		return false;
+
+	XMFLOAT3 o, d;
+
+	XMStoreFloat3(&o, origin);
+	XMStoreFloat3(&d, direction);
+
+	XMFLOAT3 invD = XMFLOAT3(1.0f / d.x, 1.0f / d.y, 1.0f / d.z);
+
+	float closest = maxT;
+	bool hit = false;
+	float tNear;
+
+	uint32_t stack[DX_BVH_MAX_DEPTH + 2];
+	int sp = 0;
+
+	stack[sp++] = 0;
+
+	while (sp > 0) {
+
+		const DXBVHNode& node = nodes[stack[--sp]];
+
+		if (!rayBox(o, invD, node.bmin, node.bmax, closest, &tNear))
+			continue;
+
+		if (node.count > 0) {
+
+			for (uint32_t i = 0; i < node.count; ++i) {
+
+				uint32_t instanceIndex = primIndices[node.leftFirst + i];
+				const DXBoundingVolume& B = volumes[instanceIndex];
+
+				XMFLOAT3 bmin = XMFLOAT3(B.centre.x - B.extents.x, B.centre.y - B.extents.y, B.centre.z - B.extents.z);
+				XMFLOAT3 bmax = XMFLOAT3(B.centre.x + B.extents.x, B.centre.y + B.extents.y, B.centre.z + B.extents.z);
+
+				if (rayBox(o, invD, bmin, bmax, closest, &tNear)) {
+
+					closest = tNear;
+					*hitIndex = instanceIndex;
+					hit = true;
+				}
+			}
+
+		} else {
+
+			float tLeft, tRight;
+
+			bool hitLeft = rayBox(o, invD, nodes[node.leftFirst].bmin, nodes[node.leftFirst].bmax, closest, &tLeft);
+			bool hitRight = rayBox(o, invD, nodes[node.leftFirst + 1].bmin, nodes[node.leftFirst + 1].bmax, closest, &tRight);
+
+			// Push the farther child first so the nearer child is popped next
+			if (hitLeft && hitRight) {
+
+				if (tLeft <= tRight) {
+
+					stack[sp++] = node.leftFirst + 1;
+					stack[sp++] = node.leftFirst;
+
+				} else {
+
+					stack[sp++] = node.leftFirst;
+					stack[sp++] = node.leftFirst + 1;
+				}
+
+			} else if (hitLeft) {
+
+				stack[sp++] = node.leftFirst;
+
+			} else if (hitRight) {
+
+				stack[sp++] = node.leftFirst + 1;
+			}
+		}
+	}
+
+	if (hit)
+		*hitT = closest;
+
+	return hit;
+}
+
+
+// Nearest-neighbour query.  Subtrees are pruned when their bounds are further from point than the closest instance found so far
+bool DXInstanceBVH::nearest(FXMVECTOR point, uint32_t *nearestIndex, float *nearestDist, const float maxDist) const {
+
+	if (numNodes == 0)
+		return false;
+
+	float bestDistSq = (maxDist < sqrtf(FLT_MAX)) ? maxDist * maxDist : FLT_MAX;
+	bool found = false;
+
+	uint32_t stack[DX_BVH_MAX_DEPTH + 2];
+	int sp = 0;
+
+	stack[sp++] = 0;
+
+	while (sp > 0) {
+
+		const DXBVHNode& node = nodes[stack[--sp]];
+
+		if (distanceSqToBox(point, node.bmin, node.bmax) > bestDistSq)
+			continue;
+
+		if (node.count > 0) {
+
+			for (uint32_t i = 0; i < node.count; ++i) {
+
+				uint32_t instanceIndex = primIndices[node.leftFirst + i];
+
+				float dSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&volumes[instanceIndex].centre), point)));
+
+				if (dSq <= bestDistSq) {
+
+					bestDistSq = dSq;
+					*nearestIndex = instanceIndex;
+					found = true;
+				}
+			}
+
+		} else {
+
+			float dLeft = distanceSqToBox(point, nodes[node.leftFirst].bmin, nodes[node.leftFirst].bmax);
+			float dRight = distanceSqToBox(point, nodes[node.leftFirst + 1].bmin, nodes[node.leftFirst + 1].bmax);
+
+			// Push the farther child first so the nearer child is searched first
+			if (dLeft <= dRight) {
+
+				if (dRight <= bestDistSq)
+					stack[sp++] = node.leftFirst + 1;
+				if (dLeft <= bestDistSq)
+					stack[sp++] = node.leftFirst;
+
+			} else {
+
+				if (dLeft <= bestDistSq)
+					stack[sp++] = node.leftFirst;
+				if (dRight <= bestDistSq)
+					stack[sp++] = node.leftFirst + 1;
+			}
+		}
+	}
+
+	if (found)
+		*nearestDist = sqrtf(bestDistSq);
+
+	return found;
+}
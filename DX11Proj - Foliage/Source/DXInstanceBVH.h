@@ -0,0 +1,80 @@
+
+//
+// DXInstanceBVH.h
+//
+
+// Bounding volume hierarchy over the world-space bounds of model instances (eg. the tree placements).  The hierarchy is built top-down using the surface area heuristic (SAH) evaluated over a fixed number of centroid bins.  Nodes are stored in a single array and the children of a node are always stored after their parent, so moving instances can be handled by refitting the node bounds in a single backwards pass over the array without rebuilding.  The BVH supports frustum queries (culling), ray queries (picking) and nearest-neighbour queries and does not depend on Direct3D.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <DXBoundingVolume.h>
+#include <vector>
+#include <cstdint>
+#include <cfloat>
+
+
+// Number of centroid bins evaluated per axis when choosing a split
+#define DX_BVH_NUM_BINS				12
+
+// Nodes with this many instances or fewer become leaves when the SAH does not favour a split
+#define DX_BVH_MAX_LEAF_SIZE		4
+
+// Cost of visiting a node relative to testing one instance volume
+#define DX_BVH_TRAVERSAL_COST		1.0f
+
+// Maximum tree depth.  This bounds the fixed-size traversal stacks used by the queries - nodes at this depth are made leaves regardless of size
+#define DX_BVH_MAX_DEPTH			64
+
+
+struct DXBVHNode {
+
+	DirectX::XMFLOAT3					bmin;
+	uint32_t							leftFirst; // Index of the left child (interior node, the right child is leftFirst + 1) or index of the first entry in primIndices (leaf)
+	DirectX::XMFLOAT3					bmax;
+	uint32_t							count; // Number of instances in a leaf, 0 for an interior node
+};
+
+
+class DXInstanceBVH : public GUObject {
+
+	std::vector<DXBVHNode>				nodes;
+	std::vector<uint32_t>				primIndices; // Instance indices ordered so each leaf references a contiguous range
+	std::vector<DXBoundingVolume>		volumes; // World-space instance bounds indexed by instance index
+
+	uint32_t							numNodes = 0;
+
+	// Recalculate the bounds of a leaf from the instances it references
+	void updateLeafBounds(DXBVHNode& node) const;
+
+	// Find the lowest cost split of node over the centroid bins.  Returns the SAH cost of the split or FLT_MAX if the instance centroids cannot be separated
+	float findBestSplit(const DXBVHNode& node, int *bestAxis, int *bestBin, float *binMin, float *binScale) const;
+
+public:
+
+	DXInstanceBVH();
+	~DXInstanceBVH();
+
+	// Build the hierarchy over count world-space instance volumes.  Instance indices used by the queries refer to the order of instanceVolumes
+	void build(const DXBoundingVolume *instanceVolumes, const uint32_t count);
+
+	// Update the world-space volume of an existing instance.  The hierarchy is not valid for queries until refit() is called
+	void setVolume(const uint32_t index, const DXBoundingVolume& B);
+
+	// Recalculate all node bounds bottom-up after instances have moved.  The tree topology is kept so query performance degrades if instances move far from where they were when the tree was built
+	void refit();
+
+	uint32_t instanceCount() const;
+	uint32_t nodeCount() const;
+	const DXBoundingVolume& getVolume(const uint32_t index) const;
+
+	// Write the indices of all instances whose bounds intersect the given frustum planes (see DXFrustumCuller::ExtractPlanes) to visibleInstances.  Subtrees entirely inside the frustum are accepted without testing their instances.  Returns the number of visible instances
+	uint32_t frustumQuery(const DirectX::XMFLOAT4 *frustumPlanes, std::vector<uint32_t>& visibleInstances) const;
+
+	// Find the closest instance whose bounding box is intersected by the ray origin + t * direction with 0 <= t <= maxT.  Returns true if an instance is hit and sets hitIndex and hitT
+	bool raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, uint32_t *hitIndex, float *hitT, const float maxT = FLT_MAX) const;
+
+	// Find the instance whose centre is closest to point and no further than maxDist away.  Returns true if an instance is found and sets nearestIndex and nearestDist
+	bool nearest(DirectX::FXMVECTOR point, uint32_t *nearestIndex, float *nearestDist, const float maxDist = FLT_MAX) const;
+};
@@ -138,6 +138,24 @@ DXModel::DXModel(ID3D11Device *device, DXBlob *vsBytecode, const std::wstring& f
 		}
 
 
+		// Calculate the object-space bounds from the final (x flipped) vertex positions
+		bounds = DXBoundingVolume::FromPoints(&(_vertexBuffer->pos), numVertices, sizeof(DXVertexExt));
+
+		// Keep a CPU-side copy of the triangles (positions and absolute vertex indices) so the model can be used as an occluder
+		positions.resize(numVertices);
+
+		for (uint32_t k = 0; k < numVertices; ++k)
+			positions[k] = _vertexBuffer[k].pos;
+
+		triangleIndices.assign(_indexBuffer, _indexBuffer + numIndices);
+
+		for (uint32_t indexOffset = 0, i = 0; i < numMeshes; indexOffset += indexCount[i], ++i) {
+
+			for (uint32_t k = 0; k < indexCount[i]; ++k)
+				triangleIndices[indexOffset + k] += baseVertexOffset[i];
+		}
+
+
 		//
 		// Setup DX vertex buffer interfaces
 		//
@@ -283,3 +301,21 @@ void DXModel::render(ID3D11DeviceContext *context) {
 	for (uint32_t indexOffset = 0, i = 0; i < numMeshes; indexOffset += indexCount[i], ++i)
 		context->DrawIndexed(indexCount[i], indexOffset, baseVertexOffset[i]);
 }
+
+
+const DXBoundingVolume& DXModel::getBounds() const {
+
+	return bounds;
+}
+
+
+const vector<XMFLOAT3>& DXModel::getPositions() const {
+
+	return positions;
+}
+
+
+const vector<uint32_t>& DXModel::getTriangleIndices() const {
+
+	return triangleIndices;
+}
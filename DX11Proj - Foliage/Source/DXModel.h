@@ -10,6 +10,7 @@
 
 #include <d3d11_2.h>
 #include <DXBaseModel.h>
+#include <DXBoundingVolume.h>
 #include <string>
 #include <vector>
 #include <cstdint>
@@ -25,10 +26,21 @@ class DXModel : public DXBaseModel {
 	ID3D11ShaderResourceView			*textureResourceView = nullptr;
 	ID3D11SamplerState					*sampler = nullptr;
 
+	// Object-space bounding volume of all meshes calculated at load time
+	DXBoundingVolume					bounds;
+
+	// CPU-side copy of the object-space triangle list of all meshes
+	std::vector<DirectX::XMFLOAT3>		positions;
+	std::vector<uint32_t>				triangleIndices;
+
 public:
 
 	DXModel(ID3D11Device *device, DXBlob *vsBytecode, const std::wstring& filename, ID3D11ShaderResourceView *tex_view, DirectX::PackedVector::XMCOLOR diffuse, DirectX::PackedVector::XMCOLOR specular);
 	~DXModel();
 
 	void render(ID3D11DeviceContext *context);
+
+	const DXBoundingVolume& getBounds() const;
+	const std::vector<DirectX::XMFLOAT3>& getPositions() const;
+	const std::vector<uint32_t>& getTriangleIndices() const;
 };
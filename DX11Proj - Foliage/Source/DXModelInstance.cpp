@@ -10,20 +10,15 @@ using namespace DirectX;
 
 DXModelInstance::DXModelInstance(DXBaseModel *_model, const XMFLOAT3& initT, const XMFLOAT3& initE) {
 
-	model = _model;
-
-	if (model)
-		model->retain();
+	model = GURef<DXBaseModel>::Retain(_model);
 
 	T = initT;
 	E = initE;
 }
 
 
+// The model is released by GURef
 DXModelInstance::~DXModelInstance() {
-
-	if (model)
-		model->release();
 }
 
 
@@ -4,6 +4,7 @@
 #include <d3d11_2.h>
 #include <DirectXMath.h>
 #include <GUObject.h>
+#include <GURef.h>
 
 class DXBaseModel;
 
@@ -11,7 +12,7 @@ class DXModelInstance : public GUObject {
 
 	DirectX::XMFLOAT3			T = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);	// Position (x, y, z)
 	DirectX::XMFLOAT3			E = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);	// Euler angles in radians
-	DXBaseModel					*model = nullptr;							// Reference to mesh model
+	GURef<DXBaseModel>			model;										// Reference to mesh model
 
 public:
 
@@ -0,0 +1,721 @@
+
+//
+// DXOcclusionCuller.cpp
+//
+
+#include <stdafx.h>
+#include <DXOcclusionCuller.h>
+#include <iostream>
+#include <exception>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Project a clip-space position to <x, y, depth> in depth buffer pixel coordinates (y down)
+static inline XMFLOAT3 toScreen(const XMFLOAT4& c, const float width, const float height) {
+
+	float rw = 1.0f / c.w;
+
+	return XMFLOAT3((c.x * rw * 0.5f + 0.5f) * width, (0.5f - c.y * rw * 0.5f) * height, c.z * rw);
+}
+
+
+// Return true if any lane of the comparison result V is set
+static inline bool anyLane(FXMVECTOR V) {
+
+	return XMComparisonAnyTrue(XMVector4EqualIntR(V, XMVectorTrueInt()));
+}
+
+
+// Separating axis test between a triangle and an axis-aligned box (Akenine-Moller).  v holds the triangle vertices relative to the box centre and h is the box half size.  The axes tested are the 3 box face normals, the triangle normal and the 9 cross products of the box axes with the triangle edges
+static bool triangleOverlapsBox(const float v[3][3], const float h[3]) {
+
+	for (int k = 0; k < 3; ++k) {
+
+		if (min(v[0][k], min(v[1][k], v[2][k])) > h[k] || max(v[0][k], max(v[1][k], v[2][k])) < -h[k])
+			return false;
+	}
+
+	float e[3][3];
+
+	for (int k = 0; k < 3; ++k) {
+
+		e[0][k] = v[1][k] - v[0][k];
+		e[1][k] = v[2][k] - v[1][k];
+		e[2][k] = v[0][k] - v[2][k];
+	}
+
+	float n[3] = { e[0][1] * e[1][2] - e[0][2] * e[1][1], e[0][2] * e[1][0] - e[0][0] * e[1][2], e[0][0] * e[1][1] - e[0][1] * e[1][0] };
+
+	if (fabsf(n[0] * v[0][0] + n[1] * v[0][1] + n[2] * v[0][2]) > h[0] * fabsf(n[0]) + h[1] * fabsf(n[1]) + h[2] * fabsf(n[2]))
+		return false;
+
+	for (int i = 0; i < 3; ++i) {
+
+		for (int k = 0; k < 3; ++k) {
+
+			// axis = unit(k) x e[i]
+			float a[3] = { 0.0f, 0.0f, 0.0f };
+
+			a[(k + 1) % 3] = -e[i][(k + 2) % 3];
+			a[(k + 2) % 3] = e[i][(k + 1) % 3];
+
+			float p0 = a[0] * v[0][0] + a[1] * v[0][1] + a[2] * v[0][2];
+			float p1 = a[0] * v[1][0] + a[1] * v[1][1] + a[2] * v[1][2];
+			float p2 = a[0] * v[2][0] + a[1] * v[2][1] + a[2] * v[2][2];
+			float r = h[0] * fabsf(a[0]) + h[1] * fabsf(a[1]) + h[2] * fabsf(a[2]);
+
+			if (min(p0, min(p1, p2)) > r || max(p0, max(p1, p2)) < -r)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+
+DXOcclusionCuller::DXOcclusionCuller(const uint32_t initWidth, const uint32_t initHeight) {
+
+	try
+	{
+		if (initWidth == 0 || initHeight == 0)
+			throw exception("Invalid depth buffer dimensions");
+
+		// Round dimensions up to whole tiles so every row is a multiple of 4 pixels and 16 byte aligned
+		tilesX = (initWidth + DX_OCCLUSION_TILE_SIZE - 1) / DX_OCCLUSION_TILE_SIZE;
+		tilesY = (initHeight + DX_OCCLUSION_TILE_SIZE - 1) / DX_OCCLUSION_TILE_SIZE;
+		width = tilesX * DX_OCCLUSION_TILE_SIZE;
+		height = tilesY * DX_OCCLUSION_TILE_SIZE;
+
+		depth = (float*)_aligned_malloc(width * height * sizeof(float), 16);
+
+		if (!depth)
+			throw exception("Cannot allocate depth buffer");
+
+		tileMaxDepth = (float*)_aligned_malloc(tilesX * tilesY * sizeof(float), 16);
+
+		if (!tileMaxDepth)
+			throw exception("Cannot allocate tile depth buffer");
+
+		erodeBuffer = (float*)_aligned_malloc(width * height * sizeof(float), 16);
+
+		if (!erodeBuffer)
+			throw exception("Cannot allocate erosion buffer");
+
+		XMStoreFloat4x4(&viewProj, XMMatrixIdentity());
+
+		for (uint32_t i = 0; i < width * height; ++i)
+			depth[i] = 1.0f;
+
+		for (uint32_t i = 0; i < tilesX * tilesY; ++i)
+			tileMaxDepth[i] = 1.0f;
+	}
+	catch (exception& e)
+	{
+		cout << "DXOcclusionCuller could not be instantiated due to:\n";
+		cout << e.what() << endl;
+
+		if (depth)
+			_aligned_free(depth);
+
+		if (tileMaxDepth)
+			_aligned_free(tileMaxDepth);
+
+		if (erodeBuffer)
+			_aligned_free(erodeBuffer);
+
+		depth = nullptr;
+		tileMaxDepth = nullptr;
+		erodeBuffer = nullptr;
+		width = height = tilesX = tilesY = 0;
+	}
+}
+
+
+DXOcclusionCuller::~DXOcclusionCuller() {
+
+	if (depth)
+		_aligned_free(depth);
+
+	if (tileMaxDepth)
+		_aligned_free(tileMaxDepth);
+
+	if (erodeBuffer)
+		_aligned_free(erodeBuffer);
+}
+
+
+// Voxel flags used by BuildOccluderHull
+enum DXHullVoxel { DX_HULL_SURFACE = 1, DX_HULL_INSIDE_X = 2, DX_HULL_INSIDE_Y = 4, DX_HULL_INSIDE_Z = 8, DX_HULL_USED = 16 };
+
+
+void DXOcclusionCuller::BuildOccluderHull(const XMFLOAT3 *positions, const uint32_t *indices, const uint32_t numIndices, const uint32_t resolution, const uint32_t maxBoxes, vector<XMFLOAT3>& hullPositions, vector<uint32_t>& hullIndices) {
+
+	hullPositions.clear();
+	hullIndices.clear();
+
+	if (!positions || !indices || numIndices < 3 || resolution == 0 || maxBoxes == 0)
+		return;
+
+	uint32_t numTriangles = numIndices / 3;
+
+	// Voxel grid over the mesh bounds
+	float bmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float bmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (uint32_t i = 0; i < numTriangles * 3; ++i) {
+
+		const float *p = &positions[indices[i]].x;
+
+		for (int k = 0; k < 3; ++k) {
+
+			bmin[k] = min(bmin[k], p[k]);
+			bmax[k] = max(bmax[k], p[k]);
+		}
+	}
+
+	float size = max(bmax[0] - bmin[0], max(bmax[1] - bmin[1], bmax[2] - bmin[2])) / (float)resolution;
+
+	if (!(size > 0.0f))
+		return;
+
+	int dim[3];
+
+	for (int k = 0; k < 3; ++k)
+		dim[k] = max((int)ceilf((bmax[k] - bmin[k]) / size), 1);
+
+	vector<uint8_t> voxels(dim[0] * dim[1] * dim[2], 0);
+
+	// Mark the voxels the surface passes through.  The test box is slightly enlarged so triangles lying on a voxel face count for the voxels on both sides
+	float h[3] = { size * 0.501f, size * 0.501f, size * 0.501f };
+
+	for (uint32_t t = 0; t < numTriangles; ++t) {
+
+		const float *p[3] = { &positions[indices[t * 3]].x, &positions[indices[t * 3 + 1]].x, &positions[indices[t * 3 + 2]].x };
+
+		int lo[3], hi[3];
+
+		for (int k = 0; k < 3; ++k) {
+
+			lo[k] = max((int)floorf((min(p[0][k], min(p[1][k], p[2][k])) - bmin[k]) / size) - 1, 0);
+			hi[k] = min((int)floorf((max(p[0][k], max(p[1][k], p[2][k])) - bmin[k]) / size) + 1, dim[k] - 1);
+		}
+
+		for (int z = lo[2]; z <= hi[2]; ++z) {
+
+			for (int y = lo[1]; y <= hi[1]; ++y) {
+
+				for (int x = lo[0]; x <= hi[0]; ++x) {
+
+					uint8_t& voxel = voxels[(z * dim[1] + y) * dim[0] + x];
+
+					if (voxel & DX_HULL_SURFACE)
+						continue;
+
+					float c[3] = { bmin[0] + ((float)x + 0.5f) * size, bmin[1] + ((float)y + 0.5f) * size, bmin[2] + ((float)z + 0.5f) * size };
+					float v[3][3];
+
+					for (int j = 0; j < 3; ++j)
+						for (int k = 0; k < 3; ++k)
+							v[j][k] = p[j][k] - c[k];
+
+					if (triangleOverlapsBox(v, h))
+						voxel |= DX_HULL_SURFACE;
+				}
+			}
+		}
+	}
+
+	// Inside test.  For each axis a line is cast through every row of voxel centres and the points where it crosses the surface are collected, so a voxel centre is inside along that axis if an odd number of crossings lie before it.  The lines are offset by a small fraction of a voxel so they do not pass exactly through mesh edges lying on the grid
+	const float jitter[2] = { size * 0.00137f, size * 0.00291f };
+
+	for (int a = 0; a < 3; ++a) {
+
+		int u = (a + 1) % 3;
+		int w = (a + 2) % 3;
+
+		vector<vector<float>> crossings(dim[u] * dim[w]);
+
+		for (uint32_t t = 0; t < numTriangles; ++t) {
+
+			const float *p[3] = { &positions[indices[t * 3]].x, &positions[indices[t * 3 + 1]].x, &positions[indices[t * 3 + 2]].x };
+
+			float area = (p[1][u] - p[0][u]) * (p[2][w] - p[0][w]) - (p[1][w] - p[0][w]) * (p[2][u] - p[0][u]);
+
+			// Triangles parallel to the axis are not crossed
+			if (fabsf(area) < 1.0e-12f)
+				continue;
+
+			int ju0 = max((int)ceilf((min(p[0][u], min(p[1][u], p[2][u])) - bmin[u] - jitter[0]) / size - 0.5f), 0);
+			int ju1 = min((int)floorf((max(p[0][u], max(p[1][u], p[2][u])) - bmin[u] - jitter[0]) / size - 0.5f), dim[u] - 1);
+			int jw0 = max((int)ceilf((min(p[0][w], min(p[1][w], p[2][w])) - bmin[w] - jitter[1]) / size - 0.5f), 0);
+			int jw1 = min((int)floorf((max(p[0][w], max(p[1][w], p[2][w])) - bmin[w] - jitter[1]) / size - 0.5f), dim[w] - 1);
+
+			for (int jw = jw0; jw <= jw1; ++jw) {
+
+				for (int ju = ju0; ju <= ju1; ++ju) {
+
+					float pu = bmin[u] + ((float)ju + 0.5f) * size + jitter[0];
+					float pw = bmin[w] + ((float)jw + 0.5f) * size + jitter[1];
+
+					// Barycentric weights of the line in the triangle's projection
+					float b0 = ((p[1][u] - pu) * (p[2][w] - pw) - (p[1][w] - pw) * (p[2][u] - pu)) / area;
+					float b1 = ((p[2][u] - pu) * (p[0][w] - pw) - (p[2][w] - pw) * (p[0][u] - pu)) / area;
+					float b2 = 1.0f - b0 - b1;
+
+					if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f)
+						continue;
+
+					crossings[jw * dim[u] + ju].push_back(b0 * p[0][a] + b1 * p[1][a] + b2 * p[2][a]);
+				}
+			}
+		}
+
+		for (int jw = 0; jw < dim[w]; ++jw) {
+
+			for (int ju = 0; ju < dim[u]; ++ju) {
+
+				vector<float>& row = crossings[jw * dim[u] + ju];
+
+				sort(row.begin(), row.end());
+
+				uint32_t numBefore = 0;
+
+				for (int i = 0; i < dim[a]; ++i) {
+
+					float centre = bmin[a] + ((float)i + 0.5f) * size;
+
+					while (numBefore < row.size() && row[numBefore] < centre)
+						numBefore++;
+
+					if (numBefore & 1) {
+
+						int coord[3];
+
+						coord[a] = i;
+						coord[u] = ju;
+						coord[w] = jw;
+
+						voxels[(coord[2] * dim[1] + coord[1]) * dim[0] + coord[0]] |= (uint8_t)(DX_HULL_INSIDE_X << a);
+					}
+				}
+			}
+		}
+	}
+
+	// Merge runs of solid voxels into boxes, growing along x, then y, then z
+	const uint8_t solidMask = DX_HULL_SURFACE | DX_HULL_INSIDE_X | DX_HULL_INSIDE_Y | DX_HULL_INSIDE_Z | DX_HULL_USED;
+	const uint8_t solid = DX_HULL_INSIDE_X | DX_HULL_INSIDE_Y | DX_HULL_INSIDE_Z;
+
+	struct DXHullBox {
+
+		int lo[3];
+		int hi[3]; // Exclusive
+		int volume;
+	};
+
+	vector<DXHullBox> boxes;
+
+	for (int z = 0; z < dim[2]; ++z) {
+
+		for (int y = 0; y < dim[1]; ++y) {
+
+			for (int x = 0; x < dim[0]; ++x) {
+
+				if ((voxels[(z * dim[1] + y) * dim[0] + x] & solidMask) != solid)
+					continue;
+
+				int x1 = x + 1, y1 = y + 1, z1 = z + 1;
+
+				while (x1 < dim[0] && (voxels[(z * dim[1] + y) * dim[0] + x1] & solidMask) == solid)
+					x1++;
+
+				for (bool grow = true; grow && y1 < dim[1]; ) {
+
+					for (int i = x; grow && i < x1; ++i)
+						grow = ((voxels[(z * dim[1] + y1) * dim[0] + i] & solidMask) == solid);
+
+					if (grow)
+						y1++;
+				}
+
+				for (bool grow = true; grow && z1 < dim[2]; ) {
+
+					for (int j = y; grow && j < y1; ++j)
+						for (int i = x; grow && i < x1; ++i)
+							grow = ((voxels[(z1 * dim[1] + j) * dim[0] + i] & solidMask) == solid);
+
+					if (grow)
+						z1++;
+				}
+
+				for (int k = z; k < z1; ++k)
+					for (int j = y; j < y1; ++j)
+						for (int i = x; i < x1; ++i)
+							voxels[(k * dim[1] + j) * dim[0] + i] |= DX_HULL_USED;
+
+				DXHullBox box = { { x, y, z }, { x1, y1, z1 }, (x1 - x) * (y1 - y) * (z1 - z) };
+
+				boxes.push_back(box);
+			}
+		}
+	}
+
+	sort(boxes.begin(), boxes.end(), [](const DXHullBox& A, const DXHullBox& B) { return A.volume > B.volume; });
+
+	if (boxes.size() > maxBoxes)
+		boxes.resize(maxBoxes);
+
+	// 8 corners and 12 triangles per box
+	static const uint32_t boxIndices[36] = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+
+	hullPositions.reserve(boxes.size() * 8);
+	hullIndices.reserve(boxes.size() * 36);
+
+	for (uint32_t b = 0; b < boxes.size(); ++b) {
+
+		uint32_t base = (uint32_t)hullPositions.size();
+
+		for (int k = 0; k < 8; ++k) {
+
+			hullPositions.push_back(XMFLOAT3(bmin[0] + (float)((k & 1) ? boxes[b].hi[0] : boxes[b].lo[0]) * size,
+				bmin[1] + (float)((k & 2) ? boxes[b].hi[1] : boxes[b].lo[1]) * size,
+				bmin[2] + (float)((k & 4) ? boxes[b].hi[2] : boxes[b].lo[2]) * size));
+		}
+
+		for (int i = 0; i < 36; ++i)
+			hullIndices.push_back(base + boxIndices[i]);
+	}
+}
+
+
+// Clear the depth buffer and setup the view-projection transform for the current frame
+void DXOcclusionCuller::beginFrame(FXMMATRIX viewProjMatrix) {
+
+	XMStoreFloat4x4(&viewProj, viewProjMatrix);
+
+	XMVECTOR farDepth = XMVectorSplatOne();
+
+	for (uint32_t i = 0; i < width * height; i += 4)
+		XMStoreFloat4A((XMFLOAT4A*)(depth + i), farDepth);
+
+	numTrianglesRasterised = 0;
+}
+
+
+// Half-space rasterisation.  Each edge function is linear in screen space so it is evaluated for 4 adjacent pixels at once and stepped along the row by adding 4 times its x gradient.  Depth (z/w) is also linear in screen space and is stepped the same way
+void DXOcclusionCuller::rasteriseTriangle(const XMFLOAT3& v0, const XMFLOAT3& _v1, const XMFLOAT3& _v2) {
+
+	XMFLOAT3 v1 = _v1;
+	XMFLOAT3 v2 = _v2;
+
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+
+	if (fabsf(area) < 1e-6f)
+		return;
+
+	// Occluders are double sided so flip clockwise triangles
+	if (area < 0.0f) {
+
+		swap(v1, v2);
+		area = -area;
+	}
+
+	// Bounding rectangle clamped to the buffer.  minX is aligned to 4 pixels so each block maps to one aligned load / store
+	int minX = max((int)floorf(min(v0.x, min(v1.x, v2.x))), 0);
+	int maxX = min((int)ceilf(max(v0.x, max(v1.x, v2.x))), (int)width - 1);
+	int minY = max((int)floorf(min(v0.y, min(v1.y, v2.y))), 0);
+	int maxY = min((int)ceilf(max(v0.y, max(v1.y, v2.y))), (int)height - 1);
+
+	if (minX > maxX || minY > maxY)
+		return;
+
+	minX &= ~3;
+
+	// Edge function E_ab(x, y) = A * x + B * y + C is positive inside the triangle for edge a -> b
+	float A12 = v1.y - v2.y, B12 = v2.x - v1.x, C12 = v1.x * v2.y - v1.y * v2.x;
+	float A20 = v2.y - v0.y, B20 = v0.x - v2.x, C20 = v2.x * v0.y - v2.y * v0.x;
+	float A01 = v0.y - v1.y, B01 = v1.x - v0.x, C01 = v0.x * v1.y - v0.y * v1.x;
+
+	// Depth plane from the barycentric weights (E12, E20, E01) / area
+	float rArea = 1.0f / area;
+	float zA = (v0.z * A12 + v1.z * A20 + v2.z * A01) * rArea;
+	float zB = (v0.z * B12 + v1.z * B20 + v2.z * B01) * rArea;
+	float zC = (v0.z * C12 + v1.z * C20 + v2.z * C01) * rArea;
+
+	// Sample at pixel centres
+	XMVECTOR px = XMVectorAdd(XMVectorReplicate((float)minX + 0.5f), XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f));
+
+	XMVECTOR e0Row = XMVectorMultiplyAdd(XMVectorReplicate(A12), px, XMVectorReplicate(C12));
+	XMVECTOR e1Row = XMVectorMultiplyAdd(XMVectorReplicate(A20), px, XMVectorReplicate(C20));
+	XMVECTOR e2Row = XMVectorMultiplyAdd(XMVectorReplicate(A01), px, XMVectorReplicate(C01));
+	XMVECTOR zRow = XMVectorMultiplyAdd(XMVectorReplicate(zA), px, XMVectorReplicate(zC));
+
+	XMVECTOR e0Step = XMVectorReplicate(4.0f * A12);
+	XMVECTOR e1Step = XMVectorReplicate(4.0f * A20);
+	XMVECTOR e2Step = XMVectorReplicate(4.0f * A01);
+	XMVECTOR zStep = XMVectorReplicate(4.0f * zA);
+
+	XMVECTOR zero = XMVectorZero();
+
+	for (int y = minY; y <= maxY; ++y) {
+
+		float py = (float)y + 0.5f;
+
+		XMVECTOR e0 = XMVectorAdd(e0Row, XMVectorReplicate(B12 * py));
+		XMVECTOR e1 = XMVectorAdd(e1Row, XMVectorReplicate(B20 * py));
+		XMVECTOR e2 = XMVectorAdd(e2Row, XMVectorReplicate(B01 * py));
+		XMVECTOR z = XMVectorAdd(zRow, XMVectorReplicate(zB * py));
+
+		float *row = depth + y * width;
+
+		for (int x = minX; x <= maxX; x += 4) {
+
+			XMVECTOR inside = XMVectorAndInt(XMVectorAndInt(XMVectorGreaterOrEqual(e0, zero), XMVectorGreaterOrEqual(e1, zero)), XMVectorGreaterOrEqual(e2, zero));
+
+			if (anyLane(inside)) {
+
+				XMVECTOR d = XMLoadFloat4A((const XMFLOAT4A*)(row + x));
+				XMStoreFloat4A((XMFLOAT4A*)(row + x), XMVectorSelect(d, XMVectorMin(d, z), inside));
+			}
+
+			e0 = XMVectorAdd(e0, e0Step);
+			e1 = XMVectorAdd(e1, e1Step);
+			e2 = XMVectorAdd(e2, e2Step);
+			z = XMVectorAdd(z, zStep);
+		}
+	}
+
+	numTrianglesRasterised++;
+}
+
+
+void DXOcclusionCuller::rasteriseOccluder(const XMFLOAT3 *positions, const uint32_t *indices, const uint32_t numIndices, FXMMATRIX world) {
+
+	if (!depth || !positions || !indices)
+		return;
+
+	XMMATRIX WVP = XMMatrixMultiply(world, XMLoadFloat4x4(&viewProj));
+
+	float fw = (float)width;
+	float fh = (float)height;
+
+	for (uint32_t i = 0; i + 2 < numIndices; i += 3) {
+
+		XMFLOAT4 c[3];
+
+		for (int k = 0; k < 3; ++k)
+			XMStoreFloat4(&c[k], XMVector3Transform(XMLoadFloat3(&positions[indices[i + k]]), WVP));
+
+		// Trivially reject triangles entirely outside one of the clip planes (other than near, which is clipped below)
+		if ((c[0].x > c[0].w && c[1].x > c[1].w && c[2].x > c[2].w) ||
+			(c[0].x < -c[0].w && c[1].x < -c[1].w && c[2].x < -c[2].w) ||
+			(c[0].y > c[0].w && c[1].y > c[1].w && c[2].y > c[2].w) ||
+			(c[0].y < -c[0].w && c[1].y < -c[1].w && c[2].y < -c[2].w) ||
+			(c[0].z > c[0].w && c[1].z > c[1].w && c[2].z > c[2].w))
+			continue;
+
+		// Clip against the near plane (z = 0) - a triangle becomes at most a quad
+		XMFLOAT4 poly[4];
+		int n = 0;
+
+		for (int k = 0; k < 3; ++k) {
+
+			const XMFLOAT4& a = c[k];
+			const XMFLOAT4& b = c[(k + 1) % 3];
+
+			bool aInside = (a.z >= 0.0f);
+			bool bInside = (b.z >= 0.0f);
+
+			if (aInside)
+				poly[n++] = a;
+
+			if (aInside != bInside) {
+
+				float t = a.z / (a.z - b.z);
+
+				poly[n++] = XMFLOAT4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, 0.0f, a.w + (b.w - a.w) * t);
+			}
+		}
+
+		if (n < 3)
+			continue;
+
+		XMFLOAT3 s0 = toScreen(poly[0], fw, fh);
+
+		for (int k = 1; k + 1 < n; ++k)
+			rasteriseTriangle(s0, toScreen(poly[k], fw, fh), toScreen(poly[k + 1], fw, fh));
+	}
+}
+
+
+// Separable 3x3 maximum.  Rows are filtered into erodeBuffer, reading the neighbours of each block of 4 pixels with unaligned loads, then columns are filtered back into depth
+void DXOcclusionCuller::erodeDepth() {
+
+	for (uint32_t y = 0; y < height; ++y) {
+
+		const float *row = depth + y * width;
+		float *out = erodeBuffer + y * width;
+
+		for (uint32_t x = 0; x < width; x += 4) {
+
+			XMVECTOR left = (x > 0) ? XMLoadFloat4((const XMFLOAT4*)(row + x - 1)) : XMVectorSet(row[0], row[0], row[1], row[2]);
+			XMVECTOR right = (x + 4 < width) ? XMLoadFloat4((const XMFLOAT4*)(row + x + 1)) : XMVectorSet(row[x + 1], row[x + 2], row[x + 3], row[x + 3]);
+			XMVECTOR centre = XMLoadFloat4A((const XMFLOAT4A*)(row + x));
+
+			XMStoreFloat4A((XMFLOAT4A*)(out + x), XMVectorMax(centre, XMVectorMax(left, right)));
+		}
+	}
+
+	for (uint32_t y = 0; y < height; ++y) {
+
+		const float *above = erodeBuffer + ((y > 0) ? y - 1 : 0) * width;
+		const float *centre = erodeBuffer + y * width;
+		const float *below = erodeBuffer + ((y + 1 < height) ? y + 1 : y) * width;
+		float *out = depth + y * width;
+
+		for (uint32_t x = 0; x < width; x += 4) {
+
+			XMVECTOR d = XMVectorMax(XMLoadFloat4A((const XMFLOAT4A*)(above + x)), XMLoadFloat4A((const XMFLOAT4A*)(below + x)));
+
+			XMStoreFloat4A((XMFLOAT4A*)(out + x), XMVectorMax(d, XMLoadFloat4A((const XMFLOAT4A*)(centre + x))));
+		}
+	}
+}
+
+
+// Erode the covered area then calculate the maximum depth of each tile
+void DXOcclusionCuller::endFrame() {
+
+	if (!depth)
+		return;
+
+	erodeDepth();
+
+	for (uint32_t ty = 0; ty < tilesY; ++ty) {
+
+		for (uint32_t tx = 0; tx < tilesX; ++tx) {
+
+			XMVECTOR tileMax = XMVectorZero();
+
+			for (uint32_t y = 0; y < DX_OCCLUSION_TILE_SIZE; ++y) {
+
+				const float *row = depth + (ty * DX_OCCLUSION_TILE_SIZE + y) * width + tx * DX_OCCLUSION_TILE_SIZE;
+
+				for (uint32_t x = 0; x < DX_OCCLUSION_TILE_SIZE; x += 4)
+					tileMax = XMVectorMax(tileMax, XMLoadFloat4A((const XMFLOAT4A*)(row + x)));
+			}
+
+			tileMax = XMVectorMax(tileMax, XMVectorSwizzle<2, 3, 0, 1>(tileMax));
+			tileMax = XMVectorMax(tileMax, XMVectorSwizzle<1, 0, 3, 2>(tileMax));
+
+			tileMaxDepth[ty * tilesX + tx] = XMVectorGetX(tileMax);
+		}
+	}
+}
+
+
+// Hierarchical box test.  The box is reduced to its screen rectangle and nearest depth.  Tiles whose farthest occluder depth is nearer than the box are rejected outright, otherwise the depth values of the tile covered by the rectangle are compared 4 at a time
+bool DXOcclusionCuller::isVisible(const DXBoundingVolume& B) const {
+
+	if (!depth)
+		return true;
+
+	XMMATRIX VP = XMLoadFloat4x4(&viewProj);
+
+	XMVECTOR C = XMLoadFloat3(&B.centre);
+	XMVECTOR E = XMLoadFloat3(&B.extents);
+
+	float minSX = FLT_MAX, maxSX = -FLT_MAX;
+	float minSY = FLT_MAX, maxSY = -FLT_MAX;
+	float minZ = FLT_MAX;
+
+	for (int k = 0; k < 8; ++k) {
+
+		XMVECTOR sign = XMVectorSet((k & 1) ? 1.0f : -1.0f, (k & 2) ? 1.0f : -1.0f, (k & 4) ? 1.0f : -1.0f, 0.0f);
+
+		XMFLOAT4 c;
+		XMStoreFloat4(&c, XMVector3Transform(XMVectorMultiplyAdd(E, sign, C), VP));
+
+		// A corner in front of the near plane means the box surrounds or crosses the camera near plane
+		if (c.z < 0.0f || c.w <= 0.0f)
+			return true;
+
+		XMFLOAT3 s = toScreen(c, (float)width, (float)height);
+
+		minSX = min(minSX, s.x);
+		maxSX = max(maxSX, s.x);
+		minSY = min(minSY, s.y);
+		maxSY = max(maxSY, s.y);
+		minZ = min(minZ, s.z);
+	}
+
+	int x0 = max((int)floorf(minSX), 0);
+	int x1 = min((int)floorf(maxSX), (int)width - 1);
+	int y0 = max((int)floorf(minSY), 0);
+	int y1 = min((int)floorf(maxSY), (int)height - 1);
+
+	if (x0 > x1 || y0 > y1)
+		return false;
+
+	XMVECTOR boxZ = XMVectorReplicate(minZ);
+
+	for (int ty = y0 / DX_OCCLUSION_TILE_SIZE; ty <= y1 / DX_OCCLUSION_TILE_SIZE; ++ty) {
+
+		for (int tx = x0 / DX_OCCLUSION_TILE_SIZE; tx <= x1 / DX_OCCLUSION_TILE_SIZE; ++tx) {
+
+			// Every pixel in the tile is nearer than the box
+			if (minZ > tileMaxDepth[ty * tilesX + tx])
+				continue;
+
+			// Test the pixels of the tile covered by the rectangle.  x is rounded out to whole blocks of 4 which can only make the test more conservative
+			int px0 = max(x0, tx * DX_OCCLUSION_TILE_SIZE) & ~3;
+			int px1 = min(x1, (tx + 1) * DX_OCCLUSION_TILE_SIZE - 1);
+			int py0 = max(y0, ty * DX_OCCLUSION_TILE_SIZE);
+			int py1 = min(y1, (ty + 1) * DX_OCCLUSION_TILE_SIZE - 1);
+
+			for (int y = py0; y <= py1; ++y) {
+
+				const float *row = depth + y * width;
+
+				for (int x = px0; x <= px1; x += 4) {
+
+					if (anyLane(XMVectorLessOrEqual(boxZ, XMLoadFloat4A((const XMFLOAT4A*)(row + x)))))
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+
+uint32_t DXOcclusionCuller::getWidth() const {
+
+	return width;
+}
+
+
+uint32_t DXOcclusionCuller::getHeight() const {
+
+	return height;
+}
+
+
+const float* DXOcclusionCuller::getDepthBuffer() const {
+
+	return depth;
+}
+
+
+uint32_t DXOcclusionCuller::trianglesRasterised() const {
+
+	return numTrianglesRasterised;
+}
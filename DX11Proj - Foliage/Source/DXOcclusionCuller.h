@@ -0,0 +1,78 @@
+
+//
+// DXOcclusionCuller.h
+//
+
+// Software occlusion culling.  A small number of occluder meshes are rasterised on the CPU into a low resolution depth buffer each frame using half-space (edge function) rasterisation evaluated for 4 pixels at a time with DirectXMath.  Coverage is sampled at pixel centres, so once all occluders are rasterised the covered area is eroded by one pixel (each pixel takes the farthest depth of its 3x3 neighbourhood).  A pixel then only occludes at a depth if the pixel centres around it are covered at least as near, which keeps the buffer conservative at occluder silhouettes where a pixel is only partly covered.  The maximum depth of each tile of the buffer is then calculated so bounding boxes can be rejected against whole tiles before any individual depth values are tested.  Depth follows the Direct3D convention (0 = near, 1 = far) and everything is done in single precision with no threading so results are deterministic for a given view.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <DXBoundingVolume.h>
+#include <vector>
+#include <cstdint>
+
+
+// Width and height in pixels of the tiles used for the hierarchical depth test.  The depth buffer dimensions are rounded up to a multiple of this
+#define DX_OCCLUSION_TILE_SIZE		8
+
+// Default resolution (voxels along the longest axis) and box count of hulls made by BuildOccluderHull
+#define DX_OCCLUSION_HULL_RES		32
+#define DX_OCCLUSION_HULL_BOXES		32
+
+
+class DXOcclusionCuller : public GUObject {
+
+	uint32_t							width = 0;
+	uint32_t							height = 0;
+	uint32_t							tilesX = 0;
+	uint32_t							tilesY = 0;
+
+	// Depth buffer (width * height, 16 byte aligned rows) and the maximum depth of each tile
+	float								*depth = nullptr;
+	float								*tileMaxDepth = nullptr;
+
+	// Intermediate buffer for the separable erosion in endFrame (width * height)
+	float								*erodeBuffer = nullptr;
+
+	DirectX::XMFLOAT4X4					viewProj;
+
+	// Occluder statistics for the current frame
+	uint32_t							numTrianglesRasterised = 0;
+
+	// Rasterise a single screen-space triangle.  Each vertex is <x, y, depth> in pixel coordinates
+	void rasteriseTriangle(const DirectX::XMFLOAT3& v0, const DirectX::XMFLOAT3& v1, const DirectX::XMFLOAT3& v2);
+
+	// Replace each depth with the maximum depth of its 3x3 neighbourhood.  Pixels beyond the buffer edges repeat the edge pixels
+	void erodeDepth();
+
+	// Not copyable.  A copy would share and free the same buffers.  Declared but not defined
+	DXOcclusionCuller(const DXOcclusionCuller&);
+	DXOcclusionCuller& operator=(const DXOcclusionCuller&);
+
+public:
+
+	// Build a low polygon occluder that lies inside a closed mesh.  The mesh bounds are divided into voxels (resolution along the longest axis).  Voxels that no triangle passes through and whose centre is inside the mesh along all three axes (odd number of crossings) are solid, and runs of solid voxels are merged into boxes.  The maxBoxes largest boxes are written to hullPositions / hullIndices as an indexed triangle list in the mesh's object space.  Thin walls (thinner than a voxel) and open meshes give few or no boxes, which only reduces how much the occluder hides
+	static void BuildOccluderHull(const DirectX::XMFLOAT3 *positions, const uint32_t *indices, const uint32_t numIndices, const uint32_t resolution, const uint32_t maxBoxes, std::vector<DirectX::XMFLOAT3>& hullPositions, std::vector<uint32_t>& hullIndices);
+
+	DXOcclusionCuller(const uint32_t initWidth = 320, const uint32_t initHeight = 192);
+	~DXOcclusionCuller();
+
+	// Clear the depth buffer and setup the view-projection transform for the current frame
+	void beginFrame(DirectX::FXMMATRIX viewProjMatrix);
+
+	// Rasterise an indexed triangle list under the world transform.  Occluders must lie inside the geometry they represent so the test stays conservative (see BuildOccluderHull).  Triangles are rasterised regardless of winding and are clipped to the near plane
+	void rasteriseOccluder(const DirectX::XMFLOAT3 *positions, const uint32_t *indices, const uint32_t numIndices, DirectX::FXMMATRIX world);
+
+	// Erode the covered area and calculate the tile depth hierarchy.  Call after all occluders for the frame are rasterised and before any visibility tests
+	void endFrame();
+
+	// Return true if any part of the world-space bounding box B may be visible, false if it is hidden behind the occluders (or lies entirely outside the screen).  Boxes that cross the near plane are always considered visible
+	bool isVisible(const DXBoundingVolume& B) const;
+
+	uint32_t getWidth() const;
+	uint32_t getHeight() const;
+	const float* getDepthBuffer() const;
+	uint32_t trianglesRasterised() const;
+};
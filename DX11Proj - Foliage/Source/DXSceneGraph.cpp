@@ -0,0 +1,203 @@
+
+//
+// DXSceneGraph.cpp
+//
+
+#include <stdafx.h>
+#include <DXSceneGraph.h>
+#include <DXTransform.h>
+#include <exception>
+
+using namespace std;
+using namespace DirectX;
+
+
+void DXSceneGraph::markDirty(const uint32_t node) {
+
+	dirty[node] = 1;
+
+	if (node < firstDirty)
+		firstDirty = node;
+}
+
+
+uint32_t DXSceneGraph::addNode(const uint32_t parentNode, const XMFLOAT3& scale, const XMFLOAT4& rotation, const XMFLOAT3& translation) {
+
+	uint32_t node = (uint32_t)parent.size();
+
+	// Parents must precede their children so update can resolve the hierarchy in node order
+	if (parentNode != DX_SCENE_ROOT && parentNode >= node)
+		throw exception("DXSceneGraph: Parent node does not exist");
+
+	parent.push_back(parentNode);
+	localScale.push_back(scale);
+	localRotation.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+	localTranslation.push_back(translation);
+
+	world.push_back(XMFLOAT4X4());
+	normal.push_back(XMFLOAT4X4());
+	dirty.push_back(0);
+	changed.push_back(0);
+
+	setLocalRotation(node, rotation);
+
+	return node;
+}
+
+
+void DXSceneGraph::clear() {
+
+	parent.clear();
+	localScale.clear();
+	localRotation.clear();
+	localTranslation.clear();
+	world.clear();
+	normal.clear();
+	dirty.clear();
+	changed.clear();
+
+	firstDirty = 0;
+	firstChanged = 0;
+}
+
+
+uint32_t DXSceneGraph::nodeCount() const {
+
+	return (uint32_t)parent.size();
+}
+
+
+uint32_t DXSceneGraph::parentOf(const uint32_t node) const {
+
+	return parent[node];
+}
+
+
+const XMFLOAT3& DXSceneGraph::getLocalScale(const uint32_t node) const {
+
+	return localScale[node];
+}
+
+
+const XMFLOAT4& DXSceneGraph::getLocalRotation(const uint32_t node) const {
+
+	return localRotation[node];
+}
+
+
+const XMFLOAT3& DXSceneGraph::getLocalTranslation(const uint32_t node) const {
+
+	return localTranslation[node];
+}
+
+
+void DXSceneGraph::setLocalScale(const uint32_t node, const XMFLOAT3& scale) {
+
+	localScale[node] = scale;
+	markDirty(node);
+}
+
+
+void DXSceneGraph::setLocalRotation(const uint32_t node, const XMFLOAT4& rotation) {
+
+	XMStoreFloat4(&localRotation[node], XMQuaternionNormalize(XMLoadFloat4(&rotation)));
+	markDirty(node);
+}
+
+
+void DXSceneGraph::setLocalTranslation(const uint32_t node, const XMFLOAT3& translation) {
+
+	localTranslation[node] = translation;
+	markDirty(node);
+}
+
+
+void DXSceneGraph::setLocalTransform(const uint32_t node, const XMFLOAT3& scale, const XMFLOAT4& rotation, const XMFLOAT3& translation) {
+
+	localScale[node] = scale;
+	localTranslation[node] = translation;
+	setLocalRotation(node, rotation);
+}
+
+
+// With row vectors W = L * parentW, so W^-1 = parentW^-1 * L^-1 and the normal matrix (W^-1)^T = (L^-1)^T * (parentW^-1)^T is the local normal matrix times the parent's
+uint32_t DXSceneGraph::update() {
+
+	uint32_t n = nodeCount();
+
+	// Clear the nodes flagged by the previous update
+	for (uint32_t i = firstChanged; i < n; i++)
+		changed[i] = 0;
+
+	firstChanged = n;
+
+	if (firstDirty >= n)
+		return 0;
+
+	uint32_t numUpdated = 0;
+
+	for (uint32_t i = firstDirty; i < n; i++) {
+
+		uint32_t p = parent[i];
+
+		// A node is rebuilt if it is dirty or its parent was rebuilt in this pass.  Parents precede children so the parent's flag is already final
+		if (!dirty[i] && (p == DX_SCENE_ROOT || !dirty[p]))
+			continue;
+
+		dirty[i] = 1;
+
+		XMMATRIX W, N;
+
+		DXTransform::Compose(XMLoadFloat3(&localScale[i]), XMLoadFloat4(&localRotation[i]), XMLoadFloat3(&localTranslation[i]), &W, &N);
+
+		if (p != DX_SCENE_ROOT) {
+
+			W = XMMatrixMultiply(W, XMLoadFloat4x4(&world[p]));
+			N = XMMatrixMultiply(N, XMLoadFloat4x4(&normal[p]));
+		}
+
+		XMStoreFloat4x4(&world[i], W);
+		XMStoreFloat4x4(&normal[i], N);
+
+		changed[i] = 1;
+		numUpdated++;
+	}
+
+	for (uint32_t i = firstDirty; i < n; i++)
+		dirty[i] = 0;
+
+	firstChanged = firstDirty;
+	firstDirty = n;
+
+	return numUpdated;
+}
+
+
+bool DXSceneGraph::nodeChanged(const uint32_t node) const {
+
+	return changed[node] != 0;
+}
+
+
+XMMATRIX DXSceneGraph::worldMatrix(const uint32_t node) const {
+
+	return XMLoadFloat4x4(&world[node]);
+}
+
+
+XMMATRIX DXSceneGraph::normalMatrix(const uint32_t node) const {
+
+	return XMLoadFloat4x4(&normal[node]);
+}
+
+
+XMMATRIX DXSceneGraph::inverseWorldMatrix(const uint32_t node) const {
+
+	return XMMatrixTranspose(XMLoadFloat4x4(&normal[node]));
+}
+
+
+const XMFLOAT4X4* DXSceneGraph::worldMatrices() const {
+
+	return world.data();
+}
@@ -0,0 +1,76 @@
+
+//
+// DXSceneGraph.h
+//
+
+// Transform hierarchy for placing scene objects.  Each node has a scale, rotation (unit quaternion) and translation relative to its parent, so W = S * R * T * parentW.  Nodes are stored flattened in arrays indexed by node id, and a node can only be attached to a node created before it, so every parent precedes its children and update() resolves the whole hierarchy in one linear pass.  Changing a node marks it dirty.  The pass starts at the first dirty node and only rebuilds the world and normal matrices of dirty nodes and their descendants, so static nodes (and static scenes) cost nothing per frame.  World and normal matrices are composed analytically as in DXTransform.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+
+
+// Parent index of nodes placed directly in world space
+#define DX_SCENE_ROOT 0xFFFFFFFF
+
+
+class DXSceneGraph : public GUObject {
+
+	// Per-node parent and local transform components
+	std::vector<uint32_t>					parent;
+	std::vector<DirectX::XMFLOAT3>			localScale;
+	std::vector<DirectX::XMFLOAT4>			localRotation;
+	std::vector<DirectX::XMFLOAT3>			localTranslation;
+
+	// Per-node world and normal matrices as of the last update
+	std::vector<DirectX::XMFLOAT4X4>		world;
+	std::vector<DirectX::XMFLOAT4X4>		normal;
+
+	// dirty is set when a node's local transform changes.  During update it also marks the descendants of dirty nodes, then it is cleared.  changed records the nodes rebuilt by the last update
+	std::vector<uint8_t>					dirty;
+	std::vector<uint8_t>					changed;
+
+	// Lowest dirty node id, or nodeCount() if no node is dirty
+	uint32_t								firstDirty = 0;
+	uint32_t								firstChanged = 0;
+
+	void markDirty(const uint32_t node);
+
+public:
+
+	// Create a new node and return its id.  parentNode is DX_SCENE_ROOT or the id of an existing node.  rotation need not be normalised
+	uint32_t addNode(const uint32_t parentNode, const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT4& rotation, const DirectX::XMFLOAT3& translation);
+
+	// Remove all nodes
+	void clear();
+
+	uint32_t nodeCount() const;
+	uint32_t parentOf(const uint32_t node) const;
+
+	// Local (parent-relative) transform accessors.  Setting any component marks the node and its descendants for update
+	const DirectX::XMFLOAT3& getLocalScale(const uint32_t node) const;
+	const DirectX::XMFLOAT4& getLocalRotation(const uint32_t node) const;
+	const DirectX::XMFLOAT3& getLocalTranslation(const uint32_t node) const;
+
+	void setLocalScale(const uint32_t node, const DirectX::XMFLOAT3& scale);
+	void setLocalRotation(const uint32_t node, const DirectX::XMFLOAT4& rotation);
+	void setLocalTranslation(const uint32_t node, const DirectX::XMFLOAT3& translation);
+	void setLocalTransform(const uint32_t node, const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT4& rotation, const DirectX::XMFLOAT3& translation);
+
+	// Rebuild the world and normal matrices of the dirty nodes and their descendants.  Return the number of nodes rebuilt
+	uint32_t update();
+
+	// Return true if the last update rebuilt the given node, so dependent data (bounding volumes, effect transforms) can be refreshed
+	bool nodeChanged(const uint32_t node) const;
+
+	// World, normal ((W^-1)^T) and inverse world matrices as of the last update
+	DirectX::XMMATRIX worldMatrix(const uint32_t node) const;
+	DirectX::XMMATRIX normalMatrix(const uint32_t node) const;
+	DirectX::XMMATRIX inverseWorldMatrix(const uint32_t node) const;
+
+	// World matrices of all nodes in node id order
+	const DirectX::XMFLOAT4X4* worldMatrices() const;
+};
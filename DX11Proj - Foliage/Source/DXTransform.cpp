@@ -0,0 +1,148 @@
+
+//
+// DXTransform.cpp
+//
+
+#include <stdafx.h>
+#include <DXTransform.h>
+
+using namespace DirectX;
+
+
+// Build the world and normal matrices.  With rotation rows R0..R2 W has rows (sx R0, sy R1, sz R2, t).  Since R^-1 = R^T, (W^-1)^T = S^-1 * R * T^-T which has rows (R0 / sx, -(R0 . t) / sx), (R1 / sy, -(R1 . t) / sy), (R2 / sz, -(R2 . t) / sz) and (0, 0, 0, 1)
+void DXTransform::Compose(FXMVECTOR scale, FXMVECTOR rotation, FXMVECTOR translation, XMMATRIX *worldOut, XMMATRIX *normalOut) {
+
+	XMMATRIX R = XMMatrixRotationQuaternion(rotation);
+
+	XMVECTOR s[3] = { XMVectorSplatX(scale), XMVectorSplatY(scale), XMVectorSplatZ(scale) };
+
+	if (worldOut) {
+
+		for (int i = 0; i < 3; ++i)
+			worldOut->r[i] = XMVectorMultiply(R.r[i], s[i]);
+
+		worldOut->r[3] = XMVectorSetW(translation, 1.0f);
+	}
+
+	if (normalOut) {
+
+		for (int i = 0; i < 3; ++i) {
+
+			XMVECTOR N = XMVectorDivide(R.r[i], s[i]);
+
+			normalOut->r[i] = XMVectorSetW(N, -XMVectorGetX(XMVector3Dot(N, translation)));
+		}
+
+		normalOut->r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+
+DXTransform::DXTransform() : S(1.0f, 1.0f, 1.0f), q(0.0f, 0.0f, 0.0f, 1.0f), T(0.0f, 0.0f, 0.0f) {}
+
+
+DXTransform::DXTransform(const XMFLOAT3& initS, const XMFLOAT4& initQ, const XMFLOAT3& initT) {
+
+	S = initS;
+	T = initT;
+	setRotation(initQ);
+}
+
+
+const XMFLOAT3& DXTransform::getScale() const {
+
+	return S;
+}
+
+
+const XMFLOAT4& DXTransform::getRotation() const {
+
+	return q;
+}
+
+
+const XMFLOAT3& DXTransform::getTranslation() const {
+
+	return T;
+}
+
+
+void DXTransform::setScale(const XMFLOAT3& newS) {
+
+	S = newS;
+	dirty = true;
+}
+
+
+void DXTransform::setRotation(const XMFLOAT4& newQ) {
+
+	XMStoreFloat4(&q, XMQuaternionNormalize(XMLoadFloat4(&newQ)));
+	dirty = true;
+}
+
+
+void DXTransform::setRotationRollPitchYaw(const float pitch, const float yaw, const float roll) {
+
+	XMStoreFloat4(&q, XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
+	dirty = true;
+}
+
+
+void DXTransform::setTranslation(const XMFLOAT3& newT) {
+
+	T = newT;
+	dirty = true;
+}
+
+
+void DXTransform::translate(const XMFLOAT3& dT) {
+
+	T = XMFLOAT3(T.x + dT.x, T.y + dT.y, T.z + dT.z);
+	dirty = true;
+}
+
+
+bool DXTransform::isDirty() const {
+
+	return dirty;
+}
+
+
+bool DXTransform::update() const {
+
+	if (!dirty)
+		return false;
+
+	XMMATRIX W, N;
+
+	Compose(XMLoadFloat3(&S), XMLoadFloat4(&q), XMLoadFloat3(&T), &W, &N);
+
+	XMStoreFloat4x4(&world, W);
+	XMStoreFloat4x4(&normal, N);
+
+	dirty = false;
+
+	return true;
+}
+
+
+XMMATRIX DXTransform::worldMatrix() const {
+
+	update();
+
+	return XMLoadFloat4x4(&world);
+}
+
+
+XMMATRIX DXTransform::normalMatrix() const {
+
+	update();
+
+	return XMLoadFloat4x4(&normal);
+}
+
+
+XMMATRIX DXTransform::inverseWorldMatrix() const {
+
+	return XMMatrixTranspose(normalMatrix());
+}
@@ -0,0 +1,53 @@
+
+//
+// DXTransform.h
+//
+
+// Model an object's world transform as a scale, rotation (unit quaternion) and translation applied in that order, so the world matrix is W = S * R * T.  The world matrix and the normal matrix (W^-1)^T are derived analytically from the components rather than by a general 4x4 inverse and are cached.  Changing a component marks the cache dirty so the matrices are only rebuilt after a change instead of on every draw.
+
+#pragma once
+
+#include <DirectXMath.h>
+
+
+class DXTransform {
+
+	DirectX::XMFLOAT3					S;
+	DirectX::XMFLOAT4					q;
+	DirectX::XMFLOAT3					T;
+
+	// Cached matrices.  These are rebuilt on demand from const accessors so are mutable
+	mutable DirectX::XMFLOAT4X4			world;
+	mutable DirectX::XMFLOAT4X4			normal;
+	mutable bool						dirty = true;
+
+public:
+
+	// Build the world matrix S * R * T and normal matrix S^-1 * R * T^-T = (W^-1)^T of the given components.  rotation must be a unit quaternion and the scale factors non-zero.  Either output may be null
+	static void Compose(DirectX::FXMVECTOR scale, DirectX::FXMVECTOR rotation, DirectX::FXMVECTOR translation, DirectX::XMMATRIX *worldOut, DirectX::XMMATRIX *normalOut);
+
+	DXTransform(); // identity transform
+	DXTransform(const DirectX::XMFLOAT3& initS, const DirectX::XMFLOAT4& initQ, const DirectX::XMFLOAT3& initT);
+
+	// Component accessors.  The rotation quaternion is normalised when set
+	const DirectX::XMFLOAT3& getScale() const;
+	const DirectX::XMFLOAT4& getRotation() const;
+	const DirectX::XMFLOAT3& getTranslation() const;
+
+	void setScale(const DirectX::XMFLOAT3& newS);
+	void setRotation(const DirectX::XMFLOAT4& newQ);
+	void setRotationRollPitchYaw(const float pitch, const float yaw, const float roll); // Euler angles in radians as XMQuaternionRotationRollPitchYaw
+	void setTranslation(const DirectX::XMFLOAT3& newT);
+	void translate(const DirectX::XMFLOAT3& dT);
+
+	// Return true if a component has changed since the matrices were last built
+	bool isDirty() const;
+
+	// Rebuild the cached matrices if a component has changed.  Return true if the matrices were rebuilt
+	bool update() const;
+
+	// Return the world, normal and inverse world matrices, rebuilding the cache first if needed.  The inverse world matrix is the transpose of the normal matrix so is never calculated separately
+	DirectX::XMMATRIX worldMatrix() const;
+	DirectX::XMMATRIX normalMatrix() const;
+	DirectX::XMMATRIX inverseWorldMatrix() const;
+};
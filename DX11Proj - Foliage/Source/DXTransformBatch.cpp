@@ -0,0 +1,377 @@
+
+//
+// DXTransformBatch.cpp
+//
+
+#include <stdafx.h>
+#include <DXTransformBatch.h>
+#include <GUParallel.h>
+#include <exception>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace DirectX;
+using namespace CoreStructures;
+
+
+static_assert(sizeof(GUVector4) == sizeof(XMFLOAT4), "DXTransformBatch: GUVector4 must be 4 packed floats");
+
+
+// Lane-wise arithmetic on DX_TRANSFORM_LANES floats so the batched loops below are written once for both the AVX and DirectXMath (SSE) builds
+#if defined(__AVX__)
+
+typedef __m256 DXLanes;
+
+static inline DXLanes laneLoad(const float *p) { return _mm256_load_ps(p); }
+static inline DXLanes laneLoadUnaligned(const float *p) { return _mm256_loadu_ps(p); }
+static inline void laneStore(float *p, DXLanes v) { _mm256_store_ps(p, v); }
+static inline void laneStoreUnaligned(float *p, DXLanes v) { _mm256_storeu_ps(p, v); }
+static inline DXLanes laneReplicate(const float s) { return _mm256_set1_ps(s); }
+static inline DXLanes laneAdd(DXLanes a, DXLanes b) { return _mm256_add_ps(a, b); }
+static inline DXLanes laneSub(DXLanes a, DXLanes b) { return _mm256_sub_ps(a, b); }
+static inline DXLanes laneMul(DXLanes a, DXLanes b) { return _mm256_mul_ps(a, b); }
+static inline DXLanes laneDiv(DXLanes a, DXLanes b) { return _mm256_div_ps(a, b); }
+static inline DXLanes laneMulAdd(DXLanes a, DXLanes b, DXLanes c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+
+#else
+
+typedef XMVECTOR DXLanes;
+
+static inline DXLanes laneLoad(const float *p) { return XMLoadFloat4A((const XMFLOAT4A*)p); }
+static inline DXLanes laneLoadUnaligned(const float *p) { return XMLoadFloat4((const XMFLOAT4*)p); }
+static inline void laneStore(float *p, FXMVECTOR v) { XMStoreFloat4A((XMFLOAT4A*)p, v); }
+static inline void laneStoreUnaligned(float *p, FXMVECTOR v) { XMStoreFloat4((XMFLOAT4*)p, v); }
+static inline DXLanes laneReplicate(const float s) { return XMVectorReplicate(s); }
+static inline DXLanes laneAdd(FXMVECTOR a, FXMVECTOR b) { return XMVectorAdd(a, b); }
+static inline DXLanes laneSub(FXMVECTOR a, FXMVECTOR b) { return XMVectorSubtract(a, b); }
+static inline DXLanes laneMul(FXMVECTOR a, FXMVECTOR b) { return XMVectorMultiply(a, b); }
+static inline DXLanes laneDiv(FXMVECTOR a, FXMVECTOR b) { return XMVectorDivide(a, b); }
+static inline DXLanes laneMulAdd(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c) { return XMVectorMultiplyAdd(a, b, c); }
+
+#endif
+
+
+// Transform count SoA vectors (x, y, z, w) by the row-vector matrix M.  w is 1 for points and 0 for normals
+static void transformSoA(FXMMATRIX M, const float w, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, const uint32_t count) {
+
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, M);
+
+	DXLanes m00 = laneReplicate(m._11), m01 = laneReplicate(m._12), m02 = laneReplicate(m._13);
+	DXLanes m10 = laneReplicate(m._21), m11 = laneReplicate(m._22), m12 = laneReplicate(m._23);
+	DXLanes m20 = laneReplicate(m._31), m21 = laneReplicate(m._32), m22 = laneReplicate(m._33);
+	DXLanes m30 = laneReplicate(m._41 * w), m31 = laneReplicate(m._42 * w), m32 = laneReplicate(m._43 * w);
+
+	uint32_t i = 0;
+
+	for (; i + DX_TRANSFORM_LANES <= count; i += DX_TRANSFORM_LANES) {
+
+		DXLanes vx = laneLoadUnaligned(x + i);
+		DXLanes vy = laneLoadUnaligned(y + i);
+		DXLanes vz = laneLoadUnaligned(z + i);
+
+		laneStoreUnaligned(outX + i, laneMulAdd(vx, m00, laneMulAdd(vy, m10, laneMulAdd(vz, m20, m30))));
+		laneStoreUnaligned(outY + i, laneMulAdd(vx, m01, laneMulAdd(vy, m11, laneMulAdd(vz, m21, m31))));
+		laneStoreUnaligned(outZ + i, laneMulAdd(vx, m02, laneMulAdd(vy, m12, laneMulAdd(vz, m22, m32))));
+	}
+
+	for (; i < count; ++i) {
+
+		float vx = x[i], vy = y[i], vz = z[i];
+
+		outX[i] = vx * m._11 + vy * m._21 + vz * m._31 + w * m._41;
+		outY[i] = vx * m._12 + vy * m._22 + vz * m._32 + w * m._42;
+		outZ[i] = vx * m._13 + vy * m._23 + vz * m._33 + w * m._43;
+	}
+}
+
+
+
+//
+// Class methods
+//
+
+void DXTransformBatch::TransformPoints(FXMMATRIX M, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, const uint32_t count) {
+
+	transformSoA(M, 1.0f, x, y, z, outX, outY, outZ, count);
+}
+
+
+void DXTransformBatch::TransformNormals(FXMMATRIX M, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, const uint32_t count) {
+
+	transformSoA(M, 0.0f, x, y, z, outX, outY, outZ, count);
+}
+
+
+void DXTransformBatch::TransformVectors(FXMMATRIX M, GUVector4 *V, const uint32_t count) {
+
+#if defined(__AVX__)
+
+	// Two vectors per 256 bit register.  Each 128 bit half holds one vector so v * M is the sum of the replicated components of that half times the rows of M
+	__m256 r0 = _mm256_insertf128_ps(_mm256_castps128_ps256(M.r[0]), M.r[0], 1);
+	__m256 r1 = _mm256_insertf128_ps(_mm256_castps128_ps256(M.r[1]), M.r[1], 1);
+	__m256 r2 = _mm256_insertf128_ps(_mm256_castps128_ps256(M.r[2]), M.r[2], 1);
+	__m256 r3 = _mm256_insertf128_ps(_mm256_castps128_ps256(M.r[3]), M.r[3], 1);
+
+	uint32_t i = 0;
+
+	for (; i + 2 <= count; i += 2) {
+
+		__m256 v = _mm256_loadu_ps(&V[i].x);
+
+		__m256 result = _mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(_mm256_permute_ps(v, 0x00), r0), _mm256_mul_ps(_mm256_permute_ps(v, 0x55), r1)),
+			_mm256_add_ps(_mm256_mul_ps(_mm256_permute_ps(v, 0xAA), r2), _mm256_mul_ps(_mm256_permute_ps(v, 0xFF), r3)));
+
+		_mm256_storeu_ps(&V[i].x, result);
+	}
+
+	if (i < count)
+		XMStoreFloat4((XMFLOAT4*)&V[i], XMVector4Transform(XMLoadFloat4((const XMFLOAT4*)&V[i]), M));
+
+#else
+
+	XMVector4TransformStream((XMFLOAT4*)V, sizeof(GUVector4), (const XMFLOAT4*)V, sizeof(GUVector4), count, M);
+
+#endif
+}
+
+
+void DXTransformBatch::TransformVectors(const GUMatrix4& M, GUVector4 *V, const uint32_t count) {
+
+	// The column-major storage of M read as a row-major matrix is M^T, and v * M^T = (M * v)^T
+	TransformVectors(XMLoadFloat4x4((const XMFLOAT4X4*)M.M), V, count);
+}
+
+
+
+//
+// Instance methods
+//
+
+DXTransformBatch::DXTransformBatch(const uint32_t initCapacity) {
+
+	reserve(initCapacity);
+}
+
+
+DXTransformBatch::~DXTransformBatch() {
+
+	if (block)
+		_aligned_free(block);
+}
+
+
+void DXTransformBatch::reserve(const uint32_t newCapacity) {
+
+	// Round up to a whole number of batches
+	uint32_t paddedCapacity = ((newCapacity + DX_TRANSFORM_LANES - 1) / DX_TRANSFORM_LANES) * DX_TRANSFORM_LANES;
+
+	if (paddedCapacity == 0)
+		paddedCapacity = DX_TRANSFORM_LANES;
+
+	if (paddedCapacity <= capacity)
+		return;
+
+	float *newBlock = (float*)_aligned_malloc(paddedCapacity * 10 * sizeof(float), 32);
+
+	if (!newBlock)
+		throw exception("DXTransformBatch: Cannot allocate transform arrays");
+
+	float *newArrays[10];
+
+	for (int k = 0; k < 10; ++k)
+		newArrays[k] = newBlock + k * paddedCapacity;
+
+	// Fill with identity transforms (unit scale and rotation, zero translation) so padding lanes never divide by zero
+	static const float identity[10] = { 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f };
+
+	for (int k = 0; k < 10; ++k) {
+
+		for (uint32_t i = 0; i < paddedCapacity; ++i)
+			newArrays[k][i] = identity[k];
+	}
+
+	if (block) {
+
+		float *oldArrays[10] = { sx, sy, sz, qx, qy, qz, qw, tx, ty, tz };
+
+		for (int k = 0; k < 10; ++k)
+			memcpy(newArrays[k], oldArrays[k], numTransforms * sizeof(float));
+
+		_aligned_free(block);
+	}
+
+	block = newBlock;
+	capacity = paddedCapacity;
+
+	sx = newArrays[0]; sy = newArrays[1]; sz = newArrays[2];
+	qx = newArrays[3]; qy = newArrays[4]; qz = newArrays[5]; qw = newArrays[6];
+	tx = newArrays[7]; ty = newArrays[8]; tz = newArrays[9];
+}
+
+
+uint32_t DXTransformBatch::addTransform(const XMFLOAT3& S, const XMFLOAT4& q, const XMFLOAT3& T) {
+
+	if (numTransforms == capacity)
+		reserve(capacity * 2);
+
+	setTransform(numTransforms, S, q, T);
+
+	return numTransforms++;
+}
+
+
+void DXTransformBatch::setTransform(const uint32_t index, const XMFLOAT3& S, const XMFLOAT4& q, const XMFLOAT3& T) {
+
+	sx[index] = S.x;
+	sy[index] = S.y;
+	sz[index] = S.z;
+	qx[index] = q.x;
+	qy[index] = q.y;
+	qz[index] = q.z;
+	qw[index] = q.w;
+
+	setTranslation(index, T);
+}
+
+
+void DXTransformBatch::setTranslation(const uint32_t index, const XMFLOAT3& T) {
+
+	tx[index] = T.x;
+	ty[index] = T.y;
+	tz[index] = T.z;
+}
+
+
+void DXTransformBatch::clear() {
+
+	// Restore the identity padding removed transforms leave behind
+	static const XMFLOAT3 unitScale(1.0f, 1.0f, 1.0f), zero(0.0f, 0.0f, 0.0f);
+	static const XMFLOAT4 unitRotation(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for (uint32_t i = 0; i < numTransforms; ++i)
+		setTransform(i, unitScale, unitRotation, zero);
+
+	numTransforms = 0;
+}
+
+
+uint32_t DXTransformBatch::transformCount() const {
+
+	return numTransforms;
+}
+
+
+DXTransformArrays DXTransformBatch::arrays() const {
+
+	DXTransformArrays A = { sx, sy, sz, qx, qy, qz, qw, tx, ty, tz };
+
+	return A;
+}
+
+
+// Compose DX_TRANSFORM_LANES transforms per iteration.  With s = 2 / |q|^2 the rotation matrix rows (as XMMatrixRotationQuaternion) are
+//   R0 = (1 - s(yy + zz), s(xy + wz), s(xz - wy))
+//   R1 = (s(xy - wz), 1 - s(xx + zz), s(yz + wx))
+//   R2 = (s(xz + wy), s(yz - wx), 1 - s(xx + yy))
+// W = S * R * T has rows (sx R0, sy R1, sz R2, t).  Since R^-1 = R^T, (W^-1)^T = S^-1 * R * T^-T which has rows (R0 / sx, -(R0 . t) / sx), (R1 / sy, -(R1 . t) / sy), (R2 / sz, -(R2 . t) / sz) and (0, 0, 0, 1)
+void DXTransformBatch::ComposeArrays(const DXTransformArrays& A, const uint32_t begin, const uint32_t end, XMFLOAT4X4 *world, XMFLOAT4X4 *normal, const size_t stride) {
+
+	// Upper 3 rows of the world and normal matrices of the current batch in SoA form
+	__declspec(align(32)) float W[12][DX_TRANSFORM_LANES];
+	__declspec(align(32)) float N[12][DX_TRANSFORM_LANES];
+
+	DXLanes one = laneReplicate(1.0f);
+	DXLanes two = laneReplicate(2.0f);
+
+	for (uint32_t i = begin; i < end; i += DX_TRANSFORM_LANES) {
+
+		DXLanes x = laneLoad(A.qx + i), y = laneLoad(A.qy + i), z = laneLoad(A.qz + i), w = laneLoad(A.qw + i);
+
+		DXLanes s = laneDiv(two, laneMulAdd(x, x, laneMulAdd(y, y, laneMulAdd(z, z, laneMul(w, w)))));
+
+		DXLanes xs = laneMul(x, s), ys = laneMul(y, s), zs = laneMul(z, s);
+		DXLanes wx = laneMul(w, xs), wy = laneMul(w, ys), wz = laneMul(w, zs);
+		DXLanes xx = laneMul(x, xs), xy = laneMul(x, ys), xz = laneMul(x, zs);
+		DXLanes yy = laneMul(y, ys), yz = laneMul(y, zs), zz = laneMul(z, zs);
+
+		DXLanes R[3][3];
+
+		R[0][0] = laneSub(one, laneAdd(yy, zz)); R[0][1] = laneAdd(xy, wz); R[0][2] = laneSub(xz, wy);
+		R[1][0] = laneSub(xy, wz); R[1][1] = laneSub(one, laneAdd(xx, zz)); R[1][2] = laneAdd(yz, wx);
+		R[2][0] = laneAdd(xz, wy); R[2][1] = laneSub(yz, wx); R[2][2] = laneSub(one, laneAdd(xx, yy));
+
+		DXLanes S[3] = { laneLoad(A.sx + i), laneLoad(A.sy + i), laneLoad(A.sz + i) };
+		DXLanes T[3] = { laneLoad(A.tx + i), laneLoad(A.ty + i), laneLoad(A.tz + i) };
+
+		for (int r = 0; r < 3; ++r) {
+
+			for (int c = 0; c < 3; ++c)
+				laneStore(W[r * 3 + c], laneMul(R[r][c], S[r]));
+
+			if (normal) {
+
+				DXLanes invS = laneDiv(one, S[r]);
+				DXLanes dotT = laneMulAdd(R[r][0], T[0], laneMulAdd(R[r][1], T[1], laneMul(R[r][2], T[2])));
+
+				for (int c = 0; c < 3; ++c)
+					laneStore(N[r * 3 + c], laneMul(R[r][c], invS));
+
+				laneStore(N[9 + r], laneSub(laneReplicate(0.0f), laneMul(dotT, invS)));
+			}
+		}
+
+		// Write the matrices of the instances in this batch.  Padding lanes past end are not written
+		uint32_t numLanes = (end - i < DX_TRANSFORM_LANES) ? end - i : DX_TRANSFORM_LANES;
+
+		for (uint32_t lane = 0; lane < numLanes; ++lane) {
+
+			XMFLOAT4X4& Wm = *(XMFLOAT4X4*)((char*)world + (size_t)(i + lane) * stride);
+
+			Wm._11 = W[0][lane]; Wm._12 = W[1][lane]; Wm._13 = W[2][lane]; Wm._14 = 0.0f;
+			Wm._21 = W[3][lane]; Wm._22 = W[4][lane]; Wm._23 = W[5][lane]; Wm._24 = 0.0f;
+			Wm._31 = W[6][lane]; Wm._32 = W[7][lane]; Wm._33 = W[8][lane]; Wm._34 = 0.0f;
+			Wm._41 = A.tx[i + lane]; Wm._42 = A.ty[i + lane]; Wm._43 = A.tz[i + lane]; Wm._44 = 1.0f;
+
+			if (normal) {
+
+				XMFLOAT4X4& Nm = *(XMFLOAT4X4*)((char*)normal + (size_t)(i + lane) * stride);
+
+				Nm._11 = N[0][lane]; Nm._12 = N[1][lane]; Nm._13 = N[2][lane]; Nm._14 = N[9][lane];
+				Nm._21 = N[3][lane]; Nm._22 = N[4][lane]; Nm._23 = N[5][lane]; Nm._24 = N[10][lane];
+				Nm._31 = N[6][lane]; Nm._32 = N[7][lane]; Nm._33 = N[8][lane]; Nm._34 = N[11][lane];
+				Nm._41 = 0.0f; Nm._42 = 0.0f; Nm._43 = 0.0f; Nm._44 = 1.0f;
+			}
+		}
+	}
+}
+
+
+void DXTransformBatch::compose(XMFLOAT4X4 *world, XMFLOAT4X4 *normal, const size_t stride, GUParallel *pool) const {
+
+	if (numTransforms == 0)
+		return;
+
+	if (!pool || numTransforms <= DX_TRANSFORM_MIN_BLOCK) {
+
+		ComposeArrays(arrays(), 0, numTransforms, world, normal, stride);
+		return;
+	}
+
+	// Arrays and output of the current compose.  The parallel task captures only &P so std::function does not allocate
+	struct ComposeParameters {
+
+		DXTransformArrays			A;
+		XMFLOAT4X4					*world, *normal;
+		size_t						stride;
+	} P = { arrays(), world, normal, stride };
+
+	pool->parallelFor(numTransforms, DX_TRANSFORM_MIN_BLOCK, [&P](uint32_t begin, uint32_t end) {
+
+		ComposeArrays(P.A, begin, end, P.world, P.normal, P.stride);
+	});
+}
@@ -0,0 +1,89 @@
+
+//
+// DXTransformBatch.h
+//
+
+// Batched instance transforms.  Scale, rotation (unit quaternion) and translation (SRT) components are stored in structure-of-arrays (SoA) form so world matrices and their inverse-transpose (normal) matrices can be composed for 4 instances at a time (SSE via DirectXMath) or 8 instances at a time when compiled with AVX (/arch:AVX).  The normal matrix is built directly from the components as S^-1 R T^-T rather than by a general 4x4 inverse.  Static helpers transform arrays of points, normals and GUVector4s by a single matrix.  Like DXFrustumCuller the batch is independent of Direct3D so it can be run and timed on the CPU alone.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <CoreStructures\GUVector4.h>
+#include <CoreStructures\GUMatrix4.h>
+#include <cstdint>
+
+class GUParallel;
+
+
+// Number of instances composed per iteration of the batched loops.  The SoA arrays are padded to a multiple of this with identity transforms so no scalar tail is needed
+#if defined(__AVX__)
+#define DX_TRANSFORM_LANES 8
+#else
+#define DX_TRANSFORM_LANES 4
+#endif
+
+// Minimum number of instances composed by each parallel block (a multiple of DX_TRANSFORM_LANES)
+#define DX_TRANSFORM_MIN_BLOCK 4096
+
+
+// SoA transform component arrays in the layout DXTransformBatch stores them.  Each array is 32 byte aligned and holds a whole number of DX_TRANSFORM_LANES entries, with identity transforms in the padding past the last transform
+struct DXTransformArrays {
+
+	const float							*sx, *sy, *sz;
+	const float							*qx, *qy, *qz, *qw;
+	const float							*tx, *ty, *tz;
+};
+
+
+class DXTransformBatch : public GUObject {
+
+	// SoA transform components (scale, rotation quaternion and translation) stored in a single 32 byte aligned block
+	float								*block = nullptr;
+	float								*sx = nullptr, *sy = nullptr, *sz = nullptr;
+	float								*qx = nullptr, *qy = nullptr, *qz = nullptr, *qw = nullptr;
+	float								*tx = nullptr, *ty = nullptr, *tz = nullptr;
+
+	uint32_t							numTransforms = 0;
+	uint32_t							capacity = 0;
+
+	DXTransformArrays arrays() const;
+
+	// Not copyable.  A copy would share and free the same block.  Declared but not defined
+	DXTransformBatch(const DXTransformBatch&);
+	DXTransformBatch& operator=(const DXTransformBatch&);
+
+public:
+
+	// Transform count points (x, y, z, 1) stored in SoA arrays by M (row vectors, as DirectXMath).  The output arrays may alias the input arrays
+	static void TransformPoints(DirectX::FXMMATRIX M, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, const uint32_t count);
+
+	// Transform count normals (x, y, z, 0) stored in SoA arrays by M.  M should be the normal matrix (inverse-transpose of the world matrix) for non-uniformly scaled models.  The results are not re-normalised
+	static void TransformNormals(DirectX::FXMMATRIX M, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, const uint32_t count);
+
+	// Transform count homogeneous vectors in place by M, so points (w = 1) are translated and directions (w = 0) are not.  The GUMatrix4 version applies the column-major, column vector CoreStructures matrix M as M * v
+	static void TransformVectors(DirectX::FXMMATRIX M, CoreStructures::GUVector4 *V, const uint32_t count);
+	static void TransformVectors(const CoreStructures::GUMatrix4& M, CoreStructures::GUVector4 *V, const uint32_t count);
+
+	// Compose the world and normal matrices of transforms [begin, end) held in SoA arrays, as compose does for a batch.  begin is a multiple of DX_TRANSFORM_LANES.  This lets other SoA stores (such as DXEntitySystems, which gathers the dirty transforms of a chunk) use the same kernel
+	static void ComposeArrays(const DXTransformArrays& A, const uint32_t begin, const uint32_t end, DirectX::XMFLOAT4X4 *world, DirectX::XMFLOAT4X4 *normal, const size_t stride = sizeof(DirectX::XMFLOAT4X4));
+
+	DXTransformBatch(const uint32_t initCapacity = 64);
+	~DXTransformBatch();
+
+	// Allocate space for at least newCapacity transforms
+	void reserve(const uint32_t newCapacity);
+
+	// Add a new transform and return its index.  Indices are stable until clear() is called.  q is a rotation quaternion <x, y, z, w>.  It need not be normalised but must not be zero.  Scale factors must not be zero
+	uint32_t addTransform(const DirectX::XMFLOAT3& S, const DirectX::XMFLOAT4& q, const DirectX::XMFLOAT3& T);
+
+	// Update an existing transform (eg. for a moving instance)
+	void setTransform(const uint32_t index, const DirectX::XMFLOAT3& S, const DirectX::XMFLOAT4& q, const DirectX::XMFLOAT3& T);
+	void setTranslation(const uint32_t index, const DirectX::XMFLOAT3& T);
+
+	void clear();
+	uint32_t transformCount() const;
+
+	// Compose the world matrix W = S * R * T of every transform and, if normal is not null, its normal matrix (W^-1)^T.  Matrix i is written to (char*)world + i * stride and (char*)normal + i * stride, so stride = sizeof(worldTransformStruct) fills the world and normal matrices of an array of worldTransformStruct.  Blocks are processed on pool if one is given
+	void compose(DirectX::XMFLOAT4X4 *world, DirectX::XMFLOAT4X4 *normal, const size_t stride = sizeof(DirectX::XMFLOAT4X4), GUParallel *pool = nullptr) const;
+};
@@ -0,0 +1,462 @@
+
+//
+// GPUParticles.cpp
+//
+
+#include <stdafx.h>
+#include <GPUParticles.h>
+#include <DXShaderFactory.h>
+#include <iostream>
+#include <exception>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace DirectX;
+
+
+GPUParticles::GPUParticles(ID3D11Device *device, ID3D11ShaderResourceView *tex_view, const uint32_t initMaxParticles, const ParticleEmitter& E) {
+
+	for (int i = 0; i < 2; i++) {
+
+		particleBuffer[i] = nullptr;
+		particleUAV[i] = nullptr;
+		particleSRV[i] = nullptr;
+	}
+
+	try
+	{
+		if (!device || initMaxParticles == 0)
+			throw exception("Invalid parameters for GPU particles instantiation");
+
+		maxParticles = initMaxParticles;
+		emitter = E;
+
+		// Load the emit and simulate compute shaders and the vertex shader that expands the particle buffer into quads
+		if (!SUCCEEDED(DXShaderFactory::loadComputeShader(device, "Shaders\\cso\\gpu_particles_emit_cs.cso", &emitCS)))
+			throw exception("Cannot load the particle emit compute shader");
+
+		if (!SUCCEEDED(DXShaderFactory::loadComputeShader(device, "Shaders\\cso\\gpu_particles_simulate_cs.cso", &simulateCS)))
+			throw exception("Cannot load the particle simulate compute shader");
+
+		if (!SUCCEEDED(DXShaderFactory::loadVertexShader(device, "Shaders\\cso\\gpu_particles_vs.cso", &particleVS)))
+			throw exception("Cannot load the particle vertex shader");
+
+
+		// Setup the particle buffers.  Both are written through append UAVs and read by the vertex shader through SRVs
+		D3D11_BUFFER_DESC particleDesc;
+
+		ZeroMemory(&particleDesc, sizeof(D3D11_BUFFER_DESC));
+
+		particleDesc.Usage = D3D11_USAGE_DEFAULT;
+		particleDesc.ByteWidth = sizeof(GPUParticle) * maxParticles;
+		particleDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+		particleDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		particleDesc.StructureByteStride = sizeof(GPUParticle);
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+
+		ZeroMemory(&uavDesc, sizeof(D3D11_UNORDERED_ACCESS_VIEW_DESC));
+
+		uavDesc.Format = DXGI_FORMAT_UNKNOWN;
+		uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+		uavDesc.Buffer.FirstElement = 0;
+		uavDesc.Buffer.NumElements = maxParticles;
+		uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_APPEND;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+
+		ZeroMemory(&srvDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = maxParticles;
+
+		for (int i = 0; i < 2; i++) {
+
+			HRESULT hr = device->CreateBuffer(&particleDesc, nullptr, &particleBuffer[i]);
+
+			if (!SUCCEEDED(hr))
+				throw exception("Particle buffer cannot be created");
+
+			hr = device->CreateUnorderedAccessView(particleBuffer[i], &uavDesc, &particleUAV[i]);
+
+			if (!SUCCEEDED(hr))
+				throw exception("Particle buffer UAV cannot be created");
+
+			hr = device->CreateShaderResourceView(particleBuffer[i], &srvDesc, &particleSRV[i]);
+
+			if (!SUCCEEDED(hr))
+				throw exception("Particle buffer SRV cannot be created");
+		}
+
+
+		// Setup the per-step constant buffer
+		D3D11_BUFFER_DESC cbufferDesc;
+
+		ZeroMemory(&cbufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+		cbufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		cbufferDesc.ByteWidth = sizeof(GPUParticleConstants);
+		cbufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		cbufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		HRESULT hr = device->CreateBuffer(&cbufferDesc, nullptr, &constantBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Particle constant buffer cannot be created");
+
+		// The live count is copied into the first element of a constant buffer so the compute shaders can read it without a CPU round trip
+		cbufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		cbufferDesc.ByteWidth = sizeof(UINT) * 4;
+		cbufferDesc.CPUAccessFlags = 0;
+
+		hr = device->CreateBuffer(&cbufferDesc, nullptr, &countBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Particle count buffer cannot be created");
+
+
+		// Setup the indirect draw arguments.  Each instance is one quad (6 vertices) and the instance count is written by CopyStructureCount
+		UINT drawArgs[4] = { 6, 0, 0, 0 };
+
+		D3D11_BUFFER_DESC argsDesc;
+
+		ZeroMemory(&argsDesc, sizeof(D3D11_BUFFER_DESC));
+
+		argsDesc.Usage = D3D11_USAGE_DEFAULT;
+		argsDesc.ByteWidth = sizeof(drawArgs);
+		argsDesc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+
+		D3D11_SUBRESOURCE_DATA argsData;
+
+		ZeroMemory(&argsData, sizeof(D3D11_SUBRESOURCE_DATA));
+		argsData.pSysMem = drawArgs;
+
+		hr = device->CreateBuffer(&argsDesc, &argsData, &drawArgsBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Indirect draw argument buffer cannot be created");
+
+
+		textureResourceView = tex_view;
+
+		if (textureResourceView)
+			textureResourceView->AddRef(); // We didnt create it here but dont want it deleted by the creator untill we have deconstructed
+
+		D3D11_SAMPLER_DESC samplerDesc;
+
+		ZeroMemory(&samplerDesc, sizeof(D3D11_SAMPLER_DESC));
+
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.MaxAnisotropy = 16;
+		samplerDesc.MinLOD = 0.0f;
+		samplerDesc.MaxLOD = 0.0f;
+		samplerDesc.MipLODBias = 0.0f;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+
+		hr = device->CreateSamplerState(&samplerDesc, &linearSampler);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Cannot create sampler state interface");
+	}
+	catch (exception& e)
+	{
+		cout << "GPUParticles object could not be instantiated due to:\n";
+		cout << e.what() << endl;
+
+		releaseResources();
+		maxParticles = 0;
+	}
+}
+
+
+GPUParticles::~GPUParticles() {
+
+	releaseResources();
+}
+
+
+void GPUParticles::releaseResources() {
+
+	for (int i = 0; i < 2; i++) {
+
+		if (particleSRV[i])
+			particleSRV[i]->Release();
+
+		if (particleUAV[i])
+			particleUAV[i]->Release();
+
+		if (particleBuffer[i])
+			particleBuffer[i]->Release();
+
+		particleBuffer[i] = nullptr;
+		particleUAV[i] = nullptr;
+		particleSRV[i] = nullptr;
+	}
+
+	if (constantBuffer)
+		constantBuffer->Release();
+
+	if (countBuffer)
+		countBuffer->Release();
+
+	if (drawArgsBuffer)
+		drawArgsBuffer->Release();
+
+	if (emitCS)
+		emitCS->Release();
+
+	if (simulateCS)
+		simulateCS->Release();
+
+	if (particleVS)
+		particleVS->Release();
+
+	if (textureResourceView)
+		textureResourceView->Release();
+
+	if (linearSampler)
+		linearSampler->Release();
+
+	if (particleStaging)
+		particleStaging->Release();
+
+	if (countStaging)
+		countStaging->Release();
+
+	constantBuffer = nullptr;
+	countBuffer = nullptr;
+	drawArgsBuffer = nullptr;
+	emitCS = nullptr;
+	simulateCS = nullptr;
+	particleVS = nullptr;
+	textureResourceView = nullptr;
+	linearSampler = nullptr;
+	particleStaging = nullptr;
+	countStaging = nullptr;
+}
+
+
+void GPUParticles::setTexture(ID3D11ShaderResourceView *tex_view) {
+
+	if (textureResourceView)
+		textureResourceView->Release();
+
+	textureResourceView = tex_view;
+
+	if (textureResourceView)
+		textureResourceView->AddRef();
+}
+
+
+void GPUParticles::setEmitter(const ParticleEmitter& E) {
+
+	emitter = E;
+}
+
+
+const ParticleEmitter& GPUParticles::getEmitter() const {
+
+	return emitter;
+}
+
+
+void GPUParticles::update(ID3D11DeviceContext *context, const float dt) {
+
+	if (!context || !simulateCS || !emitCS || !particleBuffer[0])
+		return;
+
+	uint32_t next = 1 - current;
+
+	// Emission follows ParticleSystem::update.  The emit shader clamps the count to the free capacity
+	emitAccumulator += emitter.rate * dt;
+
+	uint32_t emitCount = (uint32_t)emitAccumulator;
+
+	emitAccumulator -= (float)emitCount;
+
+	D3D11_MAPPED_SUBRESOURCE res;
+
+	if (!SUCCEEDED(context->Map(constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &res)))
+		return;
+
+	GPUParticleConstants *C = (GPUParticleConstants*)res.pData;
+
+	C->emitter = emitter;
+	C->dt = dt;
+	C->emitCount = emitCount;
+	C->seed = (++frameIndex) * 0x9E3779B9;
+	C->capacity = maxParticles;
+
+	context->Unmap(constantBuffer, 0);
+
+	ID3D11Buffer *cbuffers[] = { constantBuffer, countBuffer };
+	ID3D11UnorderedAccessView *nullUAVs[] = { nullptr, nullptr };
+	UINT keepCounts[] = { (UINT)-1, (UINT)-1 };
+
+	context->CSSetConstantBuffers(0, 2, cbuffers);
+
+	// Simulate - consume every live particle from the current buffer and append the survivors to the next buffer
+	if (liveBound > 0) {
+
+		context->CopyStructureCount(countBuffer, 0, particleUAV[current]);
+
+		ID3D11UnorderedAccessView *uavs[] = { particleUAV[current], particleUAV[next] };
+		UINT initialCounts[] = { (UINT)-1, 0 };
+
+		context->CSSetShader(simulateCS, nullptr, 0);
+		context->CSSetUnorderedAccessViews(0, 2, uavs, initialCounts);
+		context->Dispatch((liveBound + GPU_PARTICLES_GROUP_SIZE - 1) / GPU_PARTICLES_GROUP_SIZE, 1, 1);
+		context->CSSetUnorderedAccessViews(0, 2, nullUAVs, keepCounts);
+	}
+
+	// Emit - append new particles after the survivors.  If nothing was simulated the next buffer starts empty
+	if (emitCount > 0) {
+
+		UINT initialCount = (UINT)-1;
+
+		if (liveBound > 0) {
+
+			context->CopyStructureCount(countBuffer, 0, particleUAV[next]);
+
+		} else {
+
+			UINT zeroCounts[4] = { 0, 0, 0, 0 };
+
+			context->UpdateSubresource(countBuffer, 0, nullptr, zeroCounts, 0, 0);
+			initialCount = 0;
+		}
+
+		context->CSSetShader(emitCS, nullptr, 0);
+		context->CSSetUnorderedAccessViews(0, 1, &particleUAV[next], &initialCount);
+		context->Dispatch((emitCount + GPU_PARTICLES_GROUP_SIZE - 1) / GPU_PARTICLES_GROUP_SIZE, 1, 1);
+		context->CSSetUnorderedAccessViews(0, 1, nullUAVs, keepCounts);
+	}
+
+	// Nothing was simulated or emitted so the current buffer is unchanged
+	if (liveBound == 0 && emitCount == 0)
+		return;
+
+	liveBound = min(liveBound + emitCount, maxParticles);
+	current = next;
+
+	// The number of instances drawn is the live count
+	context->CopyStructureCount(drawArgsBuffer, sizeof(UINT), particleUAV[current]);
+}
+
+
+void GPUParticles::clear() {
+
+	liveBound = 0;
+	emitAccumulator = 0.0f;
+}
+
+
+void GPUParticles::render(ID3D11DeviceContext *context) {
+
+	// Validate object before rendering (see notes in constructor)
+	if (!context || !particleVS || !drawArgsBuffer || liveBound == 0)
+		return;
+
+	// Quads are generated in the vertex shader so there is no vertex input
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	context->VSSetShader(particleVS, nullptr, 0);
+	context->VSSetShaderResources(0, 1, &particleSRV[current]);
+
+	// Bind texture resource views and texture sampler objects to the PS stage of the pipeline
+	if (textureResourceView && linearSampler) {
+
+		context->PSSetShaderResources(0, 1, &textureResourceView);
+		context->PSSetSamplers(0, 1, &linearSampler);
+	}
+
+	context->DrawInstancedIndirect(drawArgsBuffer, 0);
+
+	// Unbind the particle buffer so it can be bound as a UAV by the next update
+	ID3D11ShaderResourceView *nullSRV = nullptr;
+
+	context->VSSetShaderResources(0, 1, &nullSRV);
+}
+
+
+void GPUParticles::readParticles(ID3D11DeviceContext *context, vector<GPUParticle>& particles) {
+
+	particles.clear();
+
+	if (!context || !particleBuffer[0] || liveBound == 0)
+		return;
+
+	if (!particleStaging) {
+
+		ID3D11Device *device = nullptr;
+
+		context->GetDevice(&device);
+
+		D3D11_BUFFER_DESC stagingDesc;
+
+		ZeroMemory(&stagingDesc, sizeof(D3D11_BUFFER_DESC));
+
+		stagingDesc.Usage = D3D11_USAGE_STAGING;
+		stagingDesc.ByteWidth = sizeof(GPUParticle) * maxParticles;
+		stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		stagingDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		stagingDesc.StructureByteStride = sizeof(GPUParticle);
+
+		HRESULT hr = device->CreateBuffer(&stagingDesc, nullptr, &particleStaging);
+
+		stagingDesc.ByteWidth = sizeof(UINT) * 4;
+		stagingDesc.MiscFlags = 0;
+		stagingDesc.StructureByteStride = 0;
+
+		if (SUCCEEDED(hr))
+			hr = device->CreateBuffer(&stagingDesc, nullptr, &countStaging);
+
+		device->Release();
+
+		// Release a particle staging buffer whose count buffer failed so the next call creates both again
+		if (!SUCCEEDED(hr)) {
+
+			if (particleStaging)
+				particleStaging->Release();
+
+			particleStaging = nullptr;
+			countStaging = nullptr;
+
+			return;
+		}
+	}
+
+	context->CopyStructureCount(countStaging, 0, particleUAV[current]);
+	context->CopyResource(particleStaging, particleBuffer[current]);
+
+	D3D11_MAPPED_SUBRESOURCE res;
+
+	if (!SUCCEEDED(context->Map(countStaging, 0, D3D11_MAP_READ, 0, &res)))
+		return;
+
+	uint32_t count = min(*(const UINT*)res.pData, maxParticles);
+
+	context->Unmap(countStaging, 0);
+
+	if (!SUCCEEDED(context->Map(particleStaging, 0, D3D11_MAP_READ, 0, &res)))
+		return;
+
+	// Appended particles occupy [0, count) of the buffer
+	particles.resize(count);
+	memcpy(particles.data(), res.pData, sizeof(GPUParticle) * count);
+
+	context->Unmap(particleStaging, 0);
+}
+
+
+uint32_t GPUParticles::getCapacity() const {
+
+	return maxParticles;
+}
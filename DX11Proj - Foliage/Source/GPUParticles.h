@@ -0,0 +1,101 @@
+
+//
+// GPUParticles.h
+//
+
+// Billboarded particle effect simulated entirely on the GPU with compute shaders.  Particles live in two structured buffers with append UAVs.  Each step a simulate pass consumes every particle from the current buffer, integrates it exactly as ParticleSystem does and appends the survivors to the next buffer, then an emit pass appends new particles from a ParticleEmitter (the same structure used by the CPU simulator, copied directly into a constant buffer) and the buffers swap.  The live count never leaves the GPU: CopyStructureCount writes it into a constant buffer read by the compute passes and into the instance count of a DrawInstancedIndirect argument buffer, and gpu_particles_vs builds each quad from the particle buffer using SV_InstanceID.  readParticles copies the particles back to the CPU so the results can be checked against ParticleSystem.
+
+#pragma once
+
+#include <GUObject.h>
+#include <ParticleSystem.h>
+#include <d3d11_2.h>
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+
+
+// Threads per compute shader group (must match gpu_particles.hlsli)
+#define GPU_PARTICLES_GROUP_SIZE		256
+
+
+// Particle as stored in the GPU buffers (see gpu_particles.hlsli)
+struct GPUParticle {
+
+	DirectX::XMFLOAT3					position;
+	float								age;
+	DirectX::XMFLOAT3					velocity;
+	float								life;
+};
+
+
+// Per-step constant buffer.  The emitter is copied as is so the CPU and GPU simulations share one description
+struct GPUParticleConstants {
+
+	ParticleEmitter						emitter;
+
+	float								dt;
+	uint32_t							emitCount;
+	uint32_t							seed;
+	uint32_t							capacity;
+};
+
+
+class GPUParticles : public GUObject {
+
+	uint32_t							maxParticles = 0;
+
+	ParticleEmitter						emitter;
+	float								emitAccumulator = 0.0f;
+	uint32_t							frameIndex = 0;
+
+	// Upper bound on the live count used to size the simulate dispatch.  Particles only die on the GPU so the bound only grows with emission.  0 means the particle buffers are known to be empty (after creation and clear)
+	uint32_t							liveBound = 0;
+
+	// Current (index current) and next particle buffers
+	ID3D11Buffer						*particleBuffer[2];
+	ID3D11UnorderedAccessView			*particleUAV[2];
+	ID3D11ShaderResourceView			*particleSRV[2];
+	uint32_t							current = 0;
+
+	ID3D11Buffer						*constantBuffer = nullptr;
+	ID3D11Buffer						*countBuffer = nullptr; // Live count written by CopyStructureCount
+	ID3D11Buffer						*drawArgsBuffer = nullptr; // DrawInstancedIndirect arguments (6 vertices, live count instances)
+
+	ID3D11ComputeShader					*emitCS = nullptr;
+	ID3D11ComputeShader					*simulateCS = nullptr;
+	ID3D11VertexShader					*particleVS = nullptr;
+
+	ID3D11ShaderResourceView			*textureResourceView = nullptr;
+	ID3D11SamplerState					*linearSampler = nullptr;
+
+	// Readback copies, created on the first call to readParticles
+	ID3D11Buffer						*particleStaging = nullptr;
+	ID3D11Buffer						*countStaging = nullptr;
+
+	void releaseResources();
+
+public:
+
+	GPUParticles(ID3D11Device *device, ID3D11ShaderResourceView *tex_view, const uint32_t initMaxParticles, const ParticleEmitter& E);
+	~GPUParticles();
+
+	void setTexture(ID3D11ShaderResourceView *tex_view);
+
+	void setEmitter(const ParticleEmitter& E);
+	const ParticleEmitter& getEmitter() const;
+
+	// Simulate the particles for dt seconds, then emit the particles due from the emitter rate over dt
+	void update(ID3D11DeviceContext *context, const float dt);
+
+	// Remove all particles
+	void clear();
+
+	// Draw the live particles with DrawInstancedIndirect.  gpu_particles_vs is bound here; the caller sets the pixel shader and the fire_vs constant buffer (b0) as for ParticleEffects
+	void render(ID3D11DeviceContext *context);
+
+	// Copy the live particles back to the CPU (stalls until the GPU has finished).  Intended for debugging and for comparing against ParticleSystem
+	void readParticles(ID3D11DeviceContext *context, std::vector<GPUParticle>& particles);
+
+	uint32_t getCapacity() const;
+};
@@ -0,0 +1,158 @@
+
+//
+// GUBitmap.cpp
+//
+
+#include <stdafx.h>
+#include <GUBitmap.h>
+#include <iostream>
+#include <fstream>
+#include <exception>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+
+// Read little-endian values from the file header
+static uint32_t readUInt32(const uint8_t *p) {
+
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t readUInt16(const uint8_t *p) {
+
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+
+// Rec. 601 luma of an 8 bit BGR triple
+static float luma(const uint8_t b, const uint8_t g, const uint8_t r) {
+
+	return (0.299f * r + 0.587f * g + 0.114f * b) / 255.0f;
+}
+
+
+GUBitmap::GUBitmap(const string& filename) {
+
+	try
+	{
+		ifstream fp(filename.c_str(), ios::in | ios::binary);
+
+		if (!fp.is_open())
+			throw exception("Cannot open bitmap file");
+
+		// BITMAPFILEHEADER (14 bytes) followed by BITMAPINFOHEADER (40 bytes)
+		uint8_t header[54];
+
+		fp.read((char*)header, 54);
+
+		if (!fp || header[0] != 'B' || header[1] != 'M')
+			throw exception("Invalid bitmap file");
+
+		uint32_t dataOffset = readUInt32(header + 10);
+		uint32_t infoSize = readUInt32(header + 14);
+		int32_t bmpWidth = (int32_t)readUInt32(header + 18);
+		int32_t bmpHeight = (int32_t)readUInt32(header + 22);
+		uint16_t bpp = readUInt16(header + 28);
+		uint32_t compression = readUInt32(header + 30);
+		uint32_t paletteSize = readUInt32(header + 46);
+
+		if (infoSize < 40 || bmpWidth <= 0 || bmpHeight == 0)
+			throw exception("Unsupported bitmap header");
+
+		if (compression != 0)
+			throw exception("Compressed bitmaps are not supported");
+
+		if (bpp != 8 && bpp != 24 && bpp != 32)
+			throw exception("Unsupported bitmap pixel format");
+
+		// Positive height means the rows are stored bottom-up
+		bool bottomUp = (bmpHeight > 0);
+
+		width = (uint32_t)bmpWidth;
+		height = (uint32_t)abs(bmpHeight);
+
+		// Palette (BGRX entries) follows the info header for 8 bit images
+		float palette[256];
+
+		if (bpp == 8) {
+
+			if (paletteSize == 0 || paletteSize > 256)
+				paletteSize = 256;
+
+			vector<uint8_t> entries(paletteSize * 4);
+
+			fp.seekg(14 + infoSize, ios::beg);
+			fp.read((char*)entries.data(), entries.size());
+
+			for (uint32_t i = 0; i < 256; i++)
+				palette[i] = (i < paletteSize) ? luma(entries[i * 4], entries[i * 4 + 1], entries[i * 4 + 2]) : 0.0f;
+		}
+
+		// Rows are padded to a multiple of 4 bytes
+		uint32_t bytesPerPixel = bpp / 8;
+		uint32_t rowSize = (width * bytesPerPixel + 3) & ~3u;
+
+		vector<uint8_t> row(rowSize);
+
+		luminance.resize(width * height);
+
+		fp.seekg(dataOffset, ios::beg);
+
+		for (uint32_t y = 0; y < height; y++) {
+
+			fp.read((char*)row.data(), rowSize);
+
+			if (!fp)
+				throw exception("Unexpected end of bitmap data");
+
+			float *dest = luminance.data() + ((bottomUp) ? (height - 1 - y) : y) * width;
+
+			for (uint32_t x = 0; x < width; x++) {
+
+				const uint8_t *p = row.data() + x * bytesPerPixel;
+
+				dest[x] = (bpp == 8) ? palette[p[0]] : luma(p[0], p[1], p[2]);
+			}
+		}
+	}
+	catch (exception& e)
+	{
+		cout << "GUBitmap could not be instantiated due to:\n";
+		cout << e.what() << endl;
+
+		width = height = 0;
+		luminance.clear();
+	}
+}
+
+
+uint32_t GUBitmap::getWidth() const {
+
+	return width;
+}
+
+
+uint32_t GUBitmap::getHeight() const {
+
+	return height;
+}
+
+
+float GUBitmap::value(const int x, const int y) const {
+
+	if (luminance.empty())
+		return 0.0f;
+
+	int cx = min(max(x, 0), (int)width - 1);
+	int cy = min(max(y, 0), (int)height - 1);
+
+	return luminance[cy * width + cx];
+}
+
+
+const vector<float>& GUBitmap::getValues() const {
+
+	return luminance;
+}
@@ -0,0 +1,35 @@
+
+//
+// GUBitmap.h
+//
+
+// Model a greyscale image loaded from an uncompressed Windows bitmap (.bmp) file.  8 bit palettised, 24 bit and 32 bit images are supported and are converted to luminance in the range [0, 1].  Rows are stored top-down so (0, 0) is the top-left pixel as seen in an image viewer and as sampled by Direct3D at texture coordinate (0, 0).  This is used to read heightmaps on the CPU at their real size.
+
+#pragma once
+
+#include <GUObject.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+class GUBitmap : public GUObject {
+
+	uint32_t					width = 0;
+	uint32_t					height = 0;
+
+	std::vector<float>			luminance;
+
+public:
+
+	GUBitmap(const std::string& filename);
+
+	uint32_t getWidth() const;
+	uint32_t getHeight() const;
+
+	// Return the luminance of pixel (x, y).  Coordinates are clamped to the image
+	float value(const int x, const int y) const;
+
+	// Return the luminance values (width * height, row-major, top row first)
+	const std::vector<float>& getValues() const;
+};
@@ -0,0 +1,232 @@
+
+//
+// GUFFT.cpp
+//
+
+#include <stdafx.h>
+#include <GUFFT.h>
+#include <GUParallel.h>
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Tile rows transposed by each parallel task
+#define GU_FFT_TRANSPOSE_GRAIN		8
+
+
+GUFFT::GUFFT(const uint32_t size) {
+
+	if (size < 4 || !IsPowerOfTwo(size))
+		return;
+
+	n = size;
+
+	uint32_t log2n = 0;
+
+	while ((1u << log2n) < n)
+		log2n++;
+
+	bitReverse.resize(n);
+
+	for (uint32_t i = 0; i < n; i++) {
+
+		uint32_t r = 0;
+
+		for (uint32_t b = 0; b < log2n; b++)
+			r |= ((i >> b) & 1) << (log2n - 1 - b);
+
+		bitReverse[i] = r;
+	}
+
+	twiddleCos.resize(n / 2);
+	twiddleSin.resize(n / 2);
+
+	// Evaluate in double precision so the error does not grow with the table index
+	for (uint32_t k = 0; k < n / 2; k++) {
+
+		double theta = -2.0 * 3.14159265358979323846 * (double)k / (double)n;
+
+		twiddleCos[k] = (float)cos(theta);
+		twiddleSin[k] = (float)sin(theta);
+	}
+}
+
+
+uint32_t GUFFT::size() const {
+
+	return n;
+}
+
+
+bool GUFFT::IsPowerOfTwo(const uint32_t x) {
+
+	return x != 0 && (x & (x - 1)) == 0;
+}
+
+
+// Iterative decimation-in-time transform.  Row j of the strip holds element j of every column in the strip, so each butterfly combines two rows 4 columns at a time
+void GUFFT::transformStrip(float *re, float *im, const uint32_t begin, const uint32_t end, const bool inverse) const {
+
+	// Bit reversal permutation of the rows
+	for (uint32_t i = 0; i < n; i++) {
+
+		uint32_t j = bitReverse[i];
+
+		if (j <= i)
+			continue;
+
+		for (uint32_t c = begin; c < end; c += 4) {
+
+			XMVECTOR ar = XMLoadFloat4A((const XMFLOAT4A*)(re + i * n + c));
+			XMVECTOR ai = XMLoadFloat4A((const XMFLOAT4A*)(im + i * n + c));
+
+			XMStoreFloat4A((XMFLOAT4A*)(re + i * n + c), XMLoadFloat4A((const XMFLOAT4A*)(re + j * n + c)));
+			XMStoreFloat4A((XMFLOAT4A*)(im + i * n + c), XMLoadFloat4A((const XMFLOAT4A*)(im + j * n + c)));
+			XMStoreFloat4A((XMFLOAT4A*)(re + j * n + c), ar);
+			XMStoreFloat4A((XMFLOAT4A*)(im + j * n + c), ai);
+		}
+	}
+
+	const float sinSign = (inverse) ? -1.0f : 1.0f;
+
+	for (uint32_t span = 2; span <= n; span <<= 1) {
+
+		uint32_t half = span >> 1;
+		uint32_t twiddleStep = n / span;
+
+		for (uint32_t k = 0; k < half; k++) {
+
+			XMVECTOR wr = XMVectorReplicate(twiddleCos[k * twiddleStep]);
+			XMVECTOR wi = XMVectorReplicate(twiddleSin[k * twiddleStep] * sinSign);
+
+			for (uint32_t g = k; g < n; g += span) {
+
+				float *aRe = re + g * n;
+				float *aIm = im + g * n;
+				float *bRe = re + (g + half) * n;
+				float *bIm = im + (g + half) * n;
+
+				for (uint32_t c = begin; c < end; c += 4) {
+
+					XMVECTOR br = XMLoadFloat4A((const XMFLOAT4A*)(bRe + c));
+					XMVECTOR bi = XMLoadFloat4A((const XMFLOAT4A*)(bIm + c));
+
+					// t = w * b
+					XMVECTOR tr = XMVectorNegativeMultiplySubtract(bi, wi, XMVectorMultiply(br, wr));
+					XMVECTOR ti = XMVectorMultiplyAdd(bi, wr, XMVectorMultiply(br, wi));
+
+					XMVECTOR ar = XMLoadFloat4A((const XMFLOAT4A*)(aRe + c));
+					XMVECTOR ai = XMLoadFloat4A((const XMFLOAT4A*)(aIm + c));
+
+					XMStoreFloat4A((XMFLOAT4A*)(aRe + c), XMVectorAdd(ar, tr));
+					XMStoreFloat4A((XMFLOAT4A*)(aIm + c), XMVectorAdd(ai, ti));
+					XMStoreFloat4A((XMFLOAT4A*)(bRe + c), XMVectorSubtract(ar, tr));
+					XMStoreFloat4A((XMFLOAT4A*)(bIm + c), XMVectorSubtract(ai, ti));
+				}
+			}
+		}
+	}
+}
+
+
+void GUFFT::transformColumns(float *re, float *im, const bool inverse, GUParallel *pool) const {
+
+	if (n == 0 || !re || !im)
+		return;
+
+	uint32_t stripWidth = min(n, (uint32_t)GU_FFT_STRIP_WIDTH);
+	uint32_t numStrips = n / stripWidth;
+
+	if (pool && numStrips > 1) {
+
+		struct StripPass {
+
+			float *re, *im;
+			uint32_t width;
+			bool inverse;
+		} P = { re, im, stripWidth, inverse };
+
+		pool->parallelFor(numStrips, 1, [this, &P](uint32_t begin, uint32_t end) {
+
+			for (uint32_t s = begin; s < end; s++)
+				transformStrip(P.re, P.im, s * P.width, (s + 1) * P.width, P.inverse);
+		});
+
+	} else {
+
+		for (uint32_t s = 0; s < numStrips; s++)
+			transformStrip(re, im, s * stripWidth, (s + 1) * stripWidth, inverse);
+	}
+}
+
+
+// Swap tile (i, j) with the transpose of tile (j, i) for j >= i
+void GUFFT::transposeTiles(float *a, const uint32_t begin, const uint32_t end) const {
+
+	uint32_t numTiles = n / 4;
+
+	for (uint32_t ti = begin; ti < end; ti++) {
+
+		for (uint32_t tj = ti; tj < numTiles; tj++) {
+
+			float *p = a + ti * 4 * n + tj * 4;
+			float *q = a + tj * 4 * n + ti * 4;
+
+			XMMATRIX P(XMLoadFloat4A((const XMFLOAT4A*)p), XMLoadFloat4A((const XMFLOAT4A*)(p + n)), XMLoadFloat4A((const XMFLOAT4A*)(p + n * 2)), XMLoadFloat4A((const XMFLOAT4A*)(p + n * 3)));
+			XMMATRIX Q(XMLoadFloat4A((const XMFLOAT4A*)q), XMLoadFloat4A((const XMFLOAT4A*)(q + n)), XMLoadFloat4A((const XMFLOAT4A*)(q + n * 2)), XMLoadFloat4A((const XMFLOAT4A*)(q + n * 3)));
+
+			P = XMMatrixTranspose(P);
+			Q = XMMatrixTranspose(Q);
+
+			for (uint32_t r = 0; r < 4; r++) {
+
+				XMStoreFloat4A((XMFLOAT4A*)(q + r * n), P.r[r]);
+
+				if (tj != ti)
+					XMStoreFloat4A((XMFLOAT4A*)(p + r * n), Q.r[r]);
+			}
+		}
+	}
+}
+
+
+void GUFFT::transpose(float *re, float *im, GUParallel *pool) const {
+
+	uint32_t numTiles = n / 4;
+
+	if (pool && numTiles > GU_FFT_TRANSPOSE_GRAIN) {
+
+		struct TransposePass {
+
+			float *re, *im;
+		} P = { re, im };
+
+		// Tile rows near the top hold more tiles, so the grain is kept small to balance the work
+		pool->parallelFor(numTiles, GU_FFT_TRANSPOSE_GRAIN, [this, &P](uint32_t begin, uint32_t end) {
+
+			transposeTiles(P.re, begin, end);
+			transposeTiles(P.im, begin, end);
+		});
+
+	} else {
+
+		transposeTiles(re, 0, numTiles);
+		transposeTiles(im, 0, numTiles);
+	}
+}
+
+
+void GUFFT::transform2D(float *re, float *im, const bool inverse, GUParallel *pool) const {
+
+	if (n == 0 || !re || !im)
+		return;
+
+	transformColumns(re, im, inverse, pool);
+	transpose(re, im, pool);
+	transformColumns(re, im, inverse, pool);
+	transpose(re, im, pool);
+}
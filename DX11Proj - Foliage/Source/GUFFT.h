@@ -0,0 +1,54 @@
+
+//
+// GUFFT.h
+//
+
+// Radix-2 fast Fourier transform of square, power of two sized 2D complex arrays.  Complex values are held as separate real and imaginary arrays so the butterflies of a column transform work on whole rows - each butterfly updates 4 columns per SIMD operation (SSE via DirectXMath) and columns are split into strips transformed in parallel on a GUParallel thread pool.  A 2D transform transforms the columns, transposes the arrays, transforms the columns again and transposes back.  Twiddle factors and the bit reversal permutation are computed once when the transform is created so transforms do not allocate.
+
+#pragma once
+
+#include <GUObject.h>
+#include <vector>
+#include <cstdint>
+
+class GUParallel;
+
+
+// Columns transformed by each parallel task (a multiple of 4).  16 floats fill one 64 byte cache line of each row
+#define GU_FFT_STRIP_WIDTH			16
+
+
+class GUFFT : public GUObject {
+
+	uint32_t						n = 0;
+
+	// Row swapped with each row by the bit reversal permutation
+	std::vector<uint32_t>			bitReverse;
+
+	// cos and sin of -2 * pi * k / n for k in [0, n / 2)
+	std::vector<float>				twiddleCos;
+	std::vector<float>				twiddleSin;
+
+	// Transform columns [begin, end) of one array pair in place
+	void transformStrip(float *re, float *im, const uint32_t begin, const uint32_t end, const bool inverse) const;
+
+	// Transpose tile rows [begin, end) of a in place (4x4 tiles)
+	void transposeTiles(float *a, const uint32_t begin, const uint32_t end) const;
+
+	void transpose(float *re, float *im, GUParallel *pool) const;
+
+public:
+
+	// Create a transform of size x size values.  size must be a power of two and at least 4, otherwise size() returns 0 and transforms have no effect
+	GUFFT(const uint32_t size);
+
+	uint32_t size() const;
+
+	// Transform each column of the size x size row-major arrays re and im in place.  The forward transform is X[k] = sum x[j] e^(-2 pi i jk / size) and the inverse uses e^(+2 pi i jk / size) without the 1 / size scale.  re and im must be 16 byte aligned
+	void transformColumns(float *re, float *im, const bool inverse, GUParallel *pool = nullptr) const;
+
+	// 2D transform of the size x size row-major arrays re and im in place (unscaled, as for transformColumns)
+	void transform2D(float *re, float *im, const bool inverse, GUParallel *pool = nullptr) const;
+
+	static bool IsPowerOfTwo(const uint32_t x);
+};
@@ -0,0 +1,181 @@
+
+//
+// GUFrameAllocator.cpp
+//
+
+#include <stdafx.h>
+#include <GUFrameAllocator.h>
+#include <iostream>
+
+using namespace std;
+
+
+GUFrameAllocator* GUFrameAllocator::CreateFrameAllocator(const size_t arenaSize, const uint32_t numArenas, const uint32_t numFrames) {
+
+	if (numArenas == 0 || numFrames == 0)
+		return nullptr;
+
+	// Round arenas up so every arena starts on the arena alignment
+	size_t paddedSize = (arenaSize + GU_FRAME_ARENA_ALIGNMENT - 1) & ~(size_t)(GU_FRAME_ARENA_ALIGNMENT - 1);
+
+	uint8_t *block = (uint8_t*)_aligned_malloc(paddedSize * numArenas * numFrames, GU_FRAME_ARENA_ALIGNMENT);
+
+	if (!block)
+		return nullptr;
+
+	return new GUFrameAllocator(block, paddedSize, numArenas, numFrames);
+}
+
+
+GUFrameAllocator::GUFrameAllocator(uint8_t *initBlock, const size_t initArenaSize, const uint32_t initNumArenas, const uint32_t initNumFrames) {
+
+	block = initBlock;
+	arenaSize = initArenaSize;
+	numArenas = initNumArenas;
+	numFrames = initNumFrames;
+
+	overflowTotal = 0;
+	overflowBytes = 0;
+
+	frames = new GUFrame[numFrames];
+
+	for (uint32_t f = 0; f < numFrames; f++) {
+
+		frames[f].arenas = new GUFrameArena[numArenas];
+		frames[f].numOverflowBlocks = 0;
+
+		for (uint32_t a = 0; a < numArenas; a++) {
+
+			frames[f].arenas[a].base = block + (f * numArenas + a) * arenaSize;
+			frames[f].arenas[a].offset = 0;
+		}
+	}
+}
+
+
+GUFrameAllocator::~GUFrameAllocator() {
+
+	for (uint32_t f = 0; f < numFrames; f++) {
+
+		resetFrame(frames[f]);
+		delete[] frames[f].arenas;
+	}
+
+	delete[] frames;
+
+	_aligned_free(block);
+}
+
+
+// Record the frame's peak usage, zero its arena offsets and free its overflow blocks
+void GUFrameAllocator::resetFrame(GUFrame& F) {
+
+	for (uint32_t a = 0; a < numArenas; a++) {
+
+		size_t used = F.arenas[a].offset.load(memory_order_relaxed);
+
+		if (used > peakBytes)
+			peakBytes = used;
+
+		F.arenas[a].offset.store(0, memory_order_relaxed);
+	}
+
+	uint32_t numBlocks = F.numOverflowBlocks.load(memory_order_relaxed);
+
+	if (numBlocks > GU_FRAME_MAX_OVERFLOW)
+		numBlocks = GU_FRAME_MAX_OVERFLOW;
+
+	for (uint32_t i = 0; i < numBlocks; i++)
+		_aligned_free(F.overflowBlocks[i]);
+
+	F.numOverflowBlocks.store(0, memory_order_relaxed);
+}
+
+
+void GUFrameAllocator::beginFrame() {
+
+	frame = (frame + 1) % numFrames;
+
+	resetFrame(frames[frame]);
+}
+
+
+void* GUFrameAllocator::allocate(const size_t size, const size_t alignment, const uint32_t arena) {
+
+	GUFrame& F = frames[frame];
+	GUFrameArena& A = F.arenas[arena % numArenas];
+
+	size_t mask = alignment - 1;
+	size_t offset = A.offset.load(memory_order_relaxed);
+
+	// Another thread using the same arena can move the offset between the load and the exchange, in which case the exchange reloads it and the aligned offset is recalculated
+	while (true) {
+
+		size_t start = (offset + mask) & ~mask;
+		size_t end = start + size;
+
+		// Arena full.  The offset is left as it is so later smaller requests can still fit
+		if (end > arenaSize || end < start)
+			break;
+
+		if (A.offset.compare_exchange_weak(offset, end, memory_order_relaxed))
+			return A.base + start;
+	}
+
+	// Serve the request from the heap.  The block is freed when this frame is reused
+	overflowTotal.fetch_add(1, memory_order_relaxed);
+	overflowBytes.fetch_add(size, memory_order_relaxed);
+
+	uint32_t index = F.numOverflowBlocks.fetch_add(1, memory_order_relaxed);
+
+	if (index >= GU_FRAME_MAX_OVERFLOW)
+		return nullptr;
+
+	void *ptr = _aligned_malloc((size > 0) ? size : 1, (alignment > GU_FRAME_ARENA_ALIGNMENT) ? alignment : GU_FRAME_ARENA_ALIGNMENT);
+
+	F.overflowBlocks[index] = ptr;
+
+	return ptr;
+}
+
+
+uint32_t GUFrameAllocator::arenaCount() const {
+
+	return numArenas;
+}
+
+
+uint32_t GUFrameAllocator::frameIndex() const {
+
+	return frame;
+}
+
+
+size_t GUFrameAllocator::bytesUsed(const uint32_t arena) const {
+
+	return frames[frame].arenas[arena % numArenas].offset.load(memory_order_relaxed);
+}
+
+
+size_t GUFrameAllocator::getPeakBytes() const {
+
+	return peakBytes;
+}
+
+
+uint32_t GUFrameAllocator::overflowCount() const {
+
+	return overflowTotal.load(memory_order_relaxed);
+}
+
+
+size_t GUFrameAllocator::overflowSize() const {
+
+	return overflowBytes.load(memory_order_relaxed);
+}
+
+
+void GUFrameAllocator::report() {
+
+	cout << "frame allocator: " << numFrames << " frames x " << numArenas << " arenas x " << arenaSize << " bytes, peak " << peakBytes << " bytes, " << overflowCount() << " overflows (" << overflowSize() << " bytes)" << endl;
+}
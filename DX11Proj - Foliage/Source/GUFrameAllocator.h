@@ -0,0 +1,91 @@
+
+//
+// GUFrameAllocator.h
+//
+
+// Linear (bump) allocator for per-frame transient data.  Memory for numFrames frames is allocated once, and each frame is divided into numArenas sub-arenas so threads allocating at the same time (for example the blocks of a GUParallel loop) can each use their own arena rather than contend for one offset (pass the thread index given by GUParallel::parallelForPerThread as the arena).  Allocation advances the arena offset and individual allocations are never freed.  beginFrame moves to the next frame and resets its arenas by zeroing their offsets, so memory allocated in a frame stays valid for the following numFrames - 1 frames (eg. while the GPU reads an upload).  If an arena is full the request is served from the heap and counted as an overflow.  Overflow blocks are freed when their frame is reused, and overflowCount / report show how far the arenas should be grown so steady-state frames make no heap calls.
+
+#pragma once
+
+#include <GUObject.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+// Default number of frames whose allocations are kept alive
+#define GU_FRAME_BUFFERS			3
+
+// Maximum number of overflow heap blocks per frame.  Requests beyond this fail and return nullptr
+#define GU_FRAME_MAX_OVERFLOW		64
+
+// Alignment of each arena
+#define GU_FRAME_ARENA_ALIGNMENT	64
+
+
+class GUFrameAllocator : public GUObject {
+
+	struct GUFrameArena {
+
+		uint8_t								*base;
+		std::atomic<size_t>					offset;
+	};
+
+	struct GUFrame {
+
+		GUFrameArena						*arenas;
+		void								*overflowBlocks[GU_FRAME_MAX_OVERFLOW];
+		std::atomic<uint32_t>				numOverflowBlocks;
+	};
+
+	uint8_t									*block = nullptr;
+	GUFrame									*frames = nullptr;
+	size_t									arenaSize = 0;
+	uint32_t								numArenas = 0;
+	uint32_t								numFrames = 0;
+	uint32_t								frame = 0;
+
+	// Statistics.  peakBytes is the largest amount used in one arena over all completed frames
+	size_t									peakBytes = 0;
+	std::atomic<uint32_t>					overflowTotal;
+	std::atomic<size_t>						overflowBytes;
+
+	GUFrameAllocator(uint8_t *initBlock, const size_t initArenaSize, const uint32_t initNumArenas, const uint32_t initNumFrames);
+
+	// Not copyable.  A copy would share and free the same arenas and overflow blocks.  Declared but not defined
+	GUFrameAllocator(const GUFrameAllocator&);
+	GUFrameAllocator& operator=(const GUFrameAllocator&);
+
+	void resetFrame(GUFrame& F);
+
+public:
+
+	// Frame allocator factory method.  arenaSize is the size in bytes of each sub-arena.  Return nullptr if the arenas cannot be allocated
+	static GUFrameAllocator* CreateFrameAllocator(const size_t arenaSize, const uint32_t numArenas = 1, const uint32_t numFrames = GU_FRAME_BUFFERS);
+
+	~GUFrameAllocator();
+
+	// Start the next frame.  Allocations made numFrames - 1 frames ago are discarded.  Must not be called while other threads are allocating
+	void beginFrame();
+
+	// Allocate size bytes aligned to alignment (a power of 2 no greater than GU_FRAME_ARENA_ALIGNMENT) from the given arena of the current frame.  Safe to call from several threads, though each thread should use its own arena.  Return nullptr only if the arena and the overflow list are both full
+	void* allocate(const size_t size, const size_t alignment = 16, const uint32_t arena = 0);
+
+	// Allocate an uninitialised array of count T
+	template <typename T>
+	T* allocateArray(const size_t count, const uint32_t arena = 0) { return (T*)allocate(count * sizeof(T), (__alignof(T) > 16) ? __alignof(T) : 16, arena); }
+
+	uint32_t arenaCount() const;
+	uint32_t frameIndex() const;
+
+	// Bytes used in the given arena of the current frame
+	size_t bytesUsed(const uint32_t arena = 0) const;
+	size_t getPeakBytes() const;
+
+	// Number and total size of the requests served from the heap since the allocator was created
+	uint32_t overflowCount() const;
+	size_t overflowSize() const;
+
+	// Log the arena usage and overflow statistics
+	void report();
+};
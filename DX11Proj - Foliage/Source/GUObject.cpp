@@ -13,6 +13,20 @@ using namespace std;
 GUObject::GUObject() {
 
 	retainCount = 1; // Initialise retainCount - calling function adopts ownership
+	threadConfined = false;
+}
+
+
+GUObject::GUObject(const GUObject& obj) {
+
+	retainCount = 1;
+	threadConfined = false;
+}
+
+
+GUObject& GUObject::operator=(const GUObject& obj) {
+
+	return *this;
 }
 
 
@@ -20,18 +34,31 @@ GUObject::~GUObject() {
 }
 
 
-// Retain object
+// Retain object.  The caller already holds a reference so no ordering is needed
 void GUObject::retain() {
 
-	retainCount++;
+	if (threadConfined)
+		retainCount.store(retainCount.load(memory_order_relaxed) + 1, memory_order_relaxed);
+	else
+		retainCount.fetch_add(1, memory_order_relaxed);
 }
 
-// Release ownership of object.  If retainCount=0 then delete object.  Return true if the object is deleted successfully - so calling function knows if pointer/handle to object is valid or not.
+// Release ownership of object.  If retainCount=0 then delete object.  Return true if the object is deleted successfully - so calling function knows if pointer/handle to object is valid or not.  The decrement is acq_rel so writes made by every thread before its release are visible to the thread that deletes the object
 bool GUObject::release() {
 
-	retainCount--;
+	unsigned int prevCount;
+
+	if (threadConfined) {
+
+		prevCount = retainCount.load(memory_order_relaxed);
+		retainCount.store(prevCount - 1, memory_order_relaxed);
+
+	} else {
+
+		prevCount = retainCount.fetch_sub(1, memory_order_acq_rel);
+	}
 	
-	if (retainCount == 0) {
+	if (prevCount == 1) {
 
 		delete(this);
 		return true;
@@ -43,7 +70,13 @@ bool GUObject::release() {
 
 void GUObject::report() {
 
-	cout << "retain count = " << retainCount << endl;
+	cout << "retain count = " << retainCount.load(memory_order_relaxed) << endl;
+}
+
+
+void GUObject::setThreadConfined(const bool confined) {
+
+	threadConfined = confined;
 }
 
 
@@ -51,7 +84,11 @@ void GUObject::report() {
 
 unsigned int GUObject::getRetainCount() {
 
-	return retainCount;
+	return retainCount.load(memory_order_relaxed);
 }
 
 
+bool GUObject::isThreadConfined() {
+
+	return threadConfined;
+}
@@ -3,20 +3,27 @@
 // GUObject.h
 //
 
-// Base class incorporating a reference counting retain-release mechanism
+// Base class incorporating a reference counting retain-release mechanism.  The retain count is atomic so objects can be shared with and released from worker threads.  An object only ever retained and released on one thread can be marked thread-confined so retain and release skip the atomic read-modify-write.  GURef (GURef.h) wraps retain / release in a smart pointer
 
 #pragma once
 
 #include <GUMemory.h>
+#include <atomic>
 
 // Define base abstract class
 class GUObject {
 
 private:
-	unsigned int			retainCount;
+	std::atomic<unsigned int>	retainCount;
+	bool						threadConfined;
 
 public:
 	GUObject();
+
+	// A copy is a new object owned by the calling function, so the retain count is not copied
+	GUObject(const GUObject& obj);
+	GUObject& operator=(const GUObject& obj);
+
 	// Important - all derived classed have virtual destructors
 	// This ensures appropriate destructor called for based-class pointer referenced sub-classes
 	virtual ~GUObject();
@@ -25,6 +32,10 @@ public:
 	bool release();
 	virtual void report();
 
+	// Mark the object as only retained and released on one thread.  The object must not be shared with other threads while confined
+	void setThreadConfined(const bool confined);
+
 	// Accessor methods
 	unsigned int getRetainCount();
+	bool isThreadConfined();
 };
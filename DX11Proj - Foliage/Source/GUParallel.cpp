@@ -0,0 +1,148 @@
+
+//
+// GUParallel.cpp
+//
+
+#include <stdafx.h>
+#include <GUParallel.h>
+#include <algorithm>
+
+using namespace std;
+
+
+GUParallel* GUParallel::CreateThreadPool(const uint32_t numThreads) {
+
+	uint32_t n = numThreads;
+
+	if (n == 0)
+		n = max(thread::hardware_concurrency(), 1u);
+
+	// The calling thread runs blocks too so one fewer worker is needed
+	return new GUParallel(n - 1);
+}
+
+
+GUParallel::GUParallel(const uint32_t numWorkers) {
+
+	nextBlock = 0;
+
+	workers.reserve(numWorkers);
+
+	for (uint32_t i = 0; i < numWorkers; i++)
+		workers.push_back(thread(&GUParallel::workerMain, this, i + 1));
+}
+
+
+GUParallel::~GUParallel() {
+
+	{
+		lock_guard<mutex> lock(poolMutex);
+		quit = true;
+	}
+
+	workAvailable.notify_all();
+
+	for (uint32_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+
+void GUParallel::workerMain(const uint32_t threadIndex) {
+
+	unsigned long long lastGeneration = 0;
+
+	for (;;) {
+
+		{
+			unique_lock<mutex> lock(poolMutex);
+
+			while (!quit && generation == lastGeneration)
+				workAvailable.wait(lock);
+
+			if (quit)
+				return;
+
+			lastGeneration = generation;
+		}
+
+		runBlocks(threadIndex);
+
+		{
+			lock_guard<mutex> lock(poolMutex);
+
+			if (--activeWorkers == 0)
+				workComplete.notify_one();
+		}
+	}
+}
+
+
+void GUParallel::runBlocks(const uint32_t threadIndex) {
+
+	for (;;) {
+
+		uint32_t b = nextBlock.fetch_add(1);
+
+		if (b >= numBlocks)
+			return;
+
+		uint32_t begin = b * blockSize;
+
+		(*body)(begin, min(begin + blockSize, count), threadIndex);
+	}
+}
+
+
+uint32_t GUParallel::threadCount() const {
+
+	return (uint32_t)workers.size() + 1;
+}
+
+
+void GUParallel::parallelFor(const uint32_t n, const uint32_t grain, const function<void(uint32_t, uint32_t)>& fn) {
+
+	// The adapter only captures a reference so it fits in std::function without a heap allocation
+	parallelForPerThread(n, grain, [&fn](uint32_t begin, uint32_t end, uint32_t) { fn(begin, end); });
+}
+
+
+void GUParallel::parallelForPerThread(const uint32_t n, const uint32_t grain, const function<void(uint32_t, uint32_t, uint32_t)>& fn) {
+
+	if (n == 0)
+		return;
+
+	uint32_t g = max(grain, 1u);
+
+	// Run on the calling thread if there is nothing to share, still in blocks of grain so callers can rely on the block boundaries
+	if (workers.empty() || n <= g) {
+
+		for (uint32_t begin = 0; begin < n; begin += g)
+			fn(begin, min(begin + g, n), 0);
+
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(poolMutex);
+
+		body = &fn;
+		count = n;
+		blockSize = g;
+		numBlocks = (n + g - 1) / g;
+		nextBlock = 0;
+		activeWorkers = (uint32_t)workers.size();
+		generation++;
+	}
+
+	workAvailable.notify_all();
+
+	runBlocks(0);
+
+	// Wait for the workers to finish their last blocks
+	unique_lock<mutex> lock(poolMutex);
+
+	while (activeWorkers > 0)
+		workComplete.wait(lock);
+
+	body = nullptr;
+}
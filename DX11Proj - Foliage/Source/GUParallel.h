@@ -0,0 +1,61 @@
+
+//
+// GUParallel.h
+//
+
+// Model a simple fork-join thread pool for data-parallel loops.  parallelFor splits an index range into blocks that are claimed by the worker threads and the calling thread through a shared atomic counter, and returns once every block has been processed.  Only one loop can be in flight at a time so parallelFor must not be called from inside a loop body or from more than one thread.  parallelForPerThread also passes the body the index of the thread running each block, so per-thread state such as GUFrameAllocator arenas can be used without locking.
+
+#pragma once
+
+#include <GUObject.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+
+class GUParallel : public GUObject {
+
+	std::vector<std::thread>					workers;
+
+	std::mutex									poolMutex;
+	std::condition_variable						workAvailable;
+	std::condition_variable						workComplete;
+
+	// Current loop.  Workers wake when generation changes.  body points to the caller's function, which outlives the loop since parallelFor waits for it, so starting a loop does not allocate
+	const std::function<void(uint32_t, uint32_t, uint32_t)>	*body = nullptr;
+	uint32_t									count = 0;
+	uint32_t									blockSize = 1;
+	uint32_t									numBlocks = 0;
+	std::atomic<uint32_t>						nextBlock;
+	uint32_t									activeWorkers = 0;
+	unsigned long long							generation = 0;
+	bool										quit = false;
+
+	GUParallel(const uint32_t numWorkers);
+
+	// Worker threads are numbered from 1.  The calling thread is thread 0
+	void workerMain(const uint32_t threadIndex);
+
+	// Claim and run blocks of the current loop on the given thread until none remain
+	void runBlocks(const uint32_t threadIndex);
+
+public:
+
+	// Thread pool factory method.  numThreads is the total number of threads used by parallelFor including the calling thread.  0 uses one thread per hardware thread
+	static GUParallel* CreateThreadPool(const uint32_t numThreads = 0);
+
+	~GUParallel();
+
+	// Number of threads used by parallelFor including the calling thread
+	uint32_t threadCount() const;
+
+	// Call fn(begin, end) over [0, n) in blocks [k * grain, min((k + 1) * grain, n)).  Blocks run concurrently in no particular order.  Loops of a single block run on the calling thread.  Lambdas capturing no more than two pointers (for example [this, &state]) fit in std::function without a heap allocation on the common library implementations
+	void parallelFor(const uint32_t n, const uint32_t grain, const std::function<void(uint32_t, uint32_t)>& fn);
+
+	// As parallelFor, calling fn(begin, end, thread) where thread in [0, threadCount()) identifies the thread running the block.  Blocks given the same thread index never run at the same time
+	void parallelForPerThread(const uint32_t n, const uint32_t grain, const std::function<void(uint32_t, uint32_t, uint32_t)>& fn);
+};
@@ -0,0 +1,105 @@
+
+//
+// GUProfiler.cpp
+//
+
+#include <stdafx.h>
+#include <GUProfiler.h>
+#include <iostream>
+
+using namespace std;
+
+
+// Profiler factory method
+GUProfiler* GUProfiler::CreateProfiler() {
+
+	return new GUProfiler();
+}
+
+
+GUProfiler::~GUProfiler() {
+}
+
+
+// Register a new named section and return the section id used by beginSection / endSection
+int GUProfiler::registerSection(const string& name) {
+
+	GUProfilerSection S;
+
+	S.name = name;
+	S.startTimeIndex = 0;
+	S.totalTime = 0;
+	S.totalItems = 0;
+	S.numCalls = 0;
+
+	sections.push_back(S);
+
+	return (int)sections.size() - 1;
+}
+
+
+void GUProfiler::beginSection(const int sectionID) {
+
+	sections[sectionID].startTimeIndex = GUClock::ActualTime();
+}
+
+
+void GUProfiler::endSection(const int sectionID, const unsigned long long numItems) {
+
+	GUProfilerSection& S = sections[sectionID];
+
+	S.totalTime += GUClock::ActualTime() - S.startTimeIndex;
+	S.totalItems += numItems;
+	S.numCalls++;
+}
+
+
+// Clear all accumulated timings
+void GUProfiler::reset() {
+
+	for (auto& S : sections) {
+
+		S.totalTime = 0;
+		S.totalItems = 0;
+		S.numCalls = 0;
+	}
+}
+
+
+// Query methods
+
+gu_seconds GUProfiler::averageSectionTime(const int sectionID) const {
+
+	const GUProfilerSection& S = sections[sectionID];
+
+	return (S.numCalls > 0) ? GUClock::ConvertTimeIntervalToSeconds(S.totalTime) / (gu_seconds)S.numCalls : 0.0;
+}
+
+
+double GUProfiler::itemsPerMillisecond(const int sectionID) const {
+
+	const GUProfilerSection& S = sections[sectionID];
+
+	gu_seconds t = GUClock::ConvertTimeIntervalToSeconds(S.totalTime);
+
+	return (t > 0.0) ? (double)S.totalItems / (t * 1000.0) : 0.0;
+}
+
+
+void GUProfiler::reportTimingData() const {
+
+	if (sections.size() == 0)
+		return;
+
+	cout << "\nCPU sections (average ms per call, items per ms)...\n";
+
+	for (int i = 0; i < (int)sections.size(); ++i) {
+
+		cout << sections[i].name << " = " << averageSectionTime(i) * 1000.0 << "ms";
+
+		if (sections[i].totalItems > 0)
+			cout << " (" << itemsPerMillisecond(i) << " items/ms)";
+
+		cout << endl;
+	}
+}
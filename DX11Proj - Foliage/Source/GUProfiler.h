@@ -0,0 +1,52 @@
+
+//
+// GUProfiler.h
+//
+
+// Model a simple CPU profiler that accumulates the time spent in named sections of the frame (culling, sorting, simulation etc) along with the number of items processed, so per-frame cost and item throughput can be reported alongside the main FPS clock
+
+#pragma once
+
+#include <GUObject.h>
+#include <GUClock.h>
+#include <string>
+#include <vector>
+
+
+class GUProfiler : public GUObject {
+
+	struct GUProfilerSection {
+
+		std::string				name;
+		gu_time_index			startTimeIndex;
+		gu_time_interval		totalTime;
+		unsigned long long		totalItems;
+		unsigned long			numCalls;
+	};
+
+	std::vector<GUProfilerSection>	sections;
+
+
+public:
+
+	// Profiler factory method.  A valid GUClock must have been created first so the performance frequency is known when timings are reported
+	static GUProfiler* CreateProfiler();
+
+	~GUProfiler();
+
+	// Register a new named section and return the section id used by beginSection / endSection
+	int registerSection(const std::string& name);
+
+	// Mark the start and end of a timed section.  numItems records the number of items (instances, particles, keys...) processed so throughput can be derived
+	void beginSection(const int sectionID);
+	void endSection(const int sectionID, const unsigned long long numItems = 0);
+
+	// Clear all accumulated timings
+	void reset();
+
+	// Query methods
+	gu_seconds averageSectionTime(const int sectionID) const;
+	double itemsPerMillisecond(const int sectionID) const;
+
+	void reportTimingData() const;
+};
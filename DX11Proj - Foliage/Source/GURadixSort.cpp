@@ -0,0 +1,147 @@
+
+//
+// GURadixSort.cpp
+//
+
+#include <stdafx.h>
+#include <GURadixSort.h>
+#include <GUParallel.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+
+uint32_t GURadixSort::FloatKey(const float f) {
+
+	uint32_t u;
+
+	memcpy(&u, &f, sizeof(uint32_t));
+
+	// Negative values have every bit flipped so larger magnitudes sort first, positive values only the sign bit so they sort after all negative values
+	return u ^ ((u & 0x80000000) ? 0xFFFFFFFF : 0x80000000);
+}
+
+
+uint32_t GURadixSort::blockSize(const uint32_t count, GUParallel *pool) {
+
+	// Enough blocks to occupy every thread, but no smaller than GU_RADIX_MIN_BLOCK keys
+	uint32_t numThreads = (pool) ? pool->threadCount() : 1;
+
+	return max((count + numThreads - 1) / numThreads, (uint32_t)GU_RADIX_MIN_BLOCK);
+}
+
+
+void GURadixSort::reserve(const uint32_t count, GUParallel *pool) {
+
+	if (keyScratch.size() < count) {
+
+		keyScratch.resize(count);
+		valueScratch.resize(count);
+	}
+
+	uint32_t numThreads = (pool) ? pool->threadCount() : 1;
+
+	blockCounts.reserve(numThreads * GU_RADIX_BUCKETS);
+}
+
+
+void GURadixSort::sort(uint32_t *keys, uint32_t *values, const uint32_t count, GUParallel *pool) {
+
+	if (count < 2)
+		return;
+
+	reserve(count, pool);
+
+	// State of the current pass.  The parallel tasks capture only this and &P so std::function does not allocate
+	struct RadixPass {
+
+		uint32_t					*srcKeys, *srcValues;
+		uint32_t					*dstKeys, *dstValues;
+		uint32_t					shift;
+		uint32_t					blockSize;
+	} P;
+
+	P.blockSize = blockSize(count, pool);
+
+	uint32_t numBlocks = (count + P.blockSize - 1) / P.blockSize;
+
+	blockCounts.resize(numBlocks * GU_RADIX_BUCKETS);
+
+	P.srcKeys = keys;
+	P.srcValues = values;
+	P.dstKeys = keyScratch.data();
+	P.dstValues = valueScratch.data();
+
+	// Count the digits of each block
+	auto histogram = [this, &P](uint32_t begin, uint32_t end) {
+
+		uint32_t *counts = &blockCounts[(begin / P.blockSize) * GU_RADIX_BUCKETS];
+
+		memset(counts, 0, sizeof(uint32_t) * GU_RADIX_BUCKETS);
+
+		for (uint32_t i = begin; i < end; i++)
+			counts[(P.srcKeys[i] >> P.shift) & (GU_RADIX_BUCKETS - 1)]++;
+	};
+
+	// Scatter each block to its offsets
+	auto scatter = [this, &P](uint32_t begin, uint32_t end) {
+
+		uint32_t *offsets = &blockCounts[(begin / P.blockSize) * GU_RADIX_BUCKETS];
+
+		for (uint32_t i = begin; i < end; i++) {
+
+			uint32_t j = offsets[(P.srcKeys[i] >> P.shift) & (GU_RADIX_BUCKETS - 1)]++;
+
+			P.dstKeys[j] = P.srcKeys[i];
+			P.dstValues[j] = P.srcValues[i];
+		}
+	};
+
+	for (P.shift = 0; P.shift < 32; P.shift += GU_RADIX_BITS) {
+
+		if (pool)
+			pool->parallelFor(count, P.blockSize, histogram);
+		else
+			histogram(0, count);
+
+		// Skip the pass if every key has the same digit
+		uint32_t firstDigit = (P.srcKeys[0] >> P.shift) & (GU_RADIX_BUCKETS - 1);
+		uint32_t firstDigitCount = 0;
+
+		for (uint32_t b = 0; b < numBlocks; b++)
+			firstDigitCount += blockCounts[b * GU_RADIX_BUCKETS + firstDigit];
+
+		if (firstDigitCount == count)
+			continue;
+
+		// Convert the counts into output offsets.  Digits are ordered first and blocks in order within each digit so the sort is stable
+		uint32_t offset = 0;
+
+		for (uint32_t d = 0; d < GU_RADIX_BUCKETS; d++) {
+
+			for (uint32_t b = 0; b < numBlocks; b++) {
+
+				uint32_t n = blockCounts[b * GU_RADIX_BUCKETS + d];
+
+				blockCounts[b * GU_RADIX_BUCKETS + d] = offset;
+				offset += n;
+			}
+		}
+
+		if (pool)
+			pool->parallelFor(count, P.blockSize, scatter);
+		else
+			scatter(0, count);
+
+		swap(P.srcKeys, P.dstKeys);
+		swap(P.srcValues, P.dstValues);
+	}
+
+	// An odd number of passes leaves the result in the scratch buffers
+	if (P.srcKeys != keys) {
+
+		memcpy(keys, P.srcKeys, sizeof(uint32_t) * count);
+		memcpy(values, P.srcValues, sizeof(uint32_t) * count);
+	}
+}
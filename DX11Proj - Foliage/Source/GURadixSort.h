@@ -0,0 +1,46 @@
+
+//
+// GURadixSort.h
+//
+
+// Least significant digit (LSD) radix sort of 32 bit keys with 32 bit values (typically indices), 8 bits per pass.  Each pass builds a digit histogram per block of keys, turns the histograms into per-block output offsets and scatters every block to its offsets, so both the histogram and scatter steps run in parallel on a GUParallel thread pool while the sort stays stable.  Passes whose digit is the same for every key are skipped, so keys quantised to fewer bits cost fewer passes.  Scratch buffers are kept between calls so repeated per-frame sorts do not allocate.
+
+#pragma once
+
+#include <GUObject.h>
+#include <vector>
+#include <cstdint>
+
+class GUParallel;
+
+
+// Bits sorted per pass
+#define GU_RADIX_BITS				8
+#define GU_RADIX_BUCKETS			(1 << GU_RADIX_BITS)
+
+// Minimum number of keys handled by each parallel block
+#define GU_RADIX_MIN_BLOCK			16384
+
+
+class GURadixSort : public GUObject {
+
+	std::vector<uint32_t>			keyScratch;
+	std::vector<uint32_t>			valueScratch;
+
+	// Per-block digit counts, then per-block output offsets (numBlocks * GU_RADIX_BUCKETS)
+	std::vector<uint32_t>			blockCounts;
+
+	// Size of the blocks sorted in parallel for count keys
+	static uint32_t blockSize(const uint32_t count, GUParallel *pool);
+
+public:
+
+	// Map a float to a key whose unsigned order matches the float order (-0 sorts before +0)
+	static uint32_t FloatKey(const float f);
+
+	// Allocate the scratch buffers for sorting up to count keys on pool so later sorts of that size do not allocate
+	void reserve(const uint32_t count, GUParallel *pool = nullptr);
+
+	// Sort count keys into ascending order and apply the same permutation to values.  The sort is stable.  Blocks are processed on pool if one is given
+	void sort(uint32_t *keys, uint32_t *values, const uint32_t count, GUParallel *pool = nullptr);
+};
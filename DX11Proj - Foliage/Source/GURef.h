@@ -0,0 +1,110 @@
+
+//
+// GURef.h
+//
+
+// Intrusive smart pointer to a GUObject.  A GURef holds one retain on the object, taken when it is copied and given back on destruction or reassignment, so objects can be shared (including with worker threads) without matching retain / release calls by hand.  New objects start with a retain count of 1 owned by the caller, so a GURef constructed from a raw pointer adopts that reference.  Use GURef<T>::Retain to share an object that is owned elsewhere.  A single GURef is not itself thread safe, but different GURefs to the same object can be used on different threads
+
+#pragma once
+
+#include <GUObject.h>
+
+
+template <class T>
+class GURef {
+
+	T								*ptr = nullptr;
+
+public:
+
+	// Share an object owned elsewhere.  The object is retained
+	static GURef<T> Retain(T *obj) {
+
+		if (obj)
+			obj->retain();
+
+		return GURef<T>(obj);
+	}
+
+	GURef() {}
+
+	// Adopt the caller's reference to obj
+	explicit GURef(T *obj) : ptr(obj) {}
+
+	GURef(const GURef<T>& ref) : ptr(ref.ptr) {
+
+		if (ptr)
+			ptr->retain();
+	}
+
+	GURef(GURef<T>&& ref) : ptr(ref.ptr) {
+
+		ref.ptr = nullptr;
+	}
+
+	// Conversion from a reference to a derived class
+	template <class U>
+	GURef(const GURef<U>& ref) : ptr(ref.get()) {
+
+		if (ptr)
+			ptr->retain();
+	}
+
+	~GURef() {
+
+		if (ptr)
+			ptr->release();
+	}
+
+	GURef<T>& operator=(const GURef<T>& ref) {
+
+		// Retain first so self assignment does not release the object
+		if (ref.ptr)
+			ref.ptr->retain();
+
+		if (ptr)
+			ptr->release();
+
+		ptr = ref.ptr;
+
+		return *this;
+	}
+
+	GURef<T>& operator=(GURef<T>&& ref) {
+
+		if (this != &ref) {
+
+			if (ptr)
+				ptr->release();
+
+			ptr = ref.ptr;
+			ref.ptr = nullptr;
+		}
+
+		return *this;
+	}
+
+	// Release the current object and adopt the caller's reference to obj
+	void reset(T *obj = nullptr) {
+
+		if (ptr)
+			ptr->release();
+
+		ptr = obj;
+	}
+
+	// Give up the reference without releasing it and return the object.  The caller becomes responsible for releasing it
+	T* detach() {
+
+		T *obj = ptr;
+
+		ptr = nullptr;
+
+		return obj;
+	}
+
+	T* get() const { return ptr; }
+	T* operator->() const { return ptr; }
+	T& operator*() const { return *ptr; }
+	explicit operator bool() const { return ptr != nullptr; }
+};
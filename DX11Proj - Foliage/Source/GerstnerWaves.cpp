@@ -0,0 +1,323 @@
+
+//
+// GerstnerWaves.cpp
+//
+
+#include <stdafx.h>
+#include <GerstnerWaves.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace DirectX;
+
+
+#define GERSTNER_TWO_PI		6.28318530717958647692
+
+
+GerstnerWave::GerstnerWave() {
+
+	direction = XMFLOAT2(1.0f, 0.0f);
+	amplitude = 0.0f;
+	wavenumber = 0.0f;
+	angularFrequency = 0.0f;
+	steepness = 0.0f;
+	phase = 0.0f;
+	timePhase = 0.0f;
+}
+
+
+GerstnerWave::GerstnerWave(const XMFLOAT2& initDirection, const float initAmplitude, const float wavelength, const float initSteepness, const float gravity) {
+
+	float length = sqrtf(initDirection.x * initDirection.x + initDirection.y * initDirection.y);
+
+	direction = (length > 0.0f) ? XMFLOAT2(initDirection.x / length, initDirection.y / length) : XMFLOAT2(1.0f, 0.0f);
+	amplitude = initAmplitude;
+	wavenumber = (wavelength > 0.0f) ? (float)(GERSTNER_TWO_PI / wavelength) : 0.0f;
+
+	// Deep water dispersion relation
+	angularFrequency = sqrtf(gravity * wavenumber);
+	steepness = initSteepness;
+	phase = 0.0f;
+	timePhase = 0.0f;
+}
+
+
+GerstnerWaves::GerstnerWaves() {
+
+	constants.numWaves = 0;
+	constants.padding[0] = constants.padding[1] = constants.padding[2] = 0.0f;
+}
+
+
+bool GerstnerWaves::addWave(const GerstnerWave& wave) {
+
+	if (constants.numWaves >= GERSTNER_MAX_WAVES)
+		return false;
+
+	constants.waves[constants.numWaves++] = wave;
+	setTime(time);
+
+	return true;
+}
+
+
+void GerstnerWaves::setWave(const uint32_t index, const GerstnerWave& wave) {
+
+	if (index >= constants.numWaves)
+		return;
+
+	constants.waves[index] = wave;
+	setTime(time);
+}
+
+
+void GerstnerWaves::clear() {
+
+	constants.numWaves = 0;
+}
+
+
+uint32_t GerstnerWaves::waveCount() const {
+
+	return constants.numWaves;
+}
+
+
+const GerstnerWave& GerstnerWaves::getWave(const uint32_t index) const {
+
+	return constants.waves[min(index, (uint32_t)GERSTNER_MAX_WAVES - 1)];
+}
+
+
+void GerstnerWaves::setTime(const double t) {
+
+	time = t;
+
+	// Wrap in double precision so the float phase stays accurate however large t becomes
+	for (uint32_t i = 0; i < constants.numWaves; i++) {
+
+		GerstnerWave& w = constants.waves[i];
+
+		double p = fmod((double)w.phase - (double)w.angularFrequency * t, GERSTNER_TWO_PI);
+
+		if (p < 0.0)
+			p += GERSTNER_TWO_PI;
+
+		w.timePhase = (float)p;
+	}
+}
+
+
+double GerstnerWaves::getTime() const {
+
+	return time;
+}
+
+
+const GerstnerWaveCBuffer& GerstnerWaves::getConstants() const {
+
+	return constants;
+}
+
+
+XMFLOAT2 GerstnerWaves::getDisplacementBound() const {
+
+	XMFLOAT2 bound(0.0f, 0.0f);
+
+	for (uint32_t i = 0; i < constants.numWaves; i++) {
+
+		bound.x += fabsf(constants.waves[i].steepness * constants.waves[i].amplitude);
+		bound.y += fabsf(constants.waves[i].amplitude);
+	}
+
+	return bound;
+}
+
+
+// Must match evaluateGerstnerWaves in gerstner_waves.hlsli
+void GerstnerWaves::evaluate4(FXMVECTOR x, FXMVECTOR z, XMVECTOR *dx, XMVECTOR *dy, XMVECTOR *dz, XMVECTOR *nx, XMVECTOR *ny, XMVECTOR *nz) const {
+
+	XMVECTOR sx = XMVectorZero();
+	XMVECTOR sy = XMVectorZero();
+	XMVECTOR sz = XMVectorZero();
+	XMVECTOR snx = XMVectorZero();
+	XMVECTOR sny = XMVectorSplatOne();
+	XMVECTOR snz = XMVectorZero();
+
+	for (uint32_t i = 0; i < constants.numWaves; i++) {
+
+		const GerstnerWave& w = constants.waves[i];
+
+		XMVECTOR theta = XMVectorMultiplyAdd(XMVectorMultiplyAdd(x, XMVectorReplicate(w.direction.x), XMVectorMultiply(z, XMVectorReplicate(w.direction.y))), XMVectorReplicate(w.wavenumber), XMVectorReplicate(w.timePhase));
+
+		XMVECTOR S, C;
+
+		XMVectorSinCos(&S, &C, theta);
+
+		XMVECTOR A = XMVectorReplicate(w.amplitude);
+		XMVECTOR QAC = XMVectorMultiply(XMVectorReplicate(w.steepness * w.amplitude), C);
+
+		sx = XMVectorMultiplyAdd(QAC, XMVectorReplicate(w.direction.x), sx);
+		sy = XMVectorMultiplyAdd(A, S, sy);
+		sz = XMVectorMultiplyAdd(QAC, XMVectorReplicate(w.direction.y), sz);
+
+		if (nx) {
+
+			XMVECTOR kAC = XMVectorMultiply(XMVectorReplicate(w.wavenumber * w.amplitude), C);
+
+			snx = XMVectorNegativeMultiplySubtract(kAC, XMVectorReplicate(w.direction.x), snx);
+			sny = XMVectorNegativeMultiplySubtract(XMVectorReplicate(w.steepness * w.wavenumber * w.amplitude), S, sny);
+			snz = XMVectorNegativeMultiplySubtract(kAC, XMVectorReplicate(w.direction.y), snz);
+		}
+	}
+
+	*dx = sx;
+	*dy = sy;
+	*dz = sz;
+
+	if (nx) {
+
+		*nx = snx;
+		*ny = sny;
+		*nz = snz;
+	}
+}
+
+
+template <class Fn>
+void GerstnerWaves::forEach4(const float *x, const float *z, const uint32_t count, Fn fn) {
+
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+		fn(XMLoadFloat4((const XMFLOAT4*)(x + i)), XMLoadFloat4((const XMFLOAT4*)(z + i)), i, 4);
+
+	if (i < count) {
+
+		XMFLOAT4A px(0.0f, 0.0f, 0.0f, 0.0f), pz(0.0f, 0.0f, 0.0f, 0.0f);
+
+		for (uint32_t j = 0; i + j < count; j++) {
+
+			(&px.x)[j] = x[i + j];
+			(&pz.x)[j] = z[i + j];
+		}
+
+		fn(XMLoadFloat4A(&px), XMLoadFloat4A(&pz), i, count - i);
+	}
+}
+
+
+void GerstnerWaves::displacements(const float *x, const float *z, XMFLOAT3 *displacementOut, const uint32_t count) const {
+
+	forEach4(x, z, count, [this, displacementOut](FXMVECTOR px, FXMVECTOR pz, uint32_t i, uint32_t n) {
+
+		XMVECTOR dx, dy, dz;
+
+		evaluate4(px, pz, &dx, &dy, &dz);
+
+		XMFLOAT4A rx, ry, rz;
+
+		XMStoreFloat4A(&rx, dx);
+		XMStoreFloat4A(&ry, dy);
+		XMStoreFloat4A(&rz, dz);
+
+		for (uint32_t j = 0; j < n; j++)
+			displacementOut[i + j] = XMFLOAT3((&rx.x)[j], (&ry.x)[j], (&rz.x)[j]);
+	});
+}
+
+
+void GerstnerWaves::normals(const float *x, const float *z, XMFLOAT3 *normalOut, const uint32_t count) const {
+
+	forEach4(x, z, count, [this, normalOut](FXMVECTOR px, FXMVECTOR pz, uint32_t i, uint32_t n) {
+
+		XMVECTOR dx, dy, dz, nx, ny, nz;
+
+		evaluate4(px, pz, &dx, &dy, &dz, &nx, &ny, &nz);
+
+		// Normalise the four normals in SoA form
+		XMVECTOR invLength = XMVectorReciprocalSqrt(XMVectorMultiplyAdd(nx, nx, XMVectorMultiplyAdd(ny, ny, XMVectorMultiply(nz, nz))));
+
+		XMFLOAT4A rx, ry, rz;
+
+		XMStoreFloat4A(&rx, XMVectorMultiply(nx, invLength));
+		XMStoreFloat4A(&ry, XMVectorMultiply(ny, invLength));
+		XMStoreFloat4A(&rz, XMVectorMultiply(nz, invLength));
+
+		for (uint32_t j = 0; j < n; j++)
+			normalOut[i + j] = XMFLOAT3((&rx.x)[j], (&ry.x)[j], (&rz.x)[j]);
+	});
+}
+
+
+void GerstnerWaves::surfaceHeights(const float *x, const float *z, float *heightOut, const uint32_t count, const uint32_t iterations) const {
+
+	forEach4(x, z, count, [this, heightOut, iterations](FXMVECTOR px, FXMVECTOR pz, uint32_t i, uint32_t n) {
+
+		// Find the undisplaced point (ux, uz) that moves to (px, pz) by iterating u = p - d(u)
+		XMVECTOR ux = px;
+		XMVECTOR uz = pz;
+		XMVECTOR dx, dy, dz;
+
+		for (uint32_t k = 0; k < iterations; k++) {
+
+			evaluate4(ux, uz, &dx, &dy, &dz);
+
+			ux = XMVectorSubtract(px, dx);
+			uz = XMVectorSubtract(pz, dz);
+		}
+
+		evaluate4(ux, uz, &dx, &dy, &dz);
+
+		XMFLOAT4A ry;
+
+		XMStoreFloat4A(&ry, dy);
+
+		for (uint32_t j = 0; j < n; j++)
+			heightOut[i + j] = (&ry.x)[j];
+	});
+}
+
+
+// The sine-sum wave amp * sin(freq * dot(dir, p) + phase * t) travels against dir.  Reversing the direction and adding a half turn of phase gives the same height for a Gerstner wave travelling with positive angular frequency since sin(pi - a) = sin(a)
+GerstnerWave GerstnerWaves::FromSineWave(const SineWave& wave, const float timeScale, const float metresPerUnit) {
+
+	GerstnerWave w;
+
+	float length = sqrtf(wave.dir.x * wave.dir.x + wave.dir.y * wave.dir.y);
+
+	if (length > 0.0f)
+		w.direction = XMFLOAT2(-wave.dir.x / length, -wave.dir.y / length);
+
+	w.amplitude = wave.amp * metresPerUnit;
+	w.wavenumber = wave.freq * length / metresPerUnit;
+	w.angularFrequency = wave.phase * timeScale;
+	w.steepness = 0.0f;
+	w.phase = (float)(GERSTNER_TWO_PI * 0.5);
+
+	return w;
+}
+
+
+float GerstnerWaves::SineSumReference(const SineWave *waves, const uint32_t numWaves, const float x, const float z, const float t, XMFLOAT2 *gradient) {
+
+	float h = 0.0f;
+	float ddx = 0.0f;
+	float ddz = 0.0f;
+
+	for (uint32_t i = 0; i < numWaves; i++) {
+
+		float theta = (waves[i].dir.x * x + waves[i].dir.y * z) * waves[i].freq + t * waves[i].phase;
+		float deriv = waves[i].freq * waves[i].amp * cosf(theta);
+
+		h += waves[i].amp * sinf(theta);
+		ddx += deriv * waves[i].dir.x;
+		ddz += deriv * waves[i].dir.y;
+	}
+
+	if (gradient)
+		*gradient = XMFLOAT2(ddx, ddz);
+
+	return h;
+}
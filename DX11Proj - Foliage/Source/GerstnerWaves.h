@@ -0,0 +1,101 @@
+
+//
+// GerstnerWaves.h
+//
+
+// Sum of Gerstner (trochoidal) waves evaluated identically on the CPU and in ocean_vs.hlsl ("Effective Water Simulation From Physical Models", GPU Gems chapter 1).  The wave set is held in GerstnerWaveCBuffer, which has the layout of the gerstnerCBuffer declared in gerstner_waves.hlsli, so the structure the CPU evaluates is the structure uploaded to the shader.  setTime folds the time into the phase of each wave in double precision, so neither side loses precision as the game time grows.  Batched queries evaluate four points per SIMD operation and give the displacement, normal or the height of the displaced surface above arbitrary points (for buoyancy, camera clipping or foam placement).  Positions are in the space the waves are defined in (the ocean's wave space, in metres).  SineSumReference evaluates the sine-sum the ocean shader used before the waves were shared, so wave sets built with FromSineWave can be checked against it.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <cstdint>
+
+
+// Maximum number of waves (must match GERSTNER_MAX_WAVES in gerstner_waves.hlsli)
+#define GERSTNER_MAX_WAVES				8
+
+
+// Single wave.  The phase at point p and time t is theta = wavenumber * dot(direction, p) - angularFrequency * t + phase.  The surface point above p moves to p + steepness * amplitude * direction * cos(theta) horizontally and amplitude * sin(theta) vertically.  Crests become cusps where the sum of steepness * wavenumber * amplitude over the waves reaches 1
+struct GerstnerWave {
+
+	DirectX::XMFLOAT2					direction; // Unit direction of travel
+	float								amplitude;
+	float								wavenumber; // 2 pi / wavelength
+
+	float								angularFrequency; // 2 pi / period (sqrt(g * wavenumber) for deep water waves)
+	float								steepness; // 0 gives a sine wave
+	float								phase; // Phase at t = 0
+	float								timePhase; // Phase at the current time wrapped to [0, 2 pi).  Written by GerstnerWaves::setTime
+
+	GerstnerWave();
+	GerstnerWave(const DirectX::XMFLOAT2& initDirection, const float initAmplitude, const float wavelength, const float initSteepness, const float gravity = 9.81f);
+};
+
+
+// Wave set in the layout of gerstnerCBuffer.  Each wave occupies two 16 byte rows
+__declspec(align(16)) struct GerstnerWaveCBuffer {
+
+	GerstnerWave						waves[GERSTNER_MAX_WAVES];
+	uint32_t							numWaves;
+	float								padding[3];
+};
+
+
+// Wave of the sine-sum ocean shader: height = amp * sin(dot(dir, p) * freq + t * phase) where dir need not be unit length
+struct SineWave {
+
+	float								freq;
+	float								amp;
+	float								phase;
+	DirectX::XMFLOAT2					dir;
+};
+
+
+class GerstnerWaves : public GUObject {
+
+	GerstnerWaveCBuffer					constants;
+	double								time = 0.0;
+
+	// Displacement (dx, dy, dz) at 4 points and, if nx is given, the unnormalised normal (nx, ny, nz)
+	void evaluate4(DirectX::FXMVECTOR x, DirectX::FXMVECTOR z, DirectX::XMVECTOR *dx, DirectX::XMVECTOR *dy, DirectX::XMVECTOR *dz, DirectX::XMVECTOR *nx = nullptr, DirectX::XMVECTOR *ny = nullptr, DirectX::XMVECTOR *nz = nullptr) const;
+
+	// Run fn over count points four at a time.  The last partial group is padded so every point is evaluated by the same SIMD code
+	template <class Fn>
+	static void forEach4(const float *x, const float *z, const uint32_t count, Fn fn);
+
+public:
+
+	GerstnerWaves();
+
+	// Add a wave.  Returns false if the set is full
+	bool addWave(const GerstnerWave& wave);
+	void setWave(const uint32_t index, const GerstnerWave& wave);
+	void clear();
+
+	uint32_t waveCount() const;
+	const GerstnerWave& getWave(const uint32_t index) const;
+
+	// Set the time (in seconds) the waves are evaluated at
+	void setTime(const double t);
+	double getTime() const;
+
+	// Wave set to upload to gerstnerCBuffer
+	const GerstnerWaveCBuffer& getConstants() const;
+
+	// Largest horizontal and vertical displacement the waves can produce
+	DirectX::XMFLOAT2 getDisplacementBound() const;
+
+	// Batched queries over count points (x[i], z[i]) on the undisplaced plane.  Points are processed four at a time
+	void displacements(const float *x, const float *z, DirectX::XMFLOAT3 *displacementOut, const uint32_t count) const;
+	void normals(const float *x, const float *z, DirectX::XMFLOAT3 *normalOut, const uint32_t count) const;
+
+	// Height of the displaced surface directly above each point (x[i], z[i]).  The horizontal displacement is inverted by fixed-point iteration, which converges while the waves have no cusps
+	void surfaceHeights(const float *x, const float *z, float *heightOut, const uint32_t count, const uint32_t iterations = 4) const;
+
+	// Gerstner wave equivalent to a sine-sum wave evaluated at time t * timeScale.  The sine-sum positions are multiplied by metresPerUnit to give wave-space positions
+	static GerstnerWave FromSineWave(const SineWave& wave, const float timeScale = 1.0f, const float metresPerUnit = 1.0f);
+
+	// Scalar reference evaluation of the sine-sum height and its gradient at (x, z)
+	static float SineSumReference(const SineWave *waves, const uint32_t numWaves, const float x, const float z, const float t, DirectX::XMFLOAT2 *gradient = nullptr);
+};
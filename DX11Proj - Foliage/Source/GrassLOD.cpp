@@ -0,0 +1,116 @@
+
+//
+// GrassLOD.cpp
+//
+
+#include <stdafx.h>
+#include <GrassLOD.h>
+#include <DXFrustumCuller.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace DirectX;
+
+
+GrassLOD::GrassLOD() {
+
+	patchCuller = new DXFrustumCuller();
+}
+
+
+GrassLOD::~GrassLOD() {
+
+	if (patchCuller)
+		patchCuller->release();
+}
+
+
+void GrassLOD::setPatches(const DXBoundingVolume *patchVolumes, const uint32_t count) {
+
+	patchCuller->clear();
+
+	for (uint32_t i = 0; i < count; i++)
+		patchCuller->addVolume(patchVolumes[i]);
+
+	visiblePatches.resize(count);
+}
+
+
+void GrassLOD::setShellsPerPixel(const float s) {
+
+	shellsPerPixel = s;
+}
+
+
+void GrassLOD::setMinShells(const uint32_t n) {
+
+	minShells = max(n, (uint32_t)1);
+}
+
+
+void GrassLOD::setMinPatchPixels(const float p) {
+
+	minPatchPixels = p;
+}
+
+
+uint32_t GrassLOD::patchCount() const {
+
+	return patchCuller->volumeCount();
+}
+
+
+uint32_t GrassLOD::select(FXMMATRIX viewProj, FXMVECTOR eye, const float pixelScale, const uint32_t maxShells, const float shellExtent, vector<GrassPatchLOD>& patchLOD) {
+
+	patchLOD.clear();
+
+	if (maxShells == 0 || patchCuller->volumeCount() == 0)
+		return 0;
+
+	patchCuller->setViewProjection(viewProj);
+
+	uint32_t numVisible = patchCuller->cullBoxes(visiblePatches.data());
+	uint32_t totalShells = 0;
+
+	for (uint32_t i = 0; i < numVisible; i++) {
+
+		DXBoundingVolume B = patchCuller->getVolume(visiblePatches[i]);
+
+		XMVECTOR C = XMLoadFloat3(&B.centre);
+		XMVECTOR E = XMLoadFloat3(&B.extents);
+
+		// Distance from the eye to the nearest point of the patch box and to its centre
+		XMVECTOR nearestPoint = XMVectorClamp(eye, XMVectorSubtract(C, E), XMVectorAdd(C, E));
+		float boxDist = max(XMVectorGetX(XMVector3Length(XMVectorSubtract(eye, nearestPoint))), 1e-3f);
+		float centreDist = max(XMVectorGetX(XMVector3Length(XMVectorSubtract(eye, C))), B.radius);
+
+		GrassPatchLOD lod;
+
+		lod.patch = visiblePatches[i];
+
+		if (B.radius * pixelScale / centreDist < minPatchPixels) {
+
+			// Patch covers too little of the screen for the shells to be seen
+			lod.numShells = 1;
+			lod.shellStride = maxShells;
+		}
+		else {
+
+			// Number of shells needed for the stack's projected size at the nearest point of the patch
+			float stackPixels = shellExtent * pixelScale / boxDist;
+			uint32_t n = (uint32_t)min(ceilf(stackPixels * shellsPerPixel), (float)maxShells);
+
+			n = min(max(n, minShells), maxShells);
+
+			// Spread the shells evenly over the full stack
+			lod.shellStride = (maxShells + n - 1) / n;
+			lod.numShells = (maxShells + lod.shellStride - 1) / lod.shellStride;
+		}
+
+		totalShells += lod.numShells;
+		patchLOD.push_back(lod);
+	}
+
+	return totalShells;
+}
@@ -0,0 +1,70 @@
+
+//
+// GrassLOD.h
+//
+
+// View-dependent level of detail for the shell (fur) rendered grass.  The ground is divided into patches (the terrain chunks selected for the frame) and every patch is tested against the view frustum and given a number of shells from its distance to the camera and its projected size on screen.  Distant patches draw every n'th shell of the full stack (shellStride) so the stack keeps its height while the fill and vertex cost fall with distance, and patches too small to resolve any shells draw only the base layer.  Selection is done entirely on the CPU and does not depend on Direct3D.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <DXBoundingVolume.h>
+#include <vector>
+#include <cstdint>
+
+class DXFrustumCuller;
+
+
+// Number of shells drawn for each pixel the shell stack covers on screen
+#define GRASS_SHELLS_PER_PIXEL		4.0f
+
+// Minimum number of shells drawn for any patch that resolves at least one shell
+#define GRASS_MIN_SHELLS			4
+
+// Patches whose projected radius (in pixels) is smaller than this draw only the base layer
+#define GRASS_MIN_PATCH_PIXELS		8.0f
+
+
+// Level of detail selected for a visible patch
+struct GrassPatchLOD {
+
+	uint32_t							patch; // Patch index in the order of the volumes passed to GrassLOD::setPatches
+	uint32_t							numShells; // Number of shells drawn including the base layer
+	uint32_t							shellStride; // Draw shells 0, shellStride, 2 * shellStride... of the full stack
+
+	// Return true if shell i of the full stack is drawn for this patch
+	bool drawsShell(const uint32_t i) const {
+
+		return (i % shellStride == 0) && (i / shellStride < numShells);
+	}
+};
+
+
+class GrassLOD : public GUObject {
+
+	// World-space bounds of each patch
+	DXFrustumCuller						*patchCuller = nullptr;
+	std::vector<uint32_t>				visiblePatches;
+
+	float								shellsPerPixel = GRASS_SHELLS_PER_PIXEL;
+	uint32_t							minShells = GRASS_MIN_SHELLS;
+	float								minPatchPixels = GRASS_MIN_PATCH_PIXELS;
+
+public:
+
+	GrassLOD();
+	~GrassLOD();
+
+	// Setup the world-space patch bounds.  Patch indices used by select() refer to the order of patchVolumes
+	void setPatches(const DXBoundingVolume *patchVolumes, const uint32_t count);
+
+	void setShellsPerPixel(const float s);
+	void setMinShells(const uint32_t n);
+	void setMinPatchPixels(const float p);
+
+	uint32_t patchCount() const;
+
+	// Select the visible patches and their level of detail for the current view.  eye is the world-space camera position, pixelScale is the height in pixels of an object 1 unit high at a distance of 1 unit (projMatrix._22 * viewport height / 2), maxShells is the size of the full shell stack and shellExtent the world-space distance spanned by the stack.  Visible patches are written to patchLOD in ascending patch order and the total number of patch shells to draw is returned
+	uint32_t select(DirectX::FXMMATRIX viewProj, DirectX::FXMVECTOR eye, const float pixelScale, const uint32_t maxShells, const float shellExtent, std::vector<GrassPatchLOD>& patchLOD);
+};
@@ -0,0 +1,603 @@
+
+//
+// HeightField.cpp
+//
+
+#include <stdafx.h>
+#include <HeightField.h>
+#include <GUBitmap.h>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Catmull-Rom weights and their derivatives for the four samples around fractional position t
+static inline void catmullRomWeights(const float t, float *w, float *dw) {
+
+	float t2 = t * t;
+	float t3 = t2 * t;
+
+	w[0] = 0.5f * (-t + 2.0f * t2 - t3);
+	w[1] = 0.5f * (2.0f - 5.0f * t2 + 3.0f * t3);
+	w[2] = 0.5f * (t + 4.0f * t2 - 3.0f * t3);
+	w[3] = 0.5f * (-t2 + t3);
+
+	dw[0] = 0.5f * (-1.0f + 4.0f * t - 3.0f * t2);
+	dw[1] = 0.5f * (-10.0f * t + 9.0f * t2);
+	dw[2] = 0.5f * (1.0f + 8.0f * t - 9.0f * t2);
+	dw[3] = 0.5f * (-2.0f * t + 3.0f * t2);
+}
+
+
+// Bilinearly interpolated values of four heightmap coordinates.  The coordinate arithmetic and interpolation are done four-wide and the sixteen corner samples are gathered with scalar loads
+static inline XMVECTOR bilinear4(const float *values, const uint32_t width, const uint32_t height, FXMVECTOR qx, FXMVECTOR qz) {
+
+	XMVECTOR x = XMVectorClamp(qx, XMVectorZero(), XMVectorReplicate((float)(width - 1)));
+	XMVECTOR z = XMVectorClamp(qz, XMVectorZero(), XMVectorReplicate((float)(height - 1)));
+
+	XMVECTOR x0 = XMVectorFloor(x);
+	XMVECTOR z0 = XMVectorFloor(z);
+
+	XMFLOAT4A ix, iz;
+
+	XMStoreFloat4A(&ix, x0);
+	XMStoreFloat4A(&iz, z0);
+
+	XMFLOAT4A h00, h01, h10, h11;
+
+	float *p00 = &h00.x, *p01 = &h01.x, *p10 = &h10.x, *p11 = &h11.x;
+	const float *px = &ix.x, *pz = &iz.x;
+
+	for (int k = 0; k < 4; k++) {
+
+		uint32_t xi = (uint32_t)px[k];
+		uint32_t zi = (uint32_t)pz[k];
+		uint32_t xi1 = min(xi + 1, width - 1);
+		uint32_t zi1 = min(zi + 1, height - 1);
+
+		p00[k] = values[zi * width + xi];
+		p01[k] = values[zi * width + xi1];
+		p10[k] = values[zi1 * width + xi];
+		p11[k] = values[zi1 * width + xi1];
+	}
+
+	XMVECTOR fx = XMVectorSubtract(x, x0);
+	XMVECTOR fz = XMVectorSubtract(z, z0);
+
+	XMVECTOR h0 = XMVectorLerpV(XMLoadFloat4A(&h00), XMLoadFloat4A(&h01), fx);
+	XMVECTOR h1 = XMVectorLerpV(XMLoadFloat4A(&h10), XMLoadFloat4A(&h11), fx);
+
+	return XMVectorLerpV(h0, h1, fz);
+}
+
+
+// Two-sided ray / triangle intersection (Moller-Trumbore).  Returns true and the distance t along the ray if the ray hits triangle (V0, V1, V2)
+static bool intersectTriangle(FXMVECTOR O, FXMVECTOR D, FXMVECTOR V0, GXMVECTOR V1, HXMVECTOR V2, float *t) {
+
+	XMVECTOR e1 = XMVectorSubtract(V1, V0);
+	XMVECTOR e2 = XMVectorSubtract(V2, V0);
+
+	XMVECTOR P = XMVector3Cross(D, e2);
+	float det = XMVectorGetX(XMVector3Dot(e1, P));
+
+	if (fabsf(det) < 1e-12f)
+		return false;
+
+	float invDet = 1.0f / det;
+
+	XMVECTOR T = XMVectorSubtract(O, V0);
+	float u = XMVectorGetX(XMVector3Dot(T, P)) * invDet;
+
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	XMVECTOR Q = XMVector3Cross(T, e1);
+	float v = XMVectorGetX(XMVector3Dot(D, Q)) * invDet;
+
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	*t = XMVectorGetX(XMVector3Dot(e2, Q)) * invDet;
+
+	return true;
+}
+
+
+
+HeightField::HeightField(const string& heightmapFilename, const XMFLOAT3& initOrigin, const XMFLOAT2& size, const float initHeightScale) {
+
+	GUBitmap *heightmap = new GUBitmap(heightmapFilename);
+
+	setup(heightmap->getValues().data(), heightmap->getWidth(), heightmap->getHeight(), initOrigin, size, initHeightScale);
+
+	heightmap->release();
+}
+
+
+HeightField::HeightField(const float *heightValues, const uint32_t width, const uint32_t height, const XMFLOAT3& initOrigin, const XMFLOAT2& size, const float initHeightScale) {
+
+	setup(heightValues, width, height, initOrigin, size, initHeightScale);
+}
+
+
+void HeightField::setup(const float *heightValues, const uint32_t width, const uint32_t height, const XMFLOAT3& initOrigin, const XMFLOAT2& size, const float initHeightScale) {
+
+	mapWidth = (heightValues && width && height) ? width : 0;
+	mapHeight = (heightValues && width && height) ? height : 0;
+
+	origin = initOrigin;
+	heightScale = initHeightScale;
+
+	if (mapWidth && mapHeight) {
+
+		values.assign(heightValues, heightValues + mapWidth * mapHeight);
+
+		// Quads span the whole map (as in TerrainQuadtree) so the last row and column of samples cover the last quad
+		quadSize = XMFLOAT2(size.x / mapWidth, size.y / mapHeight);
+		invQuadSize = XMFLOAT2(1.0f / quadSize.x, 1.0f / quadSize.y);
+
+		auto range = minmax_element(values.begin(), values.end());
+
+		minHeight = origin.y + *range.first * heightScale;
+		maxHeight = origin.y + *range.second * heightScale;
+
+	} else {
+
+		// An empty heightfield is a flat plane at origin.y
+		values.assign(1, 0.0f);
+		mapWidth = mapHeight = 1;
+
+		quadSize = size;
+		invQuadSize = XMFLOAT2((size.x != 0.0f) ? 1.0f / size.x : 0.0f, (size.y != 0.0f) ? 1.0f / size.y : 0.0f);
+
+		minHeight = maxHeight = origin.y;
+	}
+
+	bounds = DXBoundingVolume(XMFLOAT3(origin.x + size.x * 0.5f, (minHeight + maxHeight) * 0.5f, origin.z + size.y * 0.5f), XMFLOAT3(size.x * 0.5f, (maxHeight - minHeight) * 0.5f, size.y * 0.5f));
+}
+
+
+float HeightField::sample(const int x, const int z) const {
+
+	int xi = min(max(x, 0), (int)mapWidth - 1);
+	int zi = min(max(z, 0), (int)mapHeight - 1);
+
+	return values[zi * mapWidth + xi];
+}
+
+
+float HeightField::bilinear(const float qx, const float qz) const {
+
+	float x = min(max(qx, 0.0f), (float)(mapWidth - 1));
+	float z = min(max(qz, 0.0f), (float)(mapHeight - 1));
+
+	float x0 = floorf(x);
+	float z0 = floorf(z);
+
+	uint32_t xi = (uint32_t)x0;
+	uint32_t zi = (uint32_t)z0;
+	uint32_t xi1 = min(xi + 1, mapWidth - 1);
+	uint32_t zi1 = min(zi + 1, mapHeight - 1);
+
+	float fx = x - x0;
+	float fz = z - z0;
+
+	float h00 = values[zi * mapWidth + xi];
+	float h01 = values[zi * mapWidth + xi1];
+	float h10 = values[zi1 * mapWidth + xi];
+	float h11 = values[zi1 * mapWidth + xi1];
+
+	float h0 = h00 + fx * (h01 - h00);
+	float h1 = h10 + fx * (h11 - h10);
+
+	return h0 + fz * (h1 - h0);
+}
+
+
+float HeightField::height(const float x, const float z) const {
+
+	return origin.y + bilinear((x - origin.x) * invQuadSize.x, (z - origin.z) * invQuadSize.y) * heightScale;
+}
+
+
+float HeightField::heightBicubic(const float x, const float z) const {
+
+	float qx = min(max((x - origin.x) * invQuadSize.x, 0.0f), (float)(mapWidth - 1));
+	float qz = min(max((z - origin.z) * invQuadSize.y, 0.0f), (float)(mapHeight - 1));
+
+	int x0 = (int)floorf(qx);
+	int z0 = (int)floorf(qz);
+
+	float wx[4], wz[4], dwx[4], dwz[4];
+
+	catmullRomWeights(qx - x0, wx, dwx);
+	catmullRomWeights(qz - z0, wz, dwz);
+
+	float h = 0.0f;
+
+	for (int j = 0; j < 4; j++) {
+
+		float row = 0.0f;
+
+		for (int i = 0; i < 4; i++)
+			row += wx[i] * sample(x0 - 1 + i, z0 - 1 + j);
+
+		h += wz[j] * row;
+	}
+
+	return origin.y + h * heightScale;
+}
+
+
+XMVECTOR HeightField::normal(const float x, const float z) const {
+
+	float qx = (x - origin.x) * invQuadSize.x;
+	float qz = (z - origin.z) * invQuadSize.y;
+
+	float hL = bilinear(qx - 1.0f, qz);
+	float hR = bilinear(qx + 1.0f, qz);
+	float hD = bilinear(qx, qz - 1.0f);
+	float hU = bilinear(qx, qz + 1.0f);
+
+	return XMVector3Normalize(XMVectorSet((hL - hR) * heightScale * 0.5f * invQuadSize.x, 1.0f, (hD - hU) * heightScale * 0.5f * invQuadSize.y, 0.0f));
+}
+
+
+XMVECTOR HeightField::normalBicubic(const float x, const float z) const {
+
+	float qx = min(max((x - origin.x) * invQuadSize.x, 0.0f), (float)(mapWidth - 1));
+	float qz = min(max((z - origin.z) * invQuadSize.y, 0.0f), (float)(mapHeight - 1));
+
+	int x0 = (int)floorf(qx);
+	int z0 = (int)floorf(qz);
+
+	float wx[4], wz[4], dwx[4], dwz[4];
+
+	catmullRomWeights(qx - x0, wx, dwx);
+	catmullRomWeights(qz - z0, wz, dwz);
+
+	// Gradient of the normalised surface with respect to heightmap coordinates
+	float dhdx = 0.0f, dhdz = 0.0f;
+
+	for (int j = 0; j < 4; j++) {
+
+		float row = 0.0f, drow = 0.0f;
+
+		for (int i = 0; i < 4; i++) {
+
+			float s = sample(x0 - 1 + i, z0 - 1 + j);
+
+			row += wx[i] * s;
+			drow += dwx[i] * s;
+		}
+
+		dhdx += wz[j] * drow;
+		dhdz += dwz[j] * row;
+	}
+
+	return XMVector3Normalize(XMVectorSet(-dhdx * heightScale * invQuadSize.x, 1.0f, -dhdz * heightScale * invQuadSize.y, 0.0f));
+}
+
+
+void HeightField::heights(const float *x, const float *z, float *heightOut, const uint32_t count) const {
+
+	XMVECTOR ox = XMVectorReplicate(origin.x);
+	XMVECTOR oz = XMVectorReplicate(origin.z);
+	XMVECTOR sx = XMVectorReplicate(invQuadSize.x);
+	XMVECTOR sz = XMVectorReplicate(invQuadSize.y);
+	XMVECTOR oy = XMVectorReplicate(origin.y);
+	XMVECTOR hs = XMVectorReplicate(heightScale);
+
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+
+		XMVECTOR qx = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)(x + i)), ox), sx);
+		XMVECTOR qz = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)(z + i)), oz), sz);
+
+		XMVECTOR h = bilinear4(values.data(), mapWidth, mapHeight, qx, qz);
+
+		XMStoreFloat4((XMFLOAT4*)(heightOut + i), XMVectorAdd(oy, XMVectorMultiply(h, hs)));
+	}
+
+	for (; i < count; i++)
+		heightOut[i] = height(x[i], z[i]);
+}
+
+
+void HeightField::normals(const float *x, const float *z, XMFLOAT3 *normalOut, const uint32_t count) const {
+
+	XMVECTOR ox = XMVectorReplicate(origin.x);
+	XMVECTOR oz = XMVectorReplicate(origin.z);
+	XMVECTOR sx = XMVectorReplicate(invQuadSize.x);
+	XMVECTOR sz = XMVectorReplicate(invQuadSize.y);
+	XMVECTOR kx = XMVectorReplicate(heightScale * 0.5f * invQuadSize.x);
+	XMVECTOR kz = XMVectorReplicate(heightScale * 0.5f * invQuadSize.y);
+	XMVECTOR one = XMVectorSplatOne();
+
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+
+		XMVECTOR qx = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)(x + i)), ox), sx);
+		XMVECTOR qz = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)(z + i)), oz), sz);
+
+		XMVECTOR hL = bilinear4(values.data(), mapWidth, mapHeight, XMVectorSubtract(qx, one), qz);
+		XMVECTOR hR = bilinear4(values.data(), mapWidth, mapHeight, XMVectorAdd(qx, one), qz);
+		XMVECTOR hD = bilinear4(values.data(), mapWidth, mapHeight, qx, XMVectorSubtract(qz, one));
+		XMVECTOR hU = bilinear4(values.data(), mapWidth, mapHeight, qx, XMVectorAdd(qz, one));
+
+		// Normalise the four <nx, 1, nz> vectors in SoA form
+		XMVECTOR nx = XMVectorMultiply(XMVectorSubtract(hL, hR), kx);
+		XMVECTOR nz = XMVectorMultiply(XMVectorSubtract(hD, hU), kz);
+		XMVECTOR invLength = XMVectorReciprocalSqrt(XMVectorAdd(XMVectorMultiplyAdd(nx, nx, one), XMVectorMultiply(nz, nz)));
+
+		XMFLOAT4A rx, ry, rz;
+
+		XMStoreFloat4A(&rx, XMVectorMultiply(nx, invLength));
+		XMStoreFloat4A(&ry, invLength);
+		XMStoreFloat4A(&rz, XMVectorMultiply(nz, invLength));
+
+		normalOut[i] = XMFLOAT3(rx.x, ry.x, rz.x);
+		normalOut[i + 1] = XMFLOAT3(rx.y, ry.y, rz.y);
+		normalOut[i + 2] = XMFLOAT3(rx.z, ry.z, rz.z);
+		normalOut[i + 3] = XMFLOAT3(rx.w, ry.w, rz.w);
+	}
+
+	for (; i < count; i++)
+		XMStoreFloat3(&normalOut[i], normal(x[i], z[i]));
+}
+
+
+bool HeightField::intersectCell(const uint32_t cx, const uint32_t cz, FXMVECTOR rayOrigin, FXMVECTOR rayDir, const float tmin, const float tmax, float *t) const {
+
+	// Cell corners in world space.  The diagonal runs from (cx + 1, cz) to (cx, cz + 1) as in the terrain grid mesh
+	float x0 = origin.x + cx * quadSize.x;
+	float x1 = x0 + quadSize.x;
+	float z0 = origin.z + cz * quadSize.y;
+	float z1 = z0 + quadSize.y;
+
+	XMVECTOR V00 = XMVectorSet(x0, origin.y + sample(cx, cz) * heightScale, z0, 0.0f);
+	XMVECTOR V01 = XMVectorSet(x1, origin.y + sample(cx + 1, cz) * heightScale, z0, 0.0f);
+	XMVECTOR V10 = XMVectorSet(x0, origin.y + sample(cx, cz + 1) * heightScale, z1, 0.0f);
+	XMVECTOR V11 = XMVectorSet(x1, origin.y + sample(cx + 1, cz + 1) * heightScale, z1, 0.0f);
+
+	float tHit = FLT_MAX, t0;
+
+	if (intersectTriangle(rayOrigin, rayDir, V00, V10, V01, &t0) && t0 >= tmin && t0 <= tmax)
+		tHit = t0;
+
+	if (intersectTriangle(rayOrigin, rayDir, V01, V10, V11, &t0) && t0 >= tmin && t0 <= tmax)
+		tHit = min(tHit, t0);
+
+	if (tHit == FLT_MAX)
+		return false;
+
+	*t = tHit;
+
+	return true;
+}
+
+
+// Walk the heightmap cells crossed by the ray (2D DDA) and test the two triangles of each cell the ray passes low enough to hit.  Cells are visited in order along the ray so the first hit is the nearest
+bool HeightField::raycast(FXMVECTOR rayOrigin, FXMVECTOR rayDir, const float maxDist, float *t) const {
+
+	if (mapWidth < 2 || mapHeight < 2)
+		return false;
+
+	XMFLOAT3 O, D;
+
+	XMStoreFloat3(&O, rayOrigin);
+	XMStoreFloat3(&D, rayDir);
+
+	// Ray in heightmap coordinates (y stays in world space).  The distance t along the ray is unchanged
+	float ox = (O.x - origin.x) * invQuadSize.x;
+	float oz = (O.z - origin.z) * invQuadSize.y;
+	float dx = D.x * invQuadSize.x;
+	float dz = D.z * invQuadSize.y;
+
+	// Clip the ray to the box holding the surface
+	float tEnter = 0.0f, tExit = maxDist;
+
+	const float slabOrigin[3] = { ox, O.y, oz };
+	const float slabDir[3] = { dx, D.y, dz };
+	const float slabMin[3] = { 0.0f, minHeight, 0.0f };
+	const float slabMax[3] = { (float)(mapWidth - 1), maxHeight, (float)(mapHeight - 1) };
+
+	for (int k = 0; k < 3; k++) {
+
+		if (fabsf(slabDir[k]) < 1e-12f) {
+
+			if (slabOrigin[k] < slabMin[k] || slabOrigin[k] > slabMax[k])
+				return false;
+
+			continue;
+		}
+
+		float t0 = (slabMin[k] - slabOrigin[k]) / slabDir[k];
+		float t1 = (slabMax[k] - slabOrigin[k]) / slabDir[k];
+
+		if (t0 > t1)
+			swap(t0, t1);
+
+		tEnter = max(tEnter, t0);
+		tExit = min(tExit, t1);
+
+		if (tEnter > tExit)
+			return false;
+	}
+
+	int lastX = (int)mapWidth - 2;
+	int lastZ = (int)mapHeight - 2;
+
+	int cx = min(max((int)floorf(ox + tEnter * dx), 0), lastX);
+	int cz = min(max((int)floorf(oz + tEnter * dz), 0), lastZ);
+
+	int stepX = (dx > 0.0f) ? 1 : -1;
+	int stepZ = (dz > 0.0f) ? 1 : -1;
+
+	float tDeltaX = (dx != 0.0f) ? fabsf(1.0f / dx) : FLT_MAX;
+	float tDeltaZ = (dz != 0.0f) ? fabsf(1.0f / dz) : FLT_MAX;
+
+	float tMaxX = (dx != 0.0f) ? ((float)(cx + ((dx > 0.0f) ? 1 : 0)) - ox) / dx : FLT_MAX;
+	float tMaxZ = (dz != 0.0f) ? ((float)(cz + ((dz > 0.0f) ? 1 : 0)) - oz) / dz : FLT_MAX;
+
+	// Allow for rounding where the ray crosses cell edges
+	const float tEpsilon = 1e-4f * max(quadSize.x, quadSize.y);
+
+	float tCell = tEnter;
+
+	while (tCell <= tExit) {
+
+		float tNext = min(min(tMaxX, tMaxZ), tExit);
+
+		// Skip the cell if the ray stays above its highest corner
+		float cellMax = max(max(sample(cx, cz), sample(cx + 1, cz)), max(sample(cx, cz + 1), sample(cx + 1, cz + 1)));
+		float rayMin = min(O.y + tCell * D.y, O.y + tNext * D.y);
+
+		if (rayMin <= origin.y + cellMax * heightScale && intersectCell(cx, cz, rayOrigin, rayDir, max(tCell - tEpsilon, 0.0f), min(tNext + tEpsilon, maxDist), t))
+			return true;
+
+		if (tMaxX < tMaxZ) {
+
+			cx += stepX;
+			tCell = tMaxX;
+			tMaxX += tDeltaX;
+
+		} else {
+
+			cz += stepZ;
+			tCell = tMaxZ;
+			tMaxZ += tDeltaZ;
+		}
+
+		if (cx < 0 || cx > lastX || cz < 0 || cz > lastZ || tCell == FLT_MAX)
+			break;
+	}
+
+	return false;
+}
+
+
+void HeightField::buildOccluderMesh(const uint32_t resolution, vector<XMFLOAT3>& positions, vector<uint32_t>& indices) const {
+
+	positions.clear();
+	indices.clear();
+
+	if (resolution == 0)
+		return;
+
+	uint32_t n = resolution + 1;
+
+	positions.resize(n * n);
+	indices.reserve(resolution * resolution * 6);
+
+	// Heightmap coordinate of occluder grid line i
+	float stepX = (float)(mapWidth - 1) / resolution;
+	float stepZ = (float)(mapHeight - 1) / resolution;
+
+	for (uint32_t i = 0; i < n; i++) {
+
+		// Samples in the occluder cells either side of the vertex
+		int z0 = (int)floorf(((i > 0) ? i - 1 : 0) * stepZ);
+		int z1 = (int)ceilf(min(i + 1, resolution) * stepZ);
+
+		for (uint32_t j = 0; j < n; j++) {
+
+			int x0 = (int)floorf(((j > 0) ? j - 1 : 0) * stepX);
+			int x1 = (int)ceilf(min(j + 1, resolution) * stepX);
+
+			float h = FLT_MAX;
+
+			for (int z = z0; z <= z1; z++) {
+
+				for (int x = x0; x <= x1; x++)
+					h = min(h, sample(x, z));
+			}
+
+			positions[i * n + j] = XMFLOAT3(origin.x + j * stepX * quadSize.x, origin.y + h * heightScale, origin.z + i * stepZ * quadSize.y);
+		}
+	}
+
+	for (uint32_t i = 0; i < resolution; i++) {
+
+		for (uint32_t j = 0; j < resolution; j++) {
+
+			uint32_t v00 = i * n + j;
+			uint32_t v01 = v00 + 1;
+			uint32_t v10 = v00 + n;
+			uint32_t v11 = v10 + 1;
+
+			indices.push_back(v00);
+			indices.push_back(v10);
+			indices.push_back(v01);
+
+			indices.push_back(v01);
+			indices.push_back(v10);
+			indices.push_back(v11);
+		}
+	}
+}
+
+
+uint32_t HeightField::getMapWidth() const {
+
+	return mapWidth;
+}
+
+
+uint32_t HeightField::getMapHeight() const {
+
+	return mapHeight;
+}
+
+
+const vector<float>& HeightField::getValues() const {
+
+	return values;
+}
+
+
+XMFLOAT3 HeightField::getOrigin() const {
+
+	return origin;
+}
+
+
+XMFLOAT2 HeightField::getSize() const {
+
+	return XMFLOAT2(quadSize.x * mapWidth, quadSize.y * mapHeight);
+}
+
+
+XMFLOAT2 HeightField::getQuadSize() const {
+
+	return quadSize;
+}
+
+
+float HeightField::getHeightScale() const {
+
+	return heightScale;
+}
+
+
+float HeightField::getMinHeight() const {
+
+	return minHeight;
+}
+
+
+float HeightField::getMaxHeight() const {
+
+	return maxHeight;
+}
+
+
+const DXBoundingVolume& HeightField::getBounds() const {
+
+	return bounds;
+}
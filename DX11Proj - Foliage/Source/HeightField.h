@@ -0,0 +1,91 @@
+
+//
+// HeightField.h
+//
+
+// CPU copy of the terrain heightmap for gameplay and placement queries.  The heightfield uses the same world-space mapping as TerrainQuadtree and terrain_vs.hlsl - heightmap sample (x, z) lies at origin + <x * quadSize.x, h * heightScale, z * quadSize.y> - so bilinear queries return the height of the surface drawn at full detail.  Single point queries are provided for bilinear and bicubic (Catmull-Rom) heights and normals, batched queries evaluate four points per SIMD operation over arrays of x and z coordinates and rays are intersected with the triangulated surface by walking the heightmap cells along the ray.  All queries take world-space coordinates and clamp them to the edges of the heightmap.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <DXBoundingVolume.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+class HeightField : public GUObject {
+
+	// Normalised heightmap values (row-major, row index = z)
+	uint32_t							mapWidth = 0;
+	uint32_t							mapHeight = 0;
+	std::vector<float>					values;
+
+	// World-space mapping
+	DirectX::XMFLOAT3					origin;
+	DirectX::XMFLOAT2					quadSize;
+	DirectX::XMFLOAT2					invQuadSize;
+	float								heightScale = 1.0f;
+
+	// World-space height range of the samples
+	float								minHeight = 0.0f;
+	float								maxHeight = 0.0f;
+
+	DXBoundingVolume					bounds;
+
+	void setup(const float *heightValues, const uint32_t width, const uint32_t height, const DirectX::XMFLOAT3& initOrigin, const DirectX::XMFLOAT2& size, const float initHeightScale);
+
+	// Normalised value of sample (x, z) clamped to the heightmap
+	float sample(const int x, const int z) const;
+
+	// Bilinearly interpolated normalised value at heightmap coordinate (qx, qz)
+	float bilinear(const float qx, const float qz) const;
+
+	// Return true and the distance t along the ray if the ray hits either triangle of cell (cx, cz) within [tmin, tmax]
+	bool intersectCell(const uint32_t cx, const uint32_t cz, DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir, const float tmin, const float tmax, float *t) const;
+
+public:
+
+	// Load the heightfield from the heightmap bitmap heightmapFilename covering size.x by size.y world units from origin.  Heights are scaled from [0, 1] to [origin.y, origin.y + heightScale]
+	HeightField(const std::string& heightmapFilename, const DirectX::XMFLOAT3& initOrigin, const DirectX::XMFLOAT2& size, const float initHeightScale);
+
+	// Build the heightfield from a width x height array of values in [0, 1]
+	HeightField(const float *heightValues, const uint32_t width, const uint32_t height, const DirectX::XMFLOAT3& initOrigin, const DirectX::XMFLOAT2& size, const float initHeightScale);
+
+	// Bilinearly interpolated world-space height at world-space (x, z).  This matches the terrain mesh at full detail
+	float height(const float x, const float z) const;
+
+	// Bicubic (Catmull-Rom) world-space height at world-space (x, z).  The surface passes through the samples and has a continuous gradient between cells
+	float heightBicubic(const float x, const float z) const;
+
+	// Unit surface normal at world-space (x, z) from the central differences of the bilinear heights one heightmap quad either side.  This matches terrain_vs.hlsl
+	DirectX::XMVECTOR normal(const float x, const float z) const;
+
+	// Unit surface normal at world-space (x, z) from the analytic gradient of the bicubic surface
+	DirectX::XMVECTOR normalBicubic(const float x, const float z) const;
+
+	// Batched queries over count points with world-space coordinates (x[i], z[i]).  Points are processed four at a time.  The results are identical to height() and normal()
+	void heights(const float *x, const float *z, float *heightOut, const uint32_t count) const;
+	void normals(const float *x, const float *z, DirectX::XMFLOAT3 *normalOut, const uint32_t count) const;
+
+	// Intersect the world-space ray rayOrigin + t * rayDir (t in [0, maxDist]) with the triangulated surface.  Returns true and the nearest t if the ray hits the terrain
+	bool raycast(DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir, const float maxDist, float *t) const;
+
+	// Build a resolution x resolution quad mesh over the heightfield whose vertex heights are the minimum of the samples in the cells around them.  The mesh lies on or below the full detail surface so it can be used as a conservative occluder (see DXOcclusionCuller::rasteriseOccluder)
+	void buildOccluderMesh(const uint32_t resolution, std::vector<DirectX::XMFLOAT3>& positions, std::vector<uint32_t>& indices) const;
+
+	uint32_t getMapWidth() const;
+	uint32_t getMapHeight() const;
+
+	// Return the normalised heightmap values (getMapWidth() * getMapHeight(), row-major)
+	const std::vector<float>& getValues() const;
+
+	DirectX::XMFLOAT3 getOrigin() const;
+	DirectX::XMFLOAT2 getSize() const;
+	DirectX::XMFLOAT2 getQuadSize() const;
+	float getHeightScale() const;
+	float getMinHeight() const;
+	float getMaxHeight() const;
+	const DXBoundingVolume& getBounds() const;
+};
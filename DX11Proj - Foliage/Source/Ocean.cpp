@@ -1,9 +1,14 @@
 
 #include <stdafx.h>
 #include <Ocean.h>
+#include <OceanSpectrum.h>
+#include <GerstnerWaves.h>
+#include <OceanGrid.h>
+#include <buffers.h>
 #include <DXVertexExt.h>
 #include <iostream>
 #include <exception>
+#include <vector>
 #include <DXBlob.h>
 
 using namespace std;
@@ -11,10 +16,26 @@ using namespace DirectX;
 using namespace DirectX::PackedVector;
 
 
+// Copy numRows rows of rowBytes bytes to a dynamic texture.  The row pitch of the mapped texture is chosen by the driver and can be larger than rowBytes
+static void writeTexture(ID3D11DeviceContext *context, ID3D11Texture2D *texture, const void *src, const size_t rowBytes, const uint32_t numRows) {
 
+	D3D11_MAPPED_SUBRESOURCE res;
 
+	HRESULT hr = context->Map(texture, 0, D3D11_MAP_WRITE_DISCARD, 0, &res);
 
-Ocean::Ocean(ID3D11Device *device, DXBlob *vsBytecode, ID3D11ShaderResourceView *tex_view) {
+	if (!SUCCEEDED(hr))
+		return;
+
+	for (uint32_t i = 0; i < numRows; i++)
+		memcpy((uint8_t*)res.pData + i * res.RowPitch, (const uint8_t*)src + i * rowBytes, rowBytes);
+
+	context->Unmap(texture, 0);
+}
+
+
+
+
+Ocean::Ocean(ID3D11Device *device, DXBlob *vsBytecode, ID3D11ShaderResourceView *tex_view, const OceanSpectrum *spectrum, const float metresPerUnit, const GerstnerWaves *waves, const OceanGrid *grid) {
 	diffuse = XMCOLOR(1.0f, 1.0f, 1.0f, 1.0f);	// BGRA
 	spec = XMCOLOR(0.0f, 0.0f, 0.0f, 0.0f);// specular power = a * 1000.0
 	try
@@ -38,6 +59,25 @@ Ocean::Ocean(ID3D11Device *device, DXBlob *vsBytecode, ID3D11ShaderResourceView
 			}
 		}
 
+		// Pad the flat grid by the largest displacement the wave maps can apply in ocean_vs
+		XMFLOAT3 pad(0.0f, 0.0f, 0.0f);
+
+		if (spectrum) {
+
+			XMFLOAT3 displacementBound = spectrum->getDisplacementBound();
+			pad = XMFLOAT3(displacementBound.x / metresPerUnit, displacementBound.y / metresPerUnit, displacementBound.z / metresPerUnit);
+		}
+
+		if (waves) {
+
+			XMFLOAT2 waveBound = waves->getDisplacementBound();
+
+			pad = XMFLOAT3(pad.x + waveBound.x / metresPerUnit, pad.y + waveBound.y / metresPerUnit, pad.z + waveBound.x / metresPerUnit);
+		}
+
+		surfaceBounds = DXBoundingVolume::FromPoints(&(vertices[0].pos), W_WIDTH*W_HEIGHT, sizeof(DXVertexExt));
+		bounds = DXBoundingVolume(surfaceBounds.centre, XMFLOAT3(surfaceBounds.extents.x + pad.x, pad.y, surfaceBounds.extents.z + pad.z));
+
 
 		if (!device || !vsBytecode)
 			throw exception("Invalid parameters for triangle model instantiation");
@@ -125,7 +165,148 @@ Ocean::Ocean(ID3D11Device *device, DXBlob *vsBytecode, ID3D11ShaderResourceView
 		hr = device->CreateSamplerState(&samplerDesc, &cubeMapSampler);
 
 
+		// Wave maps sampled in the vertex shader.  They are rewritten every frame so they are dynamic
+		if (spectrum && spectrum->size() > 0) {
+
+			mapSize = spectrum->size();
+
+			D3D11_TEXTURE2D_DESC texDesc;
+
+			ZeroMemory(&texDesc, sizeof(D3D11_TEXTURE2D_DESC));
+
+			texDesc.Width = mapSize;
+			texDesc.Height = mapSize;
+			texDesc.MipLevels = 1;
+			texDesc.ArraySize = 1;
+			texDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+			texDesc.SampleDesc.Count = 1;
+			texDesc.SampleDesc.Quality = 0;
+			texDesc.Usage = D3D11_USAGE_DYNAMIC;
+			texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+			texDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+			D3D11_SUBRESOURCE_DATA texData;
+
+			ZeroMemory(&texData, sizeof(D3D11_SUBRESOURCE_DATA));
+
+			texData.pSysMem = spectrum->getDisplacement();
+			texData.SysMemPitch = mapSize * sizeof(XMFLOAT4);
+
+			hr = device->CreateTexture2D(&texDesc, &texData, &displacementTexture);
+
+			if (!SUCCEEDED(hr))
+				throw exception("Wave displacement texture cannot be created");
+
+			hr = device->CreateShaderResourceView(displacementTexture, nullptr, &displacementResourceView);
+
+			if (!SUCCEEDED(hr))
+				throw exception("Wave displacement shader resource view cannot be created");
+
+			texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			texData.pSysMem = spectrum->getNormals();
+			texData.SysMemPitch = mapSize * sizeof(uint32_t);
+
+			hr = device->CreateTexture2D(&texDesc, &texData, &waveNormalTexture);
+
+			if (!SUCCEEDED(hr))
+				throw exception("Wave normal texture cannot be created");
+
+			hr = device->CreateShaderResourceView(waveNormalTexture, nullptr, &waveNormalResourceView);
+
+			if (!SUCCEEDED(hr))
+				throw exception("Wave normal shader resource view cannot be created");
+
+			samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+			samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+			samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+
+			hr = device->CreateSamplerState(&samplerDesc, &waveMapSampler);
+
+			if (!SUCCEEDED(hr))
+				throw exception("Wave map sampler cannot be created");
+		}
+
+		// One patch of the spectrum covers patchSize metres
+		OceanMapCBuffer cbufferData;
+
+		cbufferData.mapScale = (mapSize > 0) ? metresPerUnit / spectrum->getDesc().patchSize : 0.0f;
+		cbufferData.displacementScale = 1.0f / metresPerUnit;
+		cbufferData.metresPerUnit = metresPerUnit;
+		cbufferData.padding = 0.0f;
+
+		D3D11_BUFFER_DESC cbufferDesc;
+		D3D11_SUBRESOURCE_DATA cbufferInitData;
+
+		ZeroMemory(&cbufferDesc, sizeof(D3D11_BUFFER_DESC));
+		ZeroMemory(&cbufferInitData, sizeof(D3D11_SUBRESOURCE_DATA));
+
+		cbufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		cbufferDesc.ByteWidth = sizeof(OceanMapCBuffer);
+		cbufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		cbufferInitData.pSysMem = &cbufferData;
+
+		hr = device->CreateBuffer(&cbufferDesc, &cbufferInitData, &mapCBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Ocean map cbuffer cannot be created");
+
+		// Without a wave set the cbuffer holds no waves so ocean_vs leaves the surface to the wave maps
+		GerstnerWaveCBuffer waveData;
+
+		if (waves) {
+
+			waveData = waves->getConstants();
+
+		} else {
+
+			waveData.numWaves = 0;
+			waveData.padding[0] = waveData.padding[1] = waveData.padding[2] = 0.0f;
+		}
+
+		hr = createCBuffer(device, &waveData, &waveCBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Gerstner wave cbuffer cannot be created");
+
+		// Projected grid buffers.  The vertices are rewritten whenever the view changes so the vertex buffer is dynamic
+		if (grid && grid->maxVertexCount() > 0) {
+
+			gridMaxVertices = grid->maxVertexCount();
+
+			D3D11_BUFFER_DESC gridVertexDesc;
+
+			ZeroMemory(&gridVertexDesc, sizeof(D3D11_BUFFER_DESC));
 
+			gridVertexDesc.Usage = D3D11_USAGE_DYNAMIC;
+			gridVertexDesc.ByteWidth = sizeof(DXVertexExt) * gridMaxVertices;
+			gridVertexDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+			gridVertexDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+			hr = device->CreateBuffer(&gridVertexDesc, nullptr, &gridVertexBuffer);
+
+			if (!SUCCEEDED(hr))
+				throw exception("Grid vertex buffer cannot be created");
+
+			vector<UINT> gridIndices(grid->maxIndexCount());
+
+			grid->buildIndices(gridIndices.data());
+
+			D3D11_BUFFER_DESC gridIndexDesc;
+			D3D11_SUBRESOURCE_DATA gridIndexData;
+
+			ZeroMemory(&gridIndexDesc, sizeof(D3D11_BUFFER_DESC));
+			ZeroMemory(&gridIndexData, sizeof(D3D11_SUBRESOURCE_DATA));
+
+			gridIndexDesc.Usage = D3D11_USAGE_IMMUTABLE;
+			gridIndexDesc.ByteWidth = sizeof(UINT) * grid->maxIndexCount();
+			gridIndexDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+			gridIndexData.pSysMem = gridIndices.data();
+
+			hr = device->CreateBuffer(&gridIndexDesc, &gridIndexData, &gridIndexBuffer);
+
+			if (!SUCCEEDED(hr))
+				throw exception("Grid index buffer cannot be created");
+		}
 
 	}
 	catch (exception& e)
@@ -139,9 +320,36 @@ Ocean::Ocean(ID3D11Device *device, DXBlob *vsBytecode, ID3D11ShaderResourceView
 		if (inputLayout)
 			inputLayout->Release();
 
+		if (displacementResourceView)
+			displacementResourceView->Release();
+		if (displacementTexture)
+			displacementTexture->Release();
+		if (waveNormalResourceView)
+			waveNormalResourceView->Release();
+		if (waveNormalTexture)
+			waveNormalTexture->Release();
+		if (waveMapSampler)
+			waveMapSampler->Release();
+		if (mapCBuffer)
+			mapCBuffer->Release();
+		if (waveCBuffer)
+			waveCBuffer->Release();
+		if (gridVertexBuffer)
+			gridVertexBuffer->Release();
+
 		vertexBuffer = nullptr;
 		inputLayout = nullptr;
 		indexBuffer = nullptr;
+		displacementResourceView = nullptr;
+		displacementTexture = nullptr;
+		waveNormalResourceView = nullptr;
+		waveNormalTexture = nullptr;
+		waveMapSampler = nullptr;
+		mapCBuffer = nullptr;
+		waveCBuffer = nullptr;
+		gridVertexBuffer = nullptr;
+		gridMaxVertices = 0;
+		mapSize = 0;
 	}
 }
 
@@ -159,10 +367,88 @@ Ocean::~Ocean() {
 		textureResourceView->Release();
 
 
+	if (normalMapSampler)
+		normalMapSampler->Release();
 	if (cubeMapSampler)
 		cubeMapSampler->Release();
-	if (cubeMapSampler)
-		cubeMapSampler->Release();
+
+	if (displacementResourceView)
+		displacementResourceView->Release();
+	if (displacementTexture)
+		displacementTexture->Release();
+	if (waveNormalResourceView)
+		waveNormalResourceView->Release();
+	if (waveNormalTexture)
+		waveNormalTexture->Release();
+	if (waveMapSampler)
+		waveMapSampler->Release();
+	if (mapCBuffer)
+		mapCBuffer->Release();
+	if (waveCBuffer)
+		waveCBuffer->Release();
+	if (gridVertexBuffer)
+		gridVertexBuffer->Release();
+	if (gridIndexBuffer)
+		gridIndexBuffer->Release();
+}
+
+
+void Ocean::updateMaps(ID3D11DeviceContext *context, const OceanSpectrum *spectrum) {
+
+	if (!context || !spectrum || !displacementTexture || !waveNormalTexture || spectrum->size() != mapSize)
+		return;
+
+	writeTexture(context, displacementTexture, spectrum->getDisplacement(), mapSize * sizeof(XMFLOAT4), mapSize);
+	writeTexture(context, waveNormalTexture, spectrum->getNormals(), mapSize * sizeof(uint32_t), mapSize);
+}
+
+
+void Ocean::updateWaves(ID3D11DeviceContext *context, const GerstnerWaves *waves) {
+
+	if (!context || !waves || !waveCBuffer)
+		return;
+
+	mapBuffer(context, &waves->getConstants(), waveCBuffer);
+}
+
+
+void Ocean::updateGrid(ID3D11DeviceContext *context, const OceanGrid *grid) {
+
+	if (!context || !grid || !gridVertexBuffer || grid->maxVertexCount() != gridMaxVertices)
+		return;
+
+	gridIndexCount = grid->indexCount();
+
+	if (gridIndexCount == 0)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE res;
+
+	HRESULT hr = context->Map(gridVertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &res);
+
+	if (!SUCCEEDED(hr)) {
+
+		gridIndexCount = 0;
+		return;
+	}
+
+	DXVertexExt *v = (DXVertexExt*)res.pData;
+	const XMFLOAT3 *P = grid->getPositions();
+	uint32_t numVertices = grid->vertexCount();
+
+	for (uint32_t i = 0; i < numVertices; i++) {
+
+		v[i].pos = P[i];
+		v[i].normal = XMFLOAT3(0, 1, 0);
+		v[i].matDiffuse = diffuse;
+		v[i].matSpecular = spec;
+
+		// Same mapping from position to texture coordinates as the fixed mesh so the normal map ripples stay in place
+		v[i].texCoord.x = (P[i].x * 10.0f + (W_WIDTH / 2)) / W_WIDTH;
+		v[i].texCoord.y = (P[i].z * 10.0f + (W_HEIGHT / 2)) / W_HEIGHT;
+	}
+
+	context->Unmap(gridVertexBuffer, 0);
 }
 
 
@@ -175,17 +461,31 @@ void Ocean::render(ID3D11DeviceContext *context) {
 	// Set vertex layout
 	context->IASetInputLayout(inputLayout);
 
+	// Draw the projected grid if there is one.  Nothing is drawn while the grid has no water in view
+	bool drawGrid = (gridVertexBuffer != nullptr);
+
+	if (drawGrid && gridIndexCount == 0)
+		return;
+
 	// Set vertex and index buffers for IA
-	ID3D11Buffer* vertexBuffers[] = { vertexBuffer };
+	ID3D11Buffer* vertexBuffers[] = { (drawGrid) ? gridVertexBuffer : vertexBuffer };
 	UINT vertexStrides[] = { sizeof(DXVertexExt) };
 	UINT vertexOffsets[] = { 0 };
 
 	context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, vertexOffsets);
-	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	context->IASetIndexBuffer((drawGrid) ? gridIndexBuffer : indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
 	// Set primitive topology for IA
 	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+	// Wave maps and constants for the VS stage.  These are bound even when there are no maps so ocean_vs reads zeros rather than resources left bound by other objects
+	ID3D11ShaderResourceView *waveMaps[] = { displacementResourceView, waveNormalResourceView };
+
+	context->VSSetConstantBuffers(1, 1, &mapCBuffer);
+	context->VSSetConstantBuffers(2, 1, &waveCBuffer);
+	context->VSSetShaderResources(0, 2, waveMaps);
+	context->VSSetSamplers(0, 1, &waveMapSampler);
+
 	// Bind texture resource views and texture sampler objects to the PS stage of the pipeline
 	if (textureResourceView && cubeMapSampler && normalMapSampler) {
 
@@ -196,6 +496,17 @@ void Ocean::render(ID3D11DeviceContext *context) {
 
 	// Draw ocean object using index buffer
 	// 36 indices for the ocean.
-	context->DrawIndexed(N_W_IND, 0, 0);
+	context->DrawIndexed((drawGrid) ? gridIndexCount : N_W_IND, 0, 0);
 }
 
+
+const DXBoundingVolume& Ocean::getBounds() const {
+
+	return bounds;
+}
+
+
+const DXBoundingVolume& Ocean::getSurfaceBounds() const {
+
+	return surfaceBounds;
+}
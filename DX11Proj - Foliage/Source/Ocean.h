@@ -1,10 +1,24 @@
 #pragma once
 
 #include <GUObject.h>
+#include <DXBoundingVolume.h>
 #define W_WIDTH 20
 #define W_HEIGHT 100
 #define N_W_IND ((W_WIDTH-1)*2*3)*(W_HEIGHT-1)
 class DXBlob;
+class OceanSpectrum;
+class GerstnerWaves;
+class OceanGrid;
+
+
+// Wave map constants bound to b1 of ocean_vs.hlsl
+__declspec(align(16)) struct OceanMapCBuffer {
+
+	float								mapScale; // Wave map repeats per object-space unit (0 if there are no maps)
+	float								displacementScale; // Object-space units per metre of displacement
+	float								metresPerUnit; // Scale from object space to the wave space of the Gerstner waves
+	float								padding;
+};
 
 
 class Ocean : public GUObject {
@@ -24,10 +38,46 @@ class Ocean : public GUObject {
 	ID3D11ShaderResourceView			*textureResourceView = nullptr;
 	ID3D11SamplerState					*normalMapSampler = nullptr;
 	ID3D11SamplerState					*cubeMapSampler = nullptr;
+
+	// Wave displacement and normal maps written from an OceanSpectrum each frame and sampled in ocean_vs
+	uint32_t							mapSize = 0;
+	ID3D11Texture2D						*displacementTexture = nullptr;
+	ID3D11ShaderResourceView			*displacementResourceView = nullptr;
+	ID3D11Texture2D						*waveNormalTexture = nullptr;
+	ID3D11ShaderResourceView			*waveNormalResourceView = nullptr;
+	ID3D11SamplerState					*waveMapSampler = nullptr;
+	ID3D11Buffer						*mapCBuffer = nullptr;
+
+	// Gerstner waves added to the wave maps in ocean_vs (gerstnerCBuffer, b2)
+	ID3D11Buffer						*waveCBuffer = nullptr;
+
+	// Camera projected grid drawn instead of the fixed mesh when created
+	ID3D11Buffer						*gridVertexBuffer = nullptr;
+	ID3D11Buffer						*gridIndexBuffer = nullptr;
+	uint32_t							gridMaxVertices = 0;
+	uint32_t							gridIndexCount = 0;
+
+	// Object-space bounds of the flat surface covered by the mesh
+	DXBoundingVolume					surfaceBounds;
+
+	// Object-space bounds including the maximum wave displacement applied in ocean_vs
+	DXBoundingVolume					bounds;
 public:
 
-	Ocean(ID3D11Device *device, DXBlob *vsBytecode, ID3D11ShaderResourceView *tex_view);
+	// Create the ocean mesh.  If spectrum is given, wave maps of its size are created and the surface is displaced by them with one patch of the spectrum covering spectrum->getDesc().patchSize / metresPerUnit object-space units.  If waves is given, the bounds allow for its displacement in addition (waves may still be set later with updateWaves, but the bounds will not cover them).  If grid is given, buffers for a grid of its size are created and the surface is drawn with the grid written by updateGrid rather than the fixed mesh
+	Ocean(ID3D11Device *device, DXBlob *vsBytecode, ID3D11ShaderResourceView *tex_view, const OceanSpectrum *spectrum = nullptr, const float metresPerUnit = 1.0f, const GerstnerWaves *waves = nullptr, const OceanGrid *grid = nullptr);
 	~Ocean();
 
+	// Copy the displacement and normals of the last spectrum update to the wave maps
+	void updateMaps(ID3D11DeviceContext *context, const OceanSpectrum *spectrum);
+
+	// Upload the wave set at the current time of waves.  Positions in waves are in metres relative to the object-space origin
+	void updateWaves(ID3D11DeviceContext *context, const GerstnerWaves *waves);
+
+	// Copy the vertices of the last grid update to the grid vertex buffer.  grid should be updated with getBounds() and getSurfaceBounds()
+	void updateGrid(ID3D11DeviceContext *context, const OceanGrid *grid);
+
 	void render(ID3D11DeviceContext *context);
+	const DXBoundingVolume& getBounds() const;
+	const DXBoundingVolume& getSurfaceBounds() const;
 };
\ No newline at end of file
@@ -0,0 +1,346 @@
+
+//
+// OceanGrid.cpp
+//
+
+#include <stdafx.h>
+#include <OceanGrid.h>
+#include <DXFrustumCuller.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Largest polygon produced by clipping a quad against the 6 frustum planes
+#define OCEAN_GRID_MAX_CLIP_VERTICES	16
+
+// Range sides within this distance of the screen edge are treated as reaching it
+#define OCEAN_GRID_EDGE_TOLERANCE		1e-3f
+
+
+// Sutherland-Hodgman clip of the convex polygon in against the plane <a, b, c, d>.  Points with a positive distance are kept.  Returns the number of points written to out
+static uint32_t clipPolygon(const XMFLOAT3 *in, const uint32_t count, const XMFLOAT4& plane, XMFLOAT3 *out) {
+
+	uint32_t numOut = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		const XMFLOAT3& a = in[i];
+		const XMFLOAT3& b = in[(i + 1) % count];
+
+		float da = plane.x * a.x + plane.y * a.y + plane.z * a.z + plane.w;
+		float db = plane.x * b.x + plane.y * b.y + plane.z * b.z + plane.w;
+
+		if (da >= 0.0f)
+			out[numOut++] = a;
+
+		if ((da >= 0.0f) != (db >= 0.0f)) {
+
+			float t = da / (da - db);
+
+			out[numOut++] = XMFLOAT3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+		}
+	}
+
+	return numOut;
+}
+
+
+OceanGrid::OceanGrid(const uint32_t gridWidth, const uint32_t gridHeight) {
+
+	screenRange = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	if (gridWidth < 2 || gridHeight < 2)
+		return;
+
+	width = gridWidth;
+	height = gridHeight;
+
+	positions.resize(width * height, XMFLOAT3(0.0f, 0.0f, 0.0f));
+}
+
+
+// Clip each face of the box against the frustum and take the extent of the projected points.  The clipped faces enclose the part of the box inside the frustum so their projection covers the projection of everything in the box that can be seen
+bool OceanGrid::ScreenRange(FXMMATRIX worldViewProj, const DXBoundingVolume& bounds, XMFLOAT4 *rangeOut) {
+
+	XMFLOAT4 planes[DX_NUM_FRUSTUM_PLANES];
+
+	DXFrustumCuller::ExtractPlanes(worldViewProj, planes);
+
+	const float c[3] = { bounds.centre.x, bounds.centre.y, bounds.centre.z };
+	const float e[3] = { bounds.extents.x, bounds.extents.y, bounds.extents.z };
+
+	XMFLOAT4 range(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+	bool found = false;
+
+	for (uint32_t face = 0; face < 6; face++) {
+
+		// Face normal along axis a with sign s.  The corners vary along the other two axes u and v
+		uint32_t a = face >> 1;
+		uint32_t u = (a + 1) % 3;
+		uint32_t v = (a + 2) % 3;
+		float s = (face & 1) ? 1.0f : -1.0f;
+
+		XMFLOAT3 poly[2][OCEAN_GRID_MAX_CLIP_VERTICES];
+		uint32_t count = 4;
+
+		const float cornerU[4] = { -1.0f, 1.0f, 1.0f, -1.0f };
+		const float cornerV[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+
+		for (uint32_t k = 0; k < 4; k++) {
+
+			float p[3];
+
+			p[a] = c[a] + s * e[a];
+			p[u] = c[u] + cornerU[k] * e[u];
+			p[v] = c[v] + cornerV[k] * e[v];
+
+			poly[0][k] = XMFLOAT3(p[0], p[1], p[2]);
+		}
+
+		uint32_t src = 0;
+
+		for (uint32_t k = 0; k < DX_NUM_FRUSTUM_PLANES && count > 0; k++) {
+
+			count = clipPolygon(poly[src], count, planes[k], poly[src ^ 1]);
+			src ^= 1;
+		}
+
+		// Points on or in front of the near plane have w > 0
+		for (uint32_t k = 0; k < count; k++) {
+
+			XMFLOAT4 clip;
+
+			XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&poly[src][k]), worldViewProj));
+
+			if (clip.w <= 0.0f)
+				continue;
+
+			float x = clip.x / clip.w;
+			float y = clip.y / clip.w;
+
+			range.x = min(range.x, x);
+			range.y = min(range.y, y);
+			range.z = max(range.z, x);
+			range.w = max(range.w, y);
+			found = true;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	const float edge = 1.0f - OCEAN_GRID_EDGE_TOLERANCE;
+	const float pushed = 1.0f + OCEAN_GRID_SCREEN_MARGIN;
+
+	range.x = (range.x <= -edge) ? -pushed : max(range.x, -pushed);
+	range.y = (range.y <= -edge) ? -pushed : max(range.y, -pushed);
+	range.z = (range.z >= edge) ? pushed : min(range.z, pushed);
+	range.w = (range.w >= edge) ? pushed : min(range.w, pushed);
+
+	*rangeOut = range;
+
+	return true;
+}
+
+
+// The grid point (sx, sy) in normalised device coordinates is cast along the line from (sx, sy, 0) to (sx, sy, 1) mapped back to object space.  Homogeneous points on both planes are linear in sx, so each row is evaluated 4 columns at a time
+void OceanGrid::castGrid(FXMMATRIX worldViewProj, const DXBoundingVolume& surfaceBounds) {
+
+	XMMATRIX invM = XMMatrixInverse(nullptr, worldViewProj);
+
+	XMFLOAT4 R0, R1, R2, R3;
+
+	XMStoreFloat4(&R0, invM.r[0]);
+	XMStoreFloat4(&R1, invM.r[1]);
+	XMStoreFloat4(&R2, invM.r[2]);
+	XMStoreFloat4(&R3, invM.r[3]);
+
+	XMVECTOR r0x = XMVectorReplicate(R0.x), r0y = XMVectorReplicate(R0.y), r0z = XMVectorReplicate(R0.z), r0w = XMVectorReplicate(R0.w);
+	XMVECTOR r2x = XMVectorReplicate(R2.x), r2y = XMVectorReplicate(R2.y), r2z = XMVectorReplicate(R2.z), r2w = XMVectorReplicate(R2.w);
+
+	const float planeY = surfaceBounds.centre.y;
+
+	XMVECTOR surfaceY = XMVectorReplicate(planeY);
+	XMVECTOR minX = XMVectorReplicate(surfaceBounds.centre.x - surfaceBounds.extents.x);
+	XMVECTOR maxX = XMVectorReplicate(surfaceBounds.centre.x + surfaceBounds.extents.x);
+	XMVECTOR minZ = XMVectorReplicate(surfaceBounds.centre.z - surfaceBounds.extents.z);
+	XMVECTOR maxZ = XMVectorReplicate(surfaceBounds.centre.z + surfaceBounds.extents.z);
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR maxT = XMVectorReplicate(FLT_MAX);
+
+	const float stepX = (screenRange.z - screenRange.x) / (float)(width - 1);
+	const float stepY = (screenRange.w - screenRange.y) / (float)(height - 1);
+
+	XMVECTOR laneX = XMVectorMultiply(XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f), XMVectorReplicate(stepX));
+
+	for (uint32_t j = 0; j < height; j++) {
+
+		float sy = screenRange.y + stepY * (float)j;
+
+		XMVECTOR bx = XMVectorReplicate(sy * R1.x + R3.x);
+		XMVECTOR by = XMVectorReplicate(sy * R1.y + R3.y);
+		XMVECTOR bz = XMVectorReplicate(sy * R1.z + R3.z);
+		XMVECTOR bw = XMVectorReplicate(sy * R1.w + R3.w);
+
+		XMFLOAT3 *row = positions.data() + j * width;
+
+		for (uint32_t i = 0; i < width; i += 4) {
+
+			XMVECTOR sx = XMVectorAdd(XMVectorReplicate(screenRange.x + stepX * (float)i), laneX);
+
+			// Homogeneous points on the near and far planes
+			XMVECTOR nX = XMVectorMultiplyAdd(sx, r0x, bx);
+			XMVECTOR nY = XMVectorMultiplyAdd(sx, r0y, by);
+			XMVECTOR nZ = XMVectorMultiplyAdd(sx, r0z, bz);
+			XMVECTOR nW = XMVectorMultiplyAdd(sx, r0w, bw);
+
+			XMVECTOR nearX = XMVectorDivide(nX, nW);
+			XMVECTOR nearY = XMVectorDivide(nY, nW);
+			XMVECTOR nearZ = XMVectorDivide(nZ, nW);
+
+			XMVECTOR fW = XMVectorAdd(nW, r2w);
+			XMVECTOR farX = XMVectorDivide(XMVectorAdd(nX, r2x), fW);
+			XMVECTOR farY = XMVectorDivide(XMVectorAdd(nY, r2y), fW);
+			XMVECTOR farZ = XMVectorDivide(XMVectorAdd(nZ, r2z), fW);
+
+			XMVECTOR dirX = XMVectorSubtract(farX, nearX);
+			XMVECTOR dirZ = XMVectorSubtract(farZ, nearZ);
+
+			// Rays that meet the plane behind the camera or never (t is negative, infinite or NaN) are treated as meeting it at infinity
+			XMVECTOR t = XMVectorDivide(XMVectorSubtract(surfaceY, nearY), XMVectorSubtract(farY, nearY));
+			XMVECTOR hit = XMVectorAndInt(XMVectorGreaterOrEqual(t, zero), XMVectorLessOrEqual(t, maxT));
+
+			t = XMVectorSelect(maxT, t, hit);
+
+			// Range [t0, t1] of the ray over the surface rectangle (slab test).  A hit short of or beyond the rectangle moves to the point under the ray where it enters or leaves, which lies on the rim of the water seen along the ray, so the triangles meeting the rim cover the water up to its edge on screen.  Clamping the hit point's coordinates instead moves it sideways and leaves gaps near the horizon
+			XMVECTOR invDirX = XMVectorReciprocal(dirX);
+			XMVECTOR invDirZ = XMVectorReciprocal(dirZ);
+			XMVECTOR tx0 = XMVectorMultiply(XMVectorSubtract(minX, nearX), invDirX);
+			XMVECTOR tx1 = XMVectorMultiply(XMVectorSubtract(maxX, nearX), invDirX);
+			XMVECTOR tz0 = XMVectorMultiply(XMVectorSubtract(minZ, nearZ), invDirZ);
+			XMVECTOR tz1 = XMVectorMultiply(XMVectorSubtract(maxZ, nearZ), invDirZ);
+			XMVECTOR t0 = XMVectorMax(XMVectorMin(tx0, tx1), XMVectorMin(tz0, tz1));
+			XMVECTOR t1 = XMVectorMin(XMVectorMax(tx0, tx1), XMVectorMax(tz0, tz1));
+
+			// Rays that pass beside or behind the rectangle fall back to the far point, which the clamp moves to the edge of the surface in the direction the ray points
+			XMVECTOR crosses = XMVectorAndInt(XMVectorLessOrEqual(t0, t1), XMVectorGreaterOrEqual(t1, zero));
+
+			t = XMVectorMin(XMVectorMax(t, t0), t1);
+
+			XMVECTOR x = XMVectorSelect(farX, XMVectorMultiplyAdd(dirX, t, nearX), crosses);
+			XMVECTOR z = XMVectorSelect(farZ, XMVectorMultiplyAdd(dirZ, t, nearZ), crosses);
+
+			XMFLOAT4A rx, rz;
+
+			XMStoreFloat4A(&rx, XMVectorClamp(x, minX, maxX));
+			XMStoreFloat4A(&rz, XMVectorClamp(z, minZ, maxZ));
+
+			uint32_t n = min(width - i, 4u);
+
+			for (uint32_t k = 0; k < n; k++)
+				row[i + k] = XMFLOAT3((&rx.x)[k], planeY, (&rz.x)[k]);
+		}
+	}
+}
+
+
+bool OceanGrid::update(FXMMATRIX worldViewProj, const DXBoundingVolume& bounds, const DXBoundingVolume& surfaceBounds) {
+
+	if (width == 0)
+		return false;
+
+	XMFLOAT4X4 M;
+
+	XMStoreFloat4x4(&M, worldViewProj);
+
+	if (initialised && memcmp(&M, &lastWorldViewProj, sizeof(XMFLOAT4X4)) == 0 && memcmp(&bounds, &lastBounds, sizeof(DXBoundingVolume)) == 0 && memcmp(&surfaceBounds, &lastSurfaceBounds, sizeof(DXBoundingVolume)) == 0)
+		return false;
+
+	initialised = true;
+	lastWorldViewProj = M;
+	lastBounds = bounds;
+	lastSurfaceBounds = surfaceBounds;
+
+	visible = ScreenRange(worldViewProj, bounds, &screenRange);
+
+	if (visible)
+		castGrid(worldViewProj, surfaceBounds);
+
+	return true;
+}
+
+
+uint32_t OceanGrid::getWidth() const {
+
+	return width;
+}
+
+
+uint32_t OceanGrid::getHeight() const {
+
+	return height;
+}
+
+
+uint32_t OceanGrid::vertexCount() const {
+
+	return (visible) ? width * height : 0;
+}
+
+
+uint32_t OceanGrid::indexCount() const {
+
+	return (visible) ? maxIndexCount() : 0;
+}
+
+
+uint32_t OceanGrid::maxVertexCount() const {
+
+	return width * height;
+}
+
+
+uint32_t OceanGrid::maxIndexCount() const {
+
+	return (width > 1 && height > 1) ? (width - 1) * (height - 1) * 6 : 0;
+}
+
+
+const XMFLOAT3* OceanGrid::getPositions() const {
+
+	return positions.data();
+}
+
+
+XMFLOAT4 OceanGrid::getScreenRange() const {
+
+	return screenRange;
+}
+
+
+void OceanGrid::buildIndices(uint32_t *indicesOut) const {
+
+	uint32_t *p = indicesOut;
+
+	for (uint32_t j = 0; j + 1 < height; j++) {
+
+		for (uint32_t i = 0; i + 1 < width; i++) {
+
+			uint32_t v = j * width + i;
+
+			p[0] = v;
+			p[1] = v + width;
+			p[2] = v + 1;
+
+			p[3] = v + 1;
+			p[4] = v + width;
+			p[5] = v + width + 1;
+
+			p += 6;
+		}
+	}
+}
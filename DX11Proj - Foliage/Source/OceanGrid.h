@@ -0,0 +1,70 @@
+
+//
+// OceanGrid.h
+//
+
+// Camera projected grid for the water surface (Johanson, "Real-time water rendering - Introducing the projected grid concept").  A regular grid of width x height vertices is laid over the part of the screen the water can cover and each vertex is cast from the camera onto the undisplaced water plane, so the vertex density is uniform in screen space however near or far the water is.  The screen range is the projection of the water's displaced bounds clipped to the view frustum, so no vertices are spent off the water, and vertices whose rays miss the water are moved to the rim of the surface under the ray, where their triangles collapse.  The grid is only recast when the view or the water bounds change.  Vertices are returned in the object space of the water mesh so the wave maps and Gerstner waves are sampled at fixed positions on the surface.  The grid does not depend on Direct3D so coverage and vertex counts can be checked on the CPU alone.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <DXBoundingVolume.h>
+#include <vector>
+#include <cstdint>
+
+
+// Sides of the screen range that reach the edge of the screen are pushed this far (in normalised device coordinates) past the edge so water displaced onto the screen from just outside the view is still covered
+#define OCEAN_GRID_SCREEN_MARGIN	0.05f
+
+
+class OceanGrid : public GUObject {
+
+	uint32_t							width = 0;
+	uint32_t							height = 0;
+
+	// Object-space vertex positions (row j, column i at index j * width + i).  Rows run up the screen and columns to the right
+	std::vector<DirectX::XMFLOAT3>		positions;
+
+	// Screen range <xmin, ymin, xmax, ymax> covered by the grid in normalised device coordinates
+	DirectX::XMFLOAT4					screenRange;
+
+	bool								visible = false;
+
+	// Inputs of the last update, used to skip the update when nothing has changed
+	bool								initialised = false;
+	DirectX::XMFLOAT4X4					lastWorldViewProj;
+	DXBoundingVolume					lastBounds;
+	DXBoundingVolume					lastSurfaceBounds;
+
+	// Screen range of the parts of bounds inside the view frustum.  Returns false if no part of bounds is visible
+	static bool ScreenRange(DirectX::FXMMATRIX worldViewProj, const DXBoundingVolume& bounds, DirectX::XMFLOAT4 *rangeOut);
+
+	// Cast the grid onto the surface plane over the current screen range
+	void castGrid(DirectX::FXMMATRIX worldViewProj, const DXBoundingVolume& surfaceBounds);
+
+public:
+
+	// Create a width x height grid.  Both must be at least 2 (otherwise vertexCount() is always 0)
+	OceanGrid(const uint32_t gridWidth, const uint32_t gridHeight);
+
+	// Fit the grid to the view.  worldViewProj maps the water's object space to clip space.  bounds encloses the displaced surface and surfaceBounds is the flat surface (extents.y = 0, the plane lies at centre.y), both in object space.  Returns true if the vertices changed
+	bool update(DirectX::FXMMATRIX worldViewProj, const DXBoundingVolume& bounds, const DXBoundingVolume& surfaceBounds);
+
+	uint32_t getWidth() const;
+	uint32_t getHeight() const;
+
+	// Number of vertices and indices to draw for the last update (0 if no water is visible)
+	uint32_t vertexCount() const;
+	uint32_t indexCount() const;
+
+	// Space needed for the largest grid
+	uint32_t maxVertexCount() const;
+	uint32_t maxIndexCount() const;
+
+	const DirectX::XMFLOAT3* getPositions() const;
+	DirectX::XMFLOAT4 getScreenRange() const;
+
+	// Write the triangle list indices of the grid (maxIndexCount() entries).  Triangles are clockwise on screen.  The indices do not change with the view
+	void buildIndices(uint32_t *indicesOut) const;
+};
@@ -0,0 +1,416 @@
+
+//
+// OceanSpectrum.cpp
+//
+
+#include <stdafx.h>
+#include <OceanSpectrum.h>
+#include <GUFFT.h>
+#include <GUParallel.h>
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+
+// Number of float arrays of size x size values in the block (the displacement and normal outputs follow)
+#define OCEAN_SPECTRUM_NUM_ARRAYS		11
+
+// Approximate number of samples processed by each parallel task
+#define OCEAN_SPECTRUM_TASK_SAMPLES		8192
+
+
+// Load lanes x-1 .. x+2 of a row of n values, wrapping at the start of the row
+static inline XMVECTOR loadLeft(const float *row, const uint32_t x, const uint32_t n) {
+
+	if (x > 0)
+		return XMLoadFloat4((const XMFLOAT4*)(row + x - 1));
+
+	return XMVectorSet(row[n - 1], row[0], row[1], row[2]);
+}
+
+
+// Load lanes x+1 .. x+4 of a row of n values, wrapping at the end of the row
+static inline XMVECTOR loadRight(const float *row, const uint32_t x, const uint32_t n) {
+
+	if (x + 4 < n)
+		return XMLoadFloat4((const XMFLOAT4*)(row + x + 1));
+
+	return XMVectorSet(row[x + 1], row[x + 2], row[x + 3], row[0]);
+}
+
+
+// Standard normal random number from two xorshift32 draws (Box-Muller)
+static float randomGaussian(uint32_t& state) {
+
+	float u[2];
+
+	for (int i = 0; i < 2; i++) {
+
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		// (0, 1] so the log is finite
+		u[i] = (float)((state >> 8) + 1) * (1.0f / 16777216.0f);
+	}
+
+	return sqrtf(-2.0f * logf(u[0])) * cosf(XM_2PI * u[1]);
+}
+
+
+
+OceanSpectrumDesc::OceanSpectrumDesc() {
+
+	type = OCEAN_SPECTRUM_JONSWAP;
+	patchSize = 20.0f;
+	windSpeed = 6.0f;
+	windDirection = XMFLOAT2(1.0f, 0.0f);
+	amplitude = 0.0081f;
+	fetch = 10000.0f;
+	peakEnhancement = 3.3f;
+	minWavelength = 0.05f;
+	choppiness = 0.8f;
+	gravity = 9.81f;
+	repeatTime = 200.0f;
+}
+
+
+
+OceanSpectrum::OceanSpectrum(const uint32_t size, const OceanSpectrumDesc& initDesc, const uint32_t seed) {
+
+	desc = initDesc;
+
+	if (size < 4 || !GUFFT::IsPowerOfTwo(size))
+		return;
+
+	uint32_t N = size * size;
+
+	block = (float*)_aligned_malloc(sizeof(float) * N * (OCEAN_SPECTRUM_NUM_ARRAYS + 5), 64);
+
+	if (!block)
+		return;
+
+	n = size;
+	fft = new GUFFT(n);
+
+	float *arrays[OCEAN_SPECTRUM_NUM_ARRAYS];
+
+	for (uint32_t i = 0; i < OCEAN_SPECTRUM_NUM_ARRAYS; i++)
+		arrays[i] = block + N * i;
+
+	h0Re = arrays[0];
+	h0Im = arrays[1];
+	h0ConjRe = arrays[2];
+	h0ConjIm = arrays[3];
+	omegaCycles = arrays[4];
+	unitKx = arrays[5];
+	unitKz = arrays[6];
+	aRe = arrays[7];
+	aIm = arrays[8];
+	bRe = arrays[9];
+	bIm = arrays[10];
+
+	displacement = (XMFLOAT4*)(block + N * OCEAN_SPECTRUM_NUM_ARRAYS);
+	normals = (uint32_t*)(block + N * (OCEAN_SPECTRUM_NUM_ARRAYS + 4));
+
+	memset(block, 0, sizeof(float) * N * (OCEAN_SPECTRUM_NUM_ARRAYS + 5));
+
+	initialiseSpectrum(seed);
+	update(0.0);
+}
+
+
+OceanSpectrum::~OceanSpectrum() {
+
+	if (fft)
+		fft->release();
+
+	if (block)
+		_aligned_free(block);
+}
+
+
+// Phillips: P(k) = A exp(-1 / (kL)^2) / k^4 |k.w|^2 with L = V^2 / g.  JONSWAP: the frequency spectrum S(w) = alpha g^2 / w^5 exp(-5/4 (wp / w)^4) gamma^r is converted to wavevectors through dw/dk = g / 2w and spread downwind by (2 / pi) cos^2.  Both are damped by exp(-k^2 l^2) to suppress waves shorter than minWavelength
+float OceanSpectrum::spectrumDensity(const float kx, const float kz) const {
+
+	float k2 = kx * kx + kz * kz;
+
+	if (k2 == 0.0f || desc.windSpeed <= 0.0f)
+		return 0.0f;
+
+	float k = sqrtf(k2);
+	float g = desc.gravity;
+	float cosTheta = (kx * desc.windDirection.x + kz * desc.windDirection.y) / k;
+
+	float l = desc.minWavelength / XM_2PI;
+	float damping = expf(-k2 * l * l);
+
+	if (desc.type == OCEAN_SPECTRUM_PHILLIPS) {
+
+		float L = desc.windSpeed * desc.windSpeed / g;
+
+		return desc.amplitude * expf(-1.0f / (k2 * L * L)) / (k2 * k2) * cosTheta * cosTheta * damping;
+	}
+
+	if (cosTheta <= 0.0f || desc.fetch <= 0.0f)
+		return 0.0f;
+
+	float U = desc.windSpeed;
+	float F = desc.fetch;
+
+	float alpha = 0.076f * powf(U * U / (F * g), 0.22f);
+	float omegaPeak = 22.0f * powf(g * g / (U * F), 1.0f / 3.0f);
+
+	float omega = sqrtf(g * k);
+	float sigma = (omega <= omegaPeak) ? 0.07f : 0.09f;
+	float r = expf(-(omega - omegaPeak) * (omega - omegaPeak) / (2.0f * sigma * sigma * omegaPeak * omegaPeak));
+	float peakRatio = omegaPeak / omega;
+
+	float S = alpha * g * g / powf(omega, 5.0f) * expf(-1.25f * peakRatio * peakRatio * peakRatio * peakRatio) * powf(desc.peakEnhancement, r);
+
+	return S * (g / (2.0f * omega)) / k * (2.0f / XM_PI) * cosTheta * cosTheta * damping;
+}
+
+
+void OceanSpectrum::initialiseSpectrum(const uint32_t seed) {
+
+	float windLength = sqrtf(desc.windDirection.x * desc.windDirection.x + desc.windDirection.y * desc.windDirection.y);
+
+	if (windLength > 0.0f) {
+
+		desc.windDirection.x /= windLength;
+		desc.windDirection.y /= windLength;
+	}
+
+	float dk = XM_2PI / desc.patchSize;
+	uint32_t state = (seed) ? seed : 1;
+
+	for (uint32_t z = 0; z < n; z++) {
+
+		// Wavevector indices run [0, n / 2) then [-n / 2, 0) so no shift is needed after the transform
+		int mz = (z < n / 2) ? (int)z : (int)z - (int)n;
+
+		for (uint32_t x = 0; x < n; x++) {
+
+			int mx = (x < n / 2) ? (int)x : (int)x - (int)n;
+
+			float kx = dk * (float)mx;
+			float kz = dk * (float)mz;
+			float k = sqrtf(kx * kx + kz * kz);
+			uint32_t i = z * n + x;
+
+			float g1 = randomGaussian(state);
+			float g2 = randomGaussian(state);
+
+			// Each travelling wave is carried by both h0(k) and conj(h0(-k)), so E|h0|^2 = P dk^2 / 2 gives the surface the variance of the spectrum.  The Nyquist row and column have no matching negative wavevector so they are left empty to keep the results real
+			float amplitude = (x == n / 2 || z == n / 2) ? 0.0f : sqrtf(spectrumDensity(kx, kz)) * dk * 0.5f;
+
+			h0Re[i] = g1 * amplitude;
+			h0Im[i] = g2 * amplitude;
+
+			omegaCycles[i] = floorf(sqrtf(desc.gravity * k) * desc.repeatTime / XM_2PI + 0.5f);
+
+			unitKx[i] = (k > 0.0f) ? desc.choppiness * kx / k : 0.0f;
+			unitKz[i] = (k > 0.0f) ? desc.choppiness * kz / k : 0.0f;
+		}
+	}
+
+	// Each mode contributes |h0(k)|^2 + |h0(-k)|^2 to the variance of the height over time
+	double varianceH = 0.0, varianceX = 0.0, varianceZ = 0.0;
+
+	for (uint32_t z = 0; z < n; z++) {
+
+		for (uint32_t x = 0; x < n; x++) {
+
+			uint32_t i = z * n + x;
+			uint32_t j = ((n - z) & (n - 1)) * n + ((n - x) & (n - 1));
+
+			h0ConjRe[i] = h0Re[j];
+			h0ConjIm[i] = -h0Im[j];
+
+			double power = (double)h0Re[i] * h0Re[i] + (double)h0Im[i] * h0Im[i];
+
+			varianceH += power;
+			varianceX += power * unitKx[i] * unitKx[i];
+			varianceZ += power * unitKz[i] * unitKz[i];
+		}
+	}
+
+	displacementBound = XMFLOAT3((float)(6.0 * sqrt(2.0 * varianceX)), (float)(6.0 * sqrt(2.0 * varianceH)), (float)(6.0 * sqrt(2.0 * varianceZ)));
+}
+
+
+// h(k, t) = h0(k) e^(iwt) + conj(h0(-k)) e^(-iwt).  The x displacement spectrum is i (kx / |k|) h(k, t) scaled by the choppiness, so the first transform takes h + i Dx = h (1 - ux) and the second takes Dz = i uz h.  The horizontal displacement moves samples towards the wave crests
+void OceanSpectrum::buildSpectrumRows(const uint32_t begin, const uint32_t end, const float cycle) {
+
+	XMVECTOR u = XMVectorReplicate(cycle);
+	XMVECTOR one = XMVectorReplicate(1.0f);
+	XMVECTOR twoPi = XMVectorReplicate(XM_2PI);
+
+	for (uint32_t i = begin * n; i < end * n; i += 4) {
+
+		// Whole cycles are dropped before the phase is formed
+		XMVECTOR phase = XMVectorMultiply(XMLoadFloat4A((const XMFLOAT4A*)(omegaCycles + i)), u);
+		phase = XMVectorMultiply(XMVectorSubtract(phase, XMVectorFloor(phase)), twoPi);
+
+		XMVECTOR s, c;
+		XMVectorSinCos(&s, &c, phase);
+
+		XMVECTOR h0r = XMLoadFloat4A((const XMFLOAT4A*)(h0Re + i));
+		XMVECTOR h0i = XMLoadFloat4A((const XMFLOAT4A*)(h0Im + i));
+		XMVECTOR hcr = XMLoadFloat4A((const XMFLOAT4A*)(h0ConjRe + i));
+		XMVECTOR hci = XMLoadFloat4A((const XMFLOAT4A*)(h0ConjIm + i));
+
+		XMVECTOR hr = XMVectorMultiplyAdd(XMVectorAdd(h0r, hcr), c, XMVectorMultiply(XMVectorSubtract(hci, h0i), s));
+		XMVECTOR hi = XMVectorMultiplyAdd(XMVectorAdd(h0i, hci), c, XMVectorMultiply(XMVectorSubtract(h0r, hcr), s));
+
+		XMVECTOR ux = XMVectorSubtract(one, XMLoadFloat4A((const XMFLOAT4A*)(unitKx + i)));
+		XMVECTOR uz = XMLoadFloat4A((const XMFLOAT4A*)(unitKz + i));
+
+		XMStoreFloat4A((XMFLOAT4A*)(aRe + i), XMVectorMultiply(hr, ux));
+		XMStoreFloat4A((XMFLOAT4A*)(aIm + i), XMVectorMultiply(hi, ux));
+		XMStoreFloat4A((XMFLOAT4A*)(bRe + i), XMVectorNegate(XMVectorMultiply(hi, uz)));
+		XMStoreFloat4A((XMFLOAT4A*)(bIm + i), XMVectorMultiply(hr, uz));
+	}
+}
+
+
+// The displaced surface passes through (x + dx, h, z + dz).  Its tangents along x and z are found from central differences and the normal is their cross product.  The Jacobian of the horizontal mapping is the y component of the same unnormalised cross product divided by (2 * spacing)^2
+void OceanSpectrum::buildOutputRows(const uint32_t begin, const uint32_t end) {
+
+	float spacing2 = 2.0f * desc.patchSize / (float)n;
+
+	XMVECTOR twoSpacing = XMVectorReplicate(spacing2);
+	XMVECTOR invSpacing2 = XMVectorReplicate(1.0f / (spacing2 * spacing2));
+	XMVECTOR half = XMVectorReplicate(0.5f);
+	XMVECTOR one = XMVectorReplicate(1.0f);
+
+	for (uint32_t z = begin; z < end; z++) {
+
+		uint32_t row = z * n;
+		uint32_t up = ((z - 1) & (n - 1)) * n;
+		uint32_t down = ((z + 1) & (n - 1)) * n;
+
+		for (uint32_t x = 0; x < n; x += 4) {
+
+			XMVECTOR h = XMLoadFloat4A((const XMFLOAT4A*)(aRe + row + x));
+			XMVECTOR dx = XMLoadFloat4A((const XMFLOAT4A*)(aIm + row + x));
+			XMVECTOR dz = XMLoadFloat4A((const XMFLOAT4A*)(bRe + row + x));
+
+			// Tangent along x
+			XMVECTOR txX = XMVectorAdd(twoSpacing, XMVectorSubtract(loadRight(aIm + row, x, n), loadLeft(aIm + row, x, n)));
+			XMVECTOR txY = XMVectorSubtract(loadRight(aRe + row, x, n), loadLeft(aRe + row, x, n));
+			XMVECTOR txZ = XMVectorSubtract(loadRight(bRe + row, x, n), loadLeft(bRe + row, x, n));
+
+			// Tangent along z
+			XMVECTOR tzX = XMVectorSubtract(XMLoadFloat4A((const XMFLOAT4A*)(aIm + down + x)), XMLoadFloat4A((const XMFLOAT4A*)(aIm + up + x)));
+			XMVECTOR tzY = XMVectorSubtract(XMLoadFloat4A((const XMFLOAT4A*)(aRe + down + x)), XMLoadFloat4A((const XMFLOAT4A*)(aRe + up + x)));
+			XMVECTOR tzZ = XMVectorAdd(twoSpacing, XMVectorSubtract(XMLoadFloat4A((const XMFLOAT4A*)(bRe + down + x)), XMLoadFloat4A((const XMFLOAT4A*)(bRe + up + x))));
+
+			// N = tz x tx
+			XMVECTOR nx = XMVectorNegativeMultiplySubtract(tzZ, txY, XMVectorMultiply(tzY, txZ));
+			XMVECTOR ny = XMVectorNegativeMultiplySubtract(tzX, txZ, XMVectorMultiply(tzZ, txX));
+			XMVECTOR nz = XMVectorNegativeMultiplySubtract(tzY, txX, XMVectorMultiply(tzX, txY));
+
+			XMVECTOR jacobian = XMVectorMultiply(ny, invSpacing2);
+
+			XMVECTOR invLength = XMVectorReciprocalSqrt(XMVectorMultiplyAdd(nx, nx, XMVectorMultiplyAdd(ny, ny, XMVectorMultiply(nz, nz))));
+
+			// Transpose the 4 samples from SoA lanes to one vector per sample
+			XMMATRIX D = XMMatrixTranspose(XMMATRIX(dx, h, dz, jacobian));
+			XMMATRIX N = XMMatrixTranspose(XMMATRIX(
+				XMVectorMultiplyAdd(XMVectorMultiply(nx, invLength), half, half),
+				XMVectorMultiplyAdd(XMVectorMultiply(ny, invLength), half, half),
+				XMVectorMultiplyAdd(XMVectorMultiply(nz, invLength), half, half),
+				one));
+
+			for (uint32_t k = 0; k < 4; k++) {
+
+				XMStoreFloat4A((XMFLOAT4A*)(displacement + row + x + k), D.r[k]);
+				XMStoreUByteN4((XMUBYTEN4*)(normals + row + x + k), N.r[k]);
+			}
+		}
+	}
+}
+
+
+void OceanSpectrum::update(const double t, GUParallel *pool) {
+
+	if (!fft || n == 0)
+		return;
+
+	time = t;
+
+	double cycles = t / (double)desc.repeatTime;
+	float cycle = (float)(cycles - floor(cycles));
+
+	uint32_t grain = max(1u, (uint32_t)OCEAN_SPECTRUM_TASK_SAMPLES / n);
+
+	if (pool) {
+
+		pool->parallelFor(n, grain, [this, &cycle](uint32_t begin, uint32_t end) {
+
+			buildSpectrumRows(begin, end, cycle);
+		});
+
+	} else {
+
+		buildSpectrumRows(0, n, cycle);
+	}
+
+	fft->transform2D(aRe, aIm, true, pool);
+	fft->transform2D(bRe, bIm, true, pool);
+
+	if (pool) {
+
+		pool->parallelFor(n, grain, [this](uint32_t begin, uint32_t end) {
+
+			buildOutputRows(begin, end);
+		});
+
+	} else {
+
+		buildOutputRows(0, n);
+	}
+}
+
+
+uint32_t OceanSpectrum::size() const {
+
+	return n;
+}
+
+
+double OceanSpectrum::getTime() const {
+
+	return time;
+}
+
+
+const OceanSpectrumDesc& OceanSpectrum::getDesc() const {
+
+	return desc;
+}
+
+
+const XMFLOAT4* OceanSpectrum::getDisplacement() const {
+
+	return displacement;
+}
+
+
+const uint32_t* OceanSpectrum::getNormals() const {
+
+	return normals;
+}
+
+
+XMFLOAT3 OceanSpectrum::getDisplacementBound() const {
+
+	return displacementBound;
+}
@@ -0,0 +1,107 @@
+
+//
+// OceanSpectrum.h
+//
+
+// CPU ocean surface synthesised from a statistical wave spectrum (Tessendorf, "Simulating Ocean Water").  A square patch of patchSize x patchSize metres is sampled on a size x size grid that tiles seamlessly.  Gaussian random amplitudes h0(k) are drawn once from a Phillips or JONSWAP spectrum and each update advances their phases by the deep water dispersion relation w^2 = g|k|, then two inverse 2D FFTs (GUFFT) return the height and the choppy horizontal displacement.  The first transform carries the height in its real part and the x displacement in its imaginary part and the second carries the z displacement.  Normals and the Jacobian of the horizontal displacement (below 1 where the surface is compressed and above 1 where it is stretched) are then found from central differences of the displaced surface.  Every step runs 4 samples per SIMD operation and is split across a GUParallel thread pool if one is given.  The results are held in memory laid out to be copied directly into R32G32B32A32_FLOAT displacement and R8G8B8A8_UNORM normal textures.  The simulation does not depend on Direct3D so it can be run and timed on the CPU alone.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <cstdint>
+
+class GUFFT;
+class GUParallel;
+
+
+enum OceanSpectrumType { OCEAN_SPECTRUM_PHILLIPS, OCEAN_SPECTRUM_JONSWAP };
+
+
+// Spectrum parameters.  Lengths are in metres, speeds in metres per second
+struct OceanSpectrumDesc {
+
+	OceanSpectrumType					type;
+	float								patchSize; // Side of the square patch covered by the maps
+	float								windSpeed; // Wind speed 10m above the surface
+	DirectX::XMFLOAT2					windDirection;
+	float								amplitude; // Phillips constant A (Phillips only - JONSWAP amplitude follows from the wind and fetch)
+	float								fetch; // Distance over which the wind has blown (JONSWAP only)
+	float								peakEnhancement; // JONSWAP peak enhancement factor gamma (3.3 for a typical developing sea)
+	float								minWavelength; // Waves shorter than this are suppressed
+	float								choppiness; // Scale of the horizontal displacement (0 gives rounded sine-like waves, about 1 sharp crests)
+	float								gravity;
+	float								repeatTime; // The surface repeats after this many seconds.  Wave frequencies are rounded to multiples of 2 pi / repeatTime so phases stay precise however long the simulation runs
+
+	OceanSpectrumDesc();
+};
+
+
+class OceanSpectrum : public GUObject {
+
+	OceanSpectrumDesc					desc;
+
+	uint32_t							n = 0;
+	GUFFT								*fft = nullptr;
+
+	// All arrays are held in a single aligned block
+	float								*block = nullptr;
+
+	// Per-wavevector data (size x size, row index = kz).  h0 holds h0(k) and h0Conj holds the conjugate of h0(-k)
+	float								*h0Re = nullptr;
+	float								*h0Im = nullptr;
+	float								*h0ConjRe = nullptr;
+	float								*h0ConjIm = nullptr;
+	float								*omegaCycles = nullptr; // Wave frequency in cycles per repeatTime
+	float								*unitKx = nullptr; // kx / |k| scaled by the choppiness
+	float								*unitKz = nullptr;
+
+	// FFT work arrays.  After update the a arrays hold the height and x displacement and the b arrays the z displacement
+	float								*aRe = nullptr;
+	float								*aIm = nullptr;
+	float								*bRe = nullptr;
+	float								*bIm = nullptr;
+
+	// Outputs (size x size, row index = z).  displacement holds (dx, height, dz, Jacobian) and normals are packed as 8 bit unsigned normalised (nx, ny, nz, 1)
+	DirectX::XMFLOAT4					*displacement = nullptr;
+	uint32_t							*normals = nullptr;
+
+	DirectX::XMFLOAT3					displacementBound;
+	double								time = 0.0;
+
+	// Fill h0 from the spectrum using a fixed random seed
+	void initialiseSpectrum(const uint32_t seed);
+
+	// Spectral power density of wavevector (kx, kz) per unit wavevector area
+	float spectrumDensity(const float kx, const float kz) const;
+
+	// Phase-advanced spectrum rows [begin, end) for the transforms.  cycle is the time as a fraction of repeatTime
+	void buildSpectrumRows(const uint32_t begin, const uint32_t end, const float cycle);
+
+	// Displacement, normal and Jacobian rows [begin, end) from the transform results
+	void buildOutputRows(const uint32_t begin, const uint32_t end);
+
+	// Not copyable.  A copy would share and free the same block and transform.  Declared but not defined
+	OceanSpectrum(const OceanSpectrum&);
+	OceanSpectrum& operator=(const OceanSpectrum&);
+
+public:
+
+	// Create a size x size spectrum.  size must be a power of two of at least 4.  The same seed always gives the same sea
+	OceanSpectrum(const uint32_t size, const OceanSpectrumDesc& initDesc, const uint32_t seed = 1);
+	~OceanSpectrum();
+
+	// Evaluate the surface at time t seconds.  Work is split across pool if one is given
+	void update(const double t, GUParallel *pool = nullptr);
+
+	uint32_t size() const;
+	double getTime() const;
+	const OceanSpectrumDesc& getDesc() const;
+
+	// Row-major size x size results of the last update (nullptr if the spectrum could not be created)
+	const DirectX::XMFLOAT4* getDisplacement() const;
+	const uint32_t* getNormals() const;
+
+	// Bound on the magnitude of each component of the displacement (x, height, z).  The bound is six standard deviations of the displacement over time, which a sample exceeds with negligible probability
+	DirectX::XMFLOAT3 getDisplacementBound() const;
+};
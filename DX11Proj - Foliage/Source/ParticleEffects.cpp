@@ -0,0 +1,926 @@
+
+//
+// ParticleEffects.cpp
+//
+
+#include <stdafx.h>
+#include <ParticleEffects.h>
+#include <GUParallel.h>
+#include <GURadixSort.h>
+#include <DXBlob.h>
+#include <iostream>
+#include <exception>
+#include <algorithm>
+#include <cstring>
+#include <cfloat>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Number of float arrays in each block
+#define PARTICLE_EFFECT_NUM_ARRAYS			8
+
+// Handles hold the slot in the low 16 bits and the slot generation in the high 16 bits
+#define PARTICLE_EFFECT_SLOT_MASK			0xFFFF
+
+
+ParticleEffects::ParticleEffects(ID3D11Device *device, DXBlob *vsBytecode, const uint32_t maxEffects, const uint32_t initMaxBlocks) {
+
+	ZeroMemory(&stats, sizeof(ParticleEffectStats));
+
+	for (uint32_t i = 0; i < PARTICLE_EFFECT_MAX_TEXTURES; i++) {
+
+		textures[i] = nullptr;
+		batchStart[i] = batchCount[i] = 0;
+		batchOrder[i] = i;
+	}
+
+	try
+	{
+		if (!device || !vsBytecode || maxEffects == 0 || maxEffects > PARTICLE_EFFECT_SLOT_MASK || initMaxBlocks == 0)
+			throw exception("Invalid parameters for particle effects instantiation");
+
+		// Setup the effect slots.  Slots are handed out from the top of the free stack so the lowest slots are used first
+		effects.resize(maxEffects);
+		freeEffects.reserve(maxEffects);
+		activeEffects.reserve(maxEffects);
+
+		for (uint32_t i = 0; i < maxEffects; i++) {
+
+			effects[i].generation = 0;
+			effects[i].activeIndex = PARTICLE_EFFECT_INVALID;
+			effects[i].firstBlock = effects[i].lastBlock = PARTICLE_EFFECT_INVALID;
+			effects[i].numParticles = 0;
+			freeEffects.push_back(maxEffects - 1 - i);
+		}
+
+		// Setup the block pool with every block on the free list
+		maxBlocks = initMaxBlocks;
+
+		blockStorage = (float*)_aligned_malloc(sizeof(float) * PARTICLE_EFFECT_BLOCK_SIZE * PARTICLE_EFFECT_NUM_ARRAYS * maxBlocks, 16);
+
+		if (!blockStorage)
+			throw exception("Cannot allocate particle blocks");
+
+		// Lanes past the last particle of a block are integrated with the live ones so keep them finite
+		memset(blockStorage, 0, sizeof(float) * PARTICLE_EFFECT_BLOCK_SIZE * PARTICLE_EFFECT_NUM_ARRAYS * maxBlocks);
+
+		blockNext.resize(maxBlocks);
+
+		for (uint32_t b = 0; b < maxBlocks; b++)
+			blockNext[b] = (b + 1 < maxBlocks) ? b + 1 : PARTICLE_EFFECT_INVALID;
+
+		freeBlock = 0;
+		numFreeBlocks = maxBlocks;
+
+		uint32_t maxParticles = maxBlocks * PARTICLE_EFFECT_BLOCK_SIZE;
+
+		drawnPositions.resize(maxParticles);
+		sortKeys.reserve(maxParticles);
+		sortOrder.reserve(maxParticles);
+
+		sorter = new GURadixSort();
+		sorter->reserve(maxParticles);
+
+
+		// Setup the dynamic vertex buffer (4 vertices per particle) written each frame by upload
+		D3D11_BUFFER_DESC vertexDesc;
+
+		ZeroMemory(&vertexDesc, sizeof(D3D11_BUFFER_DESC));
+
+		vertexDesc.Usage = D3D11_USAGE_DYNAMIC;
+		vertexDesc.ByteWidth = sizeof(DXVertexParticle) * maxParticles * 4;
+		vertexDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		vertexDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		HRESULT hr = device->CreateBuffer(&vertexDesc, nullptr, &vertexBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Vertex buffer cannot be created");
+
+		// Create the index buffer.  It is rewritten in back-to-front order by sortByDepth and starts in vertex order
+		vector<UINT> indices(maxParticles * 6);
+
+		for (UINT i = 0; i < maxParticles; i++) {
+
+			indices[(i * 6) + 0] = (i * 4) + 2;
+			indices[(i * 6) + 1] = (i * 4) + 1;
+			indices[(i * 6) + 2] = (i * 4) + 0;
+
+			indices[(i * 6) + 3] = (i * 4) + 0;
+			indices[(i * 6) + 4] = (i * 4) + 3;
+			indices[(i * 6) + 5] = (i * 4) + 2;
+		}
+
+		D3D11_BUFFER_DESC indexDesc;
+
+		ZeroMemory(&indexDesc, sizeof(D3D11_BUFFER_DESC));
+
+		indexDesc.Usage = D3D11_USAGE_DYNAMIC;
+		indexDesc.ByteWidth = sizeof(UINT) * maxParticles * 6;
+		indexDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		indexDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		D3D11_SUBRESOURCE_DATA indexData;
+
+		ZeroMemory(&indexData, sizeof(D3D11_SUBRESOURCE_DATA));
+		indexData.pSysMem = indices.data();
+
+		hr = device->CreateBuffer(&indexDesc, &indexData, &indexBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Index buffer cannot be created");
+
+		// Build the vertex input layout used by fire_vs
+		hr = DXVertexParticle::createInputLayout(device, vsBytecode, &inputLayout);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Cannot create input layout interface");
+
+		D3D11_SAMPLER_DESC samplerDesc;
+
+		ZeroMemory(&samplerDesc, sizeof(D3D11_SAMPLER_DESC));
+
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.MaxAnisotropy = 16;
+		samplerDesc.MinLOD = 0.0f;
+		samplerDesc.MaxLOD = 0.0f;
+		samplerDesc.MipLODBias = 0.0f;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+
+		hr = device->CreateSamplerState(&samplerDesc, &linearSampler);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Cannot create sampler state interface");
+
+		stats.maxEffects = maxEffects;
+		stats.maxBlocks = maxBlocks;
+	}
+	catch (exception& e)
+	{
+		cout << "ParticleEffects object could not be instantiated due to:\n";
+		cout << e.what() << endl;
+
+		if (blockStorage)
+			_aligned_free(blockStorage);
+
+		if (sorter)
+			sorter->release();
+
+		if (vertexBuffer)
+			vertexBuffer->Release();
+
+		if (indexBuffer)
+			indexBuffer->Release();
+
+		if (inputLayout)
+			inputLayout->Release();
+
+		blockStorage = nullptr;
+		sorter = nullptr;
+		vertexBuffer = nullptr;
+		indexBuffer = nullptr;
+		inputLayout = nullptr;
+
+		// Leave no slots or blocks so spawn always fails
+		effects.clear();
+		freeEffects.clear();
+		freeBlock = PARTICLE_EFFECT_INVALID;
+		numFreeBlocks = maxBlocks = 0;
+	}
+}
+
+
+ParticleEffects::~ParticleEffects() {
+
+	if (blockStorage)
+		_aligned_free(blockStorage);
+	if (sorter)
+		sorter->release();
+	if (vertexBuffer)
+		vertexBuffer->Release();
+	if (indexBuffer)
+		indexBuffer->Release();
+	if (inputLayout)
+		inputLayout->Release();
+	if (linearSampler)
+		linearSampler->Release();
+
+	for (uint32_t i = 0; i < PARTICLE_EFFECT_MAX_TEXTURES; i++) {
+
+		if (textures[i])
+			textures[i]->Release();
+	}
+}
+
+
+void ParticleEffects::setTexture(const uint32_t index, ID3D11ShaderResourceView *tex_view) {
+
+	if (index >= PARTICLE_EFFECT_MAX_TEXTURES)
+		return;
+
+	if (textures[index])
+		textures[index]->Release();
+
+	textures[index] = tex_view;
+
+	if (textures[index])
+		textures[index]->AddRef(); // We didnt create it here but dont want it deleted by the creator untill we have deconstructed
+}
+
+
+//
+// Pool management
+//
+
+float* ParticleEffects::blockArray(const uint32_t block, const uint32_t array) {
+
+	return blockStorage + ((block * PARTICLE_EFFECT_NUM_ARRAYS) + array) * PARTICLE_EFFECT_BLOCK_SIZE;
+}
+
+
+ParticleSystem::ParticleArrays ParticleEffects::blockArrays(const uint32_t block) {
+
+	ParticleSystem::ParticleArrays A;
+
+	A.px = blockArray(block, 0);
+	A.py = blockArray(block, 1);
+	A.pz = blockArray(block, 2);
+	A.vx = blockArray(block, 3);
+	A.vy = blockArray(block, 4);
+	A.vz = blockArray(block, 5);
+	A.age = blockArray(block, 6);
+	A.life = blockArray(block, 7);
+
+	return A;
+}
+
+
+uint32_t ParticleEffects::allocateBlock() {
+
+	if (freeBlock == PARTICLE_EFFECT_INVALID)
+		return PARTICLE_EFFECT_INVALID;
+
+	uint32_t b = freeBlock;
+
+	freeBlock = blockNext[b];
+	blockNext[b] = PARTICLE_EFFECT_INVALID;
+	numFreeBlocks--;
+
+	return b;
+}
+
+
+void ParticleEffects::freeBlocks(uint32_t block) {
+
+	while (block != PARTICLE_EFFECT_INVALID) {
+
+		uint32_t next = blockNext[block];
+
+		blockNext[block] = freeBlock;
+		freeBlock = block;
+		numFreeBlocks++;
+
+		block = next;
+	}
+}
+
+
+uint32_t ParticleEffects::slotIndex(const uint32_t handle) const {
+
+	uint32_t slot = handle & PARTICLE_EFFECT_SLOT_MASK;
+
+	if (handle == PARTICLE_EFFECT_INVALID || slot >= effects.size())
+		return PARTICLE_EFFECT_INVALID;
+
+	const Effect& e = effects[slot];
+
+	if ((e.generation & PARTICLE_EFFECT_SLOT_MASK) != (handle >> 16) || e.activeIndex == PARTICLE_EFFECT_INVALID)
+		return PARTICLE_EFFECT_INVALID;
+
+	return slot;
+}
+
+
+void ParticleEffects::releaseSlot(const uint32_t slot) {
+
+	Effect& e = effects[slot];
+
+	freeBlocks(e.firstBlock);
+
+	// Swap the last active effect into the removed effect's position
+	uint32_t last = activeEffects.back();
+
+	activeEffects[e.activeIndex] = last;
+	effects[last].activeIndex = e.activeIndex;
+	activeEffects.pop_back();
+
+	e.firstBlock = e.lastBlock = PARTICLE_EFFECT_INVALID;
+	e.numParticles = 0;
+	e.activeIndex = PARTICLE_EFFECT_INVALID;
+	e.generation++;
+
+	freeEffects.push_back(slot);
+}
+
+
+//
+// Effect interface
+//
+
+uint32_t ParticleEffects::spawn(const ParticleEmitter& E, const uint32_t texture, FXMMATRIX worldMatrix, const float duration) {
+
+	if (freeEffects.empty() || texture >= PARTICLE_EFFECT_MAX_TEXTURES) {
+
+		stats.failedSpawns++;
+		return PARTICLE_EFFECT_INVALID;
+	}
+
+	uint32_t slot = freeEffects.back();
+
+	freeEffects.pop_back();
+
+	Effect& e = effects[slot];
+
+	e.emitter = E;
+	XMStoreFloat4x4(&e.worldMatrix, worldMatrix);
+	e.emitAccumulator = 0.0f;
+	e.emitTime = duration;
+	e.randomState = 0x9E3779B9 ^ ((slot + 1) * 0x85EBCA6B) ^ (e.generation * 0xC2B2AE35);
+	e.texture = texture;
+	e.firstBlock = e.lastBlock = PARTICLE_EFFECT_INVALID;
+	e.numParticles = 0;
+	e.activeIndex = (uint32_t)activeEffects.size();
+	e.visible = true;
+
+	if (e.randomState == 0)
+		e.randomState = 1;
+
+	activeEffects.push_back(slot);
+
+	return ((e.generation & PARTICLE_EFFECT_SLOT_MASK) << 16) | slot;
+}
+
+
+void ParticleEffects::stop(const uint32_t handle) {
+
+	uint32_t slot = slotIndex(handle);
+
+	if (slot != PARTICLE_EFFECT_INVALID)
+		effects[slot].emitTime = 0.0f;
+}
+
+
+void ParticleEffects::remove(const uint32_t handle) {
+
+	uint32_t slot = slotIndex(handle);
+
+	if (slot != PARTICLE_EFFECT_INVALID)
+		releaseSlot(slot);
+}
+
+
+bool ParticleEffects::isAlive(const uint32_t handle) const {
+
+	return slotIndex(handle) != PARTICLE_EFFECT_INVALID;
+}
+
+
+void ParticleEffects::setWorldMatrix(const uint32_t handle, FXMMATRIX worldMatrix) {
+
+	uint32_t slot = slotIndex(handle);
+
+	if (slot != PARTICLE_EFFECT_INVALID)
+		XMStoreFloat4x4(&effects[slot].worldMatrix, worldMatrix);
+}
+
+
+void ParticleEffects::setVisible(const uint32_t handle, const bool visible) {
+
+	uint32_t slot = slotIndex(handle);
+
+	if (slot != PARTICLE_EFFECT_INVALID)
+		effects[slot].visible = visible;
+}
+
+
+//
+// Simulation
+//
+
+// xorshift32 as ParticleSystem::randomSigned
+float ParticleEffects::randomSigned(uint32_t& state) {
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	return (float)(state >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+
+// Each block is integrated and compacted in place with the ParticleSystem kernels, then its survivors are moved to the write position.  The write position never passes the read position so the chain is compacted in place
+void ParticleEffects::simulateEffect(Effect& e, const float dt) {
+
+	uint32_t readBlock = e.firstBlock;
+	uint32_t writeBlock = e.firstBlock, writeIndex = 0;
+	uint32_t remaining = e.numParticles, numLive = 0;
+
+	while (readBlock != PARTICLE_EFFECT_INVALID && remaining > 0) {
+
+		uint32_t n = min(remaining, (uint32_t)PARTICLE_EFFECT_BLOCK_SIZE);
+
+		ParticleSystem::ParticleArrays R = blockArrays(readBlock);
+
+		uint32_t blockLive = ParticleSystem::IntegrateParticles(R, 0, n, e.emitter, dt);
+
+		if (blockLive < n)
+			ParticleSystem::CompactParticles(R, 0, n, R, 0);
+
+		// The survivors may straddle the end of the write block
+		for (uint32_t moved = 0; moved < blockLive;) {
+
+			uint32_t m = min(blockLive - moved, (uint32_t)PARTICLE_EFFECT_BLOCK_SIZE - writeIndex);
+
+			if (writeBlock != readBlock || writeIndex != moved) {
+
+				for (uint32_t k = 0; k < PARTICLE_EFFECT_NUM_ARRAYS; k++)
+					memmove(blockArray(writeBlock, k) + writeIndex, blockArray(readBlock, k) + moved, sizeof(float) * m);
+			}
+
+			moved += m;
+			writeIndex += m;
+
+			if (writeIndex == PARTICLE_EFFECT_BLOCK_SIZE) {
+
+				writeBlock = blockNext[writeBlock];
+				writeIndex = 0;
+			}
+		}
+
+		numLive += blockLive;
+		remaining -= n;
+		readBlock = blockNext[readBlock];
+	}
+
+	e.numParticles = numLive;
+}
+
+
+void ParticleEffects::trimEffect(Effect& e) {
+
+	if (e.numParticles == 0) {
+
+		freeBlocks(e.firstBlock);
+		e.firstBlock = e.lastBlock = PARTICLE_EFFECT_INVALID;
+		return;
+	}
+
+	uint32_t last = e.firstBlock;
+
+	for (uint32_t k = 1; k < (e.numParticles + PARTICLE_EFFECT_BLOCK_SIZE - 1) / PARTICLE_EFFECT_BLOCK_SIZE; k++)
+		last = blockNext[last];
+
+	freeBlocks(blockNext[last]);
+	blockNext[last] = PARTICLE_EFFECT_INVALID;
+	e.lastBlock = last;
+}
+
+
+// Emission as ParticleSystem::emit, taking a new block from the pool whenever the last block is full
+void ParticleEffects::emitEffect(Effect& e, const uint32_t n) {
+
+	const ParticleEmitter& E = e.emitter;
+
+	for (uint32_t k = 0; k < n; k++) {
+
+		uint32_t i = e.numParticles % PARTICLE_EFFECT_BLOCK_SIZE;
+
+		if (i == 0) {
+
+			uint32_t b = allocateBlock();
+
+			if (b == PARTICLE_EFFECT_INVALID) {
+
+				stats.droppedParticles += n - k;
+				return;
+			}
+
+			if (e.lastBlock == PARTICLE_EFFECT_INVALID)
+				e.firstBlock = b;
+			else
+				blockNext[e.lastBlock] = b;
+
+			e.lastBlock = b;
+		}
+
+		uint32_t b = e.lastBlock;
+
+		blockArray(b, 0)[i] = E.position.x + randomSigned(e.randomState) * E.positionSpread.x;
+		blockArray(b, 1)[i] = E.position.y + randomSigned(e.randomState) * E.positionSpread.y;
+		blockArray(b, 2)[i] = E.position.z + randomSigned(e.randomState) * E.positionSpread.z;
+
+		blockArray(b, 3)[i] = E.velocity.x + randomSigned(e.randomState) * E.velocitySpread.x;
+		blockArray(b, 4)[i] = E.velocity.y + randomSigned(e.randomState) * E.velocitySpread.y;
+		blockArray(b, 5)[i] = E.velocity.z + randomSigned(e.randomState) * E.velocitySpread.z;
+
+		blockArray(b, 6)[i] = 0.0f;
+		blockArray(b, 7)[i] = E.lifeMin + (randomSigned(e.randomState) * 0.5f + 0.5f) * (E.lifeMax - E.lifeMin);
+
+		e.numParticles++;
+	}
+}
+
+
+void ParticleEffects::update(const float dt, GUParallel *pool) {
+
+	// Simulate every effect.  Each task only touches the blocks of its own effects.  Capturing a pointer and a float keeps std::function from allocating
+	auto simulate = [this, dt](uint32_t begin, uint32_t end) {
+
+		for (uint32_t k = begin; k < end; k++)
+			simulateEffect(effects[activeEffects[k]], dt);
+	};
+
+	if (pool)
+		pool->parallelFor((uint32_t)activeEffects.size(), PARTICLE_EFFECT_TASK_SIZE, simulate);
+	else
+		simulate(0, (uint32_t)activeEffects.size());
+
+	// Trim, emit and remove on the calling thread since they share the block pool and the active list.  Iterate backwards so effects removed during the loop (swapped with the last active effect) are not skipped
+	for (uint32_t k = (uint32_t)activeEffects.size(); k-- > 0;) {
+
+		uint32_t slot = activeEffects[k];
+		Effect& e = effects[slot];
+
+		trimEffect(e);
+
+		bool emitting = (e.emitTime != 0.0f);
+
+		if (emitting) {
+
+			float t = (e.emitTime > 0.0f) ? min(dt, e.emitTime) : dt;
+
+			e.emitAccumulator += e.emitter.rate * t;
+
+			uint32_t n = (uint32_t)e.emitAccumulator;
+
+			e.emitAccumulator -= (float)n;
+
+			emitEffect(e, n);
+
+			if (e.emitTime > 0.0f)
+				e.emitTime = max(e.emitTime - dt, 0.0f);
+		}
+
+		// Finished effects are removed once their last particle has died
+		if (!emitting && e.numParticles == 0)
+			releaseSlot(slot);
+	}
+}
+
+
+//
+// Rendering
+//
+
+void ParticleEffects::upload(ID3D11DeviceContext *context, GUParallel *pool) {
+
+	numDrawn = 0;
+
+	for (uint32_t t = 0; t < PARTICLE_EFFECT_MAX_TEXTURES; t++) {
+
+		batchStart[t] = batchCount[t] = 0;
+		batchOrder[t] = t;
+	}
+
+	if (!context || !vertexBuffer)
+		return;
+
+	// Count the particles drawn with each texture and lay the batches out one after another
+	for (uint32_t k = 0; k < activeEffects.size(); k++) {
+
+		const Effect& e = effects[activeEffects[k]];
+
+		if (e.visible)
+			batchCount[e.texture] += e.numParticles;
+	}
+
+	for (uint32_t t = 0; t < PARTICLE_EFFECT_MAX_TEXTURES; t++) {
+
+		batchStart[t] = numDrawn;
+		numDrawn += batchCount[t];
+	}
+
+	if (numDrawn == 0)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE res;
+
+	if (!SUCCEEDED(context->Map(vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &res))) {
+
+		numDrawn = 0;
+		return;
+	}
+
+	DXVertexParticle *vertices = (DXVertexParticle*)res.pData;
+
+	static const XMFLOAT3 corners[4] = { XMFLOAT3(-1.0f, -1.0f, 0.0f), XMFLOAT3(-1.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, -1.0f, 0.0f) };
+
+	// Each texture is one task that writes its effects into the batch in active order.  Positions and velocities are moved to world space and the billboard is scaled by the world transform (data.z) so fire_vs can draw every effect with one view-projection transform.  Capturing two pointers keeps std::function from allocating
+	auto expand = [this, vertices](uint32_t begin, uint32_t end) {
+
+		for (uint32_t t = begin; t < end; t++) {
+
+			uint32_t j = batchStart[t];
+
+			for (uint32_t k = 0; k < activeEffects.size(); k++) {
+
+				Effect& e = effects[activeEffects[k]];
+
+				if (!e.visible || e.texture != t)
+					continue;
+
+				XMMATRIX W = XMLoadFloat4x4(&e.worldMatrix);
+				float scale = XMVectorGetX(XMVector3Length(W.r[0]));
+
+				uint32_t block = e.firstBlock, remaining = e.numParticles;
+
+				while (block != PARTICLE_EFFECT_INVALID && remaining > 0) {
+
+					uint32_t n = min(remaining, (uint32_t)PARTICLE_EFFECT_BLOCK_SIZE);
+
+					const float *px = blockArray(block, 0), *py = blockArray(block, 1), *pz = blockArray(block, 2);
+					const float *vx = blockArray(block, 3), *vy = blockArray(block, 4), *vz = blockArray(block, 5);
+					const float *age = blockArray(block, 6), *life = blockArray(block, 7);
+
+					for (uint32_t i = 0; i < n; i++, j++) {
+
+						XMFLOAT3 pos, vel;
+
+						XMStoreFloat3(&pos, XMVector3TransformCoord(XMVectorSet(px[i], py[i], pz[i], 1.0f), W));
+						XMStoreFloat3(&vel, XMVector3TransformNormal(XMVectorSet(vx[i], vy[i], vz[i], 0.0f), W));
+
+						XMFLOAT3 data = XMFLOAT3(age[i], life[i], scale);
+
+						drawnPositions[j] = pos;
+
+						for (int c = 0; c < 4; c++) {
+
+							DXVertexParticle& v = vertices[j * 4 + c];
+
+							v.pos = pos;
+							v.posL = corners[c];
+							v.velocity = vel;
+							v.data = data;
+						}
+					}
+
+					remaining -= n;
+					block = blockNext[block];
+				}
+			}
+		}
+	};
+
+	if (pool)
+		pool->parallelFor(PARTICLE_EFFECT_MAX_TEXTURES, 1, expand);
+	else
+		expand(0, PARTICLE_EFFECT_MAX_TEXTURES);
+
+	context->Unmap(vertexBuffer, 0);
+
+	// upload leaves the index buffer in vertex order
+	if (!SUCCEEDED(context->Map(indexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &res)))
+		return;
+
+	UINT *indices = (UINT*)res.pData;
+
+	for (uint32_t i = 0; i < numDrawn; i++) {
+
+		UINT v = i * 4;
+
+		indices[(i * 6) + 0] = v + 2;
+		indices[(i * 6) + 1] = v + 1;
+		indices[(i * 6) + 2] = v + 0;
+
+		indices[(i * 6) + 3] = v + 0;
+		indices[(i * 6) + 4] = v + 3;
+		indices[(i * 6) + 5] = v + 2;
+	}
+
+	context->Unmap(indexBuffer, 0);
+}
+
+
+// View depth is quantised over the depth range of each batch and inverted so an ascending sort puts the furthest particle first
+void ParticleEffects::sortByDepth(ID3D11DeviceContext *context, FXMMATRIX viewMatrix, GUParallel *pool) {
+
+	if (!context || !sorter || !indexBuffer || numDrawn == 0)
+		return;
+
+	XMFLOAT4X4 V;
+
+	XMStoreFloat4x4(&V, viewMatrix);
+
+	float batchDepth[PARTICLE_EFFECT_MAX_TEXTURES];
+
+	D3D11_MAPPED_SUBRESOURCE res;
+
+	if (!SUCCEEDED(context->Map(indexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &res)))
+		return;
+
+	UINT *indices = (UINT*)res.pData;
+
+	for (uint32_t t = 0; t < PARTICLE_EFFECT_MAX_TEXTURES; t++) {
+
+		uint32_t first = batchStart[t], n = batchCount[t];
+
+		batchDepth[t] = -FLT_MAX;
+
+		if (n == 0)
+			continue;
+
+		// sortKeys and sortOrder have capacity for every particle so resizing does not allocate
+		sortKeys.resize(n);
+		sortOrder.resize(n);
+
+		float minDepth = FLT_MAX, maxDepth = -FLT_MAX, sumDepth = 0.0f;
+
+		for (uint32_t i = 0; i < n; i++) {
+
+			const XMFLOAT3& p = drawnPositions[first + i];
+
+			float z = p.x * V._13 + p.y * V._23 + p.z * V._33 + V._43;
+
+			minDepth = min(minDepth, z);
+			maxDepth = max(maxDepth, z);
+			sumDepth += z;
+		}
+
+		batchDepth[t] = sumDepth / (float)n;
+
+		float keyScale = (maxDepth > minDepth) ? (float)((1 << 16) - 1) / (maxDepth - minDepth) : 0.0f;
+
+		for (uint32_t i = 0; i < n; i++) {
+
+			const XMFLOAT3& p = drawnPositions[first + i];
+
+			float z = p.x * V._13 + p.y * V._23 + p.z * V._33 + V._43;
+
+			sortKeys[i] = (uint32_t)((maxDepth - z) * keyScale);
+			sortOrder[i] = i;
+		}
+
+		sorter->sort(sortKeys.data(), sortOrder.data(), n, pool);
+
+		for (uint32_t i = 0; i < n; i++) {
+
+			UINT v = (first + sortOrder[i]) * 4;
+			UINT *q = indices + (first + i) * 6;
+
+			q[0] = v + 2;
+			q[1] = v + 1;
+			q[2] = v + 0;
+
+			q[3] = v + 0;
+			q[4] = v + 3;
+			q[5] = v + 2;
+		}
+	}
+
+	context->Unmap(indexBuffer, 0);
+
+	// Draw the furthest batch first.  Insertion sort keeps batches at the same depth in texture order
+	for (uint32_t k = 1; k < PARTICLE_EFFECT_MAX_TEXTURES; k++) {
+
+		uint32_t t = batchOrder[k], j = k;
+
+		for (; j > 0 && batchDepth[batchOrder[j - 1]] < batchDepth[t]; j--)
+			batchOrder[j] = batchOrder[j - 1];
+
+		batchOrder[j] = t;
+	}
+}
+
+
+void ParticleEffects::render(ID3D11DeviceContext *context) {
+
+	stats.drawCalls = 0;
+
+	// Validate object before rendering (see notes in constructor)
+	if (!context || !vertexBuffer || !inputLayout || numDrawn == 0)
+		return;
+
+	// Set vertex layout
+	context->IASetInputLayout(inputLayout);
+
+	// Set vertex and index buffers for IA
+	ID3D11Buffer* vertexBuffers[] = { vertexBuffer };
+	UINT vertexStrides[] = { sizeof(DXVertexParticle) };
+	UINT vertexOffsets[] = { 0 };
+
+	context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, vertexOffsets);
+	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	context->PSSetSamplers(0, 1, &linearSampler);
+
+	// One draw per texture in use
+	for (uint32_t k = 0; k < PARTICLE_EFFECT_MAX_TEXTURES; k++) {
+
+		uint32_t t = batchOrder[k];
+
+		if (batchCount[t] == 0 || !textures[t])
+			continue;
+
+		context->PSSetShaderResources(0, 1, &textures[t]);
+		context->DrawIndexed(batchCount[t] * 6, batchStart[t] * 6, 0);
+
+		stats.drawCalls++;
+	}
+}
+
+
+ParticleEffectStats ParticleEffects::getStats() const {
+
+	ParticleEffectStats S = stats;
+
+	S.liveEffects = (uint32_t)activeEffects.size();
+	S.usedBlocks = maxBlocks - numFreeBlocks;
+	S.liveParticles = 0;
+
+	for (uint32_t k = 0; k < activeEffects.size(); k++)
+		S.liveParticles += effects[activeEffects[k]].numParticles;
+
+	return S;
+}
+
+
+void ParticleEffects::readParticles(const uint32_t handle, vector<XMFLOAT4>& particles) const {
+
+	particles.clear();
+
+	uint32_t slot = slotIndex(handle);
+
+	if (slot == PARTICLE_EFFECT_INVALID)
+		return;
+
+	const Effect& e = effects[slot];
+
+	uint32_t block = e.firstBlock, remaining = e.numParticles;
+
+	while (block != PARTICLE_EFFECT_INVALID && remaining > 0) {
+
+		const float *B = blockStorage + block * PARTICLE_EFFECT_NUM_ARRAYS * PARTICLE_EFFECT_BLOCK_SIZE;
+		uint32_t n = min(remaining, (uint32_t)PARTICLE_EFFECT_BLOCK_SIZE);
+
+		for (uint32_t i = 0; i < n; i++)
+			particles.push_back(XMFLOAT4(B[i], B[PARTICLE_EFFECT_BLOCK_SIZE + i], B[PARTICLE_EFFECT_BLOCK_SIZE * 2 + i], B[PARTICLE_EFFECT_BLOCK_SIZE * 6 + i]));
+
+		remaining -= n;
+		block = blockNext[block];
+	}
+}
+
+
+void ParticleEffects::markSteadyState() {
+
+	steadyStateAllocations = gu_memory_allocations();
+}
+
+
+bool ParticleEffects::steadyStateAllocationFree() const {
+
+	return gu_memory_allocations() == steadyStateAllocations;
+}
+
+
+DXBoundingVolume ParticleEffects::EmitterBounds(const ParticleEmitter& E) {
+
+	float L = max(E.lifeMin, E.lifeMax);
+
+	// Largest billboard half extent (fire_vs grows the quad with age and makes it twice as tall as it is wide).  The billboard faces the camera so it can extend along any axis
+	float halfSize = (0.2f * L + 0.4f) * 2.0f;
+
+	const float *p = &E.position.x, *ps = &E.positionSpread.x;
+	const float *v = &E.velocity.x, *vs = &E.velocitySpread.x, *g = &E.gravity.x;
+
+	XMFLOAT3 lo, hi;
+	float *l = &lo.x, *h = &hi.x;
+
+	// Drag only slows particles so the drag-free travel bounds the motion
+	for (int a = 0; a < 3; a++) {
+
+		l[a] = p[a] - ps[a] + min(v[a] - vs[a], 0.0f) * L + 0.5f * min(g[a], 0.0f) * L * L - halfSize;
+		h[a] = p[a] + ps[a] + max(v[a] + vs[a], 0.0f) * L + 0.5f * max(g[a], 0.0f) * L * L + halfSize;
+	}
+
+	if (E.groundHeight != PARTICLE_NO_GROUND)
+		lo.y = max(lo.y, E.groundHeight - halfSize);
+
+	return DXBoundingVolume(XMFLOAT3((lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f), XMFLOAT3((hi.x - lo.x) * 0.5f, (hi.y - lo.y) * 0.5f, (hi.z - lo.z) * 0.5f));
+}
@@ -0,0 +1,180 @@
+
+//
+// ParticleEffects.h
+//
+
+// Pool of billboarded particle effect instances (fire, smoke, spray...) that can be spawned and removed at run time without heap allocation.  Effect slots and particle storage are allocated once when the pool is created.  Particles are held in fixed size blocks of SoA arrays taken from a shared free list, and each effect owns a chain of blocks that grows as it emits and shrinks as its particles die.  Every effect is simulated in its own object space and placed in the scene by a world transform.  upload expands the particles of the visible effects into world space quads, grouped by texture, so all the effects sharing a texture are drawn with a single DrawIndexed call.  Each effect uses a ParticleEmitter and follows the same emission rules as ParticleSystem, and its blocks are integrated and compacted with the ParticleSystem kernels.
+
+#pragma once
+
+#include <GUObject.h>
+#include <ParticleSystem.h>
+#include <DXBoundingVolume.h>
+#include <DXVertexParticle.h>
+#include <d3d11_2.h>
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+
+class DXBlob;
+class GUParallel;
+class GURadixSort;
+
+
+// Number of particles in each pooled block (a multiple of PARTICLE_LANES)
+#define PARTICLE_EFFECT_BLOCK_SIZE			64
+
+// Number of effects simulated by each parallel task
+#define PARTICLE_EFFECT_TASK_SIZE			8
+
+// Number of textures effects can be drawn with.  Each texture in use costs one draw call
+#define PARTICLE_EFFECT_MAX_TEXTURES		4
+
+// Handle returned when an effect cannot be spawned and held by removed effects
+#define PARTICLE_EFFECT_INVALID				0xFFFFFFFF
+
+
+// Pool occupancy
+struct ParticleEffectStats {
+
+	uint32_t							liveEffects;
+	uint32_t							maxEffects;
+	uint32_t							usedBlocks;
+	uint32_t							maxBlocks;
+	uint32_t							liveParticles;
+	uint32_t							drawCalls; // Draws issued by the last render
+	uint32_t							failedSpawns; // Spawns refused because every effect slot was in use
+	uint32_t							droppedParticles; // Emitted particles lost because the block pool was empty
+};
+
+
+class ParticleEffects : public GUObject {
+
+	// Effect slot.  Particles fill the blocks of the chain in order so only the last block is partly used
+	struct Effect {
+
+		ParticleEmitter					emitter;
+		DirectX::XMFLOAT4X4				worldMatrix;
+		float							emitAccumulator;
+		float							emitTime; // Seconds of emission left (< 0 emits until stopped)
+		uint32_t						randomState;
+		uint32_t						texture;
+		uint32_t						firstBlock, lastBlock;
+		uint32_t						numParticles;
+		uint32_t						generation; // Incremented when the slot is freed so stale handles are ignored
+		uint32_t						activeIndex; // Position in activeEffects
+		bool							visible;
+	};
+
+	std::vector<Effect>					effects;
+	std::vector<uint32_t>				freeEffects; // Stack of unused effect slots
+	std::vector<uint32_t>				activeEffects; // Slots in use, in no particular order
+
+	// Block pool.  Block b holds PARTICLE_EFFECT_BLOCK_SIZE entries of px, py, pz, vx, vy, vz, age and life from blockStorage + b * PARTICLE_EFFECT_BLOCK_SIZE * 8
+	float								*blockStorage = nullptr;
+	std::vector<uint32_t>				blockNext; // Next block in the owning effect's chain, or the next free block
+	uint32_t							freeBlock = PARTICLE_EFFECT_INVALID;
+	uint32_t							numFreeBlocks = 0;
+	uint32_t							maxBlocks = 0;
+
+	ParticleEffectStats					stats;
+	unsigned long						steadyStateAllocations = 0;
+
+	// Drawn particles of each texture occupy [batchStart, batchStart + batchCount) of the vertex buffer (4 vertices per particle)
+	uint32_t							batchStart[PARTICLE_EFFECT_MAX_TEXTURES];
+	uint32_t							batchCount[PARTICLE_EFFECT_MAX_TEXTURES];
+	uint32_t							batchOrder[PARTICLE_EFFECT_MAX_TEXTURES]; // Texture drawn by each batch
+	uint32_t							numDrawn = 0;
+
+	// World space centre of each drawn particle, used by sortByDepth
+	std::vector<DirectX::XMFLOAT3>		drawnPositions;
+
+	// Back-to-front sort of each batch
+	GURadixSort							*sorter = nullptr;
+	std::vector<uint32_t>				sortKeys;
+	std::vector<uint32_t>				sortOrder;
+
+	ID3D11Buffer						*vertexBuffer = nullptr;
+	ID3D11Buffer						*indexBuffer = nullptr;
+	ID3D11InputLayout					*inputLayout = nullptr;
+	ID3D11ShaderResourceView			*textures[PARTICLE_EFFECT_MAX_TEXTURES];
+	ID3D11SamplerState					*linearSampler = nullptr;
+
+	float* blockArray(const uint32_t block, const uint32_t array);
+	ParticleSystem::ParticleArrays blockArrays(const uint32_t block);
+
+	// Take a block from the pool, or return PARTICLE_EFFECT_INVALID if the pool is empty
+	uint32_t allocateBlock();
+
+	// Return the chain of blocks starting at block to the pool
+	void freeBlocks(uint32_t block);
+
+	// Return the slot index of a live effect, or PARTICLE_EFFECT_INVALID for a stale or invalid handle
+	uint32_t slotIndex(const uint32_t handle) const;
+
+	void releaseSlot(const uint32_t slot);
+
+	// Integrate the particles of an effect and compact the survivors towards the start of its chain.  Only touches the effect's own blocks so effects can be simulated in parallel
+	void simulateEffect(Effect& e, const float dt);
+
+	// Return the blocks past the last live particle of an effect to the pool
+	void trimEffect(Effect& e);
+
+	void emitEffect(Effect& e, const uint32_t n);
+
+	// Uniform random number in [-1, 1]
+	static float randomSigned(uint32_t& state);
+
+	// Not copyable.  A copy would share and free the same blocks and Direct3D resources.  Declared but not defined
+	ParticleEffects(const ParticleEffects&);
+	ParticleEffects& operator=(const ParticleEffects&);
+
+public:
+
+	ParticleEffects(ID3D11Device *device, DXBlob *vsBytecode, const uint32_t maxEffects, const uint32_t initMaxBlocks);
+	~ParticleEffects();
+
+	// Set the texture drawn by effects spawned with the given texture index
+	void setTexture(const uint32_t index, ID3D11ShaderResourceView *tex_view);
+
+	// Start a new effect and return its handle (PARTICLE_EFFECT_INVALID if every slot is in use).  The effect emits for duration seconds (< 0 until stop is called) and is removed once it has stopped and its last particle has died
+	uint32_t spawn(const ParticleEmitter& E, const uint32_t texture, DirectX::FXMMATRIX worldMatrix, const float duration = -1.0f);
+
+	// Stop emitting.  The remaining particles live out their lifetime
+	void stop(const uint32_t handle);
+
+	// Remove an effect and its particles immediately
+	void remove(const uint32_t handle);
+
+	// Return true if handle refers to an effect that has not been removed
+	bool isAlive(const uint32_t handle) const;
+
+	void setWorldMatrix(const uint32_t handle, DirectX::FXMMATRIX worldMatrix);
+
+	// Invisible effects are simulated but not drawn (for example when culled)
+	void setVisible(const uint32_t handle, const bool visible);
+
+	// Simulate and emit every effect over dt seconds.  Effects are simulated on pool if one is given
+	void update(const float dt, GUParallel *pool = nullptr);
+
+	// Expand the particles of the visible effects into world space quads batched by texture.  Batches are expanded on pool if one is given
+	void upload(ID3D11DeviceContext *context, GUParallel *pool = nullptr);
+
+	// Sort the particles of each batch back to front for the given view transform and draw the batches back to front by their mean depth
+	void sortByDepth(ID3D11DeviceContext *context, DirectX::FXMMATRIX viewMatrix, GUParallel *pool = nullptr);
+
+	// Draw every batch.  The caller sets the fire shaders and a constant buffer with the view-projection transform, as the quads are already in world space
+	void render(ID3D11DeviceContext *context);
+
+	ParticleEffectStats getStats() const;
+
+	// Copy the object-space position (xyz) and age (w) of each particle of an effect in emission order.  Intended for debugging and for comparing against ParticleSystem
+	void readParticles(const uint32_t handle, std::vector<DirectX::XMFLOAT4>& particles) const;
+
+	// Record the heap allocation count (see gu_memory_allocations).  Once the effects have warmed up, steadyStateAllocationFree returns false if anything has allocated since, so tests can check spawning, simulation and drawing do not allocate.  Allocations are only counted when __GU_DEBUG_MEMORY__ is defined
+	void markSteadyState();
+	bool steadyStateAllocationFree() const;
+
+	// Object-space bounds enclosing every particle billboard an emitter can produce over its lifetime (the billboard size follows fire_vs)
+	static DXBoundingVolume EmitterBounds(const ParticleEmitter& E);
+};
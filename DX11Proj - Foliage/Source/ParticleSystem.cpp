@@ -0,0 +1,372 @@
+
+//
+// ParticleSystem.cpp
+//
+
+#include <stdafx.h>
+#include <ParticleSystem.h>
+#include <GUParallel.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Number of float arrays in each particle buffer
+#define PARTICLE_NUM_ARRAYS			8
+
+// Array stride granularity in floats.  The block is 32 byte aligned and every array starts a multiple of 8 floats into it, so every array is 32 byte aligned too
+#define PARTICLE_STRIDE_ALIGNMENT	8
+
+
+// Return a bitmask with bit i set if lane i of the comparison result V is true
+static inline int laneMask(FXMVECTOR V) {
+
+#if defined(_XM_SSE_INTRINSICS_)
+
+	return _mm_movemask_ps(V);
+
+#else
+
+	XMUINT4 u;
+	XMStoreUInt4(&u, V);
+
+	return (u.x & 1) | ((u.y & 1) << 1) | ((u.z & 1) << 2) | ((u.w & 1) << 3);
+
+#endif
+}
+
+
+// Point the particle arrays of a buffer at consecutive stride sized arrays from base
+static void setArrays(float *base, const uint32_t stride, float **px, float **py, float **pz, float **vx, float **vy, float **vz, float **age, float **life) {
+
+	*px = base;
+	*py = base + stride;
+	*pz = base + stride * 2;
+	*vx = base + stride * 3;
+	*vy = base + stride * 4;
+	*vz = base + stride * 5;
+	*age = base + stride * 6;
+	*life = base + stride * 7;
+}
+
+
+// Number of set bits in a 4 bit lane mask
+static inline uint32_t laneCount(const int mask) {
+
+	static const uint32_t bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+	return bits[mask & 0xF];
+}
+
+
+
+ParticleEmitter::ParticleEmitter() {
+
+	position = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	rate = 0.0f;
+	positionSpread = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	lifeMin = 1.0f;
+	velocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	lifeMax = 1.0f;
+	velocitySpread = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	drag = 0.0f;
+	gravity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	groundHeight = PARTICLE_NO_GROUND;
+	restitution = 0.0f;
+	padding[0] = padding[1] = padding[2] = 0.0f;
+}
+
+
+
+ParticleSystem::ParticleSystem(const uint32_t maxParticles) {
+
+	capacity = maxParticles;
+	stride = max((maxParticles + PARTICLE_STRIDE_ALIGNMENT - 1) & ~(PARTICLE_STRIDE_ALIGNMENT - 1), (uint32_t)PARTICLE_STRIDE_ALIGNMENT);
+
+	block = (float*)_aligned_malloc(sizeof(float) * stride * PARTICLE_NUM_ARRAYS * 2, PARTICLE_STRIDE_ALIGNMENT * sizeof(float));
+
+	if (!block) {
+
+		capacity = stride = 0;
+		return;
+	}
+
+	setArrays(block, stride, &front.px, &front.py, &front.pz, &front.vx, &front.vy, &front.vz, &front.age, &front.life);
+	setArrays(block + stride * PARTICLE_NUM_ARRAYS, stride, &back.px, &back.py, &back.pz, &back.vx, &back.vy, &back.vz, &back.age, &back.life);
+
+	// Padding lanes are simulated with the live particles so keep them finite
+	memset(block, 0, sizeof(float) * stride * PARTICLE_NUM_ARRAYS * 2);
+}
+
+
+ParticleSystem::~ParticleSystem() {
+
+	if (block)
+		_aligned_free(block);
+}
+
+
+void ParticleSystem::setEmitter(const ParticleEmitter& E) {
+
+	emitter = E;
+}
+
+
+const ParticleEmitter& ParticleSystem::getEmitter() const {
+
+	return emitter;
+}
+
+
+// xorshift32 - fast and good enough for visual effects
+float ParticleSystem::randomSigned() {
+
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+
+	return (float)(randomState >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+
+uint32_t ParticleSystem::emit(const uint32_t n) {
+
+	uint32_t numEmitted = min(n, capacity - numParticles);
+
+	const ParticleEmitter& E = emitter;
+
+	for (uint32_t i = numParticles; i < numParticles + numEmitted; i++) {
+
+		front.px[i] = E.position.x + randomSigned() * E.positionSpread.x;
+		front.py[i] = E.position.y + randomSigned() * E.positionSpread.y;
+		front.pz[i] = E.position.z + randomSigned() * E.positionSpread.z;
+
+		front.vx[i] = E.velocity.x + randomSigned() * E.velocitySpread.x;
+		front.vy[i] = E.velocity.y + randomSigned() * E.velocitySpread.y;
+		front.vz[i] = E.velocity.z + randomSigned() * E.velocitySpread.z;
+
+		front.age[i] = 0.0f;
+		front.life[i] = E.lifeMin + (randomSigned() * 0.5f + 0.5f) * (E.lifeMax - E.lifeMin);
+	}
+
+	numParticles += numEmitted;
+
+	return numEmitted;
+}
+
+
+// Semi-implicit Euler - velocity is updated first and the new velocity moves the particle
+uint32_t ParticleSystem::IntegrateParticles(const ParticleArrays& A, const uint32_t begin, const uint32_t end, const ParticleEmitter& E, const float dt) {
+
+	XMVECTOR t = XMVectorReplicate(dt);
+	XMVECTOR gx = XMVectorReplicate(E.gravity.x * dt);
+	XMVECTOR gy = XMVectorReplicate(E.gravity.y * dt);
+	XMVECTOR gz = XMVectorReplicate(E.gravity.z * dt);
+	XMVECTOR damping = XMVectorReplicate(max(1.0f - E.drag * dt, 0.0f));
+	XMVECTOR ground = XMVectorReplicate(E.groundHeight);
+	XMVECTOR bounce = XMVectorReplicate(-E.restitution);
+
+	uint32_t numLive = 0;
+
+	for (uint32_t i = begin; i < end; i += PARTICLE_LANES) {
+
+		XMVECTOR vx = XMVectorAdd(XMVectorMultiply(XMLoadFloat4A((const XMFLOAT4A*)(A.vx + i)), damping), gx);
+		XMVECTOR vy = XMVectorAdd(XMVectorMultiply(XMLoadFloat4A((const XMFLOAT4A*)(A.vy + i)), damping), gy);
+		XMVECTOR vz = XMVectorAdd(XMVectorMultiply(XMLoadFloat4A((const XMFLOAT4A*)(A.vz + i)), damping), gz);
+
+		XMVECTOR px = XMVectorMultiplyAdd(vx, t, XMLoadFloat4A((const XMFLOAT4A*)(A.px + i)));
+		XMVECTOR py = XMVectorMultiplyAdd(vy, t, XMLoadFloat4A((const XMFLOAT4A*)(A.py + i)));
+		XMVECTOR pz = XMVectorMultiplyAdd(vz, t, XMLoadFloat4A((const XMFLOAT4A*)(A.pz + i)));
+
+		// Particles that pass below the ground are put back on it and their vertical velocity reflected
+		XMVECTOR below = XMVectorLess(py, ground);
+
+		py = XMVectorSelect(py, ground, below);
+		vy = XMVectorSelect(vy, XMVectorMultiply(vy, bounce), XMVectorAndInt(below, XMVectorLess(vy, XMVectorZero())));
+
+		XMVECTOR age = XMVectorAdd(XMLoadFloat4A((const XMFLOAT4A*)(A.age + i)), t);
+
+		XMStoreFloat4A((XMFLOAT4A*)(A.px + i), px);
+		XMStoreFloat4A((XMFLOAT4A*)(A.py + i), py);
+		XMStoreFloat4A((XMFLOAT4A*)(A.pz + i), pz);
+		XMStoreFloat4A((XMFLOAT4A*)(A.vx + i), vx);
+		XMStoreFloat4A((XMFLOAT4A*)(A.vy + i), vy);
+		XMStoreFloat4A((XMFLOAT4A*)(A.vz + i), vz);
+		XMStoreFloat4A((XMFLOAT4A*)(A.age + i), age);
+
+		// Count the live particles, ignoring padding lanes past the end of the block
+		int mask = laneMask(XMVectorLess(age, XMLoadFloat4A((const XMFLOAT4A*)(A.life + i))));
+
+		if (end - i < PARTICLE_LANES)
+			mask &= (1 << (end - i)) - 1;
+
+		numLive += laneCount(mask);
+	}
+
+	return numLive;
+}
+
+
+void ParticleSystem::CompactParticles(const ParticleArrays& src, const uint32_t begin, const uint32_t end, const ParticleArrays& dst, const uint32_t offset) {
+
+	uint32_t j = offset;
+
+	for (uint32_t i = begin; i < end; i++) {
+
+		if (src.age[i] < src.life[i]) {
+
+			dst.px[j] = src.px[i];
+			dst.py[j] = src.py[i];
+			dst.pz[j] = src.pz[i];
+			dst.vx[j] = src.vx[i];
+			dst.vy[j] = src.vy[i];
+			dst.vz[j] = src.vz[i];
+			dst.age[j] = src.age[i];
+			dst.life[j] = src.life[i];
+			j++;
+		}
+	}
+}
+
+
+void ParticleSystem::simulate(const float dt, GUParallel *pool) {
+
+	if (numParticles == 0)
+		return;
+
+	uint32_t numBlocks = (numParticles + PARTICLE_BLOCK_SIZE - 1) / PARTICLE_BLOCK_SIZE;
+
+	blockLive.resize(numBlocks);
+	blockOffset.resize(numBlocks);
+
+	// Integrate every block and count its live particles
+	auto integrate = [&](uint32_t begin, uint32_t end) {
+
+		blockLive[begin / PARTICLE_BLOCK_SIZE] = IntegrateParticles(front, begin, end, emitter, dt);
+	};
+
+	if (pool) {
+
+		pool->parallelFor(numParticles, PARTICLE_BLOCK_SIZE, integrate);
+
+	} else {
+
+		for (uint32_t b = 0; b < numBlocks; b++)
+			integrate(b * PARTICLE_BLOCK_SIZE, min((b + 1) * PARTICLE_BLOCK_SIZE, numParticles));
+	}
+
+	// Exclusive prefix sum of the live counts gives the output offset of each block
+	uint32_t numLive = 0;
+
+	for (uint32_t b = 0; b < numBlocks; b++) {
+
+		blockOffset[b] = numLive;
+		numLive += blockLive[b];
+	}
+
+	if (numLive == numParticles)
+		return;
+
+	// Compact the live particles into the back buffer and swap
+	auto compact = [&](uint32_t begin, uint32_t end) {
+
+		CompactParticles(front, begin, end, back, blockOffset[begin / PARTICLE_BLOCK_SIZE]);
+	};
+
+	if (pool) {
+
+		pool->parallelFor(numParticles, PARTICLE_BLOCK_SIZE, compact);
+
+	} else {
+
+		for (uint32_t b = 0; b < numBlocks; b++)
+			compact(b * PARTICLE_BLOCK_SIZE, min((b + 1) * PARTICLE_BLOCK_SIZE, numParticles));
+	}
+
+	swap(front, back);
+
+	numParticles = numLive;
+}
+
+
+void ParticleSystem::update(const float dt, GUParallel *pool) {
+
+	simulate(dt, pool);
+
+	emitAccumulator += emitter.rate * dt;
+
+	uint32_t n = (uint32_t)emitAccumulator;
+
+	emitAccumulator -= (float)n;
+
+	emit(n);
+}
+
+
+void ParticleSystem::clear() {
+
+	numParticles = 0;
+	emitAccumulator = 0.0f;
+}
+
+
+uint32_t ParticleSystem::particleCount() const {
+
+	return numParticles;
+}
+
+
+uint32_t ParticleSystem::getCapacity() const {
+
+	return capacity;
+}
+
+
+const float* ParticleSystem::getPositionX() const {
+
+	return front.px;
+}
+
+
+const float* ParticleSystem::getPositionY() const {
+
+	return front.py;
+}
+
+
+const float* ParticleSystem::getPositionZ() const {
+
+	return front.pz;
+}
+
+
+const float* ParticleSystem::getVelocityX() const {
+
+	return front.vx;
+}
+
+
+const float* ParticleSystem::getVelocityY() const {
+
+	return front.vy;
+}
+
+
+const float* ParticleSystem::getVelocityZ() const {
+
+	return front.vz;
+}
+
+
+const float* ParticleSystem::getAge() const {
+
+	return front.age;
+}
+
+
+const float* ParticleSystem::getLife() const {
+
+	return front.life;
+}
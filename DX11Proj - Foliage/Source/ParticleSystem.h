@@ -0,0 +1,129 @@
+
+//
+// ParticleSystem.h
+//
+
+// CPU particle simulation with structure-of-arrays (SoA) storage.  Position, velocity, age and lifetime are held in separate aligned arrays so integration runs 4 particles at a time (SSE via DirectXMath) and the particle range can be split into blocks simulated in parallel on a GUParallel thread pool.  Each step integrates velocity (gravity and drag), position (with an optional bounce off a ground plane) and age, then removes expired particles by compacting the live ones into a second set of arrays at offsets found from the per-block live counts, so the particles are always contiguous in [0, particleCount()).  New particles are emitted at the end of the arrays from a ParticleEmitter.  The simulation does not depend on Direct3D so it can be run and timed on the CPU alone.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+class GUParallel;
+
+
+// Number of particles processed per SIMD iteration
+#define PARTICLE_LANES				4
+
+// Number of particles simulated by each parallel task (a multiple of PARTICLE_LANES)
+#define PARTICLE_BLOCK_SIZE			16384
+
+// Ground height used when ground collisions are disabled
+#define PARTICLE_NO_GROUND			-1.0e30f
+
+
+// Emitter and simulation parameters.  Members are packed in 16 byte rows so the structure can be copied directly into an HLSL constant buffer
+struct ParticleEmitter {
+
+	DirectX::XMFLOAT3					position; // Centre of the emission box
+	float								rate; // Particles emitted per second by ParticleSystem::update
+
+	DirectX::XMFLOAT3					positionSpread; // Half extents of the emission box
+	float								lifeMin; // Lifetime range in seconds
+
+	DirectX::XMFLOAT3					velocity; // Mean initial velocity
+	float								lifeMax;
+
+	DirectX::XMFLOAT3					velocitySpread; // Initial velocity varies by up to +/- velocitySpread on each axis
+	float								drag; // Fraction of velocity lost per second
+
+	DirectX::XMFLOAT3					gravity; // Constant acceleration
+	float								groundHeight; // Particles bounce off the plane y = groundHeight (PARTICLE_NO_GROUND to disable)
+
+	float								restitution; // Fraction of vertical speed kept after a bounce
+	float								padding[3];
+
+	ParticleEmitter();
+};
+
+
+class ParticleSystem : public GUObject {
+
+public:
+
+	// SoA particle arrays.  The kernels below process PARTICLE_LANES particles at a time, so every array must be 16 byte aligned with room for the lanes past the last particle up to the next multiple of PARTICLE_LANES
+	struct ParticleArrays {
+
+		float							*px, *py, *pz;
+		float							*vx, *vy, *vz;
+		float							*age, *life;
+	};
+
+private:
+
+	// Both buffers are held in a single aligned block.  Simulation reads and compacts from front into back then swaps them
+	float								*block = nullptr;
+	ParticleArrays						front, back;
+
+	uint32_t							numParticles = 0;
+	uint32_t							capacity = 0; // Maximum number of live particles
+	uint32_t							stride = 0; // Capacity padded to a multiple of 8 floats so every array is 32 byte aligned
+
+	ParticleEmitter						emitter;
+	float								emitAccumulator = 0.0f;
+	uint32_t							randomState = 0x9E3779B9;
+
+	// Live particle count and output offset of each simulation block
+	std::vector<uint32_t>				blockLive;
+	std::vector<uint32_t>				blockOffset;
+
+	// Uniform random number in [-1, 1]
+	float randomSigned();
+
+
+	// Not copyable.  A copy would share and free the same block.  Declared but not defined
+	ParticleSystem(const ParticleSystem&);
+	ParticleSystem& operator=(const ParticleSystem&);
+
+public:
+
+	ParticleSystem(const uint32_t maxParticles);
+	~ParticleSystem();
+
+	void setEmitter(const ParticleEmitter& E);
+	const ParticleEmitter& getEmitter() const;
+
+	// Emit n particles from the emitter.  Returns the number emitted, which is limited by the free capacity
+	uint32_t emit(const uint32_t n);
+
+	// Advance the simulation by dt seconds.  Blocks are simulated on pool if one is given
+	void simulate(const float dt, GUParallel *pool = nullptr);
+
+	// Simulate, then emit the particles due from the emitter rate over dt
+	void update(const float dt, GUParallel *pool = nullptr);
+
+	// Remove all particles
+	void clear();
+
+	uint32_t particleCount() const;
+	uint32_t getCapacity() const;
+
+	// Read-only access to the live particles (particleCount() entries each).  Pointers are invalidated by simulate
+	const float* getPositionX() const;
+	const float* getPositionY() const;
+	const float* getPositionZ() const;
+	const float* getVelocityX() const;
+	const float* getVelocityY() const;
+	const float* getVelocityZ() const;
+	const float* getAge() const;
+	const float* getLife() const;
+
+	// Integrate particles [begin, end) of A over dt seconds with the gravity, drag and ground plane of E and return the number still alive.  begin must be a multiple of PARTICLE_LANES
+	static uint32_t IntegrateParticles(const ParticleArrays& A, const uint32_t begin, const uint32_t end, const ParticleEmitter& E, const float dt);
+
+	// Copy the live particles of [begin, end) of src to dst starting at offset, keeping their order.  src and dst may be the same arrays if offset <= begin
+	static void CompactParticles(const ParticleArrays& src, const uint32_t begin, const uint32_t end, const ParticleArrays& dst, const uint32_t offset);
+};
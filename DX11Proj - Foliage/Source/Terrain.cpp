@@ -0,0 +1,425 @@
+
+//
+// Terrain.cpp
+//
+
+#include <stdafx.h>
+#include <Terrain.h>
+#include <HeightField.h>
+#include <iostream>
+#include <exception>
+#include <DXBlob.h>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Number of indices in one quadrant of the grid mesh
+#define TERRAIN_QUADRANT_IND ((TERRAIN_GRID_DIM / 2) * (TERRAIN_GRID_DIM / 2) * 2 * 3)
+
+
+// Vertex input descriptor.  Slot 0 holds the grid mesh vertex positions and slot 1 the per-chunk TerrainChunkInstance data
+static const D3D11_INPUT_ELEMENT_DESC terrainVertexDesc[] = {
+
+		{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "CHUNK", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "CHUNK", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+};
+
+
+
+Terrain::Terrain(ID3D11Device *device, DXBlob *vsBytecode, const HeightField *heightField, ID3D11ShaderResourceView *tex_view) {
+
+	try
+	{
+		if (!device || !vsBytecode || !heightField)
+			throw exception("Invalid parameters for terrain instantiation");
+
+		if (heightField->getMapWidth() < 2 || heightField->getMapHeight() < 2)
+			throw exception("Cannot load terrain heightmap");
+
+		// Build the LOD quadtree with the same world-space mapping as the heightfield
+		XMFLOAT3 origin = heightField->getOrigin();
+		float heightScale = heightField->getHeightScale();
+
+		quadtree = new TerrainQuadtree(heightField->getValues().data(), heightField->getMapWidth(), heightField->getMapHeight(), origin, heightField->getSize(), heightScale);
+
+		bounds = quadtree->getBounds();
+		chunks.reserve(TERRAIN_MAX_CHUNKS);
+
+		// Heightmap texture
+		D3D11_TEXTURE2D_DESC texDesc;
+
+		ZeroMemory(&texDesc, sizeof(D3D11_TEXTURE2D_DESC));
+
+		texDesc.Width = heightField->getMapWidth();
+		texDesc.Height = heightField->getMapHeight();
+		texDesc.MipLevels = 1;
+		texDesc.ArraySize = 1;
+		texDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		texDesc.SampleDesc.Count = 1;
+		texDesc.SampleDesc.Quality = 0;
+		texDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		D3D11_SUBRESOURCE_DATA texData;
+
+		ZeroMemory(&texData, sizeof(D3D11_SUBRESOURCE_DATA));
+
+		texData.pSysMem = heightField->getValues().data();
+		texData.SysMemPitch = heightField->getMapWidth() * sizeof(float);
+
+		HRESULT hr = device->CreateTexture2D(&texDesc, &texData, &heightTexture);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Heightmap texture cannot be created");
+
+		hr = device->CreateShaderResourceView(heightTexture, nullptr, &heightResourceView);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Heightmap shader resource view cannot be created");
+
+
+		// Grid mesh shared by every chunk.  Vertices are integer grid coordinates
+		vector<XMFLOAT2> gridVertices((TERRAIN_GRID_DIM + 1) * (TERRAIN_GRID_DIM + 1));
+
+		for (int i = 0; i <= TERRAIN_GRID_DIM; i++)
+		{
+			for (int j = 0; j <= TERRAIN_GRID_DIM; j++)
+				gridVertices[i * (TERRAIN_GRID_DIM + 1) + j] = XMFLOAT2((float)j, (float)i);
+		}
+
+		D3D11_BUFFER_DESC vertexDesc;
+		D3D11_SUBRESOURCE_DATA vertexData;
+
+		ZeroMemory(&vertexDesc, sizeof(D3D11_BUFFER_DESC));
+		ZeroMemory(&vertexData, sizeof(D3D11_SUBRESOURCE_DATA));
+
+		vertexDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		vertexDesc.ByteWidth = sizeof(XMFLOAT2) * (UINT)gridVertices.size();
+		vertexDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		vertexData.pSysMem = gridVertices.data();
+
+		hr = device->CreateBuffer(&vertexDesc, &vertexData, &vertexBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Vertex buffer cannot be created");
+
+
+		// Indices are ordered by quadrant so each quadrant is a contiguous range and the whole mesh is all 4
+		vector<uint16_t> gridIndices;
+
+		gridIndices.reserve(TERRAIN_QUADRANT_IND * 4);
+
+		for (int q = 0; q < 4; q++)
+		{
+			int x0 = (q & 1) * (TERRAIN_GRID_DIM / 2);
+			int z0 = (q >> 1) * (TERRAIN_GRID_DIM / 2);
+
+			for (int i = z0; i < z0 + TERRAIN_GRID_DIM / 2; i++)
+			{
+				for (int j = x0; j < x0 + TERRAIN_GRID_DIM / 2; j++)
+				{
+					uint16_t v00 = (uint16_t)(i * (TERRAIN_GRID_DIM + 1) + j);
+					uint16_t v01 = (uint16_t)(v00 + 1);
+					uint16_t v10 = (uint16_t)(v00 + TERRAIN_GRID_DIM + 1);
+					uint16_t v11 = (uint16_t)(v10 + 1);
+
+					gridIndices.push_back(v00);
+					gridIndices.push_back(v10);
+					gridIndices.push_back(v01);
+
+					gridIndices.push_back(v01);
+					gridIndices.push_back(v10);
+					gridIndices.push_back(v11);
+				}
+			}
+		}
+
+		D3D11_BUFFER_DESC indexDesc;
+		D3D11_SUBRESOURCE_DATA indexData;
+
+		ZeroMemory(&indexDesc, sizeof(D3D11_BUFFER_DESC));
+		ZeroMemory(&indexData, sizeof(D3D11_SUBRESOURCE_DATA));
+
+		indexDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		indexDesc.ByteWidth = sizeof(uint16_t) * (UINT)gridIndices.size();
+		indexDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		indexData.pSysMem = gridIndices.data();
+
+		hr = device->CreateBuffer(&indexDesc, &indexData, &indexBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Index buffer cannot be created");
+
+
+		// Per-chunk instance buffer rewritten each frame
+		D3D11_BUFFER_DESC instanceDesc;
+
+		ZeroMemory(&instanceDesc, sizeof(D3D11_BUFFER_DESC));
+
+		instanceDesc.Usage = D3D11_USAGE_DYNAMIC;
+		instanceDesc.ByteWidth = sizeof(TerrainChunkInstance) * TERRAIN_MAX_CHUNKS;
+		instanceDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		instanceDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		hr = device->CreateBuffer(&instanceDesc, nullptr, &instanceBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Instance buffer cannot be created");
+
+
+		// Terrain constants
+		TerrainCBuffer cbufferData;
+
+		XMFLOAT2 quadSize = quadtree->getQuadSize();
+
+		cbufferData.originHeightScale = XMFLOAT4(origin.x, origin.y, origin.z, heightScale);
+		cbufferData.quadSizeTexel = XMFLOAT4(quadSize.x, quadSize.y, 1.0f / heightField->getMapWidth(), 1.0f / heightField->getMapHeight());
+
+		D3D11_BUFFER_DESC cbufferDesc;
+		D3D11_SUBRESOURCE_DATA cbufferInitData;
+
+		ZeroMemory(&cbufferDesc, sizeof(D3D11_BUFFER_DESC));
+		ZeroMemory(&cbufferInitData, sizeof(D3D11_SUBRESOURCE_DATA));
+
+		cbufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		cbufferDesc.ByteWidth = sizeof(TerrainCBuffer);
+		cbufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		cbufferInitData.pSysMem = &cbufferData;
+
+		hr = device->CreateBuffer(&cbufferDesc, &cbufferInitData, &terrainCBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Terrain cbuffer cannot be created");
+
+
+		// Build the vertex input layout
+		hr = device->CreateInputLayout(terrainVertexDesc, ARRAYSIZE(terrainVertexDesc), vsBytecode->getBufferPointer(), vsBytecode->getBufferSize(), &inputLayout);
+
+		if (!SUCCEEDED(hr))
+			throw exception("Cannot create input layout interface");
+
+
+		textureResourceView = tex_view;
+
+		if (textureResourceView)
+			textureResourceView->AddRef(); // We didnt create it here but dont want it deleted by the creator untill we have deconstructed
+
+		D3D11_SAMPLER_DESC samplerDesc;
+
+		ZeroMemory(&samplerDesc, sizeof(D3D11_SAMPLER_DESC));
+
+		samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
+		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.MaxAnisotropy = 16;
+		samplerDesc.MinLOD = 0.0f;
+		samplerDesc.MaxLOD = 0.0f;
+		samplerDesc.MipLODBias = 0.0f;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+
+		hr = device->CreateSamplerState(&samplerDesc, &linearSampler);
+
+		// Heights are filtered bilinearly and clamped at the edges of the terrain
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.MaxAnisotropy = 1;
+
+		hr = device->CreateSamplerState(&samplerDesc, &heightSampler);
+	}
+	catch (exception& e)
+	{
+		cout << "Terrain object could not be instantiated due to:\n";
+		cout << e.what() << endl;
+
+		if (vertexBuffer)
+			vertexBuffer->Release();
+
+		if (indexBuffer)
+			indexBuffer->Release();
+
+		if (instanceBuffer)
+			instanceBuffer->Release();
+
+		if (terrainCBuffer)
+			terrainCBuffer->Release();
+
+		if (heightResourceView)
+			heightResourceView->Release();
+
+		if (heightTexture)
+			heightTexture->Release();
+
+		if (inputLayout)
+			inputLayout->Release();
+
+		vertexBuffer = nullptr;
+		indexBuffer = nullptr;
+		instanceBuffer = nullptr;
+		terrainCBuffer = nullptr;
+		heightResourceView = nullptr;
+		heightTexture = nullptr;
+		inputLayout = nullptr;
+	}
+}
+
+
+Terrain::~Terrain() {
+
+	if (quadtree)
+		quadtree->release();
+
+	if (vertexBuffer)
+		vertexBuffer->Release();
+	if (indexBuffer)
+		indexBuffer->Release();
+	if (instanceBuffer)
+		instanceBuffer->Release();
+	if (terrainCBuffer)
+		terrainCBuffer->Release();
+	if (inputLayout)
+		inputLayout->Release();
+
+	if (heightResourceView)
+		heightResourceView->Release();
+	if (heightTexture)
+		heightTexture->Release();
+	if (heightSampler)
+		heightSampler->Release();
+
+	if (textureResourceView)
+		textureResourceView->Release();
+	if (linearSampler)
+		linearSampler->Release();
+}
+
+
+uint32_t Terrain::update(ID3D11DeviceContext *context, const XMFLOAT4 *frustumPlanes, FXMVECTOR eye) {
+
+	chunks.clear();
+
+	if (!context || !quadtree || !instanceBuffer)
+		return 0;
+
+	quadtree->select(frustumPlanes, eye, chunks);
+
+	if (chunks.size() > TERRAIN_MAX_CHUNKS)
+		chunks.resize(TERRAIN_MAX_CHUNKS);
+
+	D3D11_MAPPED_SUBRESOURCE res;
+	HRESULT hr = context->Map(instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &res);
+
+	if (!SUCCEEDED(hr)) {
+
+		chunks.clear();
+		return 0;
+	}
+
+	TerrainChunkInstance *instances = (TerrainChunkInstance*)res.pData;
+
+	for (uint32_t i = 0; i < chunks.size(); i++) {
+
+		const TerrainChunk& C = chunks[i];
+		float morphStart, morphScale;
+
+		quadtree->getMorphConstants(C.level, &morphStart, &morphScale);
+
+		instances[i].offsetScale = XMFLOAT4((float)C.x, (float)C.z, (float)(1 << C.level), (float)C.level);
+		instances[i].morphConsts = XMFLOAT4(morphStart, morphScale, 0.0f, 0.0f);
+	}
+
+	context->Unmap(instanceBuffer, 0);
+
+	return (uint32_t)chunks.size();
+}
+
+
+void Terrain::render(ID3D11DeviceContext *context) {
+
+	bind(context);
+
+	for (uint32_t i = 0; i < chunks.size(); i++)
+		renderChunk(context, i);
+}
+
+
+void Terrain::bind(ID3D11DeviceContext *context) {
+
+	// Validate object before rendering (see notes in constructor)
+	if (!context || !vertexBuffer || !inputLayout)
+		return;
+
+	// Set vertex layout
+	context->IASetInputLayout(inputLayout);
+
+	// Set grid mesh and chunk instance buffers for IA
+	ID3D11Buffer* vertexBuffers[] = { vertexBuffer, instanceBuffer };
+	UINT vertexStrides[] = { sizeof(XMFLOAT2), sizeof(TerrainChunkInstance) };
+	UINT vertexOffsets[] = { 0, 0 };
+
+	context->IASetVertexBuffers(0, 2, vertexBuffers, vertexStrides, vertexOffsets);
+	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R16_UINT, 0);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// Heightmap and terrain constants for the VS stage
+	context->VSSetConstantBuffers(1, 1, &terrainCBuffer);
+	context->VSSetShaderResources(0, 1, &heightResourceView);
+	context->VSSetSamplers(0, 1, &heightSampler);
+
+	// Bind texture resource views and texture sampler objects to the PS stage of the pipeline
+	if (textureResourceView && linearSampler) {
+
+		context->PSSetShaderResources(0, 1, &textureResourceView);
+		context->PSSetSamplers(0, 1, &linearSampler);
+	}
+}
+
+
+// Draw a single chunk.  Assumes bind() has been called.  The chunk's instance data is selected with the start instance location
+void Terrain::renderChunk(ID3D11DeviceContext *context, const uint32_t index) {
+
+	if (!context || !vertexBuffer || !inputLayout || index >= chunks.size())
+		return;
+
+	uint32_t mask = chunks[index].quadrantMask;
+
+	if (mask == TERRAIN_ALL_QUADRANTS) {
+
+		context->DrawIndexedInstanced(TERRAIN_QUADRANT_IND * 4, 1, 0, 0, index);
+		return;
+	}
+
+	for (uint32_t q = 0; q < 4; q++) {
+
+		if (mask & (1 << q))
+			context->DrawIndexedInstanced(TERRAIN_QUADRANT_IND, 1, q * TERRAIN_QUADRANT_IND, 0, index);
+	}
+}
+
+
+uint32_t Terrain::chunkCount() const {
+
+	return (uint32_t)chunks.size();
+}
+
+
+const TerrainChunk& Terrain::getChunk(const uint32_t index) const {
+
+	return chunks[index];
+}
+
+
+const TerrainQuadtree* Terrain::getQuadtree() const {
+
+	return quadtree;
+}
+
+
+const DXBoundingVolume& Terrain::getBounds() const {
+
+	return bounds;
+}
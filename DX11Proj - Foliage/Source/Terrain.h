@@ -0,0 +1,82 @@
+
+//
+// Terrain.h
+//
+
+// Chunked CDLOD heightmap terrain.  The heightmap values are taken from the CPU HeightField and uploaded as a single channel float texture sampled in terrain_vs.hlsl.  Each frame TerrainQuadtree selects the visible nodes and their LOD and the per-node data is written to a dynamic per-instance vertex buffer, so every node is drawn with the same grid vertex and index buffers (the index buffer is ordered by quadrant so partly selected nodes draw a sub-range).
+
+#pragma once
+
+#include <GUObject.h>
+#include <d3d11_2.h>
+#include <DirectXMath.h>
+#include <TerrainQuadtree.h>
+#include <vector>
+
+class DXBlob;
+class HeightField;
+
+
+// Maximum number of chunks drawn per frame
+#define TERRAIN_MAX_CHUNKS			1024
+
+
+// Per-chunk data read by terrain_vs.hlsl as per-instance vertex data
+struct TerrainChunkInstance {
+
+	DirectX::XMFLOAT4					offsetScale; // <x origin, z origin, heightmap quads per grid quad, level>
+	DirectX::XMFLOAT4					morphConsts; // <morph start, morph scale, 0, 0>
+};
+
+
+// Terrain constants bound to b1 of terrain_vs.hlsl
+__declspec(align(16)) struct TerrainCBuffer {
+
+	DirectX::XMFLOAT4					originHeightScale; // <origin x, origin y, origin z, height scale>
+	DirectX::XMFLOAT4					quadSizeTexel; // <quad size x, quad size z, 1 / map width, 1 / map height>
+};
+
+
+class Terrain : public GUObject {
+
+	TerrainQuadtree						*quadtree = nullptr;
+	std::vector<TerrainChunk>			chunks;
+
+	// World-space bounds of the whole terrain
+	DXBoundingVolume					bounds;
+
+	ID3D11Buffer						*vertexBuffer = nullptr;
+	ID3D11Buffer						*indexBuffer = nullptr;
+	ID3D11Buffer						*instanceBuffer = nullptr;
+	ID3D11Buffer						*terrainCBuffer = nullptr;
+	ID3D11InputLayout					*inputLayout = nullptr;
+
+	// Heightmap texture sampled in the vertex shader
+	ID3D11Texture2D						*heightTexture = nullptr;
+	ID3D11ShaderResourceView			*heightResourceView = nullptr;
+	ID3D11SamplerState					*heightSampler = nullptr;
+
+	// Surface texture
+	ID3D11ShaderResourceView			*textureResourceView = nullptr;
+	ID3D11SamplerState					*linearSampler = nullptr;
+
+public:
+
+	// Create terrain from heightField.  The heightmap values and world-space mapping are copied so the heightfield does not need to outlive the terrain
+	Terrain(ID3D11Device *device, DXBlob *vsBytecode, const HeightField *heightField, ID3D11ShaderResourceView *tex_view);
+	~Terrain();
+
+	// Select the chunks to draw for the given frustum planes and eye position and upload their instance data.  Returns the number of chunks selected
+	uint32_t update(ID3D11DeviceContext *context, const DirectX::XMFLOAT4 *frustumPlanes, DirectX::FXMVECTOR eye);
+
+	void render(ID3D11DeviceContext *context);
+
+	// Setup the pipeline state once, then draw individual chunks
+	void bind(ID3D11DeviceContext *context);
+	void renderChunk(ID3D11DeviceContext *context, const uint32_t index);
+
+	uint32_t chunkCount() const;
+	const TerrainChunk& getChunk(const uint32_t index) const;
+	const TerrainQuadtree* getQuadtree() const;
+	const DXBoundingVolume& getBounds() const;
+};
@@ -0,0 +1,301 @@
+
+//
+// TerrainQuadtree.cpp
+//
+
+#include <stdafx.h>
+#include <TerrainQuadtree.h>
+#include <DXFrustumCuller.h>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Return true if the box B intersects the sphere of radius r about P
+static bool boxIntersectsSphere(const DXBoundingVolume& B, FXMVECTOR P, const float r) {
+
+	XMVECTOR C = XMLoadFloat3(&B.centre);
+	XMVECTOR E = XMLoadFloat3(&B.extents);
+
+	XMVECTOR nearestPoint = XMVectorClamp(P, XMVectorSubtract(C, E), XMVectorAdd(C, E));
+
+	return XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(P, nearestPoint))) <= r * r;
+}
+
+
+
+TerrainQuadtree::TerrainQuadtree(const float *heightValues, const uint32_t width, const uint32_t height, const XMFLOAT3& initOrigin, const XMFLOAT2& size, const float initHeightScale, const uint32_t initNumLODs) {
+
+	mapWidth = (heightValues) ? width : 0;
+	mapHeight = (heightValues) ? height : 0;
+
+	if (mapWidth && mapHeight)
+		heights.assign(heightValues, heightValues + mapWidth * mapHeight);
+
+	origin = initOrigin;
+	quadSize = XMFLOAT2((mapWidth) ? size.x / mapWidth : 0.0f, (mapHeight) ? size.y / mapHeight : 0.0f);
+	heightScale = initHeightScale;
+	numLODs = min(max(initNumLODs, (uint32_t)1), (uint32_t)TERRAIN_MAX_LODS);
+
+	// Leaf height ranges from the samples on and inside each node's edges
+	nodesX[0] = (mapWidth + TERRAIN_GRID_DIM - 1) / TERRAIN_GRID_DIM;
+	nodesZ[0] = (mapHeight + TERRAIN_GRID_DIM - 1) / TERRAIN_GRID_DIM;
+	nodeHeightRange[0].resize(nodesX[0] * nodesZ[0]);
+
+	for (uint32_t nz = 0; nz < nodesZ[0]; nz++) {
+
+		for (uint32_t nx = 0; nx < nodesX[0]; nx++) {
+
+			float hmin = FLT_MAX, hmax = -FLT_MAX;
+
+			uint32_t x1 = min((nx + 1) * TERRAIN_GRID_DIM, mapWidth - 1);
+			uint32_t z1 = min((nz + 1) * TERRAIN_GRID_DIM, mapHeight - 1);
+
+			for (uint32_t z = nz * TERRAIN_GRID_DIM; z <= z1; z++) {
+
+				for (uint32_t x = nx * TERRAIN_GRID_DIM; x <= x1; x++) {
+
+					hmin = min(hmin, heights[z * mapWidth + x]);
+					hmax = max(hmax, heights[z * mapWidth + x]);
+				}
+			}
+
+			nodeHeightRange[0][nz * nodesX[0] + nx] = XMFLOAT2(origin.y + hmin * heightScale, origin.y + hmax * heightScale);
+		}
+	}
+
+	// Parent height ranges from their children
+	for (uint32_t level = 1; level < numLODs; level++) {
+
+		nodesX[level] = (nodesX[level - 1] + 1) / 2;
+		nodesZ[level] = (nodesZ[level - 1] + 1) / 2;
+		nodeHeightRange[level].assign(nodesX[level] * nodesZ[level], XMFLOAT2(FLT_MAX, -FLT_MAX));
+
+		for (uint32_t nz = 0; nz < nodesZ[level - 1]; nz++) {
+
+			for (uint32_t nx = 0; nx < nodesX[level - 1]; nx++) {
+
+				const XMFLOAT2& child = nodeHeightRange[level - 1][nz * nodesX[level - 1] + nx];
+				XMFLOAT2& parent = nodeHeightRange[level][(nz / 2) * nodesX[level] + (nx / 2)];
+
+				parent.x = min(parent.x, child.x);
+				parent.y = max(parent.y, child.y);
+			}
+		}
+	}
+
+	// LOD ranges double with each level as the node size does.  The first range is set from the leaf diagonal so a node always fits inside the morph-free part of its parent's range
+	float terrainHeight = 0.0f;
+
+	for (uint32_t i = 0; i < nodeHeightRange[numLODs - 1].size(); i++)
+		terrainHeight = max(terrainHeight, nodeHeightRange[numLODs - 1][i].y - nodeHeightRange[numLODs - 1][i].x);
+
+	float leafX = TERRAIN_GRID_DIM * quadSize.x;
+	float leafZ = TERRAIN_GRID_DIM * quadSize.y;
+
+	lodRange[0] = TERRAIN_LOD_RANGE_FACTOR * sqrtf(leafX * leafX + leafZ * leafZ + terrainHeight * terrainHeight);
+
+	for (uint32_t level = 1; level < numLODs; level++)
+		lodRange[level] = lodRange[level - 1] * 2.0f;
+
+	for (uint32_t level = 0; level < numLODs; level++) {
+
+		float prevRange = (level > 0) ? lodRange[level - 1] : 0.0f;
+		float start = prevRange + (lodRange[level] - prevRange) * TERRAIN_MORPH_START_RATIO;
+
+		morphStart[level] = start;
+		morphScale[level] = 1.0f / (lodRange[level] - start);
+	}
+
+	// The root level covers everything beyond the last range so it never morphs
+	morphStart[numLODs - 1] = 0.0f;
+	morphScale[numLODs - 1] = 0.0f;
+
+	XMFLOAT3 bmin = XMFLOAT3(origin.x, origin.y, origin.z);
+	XMFLOAT3 bmax = XMFLOAT3(origin.x + size.x, origin.y + heightScale, origin.z + size.y);
+
+	bounds = DXBoundingVolume(XMFLOAT3((bmin.x + bmax.x) * 0.5f, (bmin.y + bmax.y) * 0.5f, (bmin.z + bmax.z) * 0.5f), XMFLOAT3((bmax.x - bmin.x) * 0.5f, (bmax.y - bmin.y) * 0.5f, (bmax.z - bmin.z) * 0.5f));
+}
+
+
+DXBoundingVolume TerrainQuadtree::nodeBounds(const uint32_t level, const uint32_t nx, const uint32_t nz) const {
+
+	float nodeSize = (float)(TERRAIN_GRID_DIM << level);
+	const XMFLOAT2& h = nodeHeightRange[level][nz * nodesX[level] + nx];
+
+	float ex = nodeSize * quadSize.x * 0.5f;
+	float ez = nodeSize * quadSize.y * 0.5f;
+
+	return DXBoundingVolume(XMFLOAT3(origin.x + nx * nodeSize * quadSize.x + ex, (h.x + h.y) * 0.5f, origin.z + nz * nodeSize * quadSize.y + ez), XMFLOAT3(ex, (h.y - h.x) * 0.5f, ez));
+}
+
+
+bool TerrainQuadtree::selectNode(const uint32_t level, const uint32_t nx, const uint32_t nz, const bool isRoot, const XMFLOAT4 *frustumPlanes, FXMVECTOR eye, vector<TerrainChunk>& chunks) const {
+
+	// Children past the edge of the heightmap have nothing to draw
+	if (nx >= nodesX[level] || nz >= nodesZ[level])
+		return true;
+
+	DXBoundingVolume B = nodeBounds(level, nx, nz);
+
+	if (!isRoot && !boxIntersectsSphere(B, eye, lodRange[level]))
+		return false;
+
+	// Culled nodes are handled - neither this node nor its parent draws them
+	if (!DXFrustumCuller::BoxVisible(frustumPlanes, B))
+		return true;
+
+	TerrainChunk C;
+
+	C.x = nx * (TERRAIN_GRID_DIM << level);
+	C.z = nz * (TERRAIN_GRID_DIM << level);
+	C.level = level;
+	C.quadrantMask = TERRAIN_ALL_QUADRANTS;
+	C.bounds = B;
+
+	// Draw the whole node if it is entirely outside the range of the next finer level
+	if (level == 0 || !boxIntersectsSphere(B, eye, lodRange[level - 1])) {
+
+		chunks.push_back(C);
+		return true;
+	}
+
+	// Otherwise select the children and draw the quadrants of those outside their range at this level
+	C.quadrantMask = 0;
+
+	for (uint32_t q = 0; q < 4; q++) {
+
+		if (!selectNode(level - 1, nx * 2 + (q & 1), nz * 2 + (q >> 1), false, frustumPlanes, eye, chunks))
+			C.quadrantMask |= (1 << q);
+	}
+
+	if (C.quadrantMask)
+		chunks.push_back(C);
+
+	return true;
+}
+
+
+uint32_t TerrainQuadtree::select(const XMFLOAT4 *frustumPlanes, FXMVECTOR eye, vector<TerrainChunk>& chunks) const {
+
+	chunks.clear();
+
+	uint32_t top = numLODs - 1;
+
+	for (uint32_t nz = 0; nz < nodesZ[top]; nz++) {
+
+		for (uint32_t nx = 0; nx < nodesX[top]; nx++)
+			selectNode(top, nx, nz, true, frustumPlanes, eye, chunks);
+	}
+
+	return (uint32_t)chunks.size();
+}
+
+
+uint32_t TerrainQuadtree::lodCount() const {
+
+	return numLODs;
+}
+
+
+float TerrainQuadtree::getLODRange(const uint32_t level) const {
+
+	return lodRange[level];
+}
+
+
+void TerrainQuadtree::getMorphConstants(const uint32_t level, float *start, float *scale) const {
+
+	*start = morphStart[level];
+	*scale = morphScale[level];
+}
+
+
+float TerrainQuadtree::morphFactor(const uint32_t level, const float dist) const {
+
+	return min(max((dist - morphStart[level]) * morphScale[level], 0.0f), 1.0f);
+}
+
+
+float TerrainQuadtree::sampleHeight(const float qx, const float qz) const {
+
+	if (heights.empty())
+		return origin.y;
+
+	float x = min(max(qx, 0.0f), (float)(mapWidth - 1));
+	float z = min(max(qz, 0.0f), (float)(mapHeight - 1));
+
+	uint32_t x0 = (uint32_t)x;
+	uint32_t z0 = (uint32_t)z;
+	uint32_t x1 = min(x0 + 1, mapWidth - 1);
+	uint32_t z1 = min(z0 + 1, mapHeight - 1);
+
+	float fx = x - x0;
+	float fz = z - z0;
+
+	float h0 = heights[z0 * mapWidth + x0] + (heights[z0 * mapWidth + x1] - heights[z0 * mapWidth + x0]) * fx;
+	float h1 = heights[z1 * mapWidth + x0] + (heights[z1 * mapWidth + x1] - heights[z1 * mapWidth + x0]) * fx;
+
+	return origin.y + (h0 + (h1 - h0) * fz) * heightScale;
+}
+
+
+XMFLOAT3 TerrainQuadtree::mapToWorld(const float qx, const float qz) const {
+
+	return XMFLOAT3(origin.x + qx * quadSize.x, sampleHeight(qx, qz), origin.z + qz * quadSize.y);
+}
+
+
+// Odd grid vertices move towards their even neighbour (in the -x / -z direction) by the morph factor.  At a factor of 1 the grid matches the grid of the next coarser level
+XMFLOAT3 TerrainQuadtree::morphVertex(const TerrainChunk& C, const uint32_t gx, const uint32_t gz, FXMVECTOR eye) const {
+
+	float gridScale = (float)(1 << C.level);
+
+	XMFLOAT3 P = mapToWorld(C.x + gx * gridScale, C.z + gz * gridScale);
+
+	float k = morphFactor(C.level, XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&P), eye))));
+
+	float mx = (float)gx - (float)(gx & 1) * k;
+	float mz = (float)gz - (float)(gz & 1) * k;
+
+	return mapToWorld(C.x + mx * gridScale, C.z + mz * gridScale);
+}
+
+
+uint32_t TerrainQuadtree::getMapWidth() const {
+
+	return mapWidth;
+}
+
+
+uint32_t TerrainQuadtree::getMapHeight() const {
+
+	return mapHeight;
+}
+
+
+XMFLOAT3 TerrainQuadtree::getOrigin() const {
+
+	return origin;
+}
+
+
+XMFLOAT2 TerrainQuadtree::getQuadSize() const {
+
+	return quadSize;
+}
+
+
+float TerrainQuadtree::getHeightScale() const {
+
+	return heightScale;
+}
+
+
+const DXBoundingVolume& TerrainQuadtree::getBounds() const {
+
+	return bounds;
+}
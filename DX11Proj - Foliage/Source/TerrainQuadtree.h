@@ -0,0 +1,103 @@
+
+//
+// TerrainQuadtree.h
+//
+
+// Continuous distance-dependent level of detail (CDLOD) selection for heightmap terrain.  The heightmap is covered by a quadtree whose leaves are TERRAIN_GRID_DIM x TERRAIN_GRID_DIM heightmap quads and each level up doubles the area covered by a node.  Every node is drawn with the same grid mesh so a node at level L has a vertex spacing of 2^L heightmap quads.  Each level has a view distance range and vertices are morphed towards the next coarser grid as they approach the end of their range, so where two levels meet the finer level is fully morphed and the two meshes share the same vertices.  Nodes only partly inside their range are drawn by quadrant with the children closer to the camera selected at a finer level.  The selection and morph calculations mirror terrain_vs.hlsl and do not depend on Direct3D so they can be checked on the CPU.
+
+#pragma once
+
+#include <GUObject.h>
+#include <DirectXMath.h>
+#include <DXBoundingVolume.h>
+#include <vector>
+#include <cstdint>
+
+
+// Number of quads along each side of the shared chunk grid mesh.  This must be even so odd vertices can be morphed onto the coarser grid
+#define TERRAIN_GRID_DIM			32
+
+#define TERRAIN_MAX_LODS			8
+#define TERRAIN_DEFAULT_LODS		6
+
+// Fraction of each LOD range after which vertices start to morph towards the next level
+#define TERRAIN_MORPH_START_RATIO	0.66f
+
+// Range of the finest LOD as a multiple of the diagonal of a leaf node (including the height range of the terrain).  This must be at least 1 / (2 * (1 - TERRAIN_MORPH_START_RATIO)) ~= 1.5 for the morph regions of neighbouring levels not to overlap
+#define TERRAIN_LOD_RANGE_FACTOR	2.0f
+
+
+// Quadrants of a node.  Bit q of TerrainChunk::quadrantMask selects the quadrant covering grid x in [(q & 1) * G / 2, ((q & 1) + 1) * G / 2] and z in [(q >> 1) * G / 2, ((q >> 1) + 1) * G / 2] where G = TERRAIN_GRID_DIM
+#define TERRAIN_ALL_QUADRANTS		0xF
+
+
+// A selected node to be drawn with the grid mesh
+struct TerrainChunk {
+
+	uint32_t							x, z; // Origin in heightmap quads
+	uint32_t							level; // LOD level (0 = finest).  The node covers TERRAIN_GRID_DIM << level heightmap quads
+	uint32_t							quadrantMask; // Quadrants of the grid mesh to draw
+	DXBoundingVolume					bounds; // World-space bounds of the whole node
+};
+
+
+class TerrainQuadtree : public GUObject {
+
+	// Normalised heightmap values (row-major, row index = z)
+	uint32_t							mapWidth = 0;
+	uint32_t							mapHeight = 0;
+	std::vector<float>					heights;
+
+	// World-space mapping.  Heightmap quad coordinate (qx, qz) maps to origin + <qx * quadSize.x, h * heightScale, qz * quadSize.y>
+	DirectX::XMFLOAT3					origin;
+	DirectX::XMFLOAT2					quadSize;
+	float								heightScale;
+
+	uint32_t							numLODs = 0;
+	float								lodRange[TERRAIN_MAX_LODS];
+	float								morphStart[TERRAIN_MAX_LODS];
+	float								morphScale[TERRAIN_MAX_LODS]; // 1 / (morph end - morph start) or 0 if the level does not morph
+
+	// Number of nodes along x and z and the world-space <min, max> height of each node for each level
+	uint32_t							nodesX[TERRAIN_MAX_LODS];
+	uint32_t							nodesZ[TERRAIN_MAX_LODS];
+	std::vector<DirectX::XMFLOAT2>		nodeHeightRange[TERRAIN_MAX_LODS];
+
+	DXBoundingVolume					bounds;
+
+	DXBoundingVolume nodeBounds(const uint32_t level, const uint32_t nx, const uint32_t nz) const;
+
+	// Recursive CDLOD selection.  Returns false if the node is outside its LOD range so the parent must draw its area instead
+	bool selectNode(const uint32_t level, const uint32_t nx, const uint32_t nz, const bool isRoot, const DirectX::XMFLOAT4 *frustumPlanes, DirectX::FXMVECTOR eye, std::vector<TerrainChunk>& chunks) const;
+
+public:
+
+	// Build the quadtree over a width x height heightmap with values in [0, 1].  The terrain covers size.x by size.y world units from origin.  For complete coverage the heightmap dimensions should be multiples of the root node size (TERRAIN_GRID_DIM << (numLODs - 1))
+	TerrainQuadtree(const float *heightValues, const uint32_t width, const uint32_t height, const DirectX::XMFLOAT3& initOrigin, const DirectX::XMFLOAT2& size, const float initHeightScale, const uint32_t initNumLODs = TERRAIN_DEFAULT_LODS);
+
+	// Select the nodes to draw for the given frustum planes (see DXFrustumCuller::ExtractPlanes) and world-space eye position.  Returns the number of chunks written to chunks
+	uint32_t select(const DirectX::XMFLOAT4 *frustumPlanes, DirectX::FXMVECTOR eye, std::vector<TerrainChunk>& chunks) const;
+
+	uint32_t lodCount() const;
+	float getLODRange(const uint32_t level) const;
+
+	// Morph constants for terrain_vs.hlsl.  The morph factor of a vertex at distance d is saturate((d - start) * scale)
+	void getMorphConstants(const uint32_t level, float *start, float *scale) const;
+	float morphFactor(const uint32_t level, const float dist) const;
+
+	// Bilinearly interpolated world-space height at heightmap quad coordinate (qx, qz).  Coordinates are clamped to the heightmap
+	float sampleHeight(const float qx, const float qz) const;
+
+	// World-space position of heightmap quad coordinate (qx, qz)
+	DirectX::XMFLOAT3 mapToWorld(const float qx, const float qz) const;
+
+	// World-space position of vertex (gx, gz) of the grid mesh drawn for chunk C after morphing.  This is the CPU equivalent of terrain_vs.hlsl
+	DirectX::XMFLOAT3 morphVertex(const TerrainChunk& C, const uint32_t gx, const uint32_t gz, DirectX::FXMVECTOR eye) const;
+
+	uint32_t getMapWidth() const;
+	uint32_t getMapHeight() const;
+	DirectX::XMFLOAT3 getOrigin() const;
+	DirectX::XMFLOAT2 getQuadSize() const;
+	float getHeightScale() const;
+	const DXBoundingVolume& getBounds() const;
+};
@@ -0,0 +1,775 @@
+
+//
+// CullingTests.cpp
+//
+
+// Tests and benchmarks for the visibility culling classes (DXFrustumCuller, DXInstanceBVH and DXOcclusionCuller)
+
+#include <stdafx.h>
+#include <TestHarness.h>
+#include <DXFrustumCuller.h>
+#include <DXInstanceBVH.h>
+#include <DXOcclusionCuller.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+using namespace std;
+using namespace DirectX;
+
+
+// Random instance volumes scattered over a square of the given size on the xz plane
+static void randomVolumes(vector<DXBoundingVolume>& volumes, const uint32_t count, const float size, const uint32_t seed) {
+
+	TestRandom R(seed);
+
+	volumes.resize(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		XMFLOAT3 centre(R.uniform(-size, size), R.uniform(0.0f, 10.0f), R.uniform(-size, size));
+		XMFLOAT3 extents(R.uniform(0.5f, 4.0f), R.uniform(1.0f, 8.0f), R.uniform(0.5f, 4.0f));
+
+		volumes[i] = DXBoundingVolume(centre, extents);
+	}
+}
+
+
+// View looking across the volumes from one side
+static XMMATRIX testViewProjection() {
+
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(-50.0f, 20.0f, -400.0f, 1.0f), XMVectorSet(100.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.5f, 600.0f);
+
+	return view * proj;
+}
+
+
+#pragma region DXFrustumCuller
+
+// The batched SoA sphere and box tests must select exactly the volumes the single volume tests select
+TEST_CASE(frustumCullerMatchesSingleTests) {
+
+	vector<DXBoundingVolume> volumes;
+
+	// Count is not a multiple of DX_CULL_LANES so the padded tail is exercised
+	randomVolumes(volumes, 10007, 500.0f, 1);
+
+	DXFrustumCuller *culler = new DXFrustumCuller(16);
+
+	for (uint32_t i = 0; i < volumes.size(); i++)
+		culler->addVolume(volumes[i]);
+
+	TEST_CHECK(culler->volumeCount() == volumes.size());
+
+	culler->setViewProjection(testViewProjection());
+
+	vector<uint32_t> sphereIndices(volumes.size()), boxIndices(volumes.size());
+
+	uint32_t numSpheres = culler->cullSpheres(sphereIndices.data());
+	uint32_t numBoxes = culler->cullBoxes(boxIndices.data());
+
+	vector<uint32_t> expectedSpheres, expectedBoxes;
+
+	for (uint32_t i = 0; i < volumes.size(); i++) {
+
+		if (culler->sphereVisible(volumes[i]))
+			expectedSpheres.push_back(i);
+
+		if (culler->boxVisible(volumes[i]))
+			expectedBoxes.push_back(i);
+	}
+
+	TEST_CHECK(numSpheres == expectedSpheres.size());
+	TEST_CHECK(numBoxes == expectedBoxes.size());
+	TEST_CHECK(numBoxes > 0 && numBoxes < volumes.size());
+
+	bool sameSpheres = (numSpheres == expectedSpheres.size());
+	bool sameBoxes = (numBoxes == expectedBoxes.size());
+
+	for (uint32_t i = 0; sameSpheres && i < numSpheres; i++)
+		sameSpheres = (sphereIndices[i] == expectedSpheres[i]);
+
+	for (uint32_t i = 0; sameBoxes && i < numBoxes; i++)
+		sameBoxes = (boxIndices[i] == expectedBoxes[i]);
+
+	TEST_CHECK(sameSpheres);
+	TEST_CHECK(sameBoxes);
+
+	culler->release();
+}
+
+
+// A volume straddling a plane is visible and one fully behind the camera is not
+TEST_CASE(frustumCullerBoundaryCases) {
+
+	XMFLOAT4 planes[DX_NUM_FRUSTUM_PLANES];
+
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+	DXFrustumCuller::ExtractPlanes(view * XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 1.0f, 100.0f), planes);
+
+	TEST_CHECK(DXFrustumCuller::BoxVisible(planes, DXBoundingVolume(XMFLOAT3(0.0f, 0.0f, 50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+	TEST_CHECK(DXFrustumCuller::BoxVisible(planes, DXBoundingVolume(XMFLOAT3(0.0f, 0.0f, 100.5f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+	TEST_CHECK(!DXFrustumCuller::BoxVisible(planes, DXBoundingVolume(XMFLOAT3(0.0f, 0.0f, -10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+	TEST_CHECK(!DXFrustumCuller::SphereVisible(planes, DXBoundingVolume(XMFLOAT3(0.0f, 0.0f, 110.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+
+	// Beyond the 90 degree field of view on the left
+	TEST_CHECK(!DXFrustumCuller::BoxVisible(planes, DXBoundingVolume(XMFLOAT3(-40.0f, 0.0f, 20.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+}
+
+
+BENCHMARK(frustumCullerThroughput) {
+
+	XMMATRIX viewProj = testViewProjection();
+
+	for (uint32_t count = 10000; count <= 1000000; count *= 10) {
+
+		vector<DXBoundingVolume> volumes;
+
+		randomVolumes(volumes, count, 500.0f, 2);
+
+		DXFrustumCuller *culler = new DXFrustumCuller(count);
+
+		for (uint32_t i = 0; i < count; i++)
+			culler->addVolume(volumes[i]);
+
+		culler->setViewProjection(viewProj);
+
+		vector<uint32_t> visibleIndices(count);
+		uint32_t numVisible = 0, numRepeats = 10000000 / count;
+
+		TestTimer scalarTimer;
+
+		for (uint32_t k = 0; k < numRepeats; k++) {
+
+			numVisible = 0;
+
+			for (uint32_t i = 0; i < count; i++)
+				if (culler->boxVisible(volumes[i]))
+					visibleIndices[numVisible++] = i;
+		}
+
+		double scalarTime = scalarTimer.seconds();
+
+		TestTimer boxTimer;
+
+		for (uint32_t k = 0; k < numRepeats; k++)
+			numVisible = culler->cullBoxes(visibleIndices.data());
+
+		double boxTime = boxTimer.seconds();
+
+		TestTimer sphereTimer;
+
+		for (uint32_t k = 0; k < numRepeats; k++)
+			culler->cullSpheres(visibleIndices.data());
+
+		double sphereTime = sphereTimer.seconds();
+
+		cout << "  " << count << " volumes, " << numVisible << " visible" << endl;
+
+		test_report("single box tests", (double)count * numRepeats, scalarTime);
+		test_report("batched box tests", (double)count * numRepeats, boxTime);
+		test_report("batched sphere tests", (double)count * numRepeats, sphereTime);
+
+		culler->release();
+	}
+}
+
+#pragma endregion
+
+
+#pragma region DXInstanceBVH
+
+// Reference ray / box slab test.  Returns the entry distance or FLT_MAX if the ray misses the box within [0, maxT]
+static float rayBoxDistance(const XMFLOAT3& origin, const XMFLOAT3& direction, const DXBoundingVolume& B, const float maxT) {
+
+	const float o[3] = { origin.x, origin.y, origin.z };
+	const float d[3] = { direction.x, direction.y, direction.z };
+	const float c[3] = { B.centre.x, B.centre.y, B.centre.z };
+	const float e[3] = { B.extents.x, B.extents.y, B.extents.z };
+
+	float tMin = 0.0f, tMax = maxT;
+
+	for (int k = 0; k < 3; k++) {
+
+		if (fabsf(d[k]) < 1.0e-12f) {
+
+			if (o[k] < c[k] - e[k] || o[k] > c[k] + e[k])
+				return FLT_MAX;
+
+			continue;
+		}
+
+		float t0 = (c[k] - e[k] - o[k]) / d[k];
+		float t1 = (c[k] + e[k] - o[k]) / d[k];
+
+		tMin = max(tMin, min(t0, t1));
+		tMax = min(tMax, max(t0, t1));
+
+		if (tMin > tMax)
+			return FLT_MAX;
+	}
+
+	return tMin;
+}
+
+
+// Frustum, ray and nearest queries must agree with brute force tests over every instance, before and after a refit
+TEST_CASE(instanceBVHMatchesBruteForce) {
+
+	vector<DXBoundingVolume> volumes;
+
+	randomVolumes(volumes, 20000, 500.0f, 3);
+
+	DXInstanceBVH *bvh = new DXInstanceBVH();
+
+	bvh->build(volumes.data(), (uint32_t)volumes.size());
+
+	TEST_CHECK(bvh->instanceCount() == volumes.size());
+	TEST_CHECK(bvh->nodeCount() > 1 && bvh->nodeCount() < 2 * volumes.size());
+
+	XMFLOAT4 planes[DX_NUM_FRUSTUM_PLANES];
+
+	DXFrustumCuller::ExtractPlanes(testViewProjection(), planes);
+
+	for (int pass = 0; pass < 2; pass++) {
+
+		if (pass == 1) {
+
+			// Move every 10th instance and refit
+			TestRandom R(4);
+
+			for (uint32_t i = 0; i < volumes.size(); i += 10) {
+
+				volumes[i].centre.x += R.uniform(-50.0f, 50.0f);
+				volumes[i].centre.z += R.uniform(-50.0f, 50.0f);
+				bvh->setVolume(i, volumes[i]);
+			}
+
+			bvh->refit();
+		}
+
+		// Frustum query
+		vector<uint32_t> visible, expected;
+
+		uint32_t numVisible = bvh->frustumQuery(planes, visible);
+
+		for (uint32_t i = 0; i < volumes.size(); i++)
+			if (DXFrustumCuller::BoxVisible(planes, volumes[i]))
+				expected.push_back(i);
+
+		sort(visible.begin(), visible.end());
+
+		TEST_CHECK(numVisible == visible.size());
+		TEST_CHECK(visible == expected);
+
+		// Ray queries
+		TestRandom R(5 + pass);
+		uint32_t numRayMismatches = 0, numNearestMismatches = 0;
+
+		for (int k = 0; k < 200; k++) {
+
+			XMFLOAT3 origin(R.uniform(-600.0f, 600.0f), R.uniform(1.0f, 30.0f), R.uniform(-600.0f, 600.0f));
+			XMFLOAT3 target(R.uniform(-300.0f, 300.0f), R.uniform(0.0f, 5.0f), R.uniform(-300.0f, 300.0f));
+			XMFLOAT3 direction(target.x - origin.x, target.y - origin.y, target.z - origin.z);
+
+			float expectedT = FLT_MAX;
+
+			for (uint32_t i = 0; i < volumes.size(); i++)
+				expectedT = min(expectedT, rayBoxDistance(origin, direction, volumes[i], 2.0f));
+
+			uint32_t hitIndex = 0;
+			float hitT = FLT_MAX;
+			bool hit = bvh->raycast(XMLoadFloat3(&origin), XMLoadFloat3(&direction), &hitIndex, &hitT, 2.0f);
+
+			if (hit != (expectedT < FLT_MAX) || (hit && fabsf(hitT - expectedT) > 1.0e-4f))
+				numRayMismatches++;
+
+			// Nearest instance centre
+			float expectedDist = FLT_MAX;
+
+			for (uint32_t i = 0; i < volumes.size(); i++) {
+
+				float dx = volumes[i].centre.x - origin.x, dy = volumes[i].centre.y - origin.y, dz = volumes[i].centre.z - origin.z;
+
+				expectedDist = min(expectedDist, sqrtf(dx * dx + dy * dy + dz * dz));
+			}
+
+			uint32_t nearestIndex = 0;
+			float nearestDist = FLT_MAX;
+
+			if (!bvh->nearest(XMLoadFloat3(&origin), &nearestIndex, &nearestDist) || fabsf(nearestDist - expectedDist) > 1.0e-3f)
+				numNearestMismatches++;
+		}
+
+		TEST_CHECK(numRayMismatches == 0);
+		TEST_CHECK(numNearestMismatches == 0);
+	}
+
+	bvh->release();
+}
+
+
+BENCHMARK(instanceBVHBuildAndQuery) {
+
+	XMFLOAT4 planes[DX_NUM_FRUSTUM_PLANES];
+
+	DXFrustumCuller::ExtractPlanes(testViewProjection(), planes);
+
+	for (uint32_t count = 10000; count <= 1000000; count *= 10) {
+
+		vector<DXBoundingVolume> volumes;
+
+		// Keep the instance density constant as the count grows
+		randomVolumes(volumes, count, 5.0f * sqrtf((float)count), 6);
+
+		DXInstanceBVH *bvh = new DXInstanceBVH();
+		uint32_t numBuilds = max(1u, 1000000 / count);
+
+		TestTimer buildTimer;
+
+		for (uint32_t k = 0; k < numBuilds; k++)
+			bvh->build(volumes.data(), count);
+
+		double buildTime = buildTimer.seconds();
+
+		TestTimer refitTimer;
+
+		for (uint32_t k = 0; k < numBuilds; k++)
+			bvh->refit();
+
+		double refitTime = refitTimer.seconds();
+
+		// Frustum query against the equivalent linear SoA cull
+		vector<uint32_t> visible;
+		uint32_t numQueries = max(10u, 10000000 / count), numVisible = 0;
+
+		visible.reserve(count);
+
+		TestTimer queryTimer;
+
+		for (uint32_t k = 0; k < numQueries; k++)
+			numVisible = bvh->frustumQuery(planes, visible);
+
+		double queryTime = queryTimer.seconds();
+
+		DXFrustumCuller *culler = new DXFrustumCuller(count);
+
+		for (uint32_t i = 0; i < count; i++)
+			culler->addVolume(volumes[i]);
+
+		culler->setViewProjection(testViewProjection());
+		visible.resize(count);
+
+		TestTimer cullTimer;
+
+		for (uint32_t k = 0; k < numQueries; k++)
+			culler->cullBoxes(visible.data());
+
+		double cullTime = cullTimer.seconds();
+
+		// Ray and nearest queries
+		TestRandom R(7);
+		const uint32_t numRays = 100000;
+		float extent = 5.0f * sqrtf((float)count);
+		uint32_t numHits = 0;
+
+		TestTimer rayTimer;
+
+		for (uint32_t k = 0; k < numRays; k++) {
+
+			XMVECTOR origin = XMVectorSet(R.uniform(-extent, extent), 2.0f, R.uniform(-extent, extent), 1.0f);
+			XMVECTOR direction = XMVectorSet(R.uniform(-1.0f, 1.0f), R.uniform(-0.1f, 0.1f), R.uniform(-1.0f, 1.0f), 0.0f);
+			uint32_t hitIndex;
+			float hitT;
+
+			if (bvh->raycast(origin, direction, &hitIndex, &hitT, 100.0f))
+				numHits++;
+		}
+
+		double rayTime = rayTimer.seconds();
+
+		TestTimer nearestTimer;
+
+		for (uint32_t k = 0; k < numRays; k++) {
+
+			uint32_t nearestIndex;
+			float nearestDist;
+
+			bvh->nearest(XMVectorSet(R.uniform(-extent, extent), 2.0f, R.uniform(-extent, extent), 1.0f), &nearestIndex, &nearestDist);
+		}
+
+		double nearestTime = nearestTimer.seconds();
+
+		cout << "  " << count << " instances, " << bvh->nodeCount() << " nodes, " << numVisible << " visible, " << numHits << " ray hits" << endl;
+
+		test_report("build (per instance)", (double)count * numBuilds, buildTime);
+		test_report("refit (per instance)", (double)count * numBuilds, refitTime);
+		test_report("BVH frustum query (per instance)", (double)count * numQueries, queryTime);
+		test_report("linear SoA cull (per instance)", (double)count * numQueries, cullTime);
+		test_report("raycast (per ray)", numRays, rayTime);
+		test_report("nearest (per query)", numRays, nearestTime);
+
+		culler->release();
+		bvh->release();
+	}
+}
+
+#pragma endregion
+
+
+#pragma region DXOcclusionCuller
+
+// Path of the castle model relative to the project directory (the working directory when run from Visual Studio)
+#define CASTLE_MODEL_PATH "Resources\\Models\\saintriqT3DS.obj"
+
+
+// Read the positions and faces of an OBJ file.  Polygons are split into triangle fans
+static bool loadOBJ(const char *path, vector<XMFLOAT3>& positions, vector<uint32_t>& indices) {
+
+	ifstream file(path);
+
+	if (!file.is_open())
+		return false;
+
+	string line;
+
+	while (getline(file, line)) {
+
+		istringstream tokens(line);
+		string type;
+
+		tokens >> type;
+
+		if (type == "v") {
+
+			XMFLOAT3 p;
+
+			tokens >> p.x >> p.y >> p.z;
+			positions.push_back(p);
+
+		} else if (type == "f") {
+
+			vector<uint32_t> face;
+			string vertex;
+
+			// Each vertex is v, v/vt, v//vn or v/vt/vn.  Only the position index is used
+			while (tokens >> vertex)
+				face.push_back((uint32_t)atoi(vertex.c_str()) - 1);
+
+			for (uint32_t k = 1; k + 1 < face.size(); k++) {
+
+				indices.push_back(face[0]);
+				indices.push_back(face[k]);
+				indices.push_back(face[k + 1]);
+			}
+		}
+	}
+
+	return !indices.empty();
+}
+
+
+// Closed UV sphere mesh
+static void sphereMesh(const float radius, const uint32_t slices, const uint32_t stacks, vector<XMFLOAT3>& positions, vector<uint32_t>& indices) {
+
+	for (uint32_t j = 0; j <= stacks; j++) {
+
+		float phi = XM_PI * (float)j / (float)stacks;
+
+		for (uint32_t i = 0; i < slices; i++) {
+
+			float theta = XM_2PI * (float)i / (float)slices;
+
+			positions.push_back(XMFLOAT3(radius * sinf(phi) * cosf(theta), radius * cosf(phi), radius * sinf(phi) * sinf(theta)));
+		}
+	}
+
+	for (uint32_t j = 0; j < stacks; j++) {
+
+		for (uint32_t i = 0; i < slices; i++) {
+
+			uint32_t a = j * slices + i, b = j * slices + (i + 1) % slices;
+			uint32_t c = a + slices, d = b + slices;
+
+			indices.push_back(a); indices.push_back(c); indices.push_back(b);
+			indices.push_back(b); indices.push_back(c); indices.push_back(d);
+		}
+	}
+}
+
+
+// Sum of the volumes of the boxes of a hull made by BuildOccluderHull (8 corners per box, corner 0 is the minimum and corner 7 the maximum)
+static float hullVolume(const vector<XMFLOAT3>& hull) {
+
+	float volume = 0.0f;
+
+	for (uint32_t b = 0; b + 7 < hull.size(); b += 8)
+		volume += (hull[b + 7].x - hull[b].x) * (hull[b + 7].y - hull[b].y) * (hull[b + 7].z - hull[b].z);
+
+	return volume;
+}
+
+
+// Return true if any vertex, edge midpoint or centroid of the mesh lies strictly inside a box of the hull
+static bool meshPointsInsideHull(const vector<XMFLOAT3>& positions, const vector<uint32_t>& indices, const vector<XMFLOAT3>& hull) {
+
+	for (uint32_t t = 0; t + 2 < indices.size(); t += 3) {
+
+		const XMFLOAT3& a = positions[indices[t]];
+		const XMFLOAT3& b = positions[indices[t + 1]];
+		const XMFLOAT3& c = positions[indices[t + 2]];
+
+		XMFLOAT3 samples[7] = {
+			a, b, c,
+			XMFLOAT3((a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f, (a.z + b.z) * 0.5f),
+			XMFLOAT3((b.x + c.x) * 0.5f, (b.y + c.y) * 0.5f, (b.z + c.z) * 0.5f),
+			XMFLOAT3((c.x + a.x) * 0.5f, (c.y + a.y) * 0.5f, (c.z + a.z) * 0.5f),
+			XMFLOAT3((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f) };
+
+		for (uint32_t box = 0; box + 7 < hull.size(); box += 8) {
+
+			const XMFLOAT3& lo = hull[box];
+			const XMFLOAT3& hi = hull[box + 7];
+
+			for (int k = 0; k < 7; k++) {
+
+				const XMFLOAT3& p = samples[k];
+
+				if (p.x > lo.x && p.x < hi.x && p.y > lo.y && p.y < hi.y && p.z > lo.z && p.z < hi.z)
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+// The hull of a sphere must lie inside the sphere's polygonal surface and fill a useful part of it
+TEST_CASE(occluderHullInsideSphere) {
+
+	vector<XMFLOAT3> positions, hull;
+	vector<uint32_t> indices, hullIndices;
+
+	const float radius = 10.0f;
+	const uint32_t slices = 32, stacks = 16;
+
+	sphereMesh(radius, slices, stacks, positions, indices);
+
+	DXOcclusionCuller::BuildOccluderHull(positions.data(), indices.data(), (uint32_t)indices.size(), DX_OCCLUSION_HULL_RES, DX_OCCLUSION_HULL_BOXES, hull, hullIndices);
+
+	TEST_CHECK(!hull.empty());
+	TEST_CHECK(hull.size() <= DX_OCCLUSION_HULL_BOXES * 8);
+	TEST_CHECK(hullIndices.size() == hull.size() / 8 * 36);
+
+	// The sphere is convex so a point is inside if it is behind the plane of every face
+	uint32_t numOutside = 0;
+
+	for (uint32_t i = 0; i < hull.size(); i++) {
+
+		XMVECTOR p = XMLoadFloat3(&hull[i]);
+
+		for (uint32_t t = 0; t + 2 < indices.size(); t += 3) {
+
+			XMVECTOR a = XMLoadFloat3(&positions[indices[t]]);
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&positions[indices[t + 1]]), a), XMVectorSubtract(XMLoadFloat3(&positions[indices[t + 2]]), a));
+
+			// Skip the degenerate triangles at the poles
+			if (XMVectorGetX(XMVector3LengthSq(n)) < 1.0e-8f)
+				continue;
+
+			// Face outwards
+			if (XMVectorGetX(XMVector3Dot(n, a)) < 0.0f)
+				n = XMVectorNegate(n);
+
+			if (XMVectorGetX(XMVector3Dot(XMVector3Normalize(n), XMVectorSubtract(p, a))) > 1.0e-4f) {
+
+				numOutside++;
+				break;
+			}
+		}
+	}
+
+	TEST_CHECK(numOutside == 0);
+
+	// An inscribed cube fills 37% of a sphere
+	TEST_CHECK(hullVolume(hull) > 0.3f * (4.0f / 3.0f) * XM_PI * radius * radius * radius);
+	TEST_CHECK(!meshPointsInsideHull(positions, indices, hull));
+}
+
+
+// An open mesh has no inside so gives no hull, and a mesh that is all thin walls gives none either
+TEST_CASE(occluderHullOpenMesh) {
+
+	const XMFLOAT3 quad[4] = { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(10.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 10.0f, 0.0f), XMFLOAT3(10.0f, 10.0f, 5.0f) };
+	const uint32_t quadIndices[6] = { 0, 1, 2, 1, 3, 2 };
+
+	vector<XMFLOAT3> hull;
+	vector<uint32_t> hullIndices;
+
+	DXOcclusionCuller::BuildOccluderHull(quad, quadIndices, 6, DX_OCCLUSION_HULL_RES, DX_OCCLUSION_HULL_BOXES, hull, hullIndices);
+
+	TEST_CHECK(hull.empty() && hullIndices.empty());
+}
+
+
+// The castle hull must be far smaller than the castle mesh and must not cut through the castle surface
+TEST_CASE(occluderHullCastle) {
+
+	vector<XMFLOAT3> positions, hull;
+	vector<uint32_t> indices, hullIndices;
+
+	if (!loadOBJ(CASTLE_MODEL_PATH, positions, indices)) {
+
+		cout << "  " << CASTLE_MODEL_PATH << " not found, skipped" << endl;
+		return;
+	}
+
+	DXOcclusionCuller::BuildOccluderHull(positions.data(), indices.data(), (uint32_t)indices.size(), DX_OCCLUSION_HULL_RES, DX_OCCLUSION_HULL_BOXES, hull, hullIndices);
+
+	cout << "  castle " << indices.size() / 3 << " triangles, hull " << hullIndices.size() / 3 << " triangles" << endl;
+
+	TEST_CHECK(!hull.empty());
+	TEST_CHECK(hullIndices.size() * 10 < indices.size());
+	TEST_CHECK(!meshPointsInsideHull(positions, indices, hull));
+}
+
+
+// Orthographic view mapping world x / y directly to depth buffer pixels (y down) and z in [0, 100] to depth
+static XMMATRIX pixelViewProjection(const DXOcclusionCuller *culler) {
+
+	return XMMatrixOrthographicOffCenterLH(0.0f, (float)culler->getWidth(), (float)culler->getHeight(), 0.0f, 0.0f, 100.0f);
+}
+
+
+// Rasterise the rectangle [x0, x1] x [y0, y1] at depth z
+static void rasteriseRectangle(DXOcclusionCuller *culler, const float x0, const float y0, const float x1, const float y1, const float z) {
+
+	const XMFLOAT3 corners[4] = { XMFLOAT3(x0, y0, z), XMFLOAT3(x1, y0, z), XMFLOAT3(x0, y1, z), XMFLOAT3(x1, y1, z) };
+	const uint32_t quadIndices[6] = { 0, 1, 2, 1, 3, 2 };
+
+	culler->rasteriseOccluder(corners, quadIndices, 6, XMMatrixIdentity());
+}
+
+
+// A box hidden by an occluder is rejected, and a box behind the part of a silhouette pixel the occluder does not cover stays visible even though the pixel centre is covered
+TEST_CASE(occlusionConservativeAtSilhouettes) {
+
+	DXOcclusionCuller *culler = new DXOcclusionCuller(320, 192);
+
+	culler->beginFrame(pixelViewProjection(culler));
+
+	// Covers the centres of pixels 0 - 100 (centre 100.5) but only 70% of pixel 100
+	rasteriseRectangle(culler, -10.0f, -10.0f, 100.7f, 300.0f, 10.0f);
+
+	culler->endFrame();
+
+	TEST_CHECK(culler->trianglesRasterised() == 2);
+
+	// Well inside the occluder, behind and in front of it
+	TEST_CHECK(!culler->isVisible(DXBoundingVolume(XMFLOAT3(50.0f, 50.0f, 50.0f), XMFLOAT3(5.0f, 5.0f, 5.0f))));
+	TEST_CHECK(culler->isVisible(DXBoundingVolume(XMFLOAT3(50.0f, 50.0f, 5.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+
+	// Behind the uncovered 30% of pixel 100
+	TEST_CHECK(culler->isVisible(DXBoundingVolume(XMFLOAT3(100.8f, 50.0f, 50.0f), XMFLOAT3(0.05f, 0.05f, 1.0f))));
+
+	// Beyond the occluder
+	TEST_CHECK(culler->isVisible(DXBoundingVolume(XMFLOAT3(150.0f, 50.0f, 50.0f), XMFLOAT3(2.0f, 2.0f, 2.0f))));
+
+	// Two occluders sharing an edge leave no gap along it
+	culler->beginFrame(pixelViewProjection(culler));
+
+	rasteriseRectangle(culler, -10.0f, -10.0f, 160.3f, 300.0f, 10.0f);
+	rasteriseRectangle(culler, 160.3f, -10.0f, 330.0f, 300.0f, 10.0f);
+
+	culler->endFrame();
+
+	TEST_CHECK(!culler->isVisible(DXBoundingVolume(XMFLOAT3(160.3f, 96.0f, 50.0f), XMFLOAT3(0.05f, 50.0f, 1.0f))));
+
+	culler->release();
+}
+
+
+BENCHMARK(occlusionCastleHull) {
+
+	vector<XMFLOAT3> positions, hull;
+	vector<uint32_t> indices, hullIndices;
+
+	if (!loadOBJ(CASTLE_MODEL_PATH, positions, indices)) {
+
+		cout << "  " << CASTLE_MODEL_PATH << " not found, skipped" << endl;
+		return;
+	}
+
+	TestTimer hullTimer;
+
+	DXOcclusionCuller::BuildOccluderHull(positions.data(), indices.data(), (uint32_t)indices.size(), DX_OCCLUSION_HULL_RES, DX_OCCLUSION_HULL_BOXES, hull, hullIndices);
+
+	double hullTime = hullTimer.seconds();
+
+	cout << "  hull build " << hullTime * 1000.0 << " ms, " << hull.size() / 8 << " boxes" << endl;
+
+	// View across the castle from outside its bounds, with random boxes behind it
+	DXBoundingVolume bounds = DXBoundingVolume::FromPoints(positions.data(), (uint32_t)positions.size());
+	XMVECTOR centre = XMLoadFloat3(&bounds.centre);
+	XMVECTOR eye = XMVectorAdd(centre, XMVectorSet(0.0f, bounds.extents.y * 0.5f, -3.0f * bounds.radius, 0.0f));
+
+	XMMATRIX viewProj = XMMatrixLookAtLH(eye, centre, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * XMMatrixPerspectiveFovLH(XM_PIDIV4, 320.0f / 192.0f, 0.1f, 1000.0f);
+
+	vector<DXBoundingVolume> occludees(10000);
+	TestRandom R(8);
+
+	for (uint32_t i = 0; i < occludees.size(); i++) {
+
+		XMFLOAT3 c(bounds.centre.x + R.uniform(-bounds.radius, bounds.radius), bounds.centre.y + R.uniform(-bounds.extents.y, bounds.extents.y), bounds.centre.z + R.uniform(bounds.radius, 3.0f * bounds.radius));
+
+		occludees[i] = DXBoundingVolume(c, XMFLOAT3(0.5f, 0.5f, 0.5f));
+	}
+
+	DXOcclusionCuller *culler = new DXOcclusionCuller(320, 192);
+
+	const vector<uint32_t> *occluderIndices[2] = { &indices, &hullIndices };
+	const vector<XMFLOAT3> *occluderPositions[2] = { &positions, &hull };
+	const char *labels[2][2] = { { "full mesh raster (per triangle)", "full mesh tests (per box)" }, { "hull raster (per triangle)", "hull tests (per box)" } };
+
+	for (int k = 0; k < 2; k++) {
+
+		const uint32_t numFrames = 200;
+		uint32_t numHidden = 0;
+
+		TestTimer rasterTimer;
+
+		for (uint32_t f = 0; f < numFrames; f++) {
+
+			culler->beginFrame(viewProj);
+			culler->rasteriseOccluder(occluderPositions[k]->data(), occluderIndices[k]->data(), (uint32_t)occluderIndices[k]->size(), XMMatrixIdentity());
+			culler->endFrame();
+		}
+
+		double rasterTime = rasterTimer.seconds();
+
+		TestTimer testTimer;
+
+		for (uint32_t i = 0; i < occludees.size(); i++)
+			if (!culler->isVisible(occludees[i]))
+				numHidden++;
+
+		double testTime = testTimer.seconds();
+
+		cout << "  " << occluderIndices[k]->size() / 3 << " occluder triangles, " << rasterTime * 1000.0 / numFrames << " ms per frame, " << numHidden << " of " << occludees.size() << " boxes hidden" << endl;
+
+		test_report(labels[k][0], (double)occluderIndices[k]->size() / 3 * numFrames, rasterTime);
+		test_report(labels[k][1], (double)occludees.size(), testTime);
+	}
+
+	culler->release();
+}
+
+#pragma endregion
@@ -0,0 +1,616 @@
+
+//
+// EntityTests.cpp
+//
+
+// Tests and benchmarks for the entity-component storage and its systems (DXEntityWorld and DXEntitySystems)
+
+#include <stdafx.h>
+#include <TestHarness.h>
+#include <DXEntitySystems.h>
+#include <DXTransform.h>
+#include <DXFrustumCuller.h>
+#include <GUParallel.h>
+#include <GUFrameAllocator.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace DirectX;
+
+
+#define ENTITY_TRANSFORM	(DX_COMPONENT_BIT(DX_COMPONENT_TRANSFORM) | DX_COMPONENT_BIT(DX_COMPONENT_WORLD))
+#define ENTITY_DRAWABLE		(DX_COMPONENT_BIT(DX_COMPONENT_MESH) | DX_COMPONENT_BIT(DX_COMPONENT_MATERIAL))
+#define ENTITY_BOUNDS		DX_COMPONENT_BIT(DX_COMPONENT_BOUNDS)
+#define ENTITY_LOD			DX_COMPONENT_BIT(DX_COMPONENT_LOD)
+
+// Archetypes of the scenes below
+static const uint32_t entityMasks[4] = { ENTITY_TRANSFORM | ENTITY_DRAWABLE | ENTITY_BOUNDS, ENTITY_TRANSFORM | ENTITY_DRAWABLE | ENTITY_BOUNDS | ENTITY_LOD, ENTITY_TRANSFORM | ENTITY_BOUNDS, ENTITY_TRANSFORM | ENTITY_DRAWABLE };
+
+
+// Fill world with count entities cycling through entityMasks, with random dirty transforms scattered over a square of the given size
+static void randomScene(DXEntityWorld *world, const uint32_t count, const float size, const uint32_t seed) {
+
+	TestRandom R(seed);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		DXEntity e = world->create(entityMasks[i % 4]);
+
+		DXTransformComponent *T = world->get<DXTransformComponent>(e);
+
+		XMStoreFloat4(&T->rotation, XMQuaternionRotationRollPitchYaw(R.uniform(-0.3f, 0.3f), R.uniform(0.0f, XM_2PI), R.uniform(-0.3f, 0.3f)));
+
+		T->scale = XMFLOAT3(R.uniform(0.5f, 2.0f), R.uniform(0.5f, 3.0f), R.uniform(0.5f, 2.0f));
+		T->translation = XMFLOAT3(R.uniform(-size, size), R.uniform(0.0f, 5.0f), R.uniform(-size, size));
+		T->dirty = 1;
+
+		if (DXBoundsComponent *B = world->get<DXBoundsComponent>(e))
+			B->local = DXBoundingVolume(XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+
+		if (DXMeshComponent *M = world->get<DXMeshComponent>(e))
+			M->mesh = R.next() % 7;
+
+		if (DXMaterialComponent *S = world->get<DXMaterialComponent>(e))
+			S->material = R.next() % 3;
+
+		if (DXLODComponent *L = world->get<DXLODComponent>(e)) {
+
+			L->distance[0] = 50.0f;
+			L->distance[1] = 150.0f;
+			L->distance[2] = 300.0f;
+		}
+	}
+}
+
+
+// Largest element difference of two matrices relative to the larger of 1 and the largest element of B
+static float matrixError(const XMFLOAT4X4& A, const XMFLOAT4X4& B) {
+
+	float e = 0.0f, scale = 1.0f;
+
+	for (int i = 0; i < 4; i++) {
+
+		for (int j = 0; j < 4; j++) {
+
+			e = max(e, fabsf(A.m[i][j] - B.m[i][j]));
+			scale = max(scale, fabsf(B.m[i][j]));
+		}
+	}
+
+	return e / scale;
+}
+
+
+#pragma region DXEntityWorld
+
+// Components survive creation, removal (which moves the last row of an archetype) and moves between archetypes, ids of destroyed entities are detected and chunks cover every entity
+TEST_CASE(entityWorldStorage) {
+
+	DXEntityWorld *world = new DXEntityWorld();
+	vector<DXEntity> entities;
+
+	for (uint32_t i = 0; i < 1000; i++) {
+
+		DXEntity e = world->create(entityMasks[i % 4]);
+
+		world->get<DXTransformComponent>(e)->translation.x = (float)i;
+
+		if (DXMeshComponent *M = world->get<DXMeshComponent>(e))
+			M->mesh = i;
+
+		entities.push_back(e);
+	}
+
+	TEST_CHECK(world->entityCount() == 1000 && world->archetypeCount() == 4);
+
+	for (uint32_t i = 0; i < 1000; i += 3)
+		world->destroy(entities[i]);
+
+	uint32_t numWrong = 0;
+
+	for (uint32_t i = 0; i < 1000; i++) {
+
+		bool alive = (i % 3) != 0;
+
+		if (world->isAlive(entities[i]) != alive)
+			numWrong++;
+		else if (alive && world->get<DXTransformComponent>(entities[i])->translation.x != (float)i)
+			numWrong++;
+		else if (alive && world->get<DXMeshComponent>(entities[i]) && world->get<DXMeshComponent>(entities[i])->mesh != i)
+			numWrong++;
+	}
+
+	TEST_CHECK(numWrong == 0);
+	TEST_CHECK(world->get<DXTransformComponent>(entities[0]) == nullptr);
+
+	// A reused record has a new generation so the old id stays dead
+	DXEntity reused = world->create(entityMasks[0]);
+
+	TEST_CHECK((reused & DX_ENTITY_INDEX_MASK) == (entities[999] & DX_ENTITY_INDEX_MASK) && reused != entities[999]);
+	TEST_CHECK(world->isAlive(reused) && !world->isAlive(entities[999]));
+
+	// Moving between archetypes keeps the id and the components that remain
+	for (uint32_t i = 1; i < 1000; i += 3) {
+
+		world->addComponents(entities[i], ENTITY_LOD);
+		world->removeComponents(entities[i], ENTITY_BOUNDS);
+	}
+
+	numWrong = 0;
+
+	for (uint32_t i = 1; i < 1000; i++) {
+
+		if (i % 3 == 0)
+			continue;
+
+		if (world->get<DXTransformComponent>(entities[i])->translation.x != (float)i)
+			numWrong++;
+
+		if (i % 3 == 1 && (!world->get<DXLODComponent>(entities[i]) || world->get<DXBoundsComponent>(entities[i]) || (world->componentMask(entities[i]) & ENTITY_LOD) == 0))
+			numWrong++;
+	}
+
+	TEST_CHECK(numWrong == 0);
+
+	vector<DXEntityChunk*> chunks;
+	uint32_t total = 0, numWithLOD = 0;
+
+	world->queryChunks(0, chunks);
+
+	for (uint32_t c = 0; c < chunks.size(); c++)
+		total += chunks[c]->count;
+
+	world->queryChunks(DX_COMPONENT_BIT(DX_COMPONENT_LOD), chunks);
+
+	for (uint32_t c = 0; c < chunks.size(); c++)
+		numWithLOD += chunks[c]->count;
+
+	TEST_CHECK(total == world->entityCount());
+	TEST_CHECK(numWithLOD > 0 && numWithLOD < total);
+
+	world->clear();
+
+	TEST_CHECK(world->entityCount() == 0 && !world->isAlive(reused));
+
+	world->release();
+}
+
+#pragma endregion
+
+
+#pragma region DXEntitySystems
+
+// The transform system matches DXTransform::Compose for dirty entities only, across batches and chunks, refreshes world bounds, clears the dirty flags and gives the same result on a thread pool
+TEST_CASE(entityTransformSystem) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	const uint32_t count = 5000;
+
+	DXEntityWorld *serialWorld = new DXEntityWorld(), *pooledWorld = new DXEntityWorld();
+	DXEntitySystems *systems = new DXEntitySystems();
+
+	randomScene(serialWorld, count, 200.0f, 1);
+	randomScene(pooledWorld, count, 200.0f, 1);
+
+	// Leave a run of clean rows and scattered clean rows, with a marker in their matrices
+	vector<DXEntityChunk*> chunks;
+	uint32_t numDirty = 0;
+
+	for (int w = 0; w < 2; w++) {
+
+		(w ? pooledWorld : serialWorld)->queryChunks(ENTITY_TRANSFORM, chunks);
+
+		for (uint32_t c = 0; c < chunks.size(); c++) {
+
+			DXTransformComponent *T = chunks[c]->components<DXTransformComponent>();
+			DXWorldComponent *W = chunks[c]->components<DXWorldComponent>();
+
+			for (uint32_t i = 0; i < chunks[c]->count; i++) {
+
+				if (i % 5 == 0 || (i >= 70 && i < 140)) {
+
+					T[i].dirty = 0;
+					W[i].world._44 = -7.0f;
+
+				} else if (w == 0) {
+
+					numDirty++;
+				}
+			}
+		}
+	}
+
+	TEST_CHECK(systems->updateTransforms(serialWorld) == numDirty);
+	TEST_CHECK(systems->updateTransforms(pooledWorld, nullptr, pool) == numDirty);
+
+	serialWorld->queryChunks(ENTITY_TRANSFORM, chunks);
+
+	vector<DXEntityChunk*> pooledChunks;
+
+	pooledWorld->queryChunks(ENTITY_TRANSFORM, pooledChunks);
+
+	TEST_CHECK(chunks.size() == pooledChunks.size() && chunks.size() > 4);
+
+	float worldError = 0.0f, normalError = 0.0f, boundsError = 0.0f;
+	uint32_t numStillDirty = 0, numCleanWritten = 0, numPoolMismatches = 0;
+
+	for (uint32_t c = 0; c < chunks.size() && c < pooledChunks.size(); c++) {
+
+		DXTransformComponent *T = chunks[c]->components<DXTransformComponent>();
+		DXWorldComponent *W = chunks[c]->components<DXWorldComponent>();
+		DXBoundsComponent *B = chunks[c]->components<DXBoundsComponent>();
+
+		if (memcmp(W, pooledChunks[c]->components<DXWorldComponent>(), chunks[c]->count * sizeof(DXWorldComponent)) != 0)
+			numPoolMismatches++;
+
+		for (uint32_t i = 0; i < chunks[c]->count; i++) {
+
+			numStillDirty += T[i].dirty;
+
+			if (i % 5 == 0 || (i >= 70 && i < 140)) {
+
+				numCleanWritten += (W[i].world._44 != -7.0f) ? 1 : 0;
+				continue;
+			}
+
+			XMMATRIX world, normal;
+			XMFLOAT4X4 referenceWorld, referenceNormal;
+
+			DXTransform::Compose(XMLoadFloat3(&T[i].scale), XMLoadFloat4(&T[i].rotation), XMLoadFloat3(&T[i].translation), &world, &normal);
+
+			XMStoreFloat4x4(&referenceWorld, world);
+			XMStoreFloat4x4(&referenceNormal, normal);
+
+			worldError = max(worldError, matrixError(W[i].world, referenceWorld));
+			normalError = max(normalError, matrixError(W[i].normal, referenceNormal));
+
+			if (B) {
+
+				DXBoundingVolume V = B[i].local.transform(world);
+
+				boundsError = max(boundsError, max(fabsf(V.centre.x - B[i].world.centre.x), fabsf(V.centre.z - B[i].world.centre.z)));
+				boundsError = max(boundsError, max(fabsf(V.extents.x - B[i].world.extents.x), fabsf(V.extents.y - B[i].world.extents.y)));
+			}
+		}
+	}
+
+	TEST_CHECK(worldError < 1.0e-5f);
+	TEST_CHECK(normalError < 1.0e-5f);
+	TEST_CHECK(boundsError < 1.0e-3f);
+	TEST_CHECK(numStillDirty == 0 && numCleanWritten == 0 && numPoolMismatches == 0);
+
+	// Nothing is dirty now
+	TEST_CHECK(systems->updateTransforms(serialWorld, nullptr, pool) == 0);
+
+	systems->release();
+	pooledWorld->release();
+	serialWorld->release();
+	pool->release();
+}
+
+
+// Culling agrees with testing each entity's bounds, detail levels follow the distances and the draw list holds the visible drawable entities sorted by draw key
+TEST_CASE(entityCullAndDrawList) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	DXEntityWorld *world = new DXEntityWorld();
+	DXEntitySystems *systems = new DXEntitySystems();
+
+	randomScene(world, 20000, 500.0f, 2);
+	systems->updateTransforms(world, nullptr, pool);
+
+	XMVECTOR eye = XMVectorSet(0.0f, 10.0f, 0.0f, 1.0f);
+	XMFLOAT4 planes[DX_NUM_FRUSTUM_PLANES];
+
+	DXFrustumCuller::ExtractPlanes(XMMatrixLookAtLH(eye, XMVectorSet(0.0f, 0.0f, 100.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * XMMatrixPerspectiveFovLH(1.0f, 1.6f, 0.1f, 400.0f), planes);
+
+	uint32_t numVisible = systems->cull(world, planes, eye, pool);
+
+	vector<DXEntityChunk*> chunks;
+	uint32_t expectedVisible = 0, expectedItems = 0, numWrongLevels = 0;
+
+	world->queryChunks(ENTITY_BOUNDS, chunks);
+
+	for (uint32_t c = 0; c < chunks.size(); c++) {
+
+		DXBoundsComponent *B = chunks[c]->components<DXBoundsComponent>();
+		DXLODComponent *L = chunks[c]->components<DXLODComponent>();
+
+		for (uint32_t i = 0; i < chunks[c]->count; i++) {
+
+			bool visible = DXFrustumCuller::BoxVisible(planes, B[i].world);
+
+			expectedVisible += (visible) ? 1 : 0;
+
+			if (visible && chunks[c]->has(DX_COMPONENT_MESH))
+				expectedItems++;
+
+			if (L) {
+
+				float d = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&B[i].world.centre), eye)));
+				uint32_t level = (d > 50.0f) + (d > 150.0f) + (d > 300.0f);
+
+				numWrongLevels += (L[i].level != level) ? 1 : 0;
+			}
+		}
+	}
+
+	// Drawable entities without bounds are always drawn
+	world->queryChunks(ENTITY_DRAWABLE | DX_COMPONENT_BIT(DX_COMPONENT_WORLD), chunks);
+
+	for (uint32_t c = 0; c < chunks.size(); c++)
+		if (!chunks[c]->has(DX_COMPONENT_BOUNDS))
+			expectedItems += chunks[c]->count;
+
+	TEST_CHECK(numVisible == expectedVisible && numVisible > 0 && numVisible < 15000);
+	TEST_CHECK(numWrongLevels == 0);
+
+	vector<DXDrawItem> drawList;
+
+	TEST_CHECK(systems->buildDrawList(world, drawList, pool) == expectedItems && drawList.size() == expectedItems);
+
+	uint32_t numUnsorted = 0, numWrongItems = 0;
+
+	for (uint32_t k = 0; k < drawList.size(); k++) {
+
+		const DXDrawItem& item = drawList[k];
+
+		if (k > 0 && DXEntitySystems::DrawKey(drawList[k - 1].material, drawList[k - 1].mesh, drawList[k - 1].lod) > DXEntitySystems::DrawKey(item.material, item.mesh, item.lod))
+			numUnsorted++;
+
+		const DXWorldComponent *W = world->get<DXWorldComponent>(item.entity);
+		const DXBoundsComponent *B = world->get<DXBoundsComponent>(item.entity);
+
+		if (!W || item.world != &W->world || item.normal != &W->normal || (B && !B->visible) || world->get<DXMeshComponent>(item.entity)->mesh != item.mesh)
+			numWrongItems++;
+	}
+
+	TEST_CHECK(numUnsorted == 0 && numWrongItems == 0);
+
+	// Gathering in parallel into per-thread frame arenas gives the same list.  Arenas too small for any block (with the overflow list soon used up) fall back to gathering on the calling thread
+	GUFrameAllocator *frame = GUFrameAllocator::CreateFrameAllocator(1024 * 1024, pool->threadCount());
+	GUFrameAllocator *tinyFrame = GUFrameAllocator::CreateFrameAllocator(64, pool->threadCount());
+
+	for (int k = 0; k < 2; k++) {
+
+		vector<DXDrawItem> arenaList;
+
+		frame->beginFrame();
+		tinyFrame->beginFrame();
+
+		uint32_t numItems = systems->buildDrawList(world, arenaList, pool, (k == 0) ? frame : tinyFrame);
+		uint32_t numDifferent = 0;
+
+		for (uint32_t i = 0; i < arenaList.size() && i < drawList.size(); i++)
+			if (arenaList[i].entity != drawList[i].entity || arenaList[i].lod != drawList[i].lod || arenaList[i].world != drawList[i].world)
+				numDifferent++;
+
+		TEST_CHECK(numItems == expectedItems && arenaList.size() == expectedItems);
+		TEST_CHECK(numDifferent == 0);
+	}
+
+	TEST_CHECK(frame->overflowCount() == 0);
+	TEST_CHECK(tinyFrame->overflowCount() > GU_FRAME_MAX_OVERFLOW);
+
+	tinyFrame->release();
+	frame->release();
+	systems->release();
+	world->release();
+	pool->release();
+}
+
+
+// Frames of transform updates, culling and draw list building on a thread pool make no heap calls once the scratch buffers are warmed up, measured with GUMemory's allocation counters
+TEST_CASE(entityFrameSteadyState) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+	GUFrameAllocator *frame = GUFrameAllocator::CreateFrameAllocator(256 * 1024, pool->threadCount());
+
+	DXEntityWorld *world = new DXEntityWorld();
+	DXEntitySystems *systems = new DXEntitySystems();
+
+	randomScene(world, 5000, 100.0f, 4);
+
+	vector<DXEntityChunk*> chunks;
+	vector<DXDrawItem> drawList;
+	unsigned long allocations = 0;
+
+	world->queryChunks(ENTITY_TRANSFORM, chunks);
+
+	for (uint32_t f = 0; f < 100; f++) {
+
+		// Frame 10 on is steady state
+		if (f == 10)
+			allocations = gu_memory_allocations();
+
+		frame->beginFrame();
+
+		// Move some of the entities
+		for (uint32_t c = f % 3; c < chunks.size(); c += 3) {
+
+			DXTransformComponent *T = chunks[c]->components<DXTransformComponent>();
+
+			for (uint32_t i = 0; i < chunks[c]->count; i += 7) {
+
+				T[i].translation.y = (float)(f % 5);
+				T[i].dirty = 1;
+			}
+		}
+
+		// Walk the camera along the scene
+		XMVECTOR eye = XMVectorSet((float)f - 50.0f, 10.0f, -60.0f, 1.0f);
+		XMFLOAT4 planes[DX_NUM_FRUSTUM_PLANES];
+
+		DXFrustumCuller::ExtractPlanes(XMMatrixLookAtLH(eye, XMVectorAdd(eye, XMVectorSet(0.0f, -0.1f, 1.0f, 0.0f)), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * XMMatrixPerspectiveFovLH(1.0f, 1.6f, 0.1f, 400.0f), planes);
+
+		systems->updateTransforms(world, nullptr, pool);
+		systems->cull(world, planes, eye, pool);
+		systems->buildDrawList(world, drawList, pool, frame);
+	}
+
+#ifdef __GU_DEBUG_MEMORY__
+
+	TEST_CHECK(gu_memory_allocations() == allocations);
+
+#endif
+
+	TEST_CHECK(frame->overflowCount() == 0);
+	TEST_CHECK(drawList.size() > 0);
+
+	systems->release();
+	world->release();
+	frame->release();
+	pool->release();
+}
+
+
+// Per-frame update, cull and draw list of scenes of 10k to 1M entities, against the same work on individually heap allocated objects
+BENCHMARK(entitySystems) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool();
+
+	XMVECTOR eye = XMVectorSet(0.0f, 10.0f, 0.0f, 1.0f);
+	XMFLOAT4 planes[DX_NUM_FRUSTUM_PLANES];
+
+	DXFrustumCuller::ExtractPlanes(XMMatrixLookAtLH(eye, XMVectorSet(0.0f, 0.0f, 100.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * XMMatrixPerspectiveFovLH(1.0f, 1.6f, 0.1f, 400.0f), planes);
+
+	cout << "  " << pool->threadCount() << " threads" << endl;
+
+	for (uint32_t count = 10000; count <= 1000000; count *= 10) {
+
+		DXEntityWorld *world = new DXEntityWorld();
+		DXEntitySystems *systems = new DXEntitySystems();
+
+		// A single frame with arenas twice the share of the draw list of an evenly loaded thread
+		GUFrameAllocator *frame = GUFrameAllocator::CreateFrameAllocator(2 * count * (sizeof(DXDrawItem) + sizeof(uint32_t)) / pool->threadCount() + 65536, pool->threadCount(), 1);
+
+		randomScene(world, count, 500.0f, 3);
+
+		vector<DXDrawItem> drawList;
+		vector<DXEntityChunk*> chunks;
+
+		// Warm up the scratch buffers
+		systems->updateTransforms(world);
+		systems->buildDrawList(world, drawList);
+
+		uint32_t numRepeats = max(3u, 2000000 / count);
+
+		cout << "  " << count << " entities" << endl;
+
+		// Serial, on the pool, and on the pool gathering the draw list into per-thread frame arenas
+		for (int mode = 0; mode < 3; mode++) {
+
+			GUParallel *p = (mode > 0) ? pool : nullptr;
+			GUFrameAllocator *F = (mode == 2) ? frame : nullptr;
+			double updateSeconds = 0.0, cullSeconds = 0.0, drawListSeconds = 0.0;
+
+			for (uint32_t r = 0; r < numRepeats; r++) {
+
+				world->queryChunks(ENTITY_TRANSFORM, chunks);
+
+				for (uint32_t c = 0; c < chunks.size(); c++) {
+
+					DXTransformComponent *T = chunks[c]->components<DXTransformComponent>();
+
+					for (uint32_t i = 0; i < chunks[c]->count; i++)
+						T[i].dirty = 1;
+				}
+
+				TestTimer timer;
+				systems->updateTransforms(world, nullptr, p);
+				updateSeconds += timer.seconds();
+
+				timer.reset();
+				systems->cull(world, planes, eye, p);
+				cullSeconds += timer.seconds();
+
+				frame->beginFrame();
+
+				timer.reset();
+				systems->buildDrawList(world, drawList, p, F);
+				drawListSeconds += timer.seconds();
+			}
+
+			const char *drawListLabel[3] = { "buildDrawList", "buildDrawList (pool)", "buildDrawList (pool, frame arenas)" };
+
+			if (mode < 2) {
+
+				test_report((mode) ? "updateTransforms (pool)" : "updateTransforms", count * numRepeats, updateSeconds);
+				test_report((mode) ? "cull (pool)" : "cull", count * numRepeats, cullSeconds);
+			}
+
+			test_report(drawListLabel[mode], count * numRepeats, drawListSeconds);
+		}
+
+		// The same transform and cull work on separately allocated objects
+		struct SceneObject {
+
+			XMFLOAT3					scale;
+			XMFLOAT4					rotation;
+			XMFLOAT3					translation;
+			XMFLOAT4X4					world, normal;
+			uint32_t					mesh, material;
+			DXBoundingVolume			local, bounds;
+			uint32_t					visible;
+		};
+
+		vector<SceneObject*> objects(count);
+		vector<char*> spacers(count);
+		TestRandom R(3);
+
+		for (uint32_t i = 0; i < count; i++) {
+
+			objects[i] = new SceneObject();
+			objects[i]->scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+			objects[i]->rotation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			objects[i]->translation = XMFLOAT3(R.uniform(-500.0f, 500.0f), 0.0f, R.uniform(-500.0f, 500.0f));
+			objects[i]->local = DXBoundingVolume(XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+
+			// Interleave other allocations as a scene built over time would
+			spacers[i] = new char[64];
+		}
+
+		TestTimer timer;
+
+		for (uint32_t r = 0; r < numRepeats; r++) {
+
+			for (uint32_t i = 0; i < count; i++) {
+
+				SceneObject *o = objects[i];
+				XMMATRIX W, N;
+
+				DXTransform::Compose(XMLoadFloat3(&o->scale), XMLoadFloat4(&o->rotation), XMLoadFloat3(&o->translation), &W, &N);
+
+				XMStoreFloat4x4(&o->world, W);
+				XMStoreFloat4x4(&o->normal, N);
+
+				o->bounds = o->local.transform(W);
+				o->visible = DXFrustumCuller::BoxVisible(planes, o->bounds) ? 1 : 0;
+			}
+		}
+
+		test_report("heap objects update + cull", count * numRepeats, timer.seconds());
+
+		for (uint32_t i = 0; i < count; i++) {
+
+			delete objects[i];
+			delete[] spacers[i];
+		}
+
+		frame->report();
+
+		frame->release();
+		systems->release();
+		world->release();
+	}
+
+	pool->release();
+}
+
+#pragma endregion
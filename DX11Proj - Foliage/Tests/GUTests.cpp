@@ -0,0 +1,669 @@
+
+//
+// GUTests.cpp
+//
+
+// Tests and benchmarks for the GU utility classes (GURadixSort, GURef, GUParallel and GUFrameAllocator)
+
+#include <stdafx.h>
+#include <TestHarness.h>
+#include <GURadixSort.h>
+#include <GUParallel.h>
+#include <GURef.h>
+#include <GUFrameAllocator.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <atomic>
+#include <cstring>
+
+using namespace std;
+
+
+#pragma region GURadixSort
+
+// Random keys masked to the given number of bits, with values holding the original index
+static void randomKeys(vector<uint32_t>& keys, vector<uint32_t>& values, const uint32_t count, const uint32_t keyBits, const uint32_t seed) {
+
+	TestRandom R(seed);
+	uint32_t mask = (keyBits >= 32) ? 0xFFFFFFFF : (1u << keyBits) - 1;
+
+	keys.resize(count);
+	values.resize(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		keys[i] = R.next() & mask;
+		values[i] = i;
+	}
+}
+
+
+// Sort with GURadixSort and compare against std::stable_sort of the same key / value pairs
+static bool radixSortMatchesStableSort(GURadixSort *sorter, const uint32_t count, const uint32_t keyBits, GUParallel *pool) {
+
+	vector<uint32_t> keys, values;
+
+	randomKeys(keys, values, count, keyBits, count * 31 + keyBits);
+
+	vector<pair<uint32_t, uint32_t> > expected(count);
+
+	for (uint32_t i = 0; i < count; i++)
+		expected[i] = make_pair(keys[i], values[i]);
+
+	stable_sort(expected.begin(), expected.end(), [](const pair<uint32_t, uint32_t>& a, const pair<uint32_t, uint32_t>& b) { return a.first < b.first; });
+
+	sorter->sort(keys.data(), values.data(), count, pool);
+
+	for (uint32_t i = 0; i < count; i++)
+		if (keys[i] != expected[i].first || values[i] != expected[i].second)
+			return false;
+
+	return true;
+}
+
+
+// The sort is stable and matches std::stable_sort for full and quantised keys, for counts below and across several parallel blocks
+TEST_CASE(radixSortMatchesStableSort) {
+
+	GURadixSort *sorter = new GURadixSort();
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	const uint32_t counts[] = { 0, 1, 2, 255, 1000, GU_RADIX_MIN_BLOCK + 1, GU_RADIX_MIN_BLOCK * 5 + 77 };
+	const uint32_t keyBits[] = { 1, 8, 16, 24, 32 };
+
+	for (uint32_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+
+		for (uint32_t b = 0; b < sizeof(keyBits) / sizeof(keyBits[0]); b++) {
+
+			TEST_CHECK(radixSortMatchesStableSort(sorter, counts[c], keyBits[b], nullptr));
+			TEST_CHECK(radixSortMatchesStableSort(sorter, counts[c], keyBits[b], pool));
+		}
+	}
+
+	// Every key the same, so every pass is skipped
+	vector<uint32_t> keys(1000, 0xABCDEF01), values(1000);
+
+	for (uint32_t i = 0; i < 1000; i++)
+		values[i] = 999 - i;
+
+	sorter->sort(keys.data(), values.data(), 1000, pool);
+
+	TEST_CHECK(values[0] == 999 && values[999] == 0);
+
+	pool->release();
+	sorter->release();
+}
+
+
+// FloatKey preserves the order of floats including negative values and zeros
+TEST_CASE(radixSortFloatKeys) {
+
+	const float values[] = { -1.0e30f, -1000.0f, -1.5f, -1.0f, -1.0e-30f, -0.0f, 0.0f, 1.0e-30f, 1.0f, 1.5f, 1000.0f, 1.0e30f };
+	const uint32_t n = sizeof(values) / sizeof(values[0]);
+
+	for (uint32_t i = 0; i + 1 < n; i++)
+		TEST_CHECK(GURadixSort::FloatKey(values[i]) < GURadixSort::FloatKey(values[i + 1]));
+
+	// Sorting depths by their keys gives the same order as sorting the depths
+	TestRandom R(5);
+	vector<float> depths(5000);
+	vector<uint32_t> keys(5000), indices(5000);
+
+	for (uint32_t i = 0; i < depths.size(); i++) {
+
+		depths[i] = R.uniform(-500.0f, 500.0f);
+		keys[i] = GURadixSort::FloatKey(depths[i]);
+		indices[i] = i;
+	}
+
+	GURadixSort *sorter = new GURadixSort();
+
+	sorter->sort(keys.data(), indices.data(), (uint32_t)keys.size());
+
+	uint32_t numOutOfOrder = 0;
+
+	for (uint32_t i = 0; i + 1 < indices.size(); i++)
+		if (depths[indices[i]] > depths[indices[i + 1]])
+			numOutOfOrder++;
+
+	TEST_CHECK(numOutOfOrder == 0);
+
+	sorter->release();
+}
+
+
+BENCHMARK(radixSortKeysAndValues) {
+
+	GURadixSort *sorter = new GURadixSort();
+	GUParallel *pool = GUParallel::CreateThreadPool();
+
+	cout << "  " << pool->threadCount() << " threads" << endl;
+
+	const uint32_t counts[] = { 100000, 250000, 500000, 1000000 };
+
+	for (uint32_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+
+		uint32_t count = counts[c];
+		uint32_t numRepeats = max(5u, 20000000 / count);
+
+		sorter->reserve(count, pool);
+
+		cout << "  " << count << " keys" << endl;
+
+		// 16 bit keys are what ParticleEffects::sortByDepth produces
+		for (uint32_t keyBits = 16; keyBits <= 32; keyBits += 16) {
+
+			vector<uint32_t> sourceKeys, sourceValues, keys, values;
+
+			randomKeys(sourceKeys, sourceValues, count, keyBits, 7);
+
+			double radixTime = 0.0, poolTime = 0.0, stdTime = 0.0;
+
+			for (uint32_t k = 0; k < numRepeats; k++) {
+
+				keys = sourceKeys;
+				values = sourceValues;
+
+				TestTimer radixTimer;
+				sorter->sort(keys.data(), values.data(), count);
+				radixTime += radixTimer.seconds();
+
+				keys = sourceKeys;
+				values = sourceValues;
+
+				TestTimer poolTimer;
+				sorter->sort(keys.data(), values.data(), count, pool);
+				poolTime += poolTimer.seconds();
+			}
+
+			// std::sort of packed key / value pairs for comparison
+			vector<uint64_t> packed(count);
+
+			for (uint32_t k = 0; k < numRepeats; k++) {
+
+				for (uint32_t i = 0; i < count; i++)
+					packed[i] = ((uint64_t)sourceKeys[i] << 32) | sourceValues[i];
+
+				TestTimer stdTimer;
+				sort(packed.begin(), packed.end());
+				stdTime += stdTimer.seconds();
+			}
+
+			test_report((keyBits == 16) ? "radix sort, 16 bit keys" : "radix sort, 32 bit keys", (double)count * numRepeats, radixTime);
+			test_report((keyBits == 16) ? "radix sort (pool), 16 bit keys" : "radix sort (pool), 32 bit keys", (double)count * numRepeats, poolTime);
+			test_report((keyBits == 16) ? "std::sort, 16 bit keys" : "std::sort, 32 bit keys", (double)count * numRepeats, stdTime);
+		}
+	}
+
+	pool->release();
+	sorter->release();
+}
+
+#pragma endregion
+
+
+
+#pragma region GURef
+
+// Number of live and deleted TrackedObjects.  A payload word is checked and cleared on deletion so an object deleted twice fails the test rather than going unnoticed
+static atomic<int> trackedAlive(0), trackedDeleted(0), trackedCorrupt(0);
+
+class TrackedObject : public GUObject {
+
+	uint32_t			payload[16];
+
+public:
+
+	TrackedObject() {
+
+		for (uint32_t i = 0; i < 16; i++)
+			payload[i] = i;
+
+		trackedAlive++;
+	}
+
+	~TrackedObject() {
+
+		if (payload[3] != 3)
+			trackedCorrupt++;
+
+		payload[3] = 0xDEADBEEF;
+
+		trackedAlive--;
+		trackedDeleted++;
+	}
+};
+
+class TrackedDerived : public TrackedObject {
+};
+
+
+// Copy, move, Retain, reset, detach and derived to base conversion take and give back exactly one reference each
+TEST_CASE(guRefSemantics) {
+
+	trackedCorrupt = 0;
+
+	{
+		GURef<TrackedObject> a(new TrackedDerived());
+		GURef<TrackedObject> b = a;
+
+		TEST_CHECK(a->getRetainCount() == 2);
+
+		// Self assignment keeps the object
+		b = b;
+		TEST_CHECK(a->getRetainCount() == 2);
+
+		a = std::move(a);
+		TEST_CHECK(a && a->getRetainCount() == 2);
+
+		GURef<TrackedObject> c = GURef<TrackedObject>::Retain(a.get());
+		TEST_CHECK(c->getRetainCount() == 3);
+
+		GURef<TrackedObject> d(std::move(c));
+		TEST_CHECK(!c && d.get() == a.get() && d->getRetainCount() == 3);
+
+		TrackedObject *raw = d.detach();
+		TEST_CHECK(!d && raw->getRetainCount() == 3);
+		raw->release();
+
+		GURef<GUObject> base(a);
+		TEST_CHECK(a->getRetainCount() == 3);
+
+		b.reset();
+		a.reset();
+		TEST_CHECK(trackedAlive == 1);
+
+		base.reset(new TrackedObject());
+		TEST_CHECK(trackedAlive == 1);
+	}
+
+	TEST_CHECK(trackedAlive == 0);
+	TEST_CHECK(trackedCorrupt == 0);
+}
+
+
+// Objects shared between the pool threads through GURefs are deleted exactly once, including when the last reference is dropped on a worker thread
+TEST_CASE(guRefThreadStress) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(8);
+
+	const uint32_t numObjects = 64;
+	const uint32_t numBlocks = pool->threadCount() * 4;
+	const uint32_t numRounds = 200;
+
+	trackedAlive = 0;
+	trackedCorrupt = 0;
+
+	uint32_t leaked = 0;
+
+	for (uint32_t round = 0; round < numRounds; round++) {
+
+		vector<GURef<TrackedObject> > shared;
+
+		for (uint32_t i = 0; i < numObjects; i++)
+			shared.push_back(GURef<TrackedObject>(new TrackedObject()));
+
+		// Each block starts with its own references to every third object, so every object is held by several blocks.  The shared references are dropped before the loop so the last release of every object happens on whichever thread finishes with it last
+		vector<vector<GURef<TrackedObject> > > held(numBlocks);
+
+		for (uint32_t b = 0; b < numBlocks; b++)
+			for (uint32_t i = b % 3; i < numObjects; i += 3)
+				held[b].push_back(shared[i]);
+
+		shared.clear();
+
+		pool->parallelFor(numBlocks, 1, [&](uint32_t begin, uint32_t end) {
+
+			for (uint32_t b = begin; b < end; b++) {
+
+				vector<GURef<TrackedObject> > local;
+
+				for (uint32_t k = 0; k < 500; k++) {
+
+					GURef<TrackedObject> a = held[b][(k * 7) % held[b].size()];
+					GURef<TrackedObject> c(std::move(a));
+
+					c->retain();
+					c->release();
+
+					local.push_back(c);
+
+					if (local.size() > 16)
+						local.erase(local.begin());
+				}
+
+				held[b].clear();
+			}
+		});
+
+		if (trackedAlive != 0)
+			leaked++;
+	}
+
+	// Raw retain / release with the final release racing between threads
+	vector<TrackedObject*> objects(10000);
+
+	for (uint32_t i = 0; i < objects.size(); i++) {
+
+		objects[i] = new TrackedObject();
+
+		for (uint32_t k = 1; k < numBlocks; k++)
+			objects[i]->retain();
+	}
+
+	pool->parallelFor(numBlocks, 1, [&](uint32_t begin, uint32_t end) {
+
+		for (uint32_t b = begin; b < end; b++)
+			for (uint32_t i = 0; i < objects.size(); i++)
+				objects[i]->release();
+	});
+
+	TEST_CHECK(leaked == 0);
+	TEST_CHECK(trackedAlive == 0);
+	TEST_CHECK(trackedCorrupt == 0);
+
+	pool->release();
+}
+
+
+// Cost of a retain / release pair with the atomic count and with a thread-confined object
+BENCHMARK(retainRelease) {
+
+	const uint32_t numPairs = 50000000;
+
+	TrackedObject *obj = new TrackedObject();
+
+	TestTimer atomicTimer;
+
+	for (uint32_t i = 0; i < numPairs; i++) {
+
+		obj->retain();
+		obj->release();
+	}
+
+	double atomicTime = atomicTimer.seconds();
+
+	obj->setThreadConfined(true);
+
+	TestTimer confinedTimer;
+
+	for (uint32_t i = 0; i < numPairs; i++) {
+
+		obj->retain();
+		obj->release();
+	}
+
+	double confinedTime = confinedTimer.seconds();
+
+	test_report("retain / release, atomic", (double)numPairs, atomicTime);
+	test_report("retain / release, thread-confined", (double)numPairs, confinedTime);
+
+	obj->release();
+}
+
+#pragma endregion
+
+
+
+#pragma region GUParallel
+
+// parallelForPerThread covers every index once in blocks of grain, and gives each block a thread index below threadCount() that no other block is using at the same time
+TEST_CASE(parallelForThreadIndex) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	const uint32_t n = 100000, grain = 64;
+	const uint32_t numThreads = pool->threadCount();
+
+	vector<atomic<uint32_t> > visits(n);
+	vector<atomic<uint32_t> > threadBusy(numThreads);
+	atomic<uint32_t> badBlocks(0), badThreads(0), overlaps(0);
+
+	for (uint32_t i = 0; i < n; i++)
+		visits[i] = 0;
+
+	for (uint32_t t = 0; t < numThreads; t++)
+		threadBusy[t] = 0;
+
+	pool->parallelForPerThread(n, grain, [&](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+
+		if (begin % grain != 0 || end != min(begin + grain, n))
+			badBlocks++;
+
+		if (threadIndex >= numThreads) {
+
+			badThreads++;
+			return;
+		}
+
+		if (threadBusy[threadIndex].exchange(1) != 0)
+			overlaps++;
+
+		for (uint32_t i = begin; i < end; i++)
+			visits[i]++;
+
+		threadBusy[threadIndex] = 0;
+	});
+
+	uint32_t missed = 0;
+
+	for (uint32_t i = 0; i < n; i++)
+		if (visits[i] != 1)
+			missed++;
+
+	TEST_CHECK(missed == 0);
+	TEST_CHECK(badBlocks == 0 && badThreads == 0 && overlaps == 0);
+
+	// A loop of a single block runs on the calling thread
+	uint32_t singleThread = 0xFFFFFFFF;
+
+	pool->parallelForPerThread(grain, grain, [&](uint32_t, uint32_t, uint32_t threadIndex) { singleThread = threadIndex; });
+
+	TEST_CHECK(singleThread == 0);
+
+	pool->release();
+}
+
+#pragma endregion
+
+
+#pragma region GUFrameAllocator
+
+// Allocations are aligned, stay valid for numFrames - 1 further frames and are served from the heap (and freed when their frame is reused) once an arena is full
+TEST_CASE(frameAllocatorFrames) {
+
+	GUFrameAllocator *frame = GUFrameAllocator::CreateFrameAllocator(4096, 2, 3);
+
+	TEST_CHECK(frame && frame->arenaCount() == 2);
+	TEST_CHECK(GUFrameAllocator::CreateFrameAllocator(4096, 0) == nullptr);
+
+	uint32_t misaligned = 0, corrupt = 0;
+	uint32_t *history[3] = { nullptr, nullptr, nullptr };
+
+	for (uint32_t f = 0; f < 20; f++) {
+
+		frame->beginFrame();
+
+		TEST_CHECK(frame->bytesUsed(0) == 0 && frame->bytesUsed(1) == 0);
+
+		// The previous two frames' data is still intact
+		for (uint32_t k = 1; k < 3 && k <= f; k++) {
+
+			uint32_t *h = history[(f - k) % 3];
+
+			for (uint32_t i = 0; i < 256; i++)
+				if (h[i] != (f - k) * 1000 + i)
+					corrupt++;
+		}
+
+		uint32_t *h = frame->allocateArray<uint32_t>(256, f % 2);
+
+		for (uint32_t i = 0; i < 256; i++)
+			h[i] = f * 1000 + i;
+
+		history[f % 3] = h;
+
+		for (size_t alignment = 1; alignment <= GU_FRAME_ARENA_ALIGNMENT; alignment *= 2) {
+
+			void *ptr = frame->allocate(3, alignment, (f + 1) % 2);
+
+			if (((uintptr_t)ptr & (alignment - 1)) != 0)
+				misaligned++;
+		}
+	}
+
+	TEST_CHECK(misaligned == 0);
+	TEST_CHECK(corrupt == 0);
+	TEST_CHECK(frame->overflowCount() == 0);
+	TEST_CHECK(frame->getPeakBytes() >= 1024 && frame->getPeakBytes() <= 4096);
+
+	// Requests larger than an arena overflow to the heap.  The blocks are freed when the frame is reused
+	unsigned long allocations = gu_memory_allocations();
+	unsigned long deallocations = gu_memory_deallocations();
+
+	frame->beginFrame();
+
+	uint8_t *big = (uint8_t*)frame->allocate(1 << 20);
+
+	TEST_CHECK(big != nullptr && frame->overflowCount() == 1 && frame->overflowSize() == (1 << 20));
+
+	if (big)
+		memset(big, 1, 1 << 20);
+
+	for (uint32_t f = 0; f < 3; f++)
+		frame->beginFrame();
+
+#ifdef __GU_DEBUG_MEMORY__
+
+	TEST_CHECK(gu_memory_allocations() - allocations == 1);
+	TEST_CHECK(gu_memory_deallocations() - deallocations == 1);
+
+#endif
+
+	// Once GU_FRAME_MAX_OVERFLOW blocks are in use requests fail
+	uint32_t failed = 0;
+
+	for (uint32_t i = 0; i < GU_FRAME_MAX_OVERFLOW + 4; i++)
+		if (!frame->allocate(8192))
+			failed++;
+
+	TEST_CHECK(failed == 4);
+
+	frame->release();
+}
+
+
+// State shared with the blocks of frameAllocatorSteadyState's loops.  The loop body only captures a reference to it so starting a loop does not allocate
+struct FrameTestState {
+
+	GUFrameAllocator					*frame;
+	uint32_t							frameNumber;
+	atomic<uint32_t>					misaligned;
+	atomic<uint32_t>					failed;
+};
+
+
+// Allocating from per-thread arenas in parallel loops makes no heap calls once the arenas are large enough, measured with GUMemory's allocation counters
+TEST_CASE(frameAllocatorSteadyState) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	FrameTestState S;
+
+	S.frame = GUFrameAllocator::CreateFrameAllocator(64 * 1024, pool->threadCount());
+	S.misaligned = 0;
+	S.failed = 0;
+
+	unsigned long allocations = 0;
+
+	for (uint32_t f = 0; f < 200; f++) {
+
+		// Frame 10 on is steady state
+		if (f == 10)
+			allocations = gu_memory_allocations();
+
+		S.frame->beginFrame();
+		S.frameNumber = f;
+
+		pool->parallelForPerThread(64, 1, [&S](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+
+			for (uint32_t b = begin; b < end; b++) {
+
+				uint32_t n = 16 + (b * 37 + S.frameNumber) % 200;
+				float *v = S.frame->allocateArray<float>(n, threadIndex);
+
+				if (!v) {
+
+					S.failed++;
+					continue;
+				}
+
+				if (((uintptr_t)v & 15) != 0)
+					S.misaligned++;
+
+				for (uint32_t i = 0; i < n; i++)
+					v[i] = (float)i;
+			}
+		});
+
+		// Small single-threaded allocations, like the culling lists built on the calling thread
+		for (uint32_t i = 0; i < 1000; i++)
+			S.frame->allocate(24, 16, 0);
+	}
+
+#ifdef __GU_DEBUG_MEMORY__
+
+	TEST_CHECK(gu_memory_allocations() == allocations);
+
+#endif
+
+	TEST_CHECK(S.frame->overflowCount() == 0);
+	TEST_CHECK(S.misaligned == 0 && S.failed == 0);
+
+	S.frame->release();
+	pool->release();
+}
+
+
+// Cost of a small bump allocation compared with malloc / free
+BENCHMARK(frameAllocator) {
+
+	const uint32_t numFrames = 1000, numAllocations = 2000;
+
+	GUFrameAllocator *frame = GUFrameAllocator::CreateFrameAllocator(numAllocations * 32);
+	vector<void*> blocks(numAllocations);
+
+	double frameTime = 0.0, mallocTime = 0.0;
+
+	for (uint32_t f = 0; f < numFrames; f++) {
+
+		frame->beginFrame();
+
+		TestTimer frameTimer;
+
+		for (uint32_t i = 0; i < numAllocations; i++)
+			blocks[i] = frame->allocate(24);
+
+		frameTime += frameTimer.seconds();
+
+		TestTimer mallocTimer;
+
+		for (uint32_t i = 0; i < numAllocations; i++)
+			blocks[i] = malloc(24);
+
+		for (uint32_t i = 0; i < numAllocations; i++)
+			free(blocks[i]);
+
+		mallocTime += mallocTimer.seconds();
+	}
+
+	test_report("frame allocator", (double)numFrames * numAllocations, frameTime);
+	test_report("malloc / free", (double)numFrames * numAllocations, mallocTime);
+
+	frame->report();
+	frame->release();
+}
+
+#pragma endregion
@@ -0,0 +1,1438 @@
+
+//
+// MatrixTests.cpp
+//
+
+// Tests and benchmarks for the CoreStructures matrix library (matrix_kernel, fixed_matrix, matrix expressions, the LU decomposition, sparse matrices and symmetric eigen-decomposition)
+
+#include <stdafx.h>
+#include <TestHarness.h>
+#include <GUParallel.h>
+#include <CoreStructures\matrix.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <set>
+
+using namespace std;
+using namespace CoreStructures;
+
+
+// Column-major n x m array of uniform values in [-1, 1]
+template <typename T>
+static vector<T> randomArray(const uint32_t n, const uint32_t m, const uint32_t seed) {
+
+	TestRandom R(seed);
+	vector<T> A(n * m);
+
+	for (uint32_t i = 0; i < A.size(); i++)
+		A[i] = (T)R.uniform(-1.0f, 1.0f);
+
+	return A;
+}
+
+
+template <typename T>
+static matrix<T> randomMatrix(const uint32_t n, const uint32_t m, const uint32_t seed) {
+
+	vector<T> A = randomArray<T>(n, m, seed);
+
+	return matrix<T>(n, m, (const T*)A.data());
+}
+
+
+// Largest absolute element of a matrix
+template <typename T>
+static double maxAbs(const matrix<T>& A) {
+
+	double e = 0.0;
+
+	for (uint32_t j = 1; j <= A.columns(); j++)
+		for (uint32_t i = 1; i <= A.rows(); i++)
+			e = max(e, (double)fabs(A(i, j)));
+
+	return e;
+}
+
+
+// True if A and B have the same order and their elements differ by at most tolerance
+template <typename T>
+static bool closeMatrices(const matrix<T>& A, const matrix<T>& B, const double tolerance) {
+
+	if (A.is_null() || B.is_null())
+		return A.is_null() && B.is_null();
+
+	return A.rows() == B.rows() && A.columns() == B.columns() && maxAbs(A - B) <= tolerance;
+}
+
+
+// Route matrix_parallel_for through a thread pool, or run serially if pool is nullptr
+static void matrixThreadPool(GUParallel *pool) {
+
+	if (pool)
+		matrix_set_parallel_for([pool](unsigned int n, unsigned int grain, const function<void(unsigned int, unsigned int)>& fn) { pool->parallelFor(n, grain, fn); });
+	else
+		matrix_set_parallel_for(matrix_parallel_for_fn());
+}
+
+
+#pragma region matrix_kernel
+
+// C = AB accumulated in long double
+template <typename T>
+static vector<long double> referenceMultiply(const vector<T>& A, const vector<T>& B, const uint32_t n, const uint32_t m, const uint32_t p) {
+
+	vector<long double> C(n * p, 0.0L);
+
+	for (uint32_t j = 0; j < p; j++)
+		for (uint32_t k = 0; k < m; k++)
+			for (uint32_t i = 0; i < n; i++)
+				C[j * n + i] += (long double)A[k * n + i] * (long double)B[j * m + k];
+
+	return C;
+}
+
+
+// Multiplication and the row and column kernels of the SIMD specialisation match long double references.  Sizes straddle the register widths and the 128 row panels of A
+template <typename T>
+static void checkMatrixKernels(const double tolerance) {
+
+	const uint32_t sizes[][3] = { { 1, 1, 1 }, { 3, 5, 2 }, { 4, 4, 4 }, { 7, 9, 11 }, { 17, 130, 33 }, { 129, 257, 5 }, { 300, 200, 150 } };
+
+	for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+
+		uint32_t n = sizes[s][0], m = sizes[s][1], p = sizes[s][2];
+
+		vector<T> A = randomArray<T>(n, m, s * 3 + 1);
+		vector<T> B = randomArray<T>(m, p, s * 3 + 2);
+		vector<T> C0 = randomArray<T>(n, p, s * 3 + 3);
+		vector<T> C(n * p), D = C0;
+
+		vector<long double> R = referenceMultiply(A, B, n, m, p);
+
+		matrix_kernel<T>::multiply(A.data(), B.data(), C.data(), n, m, p);
+		matrix_kernel<T>::multiply_add(A.data(), B.data(), D.data(), n, m, p, (T)-0.5);
+
+		double multiplyError = 0.0, multiplyAddError = 0.0;
+
+		for (uint32_t i = 0; i < n * p; i++) {
+
+			multiplyError = max(multiplyError, (double)fabsl(C[i] - R[i]));
+			multiplyAddError = max(multiplyAddError, (double)fabsl(D[i] - (C0[i] - 0.5L * R[i])));
+		}
+
+		// Rounding grows with the length of the dot products
+		TEST_CHECK(multiplyError < tolerance * sqrt((double)m));
+		TEST_CHECK(multiplyAddError < tolerance * sqrt((double)m));
+
+		// matrix<T>::operator* goes through the same kernel
+		matrix<T> MC = matrix<T>(n, m, (const T*)A.data()) * matrix<T>(m, p, (const T*)B.data());
+
+		TEST_CHECK(MC.rows() == n && MC.columns() == p && equal(C.begin(), C.end(), MC.data()));
+	}
+
+	// Row (strided) and column (contiguous) operations against the generic kernels in long double
+	double rowColumnError = 0.0;
+
+	const uint32_t rows[] = { 1, 3, 8, 13 };
+	const uint32_t columns[] = { 1, 5, 9, 16 };
+
+	for (uint32_t a = 0; a < 4; a++) {
+
+		for (uint32_t b = 0; b < 4; b++) {
+
+			uint32_t n = rows[a], m = columns[b];
+
+			vector<T> X = randomArray<T>(n, m, a * 4 + b);
+			vector<long double> Z(X.begin(), X.end());
+
+			// Rows 1 and n
+			matrix_kernel<T>::swap(X.data(), X.data() + n - 1, m, n);
+			matrix_kernel<long double>::swap(Z.data(), Z.data() + n - 1, m, n);
+
+			matrix_kernel<T>::axpby(X.data(), (T)0.5, X.data() + n - 1, (T)2, m, n);
+			matrix_kernel<long double>::axpby(Z.data(), 0.5L, Z.data() + n - 1, 2.0L, m, n);
+
+			matrix_kernel<T>::scale(X.data(), (T)3, m, n);
+			matrix_kernel<long double>::scale(Z.data(), 3.0L, m, n);
+
+			// Columns 1 and m
+			matrix_kernel<T>::axpy(X.data(), (T)0.25, X.data() + (m - 1) * n, n, 1);
+			matrix_kernel<long double>::axpy(Z.data(), 0.25L, Z.data() + (m - 1) * n, n, 1);
+
+			// The kernels do not support aliased columns, so these need two
+			if (m > 1) {
+
+				matrix_kernel<T>::rotate(X.data(), X.data() + (m - 1) * n, (T)0.6, (T)0.8, n, 1);
+				matrix_kernel<long double>::rotate(Z.data(), Z.data() + (m - 1) * n, 0.6L, 0.8L, n, 1);
+
+				matrix_kernel<T>::swap(X.data(), X.data() + n, n, 1);
+				matrix_kernel<long double>::swap(Z.data(), Z.data() + n, n, 1);
+			}
+
+			for (uint32_t i = 0; i < n * m; i++)
+				rowColumnError = max(rowColumnError, (double)fabsl(X[i] - Z[i]));
+
+			long double dot = matrix_kernel<long double>::dot(Z.data(), Z.data() + n - 1, m, n);
+
+			rowColumnError = max(rowColumnError, (double)fabsl(matrix_kernel<T>::dot(X.data(), X.data() + n - 1, m, n) - dot) / sqrt((double)m));
+		}
+	}
+
+	TEST_CHECK(rowColumnError < tolerance * 10.0);
+}
+
+
+TEST_CASE(matrixKernelsMatchReference) {
+
+	checkMatrixKernels<float>(1.0e-5);
+	checkMatrixKernels<double>(1.0e-13);
+
+	// Row and column operations of matrix<T>
+	matrix<double> F(2, 2, 1.0, 2.0, 3.0, 4.0);
+
+	F.colInterchange(1, 2);
+	F.rowInterchange(1, 2);
+	F.rowAddition(1, 2.0, 2);
+
+	TEST_CHECK(F == matrix<double>(2, 2, 4.0, 3.0, 10.0, 7.0));
+}
+
+
+// C = AB with the loops of the generic kernel
+template <typename T>
+static void naiveMultiply(const T *A, const T *B, T *C, const uint32_t n, const uint32_t m, const uint32_t p) {
+
+	for (uint32_t i = 0; i < n; i++) {
+
+		for (uint32_t j = 0; j < p; j++) {
+
+			T sum = T(0);
+
+			for (uint32_t k = 0; k < m; k++)
+				sum += A[k * n + i] * B[j * m + k];
+
+			C[j * n + i] = sum;
+		}
+	}
+}
+
+
+template <typename T>
+static void benchmarkMultiply(const char *typeName) {
+
+	cout << "  " << typeName << ", SIMD " << ((matrix_kernel<T>::simd) ? "on" : "off") << endl;
+
+	for (uint32_t n = 4; n <= 1024; n *= 4) {
+
+		vector<T> A = randomArray<T>(n, n, 1), B = randomArray<T>(n, n, 2), C(n * n);
+
+		double flops = 2.0 * (double)n * n * n;
+		uint32_t numRepeats = (uint32_t)max(1.0, 2.0e8 / flops);
+
+		TestTimer kernelTimer;
+
+		for (uint32_t k = 0; k < numRepeats; k++)
+			matrix_kernel<T>::multiply(A.data(), B.data(), C.data(), n, n, n);
+
+		double kernelTime = kernelTimer.seconds();
+
+		cout << "  n = " << n << endl;
+		test_report("matrix_kernel multiply (flops)", flops * numRepeats, kernelTime);
+
+		// The scalar loops take seconds beyond this
+		if (n > 256)
+			continue;
+
+		TestTimer naiveTimer;
+
+		for (uint32_t k = 0; k < numRepeats; k++)
+			naiveMultiply(A.data(), B.data(), C.data(), n, n, n);
+
+		test_report("scalar loops (flops)", flops * numRepeats, naiveTimer.seconds());
+	}
+}
+
+
+BENCHMARK(matrixMultiply) {
+
+	benchmarkMultiply<float>("float");
+	benchmarkMultiply<double>("double");
+}
+
+#pragma endregion
+
+
+#pragma region fixed_matrix
+
+// Random N x N matrices with a dominant diagonal so they are well conditioned
+template <typename T, unsigned int N>
+static fixed_matrix<T, N, N> randomFixedMatrix(const uint32_t seed) {
+
+	vector<T> a = randomArray<T>(N, N, seed);
+
+	for (unsigned int i = 0; i < N; i++)
+		a[i * N + i] += (T)(N + 1);
+
+	return fixed_matrix<T, N, N>(a.data());
+}
+
+
+// det, inv and solve agree with matrix<T> and with the definitions, and the conversions round trip
+template <typename T, unsigned int N>
+static void checkFixedMatrix(const double tolerance) {
+
+	double inverseError = 0.0, detError = 0.0, solveError = 0.0;
+	uint32_t numConversionFailures = 0, numNotInvertible = 0;
+
+	for (uint32_t k = 0; k < 50; k++) {
+
+		fixed_matrix<T, N, N> A = randomFixedMatrix<T, N>(k * 17 + N);
+		matrix<T> D = A.to_matrix();
+
+		bool invertible = false;
+		fixed_matrix<T, N, N> I = A * A.inv(&invertible);
+
+		if (!invertible)
+			numNotInvertible++;
+
+		for (unsigned int i = 1; i <= N; i++)
+			for (unsigned int j = 1; j <= N; j++)
+				inverseError = max(inverseError, (double)fabs(I(i, j) - ((i == j) ? T(1) : T(0))));
+
+		detError = max(detError, (double)fabs(A.det() - D.det()) / max(1.0, (double)fabs(D.det())));
+
+		vector<T> b = randomArray<T>(N, 2, k);
+		fixed_matrix<T, N, 2> B(b.data());
+		fixed_matrix<T, N, 2> R = A * A.solve(B) - B;
+
+		for (unsigned int i = 0; i < N * 2; i++)
+			solveError = max(solveError, (double)fabs(R.e[i]));
+
+		if (!(fixed_matrix<T, N, N>(D) == A) || D.rows() != N || D.columns() != N)
+			numConversionFailures++;
+	}
+
+	TEST_CHECK(numNotInvertible == 0);
+	TEST_CHECK(inverseError < tolerance);
+	TEST_CHECK(detError < tolerance);
+	TEST_CHECK(solveError < tolerance);
+	TEST_CHECK(numConversionFailures == 0);
+}
+
+
+// Closed forms (N <= 4) and LU (N > 4) match matrix<T>, singular matrices are reported, and expression chains do not allocate
+TEST_CASE(fixedMatrixMatchesMatrix) {
+
+	checkFixedMatrix<double, 1>(1.0e-12);
+	checkFixedMatrix<double, 2>(1.0e-12);
+	checkFixedMatrix<double, 3>(1.0e-12);
+	checkFixedMatrix<double, 4>(1.0e-12);
+	checkFixedMatrix<double, 6>(1.0e-12);
+	checkFixedMatrix<double, 9>(1.0e-12);
+	checkFixedMatrix<float, 3>(1.0e-5);
+	checkFixedMatrix<float, 4>(1.0e-5);
+	checkFixedMatrix<float, 5>(1.0e-5);
+
+	// Singular matrices give a zero result and report failure
+	bool invertible = true;
+	fixed_matrix3d Z = fixed_matrix3d::zeromatrix().inv(&invertible);
+
+	TEST_CHECK(!invertible && Z == fixed_matrix3d::zeromatrix());
+	TEST_CHECK(fixed_matrix3d::zeromatrix().det() == 0.0);
+
+	fixed_matrix<double, 6, 6> S = fixed_matrix<double, 6, 6>::identity();
+
+	S(6, 6) = 0.0;
+	invertible = true;
+	S.inv(&invertible);
+
+	TEST_CHECK(!invertible);
+
+	bool solved = true;
+	S.solve(fixed_matrix<double, 6, 1>::zeromatrix(), &solved);
+
+	TEST_CHECK(!solved);
+
+	// Transpose and trace of a non-square matrix and its product
+	fixed_matrix<double, 2, 3> T = fixed_matrix<double, 2, 3>::zeromatrix();
+
+	T(1, 3) = 5.0;
+	T(2, 1) = -2.0;
+
+	fixed_matrix<double, 3, 2> Tt = T.transpose();
+
+	TEST_CHECK(Tt(3, 1) == 5.0 && Tt(1, 2) == -2.0);
+	TEST_CHECK((T * Tt).trace() == 29.0);
+	TEST_CHECK(T.to_matrix().rows() == 2 && T.to_matrix().columns() == 3);
+
+	// A matrix<T> of the wrong order converts to zero
+	TEST_CHECK(fixed_matrix3d(matrix<double>::I(4)) == fixed_matrix3d::zeromatrix());
+
+#ifdef __GU_DEBUG_MEMORY__
+
+	fixed_matrix4f A = fixed_matrix4f::identity(), B = randomFixedMatrix<float, 4>(1);
+	float sum = 0.0f;
+
+	unsigned long allocations = gu_memory_allocations();
+
+	for (int k = 0; k < 1000; k++) {
+
+		fixed_matrix4f C = (A * B + B).inv() * B.transpose();
+
+		sum += C.det();
+		A.e[0] += 1.0e-4f;
+	}
+
+	TEST_CHECK(gu_memory_allocations() == allocations);
+
+	// Use the results so the loop is not optimised away
+	TEST_CHECK(sum != 0.0f);
+
+#endif
+}
+
+
+BENCHMARK(fixedMatrixChain) {
+
+	const uint32_t numRepeats = 200000;
+
+	fixed_matrix4f A = fixed_matrix4f::identity(), B = randomFixedMatrix<float, 4>(1);
+	matrix<float> DA = A.to_matrix(), DB = B.to_matrix();
+
+	float sum = 0.0f;
+
+	cout << "  (A B + B)^-1 B^T on 4 x 4 floats" << endl;
+
+#ifdef __GU_DEBUG_MEMORY__
+	unsigned long allocations = gu_memory_allocations();
+#endif
+
+	TestTimer fixedTimer;
+
+	for (uint32_t k = 0; k < numRepeats; k++) {
+
+		fixed_matrix4f C = (A * B + B).inv() * B.transpose();
+
+		sum += C.e[k & 15];
+	}
+
+	test_report("fixed_matrix", numRepeats, fixedTimer.seconds());
+
+#ifdef __GU_DEBUG_MEMORY__
+	cout << "  " << (double)(gu_memory_allocations() - allocations) / numRepeats << " allocations per chain" << endl;
+	allocations = gu_memory_allocations();
+#endif
+
+	TestTimer dynamicTimer;
+
+	for (uint32_t k = 0; k < numRepeats; k++) {
+
+		matrix<float> C = (DA * DB + DB).inv() * DB.transpose();
+
+		sum += C(1 + (k & 3), 1);
+	}
+
+	test_report("matrix<float>", numRepeats, dynamicTimer.seconds());
+
+#ifdef __GU_DEBUG_MEMORY__
+	cout << "  " << (double)(gu_memory_allocations() - allocations) / numRepeats << " allocations per chain" << endl;
+#endif
+
+	cout << "  checksum " << sum << endl;
+}
+
+#pragma endregion
+
+
+#pragma region matrix_expr
+
+// Lazy expressions give the eager results, including products of expressions, transposes, concatenation, NULL operands and destinations read by the expression
+TEST_CASE(matrixExpressionsMatchEager) {
+
+	const uint32_t n = 37;
+
+	matrix<double> P = randomMatrix<double>(n, n, 1), Q = randomMatrix<double>(n, n, 2), R = randomMatrix<double>(n, n, 3), S = randomMatrix<double>(n, n, 4);
+	matrix<double> V = randomMatrix<double>(n, 1, 5), W = randomMatrix<double>(n, 1, 6);
+	matrix<double> nullMatrix;
+
+	matrix<double> out;
+
+	out = lazy(P) * Q + lazy(R) * S;
+	TEST_CHECK(closeMatrices(out, P * Q + R * S, 1.0e-12));
+
+	out = lazy(V) - lazy(P) * W * 0.5 + W;
+	TEST_CHECK(closeMatrices(out, V - P * W * 0.5 + W, 1.0e-12));
+
+	out = transpose(lazy(P)) * Q * 2.0 + R;
+	TEST_CHECK(closeMatrices(out, P.transpose() * Q * 2.0 + R, 1.0e-12));
+
+	out = (lazy(P) + Q) * (lazy(R) - S);
+	TEST_CHECK(closeMatrices(out, (P + Q) * (R - S), 1.0e-12));
+
+	out = transpose(lazy(P) * Q) - R;
+	TEST_CHECK(closeMatrices(out, (P * Q).transpose() - R, 1.0e-12));
+
+	out = (lazy(P) | Q * 2.0) || (-lazy(R) | S);
+	TEST_CHECK(closeMatrices(out, (P | Q * 2.0) || (-R | S), 0.0));
+
+	// The destination is an operand.  Pointwise expressions are evaluated in place, products into a new buffer
+	matrix<double> X = P;
+
+	X = lazy(X) * 2.0 - Q;
+	TEST_CHECK(closeMatrices(X, P * 2.0 - Q, 1.0e-12));
+
+	X = P;
+	X = lazy(X) * Q + X;
+	TEST_CHECK(closeMatrices(X, P * Q + P, 1.0e-12));
+
+	X = P;
+	X = transpose(lazy(X)) + Q;
+	TEST_CHECK(closeMatrices(X, P.transpose() + Q, 0.0));
+
+	// NULL operands follow the matrix<T> rules (0 + x = x, 0 * x = 0, x + y = 0 for mismatched orders)
+	TEST_CHECK(closeMatrices(matrix<double>(lazy(nullMatrix) + P), nullMatrix + P, 0.0));
+	TEST_CHECK(closeMatrices(matrix<double>(lazy(nullMatrix) * P), nullMatrix * P, 0.0));
+	TEST_CHECK(closeMatrices(matrix<double>(lazy(P) + V), P + V, 0.0));
+	TEST_CHECK(matrix<double>(lazy(P) * V + W).rows() == n);
+
+	// Eager operators give the same results when they reuse buffers
+	matrix<double> Y = P;
+
+	Y += Q;
+	TEST_CHECK(closeMatrices(Y, P + Q, 0.0));
+
+	Y -= Q;
+	TEST_CHECK(closeMatrices(Y, P, 1.0e-15));
+	TEST_CHECK(closeMatrices(P + (Q * 2.0), P + Q * 2.0, 0.0));
+	TEST_CHECK(closeMatrices(P - (Q * 2.0), P - Q * 2.0, 0.0));
+
+#ifdef __GU_DEBUG_MEMORY__
+
+	// Allocations once the destination has the right order
+	out = P;
+
+	unsigned long allocations = gu_memory_allocations();
+
+	out = lazy(P) * Q + lazy(R) * S;
+	TEST_CHECK(gu_memory_allocations() - allocations == 0);
+
+	matrix<double> x = V;
+
+	allocations = gu_memory_allocations();
+	x = lazy(V) - lazy(P) * W * 0.5 + W;
+	TEST_CHECK(gu_memory_allocations() - allocations == 0);
+
+	// A product under a transpose is evaluated once into a temporary
+	allocations = gu_memory_allocations();
+	out = transpose(lazy(P)) * Q * 2.0 + R;
+	TEST_CHECK(gu_memory_allocations() - allocations == 1);
+
+	allocations = gu_memory_allocations();
+	Y += Q;
+	Y -= Q;
+	Y = P;
+	TEST_CHECK(gu_memory_allocations() - allocations == 0);
+
+#endif
+}
+
+
+BENCHMARK(matrixExpressions) {
+
+	for (uint32_t n = 16; n <= 256; n *= 4) {
+
+		matrix<double> P = randomMatrix<double>(n, n, 1), Q = randomMatrix<double>(n, n, 2), R = randomMatrix<double>(n, n, 3), S = randomMatrix<double>(n, n, 4);
+		matrix<double> out = P;
+
+		uint32_t numRepeats = max(4u, 16000000 / (n * n * n));
+
+		cout << "  n = " << n << endl;
+
+		for (int chain = 0; chain < 2; chain++) {
+
+#ifdef __GU_DEBUG_MEMORY__
+			unsigned long allocations = gu_memory_allocations();
+#endif
+
+			TestTimer eagerTimer;
+
+			for (uint32_t k = 0; k < numRepeats; k++)
+				out = (chain == 0) ? P + Q * 2.0 - R + S : P * Q + R * S;
+
+			test_report((chain == 0) ? "eager P + 2Q - R + S" : "eager PQ + RS", numRepeats, eagerTimer.seconds());
+
+#ifdef __GU_DEBUG_MEMORY__
+			cout << "  " << (double)(gu_memory_allocations() - allocations) / numRepeats << " allocations per evaluation" << endl;
+			allocations = gu_memory_allocations();
+#endif
+
+			TestTimer lazyTimer;
+
+			for (uint32_t k = 0; k < numRepeats; k++) {
+
+				if (chain == 0)
+					out = lazy(P) + lazy(Q) * 2.0 - R + S;
+				else
+					out = lazy(P) * Q + lazy(R) * S;
+			}
+
+			test_report((chain == 0) ? "lazy P + 2Q - R + S" : "lazy PQ + RS", numRepeats, lazyTimer.seconds());
+
+#ifdef __GU_DEBUG_MEMORY__
+			cout << "  " << (double)(gu_memory_allocations() - allocations) / numRepeats << " allocations per evaluation" << endl;
+#endif
+		}
+	}
+}
+
+#pragma endregion
+
+
+#pragma region LU decomposition
+
+// Sign of the permutation vector P (P[i - 1] is the row of A at row i of PA)
+static double permutationSign(const vector<unsigned int>& P) {
+
+	vector<bool> visited(P.size(), false);
+	double sign = 1.0;
+
+	for (size_t i = 0; i < P.size(); i++) {
+
+		if (visited[i])
+			continue;
+
+		size_t length = 0;
+
+		for (size_t j = i; !visited[j]; j = P[j] - 1) {
+
+			visited[j] = true;
+			length++;
+		}
+
+		if (length % 2 == 0)
+			sign = -sign;
+	}
+
+	return sign;
+}
+
+
+// Residuals of the factors, solutions, inverse and determinant for orders either side of the blocked threshold, serially and on a thread pool
+TEST_CASE(luDecompositionResiduals) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	const uint32_t orders[] = { 5, matrix_lu_blocked_threshold - 1, matrix_lu_blocked_threshold, matrix_lu_blocked_threshold + 1, 130, 257 };
+
+	for (uint32_t k = 0; k < sizeof(orders) / sizeof(orders[0]); k++) {
+
+		uint32_t n = orders[k];
+
+		matrix<double> A = randomMatrix<double>(n, n, n);
+		matrix<double> B = randomMatrix<double>(n, 3, n + 1);
+
+		matrix<double> serialD, pooledD;
+		vector<unsigned int> serialP, pooledP;
+
+		matrixThreadPool(nullptr);
+		TEST_CHECK(A.lup_decomp(&serialD, &serialP) == gu_lu_okay);
+
+		matrixThreadPool(pool);
+		TEST_CHECK(A.lup_decomp(&pooledD, &pooledP) == gu_lu_okay);
+
+		// Column blocks are independent so the split does not change the result
+		TEST_CHECK(closeMatrices(serialD, pooledD, 0.0) && serialP == pooledP);
+
+		matrix<double> L, U, P;
+
+		TEST_CHECK(A.lup_decomp(&L, &U, &P) == gu_lu_okay);
+		TEST_CHECK(maxAbs(P * A - L * U) < 1.0e-12 * n);
+		TEST_CHECK(closeMatrices(P, matrix<double>::permutation_matrix(pooledP), 0.0));
+
+		matrix<double> X = lup_solve(pooledD, pooledP, B);
+
+		TEST_CHECK(X.rows() == n && X.columns() == 3);
+		TEST_CHECK(maxAbs(A * X - B) < 1.0e-11 * n);
+		TEST_CHECK(maxAbs(A * A.inv() - matrix<double>::I(n)) < 1.0e-11 * n);
+
+		// det(A) = sign(P) * prod(diag(U))
+		double logDet = 0.0, sign = permutationSign(pooledP);
+
+		for (uint32_t i = 1; i <= n; i++) {
+
+			logDet += log(fabs(pooledD(i, i)));
+			sign *= (pooledD(i, i) < 0.0) ? -1.0 : 1.0;
+		}
+
+		double det = A.det();
+
+		TEST_CHECK(det * sign > 0.0 && fabs(log(fabs(det)) - logDet) < 1.0e-10);
+	}
+
+	// A repeated column is singular
+	matrix<double> S = randomMatrix<double>(200, 200, 9);
+
+	for (uint32_t i = 1; i <= 200; i++)
+		S(i, 7) = S(i, 3) * 2.0;
+
+	matrix<double> D;
+	vector<unsigned int> P;
+
+	TEST_CHECK(S.lup_decomp(&D, &P) == gu_lu_fail_singular);
+	TEST_CHECK(S.inv().is_null());
+
+	matrixThreadPool(nullptr);
+	pool->release();
+}
+
+
+BENCHMARK(luDecomposition) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool();
+
+	cout << "  " << pool->threadCount() << " threads.  Doolittle's method below n = " << (uint32_t)matrix_lu_blocked_threshold << ", blocked from it" << endl;
+
+	for (uint32_t n = 32; n <= 1024; n *= 2) {
+
+		matrix<double> A = randomMatrix<double>(n, n, 1);
+		matrix<double> D;
+		vector<unsigned int> P;
+
+		double flops = 2.0 / 3.0 * (double)n * n * n;
+		uint32_t numRepeats = max(2u, (uint32_t)(2.0e9 / flops));
+
+		cout << "  n = " << n << endl;
+
+		for (int threaded = 0; threaded < 2; threaded++) {
+
+			matrixThreadPool((threaded) ? pool : nullptr);
+
+			TestTimer timer;
+
+			for (uint32_t k = 0; k < numRepeats; k++)
+				A.lup_decomp(&D, &P);
+
+			test_report((threaded) ? "lup_decomp (pool, flops)" : "lup_decomp (flops)", flops * numRepeats, timer.seconds());
+		}
+	}
+
+	// Multi-column solve
+	matrix<double> A = randomMatrix<double>(1024, 1024, 2), B = randomMatrix<double>(1024, 64, 3);
+	matrix<double> D;
+	vector<unsigned int> P;
+
+	A.lup_decomp(&D, &P);
+
+	cout << "  n = 1024, 64 right-hand sides" << endl;
+
+	for (int threaded = 0; threaded < 2; threaded++) {
+
+		matrixThreadPool((threaded) ? pool : nullptr);
+
+		TestTimer timer;
+		matrix<double> X = lup_solve(D, P, B);
+
+		test_report((threaded) ? "lup_solve (pool, flops)" : "lup_solve (flops)", 2.0 * 1024.0 * 1024.0 * 64.0, timer.seconds());
+	}
+
+	matrixThreadPool(nullptr);
+	pool->release();
+}
+
+#pragma endregion
+
+
+#pragma region sparse_matrix
+
+// Path of the models directory relative to the project directory (the working directory when run from Visual Studio)
+#define MODELS_PATH "Resources\\Models\\"
+
+
+// Read the vertex count and faces of an OBJ file.  Polygons are split into triangle fans
+static bool loadOBJFaces(const char *path, uint32_t& numVertices, vector<uint32_t>& indices) {
+
+	ifstream file(path);
+
+	if (!file.is_open())
+		return false;
+
+	string line;
+
+	numVertices = 0;
+
+	while (getline(file, line)) {
+
+		istringstream tokens(line);
+		string type;
+
+		tokens >> type;
+
+		if (type == "v") {
+
+			numVertices++;
+
+		} else if (type == "f") {
+
+			vector<uint32_t> face;
+			string vertex;
+
+			// Each vertex is v, v/vt, v//vn or v/vt/vn.  Only the position index is used
+			while (tokens >> vertex)
+				face.push_back((uint32_t)atoi(vertex.c_str()) - 1);
+
+			for (uint32_t k = 1; k + 1 < face.size(); k++) {
+
+				indices.push_back(face[0]);
+				indices.push_back(face[k]);
+				indices.push_back(face[k + 1]);
+			}
+		}
+	}
+
+	return !indices.empty();
+}
+
+
+// Triangulated w x h vertex grid
+static void gridMesh(const uint32_t w, const uint32_t h, uint32_t& numVertices, vector<uint32_t>& indices) {
+
+	numVertices = w * h;
+
+	for (uint32_t j = 0; j + 1 < h; j++) {
+
+		for (uint32_t i = 0; i + 1 < w; i++) {
+
+			uint32_t a = j * w + i, b = a + 1, c = a + w, d = c + 1;
+
+			indices.push_back(a); indices.push_back(c); indices.push_back(b);
+			indices.push_back(b); indices.push_back(c); indices.push_back(d);
+		}
+	}
+}
+
+
+// Implicit smoothing operators of a mesh with uniform graph Laplacian L and vertex degrees D.  A = I + tL is symmetric positive-definite and N = I + tD^-1 L (rows normalised by the degree) is not symmetric where neighbouring degrees differ
+static void meshSmoothingSystems(const uint32_t numVertices, const vector<uint32_t>& indices, const double t, sparse_matrix<double>& A, sparse_matrix<double>& N) {
+
+	set<pair<uint32_t, uint32_t> > edges;
+
+	for (size_t k = 0; k + 2 < indices.size(); k += 3) {
+
+		for (uint32_t e = 0; e < 3; e++) {
+
+			uint32_t a = indices[k + e], b = indices[k + (e + 1) % 3];
+
+			if (a != b && a < numVertices && b < numVertices)
+				edges.insert(make_pair(min(a, b), max(a, b)));
+		}
+	}
+
+	vector<double> degree(numVertices, 0.0);
+
+	for (auto e = edges.begin(); e != edges.end(); e++) {
+
+		degree[e->first] += 1.0;
+		degree[e->second] += 1.0;
+	}
+
+	vector<sparse_entry<double> > symmetric, normalised;
+
+	for (auto e = edges.begin(); e != edges.end(); e++) {
+
+		sparse_entry<double> ab = { e->first + 1, e->second + 1, -t }, ba = { e->second + 1, e->first + 1, -t };
+
+		symmetric.push_back(ab);
+		symmetric.push_back(ba);
+
+		ab.value = -t / degree[e->first];
+		ba.value = -t / degree[e->second];
+
+		normalised.push_back(ab);
+		normalised.push_back(ba);
+	}
+
+	for (uint32_t i = 0; i < numVertices; i++) {
+
+		sparse_entry<double> d = { i + 1, i + 1, 1.0 + t * degree[i] };
+
+		symmetric.push_back(d);
+
+		// Isolated vertices keep a unit diagonal
+		d.value = (degree[i] > 0.0) ? 1.0 + t : 1.0;
+		normalised.push_back(d);
+	}
+
+	A = sparse_matrix<double>(numVertices, numVertices, symmetric);
+	N = sparse_matrix<double>(numVertices, numVertices, normalised);
+}
+
+
+// Conversions, compressed layouts and products agree with the dense matrix, and construction sums duplicates and ignores entries outside the matrix
+TEST_CASE(sparseMatrixMatchesDense) {
+
+	TestRandom R(5);
+
+	matrix<double> A = matrix<double>::zeromatrix(37, 23);
+
+	for (uint32_t k = 0; k < 120; k++)
+		A(1 + R.next() % 37, 1 + R.next() % 23) = R.uniform(-1.0f, 1.0f);
+
+	sparse_matrix<double> S(A);
+
+	TEST_CHECK(S.rows() == 37 && S.columns() == 23 && !S.is_square());
+	TEST_CHECK(closeMatrices(S.to_matrix(), A, 0.0));
+	TEST_CHECK(closeMatrices(S.transpose().to_matrix(), A.transpose(), 0.0));
+
+	uint32_t nonzeros = 0;
+
+	for (uint32_t j = 1; j <= 23; j++)
+		for (uint32_t i = 1; i <= 37; i++)
+			nonzeros += (A(i, j) != 0.0) ? 1 : 0;
+
+	TEST_CHECK(S.nonzeros() == nonzeros);
+
+	// CSC arrays rebuild the same matrix
+	vector<unsigned int> ptr, index;
+	vector<double> values;
+
+	S.compressed(gu_sparse_csc, &ptr, &index, &values);
+
+	TEST_CHECK(ptr.size() == 24 && index.size() == nonzeros && values.size() == nonzeros);
+	TEST_CHECK(closeMatrices(sparse_matrix<double>(37, 23, gu_sparse_csc, ptr, index, values).to_matrix(), A, 0.0));
+
+	// Inconsistent arrays give a NULL matrix
+	TEST_CHECK(sparse_matrix<double>(37, 22, gu_sparse_csc, ptr, index, values).is_null());
+
+	// Products
+	matrix<double> X = randomMatrix<double>(23, 4, 6);
+
+	TEST_CHECK(closeMatrices(S * X, A * X, 1.0e-14));
+	TEST_CHECK((S * randomMatrix<double>(22, 4, 6)).is_null());
+
+	vector<double> x = randomArray<double>(37, 1, 7), y(23);
+	matrix<double> xt = matrix<double>(37, 1, (const double*)x.data());
+
+	S.multiply_transpose(x.data(), y.data());
+
+	TEST_CHECK(closeMatrices(matrix<double>(23, 1, (const double*)y.data()), A.transpose() * xt, 1.0e-14));
+
+	// Duplicates are summed and entries outside the matrix ignored
+	vector<sparse_entry<double> > entries;
+	sparse_entry<double> e[] = { { 1, 1, 1.0 }, { 2, 3, 4.0 }, { 1, 1, 2.0 }, { 3, 1, 5.0 }, { 1, 4, 6.0 }, { 0, 1, 7.0 } };
+
+	entries.assign(e, e + 6);
+
+	sparse_matrix<double> D(2, 3, entries);
+
+	TEST_CHECK(D.nonzeros() == 2 && D(1, 1) == 3.0 && D(2, 3) == 4.0 && D(1, 2) == 0.0);
+	TEST_CHECK(sparse_matrix<double>(0, 3, entries).is_null());
+}
+
+
+// CG solves the symmetric and BiCGSTAB the non-symmetric smoothing system of a mesh with every preconditioner.  The true residual meets the tolerance, ILU(0) beats no preconditioning and a thread pool gives the serial result exactly
+TEST_CASE(sparseSolversOnMeshLaplacian) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	uint32_t numVertices;
+	vector<uint32_t> indices;
+
+	gridMesh(61, 47, numVertices, indices);
+
+	sparse_matrix<double> A, N;
+
+	meshSmoothingSystems(numVertices, indices, 2.0, A, N);
+
+	vector<double> b = randomArray<double>(numVertices, 1, 8);
+	matrix<double> B(numVertices, 1, (const double*)b.data());
+
+	TEST_CHECK(A.is_square() && A.rows() == numVertices && N.nonzeros() == A.nonzeros());
+	TEST_CHECK(closeMatrices(A.transpose().to_matrix(), A.to_matrix(), 0.0));
+
+	const double tolerance = 1.0e-9;
+	const gu_sparse_precond_type preconditioners[] = { gu_sparse_precond_none, gu_sparse_precond_jacobi, gu_sparse_precond_ilu0 };
+
+	double normB = sqrt((B.transpose() * B)(1, 1));
+	uint32_t cgIterations[3], bicgstabIterations[3];
+
+	for (uint32_t k = 0; k < 3; k++) {
+
+		matrix<double> serialX, pooledX;
+		gu_sparse_solver_aux<double> serialAux, pooledAux;
+
+		// CG on A
+		matrixThreadPool(nullptr);
+		TEST_CHECK(sparse_cg(A, B, &serialX, preconditioners[k], tolerance, 0, &serialAux) == gu_sparse_converged);
+
+		matrixThreadPool(pool);
+		TEST_CHECK(sparse_cg(A, B, &pooledX, preconditioners[k], tolerance, 0, &pooledAux) == gu_sparse_converged);
+
+		TEST_CHECK(serialAux.residual <= tolerance);
+		TEST_CHECK(maxAbs(A * serialX - B) <= 10.0 * tolerance * normB);
+		TEST_CHECK(closeMatrices(serialX, pooledX, 0.0) && serialAux.iterations == pooledAux.iterations);
+
+		cgIterations[k] = serialAux.iterations;
+
+		// BiCGSTAB on N
+		matrixThreadPool(nullptr);
+		TEST_CHECK(sparse_bicgstab(N, B, &serialX, preconditioners[k], tolerance, 0, &serialAux) == gu_sparse_converged);
+
+		matrixThreadPool(pool);
+		TEST_CHECK(sparse_bicgstab(N, B, &pooledX, preconditioners[k], tolerance, 0, &pooledAux) == gu_sparse_converged);
+
+		TEST_CHECK(serialAux.residual <= tolerance);
+		TEST_CHECK(maxAbs(N * serialX - B) <= 10.0 * tolerance * normB);
+		TEST_CHECK(closeMatrices(serialX, pooledX, 0.0) && serialAux.iterations == pooledAux.iterations);
+
+		bicgstabIterations[k] = serialAux.iterations;
+	}
+
+	TEST_CHECK(cgIterations[2] < cgIterations[0] && bicgstabIterations[2] < bicgstabIterations[0]);
+
+	// A converged initial guess returns immediately and bad orders are errors
+	matrix<double> X = matrix<double>(numVertices, 1, (const double*)b.data());
+	gu_sparse_solver_aux<double> aux;
+
+	TEST_CHECK(sparse_cg(sparse_matrix<double>::identity(numVertices), B, &X, gu_sparse_precond_none, tolerance, 0, &aux) == gu_sparse_converged && aux.iterations == 0);
+	TEST_CHECK(sparse_cg(A, randomMatrix<double>(numVertices + 1, 1, 9), &X, gu_sparse_precond_jacobi, tolerance) == gu_sparse_error);
+
+	matrixThreadPool(nullptr);
+	pool->release();
+}
+
+
+// SpMV and the solvers on the smoothing systems of the shipped models, or a generated grid if they cannot be found
+BENCHMARK(sparseSolvers) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool();
+
+	const char *models[] = { "Shark.obj", "logs.obj", "tree.obj", "saintriqT3DS.obj" };
+	const char *preconditionerNames[] = { "none", "Jacobi", "ILU(0)" };
+
+	for (uint32_t m = 0; m <= sizeof(models) / sizeof(models[0]); m++) {
+
+		uint32_t numVertices;
+		vector<uint32_t> indices;
+		string name;
+
+		if (m < sizeof(models) / sizeof(models[0])) {
+
+			if (!loadOBJFaces((string(MODELS_PATH) + models[m]).c_str(), numVertices, indices)) {
+
+				cout << "  " << models[m] << " skipped - could not be loaded" << endl;
+				continue;
+			}
+
+			name = models[m];
+
+		} else {
+
+			gridMesh(512, 512, numVertices, indices);
+			name = "512 x 512 grid";
+		}
+
+		sparse_matrix<double> A, N;
+
+		meshSmoothingSystems(numVertices, indices, 1.0, A, N);
+
+		vector<double> b = randomArray<double>(numVertices, 1, 10);
+		matrix<double> B(numVertices, 1, (const double*)b.data());
+
+		cout << "  " << name << ": n = " << numVertices << ", " << A.nonzeros() << " non-zeros, " << pool->threadCount() << " threads" << endl;
+
+		for (int threaded = 0; threaded < 2; threaded++) {
+
+			matrixThreadPool((threaded) ? pool : nullptr);
+
+			vector<double> x(numVertices, 1.0), y(numVertices);
+			uint32_t numRepeats = max(10u, (uint32_t)(2.0e8 / A.nonzeros()));
+
+			TestTimer timer;
+
+			for (uint32_t k = 0; k < numRepeats; k++)
+				A.multiply(x.data(), y.data());
+
+			test_report((threaded) ? "SpMV (pool, flops)" : "SpMV (flops)", 2.0 * A.nonzeros() * numRepeats, timer.seconds());
+		}
+
+		for (uint32_t k = 0; k < 3; k++) {
+
+			for (int threaded = 0; threaded < 2; threaded++) {
+
+				matrixThreadPool((threaded) ? pool : nullptr);
+
+				matrix<double> X;
+				gu_sparse_solver_aux<double> aux;
+
+				TestTimer timer;
+				sparse_cg(A, B, &X, (gu_sparse_precond_type)k, 1.0e-8, 0, &aux);
+				double cgSeconds = timer.seconds();
+				uint32_t cgIterations = aux.iterations;
+
+				timer.reset();
+				sparse_bicgstab(N, B, &X, (gu_sparse_precond_type)k, 1.0e-8, 0, &aux);
+				double bicgstabSeconds = timer.seconds();
+
+				cout << "    " << preconditionerNames[k] << ((threaded) ? " (pool)" : "") << ": CG " << cgIterations << " iterations " << cgSeconds * 1.0e3 << " ms, BiCGSTAB " << aux.iterations << " iterations " << bicgstabSeconds * 1.0e3 << " ms" << endl;
+			}
+		}
+	}
+
+	matrixThreadPool(nullptr);
+	pool->release();
+}
+
+#pragma endregion
+
+
+#pragma region symmetric eigen-decomposition
+
+// Random symmetric n x n matrix with elements in [-1, 1]
+static matrix<double> randomSymmetric(const uint32_t n, const uint32_t seed) {
+
+	matrix<double> A = randomMatrix<double>(n, n, seed);
+
+	for (uint32_t j = 1; j <= n; j++)
+		for (uint32_t i = j + 1; i <= n; i++)
+			A(j, i) = A(i, j);
+
+	return A;
+}
+
+
+// Largest of |Z^T Z - I| and |AZ - ZD| relative to the largest eigenvalue, where D = diag(d)
+static void eigenResiduals(const matrix<double>& A, const vector<double>& d, const matrix<double>& Z, double& orthogonality, double& residual) {
+
+	uint32_t n = A.rows();
+	matrix<double> D = matrix<double>::zeromatrix(n, n);
+	double scale = 1.0;
+
+	for (uint32_t i = 1; i <= n; i++) {
+
+		D(i, i) = d[i - 1];
+		scale = max(scale, fabs(d[i - 1]));
+	}
+
+	orthogonality = maxAbs(Z.transpose() * Z - matrix<double>::I(n));
+	residual = maxAbs(A * Z - Z * D) / scale;
+}
+
+
+// Orthonormal eigenvectors and small residuals for orders either side of the eigen_system threshold and the block sizes, serially and on a thread pool.  eigen_system routes large symmetric matrices to symmetric_eigen and agrees with tred2 / tqli below the threshold
+TEST_CASE(symmetricEigenResiduals) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	const uint32_t orders[] = { 1, 2, 3, 5, matrix_eigen_block_size - 1, matrix_eigen_block_size + 1, 100, matrix_eigen_threshold - 1, matrix_eigen_threshold, 200, 300 };
+
+	for (uint32_t k = 0; k < sizeof(orders) / sizeof(orders[0]); k++) {
+
+		uint32_t n = orders[k];
+
+		matrix<double> A = randomSymmetric(n, n + 20);
+
+		vector<double> serialD, pooledD;
+		matrix<double> serialZ, pooledZ;
+
+		matrixThreadPool(nullptr);
+		TEST_CHECK(A.symmetric_eigen(&serialD, &serialZ));
+
+		matrixThreadPool(pool);
+		TEST_CHECK(A.symmetric_eigen(&pooledD, &pooledZ));
+
+		// Blocks are independent so the split does not change the result
+		TEST_CHECK(serialD == pooledD && closeMatrices(serialZ, pooledZ, 0.0));
+
+		TEST_CHECK(serialD.size() == n && is_sorted(serialD.begin(), serialD.end()));
+
+		double orthogonality, residual;
+
+		eigenResiduals(A, serialD, serialZ, orthogonality, residual);
+
+		TEST_CHECK(orthogonality < 1.0e-13 * n);
+		TEST_CHECK(residual < 1.0e-13 * n);
+
+		// The trace is the sum of the eigenvalues
+		double trace = 0.0, sum = 0.0;
+
+		for (uint32_t i = 1; i <= n; i++) {
+
+			trace += A(i, i);
+			sum += serialD[i - 1];
+		}
+
+		TEST_CHECK(fabs(trace - sum) < 1.0e-12 * n);
+
+		// Only the lower triangle is read
+		matrix<double> upper = A;
+		vector<double> upperD;
+		matrix<double> upperZ;
+
+		for (uint32_t j = 2; j <= n; j++)
+			upper(1, j) += 1.0;
+
+		TEST_CHECK(upper.symmetric_eigen(&upperD, &upperZ) && upperD == pooledD && closeMatrices(upperZ, pooledZ, 0.0));
+
+		// eigen_system gives the same eigenvalues, by symmetric_eigen from the threshold and tred2 / tqli below it
+		vector<complex<double> > systemD;
+		matrix<double> systemZ;
+
+		TEST_CHECK(A.eigen_system(&systemD, &systemZ) && systemD.size() == n);
+
+		vector<double> realD;
+
+		for (size_t i = 0; i < systemD.size(); i++)
+			realD.push_back(systemD[i].real());
+
+		if (n >= matrix_eigen_threshold) {
+
+			TEST_CHECK(realD == pooledD && closeMatrices(systemZ, pooledZ, 0.0));
+
+		} else {
+
+			sort(realD.begin(), realD.end());
+
+			double error = 0.0;
+
+			for (uint32_t i = 0; i < n; i++)
+				error = max(error, fabs(realD[i] - pooledD[i]));
+
+			TEST_CHECK(error < 1.0e-12 * n);
+		}
+	}
+
+	// Repeated eigenvalues.  Q diag(1, 1, 1, 2, 2, 3, ...) Q^T for a random orthogonal Q
+	matrix<double> Q;
+	vector<double> d;
+
+	TEST_CHECK(randomSymmetric(150, 7).symmetric_eigen(&d, &Q));
+
+	matrix<double> D = matrix<double>::zeromatrix(150, 150);
+
+	for (uint32_t i = 1; i <= 150; i++)
+		D(i, i) = (double)(1 + i / 50);
+
+	matrix<double> C = Q * D * Q.transpose();
+
+	for (uint32_t j = 1; j <= 150; j++)
+		for (uint32_t i = j + 1; i <= 150; i++)
+			C(j, i) = C(i, j);
+
+	matrix<double> Z;
+	double orthogonality, residual, error = 0.0;
+
+	TEST_CHECK(C.symmetric_eigen(&d, &Z));
+
+	eigenResiduals(C, d, Z, orthogonality, residual);
+
+	for (uint32_t i = 1; i <= 150; i++)
+		error = max(error, fabs(d[i - 1] - D(i, i)));
+
+	TEST_CHECK(orthogonality < 1.0e-12 && residual < 1.0e-12 && error < 1.0e-12);
+
+	// NULL and non-square matrices
+	TEST_CHECK(!matrix<double>().symmetric_eigen(&d, &Z));
+	TEST_CHECK(!randomMatrix<double>(4, 3, 1).symmetric_eigen(&d, &Z));
+
+	matrixThreadPool(nullptr);
+	pool->release();
+}
+
+
+// Random symmetric N x N matrix
+template <typename T, unsigned int N>
+static fixed_matrix<T, N, N> randomFixedSymmetric(const uint32_t seed) {
+
+	fixed_matrix<T, N, N> A(randomArray<T>(N, N, seed).data());
+
+	for (unsigned int j = 1; j <= N; j++)
+		for (unsigned int i = j + 1; i <= N; i++)
+			A(j, i) = A(i, j);
+
+	return A;
+}
+
+
+// The Jacobi eigen-decomposition of single matrices and batches gives ascending eigenvalues, orthonormal eigenvectors and small residuals, including repeated eigenvalues and diagonal matrices.  A pooled batch gives the serial result
+template <typename T, unsigned int N>
+static void checkFixedSymmetricEigen(GUParallel *pool, const double tolerance) {
+
+	const uint32_t count = 3000;
+
+	vector<fixed_matrix<T, N, N> > A(count), V(count), pooledV(count);
+	vector<fixed_matrix<T, N, 1> > W(count), pooledW(count);
+
+	for (uint32_t k = 0; k < count; k++)
+		A[k] = randomFixedSymmetric<T, N>(k + N * count);
+
+	// Identity, diagonal and repeated eigenvalues
+	A[0] = fixed_matrix<T, N, N>::identity();
+	A[1] = fixed_matrix<T, N, N>::zeromatrix();
+	A[2] = fixed_matrix<T, N, N>::identity() * T(2);
+
+	for (unsigned int i = 1; i <= N; i++)
+		A[1](i, i) = (T)(N - i);
+
+	A[2](2, 1) = A[2](1, 2) = T(1);
+
+	matrixThreadPool(nullptr);
+	fixed_symmetric_eigen_batch(A.data(), W.data(), V.data(), count);
+
+	matrixThreadPool(pool);
+	fixed_symmetric_eigen_batch(A.data(), pooledW.data(), pooledV.data(), count);
+
+	double orthogonality = 0.0, residual = 0.0, singleError = 0.0;
+	uint32_t numUnsorted = 0, numPoolMismatches = 0, maxSweeps = 0;
+
+	for (uint32_t k = 0; k < count; k++) {
+
+		fixed_matrix<T, N, N> O = V[k].transpose() * V[k], R = A[k] * V[k];
+
+		for (unsigned int j = 1; j <= N; j++) {
+
+			for (unsigned int i = 1; i <= N; i++) {
+
+				orthogonality = max(orthogonality, (double)fabs(O(i, j) - ((i == j) ? T(1) : T(0))));
+				residual = max(residual, (double)fabs(R(i, j) - V[k](i, j) * W[k](j, 1)));
+			}
+
+			if (j > 1 && W[k](j, 1) < W[k](j - 1, 1))
+				numUnsorted++;
+		}
+
+		if (!(W[k] == pooledW[k]) || !(V[k] == pooledV[k]))
+			numPoolMismatches++;
+
+		// A single decomposition finds the same eigenvalues
+		if (k < 200) {
+
+			fixed_matrix<T, N, 1> w;
+			fixed_matrix<T, N, N> v;
+
+			maxSweeps = max(maxSweeps, A[k].symmetric_eigen(&w, &v));
+
+			for (unsigned int i = 1; i <= N; i++)
+				singleError = max(singleError, (double)fabs(w(i, 1) - W[k](i, 1)));
+		}
+	}
+
+	TEST_CHECK(orthogonality < tolerance);
+	TEST_CHECK(residual < tolerance);
+	TEST_CHECK(singleError < tolerance);
+	TEST_CHECK(numUnsorted == 0 && numPoolMismatches == 0);
+	TEST_CHECK(maxSweeps <= fixed_matrix_jacobi_sweeps);
+
+	vector<T> ones(N, T(1));
+	fixed_matrix<T, N, 1> unitValues(ones.data());
+
+	TEST_CHECK(W[0] == unitValues && V[0] == A[0]);
+	TEST_CHECK(W[1](1, 1) == T(0) && W[1](N, 1) == (T)(N - 1));
+	TEST_CHECK(fabs(W[2](1, 1) - T(1)) < tolerance && fabs(W[2](N, 1) - T(3)) < tolerance);
+
+	matrixThreadPool(nullptr);
+}
+
+
+TEST_CASE(fixedSymmetricEigen) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	checkFixedSymmetricEigen<double, 2>(pool, 1.0e-14);
+	checkFixedSymmetricEigen<double, 3>(pool, 1.0e-14);
+	checkFixedSymmetricEigen<double, 4>(pool, 1.0e-14);
+	checkFixedSymmetricEigen<float, 3>(pool, 1.0e-5);
+
+	pool->release();
+}
+
+
+BENCHMARK(symmetricEigen) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool();
+
+	cout << "  " << pool->threadCount() << " threads.  eigen_system uses tred2 / tqli below n = " << (uint32_t)matrix_eigen_threshold << ", symmetric_eigen from it" << endl;
+
+	for (uint32_t n = 32; n <= 1024; n *= 2) {
+
+		matrix<double> A = randomSymmetric(n, 1);
+		vector<double> d;
+		matrix<double> Z;
+
+		uint32_t numRepeats = max(1u, (uint32_t)(2.0e8 / ((double)n * n * n)));
+
+		cout << "  n = " << n << endl;
+
+		for (int threaded = 0; threaded < 2; threaded++) {
+
+			matrixThreadPool((threaded) ? pool : nullptr);
+
+			TestTimer timer;
+
+			for (uint32_t k = 0; k < numRepeats; k++)
+				A.symmetric_eigen(&d, &Z);
+
+			test_report((threaded) ? "symmetric_eigen (pool)" : "symmetric_eigen", numRepeats, timer.seconds());
+		}
+
+		if (n < matrix_eigen_threshold) {
+
+			matrixThreadPool(nullptr);
+
+			vector<complex<double> > systemD;
+			TestTimer timer;
+
+			for (uint32_t k = 0; k < numRepeats; k++)
+				A.eigen_system(&systemD, &Z);
+
+			test_report("eigen_system (tred2 / tqli)", numRepeats, timer.seconds());
+		}
+	}
+
+	// Batches of 3x3 matrices such as inertia tensors and point covariances
+	const uint32_t count = 100000;
+
+	vector<fixed_matrix3d> A(count), V(count);
+	vector<fixed_matrix<double, 3, 1> > W(count);
+
+	for (uint32_t k = 0; k < count; k++)
+		A[k] = randomFixedSymmetric<double, 3>(k);
+
+	cout << "  " << count << " 3x3 matrices" << endl;
+
+	for (int threaded = 0; threaded < 2; threaded++) {
+
+		matrixThreadPool((threaded) ? pool : nullptr);
+
+		TestTimer timer;
+		fixed_symmetric_eigen_batch(A.data(), W.data(), V.data(), count);
+
+		test_report((threaded) ? "fixed_symmetric_eigen_batch (pool)" : "fixed_symmetric_eigen_batch", count, timer.seconds());
+	}
+
+	matrixThreadPool(nullptr);
+
+	TestTimer timer;
+
+	for (uint32_t k = 0; k < count; k++)
+		A[k].symmetric_eigen(&W[k], &V[k]);
+
+	test_report("fixed_matrix::symmetric_eigen", count, timer.seconds());
+
+	vector<complex<double> > systemD;
+	matrix<double> systemZ;
+
+	timer.reset();
+
+	for (uint32_t k = 0; k < count / 10; k++)
+		A[k].to_matrix().eigen_system(&systemD, &systemZ);
+
+	test_report("matrix::eigen_system", count / 10, timer.seconds());
+
+	pool->release();
+}
+
+#pragma endregion
@@ -0,0 +1,687 @@
+
+//
+// OceanTests.cpp
+//
+
+// Tests and benchmarks for the water simulation (GUFFT, OceanSpectrum, GerstnerWaves and OceanGrid)
+
+#include <stdafx.h>
+#include <TestHarness.h>
+#include <GUFFT.h>
+#include <GUParallel.h>
+#include <OceanSpectrum.h>
+#include <GerstnerWaves.h>
+#include <OceanGrid.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace DirectX;
+
+
+#pragma region GUFFT
+
+// Size x size float array aligned for GUFFT
+static float* alignedArray(const uint32_t size) {
+
+	return (float*)_aligned_malloc(sizeof(float) * size * size, 16);
+}
+
+
+// Direct 2D DFT in double precision.  sign is -1 for the forward transform and +1 for the inverse
+static void naiveDFT2D(const float *re, const float *im, const uint32_t n, const double sign, vector<double>& outRe, vector<double>& outIm) {
+
+	outRe.assign(n * n, 0.0);
+	outIm.assign(n * n, 0.0);
+
+	const double twoPi = 6.283185307179586;
+
+	for (uint32_t ky = 0; ky < n; ky++) {
+
+		for (uint32_t kx = 0; kx < n; kx++) {
+
+			double sumRe = 0.0, sumIm = 0.0;
+
+			for (uint32_t y = 0; y < n; y++) {
+
+				for (uint32_t x = 0; x < n; x++) {
+
+					double a = sign * twoPi * (double)(((kx * x) % n) * n + ((ky * y) % n) * n) / (double)(n * n);
+					double c = cos(a), s = sin(a);
+
+					sumRe += re[y * n + x] * c - im[y * n + x] * s;
+					sumIm += re[y * n + x] * s + im[y * n + x] * c;
+				}
+			}
+
+			outRe[ky * n + kx] = sumRe;
+			outIm[ky * n + kx] = sumIm;
+		}
+	}
+}
+
+
+// Forward and inverse 2D transforms match a direct DFT, on one thread and on a thread pool
+TEST_CASE(fftMatchesNaiveDFT) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	for (uint32_t n = 4; n <= 64; n *= 2) {
+
+		GUFFT *fft = new GUFFT(n);
+
+		TEST_CHECK(fft->size() == n);
+
+		float *re = alignedArray(n), *im = alignedArray(n);
+		vector<float> sourceRe(n * n), sourceIm(n * n);
+		TestRandom R(n);
+
+		for (uint32_t i = 0; i < n * n; i++) {
+
+			sourceRe[i] = R.uniform(-1.0f, 1.0f);
+			sourceIm[i] = R.uniform(-1.0f, 1.0f);
+		}
+
+		for (int inverse = 0; inverse < 2; inverse++) {
+
+			vector<double> expectedRe, expectedIm;
+
+			naiveDFT2D(sourceRe.data(), sourceIm.data(), n, (inverse) ? 1.0 : -1.0, expectedRe, expectedIm);
+
+			for (int threaded = 0; threaded < 2; threaded++) {
+
+				memcpy(re, sourceRe.data(), sizeof(float) * n * n);
+				memcpy(im, sourceIm.data(), sizeof(float) * n * n);
+
+				fft->transform2D(re, im, inverse != 0, (threaded) ? pool : nullptr);
+
+				double maxError = 0.0;
+
+				for (uint32_t i = 0; i < n * n; i++)
+					maxError = max(maxError, max(fabs(re[i] - expectedRe[i]), fabs(im[i] - expectedIm[i])));
+
+				// The transformed values grow as n (random phases), with float rounding growing as log2(n)
+				TEST_CHECK(maxError < 1.0e-5 * (double)n);
+			}
+		}
+
+		// A forward then inverse transform returns the input scaled by n^2
+		memcpy(re, sourceRe.data(), sizeof(float) * n * n);
+		memcpy(im, sourceIm.data(), sizeof(float) * n * n);
+
+		fft->transform2D(re, im, false, pool);
+		fft->transform2D(re, im, true, pool);
+
+		double maxError = 0.0;
+
+		for (uint32_t i = 0; i < n * n; i++)
+			maxError = max(maxError, max(fabs(re[i] / (double)(n * n) - sourceRe[i]), fabs(im[i] / (double)(n * n) - sourceIm[i])));
+
+		TEST_CHECK(maxError < 1.0e-5);
+
+		_aligned_free(re);
+		_aligned_free(im);
+
+		fft->release();
+	}
+
+	// Sizes that are not powers of two of at least 4 are rejected
+	const uint32_t badSizes[] = { 0, 1, 2, 6, 100 };
+
+	for (uint32_t i = 0; i < sizeof(badSizes) / sizeof(badSizes[0]); i++) {
+
+		GUFFT *fft = new GUFFT(badSizes[i]);
+
+		TEST_CHECK(fft->size() == 0);
+
+		fft->release();
+	}
+
+	pool->release();
+}
+
+#pragma endregion
+
+
+#pragma region OceanSpectrum
+
+// The pooled update is identical to the serial one, the surface repeats after repeatTime, the height has zero mean and no sample exceeds the displacement bound
+TEST_CASE(oceanSpectrumProperties) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	const uint32_t n = 64;
+	const uint32_t N = n * n;
+
+	for (int type = 0; type < 2; type++) {
+
+		OceanSpectrumDesc desc;
+
+		desc.type = (type) ? OCEAN_SPECTRUM_JONSWAP : OCEAN_SPECTRUM_PHILLIPS;
+
+		OceanSpectrum *serial = new OceanSpectrum(n, desc, 7);
+		OceanSpectrum *pooled = new OceanSpectrum(n, desc, 7);
+
+		TEST_CHECK(serial->size() == n);
+
+		XMFLOAT3 bound = serial->getDisplacementBound();
+
+		TEST_CHECK(bound.y > 0.0f);
+
+		uint32_t numDifferent = 0, numOutOfBound = 0;
+		double maxMeanHeight = 0.0, maxMeanJacobian = 0.0;
+
+		for (int step = 0; step < 10; step++) {
+
+			double t = 0.37 * (double)step;
+
+			serial->update(t);
+			pooled->update(t, pool);
+
+			if (memcmp(serial->getDisplacement(), pooled->getDisplacement(), sizeof(XMFLOAT4) * N) != 0 || memcmp(serial->getNormals(), pooled->getNormals(), sizeof(uint32_t) * N) != 0)
+				numDifferent++;
+
+			const XMFLOAT4 *D = serial->getDisplacement();
+			double sumHeight = 0.0, sumJacobian = 0.0;
+
+			for (uint32_t i = 0; i < N; i++) {
+
+				if (fabsf(D[i].x) > bound.x || fabsf(D[i].y) > bound.y || fabsf(D[i].z) > bound.z)
+					numOutOfBound++;
+
+				sumHeight += D[i].y;
+				sumJacobian += D[i].w;
+			}
+
+			maxMeanHeight = max(maxMeanHeight, fabs(sumHeight / (double)N));
+			maxMeanJacobian = max(maxMeanJacobian, fabs(sumJacobian / (double)N - 1.0));
+		}
+
+		TEST_CHECK(numDifferent == 0);
+		TEST_CHECK(numOutOfBound == 0);
+		TEST_CHECK(maxMeanHeight < 1.0e-3 * bound.y);
+
+		// The Jacobian of a periodic displacement averages to about 1 (exactly for the continuous surface)
+		TEST_CHECK(maxMeanJacobian < 0.05);
+
+		// Frequencies are multiples of 2 pi / repeatTime so the surface repeats
+		vector<XMFLOAT4> first(N);
+
+		serial->update(3.0);
+		memcpy(first.data(), serial->getDisplacement(), sizeof(XMFLOAT4) * N);
+		serial->update(3.0 + 5.0 * desc.repeatTime);
+
+		float maxError = 0.0f;
+
+		for (uint32_t i = 0; i < N; i++)
+			maxError = max(maxError, fabsf(first[i].y - serial->getDisplacement()[i].y));
+
+		TEST_CHECK(maxError < 1.0e-3f * bound.y);
+		TEST_CHECK(serial->getTime() == 3.0 + 5.0 * desc.repeatTime);
+
+		serial->release();
+		pooled->release();
+	}
+
+	pool->release();
+}
+
+
+BENCHMARK(oceanFFTAndSpectrum) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool();
+
+	cout << "  " << pool->threadCount() << " threads" << endl;
+
+	for (uint32_t n = 128; n <= 512; n *= 2) {
+
+		uint32_t numRepeats = (512 / n) * (512 / n) * 4;
+
+		GUFFT *fft = new GUFFT(n);
+		float *re = alignedArray(n), *im = alignedArray(n);
+
+		TestRandom R(n);
+
+		for (uint32_t i = 0; i < n * n; i++) {
+
+			re[i] = R.uniform(-1.0f, 1.0f);
+			im[i] = R.uniform(-1.0f, 1.0f);
+		}
+
+		cout << "  " << n << " x " << n << " samples" << endl;
+
+		for (int threaded = 0; threaded < 2; threaded++) {
+
+			TestTimer timer;
+
+			// Alternate directions so the values stay bounded
+			for (uint32_t k = 0; k < numRepeats; k++)
+				fft->transform2D(re, im, (k & 1) != 0, (threaded) ? pool : nullptr);
+
+			test_report((threaded) ? "2D FFT (pool)" : "2D FFT", (double)n * n * numRepeats, timer.seconds());
+		}
+
+		_aligned_free(re);
+		_aligned_free(im);
+		fft->release();
+
+		OceanSpectrum *spectrum = new OceanSpectrum(n, OceanSpectrumDesc());
+
+		for (int threaded = 0; threaded < 2; threaded++) {
+
+			TestTimer timer;
+
+			for (uint32_t k = 0; k < numRepeats; k++)
+				spectrum->update((double)k / 60.0, (threaded) ? pool : nullptr);
+
+			test_report((threaded) ? "spectrum update (pool)" : "spectrum update", (double)n * n * numRepeats, timer.seconds());
+		}
+
+		spectrum->release();
+	}
+
+	pool->release();
+}
+
+#pragma endregion
+
+
+#pragma region GerstnerWaves
+
+// Displacement and unnormalised normal of a wave set at (x, z) evaluated directly in double precision
+static void referenceGerstner(const GerstnerWaves *waves, const double t, const double x, const double z, double displacement[3], double normal[3]) {
+
+	displacement[0] = displacement[1] = displacement[2] = 0.0;
+	normal[0] = normal[2] = 0.0;
+	normal[1] = 1.0;
+
+	for (uint32_t i = 0; i < waves->waveCount(); i++) {
+
+		const GerstnerWave& w = waves->getWave(i);
+
+		double theta = (double)w.wavenumber * ((double)w.direction.x * x + (double)w.direction.y * z) - (double)w.angularFrequency * t + (double)w.phase;
+		double S = sin(theta), C = cos(theta);
+
+		displacement[0] += (double)w.steepness * w.amplitude * w.direction.x * C;
+		displacement[1] += (double)w.amplitude * S;
+		displacement[2] += (double)w.steepness * w.amplitude * w.direction.y * C;
+
+		normal[0] -= (double)w.wavenumber * w.amplitude * w.direction.x * C;
+		normal[1] -= (double)w.steepness * w.wavenumber * w.amplitude * S;
+		normal[2] -= (double)w.wavenumber * w.amplitude * w.direction.y * C;
+	}
+}
+
+
+// Sample points on a square of the given half width.  The count is not a multiple of 4 so the padded last group is exercised
+static void gerstnerPoints(vector<float>& x, vector<float>& z, const float halfWidth, const uint32_t seed) {
+
+	TestRandom R(seed);
+
+	x.resize(1003);
+	z.resize(1003);
+
+	for (uint32_t i = 0; i < x.size(); i++) {
+
+		x[i] = R.uniform(-halfWidth, halfWidth);
+		z[i] = R.uniform(-halfWidth, halfWidth);
+	}
+}
+
+
+// Wave sets built with FromSineWave reproduce the sine-sum the ocean shader used, including the time and position scales DXController applies
+TEST_CASE(gerstnerMatchesSineSum) {
+
+	const SineWave swell[] = {
+		{ 1.0f, 0.05f, 0.5f, XMFLOAT2(-0.5f, 0.6f) },
+		{ 2.0f, 0.025f, 1.3f, XMFLOAT2(0.7f, 0.7f) },
+		{ 0.35f, 0.2f, -0.8f, XMFLOAT2(0.0f, 2.0f) }
+	};
+	const uint32_t numWaves = sizeof(swell) / sizeof(swell[0]);
+
+	const float timeScales[] = { 1.0f, 0.5f };
+	const float metresPerUnits[] = { 1.0f, 2.5f };
+
+	vector<float> x, z;
+
+	gerstnerPoints(x, z, 40.0f, 3);
+
+	for (uint32_t s = 0; s < 2; s++) {
+
+		float timeScale = timeScales[s];
+		float metresPerUnit = metresPerUnits[s];
+
+		GerstnerWaves *waves = new GerstnerWaves();
+
+		for (uint32_t i = 0; i < numWaves; i++)
+			TEST_CHECK(waves->addWave(GerstnerWaves::FromSineWave(swell[i], timeScale, metresPerUnit)));
+
+		// Wave-space positions
+		vector<float> wx(x.size()), wz(z.size());
+
+		for (uint32_t i = 0; i < x.size(); i++) {
+
+			wx[i] = x[i] * metresPerUnit;
+			wz[i] = z[i] * metresPerUnit;
+		}
+
+		vector<XMFLOAT3> displacement(x.size()), normal(x.size());
+		float maxHeightError = 0.0f, maxHorizontal = 0.0f, maxNormalError = 0.0f;
+
+		for (int step = 0; step < 8; step++) {
+
+			float t = 1.7f * (float)step;
+
+			waves->setTime(t);
+			waves->displacements(wx.data(), wz.data(), displacement.data(), (uint32_t)x.size());
+			waves->normals(wx.data(), wz.data(), normal.data(), (uint32_t)x.size());
+
+			for (uint32_t i = 0; i < x.size(); i++) {
+
+				XMFLOAT2 gradient;
+
+				float h = GerstnerWaves::SineSumReference(swell, numWaves, x[i], z[i], t * timeScale, &gradient);
+
+				XMVECTOR expectedNormal = XMVector3Normalize(XMVectorSet(-gradient.x, 1.0f, -gradient.y, 0.0f));
+
+				maxHeightError = max(maxHeightError, fabsf(displacement[i].y - h * metresPerUnit));
+				maxHorizontal = max(maxHorizontal, max(fabsf(displacement[i].x), fabsf(displacement[i].z)));
+				maxNormalError = max(maxNormalError, XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&normal[i]), expectedNormal))));
+			}
+		}
+
+		TEST_CHECK(maxHeightError < 1.0e-5f * metresPerUnit);
+		TEST_CHECK(maxHorizontal == 0.0f);
+		TEST_CHECK(maxNormalError < 1.0e-5f);
+
+		waves->release();
+	}
+}
+
+
+// Steep waves match a double precision Gerstner sum at large times, stay within the displacement bound, and surfaceHeights inverts the horizontal displacement
+TEST_CASE(gerstnerMatchesDoubleReference) {
+
+	TestRandom R(11);
+	GerstnerWaves *waves = new GerstnerWaves();
+
+	// Keep the sum of steepness * wavenumber * amplitude below 1 so the surface has no cusps
+	float crestSum = 0.0f;
+
+	for (uint32_t i = 0; i < GERSTNER_MAX_WAVES; i++) {
+
+		float angle = R.uniform(0.0f, 6.2831853f);
+		float wavelength = R.uniform(4.0f, 60.0f);
+
+		GerstnerWave w(XMFLOAT2(cosf(angle), sinf(angle)), wavelength * 0.01f, wavelength, R.uniform(0.2f, 1.0f));
+
+		w.phase = R.uniform(0.0f, 6.2831853f);
+		crestSum += w.steepness * w.wavenumber * w.amplitude;
+
+		TEST_CHECK(waves->addWave(w));
+	}
+
+	TEST_CHECK(!waves->addWave(GerstnerWave()));
+	TEST_CHECK(crestSum < 0.6f);
+
+	vector<float> x, z;
+
+	gerstnerPoints(x, z, 200.0f, 4);
+
+	vector<XMFLOAT3> displacement(x.size()), normal(x.size());
+	vector<float> surfaceX(x.size()), surfaceZ(x.size()), heights(x.size());
+
+	XMFLOAT2 bound = waves->getDisplacementBound();
+
+	const double times[] = { 0.0, 12.5, 3600.0, 86400.0 * 7.0, 1.0e7 };
+
+	for (uint32_t k = 0; k < sizeof(times) / sizeof(times[0]); k++) {
+
+		waves->setTime(times[k]);
+		waves->displacements(x.data(), z.data(), displacement.data(), (uint32_t)x.size());
+		waves->normals(x.data(), z.data(), normal.data(), (uint32_t)x.size());
+
+		double maxDisplacementError = 0.0, maxNormalError = 0.0;
+		uint32_t numOutOfBound = 0;
+
+		for (uint32_t i = 0; i < x.size(); i++) {
+
+			double d[3], n[3];
+
+			referenceGerstner(waves, times[k], x[i], z[i], d, n);
+
+			double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			maxDisplacementError = max(maxDisplacementError, max(fabs(displacement[i].x - d[0]), max(fabs(displacement[i].y - d[1]), fabs(displacement[i].z - d[2]))));
+			maxNormalError = max(maxNormalError, max(fabs(normal[i].x - n[0] / length), max(fabs(normal[i].y - n[1] / length), fabs(normal[i].z - n[2] / length))));
+
+			if (sqrtf(displacement[i].x * displacement[i].x + displacement[i].z * displacement[i].z) > bound.x * 1.0001f || fabsf(displacement[i].y) > bound.y * 1.0001f)
+				numOutOfBound++;
+
+			surfaceX[i] = x[i] + displacement[i].x;
+			surfaceZ[i] = z[i] + displacement[i].z;
+		}
+
+		// The phase is wrapped in double precision so the error does not grow with the time
+		TEST_CHECK(maxDisplacementError < 2.0e-5);
+		TEST_CHECK(maxNormalError < 2.0e-5);
+		TEST_CHECK(numOutOfBound == 0);
+
+		// The height above each displaced point is the height the point was displaced to
+		waves->surfaceHeights(surfaceX.data(), surfaceZ.data(), heights.data(), (uint32_t)x.size(), 8);
+
+		float maxHeightError = 0.0f;
+
+		for (uint32_t i = 0; i < x.size(); i++)
+			maxHeightError = max(maxHeightError, fabsf(heights[i] - displacement[i].y));
+
+		TEST_CHECK(maxHeightError < 1.0e-3f * bound.y);
+	}
+
+	waves->release();
+}
+
+#pragma endregion
+
+
+#pragma region OceanGrid
+
+// Point on the water plane seen through the screen point (sx, sy), found by casting between the near and far planes.  Returns false if the ray misses the surface shrunk by inset on each side or meets it outside the view depth range
+static bool waterUnderPixel(FXMMATRIX invWorldViewProj, const float sx, const float sy, const DXBoundingVolume& surfaceBounds, const float inset) {
+
+	XMFLOAT3 n, f;
+
+	XMStoreFloat3(&n, XMVector3TransformCoord(XMVectorSet(sx, sy, 0.0f, 1.0f), invWorldViewProj));
+	XMStoreFloat3(&f, XMVector3TransformCoord(XMVectorSet(sx, sy, 1.0f, 1.0f), invWorldViewProj));
+
+	if (f.y == n.y)
+		return false;
+
+	float t = (surfaceBounds.centre.y - n.y) / (f.y - n.y);
+
+	if (t < 0.0f || t > 1.0f)
+		return false;
+
+	float x = n.x + (f.x - n.x) * t;
+	float z = n.z + (f.z - n.z) * t;
+
+	return fabsf(x - surfaceBounds.centre.x) <= surfaceBounds.extents.x - inset && fabsf(z - surfaceBounds.centre.z) <= surfaceBounds.extents.z - inset;
+}
+
+
+// Signed area of the screen triangle abc (negative when clockwise)
+static float signedArea(const XMFLOAT2& a, const XMFLOAT2& b, const XMFLOAT2& c) {
+
+	return 0.5f * ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x));
+}
+
+
+// Every screen point that sees the water is covered by a grid triangle, vertices stay on the surface, vertices that hit the water project back to their grid position, triangles are clockwise and views that cannot see the water draw nothing
+TEST_CASE(oceanGridCoverage) {
+
+	const uint32_t width = 48, height = 27;
+
+	DXBoundingVolume surfaceBounds(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(200.0f, 0.0f, 200.0f));
+	DXBoundingVolume bounds(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(202.0f, 2.0f, 202.0f));
+
+	// Eye, target and whether the water can be seen
+	struct GridView { XMFLOAT3 eye, target; bool visible; };
+
+	const GridView views[] = {
+		{ XMFLOAT3(0.0f, 20.0f, -50.0f), XMFLOAT3(0.0f, 0.0f, 100.0f), true }, // Towards the horizon
+		{ XMFLOAT3(10.0f, 100.0f, 0.0f), XMFLOAT3(10.0f, 0.0f, 1.0f), true }, // Straight down
+		{ XMFLOAT3(0.0f, 5.0f, -400.0f), XMFLOAT3(30.0f, 0.0f, 0.0f), true }, // From outside the water
+		{ XMFLOAT3(-150.0f, 1.0f, 150.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), true }, // Inside the displaced bounds
+		{ XMFLOAT3(0.0f, 20.0f, 0.0f), XMFLOAT3(0.0f, 100.0f, 10.0f), false }, // At the sky
+		{ XMFLOAT3(0.0f, 20.0f, -600.0f), XMFLOAT3(0.0f, 20.0f, -1000.0f), false } // Away from the water
+	};
+
+	OceanGrid *grid = new OceanGrid(width, height);
+
+	TEST_CHECK(grid->maxVertexCount() == width * height);
+	TEST_CHECK(grid->maxIndexCount() == (width - 1) * (height - 1) * 6);
+
+	vector<uint32_t> indices(grid->maxIndexCount());
+
+	grid->buildIndices(indices.data());
+
+	uint32_t maxIndex = 0;
+
+	for (uint32_t i = 0; i < indices.size(); i++)
+		maxIndex = max(maxIndex, indices[i]);
+
+	TEST_CHECK(maxIndex == width * height - 1);
+
+	for (uint32_t v = 0; v < sizeof(views) / sizeof(views[0]); v++) {
+
+		XMVECTOR upVector = (fabsf(views[v].eye.y - views[v].target.y) > 50.0f && fabsf(views[v].eye.z - views[v].target.z) < 20.0f) ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+		XMMATRIX worldViewProj = XMMatrixLookAtLH(XMLoadFloat3(&views[v].eye), XMLoadFloat3(&views[v].target), upVector) * XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.5f, 1000.0f);
+		XMMATRIX invWorldViewProj = XMMatrixInverse(nullptr, worldViewProj);
+
+		TEST_CHECK(grid->update(worldViewProj, bounds, surfaceBounds));
+		TEST_CHECK(!grid->update(worldViewProj, bounds, surfaceBounds));
+
+		if (!views[v].visible) {
+
+			TEST_CHECK(grid->vertexCount() == 0 && grid->indexCount() == 0);
+			continue;
+		}
+
+		TEST_CHECK(grid->vertexCount() == width * height && grid->indexCount() == grid->maxIndexCount());
+
+		const XMFLOAT3 *positions = grid->getPositions();
+		XMFLOAT4 range = grid->getScreenRange();
+
+		// Project the vertices.  Vertices whose ray hit the water inside the surface land back on their grid point
+		vector<XMFLOAT2> screen(width * height);
+		uint32_t numOffSurface = 0, numBehind = 0, numMisplaced = 0, numHits = 0;
+
+		for (uint32_t j = 0; j < height; j++) {
+
+			for (uint32_t i = 0; i < width; i++) {
+
+				const XMFLOAT3& p = positions[j * width + i];
+
+				if (fabsf(p.x) > surfaceBounds.extents.x || fabsf(p.z) > surfaceBounds.extents.z || p.y != surfaceBounds.centre.y)
+					numOffSurface++;
+
+				XMFLOAT4 clip;
+
+				XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(p.x, p.y, p.z, 1.0f), worldViewProj));
+
+				if (clip.w <= 0.0f) {
+
+					numBehind++;
+					continue;
+				}
+
+				screen[j * width + i] = XMFLOAT2(clip.x / clip.w, clip.y / clip.w);
+
+				float sx = range.x + (range.z - range.x) * (float)i / (float)(width - 1);
+				float sy = range.y + (range.w - range.y) * (float)j / (float)(height - 1);
+
+				if (fabsf(p.x) < surfaceBounds.extents.x * 0.99f && fabsf(p.z) < surfaceBounds.extents.z * 0.99f) {
+
+					numHits++;
+
+					if (fabsf(screen[j * width + i].x - sx) > 1.0e-3f || fabsf(screen[j * width + i].y - sy) > 1.0e-3f)
+						numMisplaced++;
+				}
+			}
+		}
+
+		TEST_CHECK(numOffSurface == 0);
+		TEST_CHECK(numBehind == 0);
+		TEST_CHECK(numHits > 0);
+		TEST_CHECK(numMisplaced == 0);
+
+		// Triangles are clockwise on screen or have collapsed against the edge of the surface
+		uint32_t numCounterClockwise = 0;
+
+		for (uint32_t k = 0; k < indices.size(); k += 3)
+			if (signedArea(screen[indices[k]], screen[indices[k + 1]], screen[indices[k + 2]]) > 1.0e-6f)
+				numCounterClockwise++;
+
+		TEST_CHECK(numCounterClockwise == 0);
+
+		// Screen points that see the water (away from its rim, where the clamped triangles collapse) lie in a grid triangle
+		uint32_t numWaterPixels = 0, numUncovered = 0;
+
+		for (int py = 0; py < 40; py++) {
+
+			for (int px = 0; px < 40; px++) {
+
+				XMFLOAT2 s(-0.99f + 1.98f * (float)px / 39.0f, -0.99f + 1.98f * (float)py / 39.0f);
+
+				if (!waterUnderPixel(invWorldViewProj, s.x, s.y, surfaceBounds, 2.0f))
+					continue;
+
+				numWaterPixels++;
+
+				bool covered = false;
+
+				for (uint32_t k = 0; k < indices.size() && !covered; k += 3) {
+
+					const XMFLOAT2& a = screen[indices[k]];
+					const XMFLOAT2& b = screen[indices[k + 1]];
+					const XMFLOAT2& c = screen[indices[k + 2]];
+
+					// Clockwise triangles contain the points on the right of every edge
+					covered = signedArea(a, b, s) <= 0.0f && signedArea(b, c, s) <= 0.0f && signedArea(c, a, s) <= 0.0f && signedArea(a, b, c) < 0.0f;
+				}
+
+				if (!covered)
+					numUncovered++;
+			}
+		}
+
+		TEST_CHECK(numWaterPixels > 0);
+		TEST_CHECK(numUncovered == 0);
+	}
+
+	// Seen from outside the water only part of the screen is covered, so the grid is not spread over the whole screen
+	XMMATRIX distant = XMMatrixLookAtLH(XMVectorSet(0.0f, 30.0f, -900.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.5f, 2000.0f);
+
+	grid->update(distant, bounds, surfaceBounds);
+
+	XMFLOAT4 range = grid->getScreenRange();
+
+	TEST_CHECK(grid->vertexCount() == width * height);
+	TEST_CHECK((range.z - range.x) * (range.w - range.y) < 0.5f * 4.0f);
+
+	grid->release();
+
+	// Grids smaller than 2 x 2 draw nothing
+	OceanGrid *empty = new OceanGrid(1, 10);
+
+	TEST_CHECK(empty->maxVertexCount() == 0 && empty->maxIndexCount() == 0);
+	TEST_CHECK(!empty->update(XMMatrixIdentity(), bounds, surfaceBounds));
+
+	empty->release();
+}
+
+#pragma endregion
@@ -0,0 +1,687 @@
+
+//
+// ParticleTests.cpp
+//
+
+// Tests and benchmarks for the CPU particle simulation (ParticleSystem)
+
+#include <stdafx.h>
+#include <TestHarness.h>
+#include <ParticleSystem.h>
+#include <GUParallel.h>
+#include <GPUParticles.h>
+#include <ParticleEffects.h>
+#include <DXShaderFactory.h>
+#include <DXBlob.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace DirectX;
+
+
+#pragma region ParticleSystem
+
+// Fountain emitter with a ground plane so both the bounce and the expiry paths are exercised
+static ParticleEmitter fountainEmitter(const float lifeMin, const float lifeMax) {
+
+	ParticleEmitter E;
+
+	E.position = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	E.positionSpread = XMFLOAT3(0.5f, 0.5f, 0.5f);
+	E.velocity = XMFLOAT3(0.0f, 6.0f, 0.0f);
+	E.velocitySpread = XMFLOAT3(3.0f, 2.0f, 3.0f);
+	E.gravity = XMFLOAT3(0.0f, -9.81f, 0.0f);
+	E.drag = 0.2f;
+	E.groundHeight = 0.0f;
+	E.restitution = 0.5f;
+	E.lifeMin = lifeMin;
+	E.lifeMax = lifeMax;
+	E.rate = 0.0f;
+
+	return E;
+}
+
+
+// Scalar copy of the live particles of a system
+struct ReferenceParticle {
+
+	float								p[3], v[3], age, life;
+};
+
+static void copyParticles(const ParticleSystem *system, vector<ReferenceParticle>& particles) {
+
+	particles.resize(system->particleCount());
+
+	for (uint32_t i = 0; i < particles.size(); i++) {
+
+		ReferenceParticle& P = particles[i];
+
+		P.p[0] = system->getPositionX()[i];
+		P.p[1] = system->getPositionY()[i];
+		P.p[2] = system->getPositionZ()[i];
+		P.v[0] = system->getVelocityX()[i];
+		P.v[1] = system->getVelocityY()[i];
+		P.v[2] = system->getVelocityZ()[i];
+		P.age = system->getAge()[i];
+		P.life = system->getLife()[i];
+	}
+}
+
+
+// Scalar reference step.  Same integration as ParticleSystem::IntegrateParticles, and expired particles are removed keeping the order of the rest
+static void referenceStep(vector<ReferenceParticle>& particles, const ParticleEmitter& E, const float dt) {
+
+	const float g[3] = { E.gravity.x * dt, E.gravity.y * dt, E.gravity.z * dt };
+	float damping = max(1.0f - E.drag * dt, 0.0f);
+
+	uint32_t numLive = 0;
+
+	for (uint32_t i = 0; i < particles.size(); i++) {
+
+		ReferenceParticle P = particles[i];
+
+		for (int k = 0; k < 3; k++) {
+
+			P.v[k] = P.v[k] * damping + g[k];
+			P.p[k] = P.p[k] + P.v[k] * dt;
+		}
+
+		if (P.p[1] < E.groundHeight) {
+
+			P.p[1] = E.groundHeight;
+
+			if (P.v[1] < 0.0f)
+				P.v[1] *= -E.restitution;
+		}
+
+		P.age += dt;
+
+		if (P.age < P.life)
+			particles[numLive++] = P;
+	}
+
+	particles.resize(numLive);
+}
+
+
+// Count the particles of system that differ from the reference by more than tolerance
+static uint32_t countParticleMismatches(const ParticleSystem *system, const vector<ReferenceParticle>& reference, const float tolerance) {
+
+	vector<ReferenceParticle> particles;
+
+	copyParticles(system, particles);
+
+	if (particles.size() != reference.size())
+		return (uint32_t)max(particles.size(), reference.size());
+
+	uint32_t numMismatches = 0;
+
+	for (uint32_t i = 0; i < particles.size(); i++) {
+
+		const ReferenceParticle& P = particles[i];
+		const ReferenceParticle& Q = reference[i];
+
+		bool match = P.age == Q.age && P.life == Q.life;
+
+		for (int k = 0; k < 3; k++)
+			match = match && fabsf(P.p[k] - Q.p[k]) <= tolerance && fabsf(P.v[k] - Q.v[k]) <= tolerance;
+
+		if (!match)
+			numMismatches++;
+	}
+
+	return numMismatches;
+}
+
+
+// Every particle array is 32 byte aligned whatever the capacity
+TEST_CASE(particleSystemArrayAlignment) {
+
+	const uint32_t capacities[] = { 1, 3, 4, 5, 7, 9, 13, 100, 16385 };
+
+	for (uint32_t c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+
+		ParticleSystem *system = new ParticleSystem(capacities[c]);
+
+		TEST_CHECK(system->getCapacity() == capacities[c]);
+
+		const float *arrays[] = { system->getPositionX(), system->getPositionY(), system->getPositionZ(), system->getVelocityX(), system->getVelocityY(), system->getVelocityZ(), system->getAge(), system->getLife() };
+
+		for (uint32_t a = 0; a < 8; a++)
+			TEST_CHECK(((uintptr_t)arrays[a] & 31) == 0);
+
+		system->release();
+	}
+}
+
+
+// The SIMD integration and compaction match the scalar reference step for step, on one thread and on a thread pool
+TEST_CASE(particleSystemMatchesReference) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	// Several simulation blocks with an odd tail so the padding lanes and the per-block offsets are exercised
+	const uint32_t capacity = PARTICLE_BLOCK_SIZE * 3 + 13;
+
+	for (int threaded = 0; threaded < 2; threaded++) {
+
+		ParticleSystem *system = new ParticleSystem(capacity);
+
+		system->setEmitter(fountainEmitter(0.2f, 2.0f));
+
+		TEST_CHECK(system->emit(capacity + 100) == capacity);
+		TEST_CHECK(system->particleCount() == capacity);
+
+		vector<ReferenceParticle> reference;
+
+		copyParticles(system, reference);
+
+		const float dt = 1.0f / 60.0f;
+		uint32_t numMismatches = 0;
+
+		for (int step = 0; step < 200; step++) {
+
+			system->simulate(dt, (threaded) ? pool : nullptr);
+			referenceStep(reference, system->getEmitter(), dt);
+
+			numMismatches += countParticleMismatches(system, reference, 1.0e-4f);
+
+			// Top up part way through so new particles are appended after compacted ones
+			if (step == 40) {
+
+				system->emit(PARTICLE_BLOCK_SIZE);
+
+				copyParticles(system, reference);
+			}
+		}
+
+		TEST_CHECK(numMismatches == 0);
+
+		// Every particle has expired
+		TEST_CHECK(system->particleCount() == 0);
+
+		system->release();
+	}
+
+	pool->release();
+}
+
+
+// Particles emitted by update follow the emitter rate and never exceed the capacity
+TEST_CASE(particleSystemEmissionRate) {
+
+	ParticleSystem *system = new ParticleSystem(1000);
+	ParticleEmitter E = fountainEmitter(100.0f, 100.0f);
+
+	E.rate = 250.0f;
+	system->setEmitter(E);
+
+	for (int step = 0; step < 60; step++)
+		system->update(1.0f / 60.0f);
+
+	TEST_CHECK(system->particleCount() >= 249 && system->particleCount() <= 250);
+
+	for (int step = 0; step < 300; step++)
+		system->update(1.0f / 60.0f);
+
+	TEST_CHECK(system->particleCount() == 1000);
+
+	const float *py = system->getPositionY();
+	uint32_t numBelowGround = 0;
+
+	for (uint32_t i = 0; i < system->particleCount(); i++)
+		if (py[i] < E.groundHeight)
+			numBelowGround++;
+
+	TEST_CHECK(numBelowGround == 0);
+
+	system->clear();
+
+	TEST_CHECK(system->particleCount() == 0);
+
+	system->release();
+}
+
+
+BENCHMARK(particleSystemSimulate) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool();
+	const float dt = 1.0f / 60.0f;
+
+	cout << "  " << pool->threadCount() << " threads" << endl;
+
+	for (uint32_t count = 10000; count <= 1000000; count *= 10) {
+
+		ParticleSystem *system = new ParticleSystem(count);
+		uint32_t numSteps = max(10u, 20000000 / count);
+
+		cout << "  " << count << " particles" << endl;
+
+		// Long lifetimes give integration only.  Short lifetimes remove about 1 particle in 60 each step and the system is topped up again so compaction runs every step
+		for (int expiring = 0; expiring < 2; expiring++) {
+
+			system->setEmitter(fountainEmitter((expiring) ? 0.5f : 1.0e6f, (expiring) ? 1.5f : 1.0e6f));
+
+			for (int threaded = 0; threaded < 2; threaded++) {
+
+				system->clear();
+				system->emit(count);
+
+				TestTimer timer;
+
+				for (uint32_t step = 0; step < numSteps; step++) {
+
+					system->simulate(dt, (threaded) ? pool : nullptr);
+					system->emit(count);
+				}
+
+				double t = timer.seconds();
+
+				test_report((expiring) ? ((threaded) ? "simulate + compact (pool)" : "simulate + compact") : ((threaded) ? "simulate (pool)" : "simulate"), (double)count * numSteps, t);
+			}
+		}
+
+		system->release();
+	}
+
+	pool->release();
+}
+
+#pragma endregion
+
+
+#pragma region GPUParticles
+
+// Create a WARP (software) device so the compute shader path can be tested without a GPU.  Returns false if Direct3D 11 is not available
+static bool createWARPDevice(ID3D11Device **device, ID3D11DeviceContext **context) {
+
+	D3D_FEATURE_LEVEL featureLevel = D3D_FEATURE_LEVEL_11_0;
+
+	HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, D3D11_CREATE_DEVICE_SINGLETHREADED, &featureLevel, 1, D3D11_SDK_VERSION, device, nullptr, context);
+
+	return SUCCEEDED(hr);
+}
+
+
+// The compute shader simulation read back with readParticles matches ParticleSystem.  The emitter has no spread and a fixed lifetime so every particle emitted in a step is identical on both and the GPU random numbers do not matter.  Particles emitted in different steps differ in age, and the GPU append order is not defined, so both sets are compared in age order.  Run from the project directory after building DX11Proj so the particle shaders are found in Shaders\cso
+TEST_CASE(gpuParticlesMatchParticleSystem) {
+
+	ID3D11Device *device = nullptr;
+	ID3D11DeviceContext *context = nullptr;
+
+	if (!createWARPDevice(&device, &context)) {
+
+		cout << "  skipped - no Direct3D 11 WARP device" << endl;
+		return;
+	}
+
+	ParticleEmitter E = fountainEmitter(1.25f, 1.25f);
+
+	E.positionSpread = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	E.velocitySpread = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	E.velocity = XMFLOAT3(1.5f, 6.0f, -0.5f);
+	E.rate = 300.0f;
+
+	const uint32_t capacity = 1000;
+
+	// The constructor reports failures itself and leaves the capacity 0
+	GPUParticles *gpu = new GPUParticles(device, nullptr, capacity, E);
+
+	if (gpu->getCapacity() == 0) {
+
+		cout << "  skipped - the particle shaders could not be loaded" << endl;
+
+		gpu->release();
+		context->Release();
+		device->Release();
+		return;
+	}
+
+	ParticleSystem *cpu = new ParticleSystem(capacity);
+
+	cpu->setEmitter(E);
+
+	vector<GPUParticle> particles;
+	const float dt = 1.0f / 60.0f;
+	uint32_t numCountMismatches = 0, numMismatches = 0;
+
+	// Long enough for particles to bounce and expire and for the buffer to fill
+	for (int step = 0; step < 240; step++) {
+
+		gpu->update(context, dt);
+		cpu->update(dt);
+
+		// Change the rate part way through so emission is limited by the capacity
+		if (step == 120) {
+
+			E.rate = 2000.0f;
+
+			gpu->setEmitter(E);
+			cpu->setEmitter(E);
+		}
+
+		if (step % 20 != 19)
+			continue;
+
+		gpu->readParticles(context, particles);
+
+		if (particles.size() != cpu->particleCount()) {
+
+			numCountMismatches++;
+			continue;
+		}
+
+		vector<uint32_t> order(cpu->particleCount());
+
+		for (uint32_t i = 0; i < order.size(); i++)
+			order[i] = i;
+
+		const float *age = cpu->getAge();
+
+		stable_sort(order.begin(), order.end(), [age](uint32_t a, uint32_t b) { return age[a] < age[b]; });
+		stable_sort(particles.begin(), particles.end(), [](const GPUParticle& a, const GPUParticle& b) { return a.age < b.age; });
+
+		for (uint32_t i = 0; i < particles.size(); i++) {
+
+			const GPUParticle& P = particles[i];
+			uint32_t j = order[i];
+
+			float error = max(max(fabsf(P.position.x - cpu->getPositionX()[j]), fabsf(P.position.y - cpu->getPositionY()[j])), fabsf(P.position.z - cpu->getPositionZ()[j]));
+
+			error = max(error, max(max(fabsf(P.velocity.x - cpu->getVelocityX()[j]), fabsf(P.velocity.y - cpu->getVelocityY()[j])), fabsf(P.velocity.z - cpu->getVelocityZ()[j])));
+			error = max(error, max(fabsf(P.age - age[j]), fabsf(P.life - cpu->getLife()[j])));
+
+			if (error > 1.0e-3f)
+				numMismatches++;
+		}
+	}
+
+	TEST_CHECK(numCountMismatches == 0);
+	TEST_CHECK(numMismatches == 0);
+	TEST_CHECK(cpu->particleCount() == capacity);
+
+	// Clearing empties the readback
+	gpu->clear();
+	gpu->readParticles(context, particles);
+
+	TEST_CHECK(particles.empty());
+
+	cpu->release();
+	gpu->release();
+	context->Release();
+	device->Release();
+}
+
+#pragma endregion
+
+
+#pragma region ParticleEffects
+
+// WARP device and the fire_vs bytecode ParticleEffects builds its input layout from.  Returns false if either is unavailable
+static bool createEffectsDevice(ID3D11Device **device, ID3D11DeviceContext **context, ID3D11VertexShader **fireVS, DXBlob **fireVSBytecode) {
+
+	if (!createWARPDevice(device, context)) {
+
+		cout << "  skipped - no Direct3D 11 WARP device" << endl;
+		return false;
+	}
+
+	if (!SUCCEEDED(DXShaderFactory::loadVertexShader(*device, "Shaders\\cso\\fire_vs.cso", fireVS, fireVSBytecode))) {
+
+		cout << "  skipped - fire_vs.cso could not be loaded" << endl;
+
+		(*context)->Release();
+		(*device)->Release();
+		return false;
+	}
+
+	return true;
+}
+
+
+static void releaseEffectsDevice(ID3D11Device *device, ID3D11DeviceContext *context, ID3D11VertexShader *fireVS, DXBlob *fireVSBytecode) {
+
+	fireVSBytecode->release();
+	fireVS->Release();
+	context->Release();
+	device->Release();
+}
+
+
+// Emitter for effect i of the comparison test.  There is no spread and a fixed lifetime so the different random sequences of ParticleEffects and ParticleSystem do not matter
+static ParticleEmitter effectEmitter(const uint32_t i) {
+
+	ParticleEmitter E = fountainEmitter(0.5f + 0.05f * (float)i, 0.5f + 0.05f * (float)i);
+
+	E.positionSpread = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	E.velocitySpread = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	E.velocity = XMFLOAT3(0.1f * (float)i, 4.0f + 0.25f * (float)i, -0.2f * (float)i);
+	E.rate = 30.0f + 17.0f * (float)i;
+
+	return E;
+}
+
+
+// Effects simulated in pooled blocks match a ParticleSystem with the same emitter particle for particle, on one thread and on a thread pool, and finished effects return their blocks and slots
+TEST_CASE(particleEffectsMatchParticleSystem) {
+
+	ID3D11Device *device = nullptr;
+	ID3D11DeviceContext *context = nullptr;
+	ID3D11VertexShader *fireVS = nullptr;
+	DXBlob *fireVSBytecode = nullptr;
+
+	if (!createEffectsDevice(&device, &context, &fireVS, &fireVSBytecode))
+		return;
+
+	const uint32_t numEffects = 24;
+	const float dt = 1.0f / 60.0f;
+
+	ParticleEffects *effects = new ParticleEffects(device, fireVSBytecode, 32, 1024);
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	for (int threaded = 0; threaded < 2; threaded++) {
+
+		uint32_t handles[numEffects];
+		ParticleSystem *systems[numEffects];
+
+		for (uint32_t i = 0; i < numEffects; i++) {
+
+			handles[i] = effects->spawn(effectEmitter(i), i % PARTICLE_EFFECT_MAX_TEXTURES, XMMatrixIdentity());
+
+			systems[i] = new ParticleSystem(4096);
+			systems[i]->setEmitter(effectEmitter(i));
+
+			TEST_CHECK(handles[i] != PARTICLE_EFFECT_INVALID);
+		}
+
+		vector<XMFLOAT4> particles;
+		uint32_t numCountMismatches = 0, numMismatches = 0, numStatsMismatches = 0;
+
+		for (int step = 0; step < 150; step++) {
+
+			effects->update(dt, (threaded) ? pool : nullptr);
+
+			uint32_t numLive = 0, numBlocks = 0;
+
+			for (uint32_t i = 0; i < numEffects; i++) {
+
+				systems[i]->update(dt);
+
+				numLive += systems[i]->particleCount();
+				numBlocks += (systems[i]->particleCount() + PARTICLE_EFFECT_BLOCK_SIZE - 1) / PARTICLE_EFFECT_BLOCK_SIZE;
+
+				effects->readParticles(handles[i], particles);
+
+				if (particles.size() != systems[i]->particleCount()) {
+
+					numCountMismatches++;
+					continue;
+				}
+
+				for (uint32_t j = 0; j < particles.size(); j++) {
+
+					const XMFLOAT4& P = particles[j];
+
+					float error = max(max(fabsf(P.x - systems[i]->getPositionX()[j]), fabsf(P.y - systems[i]->getPositionY()[j])), max(fabsf(P.z - systems[i]->getPositionZ()[j]), fabsf(P.w - systems[i]->getAge()[j])));
+
+					if (error > 1.0e-5f)
+						numMismatches++;
+				}
+			}
+
+			ParticleEffectStats S = effects->getStats();
+
+			if (S.liveParticles != numLive || S.usedBlocks != numBlocks)
+				numStatsMismatches++;
+		}
+
+		TEST_CHECK(numCountMismatches == 0);
+		TEST_CHECK(numMismatches == 0);
+		TEST_CHECK(numStatsMismatches == 0);
+		TEST_CHECK(effects->getStats().droppedParticles == 0);
+
+		// Stopped effects are removed once their last particle has died, returning every block
+		for (uint32_t i = 0; i < numEffects; i++) {
+
+			effects->stop(handles[i]);
+			systems[i]->release();
+		}
+
+		for (int step = 0; step < 120; step++)
+			effects->update(dt, (threaded) ? pool : nullptr);
+
+		uint32_t numAlive = 0;
+
+		for (uint32_t i = 0; i < numEffects; i++)
+			if (effects->isAlive(handles[i]))
+				numAlive++;
+
+		TEST_CHECK(numAlive == 0);
+		TEST_CHECK(effects->getStats().liveEffects == 0);
+		TEST_CHECK(effects->getStats().usedBlocks == 0);
+	}
+
+	pool->release();
+	effects->release();
+
+	releaseEffectsDevice(device, context, fireVS, fireVSBytecode);
+}
+
+
+// Once warmed up, spawning, simulating, uploading, sorting and drawing effects does not touch the heap
+TEST_CASE(particleEffectsSteadyStateAllocationFree) {
+
+#ifndef __GU_DEBUG_MEMORY__
+
+	cout << "  skipped - heap allocations are only counted when __GU_DEBUG_MEMORY__ is defined (Debug)" << endl;
+
+#else
+
+	ID3D11Device *device = nullptr;
+	ID3D11DeviceContext *context = nullptr;
+	ID3D11VertexShader *fireVS = nullptr;
+	DXBlob *fireVSBytecode = nullptr;
+
+	if (!createEffectsDevice(&device, &context, &fireVS, &fireVSBytecode))
+		return;
+
+	ParticleEffects *effects = new ParticleEffects(device, fireVSBytecode, 32, 256);
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	const float dt = 1.0f / 60.0f;
+	XMMATRIX viewMatrix = XMMatrixLookAtLH(XMVectorSet(0.0f, 3.0f, -10.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+	ParticleEmitter E = fountainEmitter(0.4f, 0.9f);
+
+	E.rate = 120.0f;
+
+	context->VSSetShader(fireVS, nullptr, 0);
+
+	// Short lived effects are spawned continuously so slots and blocks are recycled
+	for (int frame = 0; frame < 600; frame++) {
+
+		if (frame == 300)
+			effects->markSteadyState();
+
+		if (frame % 5 == 0)
+			effects->spawn(E, (frame / 5) % PARTICLE_EFFECT_MAX_TEXTURES, XMMatrixTranslation((float)(frame % 7), 0.0f, (float)(frame % 3)), 0.5f);
+
+		effects->update(dt, pool);
+		effects->upload(context, pool);
+		effects->sortByDepth(context, viewMatrix, pool);
+		effects->render(context);
+	}
+
+	TEST_CHECK(effects->getStats().liveEffects > 0);
+	TEST_CHECK(effects->getStats().failedSpawns == 0);
+	TEST_CHECK(effects->getStats().droppedParticles == 0);
+	TEST_CHECK(effects->steadyStateAllocationFree());
+
+	pool->release();
+	effects->release();
+
+	releaseEffectsDevice(device, context, fireVS, fireVSBytecode);
+
+#endif
+}
+
+
+BENCHMARK(particleEffectsUpdate) {
+
+	ID3D11Device *device = nullptr;
+	ID3D11DeviceContext *context = nullptr;
+	ID3D11VertexShader *fireVS = nullptr;
+	DXBlob *fireVSBytecode = nullptr;
+
+	if (!createEffectsDevice(&device, &context, &fireVS, &fireVSBytecode))
+		return;
+
+	GUParallel *pool = GUParallel::CreateThreadPool();
+	const float dt = 1.0f / 60.0f;
+
+	cout << "  " << pool->threadCount() << " threads" << endl;
+
+	for (uint32_t numEffects = 64; numEffects <= 4096; numEffects *= 8) {
+
+		// About 100 particles per effect as for the scene fires
+		ParticleEffects *effects = new ParticleEffects(device, fireVSBytecode, numEffects, numEffects * 3);
+		ParticleEmitter E = fountainEmitter(0.6f, 1.0f);
+
+		E.rate = 125.0f;
+
+		for (uint32_t i = 0; i < numEffects; i++)
+			effects->spawn(E, i % PARTICLE_EFFECT_MAX_TEXTURES, XMMatrixTranslation((float)(i % 64), 0.0f, (float)(i / 64)));
+
+		// Warm up to the steady particle count
+		for (int step = 0; step < 120; step++)
+			effects->update(dt);
+
+		const uint32_t numSteps = 200;
+
+		for (int threaded = 0; threaded < 2; threaded++) {
+
+			TestTimer timer;
+
+			for (uint32_t step = 0; step < numSteps; step++)
+				effects->update(dt, (threaded) ? pool : nullptr);
+
+			double t = timer.seconds();
+
+			if (!threaded)
+				cout << "  " << numEffects << " effects, " << effects->getStats().liveParticles << " particles" << endl;
+
+			test_report((threaded) ? "update (pool, per particle)" : "update (per particle)", (double)effects->getStats().liveParticles * numSteps, t);
+		}
+
+		effects->release();
+	}
+
+	pool->release();
+
+	releaseEffectsDevice(device, context, fireVS, fireVSBytecode);
+}
+
+#pragma endregion
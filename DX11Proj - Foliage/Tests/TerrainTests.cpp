@@ -0,0 +1,852 @@
+
+//
+// TerrainTests.cpp
+//
+
+// Tests and benchmarks for the terrain and grass classes (GrassLOD, TerrainQuadtree and HeightField)
+
+#include <stdafx.h>
+#include <TestHarness.h>
+#include <GrassLOD.h>
+#include <TerrainQuadtree.h>
+#include <HeightField.h>
+#include <DXFrustumCuller.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+using namespace std;
+using namespace DirectX;
+
+
+#pragma region GrassLOD
+
+// Square grid of n x n patches of the given size on the xz plane starting at the origin
+static void patchGrid(vector<DXBoundingVolume>& patches, const uint32_t n, const float size) {
+
+	patches.resize(n * n);
+
+	for (uint32_t z = 0; z < n; z++)
+		for (uint32_t x = 0; x < n; x++)
+			patches[z * n + x] = DXBoundingVolume(XMFLOAT3(((float)x + 0.5f) * size, 0.5f, ((float)z + 0.5f) * size), XMFLOAT3(size * 0.5f, 0.5f, size * 0.5f));
+}
+
+
+// Selection must return exactly the patches in the frustum, with shell counts that fall with distance and never exceed the stack
+TEST_CASE(grassLODSelection) {
+
+	const uint32_t n = 64, maxShells = 40;
+	const float size = 40.0f, shellExtent = 0.5f;
+
+	vector<DXBoundingVolume> patches;
+
+	patchGrid(patches, n, size);
+
+	GrassLOD *grassLOD = new GrassLOD();
+
+	grassLOD->setPatches(patches.data(), (uint32_t)patches.size());
+
+	TEST_CHECK(grassLOD->patchCount() == n * n);
+
+	// Standing inside patch (1, 1) looking across the grid
+	XMVECTOR eye = XMVectorSet(60.0f, 1.7f, 60.0f, 1.0f);
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 1.0f, 0.1f, 4000.0f);
+	XMMATRIX viewProj = XMMatrixLookAtLH(eye, XMVectorSet(1600.0f, 0.0f, 1280.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * proj;
+	float pixelScale = XMVectorGetY(proj.r[1]) * 600.0f * 0.5f;
+
+	vector<GrassPatchLOD> patchLOD;
+
+	uint32_t totalShells = grassLOD->select(viewProj, eye, pixelScale, maxShells, shellExtent, patchLOD);
+
+	// Same patches as the frustum test, in ascending order
+	XMFLOAT4 planes[DX_NUM_FRUSTUM_PLANES];
+
+	DXFrustumCuller::ExtractPlanes(viewProj, planes);
+
+	vector<uint32_t> expected;
+
+	for (uint32_t i = 0; i < patches.size(); i++)
+		if (DXFrustumCuller::BoxVisible(planes, patches[i]))
+			expected.push_back(i);
+
+	TEST_CHECK(patchLOD.size() == expected.size());
+	TEST_CHECK(!patchLOD.empty() && patchLOD.size() < patches.size());
+
+	bool samePatches = (patchLOD.size() == expected.size());
+
+	for (uint32_t i = 0; samePatches && i < patchLOD.size(); i++)
+		samePatches = (patchLOD[i].patch == expected[i]);
+
+	TEST_CHECK(samePatches);
+
+	// Shell counts
+	uint32_t sum = 0, numBadCounts = 0, numBadStrides = 0, numBaseOnly = 0;
+
+	for (uint32_t i = 0; i < patchLOD.size(); i++) {
+
+		const GrassPatchLOD& L = patchLOD[i];
+
+		sum += L.numShells;
+
+		if (L.numShells < 1 || L.numShells > maxShells)
+			numBadCounts++;
+
+		// Drawn shells are the first numShells multiples of the stride and stay inside the stack
+		uint32_t numDrawn = 0;
+
+		for (uint32_t s = 0; s < maxShells; s++)
+			if (L.drawsShell(s))
+				numDrawn++;
+
+		if (!L.drawsShell(0) || numDrawn != L.numShells || (L.numShells - 1) * L.shellStride >= maxShells)
+			numBadStrides++;
+
+		if (L.numShells == 1)
+			numBaseOnly++;
+	}
+
+	TEST_CHECK(sum == totalShells);
+	TEST_CHECK(numBadCounts == 0);
+	TEST_CHECK(numBadStrides == 0);
+
+	// The patch under the camera draws the full stack, distant patches only the base layer, and the total is far below drawing every visible patch in full
+	uint32_t eyePatchShells = 0;
+
+	for (uint32_t i = 0; i < patchLOD.size(); i++)
+		if (patchLOD[i].patch == n + 1)
+			eyePatchShells = patchLOD[i].numShells;
+
+	TEST_CHECK(eyePatchShells == maxShells);
+
+	TEST_CHECK(numBaseOnly > 0);
+	TEST_CHECK(totalShells < patchLOD.size() * maxShells / 2);
+
+	// Shell counts do not increase with distance along the view direction
+	uint32_t numIncreases = 0;
+
+	for (uint32_t d = 1; d < n; d++) {
+
+		uint32_t nearIndex = d * n + d, farIndex = (d + 1 < n) ? (d + 1) * n + (d + 1) : nearIndex;
+		uint32_t nearShells = 0, farShells = 0;
+
+		for (uint32_t i = 0; i < patchLOD.size(); i++) {
+
+			if (patchLOD[i].patch == nearIndex)
+				nearShells = patchLOD[i].numShells;
+
+			if (patchLOD[i].patch == farIndex)
+				farShells = patchLOD[i].numShells;
+		}
+
+		if (nearShells && farShells && farShells > nearShells)
+			numIncreases++;
+	}
+
+	TEST_CHECK(numIncreases == 0);
+
+	// Looking away from the grid selects nothing
+	viewProj = XMMatrixLookAtLH(XMVectorSet(-10.0f, 1.7f, -10.0f, 1.0f), XMVectorSet(-100.0f, 0.0f, -100.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * proj;
+
+	TEST_CHECK(grassLOD->select(viewProj, XMVectorSet(-10.0f, 1.7f, -10.0f, 1.0f), pixelScale, maxShells, shellExtent, patchLOD) == 0);
+	TEST_CHECK(patchLOD.empty());
+
+	grassLOD->release();
+}
+
+
+BENCHMARK(grassLODSelect) {
+
+	const uint32_t maxShells = 40;
+
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 1.0f, 0.1f, 1000.0f);
+	float pixelScale = XMVectorGetY(proj.r[1]) * 600.0f * 0.5f;
+
+	for (uint32_t n = 32; n <= 256; n *= 2) {
+
+		vector<DXBoundingVolume> patches;
+		vector<GrassPatchLOD> patchLOD;
+
+		patchGrid(patches, n, 10.0f);
+
+		GrassLOD *grassLOD = new GrassLOD();
+
+		grassLOD->setPatches(patches.data(), (uint32_t)patches.size());
+
+		XMVECTOR eye = XMVectorSet(15.0f, 1.7f, 15.0f, 1.0f);
+		XMMATRIX viewProj = XMMatrixLookAtLH(eye, XMVectorSet((float)n * 10.0f, 0.0f, (float)n * 8.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * proj;
+
+		uint32_t numRepeats = 4000000 / (n * n), totalShells = 0;
+
+		TestTimer timer;
+
+		for (uint32_t k = 0; k < numRepeats; k++)
+			totalShells = grassLOD->select(viewProj, eye, pixelScale, maxShells, 0.5f, patchLOD);
+
+		double t = timer.seconds();
+
+		cout << "  " << n * n << " patches, " << patchLOD.size() << " visible, " << totalShells << " shells (" << patchLOD.size() * maxShells << " without LOD)" << endl;
+
+		test_report("select (per patch)", (double)n * n * numRepeats, t);
+
+		grassLOD->release();
+	}
+}
+
+#pragma endregion
+
+
+#pragma region TerrainQuadtree
+
+// Area of a selected chunk drawn by one quadrant of the grid mesh, in heightmap quads
+struct TerrainRegion {
+
+	const TerrainChunk					*chunk;
+	uint32_t							x0, x1, z0, z1;
+};
+
+
+// Smooth hills with some high frequency detail so morphing changes the surface
+static void testHeightmap(vector<float>& heights, const uint32_t width, const uint32_t height) {
+
+	heights.resize(width * height);
+
+	for (uint32_t z = 0; z < height; z++) {
+
+		for (uint32_t x = 0; x < width; x++) {
+
+			uint32_t hash = (x * 73856093u) ^ (z * 19349663u);
+
+			hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+
+			heights[z * width + x] = 0.5f + 0.3f * sinf((float)x * 0.031f) * cosf((float)z * 0.023f) + 0.02f * (float)(hash & 0xFFFF) / 65535.0f;
+		}
+	}
+}
+
+
+// Split the selected chunks into the quadrants they draw
+static void terrainRegions(const vector<TerrainChunk>& chunks, vector<TerrainRegion>& regions) {
+
+	regions.clear();
+
+	for (uint32_t i = 0; i < chunks.size(); i++) {
+
+		uint32_t half = (TERRAIN_GRID_DIM << chunks[i].level) / 2;
+
+		for (uint32_t q = 0; q < 4; q++) {
+
+			if (!(chunks[i].quadrantMask & (1 << q)))
+				continue;
+
+			TerrainRegion R = { &chunks[i], chunks[i].x + (q & 1) * half, chunks[i].x + ((q & 1) + 1) * half, chunks[i].z + (q >> 1) * half, chunks[i].z + ((q >> 1) + 1) * half };
+
+			regions.push_back(R);
+		}
+	}
+}
+
+
+// Morphed vertices of region R along its edge at heightmap coordinate edge (x if alongZ, otherwise z) as <position along the edge, height> pairs
+static void regionEdge(const TerrainQuadtree *terrain, const TerrainRegion& R, const bool alongZ, const uint32_t edge, FXMVECTOR eye, vector<XMFLOAT2>& points) {
+
+	const TerrainChunk& C = *R.chunk;
+	uint32_t step = 1 << C.level;
+
+	points.clear();
+
+	uint32_t g = (edge - ((alongZ) ? C.x : C.z)) / step;
+	uint32_t g0 = (((alongZ) ? R.z0 : R.x0) - ((alongZ) ? C.z : C.x)) / step;
+	uint32_t g1 = (((alongZ) ? R.z1 : R.x1) - ((alongZ) ? C.z : C.x)) / step;
+
+	for (uint32_t k = g0; k <= g1; k++) {
+
+		XMFLOAT3 P = (alongZ) ? terrain->morphVertex(C, g, k, eye) : terrain->morphVertex(C, k, g, eye);
+
+		points.push_back(XMFLOAT2((alongZ) ? P.z : P.x, P.y));
+	}
+}
+
+
+// Height of the polyline at position t, or FLT_MAX if t is outside it
+static float polylineHeight(const vector<XMFLOAT2>& points, const float t) {
+
+	for (uint32_t i = 0; i + 1 < points.size(); i++) {
+
+		const XMFLOAT2& a = points[i];
+		const XMFLOAT2& b = points[i + 1];
+
+		if (t < a.x - 1.0e-4f || t > b.x + 1.0e-4f)
+			continue;
+
+		if (b.x - a.x < 1.0e-6f)
+			return a.y;
+
+		return a.y + (b.y - a.y) * min(max((t - a.x) / (b.x - a.x), 0.0f), 1.0f);
+	}
+
+	return FLT_MAX;
+}
+
+
+// Count the vertices of polyline A inside the span of polyline B that do not lie on B
+static uint32_t countEdgeCracks(const vector<XMFLOAT2>& A, const vector<XMFLOAT2>& B, const float tolerance) {
+
+	uint32_t numCracks = 0;
+
+	for (uint32_t i = 0; i < A.size(); i++) {
+
+		if (A[i].x < B.front().x - 1.0e-4f || A[i].x > B.back().x + 1.0e-4f)
+			continue;
+
+		if (fabsf(polylineHeight(B, A[i].x) - A[i].y) > tolerance)
+			numCracks++;
+	}
+
+	return numCracks;
+}
+
+
+// Check the regions selected for a view tile the visible terrain without overlaps, that neighbours differ by at most one level and that the morphed vertices along every shared edge lie on the neighbour's edge so no cracks open between levels
+static void checkTerrainStitching(const TerrainQuadtree *terrain, FXMVECTOR eye, FXMVECTOR target, uint32_t *numLevelsUsed) {
+
+	XMMATRIX viewProj = XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.5f, 0.1f, 5000.0f);
+	XMFLOAT4 planes[DX_NUM_FRUSTUM_PLANES];
+
+	DXFrustumCuller::ExtractPlanes(viewProj, planes);
+
+	vector<TerrainChunk> chunks;
+	vector<TerrainRegion> regions;
+
+	TEST_CHECK(terrain->select(planes, eye, chunks) == chunks.size());
+	TEST_CHECK(!chunks.empty());
+
+	terrainRegions(chunks, regions);
+
+	uint32_t levelMask = 0, numOverlaps = 0, numLevelJumps = 0, numSharedEdges = 0, numCracks = 0;
+	float tolerance = terrain->getHeightScale() * 1.0e-4f;
+
+	vector<XMFLOAT2> edgeA, edgeB;
+
+	for (uint32_t i = 0; i < regions.size(); i++) {
+
+		const TerrainRegion& A = regions[i];
+
+		levelMask |= 1 << A.chunk->level;
+
+		for (uint32_t j = i + 1; j < regions.size(); j++) {
+
+			const TerrainRegion& B = regions[j];
+
+			if (A.x0 < B.x1 && B.x0 < A.x1 && A.z0 < B.z1 && B.z0 < A.z1)
+				numOverlaps++;
+
+			// Shared edge along z (A and B side by side in x) or along x
+			bool alongZ = (A.x1 == B.x0 || B.x1 == A.x0) && A.z0 < B.z1 && B.z0 < A.z1;
+			bool alongX = (A.z1 == B.z0 || B.z1 == A.z0) && A.x0 < B.x1 && B.x0 < A.x1;
+
+			if (!alongZ && !alongX)
+				continue;
+
+			numSharedEdges++;
+
+			if (abs((int)A.chunk->level - (int)B.chunk->level) > 1)
+				numLevelJumps++;
+
+			uint32_t edge = (alongZ) ? ((A.x1 == B.x0) ? A.x1 : A.x0) : ((A.z1 == B.z0) ? A.z1 : A.z0);
+
+			regionEdge(terrain, A, alongZ, edge, eye, edgeA);
+			regionEdge(terrain, B, alongZ, edge, eye, edgeB);
+
+			numCracks += countEdgeCracks(edgeA, edgeB, tolerance) + countEdgeCracks(edgeB, edgeA, tolerance);
+		}
+	}
+
+	for (uint32_t level = 0; level < TERRAIN_MAX_LODS; level++)
+		if (levelMask & (1 << level))
+			(*numLevelsUsed)++;
+
+	TEST_CHECK(numSharedEdges > 0);
+	TEST_CHECK(numOverlaps == 0);
+	TEST_CHECK(numLevelJumps == 0);
+	TEST_CHECK(numCracks == 0);
+}
+
+
+// Selection and morphing across LOD boundaries for several views over the terrain
+TEST_CASE(terrainQuadtreeStitching) {
+
+	const uint32_t mapSize = 512;
+	vector<float> heights;
+
+	testHeightmap(heights, mapSize, mapSize);
+
+	TerrainQuadtree *terrain = new TerrainQuadtree(heights.data(), mapSize, mapSize, XMFLOAT3(-512.0f, 0.0f, -512.0f), XMFLOAT2(1024.0f, 1024.0f), 60.0f, 5);
+
+	TEST_CHECK(terrain->lodCount() == 5);
+
+	// LOD ranges double each level and the morph reaches 1 at the end of each range
+	for (uint32_t level = 0; level + 1 < terrain->lodCount(); level++) {
+
+		TEST_CHECK(terrain->getLODRange(level + 1) > terrain->getLODRange(level));
+		TEST_CHECK_CLOSE(terrain->morphFactor(level, terrain->getLODRange(level)), 1.0f, 1.0e-5f);
+		TEST_CHECK_CLOSE(terrain->morphFactor(level, 0.0f), 0.0f, 1.0e-5f);
+	}
+
+	// Unmorphed vertices lie on the heightmap
+	TerrainChunk C;
+
+	C.x = 64;
+	C.z = 96;
+	C.level = 0;
+	C.quadrantMask = TERRAIN_ALL_QUADRANTS;
+
+	XMFLOAT3 Q = terrain->mapToWorld(67.0f, 101.0f);
+	XMFLOAT3 P = terrain->morphVertex(C, 3, 5, XMLoadFloat3(&Q));
+
+	TEST_CHECK_CLOSE(P.x, Q.x, 1.0e-4f);
+	TEST_CHECK_CLOSE(P.y, Q.y, 1.0e-4f);
+	TEST_CHECK_CLOSE(P.z, Q.z, 1.0e-4f);
+	TEST_CHECK_CLOSE(Q.y, heights[101 * mapSize + 67] * 60.0f, 1.0e-3f);
+
+	uint32_t numLevelsUsed = 0;
+
+	const XMVECTOR eyes[4] = { XMVectorSet(0.0f, 80.0f, 0.0f, 1.0f), XMVectorSet(-400.0f, 40.0f, -300.0f, 1.0f), XMVectorSet(250.0f, 120.0f, 100.0f, 1.0f), XMVectorSet(13.7f, 45.0f, -451.3f, 1.0f) };
+	const XMVECTOR targets[4] = { XMVectorSet(300.0f, 0.0f, 200.0f, 1.0f), XMVectorSet(400.0f, 0.0f, 400.0f, 1.0f), XMVectorSet(-300.0f, 0.0f, -100.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 500.0f, 1.0f) };
+
+	for (int i = 0; i < 4; i++)
+		checkTerrainStitching(terrain, eyes[i], targets[i], &numLevelsUsed);
+
+	// The views must exercise transitions between several levels
+	TEST_CHECK(numLevelsUsed >= 4 * 3);
+
+	terrain->release();
+}
+
+
+BENCHMARK(terrainQuadtreeSelect) {
+
+	for (uint32_t mapSize = 512; mapSize <= 2048; mapSize *= 2) {
+
+		vector<float> heights;
+
+		testHeightmap(heights, mapSize, mapSize);
+
+		float size = (float)mapSize * 2.0f;
+		uint32_t numLODs = (mapSize == 512) ? 5 : (mapSize == 1024) ? 6 : 7;
+
+		TerrainQuadtree *terrain = new TerrainQuadtree(heights.data(), mapSize, mapSize, XMFLOAT3(-size * 0.5f, 0.0f, -size * 0.5f), XMFLOAT2(size, size), 60.0f, numLODs);
+
+		XMVECTOR eye = XMVectorSet(0.0f, 80.0f, 0.0f, 1.0f);
+		XMFLOAT4 planes[DX_NUM_FRUSTUM_PLANES];
+
+		DXFrustumCuller::ExtractPlanes(XMMatrixLookAtLH(eye, XMVectorSet(size, 0.0f, size * 0.6f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * XMMatrixPerspectiveFovLH(XM_PIDIV4, 1.5f, 0.1f, size * 2.0f), planes);
+
+		vector<TerrainChunk> chunks;
+		const uint32_t numRepeats = 10000;
+
+		TestTimer timer;
+
+		for (uint32_t k = 0; k < numRepeats; k++)
+			terrain->select(planes, eye, chunks);
+
+		double t = timer.seconds();
+
+		cout << "  " << mapSize << "x" << mapSize << " heightmap, " << numLODs << " levels, " << chunks.size() << " chunks" << endl;
+
+		test_report("select (per frame)", numRepeats, t);
+
+		terrain->release();
+	}
+}
+
+#pragma endregion
+
+
+
+#pragma region HeightField
+
+#define HEIGHTMAP_PATH "Resources\\Textures\\heightmap.bmp"
+
+// Random values in [0, 1] for a width x height heightfield
+static void randomHeightValues(vector<float>& values, const uint32_t width, const uint32_t height, const uint32_t seed) {
+
+	TestRandom R(seed);
+
+	values.resize(width * height);
+
+	for (uint32_t i = 0; i < values.size(); i++)
+		values[i] = R.uniform(0.0f, 1.0f);
+}
+
+
+// Random world-space query points over the heightfield, including some outside it to exercise the clamping
+static void randomQueryPoints(const HeightField *field, vector<float>& x, vector<float>& z, const uint32_t count, const uint32_t seed) {
+
+	TestRandom R(seed);
+	XMFLOAT3 origin = field->getOrigin();
+	XMFLOAT2 size = field->getSize();
+
+	x.resize(count);
+	z.resize(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		x[i] = origin.x + R.uniform(-0.05f, 1.05f) * size.x;
+		z[i] = origin.z + R.uniform(-0.05f, 1.05f) * size.y;
+	}
+}
+
+
+// Nearest hit of the ray with every triangle of the heightfield's cells, in double precision.  The cells are split along the diagonal from (cx + 1, cz) to (cx, cz + 1) as in the terrain mesh
+static bool bruteForceRaycast(const HeightField *field, const XMFLOAT3& O, const XMFLOAT3& D, const float maxDist, double *tHit) {
+
+	const vector<float>& values = field->getValues();
+	uint32_t width = field->getMapWidth(), height = field->getMapHeight();
+	XMFLOAT3 origin = field->getOrigin();
+	XMFLOAT2 quad = field->getQuadSize();
+	double scale = field->getHeightScale();
+
+	double best = DBL_MAX;
+
+	for (uint32_t cz = 0; cz + 1 < height; cz++) {
+
+		for (uint32_t cx = 0; cx + 1 < width; cx++) {
+
+			double V[4][3];
+
+			for (uint32_t k = 0; k < 4; k++) {
+
+				uint32_t x = cx + (k & 1), z = cz + (k >> 1);
+
+				V[k][0] = origin.x + (double)x * quad.x;
+				V[k][1] = origin.y + values[z * width + x] * scale;
+				V[k][2] = origin.z + (double)z * quad.y;
+			}
+
+			const uint32_t triangles[2][3] = { { 0, 2, 1 }, { 1, 2, 3 } };
+
+			for (uint32_t tri = 0; tri < 2; tri++) {
+
+				const double *A = V[triangles[tri][0]], *B = V[triangles[tri][1]], *C = V[triangles[tri][2]];
+
+				double e1[3] = { B[0] - A[0], B[1] - A[1], B[2] - A[2] };
+				double e2[3] = { C[0] - A[0], C[1] - A[1], C[2] - A[2] };
+				double P[3] = { D.y * e2[2] - D.z * e2[1], D.z * e2[0] - D.x * e2[2], D.x * e2[1] - D.y * e2[0] };
+				double det = e1[0] * P[0] + e1[1] * P[1] + e1[2] * P[2];
+
+				if (fabs(det) < 1e-15)
+					continue;
+
+				double T[3] = { O.x - A[0], O.y - A[1], O.z - A[2] };
+				double u = (T[0] * P[0] + T[1] * P[1] + T[2] * P[2]) / det;
+				double Q[3] = { T[1] * e1[2] - T[2] * e1[1], T[2] * e1[0] - T[0] * e1[2], T[0] * e1[1] - T[1] * e1[0] };
+				double v = (D.x * Q[0] + D.y * Q[1] + D.z * Q[2]) / det;
+				double t = (e2[0] * Q[0] + e2[1] * Q[1] + e2[2] * Q[2]) / det;
+
+				if (u >= 0.0 && v >= 0.0 && u + v <= 1.0 && t >= 0.0 && t <= maxDist && t < best)
+					best = t;
+			}
+		}
+	}
+
+	*tHit = best;
+
+	return best != DBL_MAX;
+}
+
+
+// Batched heights() and normals() match height() and normal() for point counts that are and are not a multiple of four.  The bicubic surface passes through the samples, its analytic normal matches its finite differences, and both surfaces reproduce a plane
+TEST_CASE(heightFieldBatchedQueries) {
+
+	vector<float> values;
+
+	randomHeightValues(values, 61, 47, 5);
+
+	HeightField *field = new HeightField(values.data(), 61, 47, XMFLOAT3(-30.0f, -2.0f, 10.0f), XMFLOAT2(61.0f * 0.75f, 47.0f * 1.25f), 4.0f);
+
+	TEST_CHECK(field->getMapWidth() == 61 && field->getMapHeight() == 47);
+	TEST_CHECK(field->getMinHeight() >= -2.0f && field->getMaxHeight() <= 2.0f && field->getMinHeight() < field->getMaxHeight());
+
+	const uint32_t counts[] = { 0, 1, 3, 4, 7, 1003 };
+	uint32_t numHeightErrors = 0, numNormalErrors = 0;
+
+	for (uint32_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+
+		uint32_t n = counts[c];
+		vector<float> x, z;
+
+		randomQueryPoints(field, x, z, n, n + 1);
+
+		// Guard values after the outputs catch writes past the end
+		vector<float> heights(n + 4, -1000.0f);
+		vector<XMFLOAT3> normals(n + 4, XMFLOAT3(-1000.0f, -1000.0f, -1000.0f));
+
+		field->heights(x.data(), z.data(), heights.data(), n);
+		field->normals(x.data(), z.data(), normals.data(), n);
+
+		for (uint32_t i = 0; i < n; i++) {
+
+			if (fabsf(heights[i] - field->height(x[i], z[i])) > 1e-5f)
+				numHeightErrors++;
+
+			XMVECTOR N = field->normal(x[i], z[i]);
+
+			if (XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&normals[i]), N))) > 1e-5f)
+				numNormalErrors++;
+		}
+
+		for (uint32_t i = n; i < n + 4; i++)
+			if (heights[i] != -1000.0f || normals[i].x != -1000.0f)
+				numHeightErrors++;
+	}
+
+	TEST_CHECK(numHeightErrors == 0);
+	TEST_CHECK(numNormalErrors == 0);
+
+	// Both surfaces pass through the samples
+	XMFLOAT3 origin = field->getOrigin();
+	XMFLOAT2 quad = field->getQuadSize();
+	uint32_t numSampleErrors = 0;
+
+	for (uint32_t j = 0; j < 47; j++) {
+
+		for (uint32_t i = 0; i < 61; i++) {
+
+			float x = origin.x + i * quad.x, z = origin.z + j * quad.y;
+			float h = origin.y + values[j * 61 + i] * 4.0f;
+
+			if (fabsf(field->height(x, z) - h) > 1e-4f || fabsf(field->heightBicubic(x, z) - h) > 1e-4f)
+				numSampleErrors++;
+		}
+	}
+
+	TEST_CHECK(numSampleErrors == 0);
+
+	// The bicubic normal is perpendicular to the central differences of the bicubic heights
+	vector<float> x, z;
+	uint32_t numBicubicErrors = 0;
+
+	randomQueryPoints(field, x, z, 500, 99);
+
+	for (uint32_t i = 0; i < x.size(); i++) {
+
+		// Keep the differences inside the heightmap, away from the clamped border
+		float px = min(max(x[i], origin.x + 2.0f * quad.x), origin.x + 58.0f * quad.x);
+		float pz = min(max(z[i], origin.z + 2.0f * quad.y), origin.z + 44.0f * quad.y);
+		float e = 1e-3f;
+
+		float dhdx = (field->heightBicubic(px + e, pz) - field->heightBicubic(px - e, pz)) / (2.0f * e);
+		float dhdz = (field->heightBicubic(px, pz + e) - field->heightBicubic(px, pz - e)) / (2.0f * e);
+
+		XMVECTOR expected = XMVector3Normalize(XMVectorSet(-dhdx, 1.0f, -dhdz, 0.0f));
+
+		if (XMVectorGetX(XMVector3Length(XMVectorSubtract(field->normalBicubic(px, pz), expected))) > 2e-3f)
+			numBicubicErrors++;
+	}
+
+	TEST_CHECK(numBicubicErrors == 0);
+
+	field->release();
+
+	// A plane h = 0.2 + 0.01 x + 0.005 z (in samples) is reproduced by both interpolants and the normals away from the border
+	vector<float> plane(40 * 30);
+
+	for (uint32_t j = 0; j < 30; j++)
+		for (uint32_t i = 0; i < 40; i++)
+			plane[j * 40 + i] = 0.2f + 0.01f * i + 0.005f * j;
+
+	HeightField *planeField = new HeightField(plane.data(), 40, 30, XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT2(40.0f * 2.0f, 30.0f * 0.5f), 3.0f);
+
+	XMVECTOR planeNormal = XMVector3Normalize(XMVectorSet(-0.01f * 3.0f / 2.0f, 1.0f, -0.005f * 3.0f / 0.5f, 0.0f));
+	uint32_t numPlaneErrors = 0;
+	TestRandom R(17);
+
+	for (uint32_t k = 0; k < 1000; k++) {
+
+		float qx = R.uniform(2.0f, 37.0f), qz = R.uniform(2.0f, 27.0f);
+		float x = qx * 2.0f, z = qz * 0.5f;
+		float h = 1.0f + (0.2f + 0.01f * qx + 0.005f * qz) * 3.0f;
+
+		if (fabsf(planeField->height(x, z) - h) > 1e-4f || fabsf(planeField->heightBicubic(x, z) - h) > 1e-4f)
+			numPlaneErrors++;
+
+		if (XMVectorGetX(XMVector3Length(XMVectorSubtract(planeField->normal(x, z), planeNormal))) > 1e-4f || XMVectorGetX(XMVector3Length(XMVectorSubtract(planeField->normalBicubic(x, z), planeNormal))) > 1e-4f)
+			numPlaneErrors++;
+	}
+
+	TEST_CHECK(numPlaneErrors == 0);
+
+	planeField->release();
+}
+
+
+// raycast() finds the same nearest hit as testing the ray against every triangle of the surface
+TEST_CASE(heightFieldRaycast) {
+
+	vector<float> values;
+
+	randomHeightValues(values, 33, 29, 11);
+
+	HeightField *field = new HeightField(values.data(), 33, 29, XMFLOAT3(-10.0f, 0.5f, -5.0f), XMFLOAT2(33.0f * 0.6f, 29.0f * 0.9f), 3.0f);
+
+	XMFLOAT3 origin = field->getOrigin();
+	XMFLOAT2 size = field->getSize();
+	TestRandom R(23);
+
+	uint32_t numHits = 0, numMisses = 0, numMismatches = 0;
+
+	for (uint32_t k = 0; k < 3000; k++) {
+
+		// Rays from above and around the surface, mostly pointing down, some grazing and some pointing up
+		XMFLOAT3 O(origin.x + R.uniform(-0.3f, 1.3f) * size.x, origin.y + R.uniform(-0.5f, 6.0f), origin.z + R.uniform(-0.3f, 1.3f) * size.y);
+		XMFLOAT3 target(origin.x + R.uniform(0.0f, 1.0f) * size.x, origin.y + R.uniform(-1.0f, 4.0f), origin.z + R.uniform(0.0f, 1.0f) * size.y);
+
+		XMVECTOR D = XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&target), XMLoadFloat3(&O)));
+		XMFLOAT3 dir;
+
+		XMStoreFloat3(&dir, D);
+
+		float maxDist = (k % 4 == 0) ? R.uniform(1.0f, 20.0f) : 1000.0f;
+		float t = 0.0f;
+		double tRef = 0.0;
+
+		bool hit = field->raycast(XMLoadFloat3(&O), D, maxDist, &t);
+		bool hitRef = bruteForceRaycast(field, O, dir, maxDist, &tRef);
+
+		if (hit != hitRef || (hit && fabs(t - tRef) > 1e-3 * (1.0 + tRef)))
+			numMismatches++;
+
+		if (hitRef)
+			numHits++;
+		else
+			numMisses++;
+	}
+
+	TEST_CHECK(numMismatches == 0);
+
+	// Both outcomes must be exercised
+	TEST_CHECK(numHits > 500 && numMisses > 500);
+
+	field->release();
+}
+
+
+// Every point of the occluder mesh lies on or below the surface of the heightmap
+TEST_CASE(heightFieldOccluderMesh) {
+
+	HeightField *field = new HeightField(string(HEIGHTMAP_PATH), XMFLOAT3(-25.0f, 0.0f, -25.0f), XMFLOAT2(50.0f, 50.0f), 2.5f);
+
+	TEST_CHECK(field->getMapWidth() > 1 && field->getMapHeight() > 1);
+
+	const uint32_t resolutions[] = { 1, 7, 16, 64 };
+
+	for (uint32_t r = 0; r < sizeof(resolutions) / sizeof(resolutions[0]); r++) {
+
+		uint32_t n = resolutions[r];
+		vector<XMFLOAT3> positions;
+		vector<uint32_t> indices;
+
+		field->buildOccluderMesh(n, positions, indices);
+
+		TEST_CHECK(positions.size() == (n + 1) * (n + 1) && indices.size() == n * n * 6);
+
+		uint32_t numAbove = 0;
+
+		// Vertices, edge midpoints and an interior point of each triangle
+		const float barycentrics[7][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 0.5f, 0.5f, 0 }, { 0, 0.5f, 0.5f }, { 0.5f, 0, 0.5f }, { 0.2f, 0.3f, 0.5f } };
+
+		for (uint32_t i = 0; i + 2 < indices.size(); i += 3) {
+
+			const XMFLOAT3& A = positions[indices[i]];
+			const XMFLOAT3& B = positions[indices[i + 1]];
+			const XMFLOAT3& C = positions[indices[i + 2]];
+
+			for (uint32_t k = 0; k < 7; k++) {
+
+				const float *w = barycentrics[k];
+
+				float x = w[0] * A.x + w[1] * B.x + w[2] * C.x;
+				float y = w[0] * A.y + w[1] * B.y + w[2] * C.y;
+				float z = w[0] * A.z + w[1] * B.z + w[2] * C.z;
+
+				if (y > field->height(x, z) + 1e-4f)
+					numAbove++;
+			}
+		}
+
+		TEST_CHECK(numAbove == 0);
+	}
+
+	field->release();
+}
+
+
+// Bulk height and normal queries on heightmap.bmp, batched against the per-point scalar queries, with bicubic and raycast costs for comparison.  CGTerrain is only available as a prebuilt Windows DLL so the scalar queries are the baseline
+BENCHMARK(heightFieldQueries) {
+
+	HeightField *field = new HeightField(string(HEIGHTMAP_PATH), XMFLOAT3(-25.0f, 0.0f, -25.0f), XMFLOAT2(50.0f, 50.0f), 2.5f);
+
+	const uint32_t numPoints = 1 << 20;
+
+	vector<float> x, z, heights(numPoints);
+	vector<XMFLOAT3> normals(numPoints);
+
+	randomQueryPoints(field, x, z, numPoints, 3);
+
+	cout << "  " << field->getMapWidth() << "x" << field->getMapHeight() << " heightmap" << endl;
+
+	TestTimer timer;
+
+	for (uint32_t i = 0; i < numPoints; i++)
+		heights[i] = field->height(x[i], z[i]);
+
+	test_report("height (per point)", numPoints, timer.seconds());
+
+	timer.reset();
+	field->heights(x.data(), z.data(), heights.data(), numPoints);
+	test_report("heights (batched)", numPoints, timer.seconds());
+
+	timer.reset();
+
+	for (uint32_t i = 0; i < numPoints; i++)
+		XMStoreFloat3(&normals[i], field->normal(x[i], z[i]));
+
+	test_report("normal (per point)", numPoints, timer.seconds());
+
+	timer.reset();
+	field->normals(x.data(), z.data(), normals.data(), numPoints);
+	test_report("normals (batched)", numPoints, timer.seconds());
+
+	timer.reset();
+
+	for (uint32_t i = 0; i < numPoints; i++)
+		heights[i] = field->heightBicubic(x[i], z[i]);
+
+	test_report("heightBicubic (per point)", numPoints, timer.seconds());
+
+	// Rays from a camera height towards random points on the ground
+	const uint32_t numRays = 100000;
+	uint32_t numHits = 0;
+
+	timer.reset();
+
+	for (uint32_t i = 0; i < numRays; i++) {
+
+		XMVECTOR O = XMVectorSet(x[i] * 0.5f, 4.0f, z[i] * 0.5f, 1.0f);
+		XMVECTOR D = XMVector3Normalize(XMVectorSubtract(XMVectorSet(x[i + numRays], 0.0f, z[i + numRays], 1.0f), O));
+		float t;
+
+		if (field->raycast(O, D, 100.0f, &t))
+			numHits++;
+	}
+
+	test_report("raycast", numRays, timer.seconds());
+
+	cout << "  " << numHits << " of " << numRays << " rays hit" << endl;
+
+	field->release();
+}
+
+#pragma endregion
@@ -0,0 +1,80 @@
+
+//
+// TestHarness.h
+//
+
+// Minimal test and benchmark harness for the headless DX11Tests console project.  Tests and benchmarks are free functions registered by the TEST_CASE and BENCHMARK macros during static initialisation and run by TestMain.cpp.  A failed TEST_CHECK is logged and counted but the test carries on, so a single run reports every failed check.  Benchmarks only run when --bench is given because their timings are only meaningful in Release builds.
+
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+
+
+typedef void (*TestFunction)();
+
+
+// Register a test (or benchmark if benchmark is true).  Called by the TEST_CASE / BENCHMARK macros.  The return value is unused
+int test_register(const char *name, TestFunction fn, const bool benchmark);
+
+// Record the result of a check.  Failed checks are logged with their expression and location
+void test_check(const bool passed, const char *expr, const char *file, const int line);
+
+// Check |a - b| <= tolerance
+void test_check_close(const double a, const double b, const double tolerance, const char *expr, const char *file, const int line);
+
+// Log a benchmark result as total time, time per item and items per millisecond
+void test_report(const char *label, const double numItems, const double seconds);
+
+
+#define TEST_CASE(name)						static void name(); static int name##_id = test_register(#name, name, false); static void name()
+#define BENCHMARK(name)						static void name(); static int name##_id = test_register(#name, name, true); static void name()
+
+#define TEST_CHECK(cond)					test_check((cond) ? true : false, #cond, __FILE__, __LINE__)
+#define TEST_CHECK_CLOSE(a, b, tolerance)	test_check_close((double)(a), (double)(b), (double)(tolerance), #a " == " #b, __FILE__, __LINE__)
+
+
+// High resolution timer for benchmarks
+class TestTimer {
+
+	LARGE_INTEGER						startTime;
+
+public:
+
+	TestTimer() { reset(); }
+
+	void reset() { QueryPerformanceCounter(&startTime); }
+
+	double seconds() const {
+
+		LARGE_INTEGER t, frequency;
+
+		QueryPerformanceCounter(&t);
+		QueryPerformanceFrequency(&frequency);
+
+		return (double)(t.QuadPart - startTime.QuadPart) / (double)frequency.QuadPart;
+	}
+};
+
+
+// Simple deterministic random number generator (xorshift) so tests and benchmarks see the same data on every run
+class TestRandom {
+
+	uint32_t							state;
+
+public:
+
+	TestRandom(const uint32_t seed = 0x9E3779B9) : state((seed) ? seed : 1) {}
+
+	uint32_t next() {
+
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		return state;
+	}
+
+	// Uniform in [lo, hi)
+	float uniform(const float lo, const float hi) { return lo + (hi - lo) * (float)(next() >> 8) * (1.0f / 16777216.0f); }
+};
@@ -0,0 +1,118 @@
+
+//
+// TestMain.cpp
+//
+
+// Entry point of the DX11Tests console project.  Usage: DX11Tests [--bench] [name]  Runs every registered test, or every benchmark with --bench, whose name contains name.  Returns 0 if every check passed
+
+#include <stdafx.h>
+#include <TestHarness.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+
+
+struct TestEntry {
+
+	const char				*name;
+	TestFunction			fn;
+	bool					benchmark;
+};
+
+// Function-local so registration from other translation units does not depend on static initialisation order
+static vector<TestEntry>& testEntries() {
+
+	static vector<TestEntry> entries;
+
+	return entries;
+}
+
+static uint32_t numChecks = 0;
+static uint32_t numFailures = 0;
+
+
+int test_register(const char *name, TestFunction fn, const bool benchmark) {
+
+	TestEntry entry = { name, fn, benchmark };
+
+	testEntries().push_back(entry);
+
+	return (int)testEntries().size();
+}
+
+
+void test_check(const bool passed, const char *expr, const char *file, const int line) {
+
+	numChecks++;
+
+	if (!passed) {
+
+		numFailures++;
+		cout << "  FAILED: " << expr << " (" << file << ":" << line << ")" << endl;
+	}
+}
+
+
+void test_check_close(const double a, const double b, const double tolerance, const char *expr, const char *file, const int line) {
+
+	numChecks++;
+
+	if (!(fabs(a - b) <= tolerance)) {
+
+		numFailures++;
+		cout << "  FAILED: " << expr << " (" << a << " vs " << b << ", tolerance " << tolerance << ") (" << file << ":" << line << ")" << endl;
+	}
+}
+
+
+void test_report(const char *label, const double numItems, const double seconds) {
+
+	cout << "  " << left << setw(40) << label << right << fixed << setprecision(3) << setw(12) << seconds * 1000.0 << " ms" << setw(12) << seconds * 1.0e9 / numItems << " ns/item" << setw(14) << setprecision(1) << numItems / (seconds * 1000.0) << " items/ms" << endl;
+
+	cout.unsetf(ios::fixed);
+	cout << setprecision(6);
+}
+
+
+int main(int argc, char *argv[]) {
+
+	bool runBenchmarks = false;
+	const char *filter = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+
+		if (strcmp(argv[i], "--bench") == 0)
+			runBenchmarks = true;
+		else
+			filter = argv[i];
+	}
+
+	uint32_t numRun = 0;
+
+	for (uint32_t i = 0; i < testEntries().size(); i++) {
+
+		const TestEntry& T = testEntries()[i];
+
+		if (T.benchmark != runBenchmarks || (filter && !strstr(T.name, filter)))
+			continue;
+
+		uint32_t failuresBefore = numFailures;
+
+		cout << T.name << endl;
+
+		T.fn();
+
+		if (numFailures != failuresBefore)
+			cout << "  " << (numFailures - failuresBefore) << " check(s) failed" << endl;
+
+		numRun++;
+	}
+
+	cout << endl << numRun << ((runBenchmarks) ? " benchmarks, " : " tests, ") << numChecks << " checks, " << numFailures << " failures" << endl;
+
+	return (numFailures == 0) ? 0 : 1;
+}
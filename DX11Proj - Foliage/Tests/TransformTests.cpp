@@ -0,0 +1,690 @@
+
+//
+// TransformTests.cpp
+//
+
+// Tests and benchmarks for the batched instance transforms (DXTransformBatch), the cached single transform (DXTransform) and the transform hierarchy (DXSceneGraph)
+
+#include <stdafx.h>
+#include <TestHarness.h>
+#include <DXTransformBatch.h>
+#include <DXTransform.h>
+#include <DXSceneGraph.h>
+#include <GUParallel.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace DirectX;
+using namespace CoreStructures;
+
+
+#pragma region DXTransformBatch
+
+// Instance transform with the layout of worldTransformStruct followed by a guard that compose must not write
+struct TransformRecord {
+
+	XMFLOAT4X4							world;
+	XMFLOAT4X4							normal;
+	float								guard[4];
+};
+
+
+// Random non-zero scales (some negative), unnormalised quaternions and translations
+static void randomTransforms(vector<XMFLOAT3>& S, vector<XMFLOAT4>& q, vector<XMFLOAT3>& T, const uint32_t count, const uint32_t seed) {
+
+	TestRandom R(seed);
+
+	S.resize(count);
+	q.resize(count);
+	T.resize(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		float sign = (R.next() % 8 == 0) ? -1.0f : 1.0f;
+
+		S[i] = XMFLOAT3(sign * R.uniform(0.2f, 4.0f), R.uniform(0.2f, 4.0f), R.uniform(0.2f, 4.0f));
+		q[i] = XMFLOAT4(R.uniform(-1.0f, 1.0f), R.uniform(-1.0f, 1.0f), R.uniform(-1.0f, 1.0f), R.uniform(0.1f, 1.0f));
+		T[i] = XMFLOAT3(R.uniform(-1000.0f, 1000.0f), R.uniform(-10.0f, 100.0f), R.uniform(-1000.0f, 1000.0f));
+	}
+}
+
+
+// World and normal matrices of one instance in double precision.  The normal matrix is found from a cofactor inverse of the upper 3x3 block of W rather than from the rotation and scale so it checks the S^-1 R T^-T form used by compose
+static void referenceCompose(const XMFLOAT3& S, const XMFLOAT4& q, const XMFLOAT3& T, XMFLOAT4X4& world, XMFLOAT4X4& normal) {
+
+	double l = sqrt((double)q.x * q.x + (double)q.y * q.y + (double)q.z * q.z + (double)q.w * q.w);
+	double x = q.x / l, y = q.y / l, z = q.z / l, w = q.w / l;
+	double s[3] = { S.x, S.y, S.z }, t[3] = { T.x, T.y, T.z };
+
+	// Rows of R as XMMatrixRotationQuaternion, scaled by S
+	double A[3][3] = {
+		{ 1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y + w * z), 2.0 * (x * z - w * y) },
+		{ 2.0 * (x * y - w * z), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z + w * x) },
+		{ 2.0 * (x * z + w * y), 2.0 * (y * z - w * x), 1.0 - 2.0 * (x * x + y * y) } };
+
+	for (int r = 0; r < 3; r++)
+		for (int c = 0; c < 3; c++)
+			A[r][c] *= s[r];
+
+	// W^-1 = [A^-1 0; -t A^-1 1]
+	double det = A[0][0] * (A[1][1] * A[2][2] - A[1][2] * A[2][1]) - A[0][1] * (A[1][0] * A[2][2] - A[1][2] * A[2][0]) + A[0][2] * (A[1][0] * A[2][1] - A[1][1] * A[2][0]);
+	double B[3][3];
+
+	for (int r = 0; r < 3; r++)
+		for (int c = 0; c < 3; c++)
+			B[r][c] = (A[(c + 1) % 3][(r + 1) % 3] * A[(c + 2) % 3][(r + 2) % 3] - A[(c + 1) % 3][(r + 2) % 3] * A[(c + 2) % 3][(r + 1) % 3]) / det;
+
+	for (int r = 0; r < 4; r++) {
+
+		for (int c = 0; c < 4; c++) {
+
+			world.m[r][c] = (float)((r < 3) ? ((c < 3) ? A[r][c] : 0.0) : ((c < 3) ? t[c] : 1.0));
+
+			// Transpose of W^-1
+			double inverse = 0.0;
+
+			if (c < 3)
+				inverse = (r < 3) ? B[c][r] : 0.0;
+			else if (r < 3)
+				inverse = -(t[0] * B[0][r] + t[1] * B[1][r] + t[2] * B[2][r]);
+			else
+				inverse = 1.0;
+
+			normal.m[r][c] = (float)inverse;
+		}
+	}
+}
+
+
+// Largest element difference of two matrices relative to the larger of 1 and the largest element of B.  The translation column of a normal matrix is a dot product of the translation that cancels, so its error is bounded relative to the matrix rather than the element
+static float matrixError(const XMFLOAT4X4& A, const XMFLOAT4X4& B) {
+
+	float e = 0.0f, scale = 1.0f;
+
+	for (int i = 0; i < 4; i++) {
+
+		for (int j = 0; j < 4; j++) {
+
+			e = max(e, fabsf(A.m[i][j] - B.m[i][j]));
+			scale = max(scale, fabsf(B.m[i][j]));
+		}
+	}
+
+	return e / scale;
+}
+
+
+// Compose batches with counts either side of the lane width and the parallel block size.  World and normal matrices match the DirectXMath reference, the stride is respected, nothing past the last instance is written and a thread pool gives the serial result
+TEST_CASE(transformBatchMatchesReference) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool(4);
+
+	const uint32_t counts[] = { 0, 1, 3, 4, 5, 7, 8, 9, 17, 100, DX_TRANSFORM_MIN_BLOCK + 1, 3 * DX_TRANSFORM_MIN_BLOCK + 5 };
+
+	for (uint32_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+
+		uint32_t count = counts[k];
+
+		vector<XMFLOAT3> S, T;
+		vector<XMFLOAT4> q;
+
+		randomTransforms(S, q, T, count, count + 1);
+
+		// Grow from the smallest capacity so reserve copies the arrays
+		DXTransformBatch *batch = new DXTransformBatch(1);
+
+		uint32_t numWrongIndices = 0;
+
+		for (uint32_t i = 0; i < count; i++)
+			numWrongIndices += (batch->addTransform(S[i], q[i], T[i]) != i) ? 1 : 0;
+
+		TEST_CHECK(numWrongIndices == 0 && batch->transformCount() == count);
+
+		// One extra record past the end checks the padding lanes are not written
+		vector<TransformRecord> serial(count + 1), pooled(count + 1);
+
+		memset(serial.data(), 0xCD, serial.size() * sizeof(TransformRecord));
+		memset(pooled.data(), 0xCD, pooled.size() * sizeof(TransformRecord));
+
+		batch->compose(&serial[0].world, &serial[0].normal, sizeof(TransformRecord));
+		batch->compose(&pooled[0].world, &pooled[0].normal, sizeof(TransformRecord), pool);
+
+		TEST_CHECK(memcmp(serial.data(), pooled.data(), serial.size() * sizeof(TransformRecord)) == 0);
+
+		float worldError = 0.0f, normalError = 0.0f;
+		uint32_t numGuardsWritten = 0;
+
+		for (uint32_t i = 0; i < count; i++) {
+
+			XMFLOAT4X4 world, normal;
+
+			referenceCompose(S[i], q[i], T[i], world, normal);
+
+			worldError = max(worldError, matrixError(serial[i].world, world));
+			normalError = max(normalError, matrixError(serial[i].normal, normal));
+		}
+
+		const unsigned char *end = (const unsigned char*)&serial[count];
+
+		for (uint32_t i = 0; i < count; i++) {
+
+			const unsigned char *guard = (const unsigned char*)serial[i].guard;
+
+			for (uint32_t b = 0; b < sizeof(serial[i].guard); b++)
+				numGuardsWritten += (guard[b] != 0xCD) ? 1 : 0;
+		}
+
+		for (uint32_t b = 0; b < sizeof(TransformRecord); b++)
+			numGuardsWritten += (end[b] != 0xCD) ? 1 : 0;
+
+		TEST_CHECK(worldError < 1.0e-5f);
+		TEST_CHECK(normalError < 1.0e-5f);
+		TEST_CHECK(numGuardsWritten == 0);
+
+		// World matrices alone into a packed array
+		vector<XMFLOAT4X4> packed(count + 1);
+
+		if (count > 0) {
+
+			batch->compose(packed.data(), nullptr);
+
+			bool same = true;
+
+			for (uint32_t i = 0; i < count; i++)
+				same = same && memcmp(&packed[i], &serial[i].world, sizeof(XMFLOAT4X4)) == 0;
+
+			TEST_CHECK(same);
+		}
+
+		batch->release();
+	}
+
+	pool->release();
+}
+
+
+// setTransform and setTranslation update single instances, clear restores the identity padding and reserve keeps existing transforms
+TEST_CASE(transformBatchUpdates) {
+
+	vector<XMFLOAT3> S, T;
+	vector<XMFLOAT4> q;
+
+	randomTransforms(S, q, T, 21, 3);
+
+	DXTransformBatch *batch = new DXTransformBatch();
+
+	for (uint32_t i = 0; i < 20; i++)
+		batch->addTransform(S[i], q[i], T[i]);
+
+	batch->setTransform(5, S[20], q[20], T[20]);
+	batch->setTranslation(6, T[20]);
+	batch->reserve(1000);
+
+	vector<XMFLOAT4X4> world(20), normal(20);
+	XMFLOAT4X4 W, N;
+
+	batch->compose(world.data(), normal.data());
+
+	referenceCompose(S[20], q[20], T[20], W, N);
+	TEST_CHECK(matrixError(world[5], W) < 1.0e-5f && matrixError(normal[5], N) < 1.0e-5f);
+
+	referenceCompose(S[6], q[6], T[20], W, N);
+	TEST_CHECK(matrixError(world[6], W) < 1.0e-5f && matrixError(normal[6], N) < 1.0e-5f);
+
+	referenceCompose(S[19], q[19], T[19], W, N);
+	TEST_CHECK(matrixError(world[19], W) < 1.0e-5f && matrixError(normal[19], N) < 1.0e-5f);
+
+	// After clear the padding lanes are identities again so a single new transform composes correctly
+	batch->clear();
+
+	TEST_CHECK(batch->transformCount() == 0);
+	TEST_CHECK(batch->addTransform(S[0], q[0], T[0]) == 0);
+
+	batch->compose(world.data(), normal.data());
+
+	referenceCompose(S[0], q[0], T[0], W, N);
+	TEST_CHECK(matrixError(world[0], W) < 1.0e-5f && matrixError(normal[0], N) < 1.0e-5f);
+
+	batch->release();
+}
+
+
+// The static point, normal and vector transforms match DirectXMath for counts either side of the lane width, in place and out of place
+TEST_CASE(transformArraysMatchReference) {
+
+	TestRandom R(11);
+
+	XMMATRIX M = XMMatrixScaling(2.0f, 0.5f, 3.0f) * XMMatrixRotationRollPitchYaw(0.3f, 1.1f, -0.7f) * XMMatrixTranslation(10.0f, -4.0f, 7.0f);
+	XMFLOAT4X4 m;
+
+	XMStoreFloat4x4(&m, M);
+
+	for (uint32_t count = 0; count <= 19; count++) {
+
+		vector<float> x(count), y(count), z(count), outX(count), outY(count), outZ(count);
+
+		for (uint32_t i = 0; i < count; i++) {
+
+			x[i] = R.uniform(-10.0f, 10.0f);
+			y[i] = R.uniform(-10.0f, 10.0f);
+			z[i] = R.uniform(-10.0f, 10.0f);
+		}
+
+		float pointError = 0.0f, normalError = 0.0f, vectorError = 0.0f;
+
+		DXTransformBatch::TransformPoints(M, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count);
+
+		for (uint32_t i = 0; i < count; i++) {
+
+			XMFLOAT3 p;
+
+			XMStoreFloat3(&p, XMVector3Transform(XMVectorSet(x[i], y[i], z[i], 1.0f), M));
+			pointError = max(pointError, max(fabsf(outX[i] - p.x), max(fabsf(outY[i] - p.y), fabsf(outZ[i] - p.z))));
+		}
+
+		// In place
+		vector<float> nx = x, ny = y, nz = z;
+
+		DXTransformBatch::TransformNormals(M, nx.data(), ny.data(), nz.data(), nx.data(), ny.data(), nz.data(), count);
+
+		for (uint32_t i = 0; i < count; i++) {
+
+			XMFLOAT3 n;
+
+			XMStoreFloat3(&n, XMVector3TransformNormal(XMVectorSet(x[i], y[i], z[i], 0.0f), M));
+			normalError = max(normalError, max(fabsf(nx[i] - n.x), max(fabsf(ny[i] - n.y), fabsf(nz[i] - n.z))));
+		}
+
+		// Homogeneous vectors.  The column-major GUMatrix4 holding the same 16 floats is M^T, so M^T * v gives the same results as v * M
+		vector<GUVector4> V(count), U(count);
+		GUMatrix4 G;
+
+		memcpy(G.M, &m, sizeof(G.M));
+
+		for (uint32_t i = 0; i < count; i++)
+			V[i] = U[i] = GUVector4(x[i], y[i], z[i], (i % 2 == 0) ? 1.0f : 0.0f);
+
+		DXTransformBatch::TransformVectors(M, V.data(), count);
+		DXTransformBatch::TransformVectors(G, U.data(), count);
+
+		for (uint32_t i = 0; i < count; i++) {
+
+			XMFLOAT4 v;
+
+			XMStoreFloat4(&v, XMVector4Transform(XMVectorSet(x[i], y[i], z[i], (i % 2 == 0) ? 1.0f : 0.0f), M));
+
+			vectorError = max(vectorError, max(max(fabsf(V[i].x - v.x), fabsf(V[i].y - v.y)), max(fabsf(V[i].z - v.z), fabsf(V[i].w - v.w))));
+			vectorError = max(vectorError, max(max(fabsf(U[i].x - v.x), fabsf(U[i].y - v.y)), max(fabsf(U[i].z - v.z), fabsf(U[i].w - v.w))));
+		}
+
+		TEST_CHECK(pointError < 1.0e-4f);
+		TEST_CHECK(normalError < 1.0e-4f);
+		TEST_CHECK(vectorError < 1.0e-4f);
+	}
+}
+
+
+// World and normal matrices of one instance composed as the scene did before DXTransformBatch, by matrix products and a general inverse
+static void directXMathCompose(const XMFLOAT3& S, const XMFLOAT4& q, const XMFLOAT3& T, XMFLOAT4X4& world, XMFLOAT4X4& normal) {
+
+	XMMATRIX W = XMMatrixScaling(S.x, S.y, S.z) * XMMatrixRotationQuaternion(XMQuaternionNormalize(XMLoadFloat4(&q))) * XMMatrixTranslation(T.x, T.y, T.z);
+
+	XMStoreFloat4x4(&world, W);
+	XMStoreFloat4x4(&normal, XMMatrixTranspose(XMMatrixInverse(nullptr, W)));
+}
+
+
+BENCHMARK(transformBatch) {
+
+	GUParallel *pool = GUParallel::CreateThreadPool();
+
+	cout << "  " << DX_TRANSFORM_LANES << " lanes, " << pool->threadCount() << " threads" << endl;
+
+	for (uint32_t count = 10000; count <= 1000000; count *= 10) {
+
+		vector<XMFLOAT3> S, T;
+		vector<XMFLOAT4> q;
+
+		randomTransforms(S, q, T, count, 1);
+
+		DXTransformBatch *batch = new DXTransformBatch(count);
+
+		for (uint32_t i = 0; i < count; i++)
+			batch->addTransform(S[i], q[i], T[i]);
+
+		vector<TransformRecord> records(count);
+		uint32_t numRepeats = max(1u, 2000000 / count);
+
+		cout << "  " << count << " instances" << endl;
+
+		TestTimer timer;
+
+		for (uint32_t r = 0; r < numRepeats; r++)
+			for (uint32_t i = 0; i < count; i++)
+				directXMathCompose(S[i], q[i], T[i], records[i].world, records[i].normal);
+
+		test_report("DirectXMath per instance", count * numRepeats, timer.seconds());
+
+		timer.reset();
+
+		for (uint32_t r = 0; r < numRepeats; r++)
+			batch->compose(&records[0].world, &records[0].normal, sizeof(TransformRecord));
+
+		test_report("compose world + normal", count * numRepeats, timer.seconds());
+
+		timer.reset();
+
+		for (uint32_t r = 0; r < numRepeats; r++)
+			batch->compose(&records[0].world, &records[0].normal, sizeof(TransformRecord), pool);
+
+		test_report("compose world + normal (pool)", count * numRepeats, timer.seconds());
+
+		timer.reset();
+
+		for (uint32_t r = 0; r < numRepeats; r++)
+			batch->compose(&records[0].world, nullptr, sizeof(TransformRecord));
+
+		test_report("compose world", count * numRepeats, timer.seconds());
+
+		batch->release();
+	}
+
+	// Point arrays
+	const uint32_t numPoints = 1000000;
+
+	vector<float> x = vector<float>(numPoints, 1.0f), y = x, z = x;
+	vector<XMFLOAT3> points(numPoints, XMFLOAT3(1.0f, 1.0f, 1.0f));
+
+	XMMATRIX M = XMMatrixRotationRollPitchYaw(0.3f, 1.1f, -0.7f) * XMMatrixTranslation(10.0f, -4.0f, 7.0f);
+
+	cout << "  " << numPoints << " points" << endl;
+
+	TestTimer timer;
+
+	for (uint32_t r = 0; r < 10; r++)
+		XMVector3TransformCoordStream(points.data(), sizeof(XMFLOAT3), points.data(), sizeof(XMFLOAT3), numPoints, M);
+
+	test_report("XMVector3TransformCoordStream (AoS)", numPoints * 10, timer.seconds());
+
+	timer.reset();
+
+	for (uint32_t r = 0; r < 10; r++)
+		DXTransformBatch::TransformPoints(M, x.data(), y.data(), z.data(), x.data(), y.data(), z.data(), numPoints);
+
+	test_report("TransformPoints (SoA)", numPoints * 10, timer.seconds());
+
+	pool->release();
+}
+
+#pragma endregion
+
+
+
+#pragma region DXTransform
+
+static XMFLOAT4X4 toFloat4x4(FXMMATRIX M) {
+
+	XMFLOAT4X4 F;
+
+	XMStoreFloat4x4(&F, M);
+
+	return F;
+}
+
+
+// Compose gives W = S * R * T and a normal matrix equal to the transposed general inverse of W for non-uniform scales, including negative ones
+TEST_CASE(transformComposeMatchesInverse) {
+
+	vector<XMFLOAT3> S, T;
+	vector<XMFLOAT4> q;
+
+	randomTransforms(S, q, T, 1000, 41);
+
+	uint32_t numWorldErrors = 0, numNormalErrors = 0, numInverseErrors = 0;
+
+	for (uint32_t i = 0; i < S.size(); i++) {
+
+		XMVECTOR rotation = XMQuaternionNormalize(XMLoadFloat4(&q[i]));
+		XMMATRIX W, N;
+
+		DXTransform::Compose(XMLoadFloat3(&S[i]), rotation, XMLoadFloat3(&T[i]), &W, &N);
+
+		XMMATRIX expectedW = XMMatrixScaling(S[i].x, S[i].y, S[i].z) * XMMatrixRotationQuaternion(rotation) * XMMatrixTranslation(T[i].x, T[i].y, T[i].z);
+		XMMATRIX expectedN = XMMatrixTranspose(XMMatrixInverse(nullptr, expectedW));
+
+		if (matrixError(toFloat4x4(W), toFloat4x4(expectedW)) > 1e-5f)
+			numWorldErrors++;
+
+		if (matrixError(toFloat4x4(N), toFloat4x4(expectedN)) > 1e-4f)
+			numNormalErrors++;
+
+		// N^T is the inverse of W
+		if (matrixError(toFloat4x4(W * XMMatrixTranspose(N)), toFloat4x4(XMMatrixIdentity())) > 1e-3f)
+			numInverseErrors++;
+	}
+
+	TEST_CHECK(numWorldErrors == 0);
+	TEST_CHECK(numNormalErrors == 0);
+	TEST_CHECK(numInverseErrors == 0);
+
+	// Either output may be null
+	XMMATRIX W = XMMatrixIdentity(), N = XMMatrixIdentity();
+
+	DXTransform::Compose(XMVectorSet(2.0f, 3.0f, 4.0f, 0.0f), XMQuaternionIdentity(), XMVectorSet(1.0f, 2.0f, 3.0f, 0.0f), &W, nullptr);
+	DXTransform::Compose(XMVectorSet(2.0f, 3.0f, 4.0f, 0.0f), XMQuaternionIdentity(), XMVectorSet(1.0f, 2.0f, 3.0f, 0.0f), nullptr, &N);
+
+	TEST_CHECK(matrixError(toFloat4x4(W), toFloat4x4(XMMatrixScaling(2.0f, 3.0f, 4.0f) * XMMatrixTranslation(1.0f, 2.0f, 3.0f))) < 1e-6f);
+	TEST_CHECK(matrixError(toFloat4x4(N), toFloat4x4(XMMatrixTranspose(XMMatrixInverse(nullptr, W)))) < 1e-6f);
+}
+
+
+// Setting a component marks the transform dirty, the matrices are rebuilt once on the next access and then match Compose of the new components
+TEST_CASE(transformCache) {
+
+	DXTransform X;
+
+	TEST_CHECK(X.isDirty());
+	TEST_CHECK(matrixError(toFloat4x4(X.worldMatrix()), toFloat4x4(XMMatrixIdentity())) == 0.0f);
+	TEST_CHECK(!X.isDirty() && !X.update());
+
+	// The rotation is normalised when set
+	X = DXTransform(XMFLOAT3(2.0f, 0.5f, -3.0f), XMFLOAT4(0.0f, 2.0f, 0.0f, 2.0f), XMFLOAT3(10.0f, -4.0f, 7.0f));
+
+	XMVECTOR rotation = XMLoadFloat4(&X.getRotation());
+
+	TEST_CHECK_CLOSE(XMVectorGetX(XMVector4Length(rotation)), 1.0f, 1e-6f);
+	TEST_CHECK(X.isDirty() && X.update() && !X.update());
+
+	uint32_t numStale = 0, numNotDirty = 0, numWrong = 0;
+	TestRandom R(7);
+
+	for (uint32_t k = 0; k < 200; k++) {
+
+		switch (k % 5) {
+
+		case 0:
+			X.setScale(XMFLOAT3(R.uniform(0.2f, 4.0f), R.uniform(0.2f, 4.0f), -R.uniform(0.2f, 4.0f)));
+			break;
+
+		case 1:
+			X.setRotation(XMFLOAT4(R.uniform(-1.0f, 1.0f), R.uniform(-1.0f, 1.0f), R.uniform(-1.0f, 1.0f), R.uniform(0.1f, 1.0f)));
+			break;
+
+		case 2:
+			X.setRotationRollPitchYaw(R.uniform(-3.0f, 3.0f), R.uniform(-3.0f, 3.0f), R.uniform(-3.0f, 3.0f));
+			break;
+
+		case 3:
+			X.setTranslation(XMFLOAT3(R.uniform(-100.0f, 100.0f), R.uniform(-100.0f, 100.0f), R.uniform(-100.0f, 100.0f)));
+			break;
+
+		default:
+			X.translate(XMFLOAT3(1.0f, -2.0f, 0.5f));
+			break;
+		}
+
+		if (!X.isDirty())
+			numNotDirty++;
+
+		XMMATRIX W, N;
+
+		DXTransform::Compose(XMLoadFloat3(&X.getScale()), XMLoadFloat4(&X.getRotation()), XMLoadFloat3(&X.getTranslation()), &W, &N);
+
+		// The first access rebuilds the cache, later ones return it unchanged
+		XMFLOAT4X4 world = toFloat4x4(X.worldMatrix());
+
+		if (X.isDirty() || X.update())
+			numStale++;
+
+		if (matrixError(world, toFloat4x4(W)) != 0.0f || matrixError(toFloat4x4(X.normalMatrix()), toFloat4x4(N)) != 0.0f)
+			numWrong++;
+
+		if (matrixError(toFloat4x4(X.inverseWorldMatrix()), toFloat4x4(XMMatrixInverse(nullptr, W))) > 1e-4f)
+			numWrong++;
+	}
+
+	TEST_CHECK(numNotDirty == 0 && numStale == 0 && numWrong == 0);
+
+	// translate adds to the translation
+	X.setTranslation(XMFLOAT3(1.0f, 2.0f, 3.0f));
+	X.translate(XMFLOAT3(0.5f, -1.0f, 2.0f));
+
+	TEST_CHECK(X.getTranslation().x == 1.5f && X.getTranslation().y == 1.0f && X.getTranslation().z == 5.0f);
+
+	// setRotationRollPitchYaw uses XMQuaternionRotationRollPitchYaw
+	X.setRotationRollPitchYaw(0.3f, -1.2f, 2.0f);
+
+	TEST_CHECK(XMVector4NearEqual(XMLoadFloat4(&X.getRotation()), XMQuaternionRotationRollPitchYaw(0.3f, -1.2f, 2.0f), XMVectorReplicate(1e-6f)));
+}
+
+#pragma endregion
+
+
+
+#pragma region DXSceneGraph
+
+// World matrix of a node built with XMMatrixScaling, XMMatrixRotationQuaternion and XMMatrixTranslation from its local components, times its parent's world matrix
+static XMMATRIX referenceNodeWorld(const DXSceneGraph& graph, const uint32_t node) {
+
+	const XMFLOAT3& S = graph.getLocalScale(node);
+	const XMFLOAT3& T = graph.getLocalTranslation(node);
+
+	XMMATRIX W = XMMatrixScaling(S.x, S.y, S.z) * XMMatrixRotationQuaternion(XMLoadFloat4(&graph.getLocalRotation(node))) * XMMatrixTranslation(T.x, T.y, T.z);
+
+	if (graph.parentOf(node) != DX_SCENE_ROOT)
+		W = W * referenceNodeWorld(graph, graph.parentOf(node));
+
+	return W;
+}
+
+
+// Number of nodes whose world, normal or inverse world matrix differs from the reference, with the normal and inverse matrices found by XMMatrixInverse
+static uint32_t sceneGraphErrors(const DXSceneGraph& graph) {
+
+	uint32_t numErrors = 0;
+
+	for (uint32_t i = 0; i < graph.nodeCount(); i++) {
+
+		XMMATRIX W = referenceNodeWorld(graph, i);
+		XMMATRIX inverseW = XMMatrixInverse(nullptr, W);
+
+		if (matrixError(toFloat4x4(graph.worldMatrix(i)), toFloat4x4(W)) > 1e-5f)
+			numErrors++;
+
+		if (matrixError(toFloat4x4(graph.normalMatrix(i)), toFloat4x4(XMMatrixTranspose(inverseW))) > 1e-4f)
+			numErrors++;
+
+		if (matrixError(toFloat4x4(graph.inverseWorldMatrix(i)), toFloat4x4(inverseW)) > 1e-4f)
+			numErrors++;
+
+		if (matrixError(graph.worldMatrices()[i], toFloat4x4(graph.worldMatrix(i))) != 0.0f)
+			numErrors++;
+	}
+
+	return numErrors;
+}
+
+
+// Bit i set if update rebuilt node i
+static uint32_t changedNodes(const DXSceneGraph& graph) {
+
+	uint32_t mask = 0;
+
+	for (uint32_t i = 0; i < graph.nodeCount(); i++)
+		if (graph.nodeChanged(i))
+			mask |= 1 << i;
+
+	return mask;
+}
+
+
+// A three-level chain 0 -> 1 -> 2 and a sibling subtree 0 -> 3 -> 4, all with non-uniform (and one negative) scales.  update composes W = S * R * T * parentW and N = N_local * N_parent, rebuilds only the dirty nodes and their descendants, and does nothing for a static graph
+TEST_CASE(sceneGraphUpdate) {
+
+	DXSceneGraph *graph = new DXSceneGraph();
+
+	uint32_t root = graph->addNode(DX_SCENE_ROOT, XMFLOAT3(2.0f, 0.5f, 1.5f), XMFLOAT4(0.1f, 0.7f, -0.2f, 0.6f), XMFLOAT3(10.0f, -2.0f, 5.0f));
+	uint32_t middle = graph->addNode(root, XMFLOAT3(0.5f, 3.0f, 1.0f), XMFLOAT4(-0.4f, 0.1f, 0.3f, 0.8f), XMFLOAT3(-1.0f, 4.0f, 2.0f));
+	uint32_t leaf = graph->addNode(middle, XMFLOAT3(1.2f, 0.8f, -2.0f), XMFLOAT4(0.0f, 0.0f, 0.5f, 0.9f), XMFLOAT3(3.0f, 0.5f, -1.5f));
+	uint32_t sibling = graph->addNode(root, XMFLOAT3(1.0f, 2.0f, 0.25f), XMFLOAT4(0.3f, -0.3f, 0.3f, 0.7f), XMFLOAT3(0.0f, -3.0f, 6.0f));
+	uint32_t siblingLeaf = graph->addNode(sibling, XMFLOAT3(4.0f, 1.0f, 0.5f), XMFLOAT4(0.2f, 0.5f, 0.0f, 0.4f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+
+	TEST_CHECK(graph->nodeCount() == 5);
+	TEST_CHECK(graph->parentOf(leaf) == middle && graph->parentOf(siblingLeaf) == sibling && graph->parentOf(root) == DX_SCENE_ROOT);
+
+	// New nodes are dirty, so the first update builds everything
+	TEST_CHECK(graph->update() == 5);
+	TEST_CHECK(changedNodes(*graph) == 0x1F);
+	TEST_CHECK(sceneGraphErrors(*graph) == 0);
+
+	// A static graph rebuilds nothing and the changed flags of the previous update are cleared
+	TEST_CHECK(graph->update() == 0);
+	TEST_CHECK(changedNodes(*graph) == 0);
+
+	// Moving the middle node rebuilds it and its child but not the root or the sibling subtree created after it
+	XMFLOAT4X4 siblingWorld = toFloat4x4(graph->worldMatrix(siblingLeaf));
+
+	graph->setLocalTranslation(middle, XMFLOAT3(-2.0f, 6.0f, 1.0f));
+
+	TEST_CHECK(graph->update() == 2);
+	TEST_CHECK(changedNodes(*graph) == ((1u << middle) | (1u << leaf)));
+	TEST_CHECK(sceneGraphErrors(*graph) == 0);
+	TEST_CHECK(matrixError(toFloat4x4(graph->worldMatrix(siblingLeaf)), siblingWorld) == 0.0f);
+
+	// No-op frame after the move
+	TEST_CHECK(graph->update() == 0);
+	TEST_CHECK(changedNodes(*graph) == 0);
+	TEST_CHECK(sceneGraphErrors(*graph) == 0);
+
+	// Changes to nodes in both subtrees in one frame
+	graph->setLocalScale(leaf, XMFLOAT3(0.3f, 0.3f, 5.0f));
+	graph->setLocalRotation(sibling, XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f));
+
+	TEST_CHECK(graph->update() == 3);
+	TEST_CHECK(changedNodes(*graph) == ((1u << leaf) | (1u << sibling) | (1u << siblingLeaf)));
+	TEST_CHECK(sceneGraphErrors(*graph) == 0);
+
+	// The rotation is normalised when set
+	TEST_CHECK_CLOSE(XMVectorGetX(XMVector4Length(XMLoadFloat4(&graph->getLocalRotation(sibling)))), 1.0f, 1e-6f);
+
+	// Moving the root rebuilds the whole graph
+	graph->setLocalTransform(root, XMFLOAT3(1.0f, 1.0f, 3.0f), XMFLOAT4(0.5f, 0.5f, 0.5f, 0.5f), XMFLOAT3(0.0f, 20.0f, 0.0f));
+
+	TEST_CHECK(graph->update() == 5);
+	TEST_CHECK(changedNodes(*graph) == 0x1F);
+	TEST_CHECK(sceneGraphErrors(*graph) == 0);
+
+	TEST_CHECK(graph->update() == 0);
+
+	graph->clear();
+
+	TEST_CHECK(graph->nodeCount() == 0 && graph->update() == 0);
+
+	graph->release();
+}
+
+#pragma endregion